@@ -11,18 +11,49 @@
 // https://groups.google.com/g/comp.sys.apple2/c/2NHj_6azS_g/m/H67Cijk7ViEJ
 // Gil Megidish's pixel rendering algorithm
 
+// Run with --screen FILE to also decode a full-screen hi-res picture, such as a title or intro screen, to FILE.pcx.
+// --screen can be given more than once.
+
+// Run with --ntsc to render through a simulation of the NTSC composite signal instead of the flat colors, with the
+// color fringing and blending of a real monitor. That writes true color ultshapes_ntsc.png and mapchars_ntsc.png files
+// (and FILE_ntsc.png for --screen) without opening a window.
+
+// Run with --encode-tiles FILE.png DIR to go the other way: an edited copy of ultshapes.pcx (saved as PNG) is encoded
+// over ULTSHAPES and written to DIR, with the bits of every byte picked so the tiles render as close to it as possible.
+// Rows that weren't edited keep their bytes, and so does the rest of the file after the tile data.
+
+// Takes the options every ripper does (see ripper_options.h): --verify against ultshapes.png and mapchars.png, --pack
+// and --datafile with the tiles and map characters, --stats and --force-isa.
+
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_reader.h"
+#include "../../util/png/png_writer.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/apple2_decode.h"
+#include "../../util/tile_decode/apple2_encode.h"
+#include "../../util/tile_decode/apple2_ntsc.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/apple2_encode_verify.h"
+#include "../../util/verify/apple2_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
+
 // OUT.SHAPES size 512 bytes
 // SPA.SHAPES size 860 bytes
 // TWN.CAS.SHAPES size 256 bytes
-// ULTSHAPES size 763 bytes - possibly only contains 512 bytes of tile data?
+// ULTSHAPES size 763 bytes - only the first 512 bytes are tile data
 // MAPCHARS is 1024 bytes
 
 #define TILE_WIDTH    14
@@ -53,227 +84,500 @@
 #define MAPCHARS_BUFFER_HEIGHT ( CHAR_HEIGHT * CHARS_PER_COL_MAPCHARS )
 
 
-enum colorType
+// Each ULTSHAPES row is 2 bytes that render as one 14 pixel span. The first 256 bytes contain the left side of each
+// tile and the next 256 bytes contain the right side. The pixel bits of the right side are drawn first, but each half
+// keeps the colorGroup bit of the other byte.
+void DecodeUltShapesBytes( const std::vector<uint8_t>& fileData, IndexSurface& surface, RgbSurface* ntsc = nullptr )
 {
-  Green,
-  Orange,
-  Violet,
-  Blue,
-  White,
-  Black
-};
+  surface.Create( ULTSHAPES_BUFFER_WIDTH, ULTSHAPES_BUFFER_HEIGHT );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( ULTSHAPES_BUFFER_WIDTH, ULTSHAPES_BUFFER_HEIGHT );
+  }
 
-int colorTable[6];
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
 
+  for( uint32_t i = 0; i < ULTSHAPES_ROWS; ++i )
+  {
+    const uint8_t left{ fileData[i] };
+    const uint8_t right{ fileData[ULTSHAPES_ROWS + i] };
 
-// From Gil Megidish:
-// The algorithm is this: for any given pixel at x, if x is 1 and any of( x - 1 ), ( x + 1 ) are 1s, then pixel at x is
-// white. if x is 0 and the two adjacent are also zero, then pixel at x is black. Now it's tricky. If x is 1 and both
-// adjacent pixels are 0, then pixel at x is green/purple (if odd or even), there's also blue / orange for second
-// palette. If x is 0, and both adjacent are 1, then the previous algorithm also catches. Sum it up, color at pixel x
-// depends on the two adjacent pixels, the MSB of the byte being rendered, and if this pixel is odd / even.
+    const uint8_t tileData[TILE_BYTES_PER_ROW] =
+    {
+      static_cast<uint8_t>( ( right & 0x7f ) | ( left & 0x80 ) ),
+      static_cast<uint8_t>( ( left & 0x7f ) | ( right & 0x80 ) )
+    };
+    DecodeAppleSpan( tileData, TILE_BYTES_PER_ROW, false, false, surface.Row( i ) );
 
-void Draw( BITMAP* buffer, uint32_t x, uint32_t y, uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd )
+    if( ntsc != nullptr )
+    {
+      DecodeAppleSpanNtsc( tileData, TILE_BYTES_PER_ROW, false, ntsc->Row( i ) );
+    }
+  }
+}
+
+
+bool DecodeUltShapes( IndexSurface& surface, RgbSurface* ntsc = nullptr )
 {
-  colorType color{ Black };
+  INSTRUMENT_BEGIN_FILE( "ULTSHAPES" );
 
-  if( ( value & 0x1 ) == 1 )
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( "ULTSHAPES", fileData ) )
   {
-    if( lastBitOn || ( ( value >> 1 ) & 0x1 ) )
+    return false;
+  }
+
+  // Anything missing from the end of the file reads as EOF, like infile.get()
+  if( fileData.size() < ULTSHAPES_BYTES )
+  {
+    fileData.resize( ULTSHAPES_BYTES, 0xff );
+  }
+
+  DecodeUltShapesBytes( fileData, surface, ntsc );
+  return true;
+}
+
+
+// The reverse of DecodeUltShapesBytes(), for a sheet laid out like ultshapes.pcx: the pixel bits of each span go back
+// to the other half, and each half keeps its own colorGroup bit. fileData is the ULTSHAPES file to patch, where only
+// the rows that render differently change and the bytes past the tile data are kept, or empty to encode every tile
+// afresh. Returns how far the tiles are from the sheet (0 if they match exactly), or -1 if the sheet is too small.
+int64_t EncodeUltShapesBytes( const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize,
+                              std::vector<uint8_t>& fileData )
+{
+  // The spans as DecodeUltShapesBytes() renders them, one tile after another
+  std::vector<uint8_t> tiles;
+  if( !fileData.empty() )
+  {
+    if( fileData.size() < ULTSHAPES_BYTES )
     {
-      color = White;
+      fileData.resize( ULTSHAPES_BYTES, 0xff );
     }
-    else if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+
+    tiles.resize( ULTSHAPES_BYTES );
+    for( uint32_t i = 0; i < ULTSHAPES_ROWS; ++i )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
-      else
+      const uint8_t left{ fileData[i] };
+      const uint8_t right{ fileData[ULTSHAPES_ROWS + i] };
+
+      tiles[i * TILE_BYTES_PER_ROW] = static_cast<uint8_t>( ( right & 0x7f ) | ( left & 0x80 ) );
+      tiles[i * TILE_BYTES_PER_ROW + 1] = static_cast<uint8_t>( ( left & 0x7f ) | ( right & 0x80 ) );
+    }
+  }
+
+  const int64_t difference{ EncodeAppleTiles( sheet, palette, paletteSize, TILES_PER_COL_ULTSHAPES,
+                                              TILES_PER_ROW_ULTSHAPES, TILE_WIDTH, TILE_HEIGHT, false, tiles, 0 ) };
+  if( difference < 0 )
+  {
+    return difference;
+  }
+
+  // Span i is ULTSHAPES row i
+  if( fileData.empty() )
+  {
+    fileData.resize( ULTSHAPES_BYTES );
+  }
+
+  for( uint32_t i = 0; i < ULTSHAPES_ROWS; ++i )
+  {
+    const uint8_t* tileData{ &tiles[i * TILE_BYTES_PER_ROW] };
+
+    fileData[i] = static_cast<uint8_t>( ( tileData[1] & 0x7f ) | ( tileData[0] & 0x80 ) );
+    fileData[ULTSHAPES_ROWS + i] = static_cast<uint8_t>( ( tileData[0] & 0x7f ) | ( tileData[1] & 0x80 ) );
+  }
+
+  return difference;
+}
+
+
+// MAPCHARS is made of 128 byte strides, where each stride holds 1 row of every character
+bool DecodeMapChars( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( "MAPCHARS" );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( "MAPCHARS", fileData ) )
+  {
+    return false;
+  }
+
+  if( fileData.size() < MAPCHARS_BYTES )
+  {
+    fileData.resize( MAPCHARS_BYTES, 0xff );
+  }
+
+  surface.Create( MAPCHARS_BUFFER_WIDTH, MAPCHARS_BUFFER_HEIGHT );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( MAPCHARS_BUFFER_WIDTH, MAPCHARS_BUFFER_HEIGHT );
+  }
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  const uint8_t* tileData{ fileData.data() };
+  for( int32_t y = 0; y < MAPCHARS_BUFFER_HEIGHT; ++y )
+  {
+    uint8_t* row{ surface.Row( y ) };
+    for( int32_t i = 0; i < CHARS_PER_ROW_MAPCHARS; ++i )
+    {
+      DecodeAppleSpan( tileData, 1, false, false, row + i * CHAR_WIDTH );
+
+      if( ntsc != nullptr )
       {
-        color = firstColorGroup ? Violet : Blue;
+        DecodeAppleSpanNtsc( tileData, 1, false, ntsc->Row( y ) + i * CHAR_WIDTH );
       }
+
+      ++tileData;
     }
   }
-  else
+
+  return true;
+}
+
+
+// A whole hi-res page, as saved from $2000
+bool DecodeScreen( const char* filename, IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> picture;
+  if( !ReadFileBytes( filename, picture ) )
   {
-    if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    printf( "Can't open %s\n", filename );
+    return false;
+  }
+
+  if( !DecodeAppleScreen( picture.data(), picture.size(), surface, 0 ) )
+  {
+    printf( "%s is %d bytes, too short for a hi-res screen\n", filename, static_cast<int32_t>( picture.size() ) );
+    return false;
+  }
+
+  return ntsc == nullptr || DecodeAppleScreenNtsc( picture.data(), picture.size(), *ntsc, 0 );
+}
+
+
+bool Verify()
+{
+  bool passed{ VerifyAppleKernels() };
+  passed &= VerifyAppleEncoder();
+  passed &= VerifyAppleScreenDecoder();
+  passed &= VerifyAppleNtsc();
+  passed &= VerifyDispatchKernels();
+
+  IndexSurface surface;
+
+  if( DecodeUltShapes( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "ULTSHAPES", surface, apple2Palette, 6, "ultshapes.png", TILE_WIDTH,
+                                       TILE_HEIGHT );
+    passed &= VerifySheetPack( "ULTSHAPES", surface, apple2Palette, 6, TILE_WIDTH, TILE_HEIGHT );
+
+    // The decoded tiles have to encode back to bytes that decode the same
+    std::vector<uint8_t> ultShapes;
+    IndexSurface reencoded;
+    const int64_t difference{ EncodeUltShapesBytes( surface, apple2Palette, 6, ultShapes ) };
+    DecodeUltShapesBytes( ultShapes, reencoded );
+
+    if( difference == 0 && reencoded.pixels == surface.pixels )
     {
-      color = Black;
+      printf( "OK   ULTSHAPES re-encodes to the same tiles\n" );
     }
-    if( lastBitOn && ( ( value >> 1 ) & 0x1 ) )
+    else
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Violet : Blue;
-      }
-      else
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
+      printf( "FAIL ULTSHAPES doesn't re-encode to the same tiles\n" );
+      passed = false;
+    }
+
+    // Encoded over the file itself, the same tiles have to give back the file byte for byte
+    std::vector<uint8_t> original;
+    ReadFileBytes( "ULTSHAPES", original );
+    ultShapes = original;
+
+    if( EncodeUltShapesBytes( surface, apple2Palette, 6, ultShapes ) == 0 && ultShapes == original )
+    {
+      printf( "OK   ULTSHAPES encodes over itself to the same %d bytes\n", static_cast<int32_t>( original.size() ) );
+    }
+    else
+    {
+      printf( "FAIL ULTSHAPES doesn't encode over itself to the same bytes\n" );
+      passed = false;
     }
   }
+  else
+  {
+    printf( "FAIL can't open ULTSHAPES\n" );
+    passed = false;
+  }
 
-  putpixel( buffer, x, y, colorTable[color] );
+  if( DecodeMapChars( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "MAPCHARS", surface, apple2Palette, 6, "mapchars.png", CHAR_WIDTH,
+                                       CHAR_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open MAPCHARS\n" );
+    passed = false;
+  }
+
+  return passed;
 }
 
 
-int32_t main()
+// Headless: reads an edited tile sheet, encodes it over ULTSHAPES and writes the result into directory
+bool EncodeTiles( const char* pngFilename, const char* directory )
 {
-  if( allegro_init() != 0 )
+  PngImage sheet;
+  const char* error{ nullptr };
+  if( !ReadPng( pngFilename, sheet, error ) )
   {
-    allegro_message( "Allegro initialization failed" );
-    return -1;
+    printf( "%s: %s\n", pngFilename, error );
+    return false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  std::vector<uint8_t> ultShapes;
+  if( !ReadFileBytes( "ULTSHAPES", ultShapes ) || ultShapes.empty() )
   {
-    depth = 16;
+    printf( "Can't open ULTSHAPES to encode the tiles over\n" );
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  const int64_t difference{ EncodeUltShapesBytes( sheet.indices, sheet.palette.data(),
+                                                  static_cast<int32_t>( sheet.palette.size() ), ultShapes ) };
+  if( difference < 0 )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    printf( "%s: needs to be at least %dx%d\n", pngFilename, ULTSHAPES_BUFFER_WIDTH, ULTSHAPES_BUFFER_HEIGHT );
+    return false;
   }
 
-  colorTable[Green]  = makecol( 0x25, 0xBE, 0x00 );
-  colorTable[Orange] = makecol( 0xE5, 0x50, 0x00 );
-  colorTable[Violet] = makecol( 0x9E, 0x00, 0xFF );
-  colorTable[Blue]   = makecol( 0x00, 0x7E, 0xFF );
-  colorTable[White]  = makecol( 0xFF, 0xFF, 0xFF );
-  colorTable[Black]  = makecol( 0x00, 0x00, 0x00 );
+  const std::string filename{ std::string( directory ) + "/ULTSHAPES" };
+  if( !WriteFileBytes( filename.c_str(), ultShapes ) )
+  {
+    printf( "Can't write %s\n", filename.c_str() );
+    return false;
+  }
 
-  // ---------------------
-  // Process ULTSHAPES
-  // ---------------------
+  printf( "%s: wrote %s, squared color difference %lld\n", pngFilename, filename.c_str(),
+          static_cast<long long>( difference ) );
+  return true;
+}
 
-  BITMAP* backBuffer{ create_bitmap( ULTSHAPES_BUFFER_WIDTH, ULTSHAPES_BUFFER_HEIGHT ) };
 
-  std::ifstream infile;
-  infile.open( "ULTSHAPES", std::ios::in | std::ios::binary );
+// The sheets (and --screen pictures) of a normal run, through the NTSC simulation
+bool WriteNtsc( int32_t argc, char* argv[] )
+{
+  IndexSurface surface;
+  RgbSurface ntsc;
 
-  if( !infile.is_open() )
+  if( !DecodeUltShapes( surface, &ntsc ) || !WritePngRgb( "ultshapes_ntsc.png", ntsc ) )
   {
-    return -1;
+    return false;
   }
 
-  uint32_t numBytesToRead{ ULTSHAPES_BYTES / 2 };
-  uint32_t currentBytes{ 0 };
-  uint32_t rowData[ULTSHAPES_ROWS];
-  uint32_t rowData2[ULTSHAPES_ROWS];
+  if( !DecodeMapChars( surface, &ntsc ) || !WritePngRgb( "mapchars_ntsc.png", ntsc ) )
+  {
+    return false;
+  }
 
-  // The first 256 bytes contain the left side of each tile
-  while( currentBytes < numBytesToRead )
+  for( int32_t i = 1; i + 1 < argc; ++i )
   {
-    const uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-    rowData[currentBytes++] = ( tileData << 8 ) & 0xffff;
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface, &ntsc ) ||
+        !WritePngRgb( ( std::string( argv[i + 1] ) + "_ntsc.png" ).c_str(), ntsc ) )
+    {
+      return false;
+    }
   }
 
-  currentBytes = 0;
+  return true;
+}
+
 
-  // The next 256 bytes contain the right side of each tile
-  while( currentBytes < numBytesToRead )
+// The tiles, then the characters, packed from the sheets of a normal run
+bool WritePack( const char* filename, bool compress )
+{
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( apple2Palette, 6 ) };
+  IndexSurface surface;
+
+  if( !DecodeUltShapes( surface ) || writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
   {
-    const uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-    rowData[currentBytes++] |= ( static_cast<uint32_t>( tileData ) & 0xff );
+    return false;
   }
 
-  uint32_t x{ 0 };
-  uint32_t y{ 0 };
+  if( !DecodeMapChars( surface ) || writer.AddSheet( surface, CHAR_WIDTH, CHAR_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
 
-  for( uint32_t i = 0; i < ULTSHAPES_ROWS; ++i )
+  if( !writer.Save( filename, compress ) )
   {
-    uint32_t tileData{ rowData[i] };
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
+  }
 
-    const bool colorGroup1{ ( ( tileData >> 15 ) & 0x1 ) == 0 };
-    const bool colorGroup2{ ( ( tileData >> 7 ) & 0x1 ) == 0 };
+  return true;
+}
 
-    // Combine both bytes into one word, ignoring the colorGroup bits
-    tileData = ( ( ( tileData >> 8 ) & 0x7f ) << 7 ) | ( tileData & 0x7f );
 
-    // Place the row of pixels
-    Draw( backBuffer, x++, y, ( tileData >> 0  ) & 0x3, false, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 1  ) & 0x3, ( tileData >> 0  ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 2  ) & 0x3, ( tileData >> 1  ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 3  ) & 0x3, ( tileData >> 2  ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 4  ) & 0x3, ( tileData >> 3  ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 5  ) & 0x3, ( tileData >> 4  ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 6  ) & 0x3, ( tileData >> 5  ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 7  ) & 0x3, ( tileData >> 6  ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 8  ) & 0x3, ( tileData >> 7  ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 9  ) & 0x3, ( tileData >> 8  ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 10 ) & 0x3, ( tileData >> 9  ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 11 ) & 0x3, ( tileData >> 10 ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 12 ) & 0x3, ( tileData >> 11 ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 13 ) & 0x3, ( tileData >> 12 ) & 0x1, colorGroup2, true );
+// The tiles and characters of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", apple2Palette, 6 );
+  IndexSurface surface;
 
-    // Next pixel row
-    x = 0;
-    ++y;
+  if( !DecodeUltShapes( surface ) || writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
   }
 
-  infile.close();
+  if( !DecodeMapChars( surface ) || writer.AddSheet( "CHAR", surface, CHAR_WIDTH, CHAR_HEIGHT ) == 0 )
+  {
+    return false;
+  }
 
-  save_pcx( "ultshapes.pcx", backBuffer, nullptr );
+  if( !SaveDatafile( filename, writer, compress ) )
+  {
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
 
-  destroy_bitmap( backBuffer );
+  return true;
+}
 
-  // ---------------------
-  // Process MAPCHARS
-  // ---------------------
 
-  backBuffer = create_bitmap( MAPCHARS_BUFFER_WIDTH, MAPCHARS_BUFFER_HEIGHT );
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
 
-  infile.open( "MAPCHARS", std::ios::in | std::ios::binary );
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
 
-  if( !infile.is_open() )
+  if( HasVerifyOption( argc, argv ) )
   {
+    return Verify() ? 0 : 1;
+  }
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--ntsc" ) == 0 )
+    {
+      // Written straight to PNG, so this runs headless too
+      return WriteNtsc( argc, argv ) ? 0 : -1;
+    }
+  }
+
+  for( int32_t i = 1; i + 2 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--encode-tiles" ) == 0 )
+    {
+      return EncodeTiles( argv[i + 1], argv[i + 2] ) ? 0 : -1;
+    }
+  }
+
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
+
+  if( allegro_init() != 0 )
+  {
+    allegro_message( "Allegro initialization failed" );
+    return -1;
+  }
+
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
+
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
+  }
+
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
     return -1;
   }
 
-  numBytesToRead = CHARS_PER_ROW_MAPCHARS * BYTES_PER_CHAR;
+  int32_t colorTable[6];
+  MakeColorTable( apple2Palette, 6, colorTable );
 
-  x = 0;
-  y = 0;
+  IndexSurface surface;
 
-  currentBytes = 0;
+  // ---------------------
+  // Process ULTSHAPES
+  // ---------------------
 
-  while( currentBytes < numBytesToRead )
+  if( !DecodeUltShapes( surface ) )
   {
-    uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
+    return -1;
+  }
 
-    // Place the first 7 pixels
-    const bool colorGroup{ ( ( tileData >> 7 ) & 0x1 ) == 0 };
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, colorTable ) };
 
-    // Remove the colorGroup bit
-    tileData &= 0x7f;
+  SavePcx( "ultshapes.pcx", backBuffer );
 
-    Draw( backBuffer, x++, y, ( tileData >> 0 ) & 0x3, false, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 1 ) & 0x3, ( tileData >> 0 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 2 ) & 0x3, ( tileData >> 1 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 3 ) & 0x3, ( tileData >> 2 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 4 ) & 0x3, ( tileData >> 3 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 5 ) & 0x3, ( tileData >> 4 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 6 ) & 0x3, ( tileData >> 5 ) & 0x1, colorGroup, false );
+  destroy_bitmap( backBuffer );
 
-    if( MAPCHARS_BUFFER_WIDTH == x )
-    {
-      // Wrap to the next line
-      x = 0;
-      ++y;
-    }
+  // ---------------------
+  // Process MAPCHARS
+  // ---------------------
 
-    ++currentBytes;
+  if( !DecodeMapChars( surface ) )
+  {
+    return -1;
   }
 
-  infile.close();
+  backBuffer = CreateBitmapFromSurface( surface, colorTable );
 
-  save_pcx( "mapchars.pcx", backBuffer, nullptr );
+  SavePcx( "mapchars.pcx", backBuffer );
 
   destroy_bitmap( backBuffer );
 
+  // --------------------
+  // Full-screen pictures
+  // --------------------
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface ) )
+    {
+      return -1;
+    }
+
+    backBuffer = CreateBitmapFromSurface( surface, colorTable );
+
+    SavePcx( ( std::string( argv[i + 1] ) + ".pcx" ).c_str(), backBuffer );
+
+    destroy_bitmap( backBuffer );
+  }
+
   return 0;
 }
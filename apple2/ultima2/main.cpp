@@ -2,6 +2,16 @@
 // This program requires the SHAPES AND HTXT files from the .dsk image
 // Apple II disk and file archive manager: https://a2ciderpress.com/
 
+// Run with --screen FILE to also decode a full-screen hi-res picture, such as a title or intro screen, to FILE.pcx.
+// --screen can be given more than once.
+
+// Run with --ntsc to render through a simulation of the NTSC composite signal instead of the flat colors, with the
+// color fringing and blending of a real monitor. That writes true color tiles_ntsc.png and text_ntsc.png files (and
+// FILE_ntsc.png for --screen) without opening a window.
+
+// Takes the options every ripper does (see ripper_options.h): --verify against tiles.png and text.png, --pack and
+// --datafile with the tiles and text characters, --stats and --force-isa.
+
 // Resources:
 // https://u4a2.com/
 // https://en.wikipedia.org/wiki/Apple_II_graphics
@@ -9,16 +19,27 @@
 // https://www.xtof.info/hires-graphics-apple-ii.html
 // Gil Megidish's pixel rendering algorithm
 
-
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
-#include <iostream>
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_writer.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/apple2_decode.h"
+#include "../../util/tile_decode/apple2_ntsc.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/apple2_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
 
 #define TILE_WIDTH    14
 #define TILE_HEIGHT   16
@@ -45,158 +66,314 @@
 #define EXPORT_VERTICAL_STRIP 0
 
 
-enum colorType
-{
-  Green,
-  Orange,
-  Violet,
-  Blue,
-  White,
-  Black
-};
-
-int colorTable[6];
-
-// From Gil Megidish:
-// The algorithm is this: for any given pixel at x, if x is 1 and any of( x - 1 ), ( x + 1 ) are 1s, then pixel at x is
-// white. if x is 0 and the two adjacent are also zero, then pixel at x is black. Now it's tricky. If x is 1 and both
-// adjacent pixels are 0, then pixel at x is green/purple (if odd or even), there's also blue / orange for second
-// palette. If x is 0, and both adjacent are 1, then the previous algorithm also catches. Sum it up, color at pixel x
-// depends on the two adjacent pixels, the MSB of the byte being rendered, and if this pixel is odd / even.
-
-void Draw( BITMAP* buffer, uint32_t x, uint32_t y, uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd )
+// Decodes a file made of 128 byte strides, where each stride holds 1 row of every tile. Each tile row is bytesPerRow
+// bytes that render as one span.
+bool DecodeStrides( const char* filename, int32_t numTiles, int32_t tileWidth, int32_t tileHeight, int32_t bytesPerRow,
+                    IndexSurface& surface, RgbSurface* ntsc )
 {
-  colorType color{ Black };
+  INSTRUMENT_BEGIN_FILE( filename );
 
-  if( ( value & 0x1 ) == 1 )
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    if( lastBitOn || ( ( value >> 1 ) & 0x1 ) )
-    {
-      color = White;
-    }
-    else if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    return false;
+  }
+
+  // Anything missing from the end of the file reads as EOF, like infile.get()
+  const size_t numBytesToRead{ static_cast<size_t>( numTiles ) * tileHeight * bytesPerRow };
+  fileData.resize( numBytesToRead, 0xff );
+
+  surface.Create( numTiles * tileWidth, tileHeight );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( numTiles * tileWidth, tileHeight );
+  }
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  const uint8_t* tileData{ fileData.data() };
+  for( int32_t y = 0; y < tileHeight; ++y )
+  {
+    uint8_t* row{ surface.Row( y ) };
+    for( int32_t i = 0; i < numTiles; ++i )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
-      else
+      DecodeAppleSpan( tileData, bytesPerRow, false, false, row + i * tileWidth );
+
+      if( ntsc != nullptr )
       {
-        color = firstColorGroup ? Violet : Blue;
+        DecodeAppleSpanNtsc( tileData, bytesPerRow, false, ntsc->Row( y ) + i * tileWidth );
       }
+
+      tileData += bytesPerRow;
+    }
+  }
+
+  return true;
+}
+
+
+bool DecodeTiles( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  return DecodeStrides( "SHAPES", TILES_PER_ROW, TILE_WIDTH, TILE_HEIGHT, TILE_BYTES_PER_ROW, surface, ntsc );
+}
+
+
+bool DecodeText( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( "HTXT" );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( "HTXT", fileData ) )
+  {
+    return false;
+  }
+
+  // Anything missing from the end of the file reads as EOF, like infile.get()
+  fileData.resize( NUM_CHARS * CHAR_HEIGHT * CHAR_BYTES_PER_ROW, 0xff );
+
+  // The characters are stored one after the other, so each byte is simply the next row of a vertical strip
+  surface.Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  }
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  for( int32_t y = 0; y < CHAR_BUFFER_HEIGHT; ++y )
+  {
+    DecodeAppleSpan( &fileData[y * CHAR_BYTES_PER_ROW], CHAR_BYTES_PER_ROW, false, false, surface.Row( y ) );
+
+    if( ntsc != nullptr )
+    {
+      DecodeAppleSpanNtsc( &fileData[y * CHAR_BYTES_PER_ROW], CHAR_BYTES_PER_ROW, false, ntsc->Row( y ) );
     }
   }
+
+  return true;
+}
+
+
+// A whole hi-res page, as saved from $2000
+bool DecodeScreen( const char* filename, IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> picture;
+  if( !ReadFileBytes( filename, picture ) )
+  {
+    printf( "Can't open %s\n", filename );
+    return false;
+  }
+
+  if( !DecodeAppleScreen( picture.data(), picture.size(), surface, 0 ) )
+  {
+    printf( "%s is %d bytes, too short for a hi-res screen\n", filename, static_cast<int32_t>( picture.size() ) );
+    return false;
+  }
+
+  return ntsc == nullptr || DecodeAppleScreenNtsc( picture.data(), picture.size(), *ntsc, 0 );
+}
+
+
+bool Verify()
+{
+  bool passed{ VerifyAppleKernels() };
+  passed &= VerifyAppleScreenDecoder();
+  passed &= VerifyAppleNtsc();
+  passed &= VerifyDispatchKernels();
+
+  IndexSurface surface;
+
+  if( DecodeTiles( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "SHAPES", surface, apple2Palette, 6, "tiles.png", TILE_WIDTH, TILE_HEIGHT );
+    passed &= VerifySheetPack( "SHAPES", surface, apple2Palette, 6, TILE_WIDTH, TILE_HEIGHT );
+  }
   else
   {
-    if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    printf( "FAIL can't open SHAPES\n" );
+    passed = false;
+  }
+
+  if( DecodeText( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "HTXT", surface, apple2Palette, 6, "text.png", CHAR_WIDTH, CHAR_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open HTXT\n" );
+    passed = false;
+  }
+
+  return passed;
+}
+
+
+// The sheets (and --screen pictures) of a normal run, through the NTSC simulation
+bool WriteNtsc( int32_t argc, char* argv[] )
+{
+  IndexSurface surface;
+  RgbSurface ntsc;
+
+  if( !DecodeTiles( surface, &ntsc ) || !WritePngRgb( "tiles_ntsc.png", ntsc ) )
+  {
+    return false;
+  }
+
+  if( !DecodeText( surface, &ntsc ) || !WritePngRgb( "text_ntsc.png", ntsc ) )
+  {
+    return false;
+  }
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
     {
-      color = Black;
+      continue;
     }
-    if( lastBitOn && ( ( value >> 1 ) & 0x1 ) )
+
+    if( !DecodeScreen( argv[i + 1], surface, &ntsc ) ||
+        !WritePngRgb( ( std::string( argv[i + 1] ) + "_ntsc.png" ).c_str(), ntsc ) )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Violet : Blue;
-      }
-      else
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
+      return false;
     }
   }
 
-  putpixel( buffer, x, y, colorTable[color] );
+  return true;
 }
 
 
-int32_t main()
+// The tiles, then the characters, packed from the sheets of a normal run
+bool WritePack( const char* filename, bool compress )
 {
-  if( allegro_init() != 0 )
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( apple2Palette, 6 ) };
+  IndexSurface surface;
+
+  if( !DecodeTiles( surface ) || writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
   {
-    allegro_message( "Allegro initialization failed" );
-    return -1;
+    return false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  if( !DecodeText( surface ) || writer.AddSheet( surface, CHAR_WIDTH, CHAR_HEIGHT, palette ) < 0 )
   {
-    depth = 16;
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  if( !writer.Save( filename, compress ) )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
   }
 
-  colorTable[Green]  = makecol( 0x25, 0xBE, 0x00 );
-  colorTable[Orange] = makecol( 0xE5, 0x50, 0x00 );
-  colorTable[Violet] = makecol( 0x9E, 0x00, 0xFF );
-  colorTable[Blue]   = makecol( 0x00, 0x7E, 0xFF );
-  colorTable[White]  = makecol( 0xFF, 0xFF, 0xFF );
-  colorTable[Black]  = makecol( 0x00, 0x00, 0x00 );
+  return true;
+}
 
-  // ---------------------
-  // Process tile graphics
-  // ---------------------
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
+// The tiles and characters of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", apple2Palette, 6 );
+  IndexSurface surface;
+
+  if( !DecodeTiles( surface ) || writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !DecodeText( surface ) || writer.AddSheet( "CHAR", surface, CHAR_WIDTH, CHAR_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !SaveDatafile( filename, writer, compress ) )
+  {
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
+
+  return true;
+}
 
-  std::ifstream infile;
-  infile.open( "SHAPES", std::ios::in | std::ios::binary );
 
-  if( !infile.is_open() )
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  if( !ApplyForceIsaOption( argc, argv ) )
   {
     return -1;
   }
 
-  uint32_t numBytesToRead{ NUM_TILES * TILE_HEIGHT * TILE_BYTES_PER_ROW };
+  if( HasVerifyOption( argc, argv ) )
+  {
+    return Verify() ? 0 : 1;
+  }
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--ntsc" ) == 0 )
+    {
+      // Written straight to PNG, so this runs headless too
+      return WriteNtsc( argc, argv ) ? 0 : -1;
+    }
+  }
+
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
 
-  uint32_t x{ 0 };
-  uint32_t y{ 0 };
+  if( allegro_init() != 0 )
+  {
+    allegro_message( "Allegro initialization failed" );
+    return -1;
+  }
 
-  uint32_t currentBytes{ 0 };
-  uint32_t lineNum{ 0 };
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
 
-  while( currentBytes < numBytesToRead )
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
   {
-    const uint8_t tileData1{ static_cast<uint8_t>( infile.get() ) };
-    const uint8_t tileData2{ static_cast<uint8_t>( infile.get() ) };
+    depth = 16;
+  }
 
-    const uint16_t tileData{ static_cast<uint16_t>( ( ( tileData2 & 0x7f ) << 7 ) | ( tileData1 & 0x7f ) ) };
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
 
-    // Place the first 7 pixels
-    const bool colorGroup1{ ( ( tileData1 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 0 ) & 0x3, false, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 1 ) & 0x3, ( tileData >> 0 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 2 ) & 0x3, ( tileData >> 1 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 3 ) & 0x3, ( tileData >> 2 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 4 ) & 0x3, ( tileData >> 3 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 5 ) & 0x3, ( tileData >> 4 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 6 ) & 0x3, ( tileData >> 5 ) & 0x1, colorGroup1, false );
+  int32_t colorTable[6];
+  MakeColorTable( apple2Palette, 6, colorTable );
 
-    // Place the next 7 pixels
-    const bool colorGroup2{ ( ( tileData2 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 7  ) & 0x3, ( tileData >> 6 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 8  ) & 0x3, ( tileData >> 7 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 9  ) & 0x3, ( tileData >> 8 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 10 ) & 0x3, ( tileData >> 9 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 11 ) & 0x3, ( tileData >> 10 ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 12 ) & 0x3, ( tileData >> 11 ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 13 ) & 0x3, ( tileData >> 12 ) & 0x1, colorGroup2, true );
+  IndexSurface surface;
 
-    if( x >= TILE_BUFFER_WIDTH )
-    {
-      // Wrap to next line
-      x = 0;
-      y += 1;
-    }
+  // ---------------------
+  // Process tile graphics
+  // ---------------------
 
-    currentBytes += TILE_BYTES_PER_ROW;
+  if( !DecodeTiles( surface ) )
+  {
+    return -1;
   }
 
-  infile.close();
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, colorTable ) };
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -216,11 +393,11 @@ int32_t main()
     }
   }
 
-  save_pcx( "tiles.pcx", backBuffer2, nullptr );
+  SavePcx( "tiles.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "tiles.pcx", backBuffer, nullptr );
+  SavePcx( "tiles.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
@@ -229,54 +406,40 @@ int32_t main()
   // Process text graphics
   // ---------------------
 
-  backBuffer = create_bitmap( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
-
-  infile.open( "HTXT", std::ios::in | std::ios::binary );
-
-  if( !infile.is_open() )
+  if( !DecodeText( surface ) )
   {
     return -1;
   }
 
-  numBytesToRead = NUM_CHARS * CHAR_HEIGHT * TILE_BYTES_PER_ROW;
+  backBuffer = CreateBitmapFromSurface( surface, colorTable );
 
-  x = 0;
-  y = 0;
+  // Exported as a vertical strip by default
+  SavePcx( "text.pcx", backBuffer );
 
-  currentBytes = 0;
-  lineNum = 0;
+  destroy_bitmap( backBuffer );
 
-  while( currentBytes < numBytesToRead )
-  {
-    uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
+  // --------------------
+  // Full-screen pictures
+  // --------------------
 
-    // Place the 7 pixels
-    const bool colorGroup{ ( ( tileData >> 7 ) & 0x1 ) == 0 };
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
 
-    // Remove the color group bit
-    tileData &= 0x7f;
+    if( !DecodeScreen( argv[i + 1], surface ) )
+    {
+      return -1;
+    }
 
-    Draw( backBuffer, x++, y, ( ( tileData >> 0 ) & 0x3 ), false, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 1 ) & 0x3 ), ( tileData >> 0 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 2 ) & 0x3 ), ( tileData >> 1 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 3 ) & 0x3 ), ( tileData >> 2 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 4 ) & 0x3 ), ( tileData >> 3 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 5 ) & 0x3 ), ( tileData >> 4 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 6 ) & 0x3 ), ( tileData >> 5 ) & 0x1, colorGroup, false );
+    backBuffer = CreateBitmapFromSurface( surface, colorTable );
 
-    // Wrap to next line
-    x = 0;
-    ++y;
+    SavePcx( ( std::string( argv[i + 1] ) + ".pcx" ).c_str(), backBuffer );
 
-    currentBytes += CHAR_BYTES_PER_ROW;
+    destroy_bitmap( backBuffer );
   }
 
-  infile.close();
-
-  // Exported as a vertical strip by default
-  save_pcx( "text.pcx", backBuffer, nullptr );
-
-  destroy_bitmap( backBuffer );
-
   return 0;
 }
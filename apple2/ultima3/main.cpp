@@ -5,6 +5,20 @@
 // of text data (1 byte for each character) for each of the 128 characters.
 // Apple II disk and file archive manager: https://a2ciderpress.com/
 
+// Run with --screen FILE to also decode a full-screen hi-res picture, such as a title or intro screen, to FILE.pcx.
+// --screen can be given more than once.
+
+// Run with --ntsc to render through a simulation of the NTSC composite signal instead of the flat colors, with the
+// color fringing and blending of a real monitor. That writes true color tiles_ntsc.png and text_ntsc.png files (and
+// FILE_ntsc.png for --screen) without opening a window.
+
+// Run with --encode-tiles FILE.png DIR to go the other way: an edited copy of tiles.pcx (saved as PNG) is encoded over
+// SHAPES and written to DIR, in the same 128 byte strides, with the bits of every byte picked so the tiles render as
+// close to it as possible. Rows that weren't edited keep their bytes.
+
+// Takes the options every ripper does (see ripper_options.h): --verify against tiles.png and text.png, --pack and
+// --datafile with the tiles and text characters, --stats and --force-isa.
+
 // Resources:
 // https://u4a2.com/
 // https://en.wikipedia.org/wiki/Apple_II_graphics
@@ -15,11 +29,28 @@
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_reader.h"
+#include "../../util/png/png_writer.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/apple2_decode.h"
+#include "../../util/tile_decode/apple2_encode.h"
+#include "../../util/tile_decode/apple2_ntsc.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/apple2_encode_verify.h"
+#include "../../util/verify/apple2_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
+
 #define TILE_WIDTH    14
 #define TILE_HEIGHT   16
 #define NUM_TILES     64
@@ -43,158 +74,425 @@
 #define EXPORT_VERTICAL_STRIP 0
 
 
-enum colorType
+// Decodes data made of 128 byte strides, where each stride holds 1 row of every tile. Each tile row is bytesPerRow
+// bytes that render as one span.
+void DecodeStrideBytes( const std::vector<uint8_t>& fileData, int32_t numTiles, int32_t tileWidth, int32_t tileHeight,
+                        int32_t bytesPerRow, IndexSurface& surface, RgbSurface* ntsc )
 {
-  Green,
-  Orange,
-  Violet,
-  Blue,
-  White,
-  Black
-};
+  surface.Create( numTiles * tileWidth, tileHeight );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( numTiles * tileWidth, tileHeight );
+  }
 
-int colorTable[6];
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
 
+  const uint8_t* tileData{ fileData.data() };
+  for( int32_t y = 0; y < tileHeight; ++y )
+  {
+    uint8_t* row{ surface.Row( y ) };
+    for( int32_t i = 0; i < numTiles; ++i )
+    {
+      DecodeAppleSpan( tileData, bytesPerRow, true, false, row + i * tileWidth );
 
-// From Gil Megidish:
-// The algorithm is this: for any given pixel at x, if x is 1 and any of( x - 1 ), ( x + 1 ) are 1s, then pixel at x is
-// white. if x is 0 and the two adjacent are also zero, then pixel at x is black. Now it's tricky. If x is 1 and both
-// adjacent pixels are 0, then pixel at x is green/purple (if odd or even), there's also blue / orange for second
-// palette. If x is 0, and both adjacent are 1, then the previous algorithm also catches. Sum it up, color at pixel x
-// depends on the two adjacent pixels, the MSB of the byte being rendered, and if this pixel is odd / even.
+      if( ntsc != nullptr )
+      {
+        DecodeAppleSpanNtsc( tileData, bytesPerRow, true, ntsc->Row( y ) + i * tileWidth );
+      }
 
-void Draw( BITMAP* buffer, uint32_t x, uint32_t y, uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd )
+      tileData += bytesPerRow;
+    }
+  }
+}
+
+
+bool DecodeStrides( const char* filename, int32_t numTiles, int32_t tileWidth, int32_t tileHeight, int32_t bytesPerRow,
+                    IndexSurface& surface, RgbSurface* ntsc )
 {
-  colorType color{ Black };
+  INSTRUMENT_BEGIN_FILE( filename );
 
-  if( ( value & 0x1 ) == 1 )
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    if( lastBitOn || ( ( value >> 1 ) & 0x1 ) )
+    return false;
+  }
+
+  // Anything missing from the end of the file reads as EOF, like infile.get()
+  const size_t numBytesToRead{ static_cast<size_t>( numTiles ) * tileHeight * bytesPerRow };
+  fileData.resize( numBytesToRead, 0xff );
+
+  DecodeStrideBytes( fileData, numTiles, tileWidth, tileHeight, bytesPerRow, surface, ntsc );
+  return true;
+}
+
+
+// The reverse of DecodeStrideBytes(), for a sheet laid out like the one it decodes. fileData is the file to patch,
+// where only the rows that render differently change and any bytes past the strides are kept, or empty to encode
+// every tile afresh. Returns how far the tiles are from the sheet (0 if they match exactly), or -1 if the sheet is too
+// small.
+int64_t EncodeStrideBytes( const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize,
+                           int32_t numTiles, int32_t tileWidth, int32_t tileHeight, int32_t bytesPerRow,
+                           std::vector<uint8_t>& fileData )
+{
+  // The encoder takes each tile's rows in turn, and the strides hold each row's tiles in turn
+  const size_t numBytes{ static_cast<size_t>( numTiles ) * tileHeight * bytesPerRow };
+  std::vector<uint8_t> tiles;
+  if( !fileData.empty() )
+  {
+    if( fileData.size() < numBytes )
     {
-      color = White;
+      fileData.resize( numBytes, 0xff );
     }
-    else if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+
+    tiles.resize( numBytes );
+    for( int32_t i = 0; i < numTiles; ++i )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
-      else
+      for( int32_t y = 0; y < tileHeight; ++y )
       {
-        color = firstColorGroup ? Violet : Blue;
+        memcpy( &tiles[( static_cast<size_t>( i ) * tileHeight + y ) * bytesPerRow],
+                &fileData[( static_cast<size_t>( y ) * numTiles + i ) * bytesPerRow], bytesPerRow );
       }
     }
   }
-  else
+
+  const int64_t difference{ EncodeAppleTiles( sheet, palette, paletteSize, numTiles, numTiles, tileWidth, tileHeight,
+                                              true, tiles, 0 ) };
+  if( difference < 0 )
+  {
+    return difference;
+  }
+
+  if( fileData.empty() )
+  {
+    fileData.resize( numBytes );
+  }
+
+  for( int32_t i = 0; i < numTiles; ++i )
   {
-    if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    for( int32_t y = 0; y < tileHeight; ++y )
     {
-      color = Black;
+      memcpy( &fileData[( static_cast<size_t>( y ) * numTiles + i ) * bytesPerRow],
+              &tiles[( static_cast<size_t>( i ) * tileHeight + y ) * bytesPerRow], bytesPerRow );
     }
-    if( lastBitOn && ( ( value >> 1 ) & 0x1 ) )
+  }
+
+  return difference;
+}
+
+
+bool DecodeTiles( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  return DecodeStrides( "SHAPES", TILES_PER_ROW, TILE_WIDTH, TILE_HEIGHT, TILE_BYTES_PER_ROW, surface, ntsc );
+}
+
+
+bool DecodeText( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  return DecodeStrides( "TEXT", CHARS_PER_ROW, CHAR_WIDTH, CHAR_HEIGHT, 1, surface, ntsc );
+}
+
+
+// A whole hi-res page, as saved from $2000
+bool DecodeScreen( const char* filename, IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> picture;
+  if( !ReadFileBytes( filename, picture ) )
+  {
+    printf( "Can't open %s\n", filename );
+    return false;
+  }
+
+  if( !DecodeAppleScreen( picture.data(), picture.size(), surface, 0 ) )
+  {
+    printf( "%s is %d bytes, too short for a hi-res screen\n", filename, static_cast<int32_t>( picture.size() ) );
+    return false;
+  }
+
+  return ntsc == nullptr || DecodeAppleScreenNtsc( picture.data(), picture.size(), *ntsc, 0 );
+}
+
+
+bool Verify()
+{
+  bool passed{ VerifyAppleKernels() };
+  passed &= VerifyAppleEncoder();
+  passed &= VerifyAppleScreenDecoder();
+  passed &= VerifyAppleNtsc();
+  passed &= VerifyDispatchKernels();
+
+  IndexSurface surface;
+
+  if( DecodeTiles( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "SHAPES", surface, apple2Palette, 6, "tiles.png", TILE_WIDTH, TILE_HEIGHT );
+    passed &= VerifySheetPack( "SHAPES", surface, apple2Palette, 6, TILE_WIDTH, TILE_HEIGHT );
+
+    // The decoded tiles have to encode back to bytes that decode the same
+    std::vector<uint8_t> shapes;
+    IndexSurface reencoded;
+    const int64_t difference{ EncodeStrideBytes( surface, apple2Palette, 6, TILES_PER_ROW, TILE_WIDTH, TILE_HEIGHT,
+                                                 TILE_BYTES_PER_ROW, shapes ) };
+    DecodeStrideBytes( shapes, TILES_PER_ROW, TILE_WIDTH, TILE_HEIGHT, TILE_BYTES_PER_ROW, reencoded, nullptr );
+
+    if( difference == 0 && reencoded.pixels == surface.pixels )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Violet : Blue;
-      }
-      else
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
+      printf( "OK   SHAPES re-encodes to the same tiles\n" );
+    }
+    else
+    {
+      printf( "FAIL SHAPES doesn't re-encode to the same tiles\n" );
+      passed = false;
+    }
+
+    // Encoded over the file itself, the same tiles have to give back the file byte for byte
+    std::vector<uint8_t> original;
+    ReadFileBytes( "SHAPES", original );
+    shapes = original;
+
+    if( EncodeStrideBytes( surface, apple2Palette, 6, TILES_PER_ROW, TILE_WIDTH, TILE_HEIGHT, TILE_BYTES_PER_ROW,
+                           shapes ) == 0 && shapes == original )
+    {
+      printf( "OK   SHAPES encodes over itself to the same %d bytes\n", static_cast<int32_t>( original.size() ) );
     }
+    else
+    {
+      printf( "FAIL SHAPES doesn't encode over itself to the same bytes\n" );
+      passed = false;
+    }
+  }
+  else
+  {
+    printf( "FAIL can't open SHAPES\n" );
+    passed = false;
   }
 
-  putpixel( buffer, x, y, colorTable[color] );
+  if( DecodeText( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "TEXT", surface, apple2Palette, 6, "text.png", CHAR_WIDTH, CHAR_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open TEXT\n" );
+    passed = false;
+  }
+
+  return passed;
 }
 
 
-int32_t main()
+// Headless: reads an edited tile sheet, encodes it over SHAPES and writes the result into directory
+bool EncodeTiles( const char* pngFilename, const char* directory )
 {
-  if( allegro_init() != 0 )
+  PngImage sheet;
+  const char* error{ nullptr };
+  if( !ReadPng( pngFilename, sheet, error ) )
   {
-    allegro_message( "Allegro initialization failed" );
-    return -1;
+    printf( "%s: %s\n", pngFilename, error );
+    return false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  std::vector<uint8_t> shapes;
+  if( !ReadFileBytes( "SHAPES", shapes ) || shapes.empty() )
   {
-    depth = 16;
+    printf( "Can't open SHAPES to encode the tiles over\n" );
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  const int64_t difference{ EncodeStrideBytes( sheet.indices, sheet.palette.data(),
+                                               static_cast<int32_t>( sheet.palette.size() ), TILES_PER_ROW,
+                                               TILE_WIDTH, TILE_HEIGHT, TILE_BYTES_PER_ROW, shapes ) };
+  if( difference < 0 )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    printf( "%s: needs to be at least %dx%d\n", pngFilename, TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+    return false;
   }
 
-  colorTable[Green] = makecol( 0x25, 0xBE, 0x00 );
-  colorTable[Orange] = makecol( 0xE5, 0x50, 0x00 );
-  colorTable[Violet] = makecol( 0x9E, 0x00, 0xFF );
-  colorTable[Blue] = makecol( 0x00, 0x7E, 0xFF );
-  colorTable[White] = makecol( 0xFF, 0xFF, 0xFF );
-  colorTable[Black] = makecol( 0x00, 0x00, 0x00 );
+  const std::string filename{ std::string( directory ) + "/SHAPES" };
+  if( !WriteFileBytes( filename.c_str(), shapes ) )
+  {
+    printf( "Can't write %s\n", filename.c_str() );
+    return false;
+  }
 
-  // ---------------------
-  // Process tile graphics
-  // ---------------------
+  printf( "%s: wrote %s, squared color difference %lld\n", pngFilename, filename.c_str(),
+          static_cast<long long>( difference ) );
+  return true;
+}
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
 
-  std::ifstream infile;
-  infile.open( "SHAPES", std::ios::in | std::ios::binary );
+// The sheets (and --screen pictures) of a normal run, through the NTSC simulation
+bool WriteNtsc( int32_t argc, char* argv[] )
+{
+  IndexSurface surface;
+  RgbSurface ntsc;
 
-  if( !infile.is_open() )
+  if( !DecodeTiles( surface, &ntsc ) || !WritePngRgb( "tiles_ntsc.png", ntsc ) )
   {
-    return -1;
+    return false;
+  }
+
+  if( !DecodeText( surface, &ntsc ) || !WritePngRgb( "text_ntsc.png", ntsc ) )
+  {
+    return false;
   }
 
-  uint32_t numBytesToRead{ TILES_PER_ROW * TILE_HEIGHT * TILE_BYTES_PER_ROW };
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface, &ntsc ) ||
+        !WritePngRgb( ( std::string( argv[i + 1] ) + "_ntsc.png" ).c_str(), ntsc ) )
+    {
+      return false;
+    }
+  }
 
-  uint32_t x{ 0 };
-  uint32_t y{ 0 };
+  return true;
+}
+
+
+// The tiles, then the characters, packed from the sheets of a normal run
+bool WritePack( const char* filename, bool compress )
+{
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( apple2Palette, 6 ) };
+  IndexSurface surface;
+
+  if( !DecodeTiles( surface ) || writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
+
+  if( !DecodeText( surface ) || writer.AddSheet( surface, CHAR_WIDTH, CHAR_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
+
+  if( !writer.Save( filename, compress ) )
+  {
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
+  }
+
+  return true;
+}
+
+
+// The tiles and characters of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", apple2Palette, 6 );
+  IndexSurface surface;
+
+  if( !DecodeTiles( surface ) || writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
+  }
 
-  uint32_t currentBytes{ 0 };
-  uint32_t lineNum{ 0 };
+  if( !DecodeText( surface ) || writer.AddSheet( "CHAR", surface, CHAR_WIDTH, CHAR_HEIGHT ) == 0 )
+  {
+    return false;
+  }
 
-  while( currentBytes < numBytesToRead )
+  if( !SaveDatafile( filename, writer, compress ) )
   {
-    const uint8_t tileData1{ static_cast<uint8_t>( infile.get() ) };
-    const uint8_t tileData2{ static_cast<uint8_t>( infile.get() ) };
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
+
+  return true;
+}
 
-    currentBytes += TILE_BYTES_PER_ROW;
 
-    const uint16_t tileData{ static_cast<uint16_t>( ( ( tileData2 & 0x7f ) << 7 ) | ( tileData1 & 0x7f ) ) };
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
 
-    // Place the first 7 pixels
-    const bool colorGroup1{ ( ( tileData1 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 0 ) & 0x3, false, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 1 ) & 0x3, ( tileData >> 0 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 2 ) & 0x3, ( tileData >> 1 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 3 ) & 0x3, ( tileData >> 2 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 4 ) & 0x3, ( tileData >> 3 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 5 ) & 0x3, ( tileData >> 4 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 6 ) & 0x3, ( tileData >> 5 ) & 0x1, colorGroup1, true );
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
 
-    const bool colorGroup2{ ( ( tileData2 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 7 )  & 0x3, ( tileData >> 6 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 8 )  & 0x3, ( tileData >> 7 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 9 )  & 0x3, ( tileData >> 8 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 10 ) & 0x3, ( tileData >> 9 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 11 ) & 0x3, ( tileData >> 10 ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 12 ) & 0x3, ( tileData >> 11 ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 13 ) & 0x3, ( tileData >> 12 ) & 0x1, colorGroup2, false );
+  if( HasVerifyOption( argc, argv ) )
+  {
+    return Verify() ? 0 : 1;
+  }
 
-    if( x >= TILE_BUFFER_WIDTH )
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--ntsc" ) == 0 )
     {
-      // Wrap to next line
-      x = 0;
-      y += 1;
+      // Written straight to PNG, so this runs headless too
+      return WriteNtsc( argc, argv ) ? 0 : -1;
     }
   }
 
-  infile.close();
+  for( int32_t i = 1; i + 2 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--encode-tiles" ) == 0 )
+    {
+      return EncodeTiles( argv[i + 1], argv[i + 2] ) ? 0 : -1;
+    }
+  }
+
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
+
+  if( allegro_init() != 0 )
+  {
+    allegro_message( "Allegro initialization failed" );
+    return -1;
+  }
+
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
+
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
+  }
+
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
+
+  int32_t colorTable[6];
+  MakeColorTable( apple2Palette, 6, colorTable );
+
+  IndexSurface surface;
+
+  // ---------------------
+  // Process tile graphics
+  // ---------------------
+
+  if( !DecodeTiles( surface ) )
+  {
+    return -1;
+  }
+
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, colorTable ) };
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -214,11 +512,11 @@ int32_t main()
     }
   }
 
-  save_pcx( "tiles.pcx", backBuffer2, nullptr );
+  SavePcx( "tiles.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "tiles.pcx", backBuffer, nullptr );
+  SavePcx( "tiles.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
@@ -227,52 +525,12 @@ int32_t main()
   // Process text graphics
   // ---------------------
 
-  backBuffer = create_bitmap( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
-
-  infile.open( "TEXT", std::ios::in | std::ios::binary );
-
-  if( !infile.is_open() )
+  if( !DecodeText( surface ) )
   {
     return -1;
   }
 
-  numBytesToRead = CHARS_PER_ROW * CHAR_HEIGHT;
-
-  x = 0;
-  y = 0;
-
-  currentBytes = 0;
-  lineNum = 0;
-
-  while( currentBytes < numBytesToRead )
-  {
-    uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-
-    // Remove the color group bit
-    const bool colorGroup{ ( ( tileData >> 7 ) & 0x1 ) == 0 };
-
-    tileData &= 0x7f;
-
-    // Place the 7 pixels
-    Draw( backBuffer, x++, y, ( tileData >> 0 ) & 0x3, false, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 1 ) & 0x3, ( tileData >> 0 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 2 ) & 0x3, ( tileData >> 1 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 3 ) & 0x3, ( tileData >> 2 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 4 ) & 0x3, ( tileData >> 3 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( tileData >> 5 ) & 0x3, ( tileData >> 4 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( tileData >> 6 ) & 0x3, ( tileData >> 5 ) & 0x1, colorGroup, true );
-
-    if( x >= CHAR_BUFFER_WIDTH )
-    {
-      // Wrap to next line
-      x = 0;
-      y += 1;
-    }
-
-    ++currentBytes;
-  }
-
-  infile.close();
+  backBuffer = CreateBitmapFromSurface( surface, colorTable );
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -292,14 +550,37 @@ int32_t main()
     }
   }
 
-  save_pcx( "text.pcx", backBuffer2, nullptr );
+  SavePcx( "text.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "text.pcx", backBuffer, nullptr );
+  SavePcx( "text.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
 
+  // --------------------
+  // Full-screen pictures
+  // --------------------
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface ) )
+    {
+      return -1;
+    }
+
+    backBuffer = CreateBitmapFromSurface( surface, colorTable );
+
+    SavePcx( ( std::string( argv[i + 1] ) + ".pcx" ).c_str(), backBuffer );
+
+    destroy_bitmap( backBuffer );
+  }
+
   return 0;
 }
@@ -2,6 +2,21 @@
 // This program requires the SHP0 and SHP1 files extracted from the Apple II Ultima IV Boot.dsk
 // Apple II disk and file archive manager: https://a2ciderpress.com/
 
+// Run with --screen FILE to also decode a full-screen hi-res picture, such as a title or intro screen, to FILE.pcx.
+// --screen can be given more than once.
+
+// Run with --ntsc to render through a simulation of the NTSC composite signal instead of the flat colors, with the
+// color fringing and blending of a real monitor. That writes true color tiles_ntsc.png and text_ntsc.png files (and
+// FILE_ntsc.png for --screen) without opening a window.
+
+// Run with --encode-tiles FILE.png DIR to go the other way: an edited copy of tiles.pcx (saved as PNG) is encoded over
+// SHP0 and SHP1 and written to DIR, with the bits of every byte picked so the tiles render as close to it as possible.
+// Rows that weren't edited keep their bytes.
+
+// Takes the options every ripper does (see ripper_options.h): --verify against tiles.png and text.png, --pack and
+// --datafile with the tiles and text characters, --stats and --force-isa. --watch patches the pack whenever SHP0,
+// SHP1 or HTXT is saved.
+
 // Resources:
 // https://u4a2.com/
 // https://en.wikipedia.org/wiki/Apple_II_graphics
@@ -12,11 +27,30 @@
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_reader.h"
+#include "../../util/png/png_writer.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/apple2_decode.h"
+#include "../../util/tile_decode/apple2_encode.h"
+#include "../../util/tile_decode/apple2_ntsc.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/apple2_encode_verify.h"
+#include "../../util/verify/apple2_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
+#include "../../util/verify/tile_watch_verify.h"
+#include "../../util/watch/tile_watch.h"
+
 // SHP0 / SHP1
 // Num images across 16
 // Num images down 8
@@ -51,174 +85,561 @@
 #define EXPORT_VERTICAL_STRIP 0
 
 
-enum colorType
+// Byte n of each file is line n / NUM_TILES of tile n % NUM_TILES. SHP0 holds the left 7 pixels of the line and SHP1
+// holds the right 7, and the two render as one 14 pixel span.
+void DecodeTileBytes( const std::vector<uint8_t>& shp0, const std::vector<uint8_t>& shp1, IndexSurface& surface,
+                      RgbSurface* ntsc = nullptr )
 {
-  Green,
-  Orange,
-  Violet,
-  Blue,
-  White,
-  Black
-};
+  surface.Create( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+  }
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
 
-int colorTable[6];
+  const size_t numBytes{ shp0.size() < shp1.size() ? shp0.size() : shp1.size() };
 
+  for( size_t currentBytes = 0; currentBytes < numBytes; ++currentBytes )
+  {
+    const uint32_t tile{ static_cast<uint32_t>( currentBytes % NUM_TILES ) };
+    const uint32_t lineNum{ static_cast<uint32_t>( currentBytes / NUM_TILES ) };
+
+    if( lineNum >= TILE_HEIGHT )
+    {
+      break;
+    }
+
+    const uint8_t tileData[2] = { shp0[currentBytes], shp1[currentBytes] };
+
+    const uint32_t x{ ( tile % TILES_PER_ROW ) * TILE_WIDTH };
+    const uint32_t y{ ( tile / TILES_PER_ROW ) * TILE_HEIGHT + lineNum };
+    DecodeAppleSpan( tileData, 2, true, false, surface.Row( y ) + x );
+
+    if( ntsc != nullptr )
+    {
+      DecodeAppleSpanNtsc( tileData, 2, true, ntsc->Row( y ) + x );
+    }
+  }
+}
 
-// From Gil Megidish:
-// The algorithm is this: for any given pixel at x, if x is 1 and any of( x - 1 ), ( x + 1 ) are 1s, then pixel at x is
-// white. if x is 0 and the two adjacent are also zero, then pixel at x is black. Now it's tricky. If x is 1 and both
-// adjacent pixels are 0, then pixel at x is green/purple (if odd or even), there's also blue / orange for second
-// palette. If x is 0, and both adjacent are 1, then the previous algorithm also catches. Sum it up, color at pixel x
-// depends on the two adjacent pixels, the MSB of the byte being rendered, and if this pixel is odd / even.
 
-void Draw( BITMAP* buffer, uint32_t x, uint32_t y, uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd )
+bool DecodeTiles( IndexSurface& surface, RgbSurface* ntsc = nullptr )
 {
-  colorType color{ Black };
+  INSTRUMENT_BEGIN_FILE( "SHP0/SHP1" );
 
-  if( ( value & 0x1 ) == 1 )
+  std::vector<uint8_t> shp0;
+  std::vector<uint8_t> shp1;
+
+  if( !( ReadFileBytes( "SHP0", shp0 ) && ReadFileBytes( "SHP1", shp1 ) ) )
   {
-    if( lastBitOn || ( ( value >> 1 ) & 0x1 ) )
+    return false;
+  }
+
+  DecodeTileBytes( shp0, shp1, surface, ntsc );
+  return true;
+}
+
+
+// The reverse of DecodeTileBytes(), for a tile sheet laid out like tiles.pcx. shp0 and shp1 are the files to patch,
+// where only the rows that render differently change and any bytes past the tiles are kept, or both empty to encode
+// every tile afresh. Returns how far the tiles are from the sheet (0 if they match exactly), or -1 if the sheet is too
+// small.
+int64_t EncodeTileBytes( const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize,
+                         std::vector<uint8_t>& shp0, std::vector<uint8_t>& shp1 )
+{
+  // The encoder takes each tile's rows in turn, as byte pairs
+  std::vector<uint8_t> tiles;
+  if( !shp0.empty() || !shp1.empty() )
+  {
+    // Lines missing from the end of a file aren't drawn, which shows like zero bytes
+    if( shp0.size() < NUM_TILES * TILE_HEIGHT )
     {
-      color = White;
+      shp0.resize( NUM_TILES * TILE_HEIGHT, 0 );
     }
-    else if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+
+    if( shp1.size() < NUM_TILES * TILE_HEIGHT )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Green : Orange;
-      }
-      else
+      shp1.resize( NUM_TILES * TILE_HEIGHT, 0 );
+    }
+
+    tiles.resize( NUM_TILES * TILE_HEIGHT * 2 );
+    for( int32_t tile = 0; tile < NUM_TILES; ++tile )
+    {
+      for( int32_t lineNum = 0; lineNum < TILE_HEIGHT; ++lineNum )
       {
-        color = firstColorGroup ? Violet : Blue;
+        uint8_t* tileData{ &tiles[( tile * TILE_HEIGHT + lineNum ) * 2] };
+        tileData[0] = shp0[lineNum * NUM_TILES + tile];
+        tileData[1] = shp1[lineNum * NUM_TILES + tile];
       }
     }
   }
-  else
+
+  const int64_t difference{ EncodeAppleTiles( sheet, palette, paletteSize, NUM_TILES, TILES_PER_ROW, TILE_WIDTH,
+                                              TILE_HEIGHT, true, tiles, 0 ) };
+  if( difference < 0 )
+  {
+    return difference;
+  }
+
+  if( shp0.empty() && shp1.empty() )
   {
-    if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    shp0.resize( NUM_TILES * TILE_HEIGHT );
+    shp1.resize( NUM_TILES * TILE_HEIGHT );
+  }
+
+  for( int32_t tile = 0; tile < NUM_TILES; ++tile )
+  {
+    for( int32_t lineNum = 0; lineNum < TILE_HEIGHT; ++lineNum )
     {
-      color = Black;
+      const uint8_t* tileData{ &tiles[( tile * TILE_HEIGHT + lineNum ) * 2] };
+      shp0[lineNum * NUM_TILES + tile] = tileData[0];
+      shp1[lineNum * NUM_TILES + tile] = tileData[1];
     }
-    if( lastBitOn && ( ( value >> 1 ) & 0x1 ) )
+  }
+
+  return difference;
+}
+
+
+bool DecodeText( IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( "HTXT" );
+
+  std::vector<uint8_t> htxt;
+  if( !ReadFileBytes( "HTXT", htxt ) )
+  {
+    return false;
+  }
+
+  surface.Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  if( ntsc != nullptr )
+  {
+    ntsc->Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  }
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  // Byte n is line n / NUM_CHARS of character n % NUM_CHARS
+  for( size_t currentBytes = 0; currentBytes < htxt.size(); ++currentBytes )
+  {
+    const uint32_t character{ static_cast<uint32_t>( currentBytes % NUM_CHARS ) };
+    const uint32_t lineNum{ static_cast<uint32_t>( currentBytes / NUM_CHARS ) };
+
+    if( lineNum >= CHAR_HEIGHT )
     {
-      if( odd )
-      {
-        color = firstColorGroup ? Violet : Blue;
-      }
-      else
+      break;
+    }
+
+    const uint32_t x{ ( character % CHARS_PER_ROW ) * CHAR_WIDTH };
+    const uint32_t y{ ( character / CHARS_PER_ROW ) * CHAR_HEIGHT + lineNum };
+    DecodeAppleSpan( &htxt[currentBytes], 1, true, false, surface.Row( y ) + x );
+
+    if( ntsc != nullptr )
+    {
+      DecodeAppleSpanNtsc( &htxt[currentBytes], 1, true, ntsc->Row( y ) + x );
+    }
+  }
+
+  return true;
+}
+
+
+// A whole hi-res page, as saved from $2000
+bool DecodeScreen( const char* filename, IndexSurface& surface, RgbSurface* ntsc = nullptr )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> picture;
+  if( !ReadFileBytes( filename, picture ) )
+  {
+    printf( "Can't open %s\n", filename );
+    return false;
+  }
+
+  if( !DecodeAppleScreen( picture.data(), picture.size(), surface, 0 ) )
+  {
+    printf( "%s is %d bytes, too short for a hi-res screen\n", filename, static_cast<int32_t>( picture.size() ) );
+    return false;
+  }
+
+  return ntsc == nullptr || DecodeAppleScreenNtsc( picture.data(), picture.size(), *ntsc, 0 );
+}
+
+
+// The inputs --watch follows, in the order AddWatchedInputs() adds them
+enum WatchedInput
+{
+  WATCHED_SHP0,
+  WATCHED_SHP1,
+  WATCHED_HTXT
+};
+
+
+// Byte n of SHP0 and SHP1 is line n / NUM_TILES of tile n % NUM_TILES, and HTXT is laid out the same way. The pack
+// holds the tiles and then the characters.
+bool AddWatchedInputs( TileWatch& watch )
+{
+  if( watch.AddInput( "SHP0" ) != WATCHED_SHP0 || watch.AddInput( "SHP1" ) != WATCHED_SHP1 ||
+      watch.AddInput( "HTXT" ) != WATCHED_HTXT )
+  {
+    return false;
+  }
+
+  const TileByteLayout tiles{ 0, 1, NUM_TILES, 1, TILE_HEIGHT, NUM_TILES, 0 };
+  watch.AddLayout( WATCHED_SHP0, tiles );
+  watch.AddLayout( WATCHED_SHP1, tiles );
+  watch.AddLayout( WATCHED_HTXT, TileByteLayout{ 0, 1, NUM_CHARS, 1, CHAR_HEIGHT, NUM_CHARS, NUM_TILES } );
+  return true;
+}
+
+
+// Decodes one pack tile from the watched files, as DecodeTileBytes() and DecodeText() would have
+void DecodeWatchedTile( const TileWatch& watch, int32_t packTile, uint8_t* dest, int32_t pitch )
+{
+  if( packTile >= NUM_TILES )
+  {
+    const std::vector<uint8_t>& htxt{ watch.Bytes( WATCHED_HTXT ) };
+    for( int32_t lineNum = 0; lineNum < CHAR_HEIGHT; ++lineNum )
+    {
+      const size_t index{ static_cast<size_t>( lineNum ) * NUM_CHARS + ( packTile - NUM_TILES ) };
+      if( index < htxt.size() )
       {
-        color = firstColorGroup ? Green : Orange;
+        DecodeAppleSpan( &htxt[index], 1, true, false, dest + lineNum * pitch );
       }
     }
+
+    return;
   }
 
-  putpixel( buffer, x, y, colorTable[color] );
+  const std::vector<uint8_t>& shp0{ watch.Bytes( WATCHED_SHP0 ) };
+  const std::vector<uint8_t>& shp1{ watch.Bytes( WATCHED_SHP1 ) };
+  for( int32_t lineNum = 0; lineNum < TILE_HEIGHT; ++lineNum )
+  {
+    const size_t index{ static_cast<size_t>( lineNum ) * NUM_TILES + packTile };
+    if( index < shp0.size() && index < shp1.size() )
+    {
+      const uint8_t tileData[2] = { shp0[index], shp1[index] };
+      DecodeAppleSpan( tileData, 2, true, false, dest + lineNum * pitch );
+    }
+  }
 }
 
 
-int32_t main()
+bool Verify()
 {
-  if( allegro_init() != 0 )
+  bool passed{ VerifyAppleKernels() };
+  passed &= VerifyAppleEncoder();
+  passed &= VerifyAppleScreenDecoder();
+  passed &= VerifyAppleNtsc();
+  passed &= VerifyDispatchKernels();
+  passed &= VerifyTileWatch();
+
+  IndexSurface surface;
+  TileWatch watch;
+  const bool watched{ AddWatchedInputs( watch ) };
+  auto decodeWatchedTile = [&watch]( int32_t packTile, uint8_t* dest, int32_t pitch )
   {
-    allegro_message("Allegro initialization failed");
-    return -1;
+    DecodeWatchedTile( watch, packTile, dest, pitch );
+  };
+
+  if( DecodeTiles( surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "SHP0/SHP1", surface, apple2Palette, 6, "tiles.png", TILE_WIDTH, TILE_HEIGHT );
+    passed &= VerifySheetPack( "SHP0/SHP1", surface, apple2Palette, 6, TILE_WIDTH, TILE_HEIGHT );
+    passed &= watched && VerifyTilesDecodeAlone( "SHP0/SHP1", surface, TILE_WIDTH, TILE_HEIGHT, 0, decodeWatchedTile );
+
+    // The decoded tiles have to encode back to bytes that decode the same
+    std::vector<uint8_t> shp0;
+    std::vector<uint8_t> shp1;
+    IndexSurface reencoded;
+    const int64_t difference{ EncodeTileBytes( surface, apple2Palette, 6, shp0, shp1 ) };
+    DecodeTileBytes( shp0, shp1, reencoded );
+
+    if( difference == 0 && reencoded.pixels == surface.pixels )
+    {
+      printf( "OK   SHP0/SHP1 re-encode to the same tiles\n" );
+    }
+    else
+    {
+      printf( "FAIL SHP0/SHP1 don't re-encode to the same tiles\n" );
+      passed = false;
+    }
+
+    // Encoded over the files themselves, the same tiles have to give back the files byte for byte
+    std::vector<uint8_t> originalShp0;
+    std::vector<uint8_t> originalShp1;
+    ReadFileBytes( "SHP0", originalShp0 );
+    ReadFileBytes( "SHP1", originalShp1 );
+    shp0 = originalShp0;
+    shp1 = originalShp1;
+
+    if( EncodeTileBytes( surface, apple2Palette, 6, shp0, shp1 ) == 0 && shp0 == originalShp0 &&
+        shp1 == originalShp1 )
+    {
+      printf( "OK   SHP0/SHP1 encode over themselves to the same bytes\n" );
+    }
+    else
+    {
+      printf( "FAIL SHP0/SHP1 don't encode over themselves to the same bytes\n" );
+      passed = false;
+    }
+  }
+  else
+  {
+    printf( "FAIL can't open SHP0 and SHP1\n" );
+    passed = false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  if( DecodeText( surface ) )
   {
-    depth = 16;
+    passed &= VerifySurfaceAgainstPng( "HTXT", surface, apple2Palette, 6, "text.png", CHAR_WIDTH, CHAR_HEIGHT );
+    passed &= watched &&
+              VerifyTilesDecodeAlone( "HTXT", surface, CHAR_WIDTH, CHAR_HEIGHT, NUM_TILES, decodeWatchedTile );
+  }
+  else
+  {
+    printf( "FAIL can't open HTXT\n" );
+    passed = false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  return passed;
+}
+
+
+// Headless: reads an edited tile sheet, encodes it over SHP0 and SHP1 and writes the results into directory
+bool EncodeTiles( const char* pngFilename, const char* directory )
+{
+  PngImage sheet;
+  const char* error{ nullptr };
+  if( !ReadPng( pngFilename, sheet, error ) )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    printf( "%s: %s\n", pngFilename, error );
+    return false;
+  }
+
+  std::vector<uint8_t> shp0;
+  std::vector<uint8_t> shp1;
+  if( !ReadFileBytes( "SHP0", shp0 ) || !ReadFileBytes( "SHP1", shp1 ) || shp0.empty() || shp1.empty() )
+  {
+    printf( "Can't open SHP0 and SHP1 to encode the tiles over\n" );
+    return false;
   }
 
-  colorTable[Green]  = makecol( 0x25, 0xBE, 0x00 );
-  colorTable[Orange] = makecol( 0xE5, 0x50, 0x00 );
-  colorTable[Violet] = makecol( 0x9E, 0x00, 0xFF );
-  colorTable[Blue]   = makecol( 0x00, 0x7E, 0xFF );
-  colorTable[White]  = makecol( 0xFF, 0xFF, 0xFF );
-  colorTable[Black]  = makecol( 0x00, 0x00, 0x00 );
+  const int64_t difference{ EncodeTileBytes( sheet.indices, sheet.palette.data(),
+                                             static_cast<int32_t>( sheet.palette.size() ), shp0, shp1 ) };
+  if( difference < 0 )
+  {
+    printf( "%s: needs to be at least %dx%d\n", pngFilename, TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+    return false;
+  }
 
-  // ---------------------
-  // Process tile graphics
-  // ---------------------
+  if( !WriteFileBytes( ( std::string( directory ) + "/SHP0" ).c_str(), shp0 ) ||
+      !WriteFileBytes( ( std::string( directory ) + "/SHP1" ).c_str(), shp1 ) )
+  {
+    printf( "Can't write SHP0 and SHP1 to %s\n", directory );
+    return false;
+  }
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
+  printf( "%s: wrote %s/SHP0 and %s/SHP1, squared color difference %lld\n", pngFilename, directory, directory,
+          static_cast<long long>( difference ) );
+  return true;
+}
 
-  std::ifstream infile1;
-  infile1.open( "SHP0", std::ios::in | std::ios::binary | std::ios::ate );
 
-  std::ifstream infile2;
-  infile2.open( "SHP1", std::ios::in | std::ios::binary );
+// The sheets (and --screen pictures) of a normal run, through the NTSC simulation
+bool WriteNtsc( int32_t argc, char* argv[] )
+{
+  IndexSurface surface;
+  RgbSurface ntsc;
 
-  if( !( infile1.is_open() && infile2.is_open() ) )
+  if( !DecodeTiles( surface, &ntsc ) || !WritePngRgb( "tiles_ntsc.png", ntsc ) )
   {
-    return -1;
+    return false;
+  }
+
+  if( !DecodeText( surface, &ntsc ) || !WritePngRgb( "text_ntsc.png", ntsc ) )
+  {
+    return false;
+  }
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface, &ntsc ) ||
+        !WritePngRgb( ( std::string( argv[i + 1] ) + "_ntsc.png" ).c_str(), ntsc ) )
+    {
+      return false;
+    }
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  uint32_t numBytes{ static_cast<uint32_t>( infile1.tellg() ) };
+  return true;
+}
 
-  // Reset to the beginning
-  infile1.seekg( 0, std::ios::beg );
 
-  uint32_t x{ 0 };
-  uint32_t y{ 0 };
+// The tiles, then the characters, packed from the sheets of a normal run
+bool WritePack( const char* filename, bool compress )
+{
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( apple2Palette, 6 ) };
+  IndexSurface surface;
 
-  uint32_t currentBytes{ 0 };
-  uint32_t lineNum{ 0 };
+  if( !DecodeTiles( surface ) || writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
 
-  while( currentBytes < numBytes )
+  if( !DecodeText( surface ) || writer.AddSheet( surface, CHAR_WIDTH, CHAR_HEIGHT, palette ) < 0 )
   {
-    const uint8_t tileData1{ static_cast<uint8_t>( infile1.get() ) };
-    const uint8_t tileData2{ static_cast<uint8_t>( infile2.get() ) };
+    return false;
+  }
 
-    // Combine both bytes into one word, ignoring the colorGroup bits
-    const uint16_t tileData{ static_cast<uint16_t>( ( ( tileData2 & 0x7f ) << 7 ) | ( tileData1 & 0x7f ) ) };
+  if( !writer.Save( filename, compress ) )
+  {
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
+  }
 
-    // Place the first 7 pixels
-    const bool colorGroup1{ ( ( tileData1 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 0 ) & 0x3, false, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 1 ) & 0x3, ( tileData >> 0 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 2 ) & 0x3, ( tileData >> 1 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 3 ) & 0x3, ( tileData >> 2 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 4 ) & 0x3, ( tileData >> 3 ) & 0x1, colorGroup1, true );
-    Draw( backBuffer, x++, y, ( tileData >> 5 ) & 0x3, ( tileData >> 4 ) & 0x1, colorGroup1, false );
-    Draw( backBuffer, x++, y, ( tileData >> 6 ) & 0x3, ( tileData >> 5 ) & 0x1, colorGroup1, true );
+  return true;
+}
 
-    // Place the next 7 pixels
-    const bool colorGroup2{ ( ( tileData2 >> 7 ) & 0x1 ) == 0 };
-    Draw( backBuffer, x++, y, ( tileData >> 7 )  & 0x3, ( tileData >> 6 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 8 )  & 0x3, ( tileData >> 7 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 9 )  & 0x3, ( tileData >> 8 )  & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 10 ) & 0x3, ( tileData >> 9 )  & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 11 ) & 0x3, ( tileData >> 10 ) & 0x1, colorGroup2, false );
-    Draw( backBuffer, x++, y, ( tileData >> 12 ) & 0x3, ( tileData >> 11 ) & 0x1, colorGroup2, true );
-    Draw( backBuffer, x++, y, ( tileData >> 13 ) & 0x3, ( tileData >> 12 ) & 0x1, colorGroup2, false );
 
-    if( x >= TILE_BUFFER_WIDTH )
+// Writes the pack, then keeps it up to date as the tiles and characters are edited
+bool WatchPack( const char* filename )
+{
+  TileWatch watch;
+  if( !AddWatchedInputs( watch ) || !WritePack( filename, false ) )
+  {
+    return false;
+  }
+
+  return watch.Run( filename, [&watch]( int32_t packTile, uint8_t* dest, int32_t pitch )
+  {
+    DecodeWatchedTile( watch, packTile, dest, pitch );
+  } );
+}
+
+
+// The tiles and characters of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", apple2Palette, 6 );
+  IndexSurface surface;
+
+  if( !DecodeTiles( surface ) || writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !DecodeText( surface ) || writer.AddSheet( "CHAR", surface, CHAR_WIDTH, CHAR_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !SaveDatafile( filename, writer, compress ) )
+  {
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
+
+  return true;
+}
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
+
+  if( HasVerifyOption( argc, argv ) )
+  {
+    return Verify() ? 0 : 1;
+  }
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--ntsc" ) == 0 )
     {
-      // Wrap to the next sprite
-      x = 0;
-      y += TILE_HEIGHT;
+      // Written straight to PNG, so this runs headless too
+      return WriteNtsc( argc, argv ) ? 0 : -1;
     }
+  }
 
-    if( y >= TILE_BUFFER_HEIGHT )
+  for( int32_t i = 1; i + 2 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--encode-tiles" ) == 0 )
     {
-      // Start back at the top, but on the next unread line of the sprite
-      y = ++lineNum;
+      return EncodeTiles( argv[i + 1], argv[i + 2] ) ? 0 : -1;
     }
+  }
 
-    ++currentBytes;
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    if( HasWatchOption( argc, argv ) )
+    {
+      return WatchPack( packFilename ) ? 0 : -1;
+    }
+
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
+
+  if( allegro_init() != 0 )
+  {
+    allegro_message("Allegro initialization failed");
+    return -1;
+  }
+
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
+
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
+  }
+
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
+
+  int32_t colorTable[6];
+  MakeColorTable( apple2Palette, 6, colorTable );
+
+  IndexSurface surface;
+
+  // ---------------------
+  // Process tile graphics
+  // ---------------------
+
+  if( !DecodeTiles( surface ) )
+  {
+    return -1;
   }
 
-  infile1.close();
-  infile2.close();
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, colorTable ) };
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -238,11 +659,11 @@ int32_t main()
     }
   }
 
-  save_pcx( "tiles.pcx", backBuffer2, nullptr );
+  SavePcx( "tiles.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "tiles.pcx", backBuffer, nullptr );
+  SavePcx( "tiles.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
@@ -251,63 +672,12 @@ int32_t main()
   // Process text graphics
   // ---------------------
 
-  backBuffer = create_bitmap( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
-
-  std::ifstream infile;
-  infile.open( "HTXT", std::ios::in | std::ios::binary | std::ios::ate );
-
-  if( !infile.is_open() )
+  if( !DecodeText( surface ) )
   {
     return -1;
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  numBytes = static_cast<int32_t>( infile.tellg() );
-
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
-
-  x = 0;
-  y = 0;
-
-  currentBytes = 0;
-  lineNum = 0;
-
-  while( currentBytes < numBytes )
-  {
-    uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-
-    const bool colorGroup{ ( ( tileData >> 7 ) & 0x1 ) == 0 };
-
-    // Remove the color group bit
-    tileData &= 0x7f;
-
-    // Place the 7 pixels
-    Draw( backBuffer, x++, y, ( ( tileData >> 0 ) & 0x3 ), false, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 1 ) & 0x3 ), ( tileData >> 0 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 2 ) & 0x3 ), ( tileData >> 1 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 3 ) & 0x3 ), ( tileData >> 2 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 4 ) & 0x3 ), ( tileData >> 3 ) & 0x1, colorGroup, true );
-    Draw( backBuffer, x++, y, ( ( tileData >> 5 ) & 0x3 ), ( tileData >> 4 ) & 0x1, colorGroup, false );
-    Draw( backBuffer, x++, y, ( ( tileData >> 6 ) & 0x3 ), ( tileData >> 5 ) & 0x1, colorGroup, true );
-
-    if( x >= CHAR_BUFFER_WIDTH )
-    {
-      // Wrap to the next sprite
-      x = 0;
-      y += CHAR_HEIGHT;
-    }
-
-    if( y >= CHAR_BUFFER_HEIGHT )
-    {
-      // Start back at the top, but on the next unread line of the sprite
-      y = ++lineNum;
-    }
-
-    ++currentBytes;
-  }
-
-  infile.close();
+  backBuffer = CreateBitmapFromSurface( surface, colorTable );
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -327,14 +697,37 @@ int32_t main()
     }
   }
 
-  save_pcx( "text.pcx", backBuffer2, nullptr );
+  SavePcx( "text.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "text.pcx", backBuffer, nullptr );
+  SavePcx( "text.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
 
+  // --------------------
+  // Full-screen pictures
+  // --------------------
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--screen" ) != 0 )
+    {
+      continue;
+    }
+
+    if( !DecodeScreen( argv[i + 1], surface ) )
+    {
+      return -1;
+    }
+
+    backBuffer = CreateBitmapFromSurface( surface, colorTable );
+
+    SavePcx( ( std::string( argv[i + 1] ) + ".pcx" ).c_str(), backBuffer );
+
+    destroy_bitmap( backBuffer );
+  }
+
   return 0;
 }
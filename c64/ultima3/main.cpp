@@ -1,13 +1,54 @@
 // Extracts Ultima III tile and text data from Commodore 64 sources.
 
+// Other artwork on the disk is ripped in the same pass with --vic, through the VIC-II decoder (see vic2_decode.h).
+// Offsets are into ultima3a.d64 and can be given in hex (0x...). Each --vic writes MODE_OFFSET.pcx:
+//   --vic charset,OFFSET[,COUNT[,PER_ROW]]      256 characters, 16 per row by default (also mccharset)
+//   --vic sprites,OFFSET[,COUNT[,PER_ROW]]      64 sprites, 8 per row by default (also mcsprites)
+//   --vic bitmap,OFFSET,SCREEN_RAM              320x200 hires bitmap
+//   --vic mcbitmap,OFFSET,SCREEN_RAM,COLOR_RAM  320x200 multicolor bitmap (double-wide pixels)
+// --vic-colors BG,MC1,MC2,FG sets the color registers every --vic uses (0,11,12,1 by default).
+
+// Run with --inject-tiles FILE.png DISK.d64... --inject-into DIR to go the other way: an edited copy of tiles.pcx
+// (saved as PNG) is encoded back into each disk image, with the two colors that come closest for every tile, and the
+// new images are written to DIR under their own names. The source images are never changed.
+
+// Run with --tileset FILE.c64t to save the tiles as they are on the disk, 1 bit per pixel and a color byte per tile,
+// for renderers that expand them as they draw (see c64_tiles.h).
+
+// Takes the options every ripper does (see ripper_options.h): --verify against tiles.png, --pack and --datafile with
+// the tiles, --stats and --force-isa. --watch patches the pack whenever ultima3a.d64 is saved, including the tiles
+// whose colors changed.
+
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_reader.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/c64_decode.h"
+#include "../../util/tile_decode/c64_encode.h"
+#include "../../util/tile_decode/c64_tiles.h"
+#include "../../util/tile_decode/d64_image.h"
+#include "../../util/tile_decode/parallel.h"
+#include "../../util/tile_decode/vic2_decode.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/c64_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
+#include "../../util/verify/tile_watch_verify.h"
+#include "../../util/watch/tile_watch.h"
+
 #define NUM_TILES       64
 
 #define TILE_WIDTH      16
@@ -19,108 +60,688 @@
 #define TILE_BUFFER_WIDTH  ( TILE_WIDTH * TILES_PER_ROW )
 #define TILE_BUFFER_HEIGHT ( TILE_HEIGHT * TILES_PER_COL )
 
+// Tile colors offset
+#define TILE_COLORS_OFFSET 0xdd61
+
+// Tile data offset
+#define TILE_DATA_OFFSET 0x8800
+
+// --vic defaults
+#define VIC_DEFAULT_CHARS           256
+#define VIC_DEFAULT_CHARS_PER_ROW   16
+#define VIC_DEFAULT_SPRITES         64
+#define VIC_DEFAULT_SPRITES_PER_ROW 8
+#define VIC_MAX_ITEMS               4096
+
 #define EXPORT_VERTICAL_STRIP 0
 
 
-int32_t main()
+// Artwork to rip with the VIC-II decoder, from --vic
+struct VicArtwork
 {
-  if( allegro_init() != 0 )
+  Vic2Mode mode{ VIC2_CHARSET };
+  long offset{ 0 };
+  long screenOffset{ 0 };
+  long colorOffset{ 0 };
+  int32_t count{ 0 };
+  int32_t itemsPerRow{ 0 };
+  std::string filename;
+};
+
+
+// Reads the --vic and --vic-colors options. Returns false (after printing why) if one is malformed.
+bool ParseVicOptions( int32_t argc, char* argv[], std::vector<VicArtwork>& artwork, Vic2Colors& colors )
+{
+  for( int32_t i = 1; i < argc; ++i )
   {
-    allegro_message( "Allegro initialization failed" );
-    return -1;
+    const bool hasValue{ i + 1 < argc };
+
+    if( strcmp( argv[i], "--vic" ) == 0 && hasValue )
+    {
+      const std::string spec{ argv[++i] };
+      const size_t comma{ spec.find( ',' ) };
+
+      VicArtwork entry;
+      if( comma == std::string::npos || !FindVic2Mode( spec.substr( 0, comma ).c_str(), entry.mode ) )
+      {
+        printf( "--vic expects MODE,OFFSET,... where MODE is charset, mccharset, bitmap, mcbitmap, sprites or "
+                "mcsprites\n" );
+        return false;
+      }
+
+      // Up to 3 numbers after the offset
+      long values[4] = { -1, -1, -1, -1 };
+      const char* text{ spec.c_str() + comma + 1 };
+      int32_t numValues{ 0 };
+
+      while( numValues < 4 )
+      {
+        char* end{ nullptr };
+        values[numValues++] = strtol( text, &end, 0 );
+        if( end == text || values[numValues - 1] < 0 || ( *end != ',' && *end != '\0' ) )
+        {
+          printf( "--vic %s: expected non-negative numbers after the mode\n", spec.c_str() );
+          return false;
+        }
+
+        if( *end == '\0' )
+        {
+          break;
+        }
+
+        text = end + 1;
+      }
+
+      entry.offset = values[0];
+
+      if( entry.mode == VIC2_BITMAP || entry.mode == VIC2_MULTICOLOR_BITMAP )
+      {
+        const int32_t numNeeded{ entry.mode == VIC2_BITMAP ? 2 : 3 };
+        if( numValues != numNeeded )
+        {
+          printf( "--vic %s expects %s\n", Vic2ModeName( entry.mode ),
+                  numNeeded == 2 ? "OFFSET,SCREEN_RAM" : "OFFSET,SCREEN_RAM,COLOR_RAM" );
+          return false;
+        }
+
+        entry.screenOffset = values[1];
+        entry.colorOffset = numNeeded == 3 ? values[2] : 0;
+      }
+      else
+      {
+        const bool sprites{ entry.mode == VIC2_SPRITES || entry.mode == VIC2_MULTICOLOR_SPRITES };
+        entry.count = static_cast<int32_t>( numValues > 1 ? values[1]
+                                                          : ( sprites ? VIC_DEFAULT_SPRITES : VIC_DEFAULT_CHARS ) );
+        entry.itemsPerRow = static_cast<int32_t>( numValues > 2 ? values[2]
+                                                                : ( sprites ? VIC_DEFAULT_SPRITES_PER_ROW
+                                                                            : VIC_DEFAULT_CHARS_PER_ROW ) );
+
+        if( entry.count <= 0 || entry.count > VIC_MAX_ITEMS || entry.itemsPerRow <= 0 || numValues > 3 )
+        {
+          printf( "--vic %s expects OFFSET[,COUNT[,PER_ROW]] with 1 to %d items\n", Vic2ModeName( entry.mode ),
+                  VIC_MAX_ITEMS );
+          return false;
+        }
+      }
+
+      char filename[64];
+      snprintf( filename, sizeof( filename ), "%s_%lx.pcx", Vic2ModeName( entry.mode ), entry.offset );
+      entry.filename = filename;
+
+      artwork.push_back( entry );
+    }
+    else if( strcmp( argv[i], "--vic-colors" ) == 0 && hasValue )
+    {
+      // %n makes sure nothing follows the fourth color
+      int32_t values[4];
+      int32_t length{ 0 };
+      ++i;
+      if( sscanf( argv[i], "%d,%d,%d,%d%n", &values[0], &values[1], &values[2], &values[3], &length ) != 4 ||
+          argv[i][length] != '\0' || values[0] < 0 || values[0] > 15 || values[1] < 0 || values[1] > 15 ||
+          values[2] < 0 || values[2] > 15 || values[3] < 0 || values[3] > 15 )
+      {
+        printf( "--vic-colors expects BG,MC1,MC2,FG, each a color from 0 to 15\n" );
+        return false;
+      }
+
+      colors.background = static_cast<uint8_t>( values[0] );
+      colors.multicolor1 = static_cast<uint8_t>( values[1] );
+      colors.multicolor2 = static_cast<uint8_t>( values[2] );
+      colors.foreground = static_cast<uint8_t>( values[3] );
+    }
+    else if( strncmp( argv[i], "--vic", 5 ) == 0 )
+    {
+      printf( "%s needs a value\n", argv[i] );
+      return false;
+    }
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  return true;
+}
+
+
+// Reads the whole disk image once, for the tiles and every --vic. Tiles past the end of a short image read as EOF,
+// like infile.get(). Returns false (after printing why) if a --vic reaches past the end of the image.
+bool ReadDisk( const std::vector<VicArtwork>& artwork, std::vector<uint8_t>& diskData )
+{
+  INSTRUMENT_BEGIN_FILE( "ultima3a.d64" );
+
+  if( !ReadFileBytes( "ultima3a.d64", diskData ) )
   {
-    depth = 16;
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  // Checked without adding to the offsets, which can be anything that fits a long
+  const size_t imageSize{ diskData.size() };
+  auto inImage = [imageSize]( long offset, size_t size )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    return static_cast<unsigned long>( offset ) <= imageSize && size <= imageSize - static_cast<size_t>( offset );
+  };
+
+  for( const VicArtwork& entry : artwork )
+  {
+    const bool bitmap{ entry.mode == VIC2_BITMAP || entry.mode == VIC2_MULTICOLOR_BITMAP };
+    if( !inImage( entry.offset, Vic2DataSize( entry.mode, entry.count ) ) ||
+        ( bitmap && !inImage( entry.screenOffset, VIC2_SCREEN_CELLS ) ) ||
+        ( entry.mode == VIC2_MULTICOLOR_BITMAP && !inImage( entry.colorOffset, VIC2_SCREEN_CELLS ) ) )
+    {
+      printf( "--vic %s,0x%lx: reaches past the end of ultima3a.d64 (%u bytes)\n", Vic2ModeName( entry.mode ),
+              entry.offset, static_cast<uint32_t>( imageSize ) );
+      return false;
+    }
   }
 
-  int32_t c64ColorPalette[16] =
-  {
-    makecol( 0x00, 0x00, 0x00 ), // Black
-    makecol( 0xff, 0xff, 0xff ), // White
-    makecol( 0x93, 0x3a, 0x4c ), // Red
-    makecol( 0xb6, 0xfa, 0xfa ), // Cyan
-    makecol( 0xd2, 0x7d, 0xed ), // Purple
-    makecol( 0x6a, 0xcf, 0x6f ), // Green
-    makecol( 0x4f, 0x44, 0xd8 ), // Blue
-    makecol( 0xfb, 0xfb, 0x8b ), // Yellow
-    makecol( 0xd8, 0x9c, 0x5b ), // Orange
-    makecol( 0x7f, 0x53, 0x07 ), // Brown
-    makecol( 0xef, 0x83, 0x9f ), // Light Red
-    makecol( 0x57, 0x57, 0x53 ), // Dark Gray
-    makecol( 0x57, 0x57, 0x53 ), // Gray
-    makecol( 0xb7, 0xfb, 0xbf ), // Light Green
-    makecol( 0xa3, 0x97, 0xff ), // Light Blue
-    makecol( 0xa3, 0xa7, 0xa7 )  // Light Gray
+  const size_t tilesEnd{ TILE_COLORS_OFFSET + NUM_TILES };
+  if( diskData.size() < tilesEnd )
+  {
+    diskData.resize( tilesEnd, 0xff );
+  }
+
+  return true;
+}
+
+
+bool DecodeTiles( const std::vector<uint8_t>& diskData, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( "tiles" );
+
+  const uint8_t* tileColors{ &diskData[TILE_COLORS_OFFSET] };
+  const uint8_t* tileData{ &diskData[TILE_DATA_OFFSET] };
+
+  surface.Create( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  // Both halves of a tile row share the tile's color byte, and every row uses the same colors
+  uint8_t rowColors[NUM_TILES * 2];
+  for( int32_t j = 0; j < NUM_TILES * 2; ++j )
+  {
+    rowColors[j] = tileColors[j / 2];
+  }
+
+  // Tiles are set up like this:
+  // The first 2 bytes represent the left-half and right half of the first tile, then the next 2-bytes are for
+  // the very top of the second tile This continues until the first row of all tiles are read. Each byte = 8
+  // pixels. 0 = not drawn, 1 = drawn.
+  for( int32_t k = 0; k < TILE_HEIGHT; ++k )
+  {
+    uint8_t* row{ surface.Row( k ) };
+
+    // Draw a single tile row for all tiles. Each tile row is represented by 2 bytes.
+    DecodeC64HiresSpan( tileData, rowColors, NUM_TILES * 2, row );
+    tileData += NUM_TILES * 2;
+  }
+
+  return true;
+}
+
+
+// The tiles as they are on the disk, 1 bit per pixel plus a color byte each, for renderers that keep many tile sets
+// resident (see c64_tiles.h)
+bool BuildTileSet( const std::vector<uint8_t>& diskData, C64TileSet& set )
+{
+  INSTRUMENT_BEGIN_FILE( "tile set" );
+  INSTRUMENT_SCOPE( "decode" );
+
+  set.Create( TILE_WIDTH, TILE_HEIGHT );
+  set.AddInterleaved( &diskData[TILE_DATA_OFFSET], NUM_TILES * 2, &diskData[TILE_COLORS_OFFSET], NUM_TILES );
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, set.MemorySize() );
+  return true;
+}
+
+
+// The reverse of DecodeTiles(): encodes a sheet laid out like tiles.pcx back into a disk image, with the best two
+// colors for each tile. Tiles start out as they are on the disk, so unchanged tiles keep their bytes. Returns the
+// total squared color difference, or -1 if the sheet is too small.
+int64_t EncodeTiles( const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize, D64Image& disk )
+{
+  INSTRUMENT_SCOPE( "encode" );
+
+  const uint8_t* data{ disk.Data() };
+  std::vector<uint8_t> tileData( data + TILE_DATA_OFFSET, data + TILE_DATA_OFFSET + NUM_TILES * 2 * TILE_HEIGHT );
+  std::vector<uint8_t> tileColors( data + TILE_COLORS_OFFSET, data + TILE_COLORS_OFFSET + NUM_TILES );
+
+  int64_t total{ 0 };
+  for( int32_t tile = 0; tile < NUM_TILES; ++tile )
+  {
+    const int32_t x{ ( tile % TILES_PER_ROW ) * TILE_WIDTH };
+    const int32_t y{ ( tile / TILES_PER_ROW ) * TILE_HEIGHT };
+
+    const int64_t difference{ EncodeC64HiresBlock( sheet, palette, paletteSize, x, y, TILE_WIDTH, TILE_HEIGHT,
+                                                   &tileData[tile * 2], NUM_TILES * 2, tileColors[tile] ) };
+    if( difference < 0 )
+    {
+      return -1;
+    }
+
+    total += difference;
+  }
+
+  disk.WriteBytes( TILE_DATA_OFFSET, tileData.data(), tileData.size() );
+  disk.WriteBytes( TILE_COLORS_OFFSET, tileColors.data(), tileColors.size() );
+  return total;
+}
+
+
+// The full path of an existing file or directory, with links and . and .. resolved, or empty if there's none
+std::string FullPath( const std::string& path )
+{
+#if defined( _WIN32 )
+  char buffer[_MAX_PATH];
+  return _fullpath( buffer, path.c_str(), sizeof( buffer ) ) != nullptr ? buffer : "";
+#else
+  char buffer[PATH_MAX];
+  return realpath( path.c_str(), buffer ) != nullptr ? buffer : "";
+#endif
+}
+
+
+// The name of the copy of a disk image in directory, or empty if that would be the image itself
+std::string OutputFilename( const std::string& directory, const std::string& diskFilename )
+{
+  const size_t slash{ diskFilename.find_last_of( "/\\" ) };
+  const std::string name{ slash == std::string::npos ? diskFilename : diskFilename.substr( slash + 1 ) };
+  const std::string fullDirectory{ FullPath( directory ) };
+  if( fullDirectory.empty() || fullDirectory + "/" + name == FullPath( diskFilename ) ||
+      fullDirectory + "\\" + name == FullPath( diskFilename ) )
+  {
+    return "";
+  }
+
+  return fullDirectory + "/" + name;
+}
+
+
+// Headless: encodes an edited tile sheet into every disk image listed after it, and writes the patched images to
+// outputDirectory. The images are patched in parallel, and the sources are only read.
+bool InjectTiles( const char* pngFilename, const std::vector<std::string>& diskFilenames, const char* outputDirectory )
+{
+  PngImage sheet;
+  const char* error{ nullptr };
+  if( !ReadPng( pngFilename, sheet, error ) )
+  {
+    printf( "%s: %s\n", pngFilename, error );
+    return false;
+  }
+
+  const int32_t numDisks{ static_cast<int32_t>( diskFilenames.size() ) };
+  std::vector<const char*> errors( numDisks, nullptr );
+  std::vector<int64_t> differences( numDisks, 0 );
+  std::vector<int32_t> numChanged( numDisks, 0 );
+
+  std::vector<std::string> outputFilenames;
+  for( const std::string& diskFilename : diskFilenames )
+  {
+    outputFilenames.push_back( OutputFilename( outputDirectory, diskFilename ) );
+    if( outputFilenames.back().empty() )
+    {
+      printf( "%s: --inject-into has to be an existing directory other than the image's own\n", diskFilename.c_str() );
+      return false;
+    }
+  }
+
+  ParallelFor( numDisks, 0, [&]( int32_t index )
+  {
+    D64Image disk;
+    if( !disk.Open( diskFilenames[index].c_str() ) )
+    {
+      errors[index] = "can't read the disk image";
+      return;
+    }
+
+    differences[index] = EncodeTiles( sheet.indices, sheet.palette.data(),
+                                      static_cast<int32_t>( sheet.palette.size() ), disk );
+    if( differences[index] < 0 )
+    {
+      errors[index] = "the tile sheet is too small";
+      return;
+    }
+
+    numChanged[index] = disk.NumChangedSectors();
+    if( !disk.Save( outputFilenames[index].c_str() ) )
+    {
+      errors[index] = "can't write the new disk image";
+    }
+  } );
+
+  bool passed{ true };
+  for( int32_t i = 0; i < numDisks; ++i )
+  {
+    if( errors[i] != nullptr )
+    {
+      printf( "%s: %s\n", diskFilenames[i].c_str(), errors[i] );
+      passed = false;
+    }
+    else
+    {
+      printf( "%s: wrote %s with %d changed sectors, squared color difference %lld\n", diskFilenames[i].c_str(),
+              outputFilenames[i].c_str(), numChanged[i], static_cast<long long>( differences[i] ) );
+    }
+  }
+
+  return passed;
+}
+
+
+void DecodeArtwork( const std::vector<uint8_t>& diskData, const VicArtwork& artwork, const Vic2Colors& colors,
+                    IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( artwork.filename.c_str() );
+
+  Vic2Source source;
+  source.mode = artwork.mode;
+  source.data = &diskData[artwork.offset];
+  source.screenRam = &diskData[artwork.screenOffset];
+  source.colorRam = &diskData[artwork.colorOffset];
+  source.count = artwork.count;
+  source.itemsPerRow = artwork.itemsPerRow;
+  source.colors = colors;
+
+  DecodeVic2( source, surface, 0 );
+}
+
+
+// The disk image is the one input --watch follows. Line k of tile t is the 2 bytes at TILE_DATA_OFFSET +
+// k * NUM_TILES * 2 + t * 2, and its color byte is at TILE_COLORS_OFFSET + t.
+bool AddWatchedInputs( TileWatch& watch )
+{
+  const int32_t disk{ watch.AddInput( "ultima3a.d64" ) };
+  if( disk < 0 )
+  {
+    return false;
+  }
+
+  watch.AddLayout( disk, TileByteLayout{ TILE_DATA_OFFSET, 2, NUM_TILES * 2, 2, TILE_HEIGHT, NUM_TILES, 0 } );
+  watch.AddLayout( disk, TileByteLayout{ TILE_COLORS_OFFSET, 1, 1, 1, 1, NUM_TILES, 0 } );
+  return true;
+}
+
+
+// Decodes one tile from the watched disk image, as DecodeTiles() would have. Bytes past the end of a short image read
+// as 0xff, like ReadDisk() pads them.
+void DecodeWatchedTile( const TileWatch& watch, int32_t tile, uint8_t* dest, int32_t pitch )
+{
+  const std::vector<uint8_t>& disk{ watch.Bytes( 0 ) };
+  auto diskByte = [&disk]( size_t offset )
+  {
+    return offset < disk.size() ? disk[offset] : static_cast<uint8_t>( 0xff );
   };
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
+  const uint8_t color{ diskByte( TILE_COLORS_OFFSET + static_cast<size_t>( tile ) ) };
+  const uint8_t colors[2] = { color, color };
+
+  for( int32_t k = 0; k < TILE_HEIGHT; ++k )
+  {
+    const size_t offset{ TILE_DATA_OFFSET + static_cast<size_t>( k ) * NUM_TILES * 2 + tile * 2 };
+    const uint8_t bits[2] = { diskByte( offset ), diskByte( offset + 1 ) };
+    DecodeC64HiresSpan( bits, colors, 2, dest + k * pitch );
+  }
+}
+
+
+bool Verify()
+{
+  bool passed{ VerifyC64Kernels() };
+  passed &= VerifyC64Writer();
+  passed &= VerifyC64TileSets();
+  passed &= VerifyVic2Decoder();
+  passed &= VerifyDispatchKernels();
+  passed &= VerifyTileWatch();
 
-  std::ifstream infile;
-  infile.open("ultima3a.d64", std::ios::binary);
+  IndexSurface surface;
+  std::vector<uint8_t> diskData;
+  TileWatch watch;
+  const bool watched{ AddWatchedInputs( watch ) };
+  auto decodeWatchedTile = [&watch]( int32_t tile, uint8_t* dest, int32_t pitch )
+  {
+    DecodeWatchedTile( watch, tile, dest, pitch );
+  };
 
-  if( infile.is_open() )
+  if( ReadDisk( std::vector<VicArtwork>(), diskData ) && DecodeTiles( diskData, surface ) )
   {
-    // Tile colors offset
-    infile.seekg( 0xdd61, std::ios::beg );
+    passed &= VerifySurfaceAgainstPng( "ultima3a.d64", surface, c64Palette, 16, "tiles.png", TILE_WIDTH,
+                                       TILE_HEIGHT );
+    passed &= VerifySheetPack( "ultima3a.d64", surface, c64Palette, 16, TILE_WIDTH, TILE_HEIGHT );
+    passed &= watched &&
+              VerifyTilesDecodeAlone( "ultima3a.d64", surface, TILE_WIDTH, TILE_HEIGHT, 0, decodeWatchedTile );
+
+    // The compact tile set has to render the same sheet
+    C64TileSet set;
+    std::vector<uint8_t> mapData( NUM_TILES );
+    for( int32_t tile = 0; tile < NUM_TILES; ++tile )
+    {
+      mapData[tile] = static_cast<uint8_t>( tile );
+    }
+
+    const TileMapView map{ mapData.data(), TILES_PER_ROW, TILES_PER_COL, TILES_PER_ROW, TILE_MAP_BYTE };
+    IndexSurface rendered;
+    if( BuildTileSet( diskData, set ) &&
+        RenderC64TileMap( set, map, TileRegion{ 0, 0, TILES_PER_ROW, TILES_PER_COL }, rendered ) == 0 &&
+        rendered.pixels == surface.pixels )
+    {
+      printf( "OK   ultima3a.d64 tile set renders the same tiles in %d bytes (%d as indices)\n",
+              static_cast<int32_t>( set.MemorySize() ), static_cast<int32_t>( surface.pixels.size() ) );
+    }
+    else
+    {
+      printf( "FAIL ultima3a.d64 tile set doesn't render the decoded tiles\n" );
+      passed = false;
+    }
 
-    int32_t tileColors[NUM_TILES];
-    for( int32_t i = 0; i < NUM_TILES; ++i )
+    // Encoding the decoded tiles back onto the disk mustn't change a sector
+    D64Image disk;
+    if( disk.Open( "ultima3a.d64" ) && EncodeTiles( surface, c64Palette, 16, disk ) == 0 &&
+        disk.NumChangedSectors() == 0 )
+    {
+      printf( "OK   ultima3a.d64 tiles re-encode to the same sectors\n" );
+    }
+    else
     {
-      tileColors[i] = infile.get();
+      printf( "FAIL ultima3a.d64 tiles don't re-encode to the same sectors\n" );
+      passed = false;
     }
+  }
+  else
+  {
+    printf( "FAIL can't open ultima3a.d64\n" );
+    passed = false;
+  }
+
+  return passed;
+}
+
+
+// The tiles, packed from the sheet of a normal run
+bool WritePack( const char* filename, bool compress )
+{
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( c64Palette, 16 ) };
+  IndexSurface surface;
+  std::vector<uint8_t> diskData;
+
+  if( !ReadDisk( std::vector<VicArtwork>(), diskData ) || !DecodeTiles( diskData, surface ) ||
+      writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
+
+  if( !writer.Save( filename, compress ) )
+  {
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
+  }
+
+  return true;
+}
+
+
+// Writes the pack, then keeps it up to date as the tiles are edited on the disk image
+bool WatchPack( const char* filename )
+{
+  TileWatch watch;
+  if( !AddWatchedInputs( watch ) || !WritePack( filename, false ) )
+  {
+    return false;
+  }
+
+  return watch.Run( filename, [&watch]( int32_t tile, uint8_t* dest, int32_t pitch )
+  {
+    DecodeWatchedTile( watch, tile, dest, pitch );
+  } );
+}
+
+
+// The tiles of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", c64Palette, 16 );
+  IndexSurface surface;
+  std::vector<uint8_t> diskData;
+
+  if( !ReadDisk( std::vector<VicArtwork>(), diskData ) || !DecodeTiles( diskData, surface ) ||
+      writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !SaveDatafile( filename, writer, compress ) )
+  {
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
 
-    // Tile data offset
-    infile.seekg( 0x8800, std::ios::beg );
+  return true;
+}
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
+
+  std::vector<VicArtwork> artwork;
+  Vic2Colors vicColors;
+  if( !ParseVicOptions( argc, argv, artwork, vicColors ) )
+  {
+    return -1;
+  }
 
-    int32_t posX{ 0 };
-    int32_t posY{ 0 };
+  if( HasVerifyOption( argc, argv ) )
+  {
+    return Verify() ? 0 : 1;
+  }
 
-    // Tiles are set up like this:
-    // The first 2 bytes represent the left-half and right half of the first tile, then the next 2-bytes are for
-    // the very top of the second tile This continues until the first row of all tiles are read. Each byte = 8
-    // pixels. 0 = not drawn, 1 = drawn.
-    for( int32_t k = 0; k < TILE_HEIGHT; ++k )
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--tileset" ) == 0 && i + 1 < argc )
     {
-      // Draw a single tile row for all tiles. Each tile row is represented by 2 bytes.
-      for( int32_t j = 0; j < NUM_TILES * 2; ++j )
+      std::vector<uint8_t> diskData;
+      C64TileSet set;
+      if( !ReadDisk( std::vector<VicArtwork>(), diskData ) || !BuildTileSet( diskData, set ) )
+      {
+        return -1;
+      }
+
+      if( !SaveC64TileSet( argv[i + 1], set ) )
       {
-        int32_t index{ j / 2 };
-        int32_t backIndex{ tileColors[index] & 0x0f }; // Background color
-        int32_t foreIndex{ tileColors[index] & 0xf0 }; // Foreground color
-        foreIndex = foreIndex >> 4;
+        printf( "%s: can't write the tile set\n", argv[i + 1] );
+        return -1;
+      }
 
-        int32_t val{ infile.get() };
+      return 0;
+    }
 
-        // Draw a single tile row
-        for( int32_t i = 0 ; i < TILE_HALF_WIDTH; ++i )
+    if( strcmp( argv[i], "--inject-tiles" ) == 0 && i + 2 < argc )
+    {
+      std::vector<std::string> diskFilenames;
+      for( int32_t j = i + 2; j < argc && strncmp( argv[j], "--", 2 ) != 0; ++j )
+      {
+        diskFilenames.push_back( argv[j] );
+      }
+
+      const char* outputDirectory{ nullptr };
+      for( int32_t j = 1; j + 1 < argc; ++j )
+      {
+        if( strcmp( argv[j], "--inject-into" ) == 0 )
         {
-          // We are only interested in the most significant bit per pass
-          const int32_t color{ val & 0x80 ? c64ColorPalette[foreIndex] : c64ColorPalette[backIndex] };
-          putpixel( backBuffer, posX, posY, color );
-
-          // Shift into most significant bit, keeping val to byte-size
-          val = ( val << 1 );
-          val &= 0xff;
-          ++posX;
+          outputDirectory = argv[j + 1];
         }
       }
 
-      ++posY;
-      posX = 0;
+      if( outputDirectory == nullptr )
+      {
+        printf( "--inject-tiles needs --inject-into DIR for the new images\n" );
+        return -1;
+      }
+
+      return InjectTiles( argv[i + 1], diskFilenames, outputDirectory ) ? 0 : -1;
     }
   }
 
-  infile.close();
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    if( HasWatchOption( argc, argv ) )
+    {
+      return WatchPack( packFilename ) ? 0 : -1;
+    }
+
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
+
+  if( allegro_init() != 0 )
+  {
+    allegro_message( "Allegro initialization failed" );
+    return -1;
+  }
+
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
+
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
+  }
+
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 1024, 768, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
+
+  int32_t c64ColorPalette[16];
+  MakeColorTable( c64Palette, 16, c64ColorPalette );
+
+  std::vector<uint8_t> diskData;
+  if( !ReadDisk( artwork, diskData ) )
+  {
+    return -1;
+  }
+
+  IndexSurface surface;
+  if( !DecodeTiles( diskData, surface ) )
+  {
+    return -1;
+  }
+
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, c64ColorPalette ) };
 
   // Optionally create a vertical strip
 #if EXPORT_VERTICAL_STRIP
@@ -140,14 +761,29 @@ int32_t main()
     }
   }
 
-  save_pcx( "tiles.pcx", backBuffer2, nullptr );
+  SavePcx( "tiles.pcx", backBuffer2 );
 
   destroy_bitmap( backBuffer2 );
 #else
-  save_pcx( "tiles.pcx", backBuffer, nullptr );
+  SavePcx( "tiles.pcx", backBuffer );
 #endif // EXPORT_VERTICAL_STRIP
 
   destroy_bitmap( backBuffer );
 
+  // ------------
+  // --vic artwork
+  // ------------
+
+  for( const VicArtwork& entry : artwork )
+  {
+    DecodeArtwork( diskData, entry, vicColors, surface );
+
+    backBuffer = CreateBitmapFromSurface( surface, c64ColorPalette );
+
+    SavePcx( entry.filename.c_str(), backBuffer );
+
+    destroy_bitmap( backBuffer );
+  }
+
   return 0;
 }
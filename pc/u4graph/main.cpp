@@ -8,14 +8,36 @@
 // The first byte will be either 0x00 or 0x01 which means use tile set 0 or tile set 1.
 // Nothing seems to be behind the mysteriously locked door :(
 
+// Run with --map PARTY.EXE to render that map to map.pcx instead of extracting the graphics. Tile set 0 is shapes.old;
+// tile set 1 comes from --map-tiles1 FILE, and set 1 tiles are left black without it. The map's size isn't known, so
+// it's given with --map-size WxH (64x64 by default, cut short at the end of the file), and --map-offset moves the
+// start. --map-region X,Y,W,H renders only those tiles for a quick preview.
+
+// Takes the options every ripper does that apply here (see ripper_options.h): --verify against the reference .png
+// files in this folder, --stats and --force-isa.
+
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/ega_decode.h"
+#include "../../util/tile_decode/mapped_file.h"
+#include "../../util/tile_decode/tile_map.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/ega_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/tile_map_verify.h"
+
 #define TILE_WIDTH    16
 #define TILE_HEIGHT   16
 #define NUM_TILES     256
@@ -37,218 +59,390 @@
 #define BORDER_WIDTH  320
 #define BORDER_HEIGHT 200
 
+// 2 pixels per byte
+#define EGA_PIXELS_PER_BYTE 2
 
-int32_t main()
+// PARTY.EXE map
+#define MAP_OFFSET         0xe370
+#define MAP_DEFAULT_WIDTH  64
+#define MAP_DEFAULT_HEIGHT 64
+#define MAP_MAX_SIZE       4096
+
+
+// Every RLE picture, used by --verify
+const char* rlePictures[] =
 {
-  if( allegro_init() != 0 )
+  "compassn", "courage", "honesty", "honor", "humility", "justice", "key7", "love", "rune_0", "rune_1", "rune_2",
+  "rune_3", "rune_4", "rune_5", "sacrific", "spirit", "start", "stoncrcl", "truth", "valor"
+};
+
+
+bool DecodeShapes( const char* filename, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    allegro_message("Allegro initialization failed");
-    return -1;
+    return false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  surface.Create( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeEgaPacked( fileData.data(), fileData.size(), TILE_BUFFER_WIDTH / EGA_PIXELS_PER_BYTE, surface.Row( 0 ),
+                   surface.pitch, TILE_BUFFER_HEIGHT );
+
+  return true;
+}
+
+
+bool DecodeCharset( const char* filename, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    depth = 16;
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  surface.Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeEgaPacked( fileData.data(), fileData.size(), CHAR_BUFFER_WIDTH / EGA_PIXELS_PER_BYTE, surface.Row( 0 ),
+                   surface.pitch, CHAR_BUFFER_HEIGHT );
+
+  return true;
+}
+
+
+bool DecodeRlePicture( const char* filename, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    return false;
   }
 
-  int32_t egaColorPalette[16] =
+  surface.Create( BORDER_WIDTH, BORDER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeEgaRle( fileData.data(), fileData.size(), surface.Row( 0 ), BORDER_WIDTH, BORDER_HEIGHT, surface.pitch );
+
+  return true;
+}
+
+
+// ---------------------
+// PARTY.EXE map
+// ---------------------
+
+struct MapOptions
+{
+  const char* filename{ nullptr };
+  const char* tiles1Filename{ nullptr };
+  long offset{ MAP_OFFSET };
+  int32_t width{ MAP_DEFAULT_WIDTH };
+  int32_t height{ MAP_DEFAULT_HEIGHT };
+  TileRegion region{ 0, 0, 0, 0 };
+  bool hasRegion{ false };
+};
+
+
+// Reads the --map options. Returns false (after printing why) if one is malformed.
+bool ParseMapOptions( int32_t argc, char* argv[], MapOptions& options )
+{
+  for( int32_t i = 1; i < argc; ++i )
   {
-    makecol( 0x00, 0x00, 0x00 ), // Black
-    makecol( 0x00, 0x00, 0xAA ), // Blue
-    makecol( 0x00, 0xAA, 0x00 ), // Green
-    makecol( 0x00, 0xAA, 0xAA ), // Cyan
-    makecol( 0xAA, 0x00, 0x00 ), // Red
-    makecol( 0xAA, 0x00, 0xAA ), // Magenta
-    makecol( 0xAA, 0x55, 0x00 ), // Brown
-    makecol( 0xAA, 0xAA, 0xAA ), // Light Gray
-    makecol( 0x55, 0x55, 0x55 ), // Dark Gray
-    makecol( 0x55, 0x55, 0xFF ), // Bright Blue
-    makecol( 0x55, 0xFF, 0x55 ), // Bright Green
-    makecol( 0x55, 0xFF, 0xFF ), // Bright Cyan
-    makecol( 0xFF, 0x55, 0x55 ), // Bright Red
-    makecol( 0xFF, 0x55, 0xFF ), // Bright Magenta
-    makecol( 0xFF, 0xFF, 0x55 ), // Bright Yellow
-    makecol( 0xFF, 0xFF, 0xFF ), // White
-  };
+    const bool hasValue{ i + 1 < argc };
 
-  // ---------------------
-  // Process tile graphics
-  // ---------------------
+    if( strcmp( argv[i], "--map" ) == 0 && hasValue )
+    {
+      options.filename = argv[++i];
+    }
+    else if( strcmp( argv[i], "--map-tiles1" ) == 0 && hasValue )
+    {
+      options.tiles1Filename = argv[++i];
+    }
+    else if( strcmp( argv[i], "--map-offset" ) == 0 && hasValue )
+    {
+      options.offset = strtol( argv[++i], nullptr, 0 );
+      if( options.offset < 0 )
+      {
+        printf( "--map-offset must not be negative\n" );
+        return false;
+      }
+    }
+    else if( strcmp( argv[i], "--map-size" ) == 0 && hasValue )
+    {
+      if( sscanf( argv[++i], "%dx%d", &options.width, &options.height ) != 2 || options.width <= 0 ||
+          options.height <= 0 || options.width > MAP_MAX_SIZE || options.height > MAP_MAX_SIZE )
+      {
+        printf( "--map-size expects WxH up to %dx%d, such as 64x64\n", MAP_MAX_SIZE, MAP_MAX_SIZE );
+        return false;
+      }
+    }
+    else if( strcmp( argv[i], "--map-region" ) == 0 && hasValue )
+    {
+      TileRegion& region{ options.region };
+      if( sscanf( argv[++i], "%d,%d,%d,%d", &region.x, &region.y, &region.width, &region.height ) != 4 )
+      {
+        printf( "--map-region expects X,Y,W,H in tiles\n" );
+        return false;
+      }
+
+      options.hasRegion = true;
+    }
+    else if( strncmp( argv[i], "--map", 5 ) == 0 )
+    {
+      printf( "%s needs a value\n", argv[i] );
+      return false;
+    }
+  }
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
+  return true;
+}
 
-  std::ifstream infile;
 
-  infile.open( "shapes.old", std::ios::in | std::ios::binary | std::ios::ate );
+// Draws the map straight out of the mapped executable. The atlas holds tile set 0 (shapes.old) followed by tile set
+// 1, so a 2-byte entry is its atlas tile number.
+bool RenderPartyMap( const MapOptions& options, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( options.filename );
 
-  if( !infile.is_open() )
+  MappedFile exe;
+  if( !exe.Open( options.filename ) )
   {
-    return -1;
+    printf( "Can't open %s\n", options.filename );
+    return false;
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  int32_t numBytes{ static_cast<int32_t>( infile.tellg() ) };
+  const int32_t rowBytes{ options.width * TileMapEntrySize( TILE_MAP_SET_AND_INDEX ) };
+  const size_t offset{ static_cast<size_t>( options.offset ) };
+  const size_t available{ exe.Size() > offset ? exe.Size() - offset : 0 };
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
+  TileMapView map;
+  map.data = exe.Data() + ( exe.Size() > offset ? offset : 0 );
+  map.width = options.width;
+  const size_t rowsAvailable{ available / rowBytes };
+  map.height = rowsAvailable < static_cast<size_t>( options.height ) ? static_cast<int32_t>( rowsAvailable )
+                                                                     : options.height;
+  map.stride = rowBytes;
+  map.encoding = TILE_MAP_SET_AND_INDEX;
 
-  int32_t x{ 0 };
-  int32_t y{ 0 };
+  if( map.height < options.height )
+  {
+    printf( "%s only holds %d map rows past offset 0x%lx\n", options.filename, map.height, options.offset );
+  }
 
-  int32_t currentBytes{ 0 };
-  int32_t lineNum{ 0 };
+  TileRegion region{ 0, 0, map.width, map.height };
+  if( options.hasRegion )
+  {
+    region = options.region;
+  }
 
-  while( currentBytes < numBytes )
+  if( !ClipTileRegion( map, region ) )
   {
-    x = 0;
+    printf( "The map region is empty\n" );
+    return false;
+  }
 
-    // Read and display the next 8 bytes
-    for( int32_t i = 0; i < 8; ++i )
+  TileAtlas atlas;
+  atlas.Create( TILE_WIDTH, TILE_HEIGHT );
+
+  IndexSurface tiles;
+  if( !DecodeShapes( "shapes.old", tiles ) )
+  {
+    printf( "Can't open shapes.old\n" );
+    return false;
+  }
+
+  atlas.AddStrip( tiles );
+
+  if( options.tiles1Filename != nullptr )
+  {
+    if( !DecodeShapes( options.tiles1Filename, tiles ) )
     {
-      // Display 2 pixels per byte
-      uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-      putpixel( backBuffer, x++, y, egaColorPalette[ (tileData >> 4) & 0xF ] );
-      putpixel( backBuffer, x++, y, egaColorPalette[ tileData & 0xF ] );
+      printf( "Can't open %s\n", options.tiles1Filename );
+      return false;
     }
 
-    y += 1;
+    atlas.AddStrip( tiles );
+  }
 
-    ++currentBytes;
+  // DecodeShapes() labels the stats with the tile file, so switch back for the render
+  INSTRUMENT_BEGIN_FILE( options.filename );
+  const int32_t numMissing{ RenderTileMap( atlas, map, region, surface ) };
+  if( numMissing > 0 )
+  {
+    printf( "%d map entries name tiles that weren't loaded and were left black\n", numMissing );
   }
 
-  infile.close();
+  return true;
+}
 
-  save_pcx( "shapes.pcx", backBuffer, nullptr );
 
-  destroy_bitmap( backBuffer );
+bool Verify()
+{
+  bool passed{ VerifyEgaKernels() };
+  passed &= VerifyDispatchKernels();
+  passed &= VerifyTileMapRenderer();
 
-  // ---------------------
-  // Process text graphics
-  // ---------------------
+  IndexSurface surface;
 
-  backBuffer = create_bitmap( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  if( DecodeShapes( "shapes.old", surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "shapes.old", surface, egaPalette, 16, "shapes.png", TILE_WIDTH, TILE_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open shapes.old\n" );
+    passed = false;
+  }
 
-  infile.open( "charset.old", std::ios::in | std::ios::binary | std::ios::ate );
+  if( DecodeCharset( "charset.old", surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "charset.old", surface, egaPalette, 16, "charset.png", CHAR_WIDTH,
+                                       CHAR_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open charset.old\n" );
+    passed = false;
+  }
 
-  if( !infile.is_open() )
+  for( const char* picture : rlePictures )
   {
-    return -1;
+    const std::string oldFilename{ std::string( picture ) + ".old" };
+    const std::string pngFilename{ std::string( picture ) + ".png" };
+
+    if( DecodeRlePicture( oldFilename.c_str(), surface ) )
+    {
+      passed &= VerifySurfaceAgainstPng( oldFilename.c_str(), surface, egaPalette, 16, pngFilename.c_str(),
+                                         BORDER_WIDTH, BORDER_HEIGHT );
+    }
+    else
+    {
+      printf( "FAIL can't open %s\n", oldFilename.c_str() );
+      passed = false;
+    }
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  numBytes = static_cast<int32_t>( infile.tellg() );
+  return passed;
+}
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
 
-  x = 0;
-  y = 0;
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
 
-  currentBytes = 0;
-  lineNum = 0;
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
 
-  while( currentBytes < numBytes )
+  if( HasVerifyOption( argc, argv ) )
   {
-    x = 0;
+    return Verify() ? 0 : 1;
+  }
 
-    // Read and display the next 4 bytes
-    for( int32_t i = 0; i < 4; ++i )
-    {
-      // Display 2 pixels per byte
-      uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-      putpixel( backBuffer, x++, y, egaColorPalette[( tileData >> 4 ) & 0xF] );
-      putpixel( backBuffer, x++, y, egaColorPalette[tileData & 0xF] );
-    }
+  MapOptions mapOptions;
+  if( !ParseMapOptions( argc, argv, mapOptions ) )
+  {
+    return -1;
+  }
 
-    y += 1;
+  if( allegro_init() != 0 )
+  {
+    allegro_message("Allegro initialization failed");
+    return -1;
+  }
 
-    ++currentBytes;
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
   }
 
-  infile.close();
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
 
-  save_pcx( "charset.pcx", backBuffer, nullptr );
+  int32_t egaColorPalette[16];
+  MakeColorTable( egaPalette, 16, egaColorPalette );
 
-  destroy_bitmap( backBuffer );
+  IndexSurface surface;
 
-  // -----------------------
-  // Border / codex graphics
-  // -----------------------
+  if( mapOptions.filename != nullptr )
+  {
+    if( !RenderPartyMap( mapOptions, surface ) )
+    {
+      return -1;
+    }
 
-  backBuffer = create_bitmap( BORDER_WIDTH, BORDER_HEIGHT );
+    BITMAP* mapBuffer{ CreateBitmapFromSurface( surface, egaColorPalette ) };
 
-  // Just replace this file with any of the .old files you'd like to extract.
-  // Rename the output file below as well.
-  infile.open( "start.old", std::ios::in | std::ios::binary | std::ios::ate );
+    SavePcx( "map.pcx", mapBuffer );
+
+    destroy_bitmap( mapBuffer );
 
-  if( !infile.is_open() )
+    return 0;
+  }
+
+  // ---------------------
+  // Process tile graphics
+  // ---------------------
+
+  if( !DecodeShapes( "shapes.old", surface ) )
   {
     return -1;
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  numBytes = static_cast<int32_t>( infile.tellg() );
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, egaColorPalette ) };
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
+  SavePcx( "shapes.pcx", backBuffer );
 
-  x = 0;
-  y = 0;
+  destroy_bitmap( backBuffer );
 
-  currentBytes = 0;
-  lineNum = 0;
+  // ---------------------
+  // Process text graphics
+  // ---------------------
 
-  while( currentBytes < numBytes )
+  if( !DecodeCharset( "charset.old", surface ) )
   {
-    const uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-    ++currentBytes;
+    return -1;
+  }
 
-    if( tileData == 0x2 )
-    {
-      // Handle the run of info
-      const uint8_t numPixels{ static_cast<uint8_t>( infile.get() ) };
-      ++currentBytes;
+  backBuffer = CreateBitmapFromSurface( surface, egaColorPalette );
 
-      const uint8_t color{ static_cast<uint8_t>( infile.get() ) };
-      ++currentBytes;
+  SavePcx( "charset.pcx", backBuffer );
 
-      for( uint16_t i = 0; i < numPixels; ++i )
-      {
-        putpixel( backBuffer, x++, y, egaColorPalette[( color >> 4 ) & 0xF] );
-        putpixel( backBuffer, x++, y, egaColorPalette[color & 0xF] );
-
-        if( x >= BORDER_WIDTH )
-        {
-          x = 0;
-          ++y;
-        }
-      }
-    }
-    else
-    {
-      // Simple pixel data
-      putpixel( backBuffer, x++, y, egaColorPalette[( tileData >> 4 ) & 0xF] );
-      putpixel( backBuffer, x++, y, egaColorPalette[tileData & 0xF] );
-    }
+  destroy_bitmap( backBuffer );
 
-    if( x >= BORDER_WIDTH )
-    {
-      x = 0;
-      ++y;
-    }
+  // -----------------------
+  // Border / codex graphics
+  // -----------------------
+
+  // Just replace this file with any of the .old files you'd like to extract.
+  // Rename the output file below as well.
+  if( !DecodeRlePicture( "start.old", surface ) )
+  {
+    return -1;
   }
 
-  infile.close();
+  backBuffer = CreateBitmapFromSurface( surface, egaColorPalette );
 
-  save_pcx( "start.pcx", backBuffer, nullptr );
+  SavePcx( "start.pcx", backBuffer );
 
   destroy_bitmap( backBuffer );
 
@@ -3,14 +3,60 @@
 
 // Also extracts any of the RLE intro and engame files, such as start.ega and key7.ega.
 
+// Rips the CGA release and the VGA upgrade in the same run when their files are in the folder: shapes.cga,
+// charset.cga and the .pic pictures become *_cga.pcx, and shapes.vga, charset.vga and any .vga pictures become
+// *_vga.pcx in the colors of u4vga.pal. Pictures are recognized by the size they expand to, so an upgraded .ega file
+// comes out right too.
+
+// Renders the 256x256 tile world to a 4096x4096 world.pcx when world.map is in the folder too.
+// Run with --pyramid DIR to write the world as a deep-zoom pyramid of 256x256 PNG tiles under DIR instead (see
+// tile_pyramid.h), smoothly filtered, or with --pixel-art to keep every zoom level's pixels hard-edged.
+
+// Run with --encode-rle DIR to go the other way: every picture above that has an edited NAME.png in DIR is encoded
+// back into DIR/NAME.ega, ready to copy into the game. The colors are matched to the EGA palette.
+
+// Takes the options every ripper does (see ripper_options.h): --verify against the reference .png files in this
+// folder, --pack and --datafile with the tiles and characters (the datafile gets the EGA pictures too), --stats and
+// --force-isa. --watch patches the pack whenever shapes.ega or charset.ega is saved.
+
 #define ALLEGRO_NO_MAGIC_MAIN
 #define ALLEGRO_STATICLINK 1
 
-#include <fstream>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <string>
 
 #include "../../allegro/include/allegro.h"
 #include "../../allegro/include/winalleg.h"
 
+#include "../../util/instrument/instrument.h"
+#include "../../util/png/png_reader.h"
+#include "../../util/pyramid/tile_pyramid.h"
+#include "../../util/tile_decode/allegro_surface.h"
+#include "../../util/tile_decode/cga_decode.h"
+#include "../../util/tile_decode/cpu_dispatch.h"
+#include "../../util/tile_decode/chunked_map.h"
+#include "../../util/tile_decode/ega_decode.h"
+#include "../../util/tile_decode/ega_encode.h"
+#include "../../util/tile_decode/mapped_file.h"
+#include "../../util/tile_decode/parallel.h"
+#include "../../util/tile_decode/vga_decode.h"
+#include "../../util/tile_decode/tile_pack.h"
+#include "../../util/tile_decode/ripper_options.h"
+#include "../../util/verify/cga_vga_verify.h"
+#include "../../util/verify/chunked_map_verify.h"
+#include "../../util/verify/datafile_verify.h"
+#include "../../util/verify/ega_encode_verify.h"
+#include "../../util/verify/ega_verify.h"
+#include "../../util/verify/golden_verify.h"
+#include "../../util/verify/lzw_verify.h"
+#include "../../util/verify/png_writer_verify.h"
+#include "../../util/verify/sniff_verify.h"
+#include "../../util/verify/tile_pack_verify.h"
+#include "../../util/verify/tile_watch_verify.h"
+#include "../../util/watch/tile_watch.h"
+
 #define TILE_WIDTH    16
 #define TILE_HEIGHT   16
 #define NUM_TILES     256
@@ -32,220 +78,744 @@
 #define BORDER_WIDTH  320
 #define BORDER_HEIGHT 200
 
+// 2 pixels per byte
+#define EGA_PIXELS_PER_BYTE 2
 
-int32_t main()
+// world.map is 8x8 chunks of 32x32 tiles, one byte per tile, stored chunk after chunk
+#define WORLD_CHUNKS_WIDE   8
+#define WORLD_CHUNKS_HIGH   8
+#define WORLD_CHUNK_WIDTH   32
+#define WORLD_CHUNK_HEIGHT  32
+
+
+// The formats an RLE picture can expand to
+enum PictureFormat
 {
-  if( allegro_init() != 0 )
+  PICTURE_EGA,
+  PICTURE_CGA,
+  PICTURE_VGA,
+  PICTURE_ANY
+};
+
+
+// Every RLE picture, used by --verify
+const char* rlePictures[] =
+{
+  "compassn", "courage", "honesty", "honor", "humility", "justice", "key7", "love", "rune_0", "rune_1", "rune_2",
+  "rune_3", "rune_4", "rune_5", "sacrific", "spirit", "start", "stoncrcl", "truth", "valor"
+};
+
+
+bool DecodeShapes( const char* filename, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    allegro_message("Allegro initialization failed");
-    return -1;
+    return false;
   }
 
-  int32_t depth{ 0 };
-  if( ( depth = desktop_color_depth() ) != 0 )
+  surface.Create( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeEgaPacked( fileData.data(), fileData.size(), TILE_BUFFER_WIDTH / EGA_PIXELS_PER_BYTE, surface.Row( 0 ),
+                   surface.pitch, TILE_BUFFER_HEIGHT );
+
+  return true;
+}
+
+
+bool DecodeCharset( const char* filename, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    depth = 16;
+    return false;
   }
 
-  set_color_depth( depth );
-  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  surface.Create( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeEgaPacked( fileData.data(), fileData.size(), CHAR_BUFFER_WIDTH / EGA_PIXELS_PER_BYTE, surface.Row( 0 ),
+                   surface.pitch, CHAR_BUFFER_HEIGHT );
+
+  return true;
+}
+
+
+bool DecodeCgaSheet( const char* filename, int32_t itemWidth, int32_t itemHeight, int32_t numItems,
+                     IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
+
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    allegro_message( "Failed to set graphics mode" );
-    return -1;
+    return false;
   }
 
-  int32_t egaColorPalette[16] =
-  {
-    makecol( 0x00, 0x00, 0x00 ), // Black
-    makecol( 0x00, 0x00, 0xAA ), // Blue
-    makecol( 0x00, 0xAA, 0x00 ), // Green
-    makecol( 0x00, 0xAA, 0xAA ), // Cyan
-    makecol( 0xAA, 0x00, 0x00 ), // Red
-    makecol( 0xAA, 0x00, 0xAA ), // Magenta
-    makecol( 0xAA, 0x55, 0x00 ), // Brown
-    makecol( 0xAA, 0xAA, 0xAA ), // Light Gray
-    makecol( 0x55, 0x55, 0x55 ), // Dark Gray
-    makecol( 0x55, 0x55, 0xFF ), // Bright Blue
-    makecol( 0x55, 0xFF, 0x55 ), // Bright Green
-    makecol( 0x55, 0xFF, 0xFF ), // Bright Cyan
-    makecol( 0xFF, 0x55, 0x55 ), // Bright Red
-    makecol( 0xFF, 0x55, 0xFF ), // Bright Magenta
-    makecol( 0xFF, 0xFF, 0x55 ), // Bright Yellow
-    makecol( 0xFF, 0xFF, 0xFF ), // White
-  };
+  surface.Create( itemWidth, itemHeight * numItems );
 
-  // ---------------------
-  // Process tile graphics
-  // ---------------------
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeCgaPacked( fileData.data(), fileData.size(), CgaItemLayout( itemWidth, itemHeight ), surface.Row( 0 ),
+                   surface.pitch, surface.height );
 
-  BITMAP* backBuffer{ create_bitmap( TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT ) };
+  return true;
+}
 
-  std::ifstream infile;
 
-  infile.open( "shapes.ega", std::ios::in | std::ios::binary | std::ios::ate );
+bool DecodeVgaSheet( const char* filename, int32_t width, int32_t height, IndexSurface& surface )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
 
-  if( !infile.is_open() )
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    return -1;
+    return false;
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  int32_t numBytes{ static_cast<int32_t>( infile.tellg() ) };
+  surface.Create( width, height );
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+  DecodeVgaPacked( fileData.data(), fileData.size(), width, surface.Row( 0 ), surface.pitch, height );
+
+  return true;
+}
 
-  int32_t x{ 0 };
-  int32_t y{ 0 };
 
-  int32_t currentBytes{ 0 };
-  int32_t lineNum{ 0 };
+// EGA pictures decode straight from the RLE. CGA and VGA pictures are expanded to bytes first and then unpacked.
+// Pictures that don't expand to the only format are skipped without being decoded, returning false.
+bool DecodeRlePicture( const char* filename, IndexSurface& surface, PictureFormat* format = nullptr,
+                       PictureFormat only = PICTURE_ANY )
+{
+  INSTRUMENT_BEGIN_FILE( filename );
 
-  while( currentBytes < numBytes )
+  std::vector<uint8_t> fileData;
+  if( !ReadFileBytes( filename, fileData ) )
   {
-    x = 0;
+    return false;
+  }
 
-    // Read and display the next 8 bytes
-    for( int32_t i = 0; i < 8; ++i )
-    {
-      // Display 2 pixels per byte
-      uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-      putpixel( backBuffer, x++, y, egaColorPalette[ (tileData >> 4) & 0xF ] );
-      putpixel( backBuffer, x++, y, egaColorPalette[ tileData & 0xF ] );
-    }
+  // The expanded size tells the formats apart, and takes a scan of the run lengths, not a decode
+  const size_t expandedSize{ EgaRleExpandedSize( fileData.data(), fileData.size() ) };
+  const bool cga{ expandedSize == CGA_SCREEN_SIZE || expandedSize == CGA_SCREEN_DUMP_SIZE };
+  const bool vga{ expandedSize == VGA_SCREEN_SIZE };
+  const PictureFormat pictureFormat{ cga ? PICTURE_CGA : ( vga ? PICTURE_VGA : PICTURE_EGA ) };
 
-    y += 1;
+  if( format != nullptr )
+  {
+    *format = pictureFormat;
+  }
 
-    ++currentBytes;
+  if( only != PICTURE_ANY && pictureFormat != only )
+  {
+    return false;
   }
 
-  infile.close();
+  surface.Create( BORDER_WIDTH, BORDER_HEIGHT );
 
-  save_pcx( "shapes.pcx", backBuffer, nullptr );
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
 
-  destroy_bitmap( backBuffer );
+  if( !cga && !vga )
+  {
+    DecodeEgaRle( fileData.data(), fileData.size(), surface.Row( 0 ), BORDER_WIDTH, BORDER_HEIGHT, surface.pitch );
+    return true;
+  }
 
-  // ---------------------
-  // Process text graphics
-  // ---------------------
+  std::vector<uint8_t> expanded( expandedSize );
+  ExpandEgaRle( fileData.data(), fileData.size(), expanded.data(), expanded.size() );
 
-  backBuffer = create_bitmap( CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT );
+  if( cga )
+  {
+    DecodeCgaPacked( expanded.data(), expanded.size(), CgaScreenLayout( expandedSize ), surface.Row( 0 ),
+                     surface.pitch, BORDER_HEIGHT );
+  }
+  else
+  {
+    DecodeVgaPacked( expanded.data(), expanded.size(), BORDER_WIDTH, surface.Row( 0 ), surface.pitch,
+                     BORDER_HEIGHT );
+  }
+
+  return true;
+}
 
-  infile.open( "charset.ega", std::ios::in | std::ios::binary | std::ios::ate );
 
-  if( !infile.is_open() )
+// Draws world.map with the shapes.ega tiles, straight out of the mapped file. Returns false if either file is missing
+// or the map is short.
+bool RenderWorldMap( const char* filename, IndexSurface& surface )
+{
+  IndexSurface tiles;
+  if( !DecodeShapes( "shapes.ega", tiles ) )
   {
-    return -1;
+    return false;
   }
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  numBytes = static_cast<int32_t>( infile.tellg() );
+  TileAtlas atlas;
+  atlas.Create( TILE_WIDTH, TILE_HEIGHT );
+  atlas.AddStrip( tiles );
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
+  INSTRUMENT_BEGIN_FILE( filename );
 
-  x = 0;
-  y = 0;
+  MappedFile mapFile;
+  if( !mapFile.Open( filename ) )
+  {
+    printf( "No %s, skipping the world map\n", filename );
+    return false;
+  }
 
-  currentBytes = 0;
-  lineNum = 0;
+  const ChunkedMapLayout layout{ WORLD_CHUNKS_WIDE, WORLD_CHUNKS_HIGH, WORLD_CHUNK_WIDTH, WORLD_CHUNK_HEIGHT };
 
-  while( currentBytes < numBytes )
+  ChunkedMapStats stats;
+  if( !RenderChunkedMap( atlas, mapFile.Data(), mapFile.Size(), layout, surface, 0, &stats ) )
   {
-    x = 0;
+    printf( "%s is %d bytes, expected %d\n", filename, static_cast<int32_t>( mapFile.Size() ),
+            static_cast<int32_t>( ChunkedMapSize( layout ) ) );
+    return false;
+  }
+
+  printf( "%s: drew %d distinct chunks of %d\n", filename, stats.numDistinctChunks, stats.numChunks );
+  return true;
+}
 
-    // Read and display the next 4 bytes
-    for( int32_t i = 0; i < 4; ++i )
+
+bool HasOption( int32_t argc, char* argv[], const char* option )
+{
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], option ) == 0 )
     {
-      // Display 2 pixels per byte
-      uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-      putpixel( backBuffer, x++, y, egaColorPalette[( tileData >> 4 ) & 0xF] );
-      putpixel( backBuffer, x++, y, egaColorPalette[tileData & 0xF] );
+      return true;
     }
+  }
 
-    y += 1;
+  return false;
+}
 
-    ++currentBytes;
+
+// Headless, like --verify: the tiles are written as PNGs straight from the index surface
+bool BuildWorldPyramid( const char* directory, bool pixelArt )
+{
+  IndexSurface surface;
+  if( !RenderWorldMap( "world.map", surface ) )
+  {
+    return false;
+  }
+
+  PyramidStats stats;
+  if( !BuildTilePyramid( surface, egaPalette, 16, directory, pixelArt ? PYRAMID_NEAREST : PYRAMID_BOX, 0, &stats ) )
+  {
+    return false;
+  }
+
+  printf( "%s: %d levels, wrote %d of %d tiles (the rest were unchanged)\n", directory, stats.numLevels,
+          stats.numWritten, stats.numTiles );
+  return true;
+}
+
+
+// Headless too. The pictures are independent, so they are read, encoded and written in parallel.
+bool EncodeRlePictures( const char* directory )
+{
+  const int32_t numPictures{ static_cast<int32_t>( sizeof( rlePictures ) / sizeof( rlePictures[0] ) ) };
+
+  // Per picture: nullptr and no size if there's no PNG for it, or an error message if it failed
+  std::vector<const char*> errors( numPictures, nullptr );
+  std::vector<size_t> sizes( numPictures, 0 );
+
+  ParallelFor( numPictures, 0, [&]( int32_t index )
+  {
+    const std::string base{ std::string( directory ) + "/" + rlePictures[index] };
+
+    std::vector<uint8_t> bytes;
+    if( !ReadFileBytes( ( base + ".png" ).c_str(), bytes ) )
+    {
+      return;
+    }
+
+    PngImage image;
+    if( !DecodePng( bytes.data(), bytes.size(), image, errors[index] ) )
+    {
+      return;
+    }
+
+    MapToEgaPalette( image.indices, image.palette.data(), static_cast<int32_t>( image.palette.size() ) );
+
+    std::vector<uint8_t> encoded;
+    EncodeEgaRlePicture( image.indices, encoded );
+
+    if( !WriteFileBytes( ( base + ".ega" ).c_str(), encoded ) )
+    {
+      errors[index] = "can't write the .ega file";
+      return;
+    }
+
+    sizes[index] = encoded.size();
+  } );
+
+  int32_t numEncoded{ 0 };
+  bool passed{ true };
+  for( int32_t i = 0; i < numPictures; ++i )
+  {
+    if( errors[i] != nullptr )
+    {
+      printf( "%s/%s.png: %s\n", directory, rlePictures[i], errors[i] );
+      passed = false;
+    }
+    else if( sizes[i] > 0 )
+    {
+      printf( "%s/%s.ega: %d bytes\n", directory, rlePictures[i], static_cast<int32_t>( sizes[i] ) );
+      ++numEncoded;
+    }
   }
 
-  infile.close();
+  printf( "%s: encoded %d pictures\n", directory, numEncoded );
+  return passed;
+}
+
+
+template<size_t N>
+void SaveSurfacePcx( const char* filename, const IndexSurface& surface, const int32_t ( &colorTable )[N] )
+{
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, colorTable ) };
 
-  save_pcx( "charset.pcx", backBuffer, nullptr );
+  SavePcx( filename, backBuffer );
 
   destroy_bitmap( backBuffer );
+}
 
-  // -----------------------
-  // Border / codex graphics
-  // -----------------------
 
-  backBuffer = create_bitmap( BORDER_WIDTH, BORDER_HEIGHT );
+// Writes NAME_SUFFIX.pcx for every RLE picture NAME.EXTENSION in the folder that expands to the expected format.
+// Others are skipped quietly, since the .ega names hold either EGA pictures or the upgrade's replacements.
+template<size_t N>
+void RipPictures( const char* extension, PictureFormat expected, const char* suffix,
+                  const int32_t ( &colorTable )[N] )
+{
+  IndexSurface surface;
 
-  // Just replace this file with any of the .ega files you'd like to extract.
-  // Adjust the width and height if needed, and rename the output file below as well.
-  infile.open( "start.ega", std::ios::in | std::ios::binary | std::ios::ate );
+  for( const char* picture : rlePictures )
+  {
+    const std::string filename{ std::string( picture ) + extension };
+    if( DecodeRlePicture( filename.c_str(), surface, nullptr, expected ) )
+    {
+      SaveSurfacePcx( ( std::string( picture ) + "_" + suffix + ".pcx" ).c_str(), surface, colorTable );
+    }
+  }
+}
+
+
+// The CGA release, when its files are in the folder
+void RipCga()
+{
+  int32_t cgaColorPalette[4];
+  MakeColorTable( cgaPalette, 4, cgaColorPalette );
 
-  if( !infile.is_open() )
+  IndexSurface surface;
+
+  if( DecodeCgaSheet( "shapes.cga", TILE_WIDTH, TILE_HEIGHT, NUM_TILES, surface ) )
   {
-    return -1;
+    SaveSurfacePcx( "shapes_cga.pcx", surface, cgaColorPalette );
+  }
+
+  if( DecodeCgaSheet( "charset.cga", CHAR_WIDTH, CHAR_HEIGHT, NUM_CHARS, surface ) )
+  {
+    SaveSurfacePcx( "charset_cga.pcx", surface, cgaColorPalette );
+  }
+
+  RipPictures( ".pic", PICTURE_CGA, "cga", cgaColorPalette );
+}
+
+
+// The VGA upgrade, when u4vga.pal is in the folder. The palette is loaded once for every file.
+void RipVga()
+{
+  std::vector<uint8_t> paletteData;
+  if( !ReadFileBytes( "u4vga.pal", paletteData ) )
+  {
+    return;
+  }
+
+  PaletteEntry vgaPalette[VGA_PALETTE_SIZE];
+  if( !LoadVgaPalette( paletteData.data(), paletteData.size(), vgaPalette ) )
+  {
+    printf( "u4vga.pal is %d bytes, expected %d\n", static_cast<int32_t>( paletteData.size() ),
+            VGA_PALETTE_FILE_SIZE );
+    return;
+  }
+
+  int32_t vgaColorPalette[VGA_PALETTE_SIZE];
+  MakeColorTable( vgaPalette, VGA_PALETTE_SIZE, vgaColorPalette );
+
+  IndexSurface surface;
+
+  if( DecodeVgaSheet( "shapes.vga", TILE_BUFFER_WIDTH, TILE_BUFFER_HEIGHT, surface ) )
+  {
+    SaveSurfacePcx( "shapes_vga.pcx", surface, vgaColorPalette );
+  }
+
+  if( DecodeVgaSheet( "charset.vga", CHAR_BUFFER_WIDTH, CHAR_BUFFER_HEIGHT, surface ) )
+  {
+    SaveSurfacePcx( "charset_vga.pcx", surface, vgaColorPalette );
+  }
+
+  RipPictures( ".vga", PICTURE_VGA, "vga", vgaColorPalette );
+  RipPictures( ".ega", PICTURE_VGA, "vga", vgaColorPalette );
+}
+
+
+// The inputs --watch follows, in the order AddWatchedInputs() adds them
+enum WatchedInput
+{
+  WATCHED_SHAPES,
+  WATCHED_CHARSET
+};
+
+
+// Both files are rows of packed pixels, one tile or character after another, which makes them the pack's tiles and
+// then its characters
+bool AddWatchedInputs( TileWatch& watch )
+{
+  const int32_t tileRowBytes{ TILE_WIDTH / EGA_PIXELS_PER_BYTE };
+  const int32_t charRowBytes{ CHAR_WIDTH / EGA_PIXELS_PER_BYTE };
+
+  if( watch.AddInput( "shapes.ega" ) != WATCHED_SHAPES || watch.AddInput( "charset.ega" ) != WATCHED_CHARSET )
+  {
+    return false;
+  }
+
+  watch.AddLayout( WATCHED_SHAPES, TileByteLayout{ 0, tileRowBytes * TILE_HEIGHT, tileRowBytes, tileRowBytes,
+                                                   TILE_HEIGHT, NUM_TILES, 0 } );
+  watch.AddLayout( WATCHED_CHARSET, TileByteLayout{ 0, charRowBytes * CHAR_HEIGHT, charRowBytes, charRowBytes,
+                                                    CHAR_HEIGHT, NUM_CHARS, NUM_TILES } );
+  return true;
+}
+
+
+// Decodes one pack tile from the watched files, as DecodeShapes() and DecodeCharset() would have
+void DecodeWatchedTile( const TileWatch& watch, int32_t packTile, uint8_t* dest, int32_t pitch )
+{
+  const bool isChar{ packTile >= NUM_TILES };
+  const std::vector<uint8_t>& bytes{ watch.Bytes( isChar ? WATCHED_CHARSET : WATCHED_SHAPES ) };
+  const int32_t rowBytes{ ( isChar ? CHAR_WIDTH : TILE_WIDTH ) / EGA_PIXELS_PER_BYTE };
+  const int32_t height{ isChar ? CHAR_HEIGHT : TILE_HEIGHT };
+  const size_t offset{ static_cast<size_t>( isChar ? packTile - NUM_TILES : packTile ) * rowBytes * height };
+
+  if( offset < bytes.size() )
+  {
+    DecodeEgaPacked( &bytes[offset], bytes.size() - offset, rowBytes, dest, pitch, height );
   }
+}
 
-  // Get file size (note that the first file was opened with ios::ate so the size can be fetched)
-  numBytes = static_cast<int32_t>( infile.tellg() );
 
-  // Reset to the beginning
-  infile.seekg( 0, std::ios::beg );
+bool Verify()
+{
+  bool passed{ VerifyEgaKernels() };
+  passed &= VerifyCgaVgaDecoders();
+  passed &= VerifyEgaRleEncoder();
+  passed &= VerifyDispatchKernels();
+  passed &= VerifyChunkedMapRenderer();
+  passed &= VerifyPngWriter();
+  passed &= VerifyTilePack();
+  passed &= VerifyDatafileWriter();
+  passed &= VerifyTileWatch();
+
+  IndexSurface surface;
+  TileWatch watch;
+  const bool watched{ AddWatchedInputs( watch ) };
+  auto decodeWatchedTile = [&watch]( int32_t packTile, uint8_t* dest, int32_t pitch )
+  {
+    DecodeWatchedTile( watch, packTile, dest, pitch );
+  };
 
-  x = 0;
-  y = 0;
+  if( DecodeShapes( "shapes.ega", surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "shapes.ega", surface, egaPalette, 16, "shapes.png", TILE_WIDTH, TILE_HEIGHT );
+    passed &= VerifySheetPack( "shapes.ega", surface, egaPalette, 16, TILE_WIDTH, TILE_HEIGHT );
+    passed &= watched && VerifyTilesDecodeAlone( "shapes.ega", surface, TILE_WIDTH, TILE_HEIGHT, 0, decodeWatchedTile );
+    passed &= VerifySniffedGeometry( "shapes.ega", "shapes.ega", SNIFF_4BPP, TILE_WIDTH / EGA_PIXELS_PER_BYTE,
+                                     TILE_WIDTH, TILE_HEIGHT );
+  }
+  else
+  {
+    printf( "FAIL can't open shapes.ega\n" );
+    passed = false;
+  }
 
-  currentBytes = 0;
-  lineNum = 0;
+  if( DecodeCharset( "charset.ega", surface ) )
+  {
+    passed &= VerifySurfaceAgainstPng( "charset.ega", surface, egaPalette, 16, "charset.png", CHAR_WIDTH,
+                                       CHAR_HEIGHT );
+    passed &= watched &&
+              VerifyTilesDecodeAlone( "charset.ega", surface, CHAR_WIDTH, CHAR_HEIGHT, NUM_TILES, decodeWatchedTile );
+  }
+  else
+  {
+    printf( "FAIL can't open charset.ega\n" );
+    passed = false;
+  }
 
-  while( currentBytes < numBytes )
+  for( const char* picture : rlePictures )
   {
-    const uint8_t tileData{ static_cast<uint8_t>( infile.get() ) };
-    ++currentBytes;
+    const std::string egaFilename{ std::string( picture ) + ".ega" };
+    const std::string pngFilename{ std::string( picture ) + ".png" };
 
-    if( tileData == 0x2 )
+    if( DecodeRlePicture( egaFilename.c_str(), surface ) )
     {
-      // Handle the run of info
-      const uint8_t numPixels{ static_cast<uint8_t>( infile.get() ) };
-      ++currentBytes;
+      passed &= VerifySurfaceAgainstPng( egaFilename.c_str(), surface, egaPalette, 16, pngFilename.c_str(),
+                                         BORDER_WIDTH, BORDER_HEIGHT );
+    }
+    else
+    {
+      printf( "FAIL can't open %s\n", egaFilename.c_str() );
+      passed = false;
+    }
+  }
+
+  // The game's own files, through the LZW encoder that lzwpack puts edited ones back with
+  std::vector<std::string> lzwFiles{ "shapes.ega", "charset.ega" };
+  for( const char* picture : rlePictures )
+  {
+    lzwFiles.push_back( std::string( picture ) + ".ega" );
+  }
+
+  passed &= VerifyLzwEncoder( lzwFiles );
+
+  return passed;
+}
+
+
+// The tiles, then the characters, packed from the sheets of a normal run
+bool WritePack( const char* filename, bool compress )
+{
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( egaPalette, 16 ) };
+  IndexSurface surface;
+
+  if( !DecodeShapes( "shapes.ega", surface ) || writer.AddSheet( surface, TILE_WIDTH, TILE_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
+
+  if( !DecodeCharset( "charset.ega", surface ) || writer.AddSheet( surface, CHAR_WIDTH, CHAR_HEIGHT, palette ) < 0 )
+  {
+    return false;
+  }
+
+  if( !writer.Save( filename, compress ) )
+  {
+    printf( "%s: can't write the tile pack\n", filename );
+    return false;
+  }
+
+  return true;
+}
+
+
+// Writes the pack, then keeps it up to date as the tiles and characters are edited
+bool WatchPack( const char* filename )
+{
+  TileWatch watch;
+  if( !AddWatchedInputs( watch ) || !WritePack( filename, false ) )
+  {
+    return false;
+  }
+
+  return watch.Run( filename, [&watch]( int32_t packTile, uint8_t* dest, int32_t pitch )
+  {
+    DecodeWatchedTile( watch, packTile, dest, pitch );
+  } );
+}
+
+
+// The tiles, characters and pictures of a normal run, one datafile object each
+bool WriteDatafile( const char* filename, bool compress )
+{
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", egaPalette, 16 );
+  IndexSurface surface;
 
-      const uint8_t color{ static_cast<uint8_t>( infile.get() ) };
-      ++currentBytes;
+  if( !DecodeShapes( "shapes.ega", surface ) || writer.AddSheet( "TILE", surface, TILE_WIDTH, TILE_HEIGHT ) == 0 )
+  {
+    return false;
+  }
+
+  if( !DecodeCharset( "charset.ega", surface ) || writer.AddSheet( "CHAR", surface, CHAR_WIDTH, CHAR_HEIGHT ) == 0 )
+  {
+    return false;
+  }
 
-      for( uint16_t i = 0; i < numPixels; ++i )
+  // Whole pictures, named after their files. Missing ones, and the CGA and VGA upgrades, are left out.
+  for( const char* name : rlePictures )
+  {
+    if( DecodeRlePicture( ( std::string( name ) + ".ega" ).c_str(), surface, nullptr, PICTURE_EGA ) )
+    {
+      std::string objectName{ name };
+      for( char& letter : objectName )
       {
-        putpixel( backBuffer, x++, y, egaColorPalette[( color >> 4 ) & 0xF] );
-        putpixel( backBuffer, x++, y, egaColorPalette[color & 0xF] );
-
-        if( x >= BORDER_WIDTH )
-        {
-          x = 0;
-          ++y;
-        }
+        letter = static_cast<char>( toupper( letter ) );
       }
+
+      writer.AddBitmap( objectName.c_str(), surface.Row( 0 ), surface.pitch, surface.width, surface.height );
     }
-    else
+  }
+
+  if( !SaveDatafile( filename, writer, compress ) )
+  {
+    printf( "%s: can't write the datafile\n", filename );
+    return false;
+  }
+
+  return true;
+}
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
+
+  if( HasVerifyOption( argc, argv ) )
+  {
+    return Verify() ? 0 : 1;
+  }
+
+  for( int32_t i = 1; i + 1 < argc; ++i )
+  {
+    if( strcmp( argv[i], "--pyramid" ) == 0 )
+    {
+      return BuildWorldPyramid( argv[i + 1], HasOption( argc, argv, "--pixel-art" ) ) ? 0 : -1;
+    }
+
+    if( strcmp( argv[i], "--encode-rle" ) == 0 )
     {
-      // Simple pixel data
-      putpixel( backBuffer, x++, y, egaColorPalette[( tileData >> 4 ) & 0xF] );
-      putpixel( backBuffer, x++, y, egaColorPalette[tileData & 0xF] );
+      return EncodeRlePictures( argv[i + 1] ) ? 0 : -1;
     }
+  }
 
-    if( x >= BORDER_WIDTH )
+  bool compressPack{ false };
+  const char* packFilename{ FindPackOption( argc, argv, compressPack ) };
+  if( packFilename != nullptr )
+  {
+    // Packed straight from the decoded sheets, so this runs headless too
+    if( HasWatchOption( argc, argv ) )
     {
-      x = 0;
-      ++y;
+      return WatchPack( packFilename ) ? 0 : -1;
     }
+
+    return WritePack( packFilename, compressPack ) ? 0 : -1;
+  }
+
+  if( allegro_init() != 0 )
+  {
+    allegro_message("Allegro initialization failed");
+    return -1;
   }
 
-  infile.close();
+  // Datafile objects are 8-bit whatever the screen is, so this doesn't open a window
+  bool compressDatafile{ false };
+  const char* datafileName{ FindDatafileOption( argc, argv, compressDatafile ) };
+  if( datafileName != nullptr )
+  {
+    return WriteDatafile( datafileName, compressDatafile ) ? 0 : -1;
+  }
+
+  int32_t depth{ 0 };
+  if( ( depth = desktop_color_depth() ) != 0 )
+  {
+    depth = 16;
+  }
+
+  set_color_depth( depth );
+  if( set_gfx_mode( GFX_AUTODETECT_WINDOWED, 640, 480, 0, 0 ) != 0 )
+  {
+    allegro_message( "Failed to set graphics mode" );
+    return -1;
+  }
 
-  save_pcx( "start.pcx", backBuffer, nullptr );
+  int32_t egaColorPalette[16];
+  MakeColorTable( egaPalette, 16, egaColorPalette );
+
+  IndexSurface surface;
+
+  // ---------------------
+  // Process tile graphics
+  // ---------------------
+
+  if( !DecodeShapes( "shapes.ega", surface ) )
+  {
+    return -1;
+  }
+
+  BITMAP* backBuffer{ CreateBitmapFromSurface( surface, egaColorPalette ) };
+
+  SavePcx( "shapes.pcx", backBuffer );
+
+  destroy_bitmap( backBuffer );
+
+  // ---------------------
+  // Process text graphics
+  // ---------------------
+
+  if( !DecodeCharset( "charset.ega", surface ) )
+  {
+    return -1;
+  }
+
+  backBuffer = CreateBitmapFromSurface( surface, egaColorPalette );
+
+  SavePcx( "charset.pcx", backBuffer );
 
   destroy_bitmap( backBuffer );
 
+  // -----------------------
+  // Border / codex graphics
+  // -----------------------
+
+  // Just replace this file with any of the .ega files you'd like to extract.
+  // Adjust the width and height if needed, and rename the output file below as well.
+  PictureFormat format;
+  if( !DecodeRlePicture( "start.ega", surface, &format ) )
+  {
+    return -1;
+  }
+
+  // An upgraded start.ega is written by RipVga() instead
+  if( format == PICTURE_EGA )
+  {
+    SaveSurfacePcx( "start.pcx", surface, egaColorPalette );
+  }
+
+  // ---------
+  // World map
+  // ---------
+
+  if( RenderWorldMap( "world.map", surface ) )
+  {
+    backBuffer = CreateBitmapFromSurface( surface, egaColorPalette );
+
+    SavePcx( "world.pcx", backBuffer );
+
+    destroy_bitmap( backBuffer );
+  }
+
+  // ---------------------------
+  // CGA release and VGA upgrade
+  // ---------------------------
+
+  RipCga();
+  RipVga();
+
   return 0;
 }
@@ -0,0 +1,100 @@
+// Fuzzes the EGA packed and RLE decoders. The first three bytes pick the surface size, the rest is the stream. The
+// optimized decoders must match the reference decoders and must never write outside the surface, which is
+// surrounded by guard bytes.
+
+#include "fuzz_target.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../tile_decode/ega_decode.h"
+
+#define GUARD_BYTES 64
+#define GUARD_VALUE 0xa5
+#define FILL_VALUE  0xee
+
+
+namespace
+{
+  // A width x height surface with guard columns on the right and guard rows above and below
+  struct GuardedSurface
+  {
+    int32_t width;
+    int32_t height;
+    int32_t pitch;
+    std::vector<uint8_t> memory;
+
+    GuardedSurface( int32_t w, int32_t h ) : width( w ), height( h ), pitch( w + 3 ),
+      memory( static_cast<size_t>( pitch ) * h + GUARD_BYTES * 2, GUARD_VALUE )
+    {
+      for( int32_t y = 0; y < height; ++y )
+      {
+        memset( Pixels() + static_cast<size_t>( y ) * pitch, FILL_VALUE, width );
+      }
+    }
+
+    uint8_t* Pixels()
+    {
+      return memory.data() + GUARD_BYTES;
+    }
+
+    bool GuardsIntact() const
+    {
+      for( size_t i = 0; i < memory.size(); ++i )
+      {
+        const size_t offset{ i - GUARD_BYTES };
+        const bool inPixels{ i >= GUARD_BYTES && offset < static_cast<size_t>( pitch ) * height &&
+                             static_cast<int32_t>( offset % pitch ) < width };
+        if( !inPixels && memory[i] != GUARD_VALUE )
+        {
+          return false;
+        }
+      }
+
+      return true;
+    }
+  };
+} // namespace
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  if( size < 3 )
+  {
+    return 0;
+  }
+
+  // Up to 320x200, including the odd widths that take the per-pixel path
+  const int32_t width{ 1 + ( data[0] | ( data[1] << 8 ) ) % 320 };
+  const int32_t height{ 1 + data[2] % 200 };
+  const uint8_t* stream{ data + 3 };
+  const size_t streamSize{ size - 3 };
+
+  GuardedSurface expected( width, height );
+  GuardedSurface actual( width, height );
+
+  DecodeEgaRleReference( stream, streamSize, expected.Pixels(), width, height, expected.pitch );
+  DecodeEgaRle( stream, streamSize, actual.Pixels(), width, height, actual.pitch );
+
+  FUZZ_CHECK( actual.GuardsIntact() );
+  FUZZ_CHECK( actual.memory == expected.memory );
+
+  // Packed rows need an even width, so the byte count per row is width / 2 rounded down
+  const int32_t bytesPerRow{ width / 2 };
+  if( bytesPerRow > 0 )
+  {
+    GuardedSurface expectedPacked( bytesPerRow * 2, height );
+    GuardedSurface actualPacked( bytesPerRow * 2, height );
+
+    const int32_t expectedRows{ DecodeEgaPackedReference( stream, streamSize, bytesPerRow, expectedPacked.Pixels(),
+                                                          expectedPacked.pitch, height ) };
+    const int32_t actualRows{ DecodeEgaPacked( stream, streamSize, bytesPerRow, actualPacked.Pixels(),
+                                               actualPacked.pitch, height ) };
+
+    FUZZ_CHECK( expectedRows == actualRows );
+    FUZZ_CHECK( actualPacked.GuardsIntact() );
+    FUZZ_CHECK( actualPacked.memory == expectedPacked.memory );
+  }
+
+  return 0;
+}
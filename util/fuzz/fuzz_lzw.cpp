@@ -0,0 +1,42 @@
+// Fuzzes the U4 LZW decoder. The size pass and the bounded decompression must agree, and the bounded decompression
+// must refuse a buffer that is one byte too small.
+
+#include "fuzz_target.h"
+
+#include <vector>
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+}
+
+// Keeps pathological (but valid) inputs from running the fuzzer out of memory
+#define MAX_DECOMPRESSED_SIZE ( 64 * 1024 * 1024 )
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  std::vector<unsigned char> compressed( data, data + size );
+  const long compressedSize{ static_cast<long>( size ) };
+
+  const long decompressedSize{ lzwGetDecompressedSize( compressed.data(), compressedSize ) };
+  if( decompressedSize < 0 || decompressedSize > MAX_DECOMPRESSED_SIZE )
+  {
+    return 0;
+  }
+
+  // One spare byte past the end catches any write beyond the capacity
+  std::vector<unsigned char> decompressed( static_cast<size_t>( decompressedSize ) + 1, 0xa5 );
+  const long written{ lzwDecompressBounded( compressed.data(), decompressed.data(), compressedSize,
+                                            decompressedSize ) };
+  FUZZ_CHECK( written == decompressedSize );
+  FUZZ_CHECK( decompressed[decompressedSize] == 0xa5 );
+
+  if( decompressedSize > 0 )
+  {
+    FUZZ_CHECK( lzwDecompressBounded( compressed.data(), decompressed.data(), compressedSize,
+                                      decompressedSize - 1 ) == -1 );
+  }
+
+  return 0;
+}
@@ -0,0 +1,36 @@
+// Fuzzes the U4 LZW encoder. Whatever the input, the compressed data must fit the bound, the decoder must accept it,
+// and it must decompress to the input.
+
+#include "fuzz_target.h"
+
+#include <cstring>
+#include <vector>
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+#include "../lzw_decode/lzwenc.h"
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  static lzwEncoder* encoder{ lzwCreateEncoder() };
+
+  std::vector<unsigned char> input( data, data + size );
+  const long inputSize{ static_cast<long>( size ) };
+
+  const long bound{ lzwGetCompressBound( inputSize ) };
+  std::vector<unsigned char> compressed( static_cast<size_t>( bound ) + 1 );
+  const long compressedSize{ lzwCompress( encoder, input.data(), compressed.data(), inputSize, bound ) };
+  FUZZ_CHECK( compressedSize >= 0 && compressedSize <= bound );
+
+  FUZZ_CHECK( lzwGetDecompressedSize( compressed.data(), compressedSize ) == inputSize );
+
+  std::vector<unsigned char> decompressed( size + 1 );
+  FUZZ_CHECK( lzwDecompressBounded( compressed.data(), decompressed.data(), compressedSize, inputSize ) ==
+              inputSize );
+  FUZZ_CHECK( size == 0 || memcmp( decompressed.data(), input.data(), size ) == 0 );
+
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Fuzzes the LZW stream locator. Every stream it reports in arbitrary data must decode again to the size it was found
+// with, without overlapping the others. The input, compressed and embedded at a byte or nibble offset in filler that
+// can't start a stream, must be found if it is big enough and compresses well enough to pass the scan's thresholds:
+// either where it was put, or overlapped by a stream that decodes to more.
+
+#include "fuzz_target.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../lzwscan/lzw_scan.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzwenc.h"
+}
+
+// Every byte and nibble is a start, so the scan time grows with the input. 16K keeps each run in the milliseconds.
+#define MAX_INPUT_SIZE ( 16 * 1024 )
+
+// Thresholds a real scan would use, short of the entropy limit, which would keep most fuzz input from being embedded.
+// A stream can decode a codeword or two past its end, so the one embedded has to compress by more than MIN_RATIO to
+// be sure of being found.
+#define MIN_DECODED_BYTES 64
+#define MIN_RATIO         1.0f
+#define EMBED_MIN_RATIO   2
+
+
+namespace
+{
+  // In nibbles
+  size_t Start( const LzwStream& stream )
+  {
+    return stream.offset * 2 + ( stream.nibble ? 1 : 0 );
+  }
+
+
+  size_t End( const LzwStream& stream )
+  {
+    return Start( stream ) + stream.length * 2;
+  }
+
+
+  void CheckStreams( const std::vector<uint8_t>& data, const std::vector<LzwStream>& streams )
+  {
+    std::vector<uint8_t> decoded;
+    for( size_t i = 0; i < streams.size(); ++i )
+    {
+      const LzwStream& stream{ streams[i] };
+      FUZZ_CHECK( DecodeLzwStream( data.data(), data.size(), stream, decoded ) );
+
+      FUZZ_CHECK( i == 0 || End( streams[i - 1] ) <= Start( stream ) );
+    }
+  }
+} // namespace
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  static lzwEncoder* encoder{ lzwCreateEncoder() };
+
+  if( size > MAX_INPUT_SIZE )
+  {
+    return 0;
+  }
+
+  LzwScanOptions options;
+  options.minDecodedBytes = MIN_DECODED_BYTES;
+  options.minRatio = MIN_RATIO;
+  options.maxEntropy = 8.0f;
+  options.numThreads = 2;
+
+  std::vector<uint8_t> input( data, data + size );
+  std::vector<LzwStream> streams;
+  ScanLzwStreams( input.data(), input.size(), options, streams );
+  CheckStreams( input, streams );
+
+  if( size < MIN_DECODED_BYTES )
+  {
+    return 0;
+  }
+
+  const long bound{ lzwGetCompressBound( static_cast<long>( size ) ) };
+  std::vector<unsigned char> compressed( static_cast<size_t>( bound ) );
+  const long compressedSize{ lzwCompress( encoder, input.data(), compressed.data(), static_cast<long>( size ),
+                                          bound ) };
+  FUZZ_CHECK( compressedSize > 0 );
+  if( static_cast<size_t>( compressedSize ) * EMBED_MIN_RATIO > size )
+  {
+    return 0;
+  }
+
+  // 0xff filler: 0xfff isn't a root, so no stream starts in it at either alignment
+  const size_t offset{ 1 + size % 61 };
+  const bool nibble{ ( data[0] & 1 ) != 0 };
+  std::vector<uint8_t> blob( offset + static_cast<size_t>( compressedSize ) + 64, 0xff );
+  for( long i = 0; i < compressedSize; ++i )
+  {
+    const uint8_t byte{ compressed[i] };
+    if( nibble )
+    {
+      blob[offset + i] = static_cast<uint8_t>( ( blob[offset + i] & 0xf0 ) | ( byte >> 4 ) );
+      blob[offset + i + 1] = static_cast<uint8_t>( ( byte << 4 ) | 0x0f );
+    }
+    else
+    {
+      blob[offset + i] = byte;
+    }
+  }
+
+  ScanLzwStreams( blob.data(), blob.size(), options, streams );
+  CheckStreams( blob, streams );
+
+  const LzwStream embedded{ offset, nibble, static_cast<size_t>( compressedSize ), size, 0.0f };
+  bool found{ false };
+  for( const LzwStream& stream : streams )
+  {
+    const bool overlaps{ Start( stream ) < End( embedded ) && Start( embedded ) < End( stream ) };
+    if( stream.offset == offset && stream.nibble == nibble )
+    {
+      std::vector<uint8_t> decoded;
+      FUZZ_CHECK( DecodeLzwStream( blob.data(), blob.size(), stream, decoded ) && decoded.size() >= size &&
+                  memcmp( decoded.data(), data, size ) == 0 );
+      found = true;
+    }
+    else
+    {
+      found |= overlaps && stream.decodedSize >= size;
+    }
+  }
+
+  FUZZ_CHECK( found );
+  return 0;
+}
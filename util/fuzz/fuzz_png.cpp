@@ -0,0 +1,31 @@
+// Fuzzes the PNG reader and its inflate. Corrupt files must be rejected without crashing, and a decoded image must be
+// consistent with its header.
+
+#include "fuzz_target.h"
+
+#include "../png/png_reader.h"
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  PngImage image;
+  const char* error{ nullptr };
+
+  if( DecodePng( data, size, image, error ) )
+  {
+    FUZZ_CHECK( image.indices.width > 0 && image.indices.height > 0 );
+    FUZZ_CHECK( image.indices.pixels.size() ==
+                static_cast<size_t>( image.indices.width ) * static_cast<size_t>( image.indices.height ) );
+  }
+  else
+  {
+    FUZZ_CHECK( error != nullptr );
+  }
+
+  // The raw inflate entry point on its own, with a small fixed output buffer
+  uint8_t out[4096];
+  const long written{ ZlibInflate( data, size, out, sizeof( out ) ) };
+  FUZZ_CHECK( written >= -1 && written <= static_cast<long>( sizeof( out ) ) );
+
+  return 0;
+}
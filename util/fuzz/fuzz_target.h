@@ -0,0 +1,50 @@
+// Shared pieces of the fuzz targets.
+// Every fuzz_*.cpp file defines LLVMFuzzerTestOneInput() and can be linked either with libFuzzer or with
+// standalone_main.cpp, which replays files and mutates them for toolchains without libFuzzer (such as MSVC v142).
+//
+// libFuzzer (clang):
+//   clang -c -g -O1 -fsanitize=fuzzer,address ../lzw_decode/lzw.c
+//   clang++ -std=c++14 -g -O1 -fsanitize=fuzzer,address fuzz_lzw.cpp lzw.o -o fuzz_lzw
+//   ./fuzz_lzw corpus/
+//
+// Standalone (any compiler, ideally with /fsanitize=address or -fsanitize=address,undefined):
+//   g++ -std=c++14 -g -O1 -fsanitize=address,undefined fuzz_ega_rle.cpp standalone_main.cpp
+//     ../tile_decode/ega_decode.cpp ../tile_decode/surface.cpp ../tile_decode/cpu_dispatch.cpp
+//     ../tile_decode/c64_decode.cpp ../tile_decode/kernels_*.cpp -o fuzz_ega_rle
+//   ./fuzz_ega_rle --iterations 100000 ../../pc/ultima4/*.EGA
+//
+// What each target links besides itself (.c files compiled as C), where DECODERS is ../tile_decode/ega_decode.cpp
+// ../tile_decode/c64_decode.cpp ../tile_decode/surface.cpp ../tile_decode/cpu_dispatch.cpp
+// ../tile_decode/kernels_*.cpp:
+//   fuzz_ega_rle        DECODERS
+//   fuzz_lzw            ../lzw_decode/lzw.c
+//   fuzz_lzw_roundtrip  ../lzw_decode/lzw.c ../lzw_decode/lzwenc.c
+//   fuzz_lzw_scan       ../lzwscan/lzw_scan.cpp ../lzw_decode/lzw.c ../lzw_decode/lzwenc.c
+//   fuzz_lzw_var        ../lzw_decode/lzwvar.c
+//   fuzz_png            ../png/png_reader.cpp ../tile_decode/surface.cpp
+//   fuzz_tile_pack      ../tile_decode/tile_pack.cpp ../tile_decode/ega_encode.cpp DECODERS
+//   fuzz_tilerip        ../tilerip/tilerip.cpp ../tile_decode/apple2_decode.cpp ../lzw_decode/lzw.c
+//                       ../lzw_decode/lzwvar.c DECODERS
+
+#ifndef FUZZ_FUZZ_TARGET_H
+#define FUZZ_FUZZ_TARGET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size );
+
+// Reports a broken invariant and aborts, so both libFuzzer and the standalone driver keep the input as a crash
+#define FUZZ_CHECK( condition )                                                                   \
+  do                                                                                              \
+  {                                                                                               \
+    if( !( condition ) )                                                                          \
+    {                                                                                             \
+      fprintf( stderr, "FUZZ_CHECK failed: %s (%s:%d)\n", #condition, __FILE__, __LINE__ );       \
+      abort();                                                                                    \
+    }                                                                                             \
+  } while( 0 )
+
+#endif // FUZZ_FUZZ_TARGET_H
@@ -0,0 +1,47 @@
+// Fuzzes the tile pack reader. Packs that point outside themselves must be refused by Open(), and every tile of a pack
+// it accepts must extract without writing outside its buffer, which ends in guard bytes.
+
+#include "fuzz_target.h"
+
+#include <cstring>
+#include <vector>
+
+#include "../tile_decode/tile_pack.h"
+
+#define GUARD_BYTES 64
+#define GUARD_VALUE 0xa5
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  // Copied to an aligned buffer, the way a mapping would be
+  std::vector<uint32_t> aligned( ( size + 3 ) / 4 );
+  if( size > 0 )
+  {
+    memcpy( aligned.data(), data, size );
+  }
+
+  TilePackView view;
+  if( !view.Open( reinterpret_cast<const uint8_t*>( aligned.data() ), size ) )
+  {
+    return 0;
+  }
+
+  std::vector<uint8_t> tile;
+  for( int32_t i = 0; i < view.NumTiles(); ++i )
+  {
+    const TilePackEntry& entry{ view.Tile( i ) };
+    FUZZ_CHECK( entry.palette < view.NumPalettes() );
+
+    const size_t tileSize{ static_cast<size_t>( entry.width ) * entry.height };
+    tile.assign( tileSize + GUARD_BYTES, GUARD_VALUE );
+    view.ExtractTile( i, tile.data(), entry.width );
+
+    for( size_t j = tileSize; j < tile.size(); ++j )
+    {
+      FUZZ_CHECK( tile[j] == GUARD_VALUE );
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,300 @@
+// Fuzzes the C ABI in tilerip.h against the decoders it wraps. The first byte picks a decoder and the next two its
+// geometry, and the rest is its input. Every ABI decode goes into an image with padding past each row and guard bytes
+// past the end, which must come back untouched, and must match the reference decoder pixel for pixel.
+//
+//   g++ -std=c++14 -g -O1 -fsanitize=address,undefined fuzz_tilerip.cpp standalone_main.cpp ../tilerip/tilerip.cpp
+//     ../tile_decode/ega_decode.cpp ../tile_decode/apple2_decode.cpp ../tile_decode/c64_decode.cpp
+//     ../tile_decode/surface.cpp ../tile_decode/cpu_dispatch.cpp ../tile_decode/kernels_*.cpp
+//     ../instrument/instrument.cpp lzw.o lzwvar.o -pthread -o fuzz_tilerip
+
+#include "fuzz_target.h"
+
+#include <vector>
+
+#include "../tile_decode/apple2_decode.h"
+#include "../tile_decode/c64_decode.h"
+#include "../tile_decode/ega_decode.h"
+#include "../tilerip/tilerip.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+#include "../lzw_decode/lzwvar.h"
+}
+
+#define PADDING     5
+#define GUARD_BYTES 64
+#define GUARD_VALUE 0xa5
+
+// Keeps pathological (but valid) LZW inputs from running the fuzzer out of memory
+#define MAX_DECOMPRESSED_SIZE ( 16 * 1024 * 1024 )
+
+
+namespace
+{
+  // A width x height image with PADDING bytes past every row, in a buffer that ends in guard bytes
+  struct GuardedImage
+  {
+    GuardedImage( int32_t width, int32_t height )
+      : buffer( static_cast<size_t>( width + PADDING ) * height + GUARD_BYTES, GUARD_VALUE )
+    {
+      image = tilerip_image{ buffer.data(), width, height, width + PADDING };
+    }
+
+    // The pixels the reference decoder wrote to a tightly packed buffer of the same size must be the same, and the
+    // padding and guard bytes untouched. Pixels the reference left alone are compared as well, since both buffers
+    // start out as guard bytes.
+    void Check( const std::vector<uint8_t>& expected ) const
+    {
+      for( int32_t y = 0; y < image.height; ++y )
+      {
+        const uint8_t* row{ buffer.data() + static_cast<size_t>( y ) * image.pitch };
+        for( int32_t x = 0; x < image.width; ++x )
+        {
+          FUZZ_CHECK( row[x] == expected[static_cast<size_t>( y ) * image.width + x] );
+        }
+
+        for( int32_t x = image.width; x < image.pitch; ++x )
+        {
+          FUZZ_CHECK( row[x] == GUARD_VALUE );
+        }
+      }
+
+      for( size_t i = buffer.size() - GUARD_BYTES; i < buffer.size(); ++i )
+      {
+        FUZZ_CHECK( buffer[i] == GUARD_VALUE );
+      }
+    }
+
+    std::vector<uint8_t> buffer;
+    tilerip_image image;
+  };
+
+
+  void FuzzEga( const uint8_t* data, size_t size, uint8_t shape, uint8_t rows )
+  {
+    const int32_t bytesPerRow{ 1 + ( shape & 0xf ) };
+    const int32_t width{ bytesPerRow * 2 + ( shape >> 4 ) };
+    const int32_t height{ rows & 0x3f };
+
+    GuardedImage packed( width, height );
+    std::vector<uint8_t> expected( static_cast<size_t>( width ) * height, GUARD_VALUE );
+
+    int32_t numRows{ -1 };
+    FUZZ_CHECK( tilerip_decode_ega_packed( data, size, bytesPerRow, &packed.image, &numRows ) == TILERIP_OK );
+    FUZZ_CHECK( numRows == DecodeEgaPackedReference( data, size, bytesPerRow, expected.data(), width, height ) );
+    packed.Check( expected );
+
+    GuardedImage picture( width, height );
+    expected.assign( expected.size(), GUARD_VALUE );
+    FUZZ_CHECK( tilerip_decode_ega_rle( data, size, &picture.image ) == TILERIP_OK );
+    DecodeEgaRleReference( data, size, expected.data(), width, height, width );
+    picture.Check( expected );
+
+    size_t expandedSize{ 0 };
+    FUZZ_CHECK( tilerip_expand_rle( data, size, nullptr, 0, &expandedSize ) == TILERIP_OK );
+    FUZZ_CHECK( expandedSize == EgaRleExpandedSize( data, size ) );
+    if( expandedSize > MAX_DECOMPRESSED_SIZE )
+    {
+      return;
+    }
+
+    std::vector<uint8_t> expanded( expandedSize + GUARD_BYTES, GUARD_VALUE );
+    std::vector<uint8_t> reference( expandedSize + GUARD_BYTES, GUARD_VALUE );
+    size_t written{ 0 };
+    FUZZ_CHECK( tilerip_expand_rle( data, size, expanded.data(), expandedSize, &written ) == TILERIP_OK );
+    FUZZ_CHECK( written == ExpandEgaRle( data, size, reference.data(), expandedSize ) );
+    FUZZ_CHECK( expanded == reference );
+
+    if( expandedSize > 0 )
+    {
+      FUZZ_CHECK( tilerip_expand_rle( data, size, expanded.data(), expandedSize - 1, &written ) ==
+                  TILERIP_ERROR_SPACE );
+      FUZZ_CHECK( written == expandedSize );
+    }
+  }
+
+
+  void FuzzApple( const uint8_t* data, size_t size, uint8_t shape, uint8_t rows )
+  {
+    const int32_t bytesPerRow{ 1 + ( shape & 0x7 ) };
+    const int32_t srcPitch{ bytesPerRow + ( ( shape >> 3 ) & 0x3 ) };
+    const bool startOdd{ ( shape & 0x80 ) != 0 };
+    const int32_t width{ bytesPerRow * APPLE2_PIXELS_PER_BYTE };
+    const int32_t height{ rows & 0x1f };
+
+    GuardedImage tiles( width, height );
+    const tilerip_status status{ tilerip_decode_apple_rows( data, size, bytesPerRow, srcPitch, startOdd,
+                                                            &tiles.image ) };
+    const bool fits{ height == 0 || static_cast<size_t>( height - 1 ) * srcPitch + bytesPerRow <= size };
+    FUZZ_CHECK( status == ( fits ? TILERIP_OK : TILERIP_ERROR_DATA ) );
+
+    std::vector<uint8_t> expected( static_cast<size_t>( width ) * height, GUARD_VALUE );
+    for( int32_t y = 0; fits && y < height; ++y )
+    {
+      DecodeAppleSpanReference( data + static_cast<size_t>( y ) * srcPitch, bytesPerRow, startOdd, false,
+                                &expected[static_cast<size_t>( y ) * width] );
+    }
+
+    tiles.Check( expected );
+    if( size == 0 )
+    {
+      return;
+    }
+
+    // Screens are only ever as big as a page, so the input is repeated up to one
+    std::vector<uint8_t> page( APPLE2_SCREEN_SIZE + ( rows & 0x7 ) );
+    for( size_t i = 0; i < page.size(); ++i )
+    {
+      page[i] = data[i % size];
+    }
+
+    GuardedImage screen( APPLE2_SCREEN_WIDTH, APPLE2_SCREEN_HEIGHT );
+    IndexSurface surface;
+    const bool found{ DecodeAppleScreenReference( page.data(), page.size(), surface ) };
+    FUZZ_CHECK( tilerip_decode_apple_screen( page.data(), page.size(), &screen.image ) ==
+                ( found ? TILERIP_OK : TILERIP_ERROR_DATA ) );
+    if( found )
+    {
+      screen.Check( surface.pixels );
+    }
+  }
+
+
+  void FuzzC64( const uint8_t* data, size_t size, uint8_t shape, uint8_t rows )
+  {
+    const int32_t bytesPerRow{ 1 + ( shape & 0x7 ) };
+    const int32_t bitsPitch{ bytesPerRow + ( ( shape >> 3 ) & 0x3 ) };
+    const int32_t colorsPitch{ shape & 0x20 ? 0 : bytesPerRow };
+    const int32_t width{ bytesPerRow * C64_PIXELS_PER_BYTE };
+    const int32_t height{ rows & 0x1f };
+
+    // The colors come from the back half of the input
+    const size_t bitsSize{ size / 2 };
+    const uint8_t* colors{ data + bitsSize };
+    const size_t colorsSize{ size - bitsSize };
+
+    GuardedImage image( width, height );
+    const tilerip_status status{ tilerip_decode_c64_hires( data, bitsSize, bitsPitch, colors, colorsSize,
+                                                           colorsPitch, bytesPerRow, &image.image ) };
+    const bool fits{ height == 0 || ( static_cast<size_t>( height - 1 ) * bitsPitch + bytesPerRow <= bitsSize &&
+                                      static_cast<size_t>( height - 1 ) * colorsPitch + bytesPerRow <= colorsSize ) };
+    FUZZ_CHECK( status == ( fits ? TILERIP_OK : TILERIP_ERROR_DATA ) );
+
+    std::vector<uint8_t> expected( static_cast<size_t>( width ) * height, GUARD_VALUE );
+    for( int32_t y = 0; fits && y < height; ++y )
+    {
+      for( int32_t i = 0; i < bytesPerRow; ++i )
+      {
+        DecodeC64HiresByteReference( data[static_cast<size_t>( y ) * bitsPitch + i],
+                                     colors[static_cast<size_t>( y ) * colorsPitch + i],
+                                     &expected[static_cast<size_t>( y ) * width + i * C64_PIXELS_PER_BYTE] );
+      }
+    }
+
+    image.Check( expected );
+  }
+
+
+  void FuzzLzw( tilerip_lzw* context, const uint8_t* data, size_t size, bool variable )
+  {
+    const tilerip_lzw_format format{ variable ? TILERIP_LZW_VARIABLE : TILERIP_LZW_U4 };
+    std::vector<unsigned char> compressed( data, data + size );
+    const long compressedSize{ static_cast<long>( size ) };
+
+    // A fresh allocation for the reference, so state left in the reused context would show up
+    long expectedSize{ -1 };
+    if( variable )
+    {
+      lzwVarContext* reference{ lzwVarCreateContext() };
+      expectedSize = lzwVarGetDecompressedSize( reference, compressed.data(), compressedSize );
+      lzwVarDestroyContext( reference );
+    }
+    else
+    {
+      expectedSize = lzwGetDecompressedSize( compressed.data(), compressedSize );
+    }
+
+    size_t decompressedSize{ 0 };
+    const tilerip_status status{ tilerip_lzw_decompress( context, format, data, size, nullptr, 0,
+                                                         &decompressedSize ) };
+    FUZZ_CHECK( status == ( expectedSize < 0 ? TILERIP_ERROR_DATA : TILERIP_OK ) );
+    if( expectedSize < 0 || expectedSize > MAX_DECOMPRESSED_SIZE )
+    {
+      return;
+    }
+
+    FUZZ_CHECK( decompressedSize == static_cast<size_t>( expectedSize ) );
+
+    std::vector<uint8_t> decompressed( decompressedSize + GUARD_BYTES, GUARD_VALUE );
+    std::vector<uint8_t> reference( decompressedSize + GUARD_BYTES, GUARD_VALUE );
+    size_t written{ 0 };
+    FUZZ_CHECK( tilerip_lzw_decompress( context, format, data, size, decompressed.data(), decompressedSize,
+                                        &written ) == TILERIP_OK );
+    FUZZ_CHECK( written == decompressedSize );
+
+    if( variable )
+    {
+      lzwVarContext* referenceContext{ lzwVarCreateContext() };
+      lzwVarDecompressBounded( referenceContext, compressed.data(), reference.data(), compressedSize, expectedSize );
+      lzwVarDestroyContext( referenceContext );
+    }
+    else
+    {
+      lzwDecompressBounded( compressed.data(), reference.data(), compressedSize, expectedSize );
+    }
+
+    FUZZ_CHECK( decompressed == reference );
+
+    if( decompressedSize > 0 )
+    {
+      decompressed.assign( decompressed.size(), GUARD_VALUE );
+      FUZZ_CHECK( tilerip_lzw_decompress( context, format, data, size, decompressed.data(), decompressedSize - 1,
+                                          &written ) == TILERIP_ERROR_SPACE );
+      FUZZ_CHECK( written == decompressedSize );
+      for( size_t i = decompressedSize - 1; i < decompressed.size(); ++i )
+      {
+        FUZZ_CHECK( decompressed[i] == GUARD_VALUE );
+      }
+    }
+  }
+} // namespace
+
+
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* data, size_t size )
+{
+  static tilerip_lzw* context{ tilerip_lzw_create() };
+  FUZZ_CHECK( context != nullptr );
+
+  if( size < 3 )
+  {
+    return 0;
+  }
+
+  const uint8_t decoder{ data[0] };
+  const uint8_t shape{ data[1] };
+  const uint8_t rows{ data[2] };
+  data += 3;
+  size -= 3;
+
+  switch( decoder % 5 )
+  {
+    case 0:
+      FuzzEga( data, size, shape, rows );
+      break;
+
+    case 1:
+      FuzzApple( data, size, shape, rows );
+      break;
+
+    case 2:
+      FuzzC64( data, size, shape, rows );
+      break;
+
+    default:
+      FuzzLzw( context, data, size, decoder % 5 == 4 );
+      break;
+  }
+
+  return 0;
+}
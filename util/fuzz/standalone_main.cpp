@@ -0,0 +1,193 @@
+// Fuzz driver for toolchains without libFuzzer.
+// Runs the target on every file given on the command line, then on random mutations of them (or of random data, if
+// no files are given). If the target crashes or fails a check, the input is written to crash.bin first so it can be
+// replayed with: fuzz_target crash.bin
+//
+// Usage: fuzz_target [--iterations N] [--seed S] [file ...]
+
+#include "fuzz_target.h"
+
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+
+namespace
+{
+  std::vector<uint8_t> currentInput;
+
+
+  void SaveCrash( int32_t signalNumber )
+  {
+    FILE* file{ fopen( "crash.bin", "wb" ) };
+    if( file != nullptr )
+    {
+      fwrite( currentInput.data(), 1, currentInput.size(), file );
+      fclose( file );
+    }
+
+    fprintf( stderr, "Signal %d, input (%u bytes) saved to crash.bin\n", signalNumber,
+             static_cast<uint32_t>( currentInput.size() ) );
+
+    signal( signalNumber, SIG_DFL );
+    raise( signalNumber );
+  }
+
+
+  void Run( const std::vector<uint8_t>& input )
+  {
+    currentInput = input;
+    LLVMFuzzerTestOneInput( currentInput.data(), currentInput.size() );
+  }
+
+
+  uint32_t NextRandom( uint32_t& state )
+  {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+
+  // Applies a handful of byte-level mutations, the same kinds libFuzzer starts with
+  void Mutate( std::vector<uint8_t>& data, uint32_t& state )
+  {
+    const uint32_t numMutations{ 1 + NextRandom( state ) % 8 };
+
+    for( uint32_t i = 0; i < numMutations; ++i )
+    {
+      const uint32_t r{ NextRandom( state ) };
+
+      if( data.empty() )
+      {
+        data.push_back( static_cast<uint8_t>( r >> 8 ) );
+        continue;
+      }
+
+      const size_t position{ NextRandom( state ) % data.size() };
+
+      switch( r % 6 )
+      {
+        case 0: // Flip a bit
+          data[position] ^= static_cast<uint8_t>( 1 << ( ( r >> 8 ) & 7 ) );
+          break;
+        case 1: // Replace a byte, favoring the interesting values
+        {
+          static const uint8_t interesting[] = { 0x00, 0x01, 0x02, 0x0f, 0x7f, 0x80, 0xff };
+          data[position] = ( r & 0x100 ) ? interesting[( r >> 9 ) % sizeof( interesting )]
+                                         : static_cast<uint8_t>( r >> 16 );
+          break;
+        }
+        case 2: // Truncate
+          data.resize( position );
+          break;
+        case 3: // Insert random bytes
+        {
+          const size_t count{ 1 + ( r >> 8 ) % 16 };
+          for( size_t j = 0; j < count; ++j )
+          {
+            data.insert( data.begin() + position, static_cast<uint8_t>( NextRandom( state ) ) );
+          }
+          break;
+        }
+        case 4: // Duplicate a block
+        {
+          const size_t count{ 1 + ( r >> 8 ) % ( data.size() - position ) };
+          const std::vector<uint8_t> block( data.begin() + position, data.begin() + position + count );
+          data.insert( data.begin() + NextRandom( state ) % data.size(), block.begin(), block.end() );
+          break;
+        }
+        default: // Erase a block
+        {
+          const size_t count{ 1 + ( r >> 8 ) % ( data.size() - position ) };
+          data.erase( data.begin() + position, data.begin() + position + count );
+          break;
+        }
+      }
+    }
+  }
+
+
+  bool ReadFile( const char* filename, std::vector<uint8_t>& bytes )
+  {
+    std::ifstream infile( filename, std::ios::in | std::ios::binary );
+    if( !infile.is_open() )
+    {
+      return false;
+    }
+
+    bytes.assign( std::istreambuf_iterator<char>( infile ), std::istreambuf_iterator<char>() );
+    return true;
+  }
+} // namespace
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  uint32_t iterations{ 0 };
+  uint32_t state{ 0x2545f491 };
+  std::vector<std::vector<uint8_t>> corpus;
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--iterations" ) == 0 && i + 1 < argc )
+    {
+      iterations = static_cast<uint32_t>( strtoul( argv[++i], nullptr, 10 ) );
+    }
+    else if( strcmp( argv[i], "--seed" ) == 0 && i + 1 < argc )
+    {
+      state = static_cast<uint32_t>( strtoul( argv[++i], nullptr, 10 ) ) | 1;
+    }
+    else
+    {
+      std::vector<uint8_t> bytes;
+      if( !ReadFile( argv[i], bytes ) )
+      {
+        fprintf( stderr, "Can't open %s\n", argv[i] );
+        return 1;
+      }
+      corpus.push_back( bytes );
+    }
+  }
+
+  signal( SIGABRT, SaveCrash );
+  signal( SIGSEGV, SaveCrash );
+  signal( SIGFPE, SaveCrash );
+  signal( SIGILL, SaveCrash );
+
+  for( const auto& input : corpus )
+  {
+    Run( input );
+  }
+
+  std::vector<uint8_t> input;
+  for( uint32_t i = 0; i < iterations; ++i )
+  {
+    if( corpus.empty() )
+    {
+      input.resize( NextRandom( state ) % 4096 );
+      for( uint8_t& byte : input )
+      {
+        byte = static_cast<uint8_t>( NextRandom( state ) );
+      }
+    }
+    else
+    {
+      input = corpus[NextRandom( state ) % corpus.size()];
+    }
+
+    Mutate( input, state );
+    Run( input );
+
+    if( ( i + 1 ) % 10000 == 0 )
+    {
+      printf( "%u / %u\n", i + 1, iterations );
+    }
+  }
+
+  printf( "Ran %u inputs without a failure\n", static_cast<uint32_t>( corpus.size() + iterations ) );
+  return 0;
+}
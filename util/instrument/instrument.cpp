@@ -0,0 +1,455 @@
+#include "instrument.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef RIPPER_INSTRUMENT
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+int instrumentActive{ 0 };
+
+
+namespace
+{
+  const char* const counterNames[NUM_INSTRUMENT_COUNTERS] =
+  {
+    "bytesIn", "bytesOut", "allocations", "allocatedBytes", "rleRuns", "lzwCodewords", "lzwProbes",
+    "lzwDictionaryResets"
+  };
+
+  const char* const histogramBucketNames[RLE_HISTOGRAM_BUCKETS] =
+  {
+    "0", "1", "2-3", "4-7", "8-15", "16-31", "32-63", "64-127", "128-255"
+  };
+
+  // Files recorded before the first InstrumentBeginFile()
+  const char* const noFileName{ "(no file)" };
+
+
+  struct StageStats
+  {
+    uint64_t count{ 0 };
+    uint64_t totalNs{ 0 };
+    uint64_t maxNs{ 0 };
+
+    void Add( uint64_t ns )
+    {
+      ++count;
+      totalNs += ns;
+      if( ns > maxNs )
+      {
+        maxNs = ns;
+      }
+    }
+
+    void Merge( const StageStats& other )
+    {
+      count += other.count;
+      totalNs += other.totalNs;
+      if( other.maxNs > maxNs )
+      {
+        maxNs = other.maxNs;
+      }
+    }
+  };
+
+
+  struct FileStats
+  {
+    std::map<std::string, StageStats> stages;
+    uint64_t counters[NUM_INSTRUMENT_COUNTERS]{};
+    uint64_t runHistogram[RLE_HISTOGRAM_BUCKETS]{};
+
+    void Merge( const FileStats& other )
+    {
+      for( const auto& stage : other.stages )
+      {
+        stages[stage.first].Merge( stage.second );
+      }
+
+      for( int32_t i = 0; i < NUM_INSTRUMENT_COUNTERS; ++i )
+      {
+        counters[i] += other.counters[i];
+      }
+
+      for( int32_t i = 0; i < RLE_HISTOGRAM_BUCKETS; ++i )
+      {
+        runHistogram[i] += other.runHistogram[i];
+      }
+    }
+  };
+
+
+  struct TraceEvent
+  {
+    const char* name;
+    const char* category;
+    const std::string* file;
+    uint64_t startNs;
+    uint64_t durationNs;
+  };
+
+
+  struct OpenStage
+  {
+    const char* name;
+    uint64_t startNs;
+  };
+
+
+  // Everything one thread records. Records are only touched by their own thread until the session is written out.
+  struct ThreadRecord
+  {
+    int32_t id{ 0 };
+    std::string name;
+
+    std::map<std::string, FileStats> files;
+    const std::string* currentFileName{ nullptr };
+    FileStats* currentFile{ nullptr };
+    uint64_t fileStartNs{ 0 };
+
+    std::vector<OpenStage> openStages;
+    std::vector<TraceEvent> events;
+  };
+
+
+  std::chrono::steady_clock::time_point sessionStart;
+
+  std::mutex threadsMutex;
+  std::vector<std::unique_ptr<ThreadRecord>> threads;
+
+  thread_local ThreadRecord* currentThread{ nullptr };
+
+
+  uint64_t NowNs()
+  {
+    return static_cast<uint64_t>( std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - sessionStart ).count() );
+  }
+
+
+  void SetFile( ThreadRecord& record, const char* filename )
+  {
+    const auto file{ record.files.emplace( filename, FileStats{} ).first };
+    record.currentFileName = &file->first;
+    record.currentFile = &file->second;
+  }
+
+
+  ThreadRecord& CurrentThread()
+  {
+    if( currentThread == nullptr )
+    {
+      std::unique_ptr<ThreadRecord> record{ new ThreadRecord };
+      SetFile( *record, noFileName );
+
+      std::lock_guard<std::mutex> lock{ threadsMutex };
+      record->id = static_cast<int32_t>( threads.size() );
+      currentThread = record.get();
+      threads.push_back( std::move( record ) );
+    }
+
+    return *currentThread;
+  }
+
+
+  // Closes the trace span of the file the thread is working on, if any
+  void EndFile( ThreadRecord& record, uint64_t nowNs )
+  {
+    if( record.currentFileName != nullptr && *record.currentFileName != noFileName )
+    {
+      record.events.push_back( { record.currentFileName->c_str(), "file", record.currentFileName, record.fileStartNs,
+                                 nowNs - record.fileStartNs } );
+    }
+  }
+
+
+  void WriteJsonString( FILE* file, const char* text )
+  {
+    fputc( '"', file );
+    for( const char* c = text; *c != '\0'; ++c )
+    {
+      if( *c == '"' || *c == '\\' )
+      {
+        fputc( '\\', file );
+        fputc( *c, file );
+      }
+      else if( static_cast<unsigned char>( *c ) < 0x20 )
+      {
+        fprintf( file, "\\u%04x", *c );
+      }
+      else
+      {
+        fputc( *c, file );
+      }
+    }
+    fputc( '"', file );
+  }
+
+
+  void WriteFileStats( FILE* file, const FileStats& stats, const char* indent )
+  {
+    fprintf( file, "{\n%s  \"stages\": {", indent );
+
+    bool first{ true };
+    for( const auto& stage : stats.stages )
+    {
+      fprintf( file, "%s\n%s    ", first ? "" : ",", indent );
+      WriteJsonString( file, stage.first.c_str() );
+      fprintf( file, ": { \"count\": %llu, \"totalMs\": %.3f, \"maxMs\": %.3f }",
+               static_cast<unsigned long long>( stage.second.count ), stage.second.totalNs / 1.0e6,
+               stage.second.maxNs / 1.0e6 );
+      first = false;
+    }
+
+    if( !first )
+    {
+      fprintf( file, "\n%s  ", indent );
+    }
+
+    fprintf( file, "},\n%s  \"counters\": {", indent );
+
+    for( int32_t i = 0; i < NUM_INSTRUMENT_COUNTERS; ++i )
+    {
+      fprintf( file, "%s \"%s\": %llu", i == 0 ? "" : ",", counterNames[i],
+               static_cast<unsigned long long>( stats.counters[i] ) );
+    }
+
+    fprintf( file, " },\n%s  \"rleRunHistogram\": {", indent );
+
+    for( int32_t i = 0; i < RLE_HISTOGRAM_BUCKETS; ++i )
+    {
+      fprintf( file, "%s \"%s\": %llu", i == 0 ? "" : ",", histogramBucketNames[i],
+               static_cast<unsigned long long>( stats.runHistogram[i] ) );
+    }
+
+    fprintf( file, " }\n%s}", indent );
+  }
+
+
+  bool WriteStats( const char* filename )
+  {
+    FILE* file{ fopen( filename, "w" ) };
+    if( file == nullptr )
+    {
+      printf( "Can't write %s\n", filename );
+      return false;
+    }
+
+    // Threads can work on the same file, so merge by file name
+    std::map<std::string, FileStats> files;
+    FileStats totals;
+
+    for( const auto& thread : threads )
+    {
+      for( const auto& fileStats : thread->files )
+      {
+        files[fileStats.first].Merge( fileStats.second );
+        totals.Merge( fileStats.second );
+      }
+    }
+
+    fprintf( file, "{\n  \"threads\": %d,\n  \"totals\": ", static_cast<int32_t>( threads.size() ) );
+    WriteFileStats( file, totals, "  " );
+    fprintf( file, ",\n  \"files\": {" );
+
+    bool first{ true };
+    for( const auto& fileStats : files )
+    {
+      fprintf( file, "%s\n    ", first ? "" : "," );
+      WriteJsonString( file, fileStats.first.c_str() );
+      fprintf( file, ": " );
+      WriteFileStats( file, fileStats.second, "    " );
+      first = false;
+    }
+
+    fprintf( file, "\n  }\n}\n" );
+    fclose( file );
+
+    return true;
+  }
+
+
+  bool WriteTrace( const char* filename )
+  {
+    FILE* file{ fopen( filename, "w" ) };
+    if( file == nullptr )
+    {
+      printf( "Can't write %s\n", filename );
+      return false;
+    }
+
+    fprintf( file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n" );
+
+    bool first{ true };
+    for( const auto& thread : threads )
+    {
+      fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+               first ? "" : ",\n", thread->id );
+      if( thread->name.empty() )
+      {
+        fprintf( file, "\"thread %d\"", thread->id );
+      }
+      else
+      {
+        WriteJsonString( file, thread->name.c_str() );
+      }
+      fprintf( file, "}}" );
+      first = false;
+
+      for( const TraceEvent& event : thread->events )
+      {
+        fprintf( file, ",\n{\"name\":" );
+        WriteJsonString( file, event.name );
+        fprintf( file, ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"file\":",
+                 event.category, thread->id, event.startNs / 1.0e3, event.durationNs / 1.0e3 );
+        WriteJsonString( file, event.file->c_str() );
+        fprintf( file, "}}" );
+      }
+    }
+
+    fprintf( file, "\n]}\n" );
+    fclose( file );
+
+    return true;
+  }
+} // namespace
+
+
+extern "C" void InstrumentCount( int counter, unsigned long long amount )
+{
+  CurrentThread().currentFile->counters[counter] += amount;
+}
+
+
+extern "C" void InstrumentRunLength( unsigned int length )
+{
+  int32_t bucket{ 0 };
+  while( length != 0 && bucket < RLE_HISTOGRAM_BUCKETS - 1 )
+  {
+    length >>= 1;
+    ++bucket;
+  }
+
+  FileStats& stats{ *CurrentThread().currentFile };
+  ++stats.runHistogram[bucket];
+  ++stats.counters[COUNTER_RLE_RUNS];
+}
+
+
+extern "C" void InstrumentBeginStage( const char* name )
+{
+  CurrentThread().openStages.push_back( { name, NowNs() } );
+}
+
+
+extern "C" void InstrumentEndStage( void )
+{
+  ThreadRecord& record{ CurrentThread() };
+
+  // A stage that began before --stats took effect has nothing to close
+  if( record.openStages.empty() )
+  {
+    return;
+  }
+
+  const OpenStage stage{ record.openStages.back() };
+  record.openStages.pop_back();
+
+  const uint64_t durationNs{ NowNs() - stage.startNs };
+  record.currentFile->stages[stage.name].Add( durationNs );
+  record.events.push_back( { stage.name, "stage", record.currentFileName, stage.startNs, durationNs } );
+}
+
+
+extern "C" void InstrumentBeginFile( const char* filename )
+{
+  ThreadRecord& record{ CurrentThread() };
+
+  const uint64_t nowNs{ NowNs() };
+  EndFile( record, nowNs );
+
+  SetFile( record, filename );
+  record.fileStartNs = nowNs;
+}
+
+
+void InstrumentNameThread( const char* name )
+{
+  CurrentThread().name = name;
+}
+
+
+InstrumentSession::InstrumentSession( bool enabled, const char* statsFilename, const char* traceFilename )
+  : m_enabled( enabled ), m_statsFilename( statsFilename ), m_traceFilename( traceFilename )
+{
+  if( m_enabled )
+  {
+    sessionStart = std::chrono::steady_clock::now();
+    instrumentActive = 1;
+    InstrumentNameThread( "main" );
+  }
+}
+
+
+InstrumentSession::~InstrumentSession()
+{
+  if( !m_enabled )
+  {
+    return;
+  }
+
+  instrumentActive = 0;
+
+  // Any worker threads have been joined by now, so their records can be read without the lock
+  const uint64_t nowNs{ NowNs() };
+  for( const auto& thread : threads )
+  {
+    EndFile( *thread, nowNs );
+  }
+
+  if( WriteStats( m_statsFilename ) && WriteTrace( m_traceFilename ) )
+  {
+    printf( "Wrote %s and %s\n", m_statsFilename, m_traceFilename );
+  }
+}
+
+#else
+
+InstrumentSession::InstrumentSession( bool enabled, const char* statsFilename, const char* traceFilename )
+  : m_enabled( enabled ), m_statsFilename( statsFilename ), m_traceFilename( traceFilename )
+{
+  if( m_enabled )
+  {
+    printf( "--stats needs a build with RIPPER_INSTRUMENT defined, no statistics will be written\n" );
+  }
+}
+
+
+InstrumentSession::~InstrumentSession()
+{
+}
+
+#endif // RIPPER_INSTRUMENT
+
+
+bool HasStatsOption( int argc, char* argv[] )
+{
+  for( int i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--stats" ) == 0 )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,147 @@
+// Low-overhead instrumentation for the rippers' --stats mode.
+// Records per-stage timings, bytes in/out, LZW probe counts and dictionary resets, RLE run-length histograms, and
+// allocation counts, broken down by input file and thread. The results are written as a JSON summary and as a Chrome
+// trace-event timeline (load it in chrome://tracing or https://ui.perfetto.dev).
+//
+// Everything is compiled out unless RIPPER_INSTRUMENT is defined. When it is defined but --stats isn't given, each
+// hook costs a single flag test.
+//
+// The counter and stage hooks are plain C so lzw.c can use them too.
+
+#ifndef INSTRUMENT_INSTRUMENT_H
+#define INSTRUMENT_INSTRUMENT_H
+
+enum InstrumentCounter
+{
+  COUNTER_BYTES_IN,
+  COUNTER_BYTES_OUT,
+  COUNTER_ALLOCATIONS,
+  COUNTER_ALLOCATED_BYTES,
+  COUNTER_RLE_RUNS,
+  COUNTER_LZW_CODEWORDS,
+  COUNTER_LZW_PROBES,
+  COUNTER_LZW_DICTIONARY_RESETS,
+  NUM_INSTRUMENT_COUNTERS
+};
+
+// RLE run lengths are bucketed by power of two: 0, 1, 2-3, 4-7, ... 128-255
+#define RLE_HISTOGRAM_BUCKETS 9
+
+#ifdef RIPPER_INSTRUMENT
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Set by InstrumentStart(), tested by every hook before doing any work
+extern int instrumentActive;
+
+void InstrumentCount( int counter, unsigned long long amount );
+void InstrumentRunLength( unsigned int length );
+
+// Stages nest per thread. Names must be string literals (or otherwise outlive the session).
+void InstrumentBeginStage( const char* name );
+void InstrumentEndStage( void );
+
+// Attributes everything recorded on this thread to the named input file until the next call
+void InstrumentBeginFile( const char* filename );
+
+#ifdef __cplusplus
+}
+#endif
+
+#define INSTRUMENT_COUNT( counter, amount ) \
+  do { if( instrumentActive ) InstrumentCount( ( counter ), ( amount ) ); } while( 0 )
+#define INSTRUMENT_RUN_LENGTH( length ) \
+  do { if( instrumentActive ) InstrumentRunLength( ( length ) ); } while( 0 )
+#define INSTRUMENT_BEGIN_STAGE( name ) \
+  do { if( instrumentActive ) InstrumentBeginStage( ( name ) ); } while( 0 )
+#define INSTRUMENT_END_STAGE() \
+  do { if( instrumentActive ) InstrumentEndStage(); } while( 0 )
+#define INSTRUMENT_BEGIN_FILE( filename ) \
+  do { if( instrumentActive ) InstrumentBeginFile( ( filename ) ); } while( 0 )
+
+#else
+
+#define INSTRUMENT_COUNT( counter, amount ) ( ( void )0 )
+#define INSTRUMENT_RUN_LENGTH( length ) ( ( void )0 )
+#define INSTRUMENT_BEGIN_STAGE( name ) ( ( void )0 )
+#define INSTRUMENT_END_STAGE() ( ( void )0 )
+#define INSTRUMENT_BEGIN_FILE( filename ) ( ( void )0 )
+
+#endif // RIPPER_INSTRUMENT
+
+
+#ifdef __cplusplus
+
+#define INSTRUMENT_CONCAT_INNER( a, b ) a##b
+#define INSTRUMENT_CONCAT( a, b ) INSTRUMENT_CONCAT_INNER( a, b )
+
+#ifdef RIPPER_INSTRUMENT
+
+// Times the enclosing block as a stage
+class InstrumentScope
+{
+public:
+  explicit InstrumentScope( const char* name ) : m_active( instrumentActive != 0 )
+  {
+    if( m_active )
+    {
+      InstrumentBeginStage( name );
+    }
+  }
+
+  ~InstrumentScope()
+  {
+    if( m_active )
+    {
+      InstrumentEndStage();
+    }
+  }
+
+  InstrumentScope( const InstrumentScope& ) = delete;
+  InstrumentScope& operator=( const InstrumentScope& ) = delete;
+
+private:
+  bool m_active;
+};
+
+#define INSTRUMENT_SCOPE( name ) InstrumentScope INSTRUMENT_CONCAT( instrumentScope, __LINE__ ){ name }
+
+// Names the calling thread in the trace
+void InstrumentNameThread( const char* name );
+
+#define INSTRUMENT_THREAD_NAME( name ) \
+  do { if( instrumentActive ) InstrumentNameThread( ( name ) ); } while( 0 )
+
+#else
+
+#define INSTRUMENT_SCOPE( name ) ( ( void )0 )
+#define INSTRUMENT_THREAD_NAME( name ) ( ( void )0 )
+
+#endif // RIPPER_INSTRUMENT
+
+
+// Turns recording on for the lifetime of the session when --stats is given, then writes statsFilename and
+// traceFilename on destruction, so every exit path out of main() produces output
+class InstrumentSession
+{
+public:
+  InstrumentSession( bool enabled, const char* statsFilename, const char* traceFilename );
+  ~InstrumentSession();
+
+  InstrumentSession( const InstrumentSession& ) = delete;
+  InstrumentSession& operator=( const InstrumentSession& ) = delete;
+
+private:
+  bool m_enabled;
+  const char* m_statsFilename;
+  const char* m_traceFilename;
+};
+
+// Scans the command line for --stats
+bool HasStatsOption( int argc, char* argv[] );
+
+#endif // __cplusplus
+
+#endif // INSTRUMENT_INSTRUMENT_H
@@ -33,9 +33,16 @@
  */
 
 #include "lzw.h"
+#include "../instrument/instrument.h"
+#include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
-typedef void (*WRITE_DECOMP)(unsigned char root, unsigned char *destination, long* position);
+#define LZW_DICTIONARY_SIZE 0x1000
+#define LZW_STACK_SIZE      0x8000
+
+/* re-initialize the dictionary when there are more than 0xccc entries */
+#define LZW_MAX_DICT_ENTRIES 0xccc
 
 typedef struct _lzwDictionaryEntry
 {
@@ -44,12 +51,21 @@ typedef struct _lzwDictionaryEntry
     unsigned char occupied;
 } lzwDictionaryEntry;
 
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize);
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem);
-void discardRoot(unsigned char root, unsigned char *destination, long* position);
-void outputRoot(unsigned char root, unsigned char *destination, long* position);
-
-void getString(int codeword, lzwDictionaryEntry *lzwDictionary, unsigned char* stack, int *elementsInStack);
+struct _lzwContext
+{
+    lzwDictionaryEntry dictionary[LZW_DICTIONARY_SIZE];
+    unsigned char stack[LZW_STACK_SIZE];
+};
+
+long generalizedDecompress(lzwContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity, long* codewordsUsed);
+long getCodewordBytes(long numCodewords);
+long getNumCodewords(long compressedSize);
+int getNextCodeword(long codewordIndex, unsigned char *compressedMem);
+long outputString(unsigned char *stack, int elementsInStack, unsigned char *destination, long position, long capacity);
+void clearDictionary(lzwDictionaryEntry *dictionary);
+void lzwEndInstrumentStage(unsigned char* decompressedMem, long result);
+
+int getString(int codeword, lzwDictionaryEntry *lzwDictionary, unsigned char* stack, int *elementsInStack);
 int getNewHashCode(unsigned char root, int codeword, lzwDictionaryEntry* dictionary);
 int probe1(unsigned char root, int codeword);
 int probe2(unsigned char root, int codeword);
@@ -62,14 +78,15 @@ unsigned char hashPosFound(int hashCode, unsigned char root, int codeword, lzwDi
  * Use this function if you want to decompress a block of data, but don't know the decompressed size
  * in advance.
  *
- * There is some error checking to detect if the compressed data is corrupt, but it's only rudimentary.
+ * Corrupt data (a codeword that can't be decoded, or a dictionary chain that doesn't end in a root)
+ * is detected and reported as an error.
  * Returns:
  * No errors: (long) decompressed size
  * Error: (long) -1
  */
 long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize)
 {
-    return(generalizedDecompress(&discardRoot, compressedMem, NULL, compressedSize));
+    return(generalizedDecompress(NULL, compressedMem, NULL, compressedSize, LONG_MAX, NULL));
 }
 
 /*
@@ -77,15 +94,97 @@ long lzwGetDecompressedSize(unsigned char* compressedMem, long compressedSize)
  * Use this function if you already know the decompressed size.
  *
  * This function assumes that *decompressed_mem is already allocated, and that the decompressed data
- * will fit into *decompressed_mem.
- * There is some error checking to detect if the compressed data is corrupt, but it's only rudimentary.
+ * will fit into *decompressed_mem. Use lzwDecompressBounded() for data that can't be trusted.
  * Returns:
  * No errors: (long) decompressed size
  * Error: (long) -1
  */
 long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
 {
-    return(generalizedDecompress(&outputRoot, compressedMem, decompressedMem, compressedSize));
+    return(generalizedDecompress(NULL, compressedMem, decompressedMem, compressedSize, LONG_MAX, NULL));
+}
+
+/*
+ * Same as lzwDecompress(), but never writes more than decompressedCapacity bytes.
+ * Returns:
+ * No errors: (long) decompressed size
+ * Error, or the decompressed data doesn't fit: (long) -1
+ */
+long lzwDecompressBounded(unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity)
+{
+    if (decompressedMem == NULL || decompressedCapacity < 0)
+    {
+        return(-1);
+    }
+
+    return(generalizedDecompress(NULL, compressedMem, decompressedMem, compressedSize, decompressedCapacity, NULL));
+}
+
+lzwContext* lzwCreateContext(void)
+{
+    lzwContext* context = (lzwContext *) malloc(sizeof(lzwContext));
+
+    INSTRUMENT_COUNT(COUNTER_ALLOCATIONS, 1);
+    INSTRUMENT_COUNT(COUNTER_ALLOCATED_BYTES, sizeof(lzwContext));
+
+    return(context);
+}
+
+void lzwDestroyContext(lzwContext* context)
+{
+    free(context);
+}
+
+/*
+ * Same as lzwGetDecompressedSize(), using the context's dictionary and stack.
+ */
+long lzwContextGetDecompressedSize(lzwContext* context, unsigned char* compressedMem, long compressedSize)
+{
+    if (context == NULL)
+    {
+        return(-1);
+    }
+
+    return(generalizedDecompress(context, compressedMem, NULL, compressedSize, LONG_MAX, NULL));
+}
+
+/*
+ * Same as lzwDecompressBounded(), using the context's dictionary and stack.
+ */
+long lzwContextDecompressBounded(lzwContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity)
+{
+    if (context == NULL || decompressedMem == NULL || decompressedCapacity < 0)
+    {
+        return(-1);
+    }
+
+    return(generalizedDecompress(context, compressedMem, decompressedMem, compressedSize, decompressedCapacity, NULL));
+}
+
+/*
+ * Decodes as much of the compressed data as decodes cleanly, for streams whose end isn't known (one
+ * embedded in an executable, or followed by other data). Where the functions above fail, this one
+ * stops: at the first codeword that can't be decoded, or when the next string doesn't fit in
+ * decompressedCapacity. The number of compressed bytes that held the decoded codewords is stored in
+ * *compressedUsed. decompressedMem may be NULL to only count.
+ * Returns:
+ * No errors: (long) size of the decompressed prefix (0 if not even the first codeword decodes)
+ * Error: (long) -1
+ */
+long lzwContextDecompressPrefix(lzwContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity, long* compressedUsed)
+{
+    long codewordsUsed = 0;
+    long result;
+
+    if (context == NULL || compressedUsed == NULL || decompressedCapacity < 0)
+    {
+        return(-1);
+    }
+
+    result = generalizedDecompress(context, compressedMem, decompressedMem, compressedSize, decompressedCapacity, &codewordsUsed);
+    *compressedUsed = result >= 0 ? getCodewordBytes(codewordsUsed) : 0;
+
+    return(result);
 }
 
 /* --------------------------------------------------------------------------------------
@@ -95,27 +194,34 @@ long lzwDecompress(unsigned char* compressedMem, unsigned char* decompressedMem,
 /*
  * This function does the actual decompression work.
  * Parameters:
- * perform_decompression: FALSE ==> return decompressed size, but discard decompressed data
+ * context: the dictionary and stack to use (NULL ==> allocate them for this call only)
  * compressed_mem: compressed data
  * decompressed_mem: this is where the compressed data will be decompressed to
+ *                   (NULL ==> return decompressed size, but discard decompressed data)
  * compressed_size: size of the compressed data (in bytes)
+ * decompressed_capacity: size of decompressed_mem (in bytes)
+ * codewords_used: NULL ==> corrupt data is an error
+ *                 otherwise ==> corrupt data ends the stream, the number of codewords decoded before it
+ *                 is stored here, and the size of their output is returned
+ *
+ * Bounds are checked per block rather than per byte: the number of codewords is worked out once up
+ * front, so reading a codeword needs no check, and each decoded string is checked against the
+ * output capacity once before it is copied out.
  */
-long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize)
+long generalizedDecompress(lzwContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity, long* codewordsUsed)
 {
-    int i;
-
-    /* re-initialize the dictionary when there are more than 0xccc entries */
-    const int maxDictEntries = 0xccc;
-
-    const int lzwStackSize = 0x8000;
-    const int lzwDictionarySize = 0x1000;
-
     int old_code;
     int new_code;
     unsigned char character;
 
-    long bitsRead = 0;
+    long numCodewords;
+    long codewordsRead = 0;
     long bytesWritten = 0;
+    long result = -1;
+
+    /* the codewords and output up to the last codeword that decoded cleanly */
+    long goodCodewords = 0;
+    long goodBytes = 0;
 
     /* newpos: position in the dictionary where new codeword was added                      */
     /* must be equal to current codeword (if it isn't, the compressed data must be corrupt) */
@@ -123,32 +229,76 @@ long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, u
     int newpos;
     unsigned char unknownCodeword;
 
-    /* initialize the dictionary and the stack */
-    lzwDictionaryEntry *lzwDictionary = (lzwDictionaryEntry *) malloc(sizeof(int) * lzwDictionarySize);
+    lzwDictionaryEntry *lzwDictionary;
     int codewordsInDictionary = 0;
-    unsigned char *lzwStack = (unsigned char *) malloc(sizeof(unsigned char) * lzwStackSize);
+    unsigned char *lzwStack;
     int elementsInStack = 0;
 
-    /* clear the dictionary */
-    memset(lzwDictionary, 0, sizeof(int) * lzwDictionarySize);
-    for (i = 0; i < 0x100; i++)
+    if (compressedSize < 0 || (compressedMem == NULL && compressedSize > 0))
+    {
+        return(-1);
+    }
+
+    numCodewords = getNumCodewords(compressedSize);
+
+    /* initialize the dictionary and the stack */
+    if (context != NULL)
+    {
+        lzwDictionary = context->dictionary;
+        lzwStack = context->stack;
+    }
+    else
+    {
+        lzwDictionary = (lzwDictionaryEntry *) malloc(sizeof(lzwDictionaryEntry) * LZW_DICTIONARY_SIZE);
+        lzwStack = (unsigned char *) malloc(sizeof(unsigned char) * LZW_STACK_SIZE);
+    }
+
+    /* the size-only pass is timed separately so it doesn't inflate the decompression numbers */
+    INSTRUMENT_BEGIN_STAGE(decompressedMem != NULL ? "lzw" : "lzw_size");
+    if (context == NULL)
+    {
+        INSTRUMENT_COUNT(COUNTER_ALLOCATIONS, 2);
+        INSTRUMENT_COUNT(COUNTER_ALLOCATED_BYTES, sizeof(lzwDictionaryEntry) * LZW_DICTIONARY_SIZE + LZW_STACK_SIZE);
+    }
+    if (decompressedMem != NULL)
+    {
+        INSTRUMENT_COUNT(COUNTER_BYTES_IN, compressedSize);
+    }
+
+    if (lzwDictionary == NULL || lzwStack == NULL)
     {
-        lzwDictionary[i].occupied = 1;
+        goto cleanup;
     }
 
-    if (bitsRead + 12 <= compressedSize * 8)
+    clearDictionary(lzwDictionary);
+
+    if (codewordsRead < numCodewords)
     {
         /* read OLD_CODE */
-        old_code = getNextCodeword(&bitsRead, compressedMem);
+        old_code = getNextCodeword(codewordsRead++, compressedMem);
+
+        /* the first codeword is always a root */
+        if (old_code > 0xff)
+        {
+            goto cleanup;
+        }
+
         /* CHARACTER = OLD_CODE */
         character = (unsigned char)old_code;
         /* output OLD_CODE */
-        outFunc(character, decompressedMem, &bytesWritten);
+        bytesWritten = outputString(&character, 1, decompressedMem, bytesWritten, decompressedCapacity);
+        if (bytesWritten < 0)
+        {
+            goto cleanup;
+        }
+
+        goodCodewords = codewordsRead;
+        goodBytes = bytesWritten;
 
-        while (bitsRead + 12 <= compressedSize * 8) /* WHILE there are still input characters DO */
+        while (codewordsRead < numCodewords) /* WHILE there are still input characters DO */
         {
             /* read NEW_CODE */
-            new_code = getNextCodeword(&bitsRead, compressedMem);
+            new_code = getNextCodeword(codewordsRead++, compressedMem);
 
             if (lzwDictionary[new_code].occupied)   /* is the codeword in the dictionary? */
             {
@@ -157,7 +307,10 @@ long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, u
                 unknownCodeword = 0;
 
                 /* STRING = get translation of NEW_CODE */
-                getString(new_code,lzwDictionary,lzwStack,&elementsInStack);
+                if (!getString(new_code,lzwDictionary,lzwStack,&elementsInStack))
+                {
+                    goto cleanup;
+                }
             }
             else
             {
@@ -169,17 +322,21 @@ long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, u
                 lzwStack[elementsInStack] = character;   /* push character on the stack */
                 elementsInStack++;
 
-                getString(old_code,lzwDictionary,lzwStack,&elementsInStack);
+                if (!getString(old_code,lzwDictionary,lzwStack,&elementsInStack))
+                {
+                    goto cleanup;
+                }
             }
 
             /* CHARACTER = first character in STRING */
             character = lzwStack[elementsInStack-1];   /* element at top of stack */
 
             /* output STRING */
-            while (elementsInStack > 0)
+            bytesWritten = outputString(lzwStack, elementsInStack, decompressedMem, bytesWritten, decompressedCapacity);
+            elementsInStack = 0;
+            if (bytesWritten < 0)
             {
-                outFunc(lzwStack[elementsInStack-1], decompressedMem, &bytesWritten);
-                elementsInStack--;
+                goto cleanup;
             }
 
             /* add OLD_CODE + CHARACTER to the translation table */
@@ -193,87 +350,178 @@ long generalizedDecompress(WRITE_DECOMP outFunc, unsigned char* compressedMem, u
             /* check for errors */
             if (unknownCodeword && (newpos != new_code))
             {
-                /* clean up */
-                free(lzwStack);
-                free(lzwDictionary);
-
-                return(-1);
+                goto cleanup;
             }
 
-            if (codewordsInDictionary > maxDictEntries)
+            goodCodewords = codewordsRead;
+            goodBytes = bytesWritten;
+
+            if (codewordsInDictionary > LZW_MAX_DICT_ENTRIES)
             {
                 /* wipe dictionary */
+                INSTRUMENT_COUNT(COUNTER_LZW_DICTIONARY_RESETS, 1);
                 codewordsInDictionary = 0;
-                memset(lzwDictionary, 0, sizeof(int) * lzwDictionarySize);
-                for (i = 0; i < 0x100; i++)
-                {
-                    lzwDictionary[i].occupied = 1;
-                }
+                clearDictionary(lzwDictionary);
 
-                if (bitsRead + 12 <= compressedSize * 8)
+                if (codewordsRead < numCodewords)
                 {
-                    new_code = getNextCodeword(&bitsRead, compressedMem);
+                    new_code = getNextCodeword(codewordsRead++, compressedMem);
+
+                    /* like the first codeword, the first one after a wipe must be a root */
+                    if (new_code > 0xff)
+                    {
+                        goto cleanup;
+                    }
+
                     character = (unsigned char)new_code;
 
-                    outFunc(character, decompressedMem, &bytesWritten);
+                    bytesWritten = outputString(&character, 1, decompressedMem, bytesWritten, decompressedCapacity);
+                    if (bytesWritten < 0)
+                    {
+                        goto cleanup;
+                    }
                 }
                 else
                 {
-                    /* clean up */
-                    free(lzwStack);
-                    free(lzwDictionary);
-
-                    return(bytesWritten);
+                    break;
                 }
             }
 
             /* OLD_CODE = NEW_CODE */
             old_code = new_code;
+
+            goodCodewords = codewordsRead;
+            goodBytes = bytesWritten;
         }
-    }    
-    /* clean up */
-    free(lzwStack);
-    free(lzwDictionary);
+    }
+
+    result = bytesWritten;
+
+cleanup:
+    if (codewordsUsed != NULL && lzwDictionary != NULL && lzwStack != NULL)
+    {
+        *codewordsUsed = goodCodewords;
+        result = goodBytes;
+    }
+
+    if (context == NULL)
+    {
+        free(lzwStack);
+        free(lzwDictionary);
+    }
+
+    lzwEndInstrumentStage(decompressedMem, result);
+    return(result);
+}
+
+/*
+ * The compressed data is made up of 12-bit codewords, so every 3 bytes hold 2 codewords.
+ * A trailing byte pair holds 1 more codeword, and any other leftover bits are padding.
+ */
+long getNumCodewords(long compressedSize)
+{
+    return((compressedSize / 3) * 2 + ((compressedSize % 3) == 2 ? 1 : 0));
+}
 
-    return(bytesWritten);
+/* the bytes that hold the first numCodewords codewords (the inverse of getNumCodewords) */
+long getCodewordBytes(long numCodewords)
+{
+    return((numCodewords / 2) * 3 + ((numCodewords % 2) == 1 ? 2 : 0));
+}
+
+/*
+ * Reads a 12-bit codeword from the compressed data.
+ * Only the bytes that hold the codeword are read, so any index below getNumCodewords() is in bounds.
+ */
+int getNextCodeword(long codewordIndex, unsigned char *compressedMem)
+{
+    unsigned char *block = compressedMem + (codewordIndex / 2) * 3;
+
+    INSTRUMENT_COUNT(COUNTER_LZW_CODEWORDS, 1);
+
+    if ((codewordIndex & 1) == 0)
+    {
+        /* high 8 bits in the first byte, low 4 bits in the upper half of the second byte */
+        return((block[0] << 4) | (block[1] >> 4));
+    }
+    else
+    {
+        /* high 4 bits in the lower half of the second byte, low 8 bits in the third byte */
+        return(((block[1] & 0x0f) << 8) | block[2]);
+    }
 }
 
-/* read the next 12-bit codeword from the compressed data */
-int getNextCodeword(long* bitsRead, unsigned char *compressedMem)
+/*
+ * Writes the string on the stack (top of stack first) and returns the new position.
+ * The whole string is checked against the capacity once, before anything is written.
+ * Returns -1 if it doesn't fit. A NULL destination only advances the position.
+ */
+long outputString(unsigned char *stack, int elementsInStack, unsigned char *destination, long position, long capacity)
 {
-    int codeword = (compressedMem[(*bitsRead)/8] << 8) + compressedMem[(*bitsRead)/8+1];
-    codeword = codeword >> (4-((*bitsRead)%8));
-    codeword = codeword & 0xfff;
-    (*bitsRead) += 12;
+    if (elementsInStack > capacity - position)
+    {
+        return(-1);
+    }
+
+    if (destination != NULL)
+    {
+        unsigned char *out = destination + position;
+        int i;
+
+        for (i = elementsInStack - 1; i >= 0; i--)
+        {
+            *out++ = stack[i];
+        }
+    }
 
-    return(codeword);
+    return(position + elementsInStack);
 }
 
-/* increment position pointer, but do not write root to memory */
-void discardRoot(unsigned char root, unsigned char *destination, long* position)
+/* empties the dictionary, except for the roots */
+void clearDictionary(lzwDictionaryEntry *dictionary)
 {
-    (*position)++;
+    int i;
+
+    memset(dictionary, 0, sizeof(lzwDictionaryEntry) * LZW_DICTIONARY_SIZE);
+    for (i = 0; i < 0x100; i++)
+    {
+        dictionary[i].occupied = 1;
+    }
 }
 
-/* output a root to memory */
-void outputRoot(unsigned char root, unsigned char *destination, long* position)
+/* closes the stage opened by generalizedDecompress, counting the output of real decompressions only */
+void lzwEndInstrumentStage(unsigned char* decompressedMem, long result)
 {
-    destination[*position] = root;
-    (*position)++;
+    if (decompressedMem != NULL && result > 0)
+    {
+        INSTRUMENT_COUNT(COUNTER_BYTES_OUT, result);
+    }
+    INSTRUMENT_END_STAGE();
 }
 
 /* --------------------------------------------------------------------------------------
    Dictionary-related functions
    -------------------------------------------------------------------------------------- */
 
-/* pushes the string associated with codeword onto the stack */
-void getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stack, int *elementsInStack)
+/*
+ * Pushes the string associated with codeword onto the stack.
+ * Every dictionary entry points at an entry that was added before it, so a valid chain visits each
+ * entry at most once and the string can't be longer than the dictionary. A longer chain means the
+ * data is corrupt, and 0 is returned before the stack can overflow.
+ */
+int getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stack, int *elementsInStack)
 {
     unsigned char root;
     int currentCodeword = codeword;
+    int stackLimit = *elementsInStack + LZW_DICTIONARY_SIZE;
 
     while (currentCodeword > 0xff)
     {
+        if (*elementsInStack >= stackLimit)
+        {
+            return(0);
+        }
+
         root = dictionary[currentCodeword].root;
         currentCodeword = dictionary[currentCodeword].codeword;
         stack[*elementsInStack] = root;
@@ -283,6 +531,8 @@ void getString(int codeword, lzwDictionaryEntry *dictionary, unsigned char *stac
     /* push the root at the leaf */
     stack[*elementsInStack] = (unsigned char)currentCodeword;
     (*elementsInStack)++;
+
+    return(1);
 }
 
 int getNewHashCode (unsigned char root, int codeword, lzwDictionaryEntry *dictionary)
@@ -290,17 +540,20 @@ int getNewHashCode (unsigned char root, int codeword, lzwDictionaryEntry *dictio
     int hashCode;
 
     /* probe 1 */
+    INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
     hashCode = probe1(root, codeword);
     if (hashPosFound(hashCode, root, codeword, dictionary)) {
         return(hashCode);
     }
     /* probe 2 */
+    INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
     hashCode = probe2(root, codeword);
     if (hashPosFound(hashCode, root, codeword, dictionary)) {
         return(hashCode);
     }
     /* probe 3 */
     do {
+        INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
         hashCode = probe3(hashCode);
     }
     while (! hashPosFound(hashCode, root, codeword, dictionary));
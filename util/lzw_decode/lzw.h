@@ -23,5 +23,25 @@
 
 long lzwGetDecompressedSize(unsigned char* compressed_mem, long compressed_size);
 long lzwDecompress(unsigned char* compressed_mem, unsigned char* decompressed_mem, long compressed_size);
+long lzwDecompressBounded(unsigned char* compressed_mem, unsigned char* decompressed_mem, long compressed_size, long decompressed_capacity);
+
+/*
+ * The functions above allocate a dictionary and a stack for every call. Callers that decompress many
+ * streams (or can't allocate while they do) create a context once and pass it to the functions below,
+ * which allocate nothing. A context holds one decompression at a time.
+ */
+typedef struct _lzwContext lzwContext;
+
+lzwContext* lzwCreateContext(void);
+void lzwDestroyContext(lzwContext* context);
+
+long lzwContextGetDecompressedSize(lzwContext* context, unsigned char* compressed_mem, long compressed_size);
+long lzwContextDecompressBounded(lzwContext* context, unsigned char* compressed_mem, unsigned char* decompressed_mem, long compressed_size, long decompressed_capacity);
+
+/*
+ * Decodes up to the first codeword that can't be decoded instead of failing there, for streams whose
+ * end isn't known. Stores the compressed bytes the decoded part used in *compressed_used.
+ */
+long lzwContextDecompressPrefix(lzwContext* context, unsigned char* compressed_mem, unsigned char* decompressed_mem, long compressed_size, long decompressed_capacity, long* compressed_used);
 
 #endif /* LZW_H */
@@ -0,0 +1,291 @@
+/*
+ *  lzwenc.c - LZW compression from memory to memory, in the format lzw.c decompresses
+ */
+
+/*
+ * The U4 decoder doesn't number its dictionary entries in order: each new string goes wherever the
+ * hash probes in lzw.c put it, and the dictionary is wiped once it holds more than 0xccc strings. So
+ * the encoder keeps an exact copy of the decoder's hash table and places every string with the same
+ * probes, which makes the codeword it picks the one the decoder will look up.
+ *
+ * The hash table is only consulted to place new strings. Matching the input goes through a flat
+ * table indexed by codeword and next byte, so extending the current string is a single load. The
+ * entries it gains are remembered, so a wipe only clears those instead of the whole table.
+ *
+ * The decoder adds the string for a codeword while it reads the next one, and after a wipe it reads
+ * a root without adding anything. So the codeword that follows the string that fills the dictionary
+ * is still matched against the full dictionary, and the wipe comes after it, in place of adding a
+ * string.
+ */
+
+#include "lzwenc.h"
+#include "../instrument/instrument.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define LZW_DICTIONARY_SIZE  0x1000
+#define LZW_MAX_DICT_ENTRIES 0xccc
+
+typedef struct _lzwEncoderEntry
+{
+    unsigned char root;
+    int codeword;
+    unsigned char occupied;
+} lzwEncoderEntry;
+
+struct _lzwEncoder
+{
+    /* the decoder's hash table */
+    lzwEncoderEntry dictionary[LZW_DICTIONARY_SIZE];
+
+    /* next[(codeword << 8) | byte]: the codeword of that string followed by that byte, or 0 if it isn't in the dictionary */
+    unsigned short next[LZW_DICTIONARY_SIZE << 8];
+
+    /* the next[] slots in use, to clear on a wipe */
+    int used[LZW_DICTIONARY_SIZE];
+    int numUsed;
+};
+
+static void clearEncoder(lzwEncoder* encoder);
+static int placeString(unsigned char root, int codeword, lzwEncoderEntry* dictionary);
+static int encoderProbe2(unsigned char root, int codeword);
+static int freeHashPos(int hashCode, lzwEncoderEntry* dictionary);
+
+lzwEncoder* lzwCreateEncoder(void)
+{
+    lzwEncoder* encoder = (lzwEncoder *) malloc(sizeof(lzwEncoder));
+
+    INSTRUMENT_COUNT(COUNTER_ALLOCATIONS, 1);
+    INSTRUMENT_COUNT(COUNTER_ALLOCATED_BYTES, sizeof(lzwEncoder));
+
+    if (encoder != NULL)
+    {
+        memset(encoder->next, 0, sizeof(encoder->next));
+        encoder->numUsed = 0;
+    }
+
+    return(encoder);
+}
+
+void lzwDestroyEncoder(lzwEncoder* encoder)
+{
+    free(encoder);
+}
+
+/*
+ * The largest compressed size for decompressedSize bytes: one codeword per byte.
+ * Every 2 codewords take 3 bytes, and a trailing odd codeword takes 2.
+ */
+long lzwGetCompressBound(long decompressedSize)
+{
+    if (decompressedSize < 0)
+    {
+        return(-1);
+    }
+
+    return((decompressedSize / 2) * 3 + (decompressedSize % 2) * 2);
+}
+
+/*
+ * Compresses a block of data from memory to memory.
+ * Returns:
+ * No errors: (long) compressed size
+ * Error, or the compressed data doesn't fit: (long) -1
+ */
+long lzwCompress(lzwEncoder* encoder, unsigned char* decompressedMem, unsigned char* compressedMem, long decompressedSize, long compressedCapacity)
+{
+    int string;
+    int codeword;
+    int hashCode;
+    unsigned char character = 0;
+
+    /* a codeword waiting for the one that completes its 3 bytes (-1: none) */
+    int pending = -1;
+    int codewordsInDictionary = 0;
+    unsigned char wipeNext = 0;
+
+    long position;
+    long bytesWritten = 0;
+    long result = -1;
+
+    if (encoder == NULL || decompressedSize < 0 || compressedCapacity < 0 ||
+        (decompressedMem == NULL && decompressedSize > 0) || (compressedMem == NULL && compressedCapacity > 0))
+    {
+        return(-1);
+    }
+
+    INSTRUMENT_BEGIN_STAGE("lzw_encode");
+    INSTRUMENT_COUNT(COUNTER_BYTES_IN, decompressedSize);
+
+    if (decompressedSize == 0)
+    {
+        result = 0;
+        goto cleanup;
+    }
+
+    clearEncoder(encoder);
+
+    string = decompressedMem[0];
+
+    for (position = 1; position <= decompressedSize; position++)
+    {
+        if (position < decompressedSize)
+        {
+            character = decompressedMem[position];
+            codeword = encoder->next[(string << 8) | character];
+            if (codeword != 0)
+            {
+                string = codeword;
+                continue;
+            }
+        }
+
+        /* write the codeword for the longest match, 2 codewords to 3 bytes */
+        INSTRUMENT_COUNT(COUNTER_LZW_CODEWORDS, 1);
+        if (pending < 0)
+        {
+            pending = string;
+        }
+        else
+        {
+            if (compressedCapacity - bytesWritten < 3)
+            {
+                goto cleanup;
+            }
+
+            compressedMem[bytesWritten++] = (unsigned char)(pending >> 4);
+            compressedMem[bytesWritten++] = (unsigned char)(((pending & 0x0f) << 4) | (string >> 8));
+            compressedMem[bytesWritten++] = (unsigned char)(string & 0xff);
+            pending = -1;
+        }
+
+        if (position == decompressedSize)
+        {
+            break;
+        }
+
+        if (wipeNext)
+        {
+            /* the decoder wipes its dictionary here, and reads the next codeword as a root */
+            INSTRUMENT_COUNT(COUNTER_LZW_DICTIONARY_RESETS, 1);
+            clearEncoder(encoder);
+            wipeNext = 0;
+        }
+        else
+        {
+            /* add STRING + CHARACTER where the decoder will */
+            hashCode = placeString(character, string, encoder->dictionary);
+
+            encoder->dictionary[hashCode].root = character;
+            encoder->dictionary[hashCode].codeword = string;
+            encoder->dictionary[hashCode].occupied = 1;
+
+            encoder->next[(string << 8) | character] = (unsigned short)hashCode;
+            encoder->used[encoder->numUsed++] = (string << 8) | character;
+
+            codewordsInDictionary++;
+            if (codewordsInDictionary > LZW_MAX_DICT_ENTRIES)
+            {
+                codewordsInDictionary = 0;
+                wipeNext = 1;
+            }
+        }
+
+        string = character;
+    }
+
+    /* a trailing odd codeword takes 2 bytes, its last 4 bits padding */
+    if (pending >= 0)
+    {
+        if (compressedCapacity - bytesWritten < 2)
+        {
+            goto cleanup;
+        }
+
+        compressedMem[bytesWritten++] = (unsigned char)(pending >> 4);
+        compressedMem[bytesWritten++] = (unsigned char)((pending & 0x0f) << 4);
+    }
+
+    result = bytesWritten;
+
+cleanup:
+    if (result > 0)
+    {
+        INSTRUMENT_COUNT(COUNTER_BYTES_OUT, result);
+    }
+    INSTRUMENT_END_STAGE();
+
+    return(result);
+}
+
+/* --------------------------------------------------------------------------------------
+   Functions used only inside lzwenc.c
+   -------------------------------------------------------------------------------------- */
+
+/* empties the dictionary, except for the roots, and forgets every match */
+static void clearEncoder(lzwEncoder* encoder)
+{
+    int i;
+
+    for (i = 0; i < encoder->numUsed; i++)
+    {
+        encoder->next[encoder->used[i]] = 0;
+    }
+    encoder->numUsed = 0;
+
+    memset(encoder->dictionary, 0, sizeof(encoder->dictionary));
+    for (i = 0; i < 0x100; i++)
+    {
+        encoder->dictionary[i].occupied = 1;
+    }
+}
+
+/*
+ * The position getNewHashCode() in lzw.c picks for a new string. The string is never in the
+ * dictionary yet, so that is the first free non-root position along the same probes.
+ */
+static int placeString(unsigned char root, int codeword, lzwEncoderEntry* dictionary)
+{
+    int hashCode;
+
+    INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
+    hashCode = ((root << 4) ^ codeword) & 0xfff;
+    if (freeHashPos(hashCode, dictionary))
+    {
+        return(hashCode);
+    }
+
+    INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
+    hashCode = encoderProbe2(root, codeword);
+    if (freeHashPos(hashCode, dictionary))
+    {
+        return(hashCode);
+    }
+
+    do
+    {
+        INSTRUMENT_COUNT(COUNTER_LZW_PROBES, 1);
+        hashCode = (hashCode + 0x1fd) & 0xfff;
+    }
+    while (!freeHashPos(hashCode, dictionary));
+
+    return(hashCode);
+}
+
+/*
+ * probe2() from lzw.c in closed form. It squares AX into DX:AX and rotates DX:AX left twice through
+ * the carry, then takes bits 8-19. The rotated-in bits only reach bits 0 and 1, so that is bits 6-17
+ * of the square.
+ */
+static int encoderProbe2(unsigned char root, int codeword)
+{
+    unsigned long ax = (((unsigned long)root << 1) + (unsigned long)codeword) | 0x800;
+    unsigned long square = ax * ax;
+
+    return((int)((square >> 6) & 0xfff));
+}
+
+static int freeHashPos(int hashCode, lzwEncoderEntry* dictionary)
+{
+    return(hashCode > 0xff && !dictionary[hashCode].occupied);
+}
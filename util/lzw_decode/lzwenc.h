@@ -0,0 +1,21 @@
+/*
+ *  lzwenc.h - LZW compression from memory to memory, in the format lzw.c decompresses
+ */
+
+#ifndef LZWENC_H
+#define LZWENC_H
+
+/*
+ * The encoder's dictionary and lookup tables (a little over 2 MB), allocated once and reused for any
+ * number of files. An encoder holds no other state, so files can be compressed in parallel with one
+ * encoder per thread (lzw_pack.h does that for a batch of files).
+ */
+typedef struct _lzwEncoder lzwEncoder;
+
+lzwEncoder* lzwCreateEncoder(void);
+void lzwDestroyEncoder(lzwEncoder* encoder);
+
+long lzwGetCompressBound(long decompressedSize);
+long lzwCompress(lzwEncoder* encoder, unsigned char* decompressedMem, unsigned char* compressedMem, long decompressedSize, long compressedCapacity);
+
+#endif /* LZWENC_H */
@@ -0,0 +1,325 @@
+/*
+ *  lzwvar.c - variable-width LZW decompression from memory to memory
+ */
+
+/*
+ * The later PC Ultima titles moved from U4's fixed 12-bit codewords and hashed dictionary (see lzw.c)
+ * to textbook LZW: 9 to 12 bit codewords, a dictionary indexed by the codeword itself, and reserved
+ * codewords to reset the dictionary and to end the stream. The codeword grows by a bit as soon as the
+ * next free entry no longer fits in the current width.
+ *
+ * Two things keep this decoder fast:
+ * 1) Codewords come out of a 64-bit bit buffer that is refilled 7 bytes at a time with a single load,
+ *    so reading a codeword is a mask and a shift with one well-predicted branch.
+ * 2) The dictionary doesn't store prefix chains. Every new entry is the previous string plus the byte
+ *    that was written right after it, so the entry's string is already sitting in the output. The
+ *    dictionary records where it is and how long it is, and decoding a codeword is one forward copy
+ *    instead of a walk down the chain onto a stack.
+ * An article on LZW data (de)compression can be found here:
+ * http://dogma.net/markn/articles/lzw/lzw.htm
+ */
+
+#include "lzwvar.h"
+#include "../instrument/instrument.h"
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZWVAR_DICTIONARY_SIZE 0x1000
+#define LZWVAR_RESET_CODE      0x100
+#define LZWVAR_END_CODE        0x101
+#define LZWVAR_FIRST_FREE      0x102
+#define LZWVAR_MIN_WIDTH       9
+#define LZWVAR_MAX_WIDTH       12
+
+struct _lzwVarContext
+{
+    /* where each entry's string was written in the output, and its length (roots aren't stored) */
+    long offset[LZWVAR_DICTIONARY_SIZE];
+    unsigned short length[LZWVAR_DICTIONARY_SIZE];
+
+    /* bit reader: bitCount bits of bitBuffer are valid, least significant first */
+    unsigned char* input;
+    long inputSize;
+    long inputPosition;
+    unsigned long long bitBuffer;
+    int bitCount;
+};
+
+static long decompressStream(lzwVarContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity);
+static void refillBits(lzwVarContext* context);
+static int readCodeword(lzwVarContext* context, int width);
+static void copyForward(unsigned char* destination, const unsigned char* source, long length);
+
+lzwVarContext* lzwVarCreateContext(void)
+{
+    lzwVarContext* context = (lzwVarContext *) malloc(sizeof(lzwVarContext));
+
+    INSTRUMENT_COUNT(COUNTER_ALLOCATIONS, 1);
+    INSTRUMENT_COUNT(COUNTER_ALLOCATED_BYTES, sizeof(lzwVarContext));
+
+    return(context);
+}
+
+void lzwVarDestroyContext(lzwVarContext* context)
+{
+    free(context);
+}
+
+/*
+ * Checks the header of a compressed file: the decompressed size, followed by a stream that starts by
+ * resetting the dictionary.
+ * Returns:
+ * Looks like a compressed file: (long) decompressed size
+ * Otherwise: (long) -1
+ */
+long lzwVarReadHeader(unsigned char* fileMem, long fileSize)
+{
+    long size;
+
+    if (fileMem == NULL || fileSize < LZWVAR_HEADER_SIZE + 2)
+    {
+        return(-1);
+    }
+
+    if ((fileMem[4] | ((fileMem[5] & 1) << 8)) != LZWVAR_RESET_CODE)
+    {
+        return(-1);
+    }
+
+    size = (long)fileMem[0] | ((long)fileMem[1] << 8) | ((long)fileMem[2] << 16) | ((long)(fileMem[3] & 0x7f) << 24);
+    return(fileMem[3] & 0x80 ? -1 : size);
+}
+
+/*
+ * Returns the decompressed size of a stream without decompressing it.
+ * Returns:
+ * No errors: (long) decompressed size
+ * Error (a codeword that can't be decoded, or no end codeword): (long) -1
+ */
+long lzwVarGetDecompressedSize(lzwVarContext* context, unsigned char* compressedMem, long compressedSize)
+{
+    return(decompressStream(context, compressedMem, NULL, compressedSize, LONG_MAX));
+}
+
+/*
+ * Decompresses a stream, never writing more than decompressedCapacity bytes.
+ * Returns:
+ * No errors: (long) decompressed size
+ * Error, or the decompressed data doesn't fit: (long) -1
+ */
+long lzwVarDecompressBounded(lzwVarContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity)
+{
+    if (decompressedMem == NULL || decompressedCapacity < 0)
+    {
+        return(-1);
+    }
+
+    return(decompressStream(context, compressedMem, decompressedMem, compressedSize, decompressedCapacity));
+}
+
+/* --------------------------------------------------------------------------------------
+   Functions used only inside lzwvar.c
+   -------------------------------------------------------------------------------------- */
+
+/*
+ * decompressed_mem == NULL only measures the output. The dictionary lengths are all that's needed for
+ * that, so the offsets are kept but never used.
+ */
+static long decompressStream(lzwVarContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity)
+{
+    int width = LZWVAR_MIN_WIDTH;
+    int nextFree = LZWVAR_FIRST_FREE;
+    int codeword;
+
+    /* the previous string, which the next dictionary entry extends (-1: none since the last reset) */
+    int previous = -1;
+    long previousStart = 0;
+    long previousLength = 0;
+
+    long source;
+    long length;
+    long position = 0;
+    long result = -1;
+
+    if (context == NULL || compressedSize < 0 || (compressedMem == NULL && compressedSize > 0))
+    {
+        return(-1);
+    }
+
+    INSTRUMENT_BEGIN_STAGE(decompressedMem != NULL ? "lzw_var" : "lzw_var_size");
+    if (decompressedMem != NULL)
+    {
+        INSTRUMENT_COUNT(COUNTER_BYTES_IN, compressedSize);
+    }
+
+    context->input = compressedMem;
+    context->inputSize = compressedSize;
+    context->inputPosition = 0;
+    context->bitBuffer = 0;
+    context->bitCount = 0;
+
+    for (;;)
+    {
+        /* running out of data before the end codeword means the stream is cut short */
+        codeword = readCodeword(context, width);
+        if (codeword < 0)
+        {
+            goto cleanup;
+        }
+
+        INSTRUMENT_COUNT(COUNTER_LZW_CODEWORDS, 1);
+
+        if (codeword == LZWVAR_RESET_CODE)
+        {
+            INSTRUMENT_COUNT(COUNTER_LZW_DICTIONARY_RESETS, 1);
+            width = LZWVAR_MIN_WIDTH;
+            nextFree = LZWVAR_FIRST_FREE;
+            previous = -1;
+            continue;
+        }
+
+        if (codeword == LZWVAR_END_CODE)
+        {
+            break;
+        }
+
+        if (codeword <= 0xff)
+        {
+            source = -1;
+            length = 1;
+        }
+        else if (previous < 0 || codeword > nextFree)
+        {
+            /* only roots can follow a reset, and codewords past the next free one can't be decoded */
+            goto cleanup;
+        }
+        else if (codeword < nextFree)
+        {
+            source = context->offset[codeword];
+            length = context->length[codeword];
+        }
+        else
+        {
+            /* codeword is yet to be defined: it's the previous string plus its own first byte */
+            source = previousStart;
+            length = previousLength + 1;
+        }
+
+        if (length > decompressedCapacity - position)
+        {
+            goto cleanup;
+        }
+
+        if (decompressedMem != NULL)
+        {
+            if (source < 0)
+            {
+                decompressedMem[position] = (unsigned char)codeword;
+            }
+            else
+            {
+                copyForward(decompressedMem + position, decompressedMem + source, length);
+            }
+        }
+
+        /* the new entry is the previous string plus the first byte just written, which follows it */
+        if (previous >= 0 && nextFree < LZWVAR_DICTIONARY_SIZE)
+        {
+            context->offset[nextFree] = previousStart;
+            context->length[nextFree] = (unsigned short)(previousLength + 1);
+            nextFree++;
+
+            if (nextFree >= (1 << width) && width < LZWVAR_MAX_WIDTH)
+            {
+                width++;
+            }
+        }
+
+        previous = codeword;
+        previousStart = position;
+        previousLength = length;
+        position += length;
+    }
+
+    result = position;
+
+cleanup:
+    if (decompressedMem != NULL && result > 0)
+    {
+        INSTRUMENT_COUNT(COUNTER_BYTES_OUT, result);
+    }
+    INSTRUMENT_END_STAGE();
+
+    return(result);
+}
+
+/*
+ * Tops the bit buffer up to at least 56 bits. Away from the end of the input, 8 bytes are loaded at
+ * once and only the whole bytes that fit are counted as consumed; the bits of the partial byte above
+ * bitCount are the same ones the next load puts there, so OR-ing them in again is harmless.
+ */
+static void refillBits(lzwVarContext* context)
+{
+    const unsigned char* in;
+    unsigned long long value;
+
+    if (context->inputPosition + 8 <= context->inputSize)
+    {
+        in = context->input + context->inputPosition;
+        value = (unsigned long long)in[0] | ((unsigned long long)in[1] << 8) |
+                ((unsigned long long)in[2] << 16) | ((unsigned long long)in[3] << 24) |
+                ((unsigned long long)in[4] << 32) | ((unsigned long long)in[5] << 40) |
+                ((unsigned long long)in[6] << 48) | ((unsigned long long)in[7] << 56);
+
+        context->bitBuffer |= value << context->bitCount;
+        context->inputPosition += (63 - context->bitCount) >> 3;
+        context->bitCount |= 56;
+    }
+    else
+    {
+        while (context->bitCount <= 56 && context->inputPosition < context->inputSize)
+        {
+            context->bitBuffer |= (unsigned long long)context->input[context->inputPosition++] << context->bitCount;
+            context->bitCount += 8;
+        }
+    }
+}
+
+/* returns the next width-bit codeword, or -1 if the input runs out first */
+static int readCodeword(lzwVarContext* context, int width)
+{
+    int codeword;
+
+    if (context->bitCount < width)
+    {
+        refillBits(context);
+        if (context->bitCount < width)
+        {
+            return(-1);
+        }
+    }
+
+    codeword = (int)(context->bitBuffer & ((1u << width) - 1));
+    context->bitBuffer >>= width;
+    context->bitCount -= width;
+
+    return(codeword);
+}
+
+/* a codeword that is yet to be defined overlaps its own source, and has to be copied byte by byte */
+static void copyForward(unsigned char* destination, const unsigned char* source, long length)
+{
+    long i;
+
+    if (destination - source >= length)
+    {
+        memcpy(destination, source, (size_t)length);
+        return;
+    }
+
+    for (i = 0; i < length; i++)
+    {
+        destination[i] = source[i];
+    }
+}
@@ -0,0 +1,28 @@
+/*
+ *  lzwvar.h - variable-width LZW decompression from memory to memory
+ *
+ *  The LZW flavour of the later PC Ultima titles (Ultima 5 and 6, and the Worlds of Ultima games built on the
+ *  Ultima 6 engine). Codewords start out 9 bits wide and grow to 12, packed least significant bit first.
+ *  0x100 resets the dictionary and 0x101 ends the stream; new entries start at 0x102.
+ *
+ *  The compressed files start with a 4-byte little endian header holding the decompressed size, which
+ *  lzwVarReadHeader() checks. The functions below take the stream that follows it.
+ */
+
+#ifndef LZWVAR_H
+#define LZWVAR_H
+
+#define LZWVAR_HEADER_SIZE 4
+
+/* the dictionary and the bit reader, allocated once and reused for any number of streams */
+typedef struct _lzwVarContext lzwVarContext;
+
+lzwVarContext* lzwVarCreateContext(void);
+void lzwVarDestroyContext(lzwVarContext* context);
+
+long lzwVarReadHeader(unsigned char* fileMem, long fileSize);
+
+long lzwVarGetDecompressedSize(lzwVarContext* context, unsigned char* compressedMem, long compressedSize);
+long lzwVarDecompressBounded(lzwVarContext* context, unsigned char* compressedMem, unsigned char* decompressedMem, long compressedSize, long decompressedCapacity);
+
+#endif /* LZWVAR_H */
@@ -23,6 +23,7 @@
 #include "lzw.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 //long decompress_u4_file(char *compressed_filename, char *decompressed_filename);
 long getFilesize(FILE *input_file);
@@ -89,6 +90,9 @@ long decompress_u4_file(char *compressed_filename, char *decompressed_filename)
             if (compressed_filesize == 0)
             {
                 printf("Input file has a length of 0 bytes.\n");
+                fclose(compressed_file);
+                fclose(decompressed_file);
+                remove(decompressed_filename);
                 return(-1);
             }
 
@@ -105,7 +109,15 @@ long decompress_u4_file(char *compressed_filename, char *decompressed_filename)
 
             /* load compressed file into compressed_mem[] */
             compressed_mem = (unsigned char *) malloc(compressed_filesize);
-            fread(compressed_mem, 1, compressed_filesize, compressed_file);
+            if (compressed_mem == NULL || fread(compressed_mem, 1, compressed_filesize, compressed_file) != (size_t)compressed_filesize)
+            {
+                printf("Couldn't read '%s'.\n", compressed_filename);
+                free(compressed_mem);
+                fclose(compressed_file);
+                fclose(decompressed_file);
+                remove(decompressed_filename);
+                return(-1);
+            }
 
             /*
              * determine decompressed file size
@@ -120,6 +132,15 @@ long decompress_u4_file(char *compressed_filename, char *decompressed_filename)
 
                 /* decompress file from compressed_mem[] into decompressed_mem[] */
                 decompressed_mem = (unsigned char *) malloc(decompressed_filesize);
+                if (decompressed_mem == NULL)
+                {
+                    printf("Couldn't allocate %ld bytes.\n", decompressed_filesize);
+                    free(compressed_mem);
+                    fclose(compressed_file);
+                    fclose(decompressed_file);
+                    remove(decompressed_filename);
+                    return(-1);
+                }
 
                 /* testing: clear destination mem */
                 for (i = 0; i < decompressed_filesize; i++)
@@ -127,10 +148,19 @@ long decompress_u4_file(char *compressed_filename, char *decompressed_filename)
                     decompressed_mem[i] = 0;
                 }
 
-                errorCode = lzwDecompress(compressed_mem, decompressed_mem, compressed_filesize);
+                /* the size pass already validated the data, but never trust it with the buffer size */
+                errorCode = lzwDecompressBounded(compressed_mem, decompressed_mem, compressed_filesize, decompressed_filesize);
 
                 /* write decompressed file */
-                fwrite(decompressed_mem, 1, decompressed_filesize, decompressed_file);
+                if (errorCode == decompressed_filesize)
+                {
+                    fwrite(decompressed_mem, 1, decompressed_filesize, decompressed_file);
+                }
+                else
+                {
+                    printf("Couldn't decompress file.\n");
+                    errorCode = -1;
+                }
 
                 /* clean up */
                 fclose(decompressed_file);
@@ -139,9 +169,11 @@ long decompress_u4_file(char *compressed_filename, char *decompressed_filename)
             else
             {
                 printf("Couldn't decompress file.\n");
-                printf("Error code = %d\n",decompressed_filesize);
+                printf("Error code = %ld\n",decompressed_filesize);
 
                 /* delete the 0-byte file decompressed_file */
+                free(compressed_mem);
+                fclose(compressed_file);
                 fclose(decompressed_file);
                 remove(decompressed_filename);
 
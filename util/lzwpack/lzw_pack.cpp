@@ -0,0 +1,153 @@
+#include "lzw_pack.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+
+#include "../instrument/instrument.h"
+#include "../tile_decode/parallel.h"
+#include "../tile_decode/surface.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzwenc.h"
+}
+
+
+namespace
+{
+  const char* noEncoderError{ "no memory for an encoder" };
+
+
+  // Runs compress( encoder, index ) for every index in [0, count) on up to numThreads workers, each with an encoder of
+  // its own. Indices are left alone only if no worker got an encoder.
+  template<typename Function>
+  void ForEachWithEncoder( int32_t count, int32_t numThreads, Function&& compress )
+  {
+    const int32_t numWorkers{ std::min( ResolveThreadCount( numThreads ), count ) };
+    std::atomic<int32_t> nextIndex{ 0 };
+
+    ParallelFor( numWorkers, numWorkers, [&]( int32_t )
+    {
+      lzwEncoder* encoder{ lzwCreateEncoder() };
+      if( encoder == nullptr )
+      {
+        return;
+      }
+
+      for( int32_t index = nextIndex++; index < count; index = nextIndex++ )
+      {
+        compress( encoder, index );
+      }
+
+      lzwDestroyEncoder( encoder );
+    } );
+  }
+
+
+  // Returns null, or why input couldn't be compressed
+  const char* Compress( lzwEncoder* encoder, const std::vector<uint8_t>& input, std::vector<uint8_t>& output )
+  {
+    output.clear();
+
+    // The decoder can't tell an empty file from a broken one
+    if( input.empty() )
+    {
+      return "empty";
+    }
+
+    if( input.size() > static_cast<size_t>( LONG_MAX / 3 ) )
+    {
+      return "too big to compress";
+    }
+
+    const long inputSize{ static_cast<long>( input.size() ) };
+    const long bound{ lzwGetCompressBound( inputSize ) };
+    output.resize( static_cast<size_t>( bound ) );
+
+    const long outputSize{ lzwCompress( encoder, const_cast<uint8_t*>( input.data() ), output.data(), inputSize,
+                                        bound ) };
+    if( outputSize < 0 )
+    {
+      output.clear();
+      return "can't be compressed";
+    }
+
+    output.resize( static_cast<size_t>( outputSize ) );
+    return nullptr;
+  }
+} // namespace
+
+
+bool CompressLzwBatch( const std::vector<std::vector<uint8_t>>& inputs, std::vector<std::vector<uint8_t>>& outputs,
+                       int32_t numThreads )
+{
+  INSTRUMENT_SCOPE( "lzwpack" );
+
+  const int32_t count{ static_cast<int32_t>( inputs.size() ) };
+  outputs.assign( inputs.size(), std::vector<uint8_t>() );
+  std::vector<const char*> errors( inputs.size(), noEncoderError );
+
+  ForEachWithEncoder( count, numThreads, [&]( lzwEncoder* encoder, int32_t index )
+  {
+    errors[index] = Compress( encoder, inputs[index], outputs[index] );
+  } );
+
+  for( const char* error : errors )
+  {
+    if( error != nullptr )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool CompressLzwFiles( const std::vector<std::string>& inputFilenames, const std::vector<std::string>& outputFilenames,
+                       int32_t numThreads, std::vector<LzwPackResult>& results )
+{
+  INSTRUMENT_SCOPE( "lzwpack" );
+
+  const int32_t count{ static_cast<int32_t>( inputFilenames.size() ) };
+  results.assign( inputFilenames.size(), LzwPackResult{ 0, 0, noEncoderError } );
+
+  ForEachWithEncoder( count, numThreads, [&]( lzwEncoder* encoder, int32_t index )
+  {
+    LzwPackResult& result{ results[index] };
+
+    std::vector<uint8_t> input;
+    if( !ReadFileBytes( inputFilenames[index].c_str(), input ) )
+    {
+      result.error = "can't be read";
+      return;
+    }
+
+    std::vector<uint8_t> output;
+    result.decompressedSize = input.size();
+    result.error = Compress( encoder, input, output );
+    if( result.error != nullptr )
+    {
+      return;
+    }
+
+    if( !WriteFileBytes( outputFilenames[index].c_str(), output ) )
+    {
+      result.error = "can't write the compressed file";
+      return;
+    }
+
+    result.compressedSize = output.size();
+  } );
+
+  for( const LzwPackResult& result : results )
+  {
+    if( result.error != nullptr )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,34 @@
+// Compresses a set of files for U4 with the LZW encoder (lzwenc.h), on all cores.
+//
+// An encoder holds a little over 2 MB of tables, so there isn't one per file: each worker creates one and takes files
+// from a shared counter until they run out, which also balances a few big files against many small ones. Every file
+// is compressed on its own, so the output doesn't depend on the number of threads.
+
+#ifndef LZWPACK_LZW_PACK_H
+#define LZWPACK_LZW_PACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct LzwPackResult
+{
+  size_t decompressedSize{ 0 };
+  size_t compressedSize{ 0 };
+  const char* error{ nullptr }; // Null if the file was compressed
+};
+
+// Compresses every input into the output at the same index. Returns false if any of them couldn't be compressed (an
+// empty input, since the decoder can't tell it from a broken stream, or one too big for the encoder); its output is
+// left empty.
+bool CompressLzwBatch( const std::vector<std::vector<uint8_t>>& inputs, std::vector<std::vector<uint8_t>>& outputs,
+                       int32_t numThreads );
+
+// Reads, compresses and writes each of inputFilenames to the output filename at the same index (there must be as many
+// of them), in parallel. A file is read whole before its output is written, so the output can replace it. Returns
+// false if any of them failed, with the reason in its result.
+bool CompressLzwFiles( const std::vector<std::string>& inputFilenames, const std::vector<std::string>& outputFilenames,
+                       int32_t numThreads, std::vector<LzwPackResult>& results );
+
+#endif // LZWPACK_LZW_PACK_H
@@ -0,0 +1,109 @@
+// lzwpack: compresses files into the LZW streams PC Ultima IV reads, on all cores, for putting edited assets back into
+// the game.
+//
+//   lzwpack DIR FILE... [--threads N] [--stats]
+//
+// Each FILE is compressed into DIR under its own name, ready to copy over the game's file. DIR can be the folder the
+// files are in, to compress them in place.
+//
+// Add --stats to write the encoder's codeword, probe and dictionary reset counts to stats.json and a Chrome trace to
+// trace.json.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../instrument/instrument.h"
+#include "lzw_pack.h"
+
+
+namespace
+{
+  const char* BaseName( const char* filename )
+  {
+    const char* base{ filename };
+    for( const char* c = filename; *c != '\0'; ++c )
+    {
+      if( *c == '/' || *c == '\\' )
+      {
+        base = c + 1;
+      }
+    }
+
+    return base;
+  }
+} // namespace
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  if( argc < 3 || argv[1][0] == '-' )
+  {
+    printf( "Usage: lzwpack DIR FILE... [--threads N] [--stats]\n" );
+    return -1;
+  }
+
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  const std::string directory{ argv[1] };
+  int32_t numThreads{ 0 };
+  std::vector<std::string> inputFilenames;
+  std::vector<std::string> outputFilenames;
+  std::set<std::string> outputNames;
+
+  for( int32_t i = 2; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--threads" ) == 0 && i + 1 < argc )
+    {
+      numThreads = atoi( argv[++i] );
+      continue;
+    }
+
+    if( strcmp( argv[i], "--stats" ) == 0 )
+    {
+      continue;
+    }
+
+    // Two inputs with the same name would be written over each other
+    const char* name{ BaseName( argv[i] ) };
+    if( !outputNames.insert( name ).second )
+    {
+      printf( "%s: more than one FILE is called %s\n", directory.c_str(), name );
+      return -1;
+    }
+
+    inputFilenames.push_back( argv[i] );
+    outputFilenames.push_back( directory + "/" + name );
+  }
+
+  const auto startTime = std::chrono::steady_clock::now();
+
+  std::vector<LzwPackResult> results;
+  const bool passed{ CompressLzwFiles( inputFilenames, outputFilenames, numThreads, results ) };
+
+  const std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+
+  int32_t numCompressed{ 0 };
+  for( size_t i = 0; i < results.size(); ++i )
+  {
+    const LzwPackResult& result{ results[i] };
+    if( result.error != nullptr )
+    {
+      printf( "%s: %s\n", inputFilenames[i].c_str(), result.error );
+      continue;
+    }
+
+    printf( "%s: %u bytes, %u compressed (%.2f)\n", outputFilenames[i].c_str(),
+            static_cast<uint32_t>( result.decompressedSize ), static_cast<uint32_t>( result.compressedSize ),
+            static_cast<double>( result.decompressedSize ) / static_cast<double>( result.compressedSize ) );
+    ++numCompressed;
+  }
+
+  printf( "%s: compressed %d files in %.0f ms\n", directory.c_str(), numCompressed, elapsed.count() );
+  return passed ? 0 : -1;
+}
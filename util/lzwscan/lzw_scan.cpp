@@ -0,0 +1,221 @@
+#include "lzw_scan.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <map>
+
+#include "../instrument/instrument.h"
+#include "../tile_decode/parallel.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+}
+
+
+namespace
+{
+  // Starts handed out to a worker at a time
+  const size_t chunkBytes{ 16384 };
+
+
+  // The data from its second nibble on, so that a stream starting halfway through a byte decodes like any other
+  void ShiftNibble( const uint8_t* data, size_t size, uint8_t* dest )
+  {
+    for( size_t i = 0; i + 1 < size; ++i )
+    {
+      dest[i] = static_cast<uint8_t>( ( data[i] << 4 ) | ( data[i + 1] >> 4 ) );
+    }
+  }
+
+
+  float Entropy( const uint8_t* bytes, size_t count )
+  {
+    size_t histogram[256] = {};
+    for( size_t i = 0; i < count; ++i )
+    {
+      ++histogram[bytes[i]];
+    }
+
+    double entropy{ 0.0 };
+    for( const size_t n : histogram )
+    {
+      if( n > 0 )
+      {
+        const double p{ static_cast<double>( n ) / count };
+        entropy -= p * std::log2( p );
+      }
+    }
+
+    return static_cast<float>( entropy );
+  }
+
+
+  // In nibbles, since a stream can start or end halfway through a byte
+  size_t StreamStart( const LzwStream& stream )
+  {
+    return stream.offset * 2 + ( stream.nibble ? 1 : 0 );
+  }
+
+
+  size_t StreamEnd( const LzwStream& stream )
+  {
+    return StreamStart( stream ) + stream.length * 2;
+  }
+
+
+  // Whether a stream overlaps any of the kept ones. They are keyed by start and never overlap each other, so only the
+  // last one that starts before the stream ends can.
+  bool OverlapsKept( const std::map<size_t, const LzwStream*>& kept, const LzwStream& stream )
+  {
+    auto before = kept.lower_bound( StreamEnd( stream ) );
+    return before != kept.begin() && StreamEnd( *( --before )->second ) > StreamStart( stream );
+  }
+
+
+  // Decodes from every start in [begin, end) of bytes that could be a root, and keeps the streams that pass
+  void ScanChunk( lzwContext* context, const uint8_t* bytes, size_t size, size_t begin, size_t end, bool nibble,
+                  const LzwScanOptions& options, std::vector<uint8_t>& decoded, std::vector<LzwStream>& streams )
+  {
+    for( size_t offset = begin; offset < end; ++offset )
+    {
+      // The first codeword is a root, so its top 4 bits are clear
+      if( ( bytes[offset] >> 4 ) != 0 )
+      {
+        continue;
+      }
+
+      const long available{ static_cast<long>( std::min<size_t>( size - offset, LONG_MAX ) ) };
+      long used{ 0 };
+      const long decodedSize{ lzwContextDecompressPrefix( context, const_cast<uint8_t*>( bytes + offset ),
+                                                          decoded.data(), available,
+                                                          static_cast<long>( decoded.size() ), &used ) };
+      if( decodedSize < options.minDecodedBytes || decodedSize < used * options.minRatio )
+      {
+        continue;
+      }
+
+      const float entropy{ Entropy( decoded.data(), static_cast<size_t>( decodedSize ) ) };
+      if( entropy > options.maxEntropy )
+      {
+        continue;
+      }
+
+      streams.push_back( LzwStream{ offset, nibble, static_cast<size_t>( used ), static_cast<size_t>( decodedSize ),
+                                    entropy } );
+    }
+  }
+} // namespace
+
+
+void ScanLzwStreams( const uint8_t* data, size_t size, const LzwScanOptions& options, std::vector<LzwStream>& streams )
+{
+  INSTRUMENT_SCOPE( "lzwscan" );
+
+  streams.clear();
+  if( size < 2 )
+  {
+    return;
+  }
+
+  std::vector<uint8_t> shifted;
+  if( options.nibbles )
+  {
+    shifted.resize( size - 1 );
+    ShiftNibble( data, size, shifted.data() );
+  }
+
+  const int32_t numViews{ options.nibbles ? 2 : 1 };
+  const int32_t chunksPerView{ static_cast<int32_t>( ( size + chunkBytes - 1 ) / chunkBytes ) };
+  const int32_t numChunks{ chunksPerView * numViews };
+
+  // One decoder context and output buffer per worker, reused for every start it tries. The workers take chunks from
+  // a shared counter, so the ones that land on real streams (which take longer to reject) balance out.
+  const int32_t numWorkers{ std::min( ResolveThreadCount( options.numThreads ), numChunks ) };
+  std::vector<std::vector<LzwStream>> found( static_cast<size_t>( numWorkers ) );
+  std::atomic<int32_t> nextChunk{ 0 };
+
+  ParallelFor( numWorkers, numWorkers, [&]( int32_t worker )
+  {
+    lzwContext* context{ lzwCreateContext() };
+    if( context == nullptr )
+    {
+      return;
+    }
+
+    std::vector<uint8_t> decoded( static_cast<size_t>( std::max( options.maxDecodedBytes, 1 ) ) );
+    for( int32_t chunk = nextChunk++; chunk < numChunks; chunk = nextChunk++ )
+    {
+      const bool nibble{ chunk >= chunksPerView };
+      const uint8_t* bytes{ nibble ? shifted.data() : data };
+      const size_t viewSize{ nibble ? shifted.size() : size };
+      const size_t begin{ static_cast<size_t>( chunk % chunksPerView ) * chunkBytes };
+
+      ScanChunk( context, bytes, viewSize, begin, std::min( begin + chunkBytes, viewSize ), nibble, options, decoded,
+                 found[worker] );
+    }
+
+    lzwDestroyContext( context );
+  } );
+
+  std::vector<LzwStream> candidates;
+  for( const std::vector<LzwStream>& worker : found )
+  {
+    candidates.insert( candidates.end(), worker.begin(), worker.end() );
+  }
+
+  // Starts inside a stream (or just before one) sometimes decode for a while too, but never as far as the real start
+  std::sort( candidates.begin(), candidates.end(), []( const LzwStream& a, const LzwStream& b )
+  {
+    return a.decodedSize != b.decodedSize ? a.decodedSize > b.decodedSize : StreamStart( a ) < StreamStart( b );
+  } );
+
+  std::map<size_t, const LzwStream*> kept;
+  for( const LzwStream& candidate : candidates )
+  {
+    if( !OverlapsKept( kept, candidate ) )
+    {
+      kept.emplace( StreamStart( candidate ), &candidate );
+    }
+  }
+
+  // In file order
+  for( const auto& stream : kept )
+  {
+    streams.push_back( *stream.second );
+  }
+}
+
+
+bool DecodeLzwStream( const uint8_t* data, size_t size, const LzwStream& stream, std::vector<uint8_t>& decoded )
+{
+  // A nibble stream's last codeword ends halfway through the byte after its length
+  const size_t end{ stream.offset + stream.length + ( stream.nibble ? 1 : 0 ) };
+  if( stream.length > LONG_MAX || stream.decodedSize > LONG_MAX || end > size || end < stream.offset )
+  {
+    return false;
+  }
+
+  std::vector<uint8_t> compressed( data + stream.offset, data + stream.offset + stream.length );
+  if( stream.nibble )
+  {
+    ShiftNibble( data + stream.offset, stream.length + 1, compressed.data() );
+  }
+
+  lzwContext* context{ lzwCreateContext() };
+  if( context == nullptr )
+  {
+    return false;
+  }
+
+  decoded.resize( stream.decodedSize );
+  long used{ 0 };
+  const long decodedSize{ lzwContextDecompressPrefix( context, compressed.data(), decoded.data(),
+                                                      static_cast<long>( stream.length ),
+                                                      static_cast<long>( stream.decodedSize ), &used ) };
+  lzwDestroyContext( context );
+
+  return decodedSize == static_cast<long>( stream.decodedSize ) && used == static_cast<long>( stream.length );
+}
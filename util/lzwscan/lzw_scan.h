@@ -0,0 +1,43 @@
+// Finds U4 LZW streams embedded in executables, archives and concatenated blobs.
+//
+// A stream doesn't record its length, and nothing marks where one starts, so every byte (and, optionally, every
+// nibble) is tried as a start. Almost all of them fail within a codeword or two: the first codeword has to be a root,
+// and a codeword that isn't in the dictionary yet has to be the slot the next entry goes to. The ones that decode are
+// followed until the first codeword that doesn't, and kept if their output is big enough, smaller than it decoded to,
+// and not noise.
+
+#ifndef LZWSCAN_LZW_SCAN_H
+#define LZWSCAN_LZW_SCAN_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct LzwScanOptions
+{
+  int32_t minDecodedBytes{ 256 };
+  int32_t maxDecodedBytes{ 1 << 20 };  // Longer streams are cut off here
+  float minRatio{ 1.25f };             // Decoded bytes per compressed byte. Decoded noise comes out below 1.
+  float maxEntropy{ 7.0f };            // Bits per decoded byte
+  bool nibbles{ true };                // Try starts halfway through a byte as well
+  int32_t numThreads{ 0 };             // 0 for one per core
+};
+
+struct LzwStream
+{
+  size_t offset;       // The byte the first codeword starts in
+  bool nibble;         // Whether it starts in the low half of that byte
+  size_t length;       // Bytes of codewords, counted from the start (nibble or not). Whatever follows a stream often
+                       // decodes for a codeword or two, so this (and decodedSize) can run a few bytes long.
+  size_t decodedSize;
+  float entropy;       // Bits per decoded byte
+};
+
+// Tries every start on all cores, and returns the streams that pass the options, in file order. Where streams
+// overlap, the one that decodes to the most is kept.
+void ScanLzwStreams( const uint8_t* data, size_t size, const LzwScanOptions& options, std::vector<LzwStream>& streams );
+
+// Decodes a stream that ScanLzwStreams() found. Returns false if it doesn't decode to the size it was found with.
+bool DecodeLzwStream( const uint8_t* data, size_t size, const LzwStream& stream, std::vector<uint8_t>& decoded );
+
+#endif // LZWSCAN_LZW_SCAN_H
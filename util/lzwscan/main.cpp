@@ -0,0 +1,123 @@
+// lzwscan: finds U4 LZW streams embedded in an executable, archive or disk dump, for locating compressed assets in a
+// new game version.
+//
+//   lzwscan FILE [--min-size N] [--max-size N] [--min-ratio R] [--max-entropy E] [--bytes-only] [--threads N]
+//                [--extract PREFIX] [--stats]
+//
+// Prints the offset, length and decoded size of every stream found, and with --extract writes each one's decoded
+// bytes to PREFIX_1.bin, PREFIX_2.bin and so on.
+//
+// Add --stats to write the decoder's codeword, probe and dictionary reset counts to stats.json and a Chrome trace to
+// trace.json.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../instrument/instrument.h"
+#include "../tile_decode/mapped_file.h"
+#include "../tile_decode/surface.h"
+#include "lzw_scan.h"
+
+
+namespace
+{
+  const char* FindOption( int32_t argc, char* argv[], const char* option, const char* fallback )
+  {
+    for( int32_t i = 1; i + 1 < argc; ++i )
+    {
+      if( strcmp( argv[i], option ) == 0 )
+      {
+        return argv[i + 1];
+      }
+    }
+
+    return fallback;
+  }
+
+
+  bool HasFlag( int32_t argc, char* argv[], const char* flag )
+  {
+    for( int32_t i = 1; i < argc; ++i )
+    {
+      if( strcmp( argv[i], flag ) == 0 )
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+} // namespace
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  if( argc < 2 || argv[1][0] == '-' )
+  {
+    printf( "Usage: lzwscan FILE [--min-size N] [--max-size N] [--min-ratio R] [--max-entropy E] [--bytes-only] "
+            "[--threads N] [--extract PREFIX] [--stats]\n" );
+    return -1;
+  }
+
+  // Writes stats.json and trace.json when the program exits if --stats was given
+  InstrumentSession instrumentSession{ HasStatsOption( argc, argv ), "stats.json", "trace.json" };
+
+  MappedFile file;
+  if( !file.Open( argv[1] ) )
+  {
+    printf( "%s: can't be read\n", argv[1] );
+    return -1;
+  }
+
+  LzwScanOptions options;
+  options.minDecodedBytes = atoi( FindOption( argc, argv, "--min-size", "256" ) );
+  options.maxDecodedBytes = atoi( FindOption( argc, argv, "--max-size", "1048576" ) );
+  options.minRatio = static_cast<float>( atof( FindOption( argc, argv, "--min-ratio", "1.25" ) ) );
+  options.maxEntropy = static_cast<float>( atof( FindOption( argc, argv, "--max-entropy", "7.0" ) ) );
+  options.nibbles = !HasFlag( argc, argv, "--bytes-only" );
+  options.numThreads = atoi( FindOption( argc, argv, "--threads", "0" ) );
+
+  const char* extractPrefix{ FindOption( argc, argv, "--extract", nullptr ) };
+
+  const auto startTime = std::chrono::steady_clock::now();
+
+  std::vector<LzwStream> streams;
+  ScanLzwStreams( file.Data(), file.Size(), options, streams );
+
+  const std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+  printf( "%s: %u bytes scanned in %.0f ms, %d streams\n", argv[1], static_cast<uint32_t>( file.Size() ),
+          elapsed.count(), static_cast<int32_t>( streams.size() ) );
+
+  if( streams.empty() )
+  {
+    return 1;
+  }
+
+  printf( " #  offset      length  decoded  ratio  entropy  extracted\n" );
+  for( size_t i = 0; i < streams.size(); ++i )
+  {
+    const LzwStream& stream{ streams[i] };
+
+    std::string extracted;
+    if( extractPrefix != nullptr )
+    {
+      std::vector<uint8_t> decoded;
+      const std::string filename{ std::string( extractPrefix ) + "_" + std::to_string( i + 1 ) + ".bin" };
+      const bool written{ DecodeLzwStream( file.Data(), file.Size(), stream, decoded ) &&
+                          WriteFileBytes( filename.c_str(), decoded ) };
+      extracted = written ? filename : "(not written)";
+    }
+
+    printf( "%2d  0x%06x%s %7u  %7u  %5.2f  %7.2f  %s\n", static_cast<int32_t>( i + 1 ),
+            static_cast<uint32_t>( stream.offset ), stream.nibble ? ".5" : "  ", static_cast<uint32_t>( stream.length ),
+            static_cast<uint32_t>( stream.decodedSize ),
+            static_cast<double>( stream.decodedSize ) / static_cast<double>( stream.length ), stream.entropy,
+            extracted.c_str() );
+  }
+
+  return 0;
+}
@@ -0,0 +1,695 @@
+#include "png_reader.h"
+
+#include <cstring>
+
+
+namespace
+{
+  // ---------------------
+  // Inflate
+  // ---------------------
+
+  // Codes up to this length are resolved with a single table lookup
+  const int32_t fastBits{ 10 };
+
+  const uint16_t lengthBase[29] =
+  {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+  };
+
+  const uint8_t lengthExtra[29] =
+  {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+  };
+
+  const uint16_t distBase[30] =
+  {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+  };
+
+  const uint8_t distExtra[30] =
+  {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+  };
+
+  // Order in which the code length code lengths are stored in a dynamic block header
+  const uint8_t codeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+
+  struct BitReader
+  {
+    const uint8_t* data;
+    size_t numBytes;
+    size_t position;
+    uint64_t bits;
+    int32_t count;
+
+    void Refill()
+    {
+      while( count <= 56 )
+      {
+        // Past the end, feed zeros and let Overrun() catch streams that actually consume them
+        const uint64_t value{ position < numBytes ? data[position] : 0u };
+        ++position;
+        bits |= value << count;
+        count += 8;
+      }
+    }
+
+    uint32_t Peek( int32_t n )
+    {
+      if( count < n )
+      {
+        Refill();
+      }
+      return static_cast<uint32_t>( bits & ( ( 1ull << n ) - 1 ) );
+    }
+
+    void Consume( int32_t n )
+    {
+      bits >>= n;
+      count -= n;
+    }
+
+    uint32_t Read( int32_t n )
+    {
+      const uint32_t value{ Peek( n ) };
+      Consume( n );
+      return value;
+    }
+
+    void AlignToByte()
+    {
+      Consume( count & 7 );
+    }
+
+    bool Overrun() const
+    {
+      return position - count / 8 > numBytes;
+    }
+  };
+
+
+  struct Huffman
+  {
+    // ( length << 9 ) | symbol for every code of fastBits or less, 0 otherwise
+    uint16_t fast[1 << fastBits];
+    uint16_t firstCode[16];
+    uint16_t counts[16];
+    uint16_t firstSymbol[16];
+    uint16_t symbols[288];
+  };
+
+
+  uint32_t ReverseBits( uint32_t value, int32_t numBits )
+  {
+    uint32_t result{ 0 };
+    for( int32_t i = 0; i < numBits; ++i )
+    {
+      result = ( result << 1 ) | ( ( value >> i ) & 1 );
+    }
+    return result;
+  }
+
+
+  bool BuildHuffman( Huffman& huffman, const uint8_t* lengths, int32_t numSymbols )
+  {
+    memset( huffman.fast, 0, sizeof( huffman.fast ) );
+    memset( huffman.counts, 0, sizeof( huffman.counts ) );
+
+    for( int32_t i = 0; i < numSymbols; ++i )
+    {
+      ++huffman.counts[lengths[i]];
+    }
+    huffman.counts[0] = 0;
+
+    uint16_t nextCode[16];
+    uint32_t code{ 0 };
+    uint16_t symbolOffset{ 0 };
+
+    for( int32_t len = 1; len < 16; ++len )
+    {
+      code = ( code + huffman.counts[len - 1] ) << 1;
+
+      if( code + huffman.counts[len] > ( 1u << len ) )
+      {
+        // Oversubscribed
+        return false;
+      }
+
+      huffman.firstCode[len] = static_cast<uint16_t>( code );
+      huffman.firstSymbol[len] = symbolOffset;
+      nextCode[len] = static_cast<uint16_t>( code );
+      symbolOffset += huffman.counts[len];
+    }
+
+    for( int32_t symbol = 0; symbol < numSymbols; ++symbol )
+    {
+      const int32_t len{ lengths[symbol] };
+      if( len == 0 )
+      {
+        continue;
+      }
+
+      const uint32_t symbolCode{ nextCode[len]++ };
+      huffman.symbols[huffman.firstSymbol[len] + symbolCode - huffman.firstCode[len]] =
+        static_cast<uint16_t>( symbol );
+
+      if( len <= fastBits )
+      {
+        // The stream stores codes MSB first, but bits are pulled LSB first
+        const uint16_t entry{ static_cast<uint16_t>( ( len << 9 ) | symbol ) };
+        for( uint32_t k = ReverseBits( symbolCode, len ); k < ( 1u << fastBits ); k += ( 1u << len ) )
+        {
+          huffman.fast[k] = entry;
+        }
+      }
+    }
+
+    return true;
+  }
+
+
+  // Returns the next symbol, or -1 if the bits don't form a valid code
+  int32_t DecodeSymbol( BitReader& reader, const Huffman& huffman )
+  {
+    const uint16_t entry{ huffman.fast[reader.Peek( fastBits )] };
+    if( entry != 0 )
+    {
+      reader.Consume( entry >> 9 );
+      return entry & 0x1ff;
+    }
+
+    // Slow path for long codes
+    const uint32_t peeked{ reader.Peek( 15 ) };
+    uint32_t code{ 0 };
+
+    for( int32_t len = 1; len < 16; ++len )
+    {
+      code |= ( peeked >> ( len - 1 ) ) & 1;
+
+      const uint32_t index{ code - huffman.firstCode[len] };
+      if( code >= huffman.firstCode[len] && index < huffman.counts[len] )
+      {
+        reader.Consume( len );
+        return huffman.symbols[huffman.firstSymbol[len] + index];
+      }
+
+      code <<= 1;
+    }
+
+    return -1;
+  }
+
+
+  bool BuildFixedHuffman( Huffman& lengthCodes, Huffman& distCodes )
+  {
+    uint8_t lengths[288];
+    memset( lengths, 8, 144 );
+    memset( lengths + 144, 9, 112 );
+    memset( lengths + 256, 7, 24 );
+    memset( lengths + 280, 8, 8 );
+
+    uint8_t distLengths[30];
+    memset( distLengths, 5, sizeof( distLengths ) );
+
+    return BuildHuffman( lengthCodes, lengths, 288 ) && BuildHuffman( distCodes, distLengths, 30 );
+  }
+
+
+  bool ReadDynamicHuffman( BitReader& reader, Huffman& lengthCodes, Huffman& distCodes )
+  {
+    const int32_t numLengthCodes{ static_cast<int32_t>( reader.Read( 5 ) ) + 257 };
+    const int32_t numDistCodes{ static_cast<int32_t>( reader.Read( 5 ) ) + 1 };
+    const int32_t numCodeLengthCodes{ static_cast<int32_t>( reader.Read( 4 ) ) + 4 };
+
+    uint8_t codeLengthLengths[19];
+    memset( codeLengthLengths, 0, sizeof( codeLengthLengths ) );
+    for( int32_t i = 0; i < numCodeLengthCodes; ++i )
+    {
+      codeLengthLengths[codeLengthOrder[i]] = static_cast<uint8_t>( reader.Read( 3 ) );
+    }
+
+    Huffman codeLengthCodes;
+    if( !BuildHuffman( codeLengthCodes, codeLengthLengths, 19 ) )
+    {
+      return false;
+    }
+
+    uint8_t lengths[288 + 32];
+    const int32_t total{ numLengthCodes + numDistCodes };
+    int32_t n{ 0 };
+
+    while( n < total )
+    {
+      const int32_t symbol{ DecodeSymbol( reader, codeLengthCodes ) };
+      if( symbol < 0 )
+      {
+        return false;
+      }
+
+      if( symbol < 16 )
+      {
+        lengths[n++] = static_cast<uint8_t>( symbol );
+        continue;
+      }
+
+      uint8_t fill{ 0 };
+      int32_t repeat{ 0 };
+
+      if( symbol == 16 )
+      {
+        if( n == 0 )
+        {
+          return false;
+        }
+        fill = lengths[n - 1];
+        repeat = 3 + static_cast<int32_t>( reader.Read( 2 ) );
+      }
+      else if( symbol == 17 )
+      {
+        repeat = 3 + static_cast<int32_t>( reader.Read( 3 ) );
+      }
+      else
+      {
+        repeat = 11 + static_cast<int32_t>( reader.Read( 7 ) );
+      }
+
+      if( n + repeat > total )
+      {
+        return false;
+      }
+
+      memset( lengths + n, fill, repeat );
+      n += repeat;
+    }
+
+    return BuildHuffman( lengthCodes, lengths, numLengthCodes ) &&
+           BuildHuffman( distCodes, lengths + numLengthCodes, numDistCodes );
+  }
+
+
+  bool InflateBlock( BitReader& reader, const Huffman& lengthCodes, const Huffman& distCodes, uint8_t* out,
+                     size_t outSize, size_t& written )
+  {
+    for( ;; )
+    {
+      const int32_t symbol{ DecodeSymbol( reader, lengthCodes ) };
+
+      if( symbol < 256 )
+      {
+        if( symbol < 0 || written >= outSize )
+        {
+          return false;
+        }
+        out[written++] = static_cast<uint8_t>( symbol );
+      }
+      else if( symbol == 256 )
+      {
+        return true;
+      }
+      else
+      {
+        const int32_t lengthIndex{ symbol - 257 };
+        if( lengthIndex >= 29 )
+        {
+          return false;
+        }
+
+        const size_t length{ lengthBase[lengthIndex] + reader.Read( lengthExtra[lengthIndex] ) };
+
+        const int32_t distIndex{ DecodeSymbol( reader, distCodes ) };
+        if( distIndex < 0 || distIndex >= 30 )
+        {
+          return false;
+        }
+
+        const size_t distance{ distBase[distIndex] + reader.Read( distExtra[distIndex] ) };
+        if( distance > written || length > outSize - written )
+        {
+          return false;
+        }
+
+        // Byte by byte, since the source may overlap what is being written
+        const uint8_t* src{ out + written - distance };
+        uint8_t* dest{ out + written };
+        for( size_t i = 0; i < length; ++i )
+        {
+          dest[i] = src[i];
+        }
+        written += length;
+      }
+    }
+  }
+
+
+  // ---------------------
+  // PNG
+  // ---------------------
+
+  uint32_t ReadBigEndian32( const uint8_t* data )
+  {
+    return ( static_cast<uint32_t>( data[0] ) << 24 ) | ( static_cast<uint32_t>( data[1] ) << 16 ) |
+           ( static_cast<uint32_t>( data[2] ) << 8 ) | data[3];
+  }
+
+
+  uint8_t Paeth( int32_t a, int32_t b, int32_t c )
+  {
+    const int32_t p{ a + b - c };
+    const int32_t pa{ p > a ? p - a : a - p };
+    const int32_t pb{ p > b ? p - b : b - p };
+    const int32_t pc{ p > c ? p - c : c - p };
+
+    if( pa <= pb && pa <= pc )
+    {
+      return static_cast<uint8_t>( a );
+    }
+    return static_cast<uint8_t>( pb <= pc ? b : c );
+  }
+
+
+  // Reverses the per-row filters in place. Each row is preceded by its filter type byte.
+  bool Unfilter( uint8_t* raw, int32_t height, size_t rowBytes, size_t bytesPerPixel )
+  {
+    const uint8_t* prior{ nullptr };
+
+    for( int32_t y = 0; y < height; ++y )
+    {
+      const uint8_t filter{ raw[0] };
+      uint8_t* row{ raw + 1 };
+
+      switch( filter )
+      {
+        case 0:
+          break;
+
+        case 1:
+          for( size_t i = bytesPerPixel; i < rowBytes; ++i )
+          {
+            row[i] = static_cast<uint8_t>( row[i] + row[i - bytesPerPixel] );
+          }
+          break;
+
+        case 2:
+          if( prior )
+          {
+            for( size_t i = 0; i < rowBytes; ++i )
+            {
+              row[i] = static_cast<uint8_t>( row[i] + prior[i] );
+            }
+          }
+          break;
+
+        case 3:
+          for( size_t i = 0; i < rowBytes; ++i )
+          {
+            const int32_t left{ i >= bytesPerPixel ? row[i - bytesPerPixel] : 0 };
+            const int32_t up{ prior ? prior[i] : 0 };
+            row[i] = static_cast<uint8_t>( row[i] + ( ( left + up ) >> 1 ) );
+          }
+          break;
+
+        case 4:
+          for( size_t i = 0; i < rowBytes; ++i )
+          {
+            const int32_t left{ i >= bytesPerPixel ? row[i - bytesPerPixel] : 0 };
+            const int32_t up{ prior ? prior[i] : 0 };
+            const int32_t upLeft{ prior && i >= bytesPerPixel ? prior[i - bytesPerPixel] : 0 };
+            row[i] = static_cast<uint8_t>( row[i] + Paeth( left, up, upLeft ) );
+          }
+          break;
+
+        default:
+          return false;
+      }
+
+      prior = row;
+      raw += rowBytes + 1;
+    }
+
+    return true;
+  }
+
+
+  // Finds or adds an RGB color to the palette, returning its index or -1 if the palette is full
+  int32_t PaletteIndex( std::vector<PaletteEntry>& palette, uint8_t r, uint8_t g, uint8_t b )
+  {
+    for( size_t i = 0; i < palette.size(); ++i )
+    {
+      if( palette[i].r == r && palette[i].g == g && palette[i].b == b )
+      {
+        return static_cast<int32_t>( i );
+      }
+    }
+
+    if( palette.size() >= 256 )
+    {
+      return -1;
+    }
+
+    palette.push_back( PaletteEntry{ r, g, b } );
+    return static_cast<int32_t>( palette.size() - 1 );
+  }
+} // namespace
+
+
+long ZlibInflate( const uint8_t* data, size_t numBytes, uint8_t* out, size_t outSize )
+{
+  // 2 byte header: deflate, no preset dictionary
+  if( numBytes < 2 || ( data[0] & 0x0f ) != 8 || ( ( data[0] << 8 ) | data[1] ) % 31 != 0 || ( data[1] & 0x20 ) )
+  {
+    return -1;
+  }
+
+  BitReader reader{ data + 2, numBytes - 2, 0, 0, 0 };
+  size_t written{ 0 };
+
+  Huffman lengthCodes;
+  Huffman distCodes;
+
+  bool finalBlock{ false };
+  while( !finalBlock )
+  {
+    finalBlock = reader.Read( 1 ) != 0;
+    const uint32_t blockType{ reader.Read( 2 ) };
+
+    if( blockType == 0 )
+    {
+      // Stored block
+      reader.AlignToByte();
+      const uint32_t length{ reader.Read( 16 ) };
+      const uint32_t lengthComplement{ reader.Read( 16 ) };
+
+      if( ( length ^ 0xffff ) != lengthComplement || length > outSize - written )
+      {
+        return -1;
+      }
+
+      for( uint32_t i = 0; i < length; ++i )
+      {
+        out[written++] = static_cast<uint8_t>( reader.Read( 8 ) );
+      }
+    }
+    else if( blockType == 1 || blockType == 2 )
+    {
+      const bool built{ blockType == 1 ? BuildFixedHuffman( lengthCodes, distCodes )
+                                       : ReadDynamicHuffman( reader, lengthCodes, distCodes ) };
+
+      if( !built || !InflateBlock( reader, lengthCodes, distCodes, out, outSize, written ) )
+      {
+        return -1;
+      }
+    }
+    else
+    {
+      return -1;
+    }
+
+    if( reader.Overrun() )
+    {
+      return -1;
+    }
+  }
+
+  return static_cast<long>( written );
+}
+
+
+bool DecodePng( const uint8_t* data, size_t numBytes, PngImage& image, const char*& error )
+{
+  static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+  if( numBytes < 8 || memcmp( data, signature, 8 ) != 0 )
+  {
+    error = "not a PNG file";
+    return false;
+  }
+
+  uint32_t width{ 0 };
+  uint32_t height{ 0 };
+  uint8_t bitDepth{ 0 };
+  uint8_t colorType{ 0 };
+  bool haveHeader{ false };
+
+  std::vector<uint8_t> compressed;
+  image.palette.clear();
+
+  size_t position{ 8 };
+  while( position + 12 <= numBytes )
+  {
+    const uint32_t length{ ReadBigEndian32( data + position ) };
+    const uint8_t* type{ data + position + 4 };
+    const uint8_t* chunk{ data + position + 8 };
+
+    if( length > numBytes - position - 12 )
+    {
+      error = "truncated chunk";
+      return false;
+    }
+
+    if( memcmp( type, "IHDR", 4 ) == 0 && length >= 13 )
+    {
+      width = ReadBigEndian32( chunk );
+      height = ReadBigEndian32( chunk + 4 );
+      bitDepth = chunk[8];
+      colorType = chunk[9];
+
+      if( chunk[12] != 0 )
+      {
+        error = "interlaced images are not supported";
+        return false;
+      }
+
+      haveHeader = true;
+    }
+    else if( memcmp( type, "PLTE", 4 ) == 0 )
+    {
+      for( uint32_t i = 0; i + 3 <= length; i += 3 )
+      {
+        image.palette.push_back( PaletteEntry{ chunk[i], chunk[i + 1], chunk[i + 2] } );
+      }
+    }
+    else if( memcmp( type, "IDAT", 4 ) == 0 )
+    {
+      compressed.insert( compressed.end(), chunk, chunk + length );
+    }
+    else if( memcmp( type, "IEND", 4 ) == 0 )
+    {
+      break;
+    }
+
+    position += length + 12;
+  }
+
+  if( !haveHeader || width == 0 || height == 0 || width > 0x8000 || height > 0x8000 )
+  {
+    error = "missing or invalid IHDR";
+    return false;
+  }
+
+  int32_t channels{ 0 };
+  switch( colorType )
+  {
+    case 0: channels = 1; break; // Grayscale
+    case 2: channels = 3; break; // RGB
+    case 3: channels = 1; break; // Palette
+    case 6: channels = 4; break; // RGBA
+    default:
+      error = "unsupported color type";
+      return false;
+  }
+
+  if( ( bitDepth != 1 && bitDepth != 2 && bitDepth != 4 && bitDepth != 8 ) || ( channels > 1 && bitDepth != 8 ) )
+  {
+    error = "unsupported bit depth";
+    return false;
+  }
+
+  const size_t bitsPerPixel{ static_cast<size_t>( channels ) * bitDepth };
+  const size_t rowBytes{ ( width * bitsPerPixel + 7 ) / 8 };
+  const size_t bytesPerPixel{ bitsPerPixel < 8 ? 1 : bitsPerPixel / 8 };
+
+  // Deflate can't expand data by more than about 1032:1, so a header that claims more is corrupt. Checking before
+  // allocating keeps a tiny file from asking for gigabytes.
+  const size_t rawSize{ ( rowBytes + 1 ) * height };
+  if( rawSize / 1032 > compressed.size() )
+  {
+    error = "corrupt image data";
+    return false;
+  }
+
+  std::vector<uint8_t> raw( rawSize );
+  if( ZlibInflate( compressed.data(), compressed.size(), raw.data(), raw.size() ) != static_cast<long>( raw.size() ) )
+  {
+    error = "corrupt image data";
+    return false;
+  }
+
+  if( !Unfilter( raw.data(), static_cast<int32_t>( height ), rowBytes, bytesPerPixel ) )
+  {
+    error = "invalid row filter";
+    return false;
+  }
+
+  image.indices.Create( static_cast<int32_t>( width ), static_cast<int32_t>( height ) );
+
+  if( colorType == 0 )
+  {
+    // Grayscale becomes a gray ramp palette
+    const int32_t levels{ 1 << bitDepth };
+    for( int32_t i = 0; i < levels; ++i )
+    {
+      const uint8_t gray{ static_cast<uint8_t>( i * 255 / ( levels - 1 ) ) };
+      image.palette.push_back( PaletteEntry{ gray, gray, gray } );
+    }
+  }
+
+  for( uint32_t y = 0; y < height; ++y )
+  {
+    const uint8_t* row{ raw.data() + y * ( rowBytes + 1 ) + 1 };
+    uint8_t* dest{ image.indices.Row( static_cast<int32_t>( y ) ) };
+
+    if( channels == 1 )
+    {
+      const int32_t pixelsPerByte{ 8 / bitDepth };
+      const uint8_t mask{ static_cast<uint8_t>( ( 1 << bitDepth ) - 1 ) };
+
+      for( uint32_t x = 0; x < width; ++x )
+      {
+        const int32_t shift{ 8 - bitDepth * ( 1 + static_cast<int32_t>( x % pixelsPerByte ) ) };
+        dest[x] = ( row[x / pixelsPerByte] >> shift ) & mask;
+      }
+    }
+    else
+    {
+      for( uint32_t x = 0; x < width; ++x )
+      {
+        const uint8_t* pixel{ row + x * channels };
+        const int32_t index{ PaletteIndex( image.palette, pixel[0], pixel[1], pixel[2] ) };
+        if( index < 0 )
+        {
+          error = "more than 256 colors";
+          return false;
+        }
+        dest[x] = static_cast<uint8_t>( index );
+      }
+    }
+  }
+
+  return true;
+}
+
+
+bool ReadPng( const char* filename, PngImage& image, const char*& error )
+{
+  std::vector<uint8_t> bytes;
+  if( !ReadFileBytes( filename, bytes ) )
+  {
+    error = "can't open file";
+    return false;
+  }
+
+  return DecodePng( bytes.data(), bytes.size(), image, error );
+}
@@ -0,0 +1,24 @@
+// Minimal PNG reader used to load the reference images that ship next to the ripper inputs.
+// Supports non-interlaced 8-bit-or-less grayscale, palette, RGB and RGBA images. Truecolor images are palettized on
+// load, so they must not use more than 256 distinct colors.
+
+#ifndef PNG_PNG_READER_H
+#define PNG_PNG_READER_H
+
+#include "../tile_decode/surface.h"
+
+struct PngImage
+{
+  IndexSurface indices;
+  std::vector<PaletteEntry> palette;
+};
+
+// Returns false and fills in error if the file can't be read or uses an unsupported format
+bool ReadPng( const char* filename, PngImage& image, const char*& error );
+bool DecodePng( const uint8_t* data, size_t numBytes, PngImage& image, const char*& error );
+
+// Inflates a zlib stream into out, which must already be sized to the expected output. Returns the number of bytes
+// written, or -1 if the stream is corrupt.
+long ZlibInflate( const uint8_t* data, size_t numBytes, uint8_t* out, size_t outSize );
+
+#endif // PNG_PNG_READER_H
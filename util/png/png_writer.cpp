@@ -0,0 +1,601 @@
+#include "png_writer.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+namespace
+{
+  // ---------------------
+  // Deflate
+  // ---------------------
+
+  const int32_t windowSize{ 32768 };
+  const int32_t minMatch{ 3 };
+  const int32_t maxMatch{ 258 };
+
+  // Matches are searched along chains of earlier positions with the same 3-byte hash, newest first
+  const int32_t hashBits{ 15 };
+  const int32_t maxChainLength{ 16 };
+
+  // A match this long is taken without looking further
+  const int32_t goodEnoughMatch{ 32 };
+
+  const uint16_t lengthBase[29] =
+  {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+  };
+
+  const uint8_t lengthExtra[29] =
+  {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+  };
+
+  const uint16_t distBase[30] =
+  {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+    8193, 12289, 16385, 24577
+  };
+
+  const uint8_t distExtra[30] =
+  {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+  };
+
+
+  struct BitWriter
+  {
+    std::vector<uint8_t>& out;
+    uint64_t bits;
+    int32_t count;
+
+    // Deflate packs values LSB first. Bytes are flushed 4 at a time.
+    void Write( uint32_t value, int32_t n )
+    {
+      bits |= static_cast<uint64_t>( value ) << count;
+      count += n;
+
+      if( count >= 32 )
+      {
+        const uint8_t bytes[4] = { static_cast<uint8_t>( bits ), static_cast<uint8_t>( bits >> 8 ),
+                                   static_cast<uint8_t>( bits >> 16 ), static_cast<uint8_t>( bits >> 24 ) };
+        out.insert( out.end(), bytes, bytes + 4 );
+        bits >>= 32;
+        count -= 32;
+      }
+    }
+
+    void Flush()
+    {
+      while( count > 0 )
+      {
+        out.push_back( static_cast<uint8_t>( bits ) );
+        bits >>= 8;
+        count -= 8;
+      }
+
+      bits = 0;
+      count = 0;
+    }
+  };
+
+
+  // The fixed literal / length and distance codes from RFC 1951 3.2.6, bit-reversed since Huffman codes are packed
+  // MSB first
+  struct FixedCodes
+  {
+    uint16_t literalCodes[288];
+    uint8_t literalLengths[288];
+    uint8_t distCodes[30];
+
+    FixedCodes()
+    {
+      for( int32_t symbol = 0; symbol < 288; ++symbol )
+      {
+        uint32_t code;
+        int32_t length;
+
+        if( symbol < 144 )
+        {
+          code = 0x30 + symbol;
+          length = 8;
+        }
+        else if( symbol < 256 )
+        {
+          code = 0x190 + symbol - 144;
+          length = 9;
+        }
+        else if( symbol < 280 )
+        {
+          code = symbol - 256;
+          length = 7;
+        }
+        else
+        {
+          code = 0xc0 + symbol - 280;
+          length = 8;
+        }
+
+        literalCodes[symbol] = static_cast<uint16_t>( Reverse( code, length ) );
+        literalLengths[symbol] = static_cast<uint8_t>( length );
+      }
+
+      for( int32_t symbol = 0; symbol < 30; ++symbol )
+      {
+        distCodes[symbol] = static_cast<uint8_t>( Reverse( symbol, 5 ) );
+      }
+    }
+
+    static uint32_t Reverse( uint32_t code, int32_t length )
+    {
+      uint32_t reversed{ 0 };
+      for( int32_t i = 0; i < length; ++i )
+      {
+        reversed = ( reversed << 1 ) | ( ( code >> i ) & 1 );
+      }
+
+      return reversed;
+    }
+  };
+
+  const FixedCodes fixedCodes;
+
+
+  inline void WriteFixedLiteral( BitWriter& writer, int32_t symbol )
+  {
+    writer.Write( fixedCodes.literalCodes[symbol], fixedCodes.literalLengths[symbol] );
+  }
+
+
+  void WriteMatch( BitWriter& writer, int32_t length, int32_t distance )
+  {
+    int32_t lengthCode{ 28 };
+    while( lengthBase[lengthCode] > length )
+    {
+      --lengthCode;
+    }
+
+    WriteFixedLiteral( writer, 257 + lengthCode );
+    writer.Write( length - lengthBase[lengthCode], lengthExtra[lengthCode] );
+
+    int32_t distCode{ 29 };
+    while( distBase[distCode] > distance )
+    {
+      --distCode;
+    }
+
+    writer.Write( fixedCodes.distCodes[distCode], 5 );
+    writer.Write( distance - distBase[distCode], distExtra[distCode] );
+  }
+
+
+  inline uint32_t Hash3( const uint8_t* data )
+  {
+    const uint32_t value{ data[0] | ( data[1] << 8 ) | ( static_cast<uint32_t>( data[2] ) << 16 ) };
+    return ( value * 2654435761u ) >> ( 32 - hashBits );
+  }
+
+
+  uint32_t Adler32( const uint8_t* data, size_t numBytes )
+  {
+    uint32_t a{ 1 };
+    uint32_t b{ 0 };
+
+    while( numBytes > 0 )
+    {
+      // The largest run that can't overflow before the modulo
+      size_t run{ numBytes < 5552 ? numBytes : 5552 };
+      numBytes -= run;
+
+      while( run-- > 0 )
+      {
+        a += *data++;
+        b += a;
+      }
+
+      a %= 65521;
+      b %= 65521;
+    }
+
+    return ( b << 16 ) | a;
+  }
+
+
+  // ---------------------
+  // PNG
+  // ---------------------
+
+  struct CrcTable
+  {
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+      for( uint32_t i = 0; i < 256; ++i )
+      {
+        uint32_t crc{ i };
+        for( int32_t bit = 0; bit < 8; ++bit )
+        {
+          crc = crc & 1 ? 0xedb88320u ^ ( crc >> 1 ) : crc >> 1;
+        }
+
+        entries[i] = crc;
+      }
+    }
+  };
+
+  const CrcTable crcTable;
+
+
+  void PutBigEndian( std::vector<uint8_t>& out, uint32_t value )
+  {
+    out.push_back( static_cast<uint8_t>( value >> 24 ) );
+    out.push_back( static_cast<uint8_t>( value >> 16 ) );
+    out.push_back( static_cast<uint8_t>( value >> 8 ) );
+    out.push_back( static_cast<uint8_t>( value ) );
+  }
+
+
+  void WriteChunk( std::vector<uint8_t>& png, const char* type, const uint8_t* data, size_t numBytes )
+  {
+    PutBigEndian( png, static_cast<uint32_t>( numBytes ) );
+
+    const size_t start{ png.size() };
+    png.insert( png.end(), type, type + 4 );
+    png.insert( png.end(), data, data + numBytes );
+
+    // The CRC covers the type and the data
+    uint32_t crc{ 0xffffffffu };
+    for( size_t i = start; i < png.size(); ++i )
+    {
+      crc = crcTable.entries[( crc ^ png[i] ) & 0xff] ^ ( crc >> 8 );
+    }
+
+    PutBigEndian( png, crc ^ 0xffffffffu );
+  }
+
+
+  inline uint8_t Paeth( int32_t left, int32_t up, int32_t upLeft )
+  {
+    const int32_t estimate{ left + up - upLeft };
+    const int32_t toLeft{ abs( estimate - left ) };
+    const int32_t toUp{ abs( estimate - up ) };
+    const int32_t toUpLeft{ abs( estimate - upLeft ) };
+
+    if( toLeft <= toUp && toLeft <= toUpLeft )
+    {
+      return static_cast<uint8_t>( left );
+    }
+
+    return static_cast<uint8_t>( toUp <= toUpLeft ? up : upLeft );
+  }
+
+
+  // Applies one of the 5 PNG filters to a row. Each filter has its own loop so the compiler can vectorize the simple ones.
+  void FilterRow( uint8_t filter, const uint8_t* row, const uint8_t* above, int32_t rowBytes, int32_t bpp,
+                  uint8_t* out )
+  {
+    const int32_t lead{ bpp < rowBytes ? bpp : rowBytes };
+
+    switch( filter )
+    {
+      case 1: // Sub
+        memcpy( out, row, static_cast<size_t>( lead ) );
+        for( int32_t i = lead; i < rowBytes; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - row[i - bpp] );
+        }
+        break;
+
+      case 2: // Up
+        for( int32_t i = 0; i < rowBytes; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - above[i] );
+        }
+        break;
+
+      case 3: // Average
+        for( int32_t i = 0; i < lead; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - ( above[i] >> 1 ) );
+        }
+
+        for( int32_t i = lead; i < rowBytes; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - ( ( row[i - bpp] + above[i] ) >> 1 ) );
+        }
+        break;
+
+      case 4: // Paeth
+        for( int32_t i = 0; i < lead; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - Paeth( 0, above[i], 0 ) );
+        }
+
+        for( int32_t i = lead; i < rowBytes; ++i )
+        {
+          out[i] = static_cast<uint8_t>( row[i] - Paeth( row[i - bpp], above[i], above[i - bpp] ) );
+        }
+        break;
+
+      default: // None
+        memcpy( out, row, static_cast<size_t>( rowBytes ) );
+        break;
+    }
+  }
+
+
+  // Filters every row of raw (rowBytes per row, bpp bytes per pixel) with whichever of the 5 filters gives the
+  // smallest sum of absolute values, and deflates the result
+  void CompressRows( const std::vector<uint8_t>& raw, int32_t rowBytes, int32_t height, int32_t bpp,
+                     std::vector<uint8_t>& compressed )
+  {
+    std::vector<uint8_t> filtered;
+    filtered.reserve( static_cast<size_t>( rowBytes + 1 ) * height );
+
+    std::vector<uint8_t> candidate( static_cast<size_t>( rowBytes ) );
+    std::vector<uint8_t> best( static_cast<size_t>( rowBytes ) );
+    const std::vector<uint8_t> zeroRow( static_cast<size_t>( rowBytes ), 0 );
+
+    for( int32_t y = 0; y < height; ++y )
+    {
+      const uint8_t* row{ raw.data() + static_cast<size_t>( y ) * rowBytes };
+      const uint8_t* above{ y > 0 ? row - rowBytes : zeroRow.data() };
+
+      uint8_t bestFilter{ 0 };
+      uint32_t bestSum{ 0xffffffffu };
+
+      for( uint8_t filter = 0; filter < 5; ++filter )
+      {
+        FilterRow( filter, row, above, rowBytes, bpp, candidate.data() );
+
+        uint32_t sum{ 0 };
+        for( int32_t i = 0; i < rowBytes; ++i )
+        {
+          sum += candidate[i] < 128 ? candidate[i] : 256 - candidate[i];
+        }
+
+        if( sum < bestSum )
+        {
+          bestSum = sum;
+          bestFilter = filter;
+          best.swap( candidate );
+        }
+      }
+
+      filtered.push_back( bestFilter );
+      filtered.insert( filtered.end(), best.begin(), best.end() );
+    }
+
+    ZlibDeflate( filtered.data(), filtered.size(), compressed );
+  }
+
+
+  void WriteHeader( std::vector<uint8_t>& png, int32_t width, int32_t height, uint8_t colorType )
+  {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    png.assign( signature, signature + 8 );
+
+    std::vector<uint8_t> header;
+    PutBigEndian( header, static_cast<uint32_t>( width ) );
+    PutBigEndian( header, static_cast<uint32_t>( height ) );
+    header.push_back( 8 );         // Bit depth
+    header.push_back( colorType ); // 2 = RGB, 3 = palette
+    header.push_back( 0 );         // Deflate
+    header.push_back( 0 );         // Adaptive filtering
+    header.push_back( 0 );         // Not interlaced
+
+    WriteChunk( png, "IHDR", header.data(), header.size() );
+  }
+
+
+  void WriteImageData( std::vector<uint8_t>& png, const std::vector<uint8_t>& compressed )
+  {
+    WriteChunk( png, "IDAT", compressed.data(), compressed.size() );
+    WriteChunk( png, "IEND", nullptr, 0 );
+  }
+} // namespace
+
+
+void ZlibDeflate( const uint8_t* data, size_t numBytes, std::vector<uint8_t>& out )
+{
+  INSTRUMENT_SCOPE( "deflate" );
+
+  // 2 byte header: deflate with a 32K window, default compression, no preset dictionary
+  out.push_back( 0x78 );
+  out.push_back( 0x9c );
+
+  const size_t start{ out.size() };
+  BitWriter writer{ out, 0, 0 };
+
+  // A single final block with the fixed codes
+  writer.Write( 1, 1 );
+  writer.Write( 1, 2 );
+
+  std::vector<int32_t> head( static_cast<size_t>( 1 ) << hashBits, -1 );
+  std::vector<int32_t> previous( static_cast<size_t>( windowSize ), -1 );
+
+  const int32_t size{ static_cast<int32_t>( numBytes ) };
+
+  auto insert = [&]( int32_t position )
+  {
+    if( position + minMatch <= size )
+    {
+      const uint32_t hash{ Hash3( data + position ) };
+      previous[position & ( windowSize - 1 )] = head[hash];
+      head[hash] = position;
+    }
+  };
+
+  int32_t position{ 0 };
+  while( position < size )
+  {
+    int32_t bestLength{ 0 };
+    int32_t bestDistance{ 0 };
+
+    if( position + minMatch <= size )
+    {
+      const int32_t maxLength{ size - position < maxMatch ? size - position : maxMatch };
+      int32_t candidate{ head[Hash3( data + position )] };
+
+      for( int32_t chain = 0; chain < maxChainLength && candidate >= 0 && position - candidate <= windowSize;
+           ++chain )
+      {
+        // Check the byte that would make this match the longest first, since most candidates fail there
+        if( data[candidate + bestLength] == data[position + bestLength] )
+        {
+          int32_t length{ 0 };
+          while( length < maxLength && data[candidate + length] == data[position + length] )
+          {
+            ++length;
+          }
+
+          if( length > bestLength )
+          {
+            bestLength = length;
+            bestDistance = position - candidate;
+
+            if( length >= goodEnoughMatch || length == maxLength )
+            {
+              break;
+            }
+          }
+        }
+
+        const int32_t next{ previous[candidate & ( windowSize - 1 )] };
+        if( next >= candidate )
+        {
+          break;
+        }
+
+        candidate = next;
+      }
+    }
+
+    if( bestLength >= minMatch )
+    {
+      WriteMatch( writer, bestLength, bestDistance );
+      for( int32_t i = 0; i < bestLength; ++i )
+      {
+        insert( position + i );
+      }
+
+      position += bestLength;
+    }
+    else
+    {
+      WriteFixedLiteral( writer, data[position] );
+      insert( position );
+      ++position;
+    }
+  }
+
+  // End of block
+  WriteFixedLiteral( writer, 256 );
+  writer.Flush();
+
+  // Data that doesn't compress (noise) is cheaper as stored blocks: 5 bytes of overhead per 64K
+  const size_t maxStoredBlock{ 0xffff };
+  const size_t storedSize{ numBytes + ( numBytes / maxStoredBlock + 1 ) * 5 };
+
+  if( out.size() - start > storedSize )
+  {
+    out.resize( start );
+
+    size_t offset{ 0 };
+    do
+    {
+      const size_t length{ numBytes - offset < maxStoredBlock ? numBytes - offset : maxStoredBlock };
+      const bool finalBlock{ offset + length == numBytes };
+
+      out.push_back( finalBlock ? 1 : 0 );
+      out.push_back( static_cast<uint8_t>( length ) );
+      out.push_back( static_cast<uint8_t>( length >> 8 ) );
+      out.push_back( static_cast<uint8_t>( ~length ) );
+      out.push_back( static_cast<uint8_t>( ~length >> 8 ) );
+      out.insert( out.end(), data + offset, data + offset + length );
+
+      offset += length;
+    } while( offset < numBytes );
+  }
+
+  PutBigEndian( out, Adler32( data, numBytes ) );
+}
+
+
+bool EncodePngIndexed( const IndexSurface& surface, const PaletteEntry* palette, int32_t paletteSize,
+                       std::vector<uint8_t>& png )
+{
+  INSTRUMENT_SCOPE( "encode_png" );
+
+  if( surface.width <= 0 || surface.height <= 0 || paletteSize <= 0 || paletteSize > 256 )
+  {
+    return false;
+  }
+
+  WriteHeader( png, surface.width, surface.height, 3 );
+
+  std::vector<uint8_t> entries;
+  for( int32_t i = 0; i < paletteSize; ++i )
+  {
+    entries.push_back( palette[i].r );
+    entries.push_back( palette[i].g );
+    entries.push_back( palette[i].b );
+  }
+
+  WriteChunk( png, "PLTE", entries.data(), entries.size() );
+
+  std::vector<uint8_t> raw;
+  raw.reserve( static_cast<size_t>( surface.width ) * surface.height );
+  for( int32_t y = 0; y < surface.height; ++y )
+  {
+    raw.insert( raw.end(), surface.Row( y ), surface.Row( y ) + surface.width );
+  }
+
+  std::vector<uint8_t> compressed;
+  CompressRows( raw, surface.width, surface.height, 1, compressed );
+  WriteImageData( png, compressed );
+
+  return true;
+}
+
+
+bool EncodePngRgb( const uint32_t* pixels, int32_t width, int32_t height, int32_t pitch, std::vector<uint8_t>& png )
+{
+  INSTRUMENT_SCOPE( "encode_png" );
+
+  if( width <= 0 || height <= 0 )
+  {
+    return false;
+  }
+
+  WriteHeader( png, width, height, 2 );
+
+  std::vector<uint8_t> raw;
+  raw.reserve( static_cast<size_t>( width ) * height * 3 );
+  for( int32_t y = 0; y < height; ++y )
+  {
+    const uint32_t* row{ pixels + static_cast<size_t>( y ) * pitch };
+    for( int32_t x = 0; x < width; ++x )
+    {
+      raw.push_back( static_cast<uint8_t>( row[x] ) );
+      raw.push_back( static_cast<uint8_t>( row[x] >> 8 ) );
+      raw.push_back( static_cast<uint8_t>( row[x] >> 16 ) );
+    }
+  }
+
+  std::vector<uint8_t> compressed;
+  CompressRows( raw, width * 3, height, 3, compressed );
+  WriteImageData( png, compressed );
+
+  return true;
+}
+
+
+bool WritePngRgb( const char* filename, const RgbSurface& surface )
+{
+  std::vector<uint8_t> png;
+  return EncodePngRgb( surface.pixels.data(), surface.width, surface.height, surface.pitch, png ) &&
+         WriteFileBytes( filename, png );
+}
@@ -0,0 +1,24 @@
+// Minimal PNG writer for the rippers' generated images (map tiles, pyramids).
+// Writes non-interlaced 8-bit palette or RGB images. Rows are filtered with the usual minimum-sum heuristic and
+// compressed with a fixed-Huffman deflate, which is most of what pixel art gains from a full encoder.
+
+#ifndef PNG_PNG_WRITER_H
+#define PNG_PNG_WRITER_H
+
+#include "../tile_decode/surface.h"
+
+// Encodes an indexed surface with its palette (up to 256 entries)
+bool EncodePngIndexed( const IndexSurface& surface, const PaletteEntry* palette, int32_t paletteSize,
+                       std::vector<uint8_t>& png );
+
+// Encodes width x height pixels stored as 32-bit 0x00BBGGRR words (R in the lowest byte), pitch pixels apart. The
+// top byte is ignored.
+bool EncodePngRgb( const uint32_t* pixels, int32_t width, int32_t height, int32_t pitch, std::vector<uint8_t>& png );
+
+// Encodes an RGB surface and writes it to filename. Returns false if the file can't be written.
+bool WritePngRgb( const char* filename, const RgbSurface& surface );
+
+// Compresses data into a zlib stream, appended to out
+void ZlibDeflate( const uint8_t* data, size_t numBytes, std::vector<uint8_t>& out );
+
+#endif // PNG_PNG_WRITER_H
@@ -0,0 +1,518 @@
+#include "tile_pyramid.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+#if defined( _WIN32 )
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "../png/png_writer.h"
+#include "../tile_decode/cpu_dispatch.h"
+#include "../tile_decode/parallel.h"
+
+
+namespace
+{
+  const int32_t tileSize{ PYRAMID_TILE_SIZE };
+  const int32_t halfTile{ PYRAMID_TILE_SIZE / 2 };
+  const size_t tilePixels{ static_cast<size_t>( PYRAMID_TILE_SIZE ) * PYRAMID_TILE_SIZE };
+
+  const char* const manifestName{ "pyramid.manifest" };
+
+
+  bool MakeDirectory( const std::string& path )
+  {
+#if defined( _WIN32 )
+    const int result{ _mkdir( path.c_str() ) };
+#else
+    const int result{ mkdir( path.c_str(), 0777 ) };
+#endif
+    return result == 0 || errno == EEXIST;
+  }
+
+
+  bool FileExists( const std::string& path )
+  {
+    FILE* file{ fopen( path.c_str(), "rb" ) };
+    if( file == nullptr )
+    {
+      return false;
+    }
+
+    fclose( file );
+    return true;
+  }
+
+
+  // 64-bit FNV-1a, continued from hash
+  uint64_t HashBytes( uint64_t hash, const void* data, size_t numBytes )
+  {
+    const uint8_t* bytes{ static_cast<const uint8_t*>( data ) };
+    for( size_t i = 0; i < numBytes; ++i )
+    {
+      hash ^= bytes[i];
+      hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+  }
+
+
+  inline uint64_t TileKey( int32_t level, int32_t x, int32_t y )
+  {
+    return ( static_cast<uint64_t>( level ) << 48 ) | ( static_cast<uint64_t>( y ) << 24 ) | static_cast<uint64_t>( x );
+  }
+
+
+  class PyramidBuilder
+  {
+  public:
+    PyramidBuilder( const IndexSurface& source, const PaletteEntry* palette, int32_t paletteSize,
+                    const char* directory, PyramidFilter filter );
+
+    bool Build( int32_t numThreads, PyramidStats* stats );
+
+  private:
+    int32_t TilesPerSide( int32_t level ) const
+    {
+      return 1 << level;
+    }
+
+    size_t TileIndex( int32_t level, int32_t x, int32_t y ) const
+    {
+      return static_cast<size_t>( y ) * TilesPerSide( level ) + x;
+    }
+
+    std::string TilePath( int32_t level, int32_t x, int32_t y ) const
+    {
+      return m_directory + "/" + std::to_string( level ) + "/" + std::to_string( x ) + "_" + std::to_string( y ) +
+             ".png";
+    }
+
+    void HashTiles();
+    void ReadManifest( std::unordered_map<uint64_t, uint64_t>& hashes ) const;
+    bool WriteManifest() const;
+    void FindWork();
+
+    void DrawBaseTile( int32_t x, int32_t y, uint32_t* out ) const;
+    void Downsample( const uint32_t* child, int32_t quadrantX, int32_t quadrantY, uint32_t* out ) const;
+    void FinishTile( int32_t level, int32_t x, int32_t y, const uint32_t* pixels );
+    void BuildSubtree( int32_t level, int32_t x, int32_t y, uint32_t* out,
+                       std::vector<std::vector<uint32_t>>& scratch );
+
+    const IndexSurface& m_source;
+    int32_t m_paletteSize;
+    std::string m_directory;
+    PyramidFilter m_filter;
+    int32_t m_maxLevel{ 0 };
+    uint32_t m_colorTable[256]{};
+    uint64_t m_paletteHash{ 0 };
+
+    // Per level, per tile
+    std::vector<std::vector<uint64_t>> m_hashes;
+    std::vector<std::vector<uint8_t>> m_dirty;  // Has to be written
+    std::vector<std::vector<uint8_t>> m_needed; // Has to be drawn, to be written or to draw a dirty parent
+
+    std::atomic<int32_t> m_numWritten{ 0 };
+    std::atomic<bool> m_failed{ false };
+  };
+
+
+  PyramidBuilder::PyramidBuilder( const IndexSurface& source, const PaletteEntry* palette, int32_t paletteSize,
+                                  const char* directory, PyramidFilter filter )
+    : m_source( source ), m_paletteSize( paletteSize ), m_directory( directory ), m_filter( filter )
+  {
+    // 0x00BBGGRR, the pixel format of the PNG writer
+    for( int32_t i = 0; i < paletteSize && i < 256; ++i )
+    {
+      m_colorTable[i] = palette[i].r | ( palette[i].g << 8 ) | ( static_cast<uint32_t>( palette[i].b ) << 16 );
+    }
+
+    m_paletteHash = HashBytes( 0xcbf29ce484222325ull, m_colorTable, sizeof( m_colorTable ) );
+
+    const int32_t longestSide{ source.width > source.height ? source.width : source.height };
+    while( ( tileSize << m_maxLevel ) < longestSide )
+    {
+      ++m_maxLevel;
+    }
+  }
+
+
+  // Base tiles hash their source indices and the palette. Every other tile hashes its children's hashes and the
+  // filter, so a tile's hash only changes when some source pixel under it does.
+  void PyramidBuilder::HashTiles()
+  {
+    INSTRUMENT_SCOPE( "hash_tiles" );
+
+    m_hashes.resize( static_cast<size_t>( m_maxLevel + 1 ) );
+    for( int32_t level = 0; level <= m_maxLevel; ++level )
+    {
+      m_hashes[level].assign( static_cast<size_t>( TilesPerSide( level ) ) * TilesPerSide( level ), 0 );
+    }
+
+    const int32_t baseSide{ TilesPerSide( m_maxLevel ) };
+    ParallelFor( baseSide * baseSide, 0, [&]( int32_t tile )
+    {
+      const int32_t x{ tile % baseSide };
+      const int32_t y{ tile / baseSide };
+
+      uint64_t hash{ m_paletteHash };
+      for( int32_t row = 0; row < tileSize; ++row )
+      {
+        const int32_t sourceX{ x * tileSize };
+        const int32_t sourceY{ y * tileSize + row };
+        if( sourceY < m_source.height && sourceX < m_source.width )
+        {
+          const int32_t width{ m_source.width - sourceX < tileSize ? m_source.width - sourceX : tileSize };
+          hash = HashBytes( hash, m_source.Row( sourceY ) + sourceX, static_cast<size_t>( width ) );
+          hash = HashBytes( hash, &width, sizeof( width ) );
+        }
+      }
+
+      m_hashes[m_maxLevel][tile] = hash;
+    } );
+
+    const uint8_t filter{ static_cast<uint8_t>( m_filter ) };
+    for( int32_t level = m_maxLevel - 1; level >= 0; --level )
+    {
+      const int32_t side{ TilesPerSide( level ) };
+      for( int32_t y = 0; y < side; ++y )
+      {
+        for( int32_t x = 0; x < side; ++x )
+        {
+          uint64_t hash{ HashBytes( 0xcbf29ce484222325ull, &filter, 1 ) };
+          for( int32_t quadrant = 0; quadrant < 4; ++quadrant )
+          {
+            const size_t child{ TileIndex( level + 1, x * 2 + ( quadrant & 1 ), y * 2 + ( quadrant >> 1 ) ) };
+            hash = HashBytes( hash, &m_hashes[level + 1][child], sizeof( uint64_t ) );
+          }
+
+          m_hashes[level][TileIndex( level, x, y )] = hash;
+        }
+      }
+    }
+  }
+
+
+  void PyramidBuilder::ReadManifest( std::unordered_map<uint64_t, uint64_t>& hashes ) const
+  {
+    FILE* file{ fopen( ( m_directory + "/" + manifestName ).c_str(), "r" ) };
+    if( file == nullptr )
+    {
+      return;
+    }
+
+    char line[128];
+    while( fgets( line, sizeof( line ), file ) != nullptr )
+    {
+      int32_t level;
+      int32_t x;
+      int32_t y;
+      uint64_t hash;
+
+      // Anything that doesn't parse (the comment line) is skipped
+      if( sscanf( line, "%d %d %d %" SCNx64, &level, &x, &y, &hash ) == 4 )
+      {
+        hashes[TileKey( level, x, y )] = hash;
+      }
+    }
+
+    fclose( file );
+  }
+
+
+  bool PyramidBuilder::WriteManifest() const
+  {
+    FILE* file{ fopen( ( m_directory + "/" + manifestName ).c_str(), "w" ) };
+    if( file == nullptr )
+    {
+      return false;
+    }
+
+    fprintf( file, "# level x y source-hash\n" );
+    for( int32_t level = 0; level <= m_maxLevel; ++level )
+    {
+      const int32_t side{ TilesPerSide( level ) };
+      for( int32_t y = 0; y < side; ++y )
+      {
+        for( int32_t x = 0; x < side; ++x )
+        {
+          fprintf( file, "%d %d %d %016" PRIx64 "\n", level, x, y, m_hashes[level][TileIndex( level, x, y )] );
+        }
+      }
+    }
+
+    return fclose( file ) == 0;
+  }
+
+
+  // A tile is dirty when its hash changed or its file is gone. Drawing a tile needs all 4 children drawn, so every
+  // tile under a dirty one is needed too, though only the dirty ones are written.
+  void PyramidBuilder::FindWork()
+  {
+    std::unordered_map<uint64_t, uint64_t> previous;
+    ReadManifest( previous );
+
+    m_dirty.resize( m_hashes.size() );
+    m_needed.resize( m_hashes.size() );
+
+    for( int32_t level = 0; level <= m_maxLevel; ++level )
+    {
+      const int32_t side{ TilesPerSide( level ) };
+      m_dirty[level].assign( static_cast<size_t>( side ) * side, 0 );
+      m_needed[level].assign( static_cast<size_t>( side ) * side, 0 );
+
+      for( int32_t y = 0; y < side; ++y )
+      {
+        for( int32_t x = 0; x < side; ++x )
+        {
+          const size_t index{ TileIndex( level, x, y ) };
+          const auto entry = previous.find( TileKey( level, x, y ) );
+
+          const bool unchanged{ entry != previous.end() && entry->second == m_hashes[level][index] &&
+                                FileExists( TilePath( level, x, y ) ) };
+          const bool parentNeeded{ level > 0 && m_needed[level - 1][TileIndex( level - 1, x / 2, y / 2 )] };
+
+          m_dirty[level][index] = unchanged ? 0 : 1;
+          m_needed[level][index] = !unchanged || parentNeeded ? 1 : 0;
+        }
+      }
+    }
+  }
+
+
+  void PyramidBuilder::DrawBaseTile( int32_t x, int32_t y, uint32_t* out ) const
+  {
+    const DecodeKernels& kernels{ Kernels() };
+
+    for( int32_t row = 0; row < tileSize; ++row )
+    {
+      uint32_t* dest{ out + static_cast<size_t>( row ) * tileSize };
+      const int32_t sourceX{ x * tileSize };
+      const int32_t sourceY{ y * tileSize + row };
+
+      int32_t width{ 0 };
+      if( sourceY < m_source.height && sourceX < m_source.width )
+      {
+        width = m_source.width - sourceX < tileSize ? m_source.width - sourceX : tileSize;
+        kernels.mapIndices32( m_source.Row( sourceY ) + sourceX, width, m_colorTable, m_paletteSize, dest );
+      }
+
+      // Padding past the edge of the image
+      for( int32_t i = width; i < tileSize; ++i )
+      {
+        dest[i] = 0;
+      }
+    }
+  }
+
+
+  // Shrinks a child tile into one quadrant of out
+  void PyramidBuilder::Downsample( const uint32_t* child, int32_t quadrantX, int32_t quadrantY, uint32_t* out ) const
+  {
+    const DecodeKernels& kernels{ Kernels() };
+
+    for( int32_t row = 0; row < halfTile; ++row )
+    {
+      const uint32_t* row0{ child + static_cast<size_t>( row * 2 ) * tileSize };
+      const uint32_t* row1{ row0 + tileSize };
+      uint32_t* dest{ out + static_cast<size_t>( quadrantY * halfTile + row ) * tileSize + quadrantX * halfTile };
+
+      if( m_filter == PYRAMID_BOX )
+      {
+        kernels.boxFilter2x( row0, row1, halfTile, dest );
+      }
+      else
+      {
+        for( int32_t i = 0; i < halfTile; ++i )
+        {
+          dest[i] = row0[i * 2];
+        }
+      }
+    }
+  }
+
+
+  void PyramidBuilder::FinishTile( int32_t level, int32_t x, int32_t y, const uint32_t* pixels )
+  {
+    if( !m_dirty[level][TileIndex( level, x, y )] )
+    {
+      return;
+    }
+
+    std::vector<uint8_t> png;
+    EncodePngRgb( pixels, tileSize, tileSize, tileSize, png );
+
+    const std::string path{ TilePath( level, x, y ) };
+    if( !WriteFileBytes( path.c_str(), png ) )
+    {
+      if( !m_failed.exchange( true ) )
+      {
+        printf( "Can't write %s\n", path.c_str() );
+      }
+
+      return;
+    }
+
+    ++m_numWritten;
+  }
+
+
+  // Draws a tile from its children, depth first, with one scratch tile per level below this one
+  void PyramidBuilder::BuildSubtree( int32_t level, int32_t x, int32_t y, uint32_t* out,
+                                     std::vector<std::vector<uint32_t>>& scratch )
+  {
+    if( level == m_maxLevel )
+    {
+      DrawBaseTile( x, y, out );
+    }
+    else
+    {
+      uint32_t* child{ scratch[level + 1].data() };
+      for( int32_t quadrant = 0; quadrant < 4; ++quadrant )
+      {
+        BuildSubtree( level + 1, x * 2 + ( quadrant & 1 ), y * 2 + ( quadrant >> 1 ), child, scratch );
+        Downsample( child, quadrant & 1, quadrant >> 1, out );
+      }
+    }
+
+    FinishTile( level, x, y, out );
+  }
+
+
+  bool PyramidBuilder::Build( int32_t numThreads, PyramidStats* stats )
+  {
+    HashTiles();
+    FindWork();
+
+    for( int32_t level = 0; level <= m_maxLevel; ++level )
+    {
+      if( !MakeDirectory( m_directory + "/" + std::to_string( level ) ) )
+      {
+        printf( "Can't create %s/%d\n", m_directory.c_str(), level );
+        return false;
+      }
+    }
+
+    // Subtrees are split off at the first level with a couple of tiles per thread. Only that level's tiles and the
+    // few above it are kept whole.
+    numThreads = ResolveThreadCount( numThreads );
+
+    int32_t splitLevel{ 0 };
+    while( splitLevel < m_maxLevel && TilesPerSide( splitLevel ) * TilesPerSide( splitLevel ) < numThreads * 2 )
+    {
+      ++splitLevel;
+    }
+
+    std::vector<std::vector<uint32_t>> levelTiles( static_cast<size_t>( TilesPerSide( splitLevel ) ) *
+                                                   TilesPerSide( splitLevel ) );
+
+    {
+      INSTRUMENT_SCOPE( "build_subtrees" );
+
+      const int32_t side{ TilesPerSide( splitLevel ) };
+      ParallelFor( side * side, numThreads, [&]( int32_t tile )
+      {
+        if( !m_needed[splitLevel][tile] )
+        {
+          return;
+        }
+
+        std::vector<std::vector<uint32_t>> scratch( static_cast<size_t>( m_maxLevel + 1 ) );
+        for( int32_t level = splitLevel + 1; level <= m_maxLevel; ++level )
+        {
+          scratch[level].resize( tilePixels );
+        }
+
+        levelTiles[tile].resize( tilePixels );
+        BuildSubtree( splitLevel, tile % side, tile / side, levelTiles[tile].data(), scratch );
+      } );
+    }
+
+    // The levels above the split, which are small
+    for( int32_t level = splitLevel - 1; level >= 0; --level )
+    {
+      INSTRUMENT_SCOPE( "build_top_levels" );
+
+      const int32_t side{ TilesPerSide( level ) };
+      std::vector<std::vector<uint32_t>> parents( static_cast<size_t>( side ) * side );
+
+      for( int32_t y = 0; y < side; ++y )
+      {
+        for( int32_t x = 0; x < side; ++x )
+        {
+          const size_t index{ TileIndex( level, x, y ) };
+          if( !m_needed[level][index] )
+          {
+            continue;
+          }
+
+          parents[index].resize( tilePixels );
+          for( int32_t quadrant = 0; quadrant < 4; ++quadrant )
+          {
+            const size_t child{ TileIndex( level + 1, x * 2 + ( quadrant & 1 ), y * 2 + ( quadrant >> 1 ) ) };
+            Downsample( levelTiles[child].data(), quadrant & 1, quadrant >> 1, parents[index].data() );
+          }
+
+          FinishTile( level, x, y, parents[index].data() );
+        }
+      }
+
+      levelTiles.swap( parents );
+    }
+
+    if( stats != nullptr )
+    {
+      stats->numLevels = m_maxLevel + 1;
+      stats->numTiles = 0;
+      for( const std::vector<uint64_t>& level : m_hashes )
+      {
+        stats->numTiles += static_cast<int32_t>( level.size() );
+      }
+
+      stats->numWritten = m_numWritten;
+    }
+
+    if( m_failed )
+    {
+      return false;
+    }
+
+    if( !WriteManifest() )
+    {
+      printf( "Can't write %s/%s\n", m_directory.c_str(), manifestName );
+      return false;
+    }
+
+    return true;
+  }
+} // namespace
+
+
+bool BuildTilePyramid( const IndexSurface& source, const PaletteEntry* palette, int32_t paletteSize,
+                       const char* directory, PyramidFilter filter, int32_t numThreads, PyramidStats* stats )
+{
+  INSTRUMENT_SCOPE( "pyramid" );
+
+  if( source.width <= 0 || source.height <= 0 || paletteSize <= 0 || paletteSize > 256 )
+  {
+    printf( "Nothing to build a pyramid from\n" );
+    return false;
+  }
+
+  if( !MakeDirectory( directory ) )
+  {
+    printf( "Can't create %s\n", directory );
+    return false;
+  }
+
+  PyramidBuilder builder{ source, palette, paletteSize, directory, filter };
+  return builder.Build( numThreads, stats );
+}
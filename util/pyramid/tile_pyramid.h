@@ -0,0 +1,40 @@
+// Deep-zoom tile pyramids of rendered maps, for the web viewer.
+// Zoom level 0 is the whole image in one 256x256 tile, and every level doubles the size up to the level where the
+// image is at full resolution. Tiles are written to DIR/z/x_y.png. Images that don't fill a power-of-two square of
+// tiles are padded with black.
+//
+// Each level is built from the one below it with a 2x2 box filter, or by keeping the top-left pixel of every block for
+// crisp pixel art. Subtrees are built depth first on a thread pool and every tile goes to the PNG encoder as soon as
+// it's done, so only one tile per level per thread is held in memory, never a whole level.
+//
+// DIR/pyramid.manifest keeps a hash of every tile's source pixels. Tiles whose source hasn't changed since the last
+// run (which is every tile of a level whose source is unchanged) aren't encoded or written again. Delete the manifest
+// to force a full rebuild.
+
+#ifndef PYRAMID_TILE_PYRAMID_H
+#define PYRAMID_TILE_PYRAMID_H
+
+#include "../tile_decode/surface.h"
+
+#define PYRAMID_TILE_SIZE 256
+
+enum PyramidFilter
+{
+  PYRAMID_BOX,
+  PYRAMID_NEAREST
+};
+
+struct PyramidStats
+{
+  int32_t numLevels{ 0 };
+  int32_t numTiles{ 0 };
+  int32_t numWritten{ 0 };
+};
+
+// Builds the pyramid of source (indices into palette) under directory, which is created if needed. Uses numThreads
+// threads, or one per core when it's 0. Returns false (after printing why) if a directory or tile can't be written.
+bool BuildTilePyramid( const IndexSurface& source, const PaletteEntry* palette, int32_t paletteSize,
+                       const char* directory, PyramidFilter filter, int32_t numThreads = 0,
+                       PyramidStats* stats = nullptr );
+
+#endif // PYRAMID_TILE_PYRAMID_H
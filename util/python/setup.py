@@ -0,0 +1,41 @@
+# Builds the tilerip extension from the same sources as TileRip.vcxproj:
+#   python setup.py build_ext --inplace
+
+import glob
+import os
+import sys
+
+from setuptools import Extension, setup
+
+here = os.path.dirname(os.path.abspath(__file__))
+util = os.path.dirname(here)
+
+
+def sources(*patterns):
+    return sorted(os.path.relpath(path, here) for pattern in patterns for path in glob.glob(os.path.join(util, pattern)))
+
+
+setup(
+    name="tilerip",
+    version="1.0",
+    description="The Ultima tile rippers' decoders, returning palette indices through the buffer protocol",
+    ext_modules=[
+        Extension(
+            "tilerip",
+            sources=["tilerip_module.cpp"] + sources(
+                "tilerip/tilerip.cpp",
+                "tile_decode/apple2_decode.cpp",
+                "tile_decode/c64_decode.cpp",
+                "tile_decode/cpu_dispatch.cpp",
+                "tile_decode/ega_decode.cpp",
+                "tile_decode/kernels_*.cpp",
+                "tile_decode/surface.cpp",
+                "instrument/instrument.cpp",
+                "lzw_decode/lzw.c",
+                "lzw_decode/lzwvar.c",
+            ),
+            language="c++",
+            extra_compile_args=[] if sys.platform == "win32" else ["-O2", "-fvisibility=hidden"],
+        )
+    ],
+)
@@ -0,0 +1,632 @@
+// The tilerip Python extension: the decoders of tilerip.h for analysis scripts, without running the rippers.
+//
+// Every decoder returns a Surface, which holds the palette indices (one byte per pixel) and exports them through the
+// buffer protocol as a 2D array of height rows and width columns. numpy.asarray( surface ) and memoryview( surface )
+// use the pixels in place, with no copy. Inputs can be any object with the buffer protocol (bytes, bytearray, mmap,
+// NumPy arrays). The GIL is released while decoding, so a thread pool decodes on as many cores as it has threads.
+//
+// The tile and charset files decode as one long strip of tiles, which NumPy reshapes without a copy, e.g. for the PC
+// Ultima 4 tiles (256 tiles of 16x16 pixels):
+//   shapes = tilerip.decode_ega_packed( open( "SHAPES.EGA", "rb" ).read(), 8 )
+//   tiles = numpy.asarray( shapes ).reshape( 256, 16, 16 )
+//
+// Built with setup.py next to this file:
+//   python setup.py build_ext --inplace
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <cstring>
+
+#include "../tilerip/tilerip.h"
+
+
+namespace
+{
+  // ---------------------
+  // Surface
+  // ---------------------
+
+  struct SurfaceObject
+  {
+    PyObject_HEAD
+    uint8_t* pixels;
+    Py_ssize_t shape[2];    // Rows, then columns
+    Py_ssize_t strides[2];
+    PyObject* palette;      // bytes, 3 per color
+  };
+
+
+  void SurfaceDealloc( SurfaceObject* self )
+  {
+    PyMem_Free( self->pixels );
+    Py_XDECREF( self->palette );
+    Py_TYPE( self )->tp_free( reinterpret_cast<PyObject*>( self ) );
+  }
+
+
+  int SurfaceGetBuffer( SurfaceObject* self, Py_buffer* view, int flags )
+  {
+    const Py_ssize_t size{ self->shape[0] * self->shape[1] };
+    if( PyBuffer_FillInfo( view, reinterpret_cast<PyObject*>( self ), self->pixels, size, 0, flags ) < 0 )
+    {
+      return -1;
+    }
+
+    // Rows are back to back, so the 2D view is C contiguous and consumers that don't ask for strides get it too
+    view->ndim = 2;
+    view->shape = ( flags & PyBUF_ND ) == PyBUF_ND ? self->shape : nullptr;
+    view->strides = ( flags & PyBUF_STRIDES ) == PyBUF_STRIDES ? self->strides : nullptr;
+    if( view->shape == nullptr )
+    {
+      view->ndim = 1;
+    }
+
+    return 0;
+  }
+
+
+  PyBufferProcs surfaceBufferProcs{ reinterpret_cast<getbufferproc>( SurfaceGetBuffer ), nullptr };
+
+
+  PyObject* SurfaceGetWidth( SurfaceObject* self, void* )
+  {
+    return PyLong_FromSsize_t( self->shape[1] );
+  }
+
+
+  PyObject* SurfaceGetHeight( SurfaceObject* self, void* )
+  {
+    return PyLong_FromSsize_t( self->shape[0] );
+  }
+
+
+  PyObject* SurfaceGetPalette( SurfaceObject* self, void* )
+  {
+    Py_INCREF( self->palette );
+    return self->palette;
+  }
+
+
+  PyGetSetDef surfaceGetSet[] = {
+    { "width", reinterpret_cast<getter>( SurfaceGetWidth ), nullptr, "Columns of pixels", nullptr },
+    { "height", reinterpret_cast<getter>( SurfaceGetHeight ), nullptr, "Rows of pixels", nullptr },
+    { "palette", reinterpret_cast<getter>( SurfaceGetPalette ), nullptr,
+      "The colors the indices refer to, as bytes of r, g, b", nullptr },
+    { nullptr, nullptr, nullptr, nullptr, nullptr }
+  };
+
+
+  // Filled in by PyInit_tilerip(), field by field
+  PyTypeObject surfaceType{};
+
+
+  // A surface of zeroes, or null with an exception set
+  SurfaceObject* NewSurface( int32_t width, int32_t height, tilerip_palette_id palette )
+  {
+    SurfaceObject* surface{ PyObject_New( SurfaceObject, &surfaceType ) };
+    if( surface == nullptr )
+    {
+      return nullptr;
+    }
+
+    surface->shape[0] = height;
+    surface->shape[1] = width;
+    surface->strides[0] = width;
+    surface->strides[1] = 1;
+    surface->palette = nullptr;
+
+    // One byte even when empty, so the buffer always has an address
+    surface->pixels = static_cast<uint8_t*>( PyMem_Calloc( static_cast<size_t>( width ) * height + 1, 1 ) );
+
+    uint8_t rgb[16 * 3];
+    const int32_t numColors{ tilerip_palette( palette, rgb, 16 ) };
+    surface->palette = PyBytes_FromStringAndSize( reinterpret_cast<const char*>( rgb ), numColors * 3 );
+
+    if( surface->pixels == nullptr || surface->palette == nullptr )
+    {
+      Py_DECREF( surface );
+      PyErr_NoMemory();
+      return nullptr;
+    }
+
+    return surface;
+  }
+
+
+  tilerip_image SurfaceImage( SurfaceObject* surface )
+  {
+    return tilerip_image{ surface->pixels, static_cast<int32_t>( surface->shape[1] ),
+                          static_cast<int32_t>( surface->shape[0] ), static_cast<int32_t>( surface->strides[0] ) };
+  }
+
+
+  // ---------------------
+  // Helpers
+  // ---------------------
+
+  // Raises a ValueError for a failed status. Returns null.
+  PyObject* SetStatusError( tilerip_status status, const char* what )
+  {
+    PyErr_Format( PyExc_ValueError, status == TILERIP_ERROR_DATA ? "%s: the data is corrupt or too short"
+                                                                  : "%s: invalid arguments", what );
+    return nullptr;
+  }
+
+
+  // Drops the result and raises a ValueError if the status is a failure. Returns result otherwise.
+  PyObject* CheckStatus( tilerip_status status, PyObject* result, const char* what )
+  {
+    if( status == TILERIP_OK )
+    {
+      return result;
+    }
+
+    Py_DECREF( result );
+    return SetStatusError( status, what );
+  }
+
+
+  // Whether a width or a number of rows is positive and small enough for the decoders' int32_t geometry
+  bool CheckDimension( Py_ssize_t value, const char* name )
+  {
+    if( value <= 0 || value > 0x7fffff )
+    {
+      PyErr_Format( PyExc_ValueError, "%s must be between 1 and %d", name, 0x7fffff );
+      return false;
+    }
+
+    return true;
+  }
+
+
+  // The number of whole rows of rowBytes bytes, pitch apart, in size bytes
+  Py_ssize_t WholeRows( Py_ssize_t size, Py_ssize_t pitch, Py_ssize_t rowBytes )
+  {
+    return size < rowBytes ? 0 : ( size - rowBytes ) / pitch + 1;
+  }
+
+
+  // ---------------------
+  // Decoders
+  // ---------------------
+
+  PyObject* DecodeEgaPacked( PyObject*, PyObject* args, PyObject* kwargs )
+  {
+    static const char* keywords[] = { "data", "bytes_per_row", "rows", nullptr };
+    Py_buffer data;
+    Py_ssize_t bytesPerRow{ 0 };
+    Py_ssize_t rows{ -1 };
+    if( !PyArg_ParseTupleAndKeywords( args, kwargs, "y*n|n", const_cast<char**>( keywords ), &data, &bytesPerRow,
+                                      &rows ) )
+    {
+      return nullptr;
+    }
+
+    if( rows < 0 && CheckDimension( bytesPerRow, "bytes_per_row" ) )
+    {
+      rows = WholeRows( data.len, bytesPerRow, bytesPerRow );
+    }
+
+    SurfaceObject* surface{ nullptr };
+    if( CheckDimension( bytesPerRow, "bytes_per_row" ) && ( rows == 0 || CheckDimension( rows, "rows" ) ) )
+    {
+      surface = NewSurface( static_cast<int32_t>( bytesPerRow * 2 ), static_cast<int32_t>( rows ),
+                            TILERIP_PALETTE_EGA );
+    }
+
+    if( surface == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return nullptr;
+    }
+
+    const tilerip_image image{ SurfaceImage( surface ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_decode_ega_packed( static_cast<const uint8_t*>( data.buf ), data.len,
+                                        static_cast<int32_t>( bytesPerRow ), &image, nullptr );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &data );
+    return CheckStatus( status, reinterpret_cast<PyObject*>( surface ), "decode_ega_packed" );
+  }
+
+
+  PyObject* DecodeEgaRle( PyObject*, PyObject* args, PyObject* kwargs )
+  {
+    static const char* keywords[] = { "data", "width", "height", nullptr };
+    Py_buffer data;
+    Py_ssize_t width{ 320 };
+    Py_ssize_t height{ 200 };
+    if( !PyArg_ParseTupleAndKeywords( args, kwargs, "y*|nn", const_cast<char**>( keywords ), &data, &width,
+                                      &height ) )
+    {
+      return nullptr;
+    }
+
+    SurfaceObject* surface{ nullptr };
+    if( CheckDimension( width, "width" ) && CheckDimension( height, "height" ) )
+    {
+      surface = NewSurface( static_cast<int32_t>( width ), static_cast<int32_t>( height ), TILERIP_PALETTE_EGA );
+    }
+
+    if( surface == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return nullptr;
+    }
+
+    const tilerip_image image{ SurfaceImage( surface ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_decode_ega_rle( static_cast<const uint8_t*>( data.buf ), data.len, &image );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &data );
+    return CheckStatus( status, reinterpret_cast<PyObject*>( surface ), "decode_ega_rle" );
+  }
+
+
+  PyObject* ExpandRle( PyObject*, PyObject* args )
+  {
+    Py_buffer data;
+    if( !PyArg_ParseTuple( args, "y*", &data ) )
+    {
+      return nullptr;
+    }
+
+    const uint8_t* input{ static_cast<const uint8_t*>( data.buf ) };
+    size_t size{ 0 };
+    tilerip_expand_rle( input, data.len, nullptr, 0, &size );
+
+    PyObject* result{ PyBytes_FromStringAndSize( nullptr, static_cast<Py_ssize_t>( size ) ) };
+    if( result == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return nullptr;
+    }
+
+    uint8_t* dest{ reinterpret_cast<uint8_t*>( PyBytes_AS_STRING( result ) ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_expand_rle( input, data.len, dest, size, &size );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &data );
+    return CheckStatus( status, result, "expand_rle" );
+  }
+
+
+  PyObject* DecodeAppleRows( PyObject*, PyObject* args, PyObject* kwargs )
+  {
+    static const char* keywords[] = { "data", "bytes_per_row", "rows", "src_pitch", "start_odd", nullptr };
+    Py_buffer data;
+    Py_ssize_t bytesPerRow{ 0 };
+    Py_ssize_t rows{ -1 };
+    Py_ssize_t srcPitch{ 0 };
+    int startOdd{ 0 };
+    if( !PyArg_ParseTupleAndKeywords( args, kwargs, "y*n|nnp", const_cast<char**>( keywords ), &data, &bytesPerRow,
+                                      &rows, &srcPitch, &startOdd ) )
+    {
+      return nullptr;
+    }
+
+    if( srcPitch <= 0 )
+    {
+      srcPitch = bytesPerRow;
+    }
+
+    if( rows < 0 && CheckDimension( bytesPerRow, "bytes_per_row" ) && CheckDimension( srcPitch, "src_pitch" ) )
+    {
+      rows = WholeRows( data.len, srcPitch, bytesPerRow );
+    }
+
+    SurfaceObject* surface{ nullptr };
+    if( CheckDimension( bytesPerRow, "bytes_per_row" ) && CheckDimension( srcPitch, "src_pitch" ) &&
+        ( rows == 0 || CheckDimension( rows, "rows" ) ) )
+    {
+      surface = NewSurface( static_cast<int32_t>( bytesPerRow * 7 ), static_cast<int32_t>( rows ),
+                            TILERIP_PALETTE_APPLE2 );
+    }
+
+    if( surface == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return nullptr;
+    }
+
+    const tilerip_image image{ SurfaceImage( surface ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_decode_apple_rows( static_cast<const uint8_t*>( data.buf ), data.len,
+                                        static_cast<int32_t>( bytesPerRow ), static_cast<int32_t>( srcPitch ),
+                                        startOdd, &image );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &data );
+    return CheckStatus( status, reinterpret_cast<PyObject*>( surface ), "decode_apple_rows" );
+  }
+
+
+  PyObject* DecodeAppleScreen( PyObject*, PyObject* args )
+  {
+    Py_buffer data;
+    if( !PyArg_ParseTuple( args, "y*", &data ) )
+    {
+      return nullptr;
+    }
+
+    SurfaceObject* surface{ NewSurface( 280, 192, TILERIP_PALETTE_APPLE2 ) };
+    if( surface == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return nullptr;
+    }
+
+    const tilerip_image image{ SurfaceImage( surface ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_decode_apple_screen( static_cast<const uint8_t*>( data.buf ), data.len, &image );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &data );
+    return CheckStatus( status, reinterpret_cast<PyObject*>( surface ), "decode_apple_screen" );
+  }
+
+
+  PyObject* DecodeC64Hires( PyObject*, PyObject* args, PyObject* kwargs )
+  {
+    static const char* keywords[] = { "bits", "colors", "bytes_per_row", "rows", "bits_pitch", "colors_pitch",
+                                      nullptr };
+    Py_buffer bits;
+    Py_buffer colors;
+    Py_ssize_t bytesPerRow{ 0 };
+    Py_ssize_t rows{ -1 };
+    Py_ssize_t bitsPitch{ 0 };
+    Py_ssize_t colorsPitch{ -1 };
+    if( !PyArg_ParseTupleAndKeywords( args, kwargs, "y*y*n|nnn", const_cast<char**>( keywords ), &bits, &colors,
+                                      &bytesPerRow, &rows, &bitsPitch, &colorsPitch ) )
+    {
+      return nullptr;
+    }
+
+    if( bitsPitch <= 0 )
+    {
+      bitsPitch = bytesPerRow;
+    }
+
+    if( colorsPitch < 0 )
+    {
+      colorsPitch = bytesPerRow;
+    }
+
+    if( rows < 0 && CheckDimension( bytesPerRow, "bytes_per_row" ) && CheckDimension( bitsPitch, "bits_pitch" ) )
+    {
+      rows = WholeRows( bits.len, bitsPitch, bytesPerRow );
+    }
+
+    SurfaceObject* surface{ nullptr };
+    if( CheckDimension( bytesPerRow, "bytes_per_row" ) && CheckDimension( bitsPitch, "bits_pitch" ) &&
+        ( colorsPitch == 0 || CheckDimension( colorsPitch, "colors_pitch" ) ) &&
+        ( rows == 0 || CheckDimension( rows, "rows" ) ) )
+    {
+      surface = NewSurface( static_cast<int32_t>( bytesPerRow * 8 ), static_cast<int32_t>( rows ),
+                            TILERIP_PALETTE_C64 );
+    }
+
+    if( surface == nullptr )
+    {
+      PyBuffer_Release( &bits );
+      PyBuffer_Release( &colors );
+      return nullptr;
+    }
+
+    const tilerip_image image{ SurfaceImage( surface ) };
+    tilerip_status status;
+
+    Py_BEGIN_ALLOW_THREADS
+    status = tilerip_decode_c64_hires( static_cast<const uint8_t*>( bits.buf ), bits.len,
+                                       static_cast<int32_t>( bitsPitch ), static_cast<const uint8_t*>( colors.buf ),
+                                       colors.len, static_cast<int32_t>( colorsPitch ),
+                                       static_cast<int32_t>( bytesPerRow ), &image );
+    Py_END_ALLOW_THREADS
+
+    PyBuffer_Release( &bits );
+    PyBuffer_Release( &colors );
+    return CheckStatus( status, reinterpret_cast<PyObject*>( surface ), "decode_c64_hires" );
+  }
+
+
+  PyObject* LzwDecompress( PyObject*, PyObject* args, PyObject* kwargs )
+  {
+    static const char* keywords[] = { "data", "variable", nullptr };
+    Py_buffer data;
+    int variable{ 0 };
+    if( !PyArg_ParseTupleAndKeywords( args, kwargs, "y*|p", const_cast<char**>( keywords ), &data, &variable ) )
+    {
+      return nullptr;
+    }
+
+    const uint8_t* input{ static_cast<const uint8_t*>( data.buf ) };
+    size_t inputSize{ static_cast<size_t>( data.len ) };
+    const tilerip_lzw_format format{ variable ? TILERIP_LZW_VARIABLE : TILERIP_LZW_U4 };
+
+    // Variable-width files start with their size, so they decode in one pass into a buffer of that size. No codeword
+    // (9 bits at least) decodes to more than the 4096 bytes the dictionary can hold, which bounds a corrupt size.
+    size_t expectedSize{ 0 };
+    size_t header{ 0 };
+    if( variable && tilerip_lzw_read_header( input, inputSize, &expectedSize, &header ) != TILERIP_OK )
+    {
+      PyBuffer_Release( &data );
+      PyErr_SetString( PyExc_ValueError, "lzw_decompress: not a variable-width LZW file" );
+      return nullptr;
+    }
+
+    if( variable && expectedSize / 4096 > ( inputSize - header ) * 8 / 9 )
+    {
+      PyBuffer_Release( &data );
+      return SetStatusError( TILERIP_ERROR_DATA, "lzw_decompress" );
+    }
+
+    input += header;
+    inputSize -= header;
+
+    // Each call has its own dictionaries, so calls from several threads never wait for each other
+    tilerip_lzw* context{ tilerip_lzw_create() };
+    if( context == nullptr )
+    {
+      PyBuffer_Release( &data );
+      return PyErr_NoMemory();
+    }
+
+    // U4 files don't record their size, so theirs takes a pass without output
+    size_t size{ expectedSize };
+    tilerip_status status{ TILERIP_OK };
+    if( !variable )
+    {
+      Py_BEGIN_ALLOW_THREADS
+      status = tilerip_lzw_decompress( context, format, input, inputSize, nullptr, 0, &size );
+      Py_END_ALLOW_THREADS
+    }
+
+    PyObject* result{ nullptr };
+    if( status != TILERIP_OK )
+    {
+      SetStatusError( status, "lzw_decompress" );
+    }
+    else if( ( result = PyBytes_FromStringAndSize( nullptr, static_cast<Py_ssize_t>( size ) ) ) != nullptr )
+    {
+      uint8_t* dest{ reinterpret_cast<uint8_t*>( PyBytes_AS_STRING( result ) ) };
+
+      size_t written{ 0 };
+      Py_BEGIN_ALLOW_THREADS
+      status = tilerip_lzw_decompress( context, format, input, inputSize, dest, size, &written );
+      Py_END_ALLOW_THREADS
+
+      // A variable-width stream has to decode to exactly the size in its header
+      if( status == TILERIP_ERROR_SPACE || ( status == TILERIP_OK && written != size ) )
+      {
+        status = TILERIP_ERROR_DATA;
+      }
+
+      result = CheckStatus( status, result, "lzw_decompress" );
+    }
+
+    tilerip_lzw_destroy( context );
+    PyBuffer_Release( &data );
+    return result;
+  }
+
+
+  PyObject* Palette( PyObject*, PyObject* args )
+  {
+    const char* name{ nullptr };
+    if( !PyArg_ParseTuple( args, "s", &name ) )
+    {
+      return nullptr;
+    }
+
+    const char* names[] = { "ega", "apple2", "c64" };
+    const tilerip_palette_id ids[] = { TILERIP_PALETTE_EGA, TILERIP_PALETTE_APPLE2, TILERIP_PALETTE_C64 };
+    for( int32_t i = 0; i < 3; ++i )
+    {
+      if( strcmp( name, names[i] ) == 0 )
+      {
+        uint8_t rgb[16 * 3];
+        const int32_t numColors{ tilerip_palette( ids[i], rgb, 16 ) };
+        return PyBytes_FromStringAndSize( reinterpret_cast<const char*>( rgb ), numColors * 3 );
+      }
+    }
+
+    PyErr_Format( PyExc_ValueError, "palette: unknown palette '%s' (ega, apple2 or c64)", name );
+    return nullptr;
+  }
+
+
+  // Functions that take keywords have a third parameter, so they go into the table through a generic function pointer
+  template<typename Function>
+  PyCFunction KeywordFunction( Function function )
+  {
+    return reinterpret_cast<PyCFunction>( reinterpret_cast<void ( * )( void )>( function ) );
+  }
+
+
+  PyMethodDef methods[] = {
+    { "decode_ega_packed", KeywordFunction( DecodeEgaPacked ), METH_VARARGS | METH_KEYWORDS,
+      "decode_ega_packed(data, bytes_per_row, rows=-1) -> Surface\n\n"
+      "Packed 4bpp EGA rows, high nibble first (the PC Ultima 4 tile and charset files). Decodes every row in the "
+      "data unless rows says otherwise." },
+    { "decode_ega_rle", KeywordFunction( DecodeEgaRle ), METH_VARARGS | METH_KEYWORDS,
+      "decode_ega_rle(data, width=320, height=200) -> Surface\n\n"
+      "An RLE compressed EGA picture (the PC Ultima 4 intro and ending pictures)." },
+    { "expand_rle", ExpandRle, METH_VARARGS,
+      "expand_rle(data) -> bytes\n\n"
+      "The raw bytes of an RLE compressed picture, whatever their pixel format." },
+    { "decode_apple_rows", KeywordFunction( DecodeAppleRows ), METH_VARARGS | METH_KEYWORDS,
+      "decode_apple_rows(data, bytes_per_row, rows=-1, src_pitch=bytes_per_row, start_odd=False) -> Surface\n\n"
+      "Apple ][ hi-res rows of 7 pixels per byte, each decoded as one span (the Apple Ultima tile and font files)." },
+    { "decode_apple_screen", DecodeAppleScreen, METH_VARARGS,
+      "decode_apple_screen(data) -> Surface\n\n"
+      "A full-screen Apple ][ hi-res picture, with or without its DOS 3.3 file header, as 280x192 pixels." },
+    { "decode_c64_hires", KeywordFunction( DecodeC64Hires ), METH_VARARGS | METH_KEYWORDS,
+      "decode_c64_hires(bits, colors, bytes_per_row, rows=-1, bits_pitch=bytes_per_row, "
+      "colors_pitch=bytes_per_row) -> Surface\n\n"
+      "C64 hi-res rows of 8 pixels per byte, with a color byte per bitmap byte. A colors_pitch of 0 uses the same "
+      "colors on every row." },
+    { "lzw_decompress", KeywordFunction( LzwDecompress ), METH_VARARGS | METH_KEYWORDS,
+      "lzw_decompress(data, variable=False) -> bytes\n\n"
+      "An Ultima 4 LZW file, or with variable set, an Ultima 5 or 6 file (size header and all)." },
+    { "palette", Palette, METH_VARARGS,
+      "palette(name) -> bytes\n\n"
+      "The colors of the 'ega', 'apple2' or 'c64' palette, as bytes of r, g, b." },
+    { nullptr, nullptr, 0, nullptr }
+  };
+
+
+  PyModuleDef module = { PyModuleDef_HEAD_INIT, "tilerip",
+                         "The Ultima tile rippers' decoders. Decoded pixels come back as Surfaces of palette indices, "
+                         "which NumPy and memoryview use in place through the buffer protocol.",
+                         -1, methods, nullptr, nullptr, nullptr, nullptr };
+} // namespace
+
+
+PyMODINIT_FUNC PyInit_tilerip( void )
+{
+  // The reference a static type holds on itself, which PyVarObject_HEAD_INIT() would otherwise set
+  Py_SET_REFCNT( &surfaceType, 1 );
+  surfaceType.tp_name = "tilerip.Surface";
+  surfaceType.tp_basicsize = sizeof( SurfaceObject );
+  surfaceType.tp_dealloc = reinterpret_cast<destructor>( SurfaceDealloc );
+  surfaceType.tp_as_buffer = &surfaceBufferProcs;
+  surfaceType.tp_flags = Py_TPFLAGS_DEFAULT;
+  surfaceType.tp_doc = "Decoded palette indices, height rows of width bytes, through the buffer protocol";
+  surfaceType.tp_getset = surfaceGetSet;
+
+  if( PyType_Ready( &surfaceType ) < 0 )
+  {
+    return nullptr;
+  }
+
+  PyObject* result{ PyModule_Create( &module ) };
+  if( result == nullptr )
+  {
+    return nullptr;
+  }
+
+  Py_INCREF( &surfaceType );
+  if( PyModule_AddObject( result, "Surface", reinterpret_cast<PyObject*>( &surfaceType ) ) < 0 ||
+      PyModule_AddIntConstant( result, "ABI_VERSION", tilerip_abi_version() ) < 0 )
+  {
+    Py_DECREF( &surfaceType );
+    Py_DECREF( result );
+    return nullptr;
+  }
+
+  return result;
+}
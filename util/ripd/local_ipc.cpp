@@ -0,0 +1,499 @@
+#include "local_ipc.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <winsock2.h>
+#include <windows.h>
+#include <afunix.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+#if defined( _WIN32 )
+const LocalSocket invalidLocalSocket{ INVALID_SOCKET };
+#else
+const LocalSocket invalidLocalSocket{ -1 };
+#endif
+
+
+namespace
+{
+  bool MakeAddress( const char* path, sockaddr_un& address )
+  {
+    memset( &address, 0, sizeof( address ) );
+    address.sun_family = AF_UNIX;
+    if( strlen( path ) >= sizeof( address.sun_path ) )
+    {
+      return false;
+    }
+
+    strcpy( address.sun_path, path );
+    return true;
+  }
+
+
+#if defined( _WIN32 )
+  typedef int IoSize;
+#else
+  typedef size_t IoSize;
+#endif
+
+
+  // Whether path is a socket file that nothing listens on any more, which a daemon that went away without cleaning up
+  // leaves behind. A daemon that's still running accepts the connection.
+  bool StaleSocket( const sockaddr_un& address )
+  {
+    const LocalSocket probe{ static_cast<LocalSocket>( socket( AF_UNIX, SOCK_STREAM, 0 ) ) };
+    if( probe == invalidLocalSocket )
+    {
+      return false;
+    }
+
+    const bool connected{ connect( probe, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) == 0 };
+#if defined( _WIN32 )
+    const bool refused{ !connected && WSAGetLastError() == WSAECONNREFUSED };
+#else
+    const bool refused{ !connected && errno == ECONNREFUSED };
+#endif
+
+    CloseLocal( probe );
+    return refused;
+  }
+
+
+  // Whether a failed send or receive on a non-blocking socket only means it isn't ready
+  bool WouldBlock()
+  {
+#if defined( _WIN32 )
+    return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+  }
+} // namespace
+
+
+bool InitLocalSockets()
+{
+#if defined( _WIN32 )
+  static const bool started{ [] {
+    WSADATA data;
+    return WSAStartup( MAKEWORD( 2, 2 ), &data ) == 0;
+  }() };
+  return started;
+#else
+  return true;
+#endif
+}
+
+
+LocalSocket ListenLocal( const char* path )
+{
+  sockaddr_un address;
+  if( !MakeAddress( path, address ) )
+  {
+    return invalidLocalSocket;
+  }
+
+  const LocalSocket listener{ static_cast<LocalSocket>( socket( AF_UNIX, SOCK_STREAM, 0 ) ) };
+  if( listener == invalidLocalSocket )
+  {
+    return invalidLocalSocket;
+  }
+
+  // A socket file outlives the daemon that made it. Any other file (a running daemon's socket included) makes bind()
+  // fail.
+  if( StaleSocket( address ) )
+  {
+#if defined( _WIN32 )
+    DeleteFileA( path );
+#else
+    unlink( path );
+#endif
+  }
+
+  if( bind( listener, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 ||
+      listen( listener, 16 ) != 0 )
+  {
+    CloseLocal( listener );
+    return invalidLocalSocket;
+  }
+
+  return listener;
+}
+
+
+LocalSocket ConnectLocal( const char* path )
+{
+  sockaddr_un address;
+  if( !MakeAddress( path, address ) )
+  {
+    return invalidLocalSocket;
+  }
+
+  const LocalSocket connection{ static_cast<LocalSocket>( socket( AF_UNIX, SOCK_STREAM, 0 ) ) };
+  if( connection == invalidLocalSocket )
+  {
+    return invalidLocalSocket;
+  }
+
+  if( connect( connection, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 )
+  {
+    CloseLocal( connection );
+    return invalidLocalSocket;
+  }
+
+  return connection;
+}
+
+
+LocalSocket AcceptLocal( LocalSocket listener )
+{
+  return static_cast<LocalSocket>( accept( listener, nullptr, nullptr ) );
+}
+
+
+void CloseLocal( LocalSocket socket )
+{
+#if defined( _WIN32 )
+  closesocket( socket );
+#else
+  close( socket );
+#endif
+}
+
+
+bool SetNonBlocking( LocalSocket socket )
+{
+#if defined( _WIN32 )
+  u_long nonBlocking{ 1 };
+  return ioctlsocket( socket, FIONBIO, &nonBlocking ) == 0;
+#else
+  const int flags{ fcntl( socket, F_GETFL, 0 ) };
+  return flags >= 0 && fcntl( socket, F_SETFL, flags | O_NONBLOCK ) == 0;
+#endif
+}
+
+
+bool SendAll( LocalSocket socket, const void* data, size_t numBytes )
+{
+  const char* bytes{ static_cast<const char*>( data ) };
+  while( numBytes > 0 )
+  {
+#if defined( _WIN32 )
+    const int sent{ send( socket, bytes, static_cast<IoSize>( numBytes ), 0 ) };
+#else
+    // A client that hangs up mid-reply must not take the daemon down with SIGPIPE
+    const ssize_t sent{ send( socket, bytes, static_cast<IoSize>( numBytes ), MSG_NOSIGNAL ) };
+    if( sent < 0 && errno == EINTR )
+    {
+      continue;
+    }
+#endif
+    if( sent <= 0 )
+    {
+      return false;
+    }
+
+    bytes += sent;
+    numBytes -= static_cast<size_t>( sent );
+  }
+
+  return true;
+}
+
+
+bool ReceiveAll( LocalSocket socket, void* data, size_t numBytes )
+{
+  char* bytes{ static_cast<char*>( data ) };
+  while( numBytes > 0 )
+  {
+#if defined( _WIN32 )
+    const int received{ recv( socket, bytes, static_cast<IoSize>( numBytes ), 0 ) };
+#else
+    const ssize_t received{ recv( socket, bytes, static_cast<IoSize>( numBytes ), 0 ) };
+    if( received < 0 && errno == EINTR )
+    {
+      continue;
+    }
+#endif
+    if( received <= 0 )
+    {
+      return false;
+    }
+
+    bytes += received;
+    numBytes -= static_cast<size_t>( received );
+  }
+
+  return true;
+}
+
+
+bool SendSome( LocalSocket socket, const void* data, size_t numBytes, size_t& done )
+{
+  done = 0;
+  for( ;; )
+  {
+#if defined( _WIN32 )
+    const int sent{ send( socket, static_cast<const char*>( data ), static_cast<IoSize>( numBytes ), 0 ) };
+#else
+    const ssize_t sent{ send( socket, data, static_cast<IoSize>( numBytes ), MSG_NOSIGNAL ) };
+    if( sent < 0 && errno == EINTR )
+    {
+      continue;
+    }
+#endif
+    if( sent < 0 )
+    {
+      return WouldBlock();
+    }
+
+    done = static_cast<size_t>( sent );
+    return true;
+  }
+}
+
+
+bool ReceiveSome( LocalSocket socket, void* data, size_t numBytes, size_t& done )
+{
+  done = 0;
+  for( ;; )
+  {
+#if defined( _WIN32 )
+    const int received{ recv( socket, static_cast<char*>( data ), static_cast<IoSize>( numBytes ), 0 ) };
+#else
+    const ssize_t received{ recv( socket, data, static_cast<IoSize>( numBytes ), 0 ) };
+    if( received < 0 && errno == EINTR )
+    {
+      continue;
+    }
+#endif
+    if( received < 0 )
+    {
+      return WouldBlock();
+    }
+
+    // 0 is the peer closing its end
+    done = static_cast<size_t>( received );
+    return received > 0;
+  }
+}
+
+
+bool WaitReady( LocalSocket listener, const LocalSocket* sockets, const bool* wantWrite, int32_t numSockets,
+                bool* readable, bool* writable )
+{
+  fd_set readSet;
+  fd_set writeSet;
+  FD_ZERO( &readSet );
+  FD_ZERO( &writeSet );
+  FD_SET( listener, &readSet );
+
+  LocalSocket highest{ listener };
+  for( int32_t i = 0; i < numSockets; ++i )
+  {
+    FD_SET( sockets[i], wantWrite[i] ? &writeSet : &readSet );
+
+    highest = sockets[i] > highest ? sockets[i] : highest;
+  }
+
+  if( select( static_cast<int>( highest + 1 ), &readSet, &writeSet, nullptr, nullptr ) < 0 )
+  {
+#if !defined( _WIN32 )
+    if( errno == EINTR )
+    {
+      memset( readable, 0, numSockets + 1 );
+      memset( writable, 0, numSockets );
+      return true;
+    }
+#endif
+    return false;
+  }
+
+  for( int32_t i = 0; i < numSockets; ++i )
+  {
+    readable[i] = FD_ISSET( sockets[i], &readSet ) != 0;
+    writable[i] = FD_ISSET( sockets[i], &writeSet ) != 0;
+  }
+
+  readable[numSockets] = FD_ISSET( listener, &readSet ) != 0;
+  return true;
+}
+
+
+SharedMemory::~SharedMemory()
+{
+  Close();
+}
+
+
+#if defined( _WIN32 )
+
+bool SharedMemory::Create( const char* name, size_t size )
+{
+  Close();
+
+  const uint64_t size64{ size };
+  HANDLE mapping{ CreateFileMappingA( INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                      static_cast<DWORD>( size64 >> 32 ), static_cast<DWORD>( size64 ), name ) };
+  if( mapping == nullptr || GetLastError() == ERROR_ALREADY_EXISTS )
+  {
+    if( mapping != nullptr )
+    {
+      CloseHandle( mapping );
+    }
+
+    return false;
+  }
+
+  m_mapping = mapping;
+  m_data = static_cast<uint8_t*>( MapViewOfFile( mapping, FILE_MAP_ALL_ACCESS, 0, 0, size ) );
+  if( m_data == nullptr )
+  {
+    Close();
+    return false;
+  }
+
+  m_size = size;
+  m_owner = true;
+  return true;
+}
+
+
+bool SharedMemory::Open( const char* name )
+{
+  Close();
+
+  m_mapping = OpenFileMappingA( FILE_MAP_READ, FALSE, name );
+  if( m_mapping == nullptr )
+  {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+  MEMORY_BASIC_INFORMATION info;
+  if( m_data == nullptr || VirtualQuery( m_data, &info, sizeof( info ) ) == 0 )
+  {
+    Close();
+    return false;
+  }
+
+  m_size = info.RegionSize;
+  return true;
+}
+
+
+void SharedMemory::Close()
+{
+  if( m_data != nullptr )
+  {
+    UnmapViewOfFile( m_data );
+  }
+
+  if( m_mapping != nullptr )
+  {
+    CloseHandle( m_mapping );
+  }
+
+  // The mapping goes away with its last handle
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_owner = false;
+}
+
+#else
+
+bool SharedMemory::Create( const char* name, size_t size )
+{
+  Close();
+
+  const int memory{ shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0600 ) };
+  if( memory < 0 )
+  {
+    return false;
+  }
+
+  snprintf( m_name, sizeof( m_name ), "%s", name );
+  m_owner = true;
+
+  if( ftruncate( memory, static_cast<off_t>( size ) ) != 0 )
+  {
+    close( memory );
+    Close();
+    return false;
+  }
+
+  void* data{ mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, memory, 0 ) };
+  close( memory );
+  if( data == MAP_FAILED )
+  {
+    Close();
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>( data );
+  m_size = size;
+  return true;
+}
+
+
+bool SharedMemory::Open( const char* name )
+{
+  Close();
+
+  const int memory{ shm_open( name, O_RDONLY, 0 ) };
+  if( memory < 0 )
+  {
+    return false;
+  }
+
+  struct stat status;
+  void* data{ MAP_FAILED };
+  if( fstat( memory, &status ) == 0 && status.st_size > 0 )
+  {
+    data = mmap( nullptr, static_cast<size_t>( status.st_size ), PROT_READ, MAP_SHARED, memory, 0 );
+  }
+
+  close( memory );
+  if( data == MAP_FAILED )
+  {
+    return false;
+  }
+
+  m_data = static_cast<uint8_t*>( data );
+  m_size = static_cast<size_t>( status.st_size );
+  return true;
+}
+
+
+void SharedMemory::Close()
+{
+  if( m_data != nullptr )
+  {
+    munmap( m_data, m_size );
+  }
+
+  if( m_owner )
+  {
+    shm_unlink( m_name );
+  }
+
+  m_data = nullptr;
+  m_size = 0;
+  m_owner = false;
+}
+
+#endif
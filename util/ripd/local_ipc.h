@@ -0,0 +1,88 @@
+// The few pieces of local IPC the rip daemon needs, over Unix domain sockets and named shared memory. Windows has had
+// AF_UNIX sockets since Windows 10 1803, so both sides use the same socket calls there as well.
+
+#ifndef RIPD_LOCAL_IPC_H
+#define RIPD_LOCAL_IPC_H
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined( _WIN32 )
+typedef uintptr_t LocalSocket;
+#else
+typedef int LocalSocket;
+#endif
+
+extern const LocalSocket invalidLocalSocket;
+
+// Sets up the socket library (Winsock) once per process. Returns false if it can't.
+bool InitLocalSockets();
+
+// Listens on path, replacing a socket file a previous daemon left behind. Returns invalidLocalSocket on failure,
+// including when a daemon is still listening on path.
+LocalSocket ListenLocal( const char* path );
+
+// Connects to the daemon listening on path. Returns invalidLocalSocket on failure.
+LocalSocket ConnectLocal( const char* path );
+
+LocalSocket AcceptLocal( LocalSocket listener );
+void CloseLocal( LocalSocket socket );
+
+// Makes sends and receives on socket return straight away instead of waiting. Returns false if it can't.
+bool SetNonBlocking( LocalSocket socket );
+
+// Send or receive exactly numBytes, returning false if the peer goes away first
+bool SendAll( LocalSocket socket, const void* data, size_t numBytes );
+bool ReceiveAll( LocalSocket socket, void* data, size_t numBytes );
+
+// One send or receive of up to numBytes on a non-blocking socket. done is the number of bytes, which is 0 if the
+// socket isn't ready. Returns false if the peer has gone away or there's an error.
+bool SendSome( LocalSocket socket, const void* data, size_t numBytes, size_t& done );
+bool ReceiveSome( LocalSocket socket, void* data, size_t numBytes, size_t& done );
+
+// Waits until the listener has a connection to accept, or one of the sockets has something to read or, if its
+// wantWrite flag is set, room to write instead. readable and writable get one flag per socket, and readable one more
+// for the listener. Returns false on an error.
+bool WaitReady( LocalSocket listener, const LocalSocket* sockets, const bool* wantWrite, int32_t numSockets,
+                bool* readable, bool* writable );
+
+// A block of memory shared by name between processes. The creator owns the name and removes it when it's done.
+class SharedMemory
+{
+public:
+  SharedMemory() = default;
+  ~SharedMemory();
+
+  SharedMemory( const SharedMemory& ) = delete;
+  SharedMemory& operator=( const SharedMemory& ) = delete;
+
+  // Creates a new zeroed block, failing if the name is taken
+  bool Create( const char* name, size_t size );
+
+  // Maps an existing block, read only
+  bool Open( const char* name );
+
+  void Close();
+
+  uint8_t* Data() const
+  {
+    return m_data;
+  }
+
+  size_t Size() const
+  {
+    return m_size;
+  }
+
+private:
+  uint8_t* m_data{ nullptr };
+  size_t m_size{ 0 };
+  bool m_owner{ false };
+  char m_name[64]{};
+
+#if defined( _WIN32 )
+  void* m_mapping{ nullptr };
+#endif
+};
+
+#endif // RIPD_LOCAL_IPC_H
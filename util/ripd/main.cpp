@@ -0,0 +1,465 @@
+// ripd: keeps the decoders, their palettes and the sheets they've decoded warm for tools that preview tiles.
+//
+//   ripd [--socket PATH] [--cache-mb N]
+//     Runs the daemon until it's sent --shutdown, SIGINT or SIGTERM.
+//
+//   ripd [--socket PATH] --get FILE --decoder ega-packed|ega-rle|apple-rows|apple-screen|c64-hires --png OUT
+//        [--bytes-per-row N] [--src-pitch N] [--rows N] [--width N] [--offset N] [--lzw u4|variable] [--start-odd]
+//        [--colors-offset N] [--colors-pitch N] [--tile N --tile-height N]
+//     Asks the daemon for a sheet, or a tile of it, and writes it as a PNG.
+//
+//   ripd [--socket PATH] --shutdown
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#if defined( _WIN32 )
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "../png/png_writer.h"
+#include "rip_cache.h"
+#include "rip_client.h"
+
+
+namespace
+{
+  volatile sig_atomic_t stopRequested{ 0 };
+
+  void OnStopSignal( int )
+  {
+    stopRequested = 1;
+  }
+
+
+  const char* FindOption( int32_t argc, char* argv[], const char* option, const char* fallback )
+  {
+    for( int32_t i = 1; i + 1 < argc; ++i )
+    {
+      if( strcmp( argv[i], option ) == 0 )
+      {
+        return argv[i + 1];
+      }
+    }
+
+    return fallback;
+  }
+
+
+  bool HasOption( int32_t argc, char* argv[], const char* option )
+  {
+    for( int32_t i = 1; i < argc; ++i )
+    {
+      if( strcmp( argv[i], option ) == 0 )
+      {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  int32_t FindNumber( int32_t argc, char* argv[], const char* option, int32_t fallback )
+  {
+    const char* value{ FindOption( argc, argv, option, nullptr ) };
+    return value != nullptr ? static_cast<int32_t>( strtol( value, nullptr, 0 ) ) : fallback;
+  }
+
+
+  // ---------------------
+  // Daemon
+  // ---------------------
+
+  // Sheets are requested by absolute path, since a relative one would be found from the daemon's working directory
+  bool IsAbsolutePath( const char* path )
+  {
+#if defined( _WIN32 )
+    const bool drive{ path[0] != '\0' && path[1] == ':' && ( path[2] == '\\' || path[2] == '/' ) };
+    return drive || path[0] == '\\' || path[0] == '/';
+#else
+    return path[0] == '/';
+#endif
+  }
+
+
+  // A client, whatever part of its next request has arrived, and the replies it hasn't read yet
+  struct Connection
+  {
+    LocalSocket socket;
+    std::vector<uint8_t> pending;
+    std::vector<uint8_t> unsent;
+  };
+
+
+  void Queue( Connection& connection, const void* data, size_t numBytes )
+  {
+    const uint8_t* bytes{ static_cast<const uint8_t*>( data ) };
+    connection.unsent.insert( connection.unsent.end(), bytes, bytes + numBytes );
+  }
+
+
+  // Sends as much of the queued replies as the socket takes without waiting. Returns false when the connection should
+  // be closed.
+  bool Flush( Connection& connection )
+  {
+    if( connection.unsent.empty() )
+    {
+      return true;
+    }
+
+    size_t sent{ 0 };
+    if( !SendSome( connection.socket, connection.unsent.data(), connection.unsent.size(), sent ) )
+    {
+      return false;
+    }
+
+    connection.unsent.erase( connection.unsent.begin(), connection.unsent.begin() + sent );
+    return true;
+  }
+
+
+  // Answers one whole request, queueing the reply
+  void Answer( Connection& connection, RipCache& cache, const RipHello& hello, const RipRequest& request,
+               const char* path, bool& shutdown )
+  {
+    if( request.command == RIP_HELLO )
+    {
+      Queue( connection, &hello, sizeof( hello ) );
+      return;
+    }
+
+    RipSheet reply;
+    if( request.version != RIP_PROTOCOL_VERSION || request.command > RIP_SHUTDOWN )
+    {
+      memset( &reply, 0, sizeof( reply ) );
+      memcpy( reply.magic, "URSH", 4 );
+      reply.version = RIP_PROTOCOL_VERSION;
+      reply.status = RIP_ERROR_REQUEST;
+    }
+    else if( request.command == RIP_SHEET && !IsAbsolutePath( path ) )
+    {
+      memset( &reply, 0, sizeof( reply ) );
+      memcpy( reply.magic, "URSH", 4 );
+      reply.version = RIP_PROTOCOL_VERSION;
+      reply.status = RIP_ERROR_REQUEST;
+    }
+    else if( request.command == RIP_SHUTDOWN )
+    {
+      memset( &reply, 0, sizeof( reply ) );
+      memcpy( reply.magic, "URSH", 4 );
+      reply.version = RIP_PROTOCOL_VERSION;
+      shutdown = true;
+    }
+    else
+    {
+      cache.Serve( request, path, reply );
+    }
+
+    Queue( connection, &reply, sizeof( reply ) );
+  }
+
+
+  // Reads what a readable client has sent and answers every request that has fully arrived. A request that's still
+  // arriving waits in the connection, and so do replies the client isn't reading yet, so a slow or stalled client
+  // never holds up the others. Returns false when the connection should be closed.
+  bool Receive( Connection& connection, RipCache& cache, const RipHello& hello, bool& shutdown )
+  {
+    uint8_t buffer[4096];
+    size_t received{ 0 };
+    if( !ReceiveSome( connection.socket, buffer, sizeof( buffer ), received ) )
+    {
+      return false;
+    }
+
+    std::vector<uint8_t>& pending{ connection.pending };
+    pending.insert( pending.end(), buffer, buffer + received );
+
+    size_t used{ 0 };
+    while( pending.size() - used >= sizeof( RipRequest ) )
+    {
+      RipRequest request;
+      memcpy( &request, pending.data() + used, sizeof( request ) );
+      if( memcmp( request.magic, "URRQ", 4 ) != 0 || request.pathLength > RIP_MAX_PATH )
+      {
+        return false;
+      }
+
+      const size_t requestSize{ sizeof( request ) + request.pathLength };
+      if( pending.size() - used < requestSize )
+      {
+        break;
+      }
+
+      char path[RIP_MAX_PATH + 1];
+      memcpy( path, pending.data() + used + sizeof( request ), request.pathLength );
+      path[request.pathLength] = '\0';
+      used += requestSize;
+
+      Answer( connection, cache, hello, request, path, shutdown );
+    }
+
+    pending.erase( pending.begin(), pending.begin() + used );
+    return Flush( connection );
+  }
+
+
+  int32_t RunDaemon( const char* socketPath, size_t cacheBytes )
+  {
+#if defined( _WIN32 )
+    const uint32_t pid{ static_cast<uint32_t>( _getpid() ) };
+    const char* segmentFormat{ "Local\\tilerip-%u" };
+#else
+    const uint32_t pid{ static_cast<uint32_t>( getpid() ) };
+    const char* segmentFormat{ "/tilerip-%u" };
+#endif
+
+    RipHello hello;
+    memset( &hello, 0, sizeof( hello ) );
+    memcpy( hello.magic, "URHI", 4 );
+    hello.version = RIP_PROTOCOL_VERSION;
+    hello.status = RIP_OK;
+    hello.pid = pid;
+    snprintf( hello.segmentName, sizeof( hello.segmentName ), segmentFormat, pid );
+
+    RipCache cache;
+    if( !cache.Create( hello.segmentName, cacheBytes ) )
+    {
+      fprintf( stderr, "ripd: can't create a %u byte shared memory segment\n", static_cast<uint32_t>( cacheBytes ) );
+      return -1;
+    }
+
+    hello.segmentSize = static_cast<uint32_t>( cache.Segment().Size() );
+
+    const LocalSocket listener{ InitLocalSockets() ? ListenLocal( socketPath ) : invalidLocalSocket };
+    if( listener == invalidLocalSocket )
+    {
+      fprintf( stderr, "ripd: can't listen on %s (is another ripd running?)\n", socketPath );
+      return -1;
+    }
+
+    signal( SIGINT, OnStopSignal );
+    signal( SIGTERM, OnStopSignal );
+
+    printf( "ripd: listening on %s, %u MB cache in %s\n", socketPath,
+            static_cast<uint32_t>( cacheBytes >> 20 ), hello.segmentName );
+    fflush( stdout );
+
+    // One thread serves every client in turn. Requests are short, and the cache needs no locking this way. Client
+    // sockets don't block, so a reply that doesn't fit waits in its connection until the socket is writable again.
+    std::vector<Connection> clients;
+    std::vector<LocalSocket> sockets;
+    bool shutdown{ false };
+
+    while( !shutdown && stopRequested == 0 )
+    {
+      const int32_t numClients{ static_cast<int32_t>( clients.size() ) };
+      std::unique_ptr<bool[]> wantWrite{ new bool[clients.size() + 1] };
+      std::unique_ptr<bool[]> readable{ new bool[clients.size() + 1] };
+      std::unique_ptr<bool[]> writable{ new bool[clients.size() + 1] };
+
+      // A client with replies still queued isn't read from until it takes them, so it can't queue up any more
+      sockets.clear();
+      for( int32_t i = 0; i < numClients; ++i )
+      {
+        sockets.push_back( clients[i].socket );
+        wantWrite[i] = !clients[i].unsent.empty();
+      }
+
+      if( !WaitReady( listener, sockets.data(), wantWrite.get(), numClients, readable.get(), writable.get() ) )
+      {
+        break;
+      }
+
+      for( int32_t i = numClients - 1; i >= 0; --i )
+      {
+        bool open{ true };
+        if( writable[i] )
+        {
+          open = Flush( clients[i] );
+        }
+        else if( readable[i] )
+        {
+          open = Receive( clients[i], cache, hello, shutdown );
+        }
+
+        if( !open )
+        {
+          CloseLocal( clients[i].socket );
+          clients.erase( clients.begin() + i );
+        }
+      }
+
+      if( readable[numClients] )
+      {
+        const LocalSocket client{ AcceptLocal( listener ) };
+        if( client != invalidLocalSocket && SetNonBlocking( client ) )
+        {
+          clients.push_back( Connection{ client, {}, {} } );
+        }
+        else if( client != invalidLocalSocket )
+        {
+          CloseLocal( client );
+        }
+      }
+    }
+
+    // The reply to --shutdown is still queued, and a short reply always fits an idle socket
+    for( Connection& client : clients )
+    {
+      Flush( client );
+      CloseLocal( client.socket );
+    }
+
+    CloseLocal( listener );
+
+    remove( socketPath );
+
+    const RipCacheStats& stats{ cache.Stats() };
+    printf( "ripd: %lld hits, %lld misses, %lld resets\n", static_cast<long long>( stats.hits ),
+            static_cast<long long>( stats.misses ), static_cast<long long>( stats.resets ) );
+    return 0;
+  }
+
+
+  // ---------------------
+  // Client
+  // ---------------------
+
+  bool ParseDecoder( const char* name, RipDecoder& decoder )
+  {
+    static const struct
+    {
+      const char* name;
+      RipDecoder decoder;
+    } decoders[] = { { "ega-packed", RIP_DECODE_EGA_PACKED },
+                     { "ega-rle", RIP_DECODE_EGA_RLE },
+                     { "apple-rows", RIP_DECODE_APPLE_ROWS },
+                     { "apple-screen", RIP_DECODE_APPLE_SCREEN },
+                     { "c64-hires", RIP_DECODE_C64_HIRES } };
+
+    for( const auto& entry : decoders )
+    {
+      if( strcmp( name, entry.name ) == 0 )
+      {
+        decoder = entry.decoder;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+
+  int32_t GetSheet( RipClient& client, int32_t argc, char* argv[] )
+  {
+    const char* path{ FindOption( argc, argv, "--get", nullptr ) };
+    const char* pngName{ FindOption( argc, argv, "--png", nullptr ) };
+    const char* lzw{ FindOption( argc, argv, "--lzw", nullptr ) };
+
+    RipDecoder decoder;
+    if( pngName == nullptr || !ParseDecoder( FindOption( argc, argv, "--decoder", "" ), decoder ) ||
+        ( lzw != nullptr && strcmp( lzw, "u4" ) != 0 && strcmp( lzw, "variable" ) != 0 ) )
+    {
+      fprintf( stderr, "ripd: --get needs --decoder, --png, and --lzw u4 or variable if it's compressed\n" );
+      return -1;
+    }
+
+    RipRequest request{ MakeRipRequest( decoder ) };
+    request.compression = static_cast<uint16_t>(
+      lzw == nullptr ? RIP_COMPRESSION_NONE
+                     : strcmp( lzw, "u4" ) == 0 ? RIP_COMPRESSION_LZW_U4 : RIP_COMPRESSION_LZW_VARIABLE );
+    request.startOdd = HasOption( argc, argv, "--start-odd" ) ? 1 : 0;
+    request.offset = static_cast<uint32_t>( FindNumber( argc, argv, "--offset", 0 ) );
+    request.bytesPerRow = FindNumber( argc, argv, "--bytes-per-row", 0 );
+    request.srcPitch = FindNumber( argc, argv, "--src-pitch", 0 );
+    request.width = FindNumber( argc, argv, "--width", 0 );
+    request.rows = FindNumber( argc, argv, "--rows", -1 );
+    request.colorsOffset = static_cast<uint32_t>( FindNumber( argc, argv, "--colors-offset", 0 ) );
+    request.colorsPitch = FindNumber( argc, argv, "--colors-pitch", 0 );
+    request.tile = FindNumber( argc, argv, "--tile", -1 );
+    request.tileHeight = FindNumber( argc, argv, "--tile-height", 0 );
+
+    // The daemon can reuse the sheet's space for someone else's while it's being copied, and then it's asked for again
+    RipSheet reply;
+    IndexSurface surface;
+    bool copied{ false };
+    for( int32_t attempt = 0; attempt < 3 && !copied; ++attempt )
+    {
+      if( !client.Request( request, path, reply ) )
+      {
+        fprintf( stderr, "ripd: the daemon went away\n" );
+        return -1;
+      }
+
+      if( reply.status != RIP_OK )
+      {
+        break;
+      }
+
+      surface.Create( reply.width, reply.height );
+      copied = client.CopyPixels( reply, surface.pixels.data(), surface.pitch );
+    }
+
+    if( !copied )
+    {
+      fprintf( stderr, "ripd: %s: error %d\n", path, reply.status );
+      return -1;
+    }
+
+    PaletteEntry palette[RIP_PALETTE_SIZE];
+    for( int32_t i = 0; i < reply.paletteSize; ++i )
+    {
+      palette[i] = { reply.palette[i * 3], reply.palette[i * 3 + 1], reply.palette[i * 3 + 2] };
+    }
+
+    std::vector<uint8_t> png;
+    if( !EncodePngIndexed( surface, palette, reply.paletteSize, png ) || !WriteFileBytes( pngName, png ) )
+    {
+      fprintf( stderr, "ripd: can't write %s\n", pngName );
+      return -1;
+    }
+
+    printf( "%s: %dx%d, %s\n", pngName, reply.width, reply.height, reply.cached != 0 ? "cached" : "decoded" );
+    return 0;
+  }
+} // namespace
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  const char* socketPath{ FindOption( argc, argv, "--socket", "tilerip.sock" ) };
+  const bool get{ FindOption( argc, argv, "--get", nullptr ) != nullptr };
+
+  if( get || HasOption( argc, argv, "--shutdown" ) )
+  {
+    RipClient client;
+    if( !client.Connect( socketPath ) )
+    {
+      fprintf( stderr, "ripd: no daemon on %s\n", socketPath );
+      return -1;
+    }
+
+    if( get )
+    {
+      return GetSheet( client, argc, argv );
+    }
+
+    return client.Shutdown() ? 0 : -1;
+  }
+
+  const int32_t cacheMegabytes{ FindNumber( argc, argv, "--cache-mb", 64 ) };
+  if( cacheMegabytes < 1 || cacheMegabytes > 4095 )
+  {
+    fprintf( stderr, "ripd: --cache-mb must be from 1 to 4095\n" );
+    return -1;
+  }
+
+  return RunDaemon( socketPath, static_cast<size_t>( cacheMegabytes ) << 20 );
+}
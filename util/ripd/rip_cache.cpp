@@ -0,0 +1,517 @@
+#include "rip_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#include <time.h>
+#endif
+
+#include "../tile_decode/surface.h"
+
+
+namespace
+{
+  inline size_t AlignUp( size_t value )
+  {
+    return ( value + RIP_SEGMENT_ALIGNMENT - 1 ) & ~static_cast<size_t>( RIP_SEGMENT_ALIGNMENT - 1 );
+  }
+
+
+#if defined( _WIN32 )
+  // FILETIME ticks, 100 ns each
+  const int64_t timestampWindow{ 2 * 10000000LL };
+
+  int64_t FromFileTime( const FILETIME& time )
+  {
+    return static_cast<int64_t>( ( static_cast<uint64_t>( time.dwHighDateTime ) << 32 ) | time.dwLowDateTime );
+  }
+
+
+  int64_t CurrentTime()
+  {
+    FILETIME now;
+    GetSystemTimeAsFileTime( &now );
+    return FromFileTime( now );
+  }
+
+
+  bool FileStatus( const std::string& path, uint64_t& size, int64_t& time )
+  {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if( !GetFileAttributesExA( path.c_str(), GetFileExInfoStandard, &data ) )
+    {
+      return false;
+    }
+
+    size = ( static_cast<uint64_t>( data.nFileSizeHigh ) << 32 ) | data.nFileSizeLow;
+    time = FromFileTime( data.ftLastWriteTime );
+    return true;
+  }
+#else
+  // Nanoseconds
+  const int64_t timestampWindow{ 2 * 1000000000LL };
+
+  int64_t FromTimespec( const timespec& time )
+  {
+    return static_cast<int64_t>( time.tv_sec ) * 1000000000LL + time.tv_nsec;
+  }
+
+
+  int64_t CurrentTime()
+  {
+    timespec now;
+    clock_gettime( CLOCK_REALTIME, &now );
+    return FromTimespec( now );
+  }
+
+
+  bool FileStatus( const std::string& path, uint64_t& size, int64_t& time )
+  {
+    struct stat status;
+    if( stat( path.c_str(), &status ) != 0 )
+    {
+      return false;
+    }
+
+    size = static_cast<uint64_t>( status.st_size );
+#if defined( __APPLE__ )
+    time = FromTimespec( status.st_mtimespec );
+#else
+    time = FromTimespec( status.st_mtim );
+#endif
+    return true;
+  }
+#endif
+
+
+  // 64-bit FNV-1a
+  uint64_t HashBytes( const std::vector<uint8_t>& bytes )
+  {
+    uint64_t hash{ 0xcbf29ce484222325ULL };
+    for( const uint8_t byte : bytes )
+    {
+      hash = ( hash ^ byte ) * 0x100000001b3ULL;
+    }
+
+    return hash;
+  }
+
+
+  // Everything that changes the decoded pixels: the file, and every request field but the tile
+  std::string CacheKey( const RipRequest& request, const std::string& path )
+  {
+    const int32_t fields[] = { request.decoder, request.compression,         request.startOdd,
+                               static_cast<int32_t>( request.offset ),      request.bytesPerRow,
+                               request.srcPitch, request.width,             request.rows,
+                               static_cast<int32_t>( request.colorsOffset ), request.colorsPitch };
+
+    std::string key( reinterpret_cast<const char*>( fields ), sizeof( fields ) );
+    key += path;
+    return key;
+  }
+
+
+  // The number of whole rows of rowBytes bytes, pitch apart, in size bytes
+  int64_t WholeRows( size_t size, int32_t pitch, int32_t rowBytes )
+  {
+    return size < static_cast<size_t>( rowBytes ) ? 0 : static_cast<int64_t>( ( size - rowBytes ) / pitch + 1 );
+  }
+
+
+  int32_t StatusFromDecoder( tilerip_status status )
+  {
+    return status == TILERIP_OK ? RIP_OK : status == TILERIP_ERROR_ARGUMENT ? RIP_ERROR_REQUEST : RIP_ERROR_DECODE;
+  }
+} // namespace
+
+
+RipCache::~RipCache()
+{
+  tilerip_lzw_destroy( m_lzw );
+}
+
+
+bool RipCache::Create( const char* segmentName, size_t size )
+{
+  if( size < AlignUp( sizeof( RipSegmentHeader ) ) * 2 || size > UINT32_MAX || !m_segment.Create( segmentName, size ) )
+  {
+    return false;
+  }
+
+  m_lzw = tilerip_lzw_create();
+  if( m_lzw == nullptr )
+  {
+    return false;
+  }
+
+  RipSegmentHeader* header{ Header() };
+  memcpy( header->magic, "URSM", 4 );
+  header->version = RIP_PROTOCOL_VERSION;
+  header->size = static_cast<uint32_t>( size );
+  header->generation = 1;
+
+  m_used = AlignUp( sizeof( RipSegmentHeader ) );
+  return true;
+}
+
+
+void RipCache::Serve( const RipRequest& request, const std::string& path, RipSheet& reply )
+{
+  memset( &reply, 0, sizeof( reply ) );
+  memcpy( reply.magic, "URSH", 4 );
+  reply.version = RIP_PROTOCOL_VERSION;
+
+  const std::string key{ CacheKey( request, path ) };
+  auto found = m_entries.find( key );
+
+  // Taken before the file is looked at, so that anything written to it later has a later timestamp
+  const int64_t now{ CurrentTime() };
+  uint64_t fileSize{ 0 };
+  int64_t fileTime{ 0 };
+  const bool exists{ FileStatus( path, fileSize, fileTime ) };
+
+  bool fresh{ exists && found != m_entries.end() && found->second.fileSize == fileSize &&
+              found->second.fileTime == fileTime };
+  bool read{ false };
+
+  if( fresh && fileTime + timestampWindow >= found->second.checkedTime )
+  {
+    read = ReadFileBytes( path.c_str(), m_file );
+    fresh = read && HashBytes( m_file ) == found->second.fileHash;
+    if( fresh )
+    {
+      found->second.checkedTime = now;
+    }
+  }
+
+  Entry entry;
+  if( fresh )
+  {
+    entry = found->second;
+    reply.cached = 1;
+    ++m_stats.hits;
+  }
+  else
+  {
+    ++m_stats.misses;
+
+    if( found != m_entries.end() )
+    {
+      Free( found->second.offset, static_cast<size_t>( found->second.width ) * found->second.height, true );
+      m_entries.erase( found );
+    }
+
+    if( !exists || ( !read && !ReadFileBytes( path.c_str(), m_file ) ) )
+    {
+      reply.status = RIP_ERROR_FILE;
+      return;
+    }
+
+    entry.fileSize = fileSize;
+    entry.fileTime = fileTime;
+    entry.fileHash = HashBytes( m_file );
+    entry.checkedTime = now;
+    reply.status = static_cast<int16_t>( Decode( request, entry ) );
+    if( reply.status != RIP_OK )
+    {
+      return;
+    }
+
+    m_entries[key] = entry;
+  }
+
+  reply.generation = Header()->generation;
+  reply.offset = entry.offset;
+  reply.width = entry.width;
+  reply.height = entry.height;
+  reply.pitch = entry.width;
+
+  // A tile is a band of rows of the sheet, read in place with the sheet's pitch
+  if( request.tile >= 0 )
+  {
+    if( request.tileHeight <= 0 || static_cast<int64_t>( request.tile + 1 ) * request.tileHeight > entry.height )
+    {
+      reply.status = RIP_ERROR_REQUEST;
+      return;
+    }
+
+    reply.offset += static_cast<uint32_t>( static_cast<int64_t>( request.tile ) * request.tileHeight * reply.pitch );
+    reply.height = request.tileHeight;
+  }
+
+  uint8_t rgb[RIP_PALETTE_SIZE * 3];
+  const int32_t paletteSize{ tilerip_palette( entry.palette, rgb, RIP_PALETTE_SIZE ) };
+  reply.paletteSize = static_cast<uint16_t>( paletteSize );
+  memcpy( reply.palette, rgb, static_cast<size_t>( paletteSize ) * 3 );
+}
+
+
+int32_t RipCache::Decode( const RipRequest& request, Entry& entry )
+{
+  // Compressed files are expanded into a buffer that's reused from one request to the next
+  const uint8_t* file{ m_file.data() };
+  size_t fileSize{ m_file.size() };
+
+  if( request.compression != RIP_COMPRESSION_NONE )
+  {
+    const bool variable{ request.compression == RIP_COMPRESSION_LZW_VARIABLE };
+    const tilerip_lzw_format format{ variable ? TILERIP_LZW_VARIABLE : TILERIP_LZW_U4 };
+    if( request.compression != RIP_COMPRESSION_LZW_U4 && !variable )
+    {
+      return RIP_ERROR_REQUEST;
+    }
+
+    size_t header{ 0 };
+    size_t expectedSize{ 0 };
+    if( variable && tilerip_lzw_read_header( file, fileSize, &expectedSize, &header ) != TILERIP_OK )
+    {
+      return RIP_ERROR_DECODE;
+    }
+
+    size_t size{ 0 };
+    if( tilerip_lzw_decompress( m_lzw, format, file + header, fileSize - header, nullptr, 0, &size ) != TILERIP_OK ||
+        ( variable && size != expectedSize ) )
+    {
+      return RIP_ERROR_DECODE;
+    }
+
+    m_expanded.resize( size );
+    if( tilerip_lzw_decompress( m_lzw, format, file + header, fileSize - header, m_expanded.data(), size, &size ) !=
+        TILERIP_OK )
+    {
+      return RIP_ERROR_DECODE;
+    }
+
+    file = m_expanded.data();
+    fileSize = size;
+  }
+
+  if( request.offset > fileSize || request.colorsOffset > fileSize )
+  {
+    return RIP_ERROR_DECODE;
+  }
+
+  const uint8_t* data{ file + request.offset };
+  const size_t size{ fileSize - request.offset };
+  const int32_t bytesPerRow{ request.bytesPerRow };
+  const int32_t srcPitch{ request.srcPitch > 0 ? request.srcPitch : bytesPerRow };
+
+  // The sheet's size, from the request and the amount of data
+  const int32_t maxBytesPerRow{ 4096 };
+  const bool rowsDecoder{ request.decoder == RIP_DECODE_EGA_PACKED || request.decoder == RIP_DECODE_APPLE_ROWS ||
+                          request.decoder == RIP_DECODE_C64_HIRES };
+  if( rowsDecoder && ( bytesPerRow <= 0 || bytesPerRow > maxBytesPerRow || srcPitch < bytesPerRow ) )
+  {
+    return RIP_ERROR_REQUEST;
+  }
+
+  int64_t width{ 0 };
+  int64_t height{ request.rows };
+  if( rowsDecoder && height < 0 )
+  {
+    height = WholeRows( size, srcPitch, bytesPerRow );
+  }
+
+  switch( request.decoder )
+  {
+    case RIP_DECODE_EGA_PACKED:
+      width = bytesPerRow * 2;
+      entry.palette = TILERIP_PALETTE_EGA;
+      break;
+
+    case RIP_DECODE_EGA_RLE:
+      width = request.width > 0 ? request.width : 320;
+      height = request.rows > 0 ? request.rows : 200;
+      entry.palette = TILERIP_PALETTE_EGA;
+      break;
+
+    case RIP_DECODE_APPLE_ROWS:
+      width = bytesPerRow * 7;
+      entry.palette = TILERIP_PALETTE_APPLE2;
+      break;
+
+    case RIP_DECODE_APPLE_SCREEN:
+      width = 280;
+      height = 192;
+      entry.palette = TILERIP_PALETTE_APPLE2;
+      break;
+
+    case RIP_DECODE_C64_HIRES:
+      width = bytesPerRow * 8;
+      entry.palette = TILERIP_PALETTE_C64;
+      break;
+
+    default:
+      return RIP_ERROR_REQUEST;
+  }
+
+  if( width <= 0 || width > 0x7fff || height <= 0 || height > 0x7fffff )
+  {
+    return RIP_ERROR_REQUEST;
+  }
+
+  const uint32_t offset{ Allocate( static_cast<size_t>( width * height ) ) };
+  if( offset == 0 )
+  {
+    return RIP_ERROR_SPACE;
+  }
+
+  const tilerip_image image{ m_segment.Data() + offset, static_cast<int32_t>( width ), static_cast<int32_t>( height ),
+                             static_cast<int32_t>( width ) };
+  tilerip_status status{ TILERIP_ERROR_ARGUMENT };
+
+  switch( request.decoder )
+  {
+    case RIP_DECODE_EGA_PACKED:
+      status = tilerip_decode_ega_packed( data, size, bytesPerRow, &image, nullptr );
+      break;
+
+    case RIP_DECODE_EGA_RLE:
+      status = tilerip_decode_ega_rle( data, size, &image );
+      break;
+
+    case RIP_DECODE_APPLE_ROWS:
+      status = tilerip_decode_apple_rows( data, size, bytesPerRow, srcPitch, request.startOdd, &image );
+      break;
+
+    case RIP_DECODE_APPLE_SCREEN:
+      status = tilerip_decode_apple_screen( data, size, &image );
+      break;
+
+    case RIP_DECODE_C64_HIRES:
+      status = tilerip_decode_c64_hires( data, size, srcPitch, file + request.colorsOffset,
+                                         fileSize - request.colorsOffset, request.colorsPitch, bytesPerRow, &image );
+      break;
+  }
+
+  // A failed decode gives its space back
+  if( status != TILERIP_OK )
+  {
+    Free( offset, static_cast<size_t>( width * height ), false );
+    return StatusFromDecoder( status );
+  }
+
+  entry.offset = offset;
+  entry.width = static_cast<int32_t>( width );
+  entry.height = static_cast<int32_t>( height );
+  return RIP_OK;
+}
+
+
+uint32_t RipCache::Allocate( size_t numBytes )
+{
+  const size_t first{ AlignUp( sizeof( RipSegmentHeader ) ) };
+  if( numBytes > m_segment.Size() - first )
+  {
+    return 0;
+  }
+
+  // The smallest freed block it fits in comes first, which is usually the one the same sheet had before it changed
+  auto best = m_free.end();
+  for( auto block = m_free.begin(); block != m_free.end(); ++block )
+  {
+    if( block->second.size >= numBytes && ( best == m_free.end() || block->second.size < best->second.size ) )
+    {
+      best = block;
+    }
+  }
+
+  if( best != m_free.end() )
+  {
+    const size_t offset{ best->first };
+    const FreeBlock block{ best->second };
+    m_free.erase( best );
+
+    const size_t used{ std::min( AlignUp( numBytes ), block.size ) };
+    if( used < block.size )
+    {
+      m_free.emplace( offset + used, FreeBlock{ block.size - used, block.generation } );
+    }
+
+    if( block.generation == Header()->generation )
+    {
+      NextGeneration();
+    }
+
+    return static_cast<uint32_t>( offset );
+  }
+
+  if( numBytes > m_segment.Size() - m_used )
+  {
+    Reset();
+  }
+
+  const size_t offset{ m_used };
+  m_used = AlignUp( m_used + numBytes );
+  if( m_used > m_segment.Size() )
+  {
+    m_used = m_segment.Size();
+  }
+
+  return static_cast<uint32_t>( offset );
+}
+
+
+void RipCache::Free( size_t offset, size_t numBytes, bool replied )
+{
+  size_t size{ std::min( AlignUp( numBytes ), m_segment.Size() - offset ) };
+
+  // Nothing has seen the space at the end of the segment yet, so it can go straight back
+  if( !replied && offset + size == m_used )
+  {
+    m_used = offset;
+    return;
+  }
+
+  // Generation 0 is never current, so space no reply has seen can be reused without moving the generation on
+  uint32_t generation{ replied ? Header()->generation : 0 };
+
+  // Merged with the blocks on either side
+  auto next = m_free.lower_bound( offset );
+  if( next != m_free.end() && next->first == offset + size )
+  {
+    size += next->second.size;
+    generation = std::max( generation, next->second.generation );
+    next = m_free.erase( next );
+  }
+
+  if( next != m_free.begin() )
+  {
+    auto previous = std::prev( next );
+    if( previous->first + previous->second.size == offset )
+    {
+      previous->second.size += size;
+      previous->second.generation = std::max( previous->second.generation, generation );
+      return;
+    }
+  }
+
+  m_free.emplace( offset, FreeBlock{ size, generation } );
+}
+
+
+void RipCache::Reset()
+{
+  m_entries.clear();
+  m_free.clear();
+  m_used = AlignUp( sizeof( RipSegmentHeader ) );
+  ++m_stats.resets;
+
+  NextGeneration();
+}
+
+
+void RipCache::NextGeneration()
+{
+  // Clients compare this with the generation of the replies they hold before and after they copy the pixels, so it
+  // has to change before any of the space is written again. It skips 0, which marks free space no reply has seen.
+  uint32_t generation{ Header()->generation + 1 };
+  Header()->generation = generation != 0 ? generation : 1;
+  std::atomic_thread_fence( std::memory_order_seq_cst );
+}
@@ -0,0 +1,108 @@
+// The rip daemon's decoded sheet cache, kept in the shared memory segment that clients read the pixels from.
+//
+// Sheets are decoded straight into the segment and looked up by file name and decoding parameters. A file whose size
+// or modification time (to the nanosecond, or 100 ns on Windows) has changed since it was decoded is decoded again.
+// Timestamps only move once per tick of the file system's clock, which can be as coarse as 2 seconds, so a file that
+// was written within that long of when the daemon read it could have been written again since without its timestamp
+// changing. Until the daemon has read it once after that window, a lookup also hashes the file and compares.
+//
+// The space of a sheet that's decoded again goes on a free list and is reused first, after the segment's generation
+// goes up if replies could still point into it. When a sheet fits neither there nor in what's left at the end of the
+// segment, the whole cache is dropped and the generation goes up, so the segment never needs compacting.
+
+#ifndef RIPD_RIP_CACHE_H
+#define RIPD_RIP_CACHE_H
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../tilerip/tilerip.h"
+#include "local_ipc.h"
+#include "rip_protocol.h"
+
+struct RipCacheStats
+{
+  int64_t hits{ 0 };
+  int64_t misses{ 0 };
+  int64_t resets{ 0 };
+};
+
+class RipCache
+{
+public:
+  RipCache() = default;
+  ~RipCache();
+
+  RipCache( const RipCache& ) = delete;
+  RipCache& operator=( const RipCache& ) = delete;
+
+  // Creates the segment. Returns false if it can't be created or the LZW dictionaries can't be allocated.
+  bool Create( const char* segmentName, size_t size );
+
+  const SharedMemory& Segment() const
+  {
+    return m_segment;
+  }
+
+  const RipCacheStats& Stats() const
+  {
+    return m_stats;
+  }
+
+  // Answers a RIP_SHEET request for the file at path, decoding it if it isn't cached
+  void Serve( const RipRequest& request, const std::string& path, RipSheet& reply );
+
+private:
+  struct Entry
+  {
+    uint32_t offset;
+    int32_t width;
+    int32_t height;
+    tilerip_palette_id palette;
+    uint64_t fileSize;
+    int64_t fileTime;
+    uint64_t fileHash;     // Of the bytes that were decoded
+    int64_t checkedTime;   // When the file was last read, just before
+  };
+
+  struct FreeBlock
+  {
+    size_t size;
+    uint32_t generation;   // Replies from this generation may still point into it
+  };
+
+  // Decodes m_file, which holds the file, into the segment and fills in entry. Returns a RipStatus.
+  int32_t Decode( const RipRequest& request, Entry& entry );
+
+  // Space for numBytes in the segment, dropping the cache if that's what it takes. Returns the offset, or 0 if it's
+  // bigger than the segment.
+  uint32_t Allocate( size_t numBytes );
+
+  // Gives the space of a sheet back. replied says whether any reply has pointed into it.
+  void Free( size_t offset, size_t numBytes, bool replied );
+
+  void Reset();
+
+  // Moves the segment's generation on, before space that replies may point into is written again
+  void NextGeneration();
+
+  RipSegmentHeader* Header() const
+  {
+    return reinterpret_cast<RipSegmentHeader*>( m_segment.Data() );
+  }
+
+  SharedMemory m_segment;
+  size_t m_used{ 0 };
+  std::map<size_t, FreeBlock> m_free;
+  std::unordered_map<std::string, Entry> m_entries;
+  RipCacheStats m_stats;
+
+  // Kept across requests so the files, the decompressed data and the LZW dictionaries are allocated once
+  tilerip_lzw* m_lzw{ nullptr };
+  std::vector<uint8_t> m_file;
+  std::vector<uint8_t> m_expanded;
+};
+
+#endif // RIPD_RIP_CACHE_H
@@ -0,0 +1,185 @@
+#include "rip_client.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if !defined( _WIN32 )
+#include <climits>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+  // path from the root, without resolving links or requiring that the file exists
+  bool AbsolutePath( const char* path, std::string& absolute )
+  {
+#if defined( _WIN32 )
+    char buffer[_MAX_PATH];
+    if( _fullpath( buffer, path, sizeof( buffer ) ) == nullptr )
+    {
+      return false;
+    }
+
+    absolute = buffer;
+#else
+    if( path[0] == '/' )
+    {
+      absolute = path;
+      return true;
+    }
+
+    char directory[PATH_MAX];
+    if( getcwd( directory, sizeof( directory ) ) == nullptr )
+    {
+      return false;
+    }
+
+    absolute = std::string( directory ) + "/" + path;
+#endif
+    return true;
+  }
+} // namespace
+
+
+
+RipRequest MakeRipRequest( RipDecoder decoder )
+{
+  RipRequest request;
+  memset( &request, 0, sizeof( request ) );
+  memcpy( request.magic, "URRQ", 4 );
+  request.version = RIP_PROTOCOL_VERSION;
+  request.command = RIP_SHEET;
+  request.decoder = static_cast<uint16_t>( decoder );
+  request.compression = RIP_COMPRESSION_NONE;
+  request.rows = -1;
+  request.tile = -1;
+  return request;
+}
+
+
+RipClient::~RipClient()
+{
+  Close();
+}
+
+
+bool RipClient::Connect( const char* socketPath )
+{
+  Close();
+  if( !InitLocalSockets() )
+  {
+    return false;
+  }
+
+  m_socket = ConnectLocal( socketPath );
+  if( m_socket == invalidLocalSocket )
+  {
+    return false;
+  }
+
+  RipRequest request{ MakeRipRequest( RIP_DECODE_EGA_PACKED ) };
+  request.command = RIP_HELLO;
+
+  if( !Exchange( request, "", &m_hello, sizeof( m_hello ) ) || memcmp( m_hello.magic, "URHI", 4 ) != 0 ||
+      m_hello.version != RIP_PROTOCOL_VERSION || m_hello.status != RIP_OK )
+  {
+    Close();
+    return false;
+  }
+
+  m_hello.segmentName[RIP_MAX_SEGMENT_NAME - 1] = '\0';
+  if( !m_segment.Open( m_hello.segmentName ) || m_segment.Size() < m_hello.segmentSize ||
+      m_segment.Size() < sizeof( RipSegmentHeader ) )
+  {
+    Close();
+    return false;
+  }
+
+  return true;
+}
+
+
+void RipClient::Close()
+{
+  if( m_socket != invalidLocalSocket )
+  {
+    CloseLocal( m_socket );
+    m_socket = invalidLocalSocket;
+  }
+
+  m_segment.Close();
+  memset( &m_hello, 0, sizeof( m_hello ) );
+}
+
+
+bool RipClient::Request( const RipRequest& request, const char* path, RipSheet& reply )
+{
+  std::string absolute;
+  return AbsolutePath( path, absolute ) && Exchange( request, absolute.c_str(), &reply, sizeof( reply ) ) &&
+         memcmp( reply.magic, "URSH", 4 ) == 0;
+}
+
+
+bool RipClient::CopyPixels( const RipSheet& reply, uint8_t* dest, int32_t destPitch ) const
+{
+  if( reply.status != RIP_OK || m_segment.Data() == nullptr || reply.height <= 0 || reply.width < 0 ||
+      reply.pitch < reply.width )
+  {
+    return false;
+  }
+
+  const size_t end{ reply.offset + static_cast<size_t>( reply.height - 1 ) * reply.pitch + reply.width };
+  if( end > m_segment.Size() )
+  {
+    return false;
+  }
+
+  // Like a seqlock: the daemon moves the generation on before it reuses any space, so pixels copied between two reads
+  // of the reply's generation can't have been overwritten
+  const RipSegmentHeader* header{ reinterpret_cast<const RipSegmentHeader*>( m_segment.Data() ) };
+  if( header->generation != reply.generation )
+  {
+    return false;
+  }
+
+  std::atomic_thread_fence( std::memory_order_acquire );
+
+  const uint8_t* pixels{ m_segment.Data() + reply.offset };
+  for( int32_t y = 0; y < reply.height; ++y )
+  {
+    memcpy( dest + static_cast<size_t>( y ) * destPitch, pixels + static_cast<size_t>( y ) * reply.pitch,
+            static_cast<size_t>( reply.width ) );
+  }
+
+  std::atomic_thread_fence( std::memory_order_acquire );
+  return header->generation == reply.generation;
+}
+
+
+bool RipClient::Shutdown()
+{
+  RipRequest request{ MakeRipRequest( RIP_DECODE_EGA_PACKED ) };
+  request.command = RIP_SHUTDOWN;
+
+  RipSheet reply;
+  return Exchange( request, "", &reply, sizeof( reply ) ) && reply.status == RIP_OK;
+}
+
+
+bool RipClient::Exchange( const RipRequest& request, const char* path, void* reply, size_t replySize )
+{
+  const size_t pathLength{ strlen( path ) };
+  if( m_socket == invalidLocalSocket || pathLength > RIP_MAX_PATH )
+  {
+    return false;
+  }
+
+  RipRequest sent{ request };
+  sent.pathLength = static_cast<uint16_t>( pathLength );
+
+  return SendAll( m_socket, &sent, sizeof( sent ) ) && SendAll( m_socket, path, pathLength ) &&
+         ReceiveAll( m_socket, reply, replySize );
+}
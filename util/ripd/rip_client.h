@@ -0,0 +1,52 @@
+// The client side of the rip daemon's protocol (rip_protocol.h), for tools that want decoded sheets without decoding
+// them. One RipClient holds one connection and the mapped segment; it isn't meant to be shared between threads.
+
+#ifndef RIPD_RIP_CLIENT_H
+#define RIPD_RIP_CLIENT_H
+
+#include "local_ipc.h"
+#include "rip_protocol.h"
+
+// A RIP_SHEET request for the whole sheet of an uncompressed file, for the caller to fill in the decoder and its fields
+RipRequest MakeRipRequest( RipDecoder decoder );
+
+class RipClient
+{
+public:
+  RipClient() = default;
+  ~RipClient();
+
+  RipClient( const RipClient& ) = delete;
+  RipClient& operator=( const RipClient& ) = delete;
+
+  // Connects to the daemon on socketPath and maps its segment. Returns false if there's no daemon or it speaks another
+  // version of the protocol.
+  bool Connect( const char* socketPath );
+
+  void Close();
+
+  // Sends a RIP_SHEET request for path, made absolute since the daemon has its own working directory. Returns false
+  // if the daemon has gone away; the decode's own status is in reply.
+  bool Request( const RipRequest& request, const char* path, RipSheet& reply );
+
+  // Copies the pixels of a successful reply to dest, rows destPitch bytes apart. Returns false if the daemon has
+  // reused their space, before the copy or during it, in which case dest holds nothing useful.
+  bool CopyPixels( const RipSheet& reply, uint8_t* dest, int32_t destPitch ) const;
+
+  // Asks the daemon to exit
+  bool Shutdown();
+
+  const RipHello& Hello() const
+  {
+    return m_hello;
+  }
+
+private:
+  bool Exchange( const RipRequest& request, const char* path, void* reply, size_t replySize );
+
+  LocalSocket m_socket{ invalidLocalSocket };
+  SharedMemory m_segment;
+  RipHello m_hello{};
+};
+
+#endif // RIPD_RIP_CLIENT_H
@@ -0,0 +1,116 @@
+// The rip daemon's protocol.
+//
+// Clients connect to the daemon's Unix domain socket and send requests, each a RipRequest followed by pathLength
+// bytes of file name. The name has to be absolute, since the daemon has its own working directory. Every request gets
+// one fixed-size reply. Pixels never go through the socket: the daemon decodes into a shared memory segment, which
+// clients map once (its name comes back from RIP_HELLO), and a RipSheet reply says where in it the pixels are.
+// Everything is little endian, as the daemon and its clients share a machine.
+//
+// The segment starts with a RipSegmentHeader and is a cache of decoded sheets. When it fills up the daemon empties it
+// and starts again, and bumps the segment's generation before it writes anything. A reply's pixels are good for as
+// long as the segment's generation is the one in the reply, so clients check it both before and after they copy the
+// pixels out, and ask again if it changed.
+
+#ifndef RIPD_RIP_PROTOCOL_H
+#define RIPD_RIP_PROTOCOL_H
+
+#include <cstdint>
+
+#define RIP_PROTOCOL_VERSION  1
+#define RIP_MAX_PATH          1024
+#define RIP_MAX_SEGMENT_NAME  64
+#define RIP_PALETTE_SIZE      16
+#define RIP_SEGMENT_ALIGNMENT 64
+
+enum RipCommand
+{
+  RIP_HELLO,    // Replies with a RipHello
+  RIP_SHEET,    // Decodes a file (or finds it in the cache) and replies with a RipSheet
+  RIP_SHUTDOWN  // Replies with a RipSheet holding only a status, then stops the daemon
+};
+
+// The tilerip.h decoder to run over the file
+enum RipDecoder
+{
+  RIP_DECODE_EGA_PACKED,    // bytesPerRow
+  RIP_DECODE_EGA_RLE,       // width, rows
+  RIP_DECODE_APPLE_ROWS,    // bytesPerRow, srcPitch, startOdd
+  RIP_DECODE_APPLE_SCREEN,
+  RIP_DECODE_C64_HIRES      // bytesPerRow, srcPitch, colorsOffset, colorsPitch
+};
+
+// How the file is stored, undone before decoding
+enum RipCompression
+{
+  RIP_COMPRESSION_NONE,
+  RIP_COMPRESSION_LZW_U4,
+  RIP_COMPRESSION_LZW_VARIABLE  // With its 4 byte size header
+};
+
+enum RipStatus
+{
+  RIP_OK = 0,
+  RIP_ERROR_REQUEST = -1,  // A malformed request or an unknown command
+  RIP_ERROR_FILE = -2,     // The file can't be read
+  RIP_ERROR_DECODE = -3,   // The decoder or decompressor refused the data
+  RIP_ERROR_SPACE = -4     // The sheet is bigger than the whole segment
+};
+
+struct RipRequest
+{
+  char magic[4];          // "URRQ"
+  uint16_t version;       // RIP_PROTOCOL_VERSION
+  uint16_t command;       // RipCommand
+  uint16_t decoder;       // RipDecoder
+  uint16_t compression;   // RipCompression
+  uint16_t pathLength;    // Bytes of file name after the request, at most RIP_MAX_PATH
+  uint16_t startOdd;      // Apple rows: the phase of the first pixel of each row
+  uint32_t offset;        // Where the pixel data starts in the (decompressed) file
+  int32_t bytesPerRow;
+  int32_t srcPitch;       // Bytes between rows of data, or 0 for bytesPerRow
+  int32_t width;          // EGA RLE only
+  int32_t rows;           // -1 for every whole row in the data (320x200 for EGA RLE)
+  uint32_t colorsOffset;  // C64: where the color bytes start in the (decompressed) file
+  int32_t colorsPitch;    // C64: bytes between rows of colors, 0 for the same colors on every row
+  int32_t tile;           // -1 for the whole sheet, otherwise a tile of the sheet read as a strip of tileHeight rows
+  int32_t tileHeight;
+};
+
+struct RipHello
+{
+  char magic[4];          // "URHI"
+  uint16_t version;
+  int16_t status;
+  uint32_t segmentSize;
+  uint32_t pid;
+  char segmentName[RIP_MAX_SEGMENT_NAME];  // Null terminated
+};
+
+struct RipSheet
+{
+  char magic[4];          // "URSH"
+  uint16_t version;
+  int16_t status;         // RipStatus
+  uint32_t generation;    // The segment generation the pixels belong to
+  uint32_t offset;        // Of the first pixel, from the start of the segment
+  int32_t width;
+  int32_t height;
+  int32_t pitch;
+  uint16_t paletteSize;
+  uint16_t cached;        // 1 if the sheet was already decoded
+  uint8_t palette[RIP_PALETTE_SIZE * 3];
+};
+
+struct RipSegmentHeader
+{
+  char magic[4];          // "URSM"
+  uint16_t version;
+  uint16_t reserved;
+  uint32_t size;
+  volatile uint32_t generation;
+};
+
+static_assert( sizeof( RipRequest ) == 52 && sizeof( RipHello ) == 80 && sizeof( RipSheet ) == 80 &&
+               sizeof( RipSegmentHeader ) == 16, "The protocol structs go over the socket as they are" );
+
+#endif // RIPD_RIP_PROTOCOL_H
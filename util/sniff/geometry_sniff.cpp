@@ -0,0 +1,702 @@
+#include "geometry_sniff.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../tile_decode/cga_decode.h"
+#include "../tile_decode/cpu_dispatch.h"
+#include "../tile_decode/ega_decode.h"
+#include "../tile_decode/parallel.h"
+
+
+namespace
+{
+  // Scores are kept per block, and windows start on block boundaries
+  const int32_t blockBytes{ 64 };
+
+  // A window with less of a second color than this is blank, however alike its rows are
+  const double minImpurity{ 0.05 };
+
+  // A region grows over neighbouring windows that score at least this much of its best one
+  const double regionFraction{ 0.5 };
+
+  // Windows where fewer rows than this differ from the next at all score less the fewer there are
+  const double minChangedRows{ 0.25 };
+
+  // Seams have to differ this much more (or less, for terrain drawn to tile seamlessly) often than the rest of the
+  // pixels to count as tile edges. One size has to beat a smaller one by the margin to win, and a multiple of it by
+  // the factor.
+  const double minSeamContrast{ 0.02 };
+  const double seamTieMargin{ 0.02 };
+  const double seamMultipleFactor{ 1.1 };
+
+  const int32_t tileWidths[] = { 7, 8, 12, 14, 16, 24, 28, 32 };
+  const int32_t tileHeights[] = { 8, 10, 12, 14, 16, 24, 32 };
+
+  const int32_t sheetTilesAcross{ 16 };
+
+
+  struct EncodingInfo
+  {
+    const char* name;
+    int32_t pixelsPerByte;
+    int32_t numColors;
+  };
+
+  const EncodingInfo encodings[NUM_SNIFF_ENCODINGS] = {
+    { "1bpp", 8, 2 }, { "apple", 7, 2 }, { "2bpp", 4, 4 }, { "4bpp", 2, 16 }, { "8bpp", 1, 256 }
+  };
+
+
+  PixelDifferenceTable MakeDifferenceTable( SniffEncoding encoding )
+  {
+    PixelDifferenceTable table;
+    table.cap = 8;
+
+    for( int32_t nibble = 0; nibble < 16; ++nibble )
+    {
+      const int32_t bits{ ( nibble & 1 ) + ( ( nibble >> 1 ) & 1 ) + ( ( nibble >> 2 ) & 1 ) + ( nibble >> 3 ) };
+      const int32_t pairs{ ( ( nibble & 3 ) != 0 ? 1 : 0 ) + ( ( nibble & 12 ) != 0 ? 1 : 0 ) };
+      const int32_t any{ nibble != 0 ? 1 : 0 };
+
+      switch( encoding )
+      {
+        case SNIFF_1BPP:
+          table.low[nibble] = static_cast<uint8_t>( bits );
+          table.high[nibble] = static_cast<uint8_t>( bits );
+          break;
+        case SNIFF_APPLE_HIRES:
+          table.low[nibble] = static_cast<uint8_t>( bits );
+          table.high[nibble] = static_cast<uint8_t>( bits - ( nibble >> 3 ) );
+          break;
+        case SNIFF_2BPP:
+          table.low[nibble] = static_cast<uint8_t>( pairs );
+          table.high[nibble] = static_cast<uint8_t>( pairs );
+          break;
+        case SNIFF_4BPP:
+          table.low[nibble] = static_cast<uint8_t>( any );
+          table.high[nibble] = static_cast<uint8_t>( any );
+          break;
+        default:
+          table.low[nibble] = static_cast<uint8_t>( any );
+          table.high[nibble] = static_cast<uint8_t>( any );
+          table.cap = 1;
+          break;
+      }
+    }
+
+    return table;
+  }
+
+
+  // Color counts and horizontal pixel differences of every block for one encoding, as running totals so that any run
+  // of blocks sums in constant time
+  struct EncodingStats
+  {
+    int32_t numColors{ 0 };
+    std::vector<int32_t> colorTotals;       // (numBlocks + 1) * numColors
+    std::vector<int64_t> differenceTotals;  // numBlocks + 1
+  };
+
+
+  void GatherStats( const uint8_t* data, size_t size, SniffEncoding encoding, int32_t numBlocks, EncodingStats& stats )
+  {
+    const int32_t pixelsPerByte{ encodings[encoding].pixelsPerByte };
+    const int32_t numColors{ encodings[encoding].numColors };
+
+    stats.numColors = numColors;
+    stats.colorTotals.assign( static_cast<size_t>( numBlocks + 1 ) * numColors, 0 );
+    stats.differenceTotals.assign( static_cast<size_t>( numBlocks ) + 1, 0 );
+
+    std::vector<uint8_t> pixels( static_cast<size_t>( blockBytes + 1 ) * pixelsPerByte );
+
+    for( int32_t block = 0; block < numBlocks; ++block )
+    {
+      const size_t start{ static_cast<size_t>( block ) * blockBytes };
+      const int32_t numBytes{ static_cast<int32_t>( std::min<size_t>( blockBytes + 1, size - start ) ) };
+      ExpandSniffPixels( encoding, data + start, numBytes, pixels.data() );
+
+      const int32_t* previous{ &stats.colorTotals[static_cast<size_t>( block ) * numColors] };
+      int32_t* totals{ &stats.colorTotals[static_cast<size_t>( block + 1 ) * numColors] };
+      memcpy( totals, previous, sizeof( int32_t ) * numColors );
+
+      // The block's own pixels, each against the next one (the first pixel of the next block for the last of them)
+      const int32_t numPixels{ blockBytes * pixelsPerByte };
+      const int32_t numPairs{ std::min( numPixels, numBytes * pixelsPerByte - 1 ) };
+      int64_t differences{ 0 };
+      for( int32_t i = 0; i < numPixels; ++i )
+      {
+        ++totals[pixels[i]];
+        differences += i < numPairs && pixels[i] != pixels[i + 1] ? 1 : 0;
+      }
+
+      stats.differenceTotals[block + 1] = stats.differenceTotals[block] + differences;
+    }
+  }
+
+
+  // 1 - sum of squared color shares: how often two pixels picked at random differ
+  double Impurity( const EncodingStats& stats, int32_t firstBlock, int32_t endBlock, double& entropy )
+  {
+    const int32_t* first{ &stats.colorTotals[static_cast<size_t>( firstBlock ) * stats.numColors] };
+    const int32_t* end{ &stats.colorTotals[static_cast<size_t>( endBlock ) * stats.numColors] };
+
+    double total{ 0.0 };
+    for( int32_t color = 0; color < stats.numColors; ++color )
+    {
+      total += end[color] - first[color];
+    }
+
+    double sumOfSquares{ 0.0 };
+    entropy = 0.0;
+    for( int32_t color = 0; color < stats.numColors && total > 0.0; ++color )
+    {
+      const double share{ ( end[color] - first[color] ) / total };
+      sumOfSquares += share * share;
+      entropy -= share > 0.0 ? share * log2( share ) : 0.0;
+    }
+
+    return 1.0 - sumOfSquares;
+  }
+
+
+  // What each window of one encoding looks like without regard to the stride
+  struct WindowStats
+  {
+    std::vector<double> impurities;
+    std::vector<double> entropies;
+    std::vector<double> horizontal;  // How much more alike neighbouring pixels are than random ones
+  };
+
+
+  // A run of windows with the same encoding and stride that all look like graphics
+  struct Region
+  {
+    SniffEncoding encoding;
+    int32_t stride;
+    size_t start;
+    size_t end;
+    double score;
+    double entropy;
+  };
+
+
+  // The best window, grown over its neighbours, then the best window left, and so on
+  void FindRegions( const std::vector<double>& scores, SniffEncoding encoding, int32_t stride, size_t size,
+                    int32_t windowBlocks, int32_t maxRegions, const WindowStats& stats, std::vector<Region>& regions )
+  {
+    const int32_t numWindows{ static_cast<int32_t>( scores.size() ) };
+    std::vector<bool> taken( scores.size(), false );
+
+    for( int32_t i = 0; i < maxRegions; ++i )
+    {
+      int32_t best{ -1 };
+      for( int32_t window = 0; window < numWindows; ++window )
+      {
+        if( !taken[window] && scores[window] > 0.0 && ( best < 0 || scores[window] > scores[best] ) )
+        {
+          best = window;
+        }
+      }
+
+      if( best < 0 )
+      {
+        break;
+      }
+
+      const double threshold{ scores[best] * regionFraction };
+      int32_t first{ best };
+      int32_t last{ best };
+      while( first > 0 && !taken[first - 1] && scores[first - 1] >= threshold )
+      {
+        --first;
+      }
+
+      while( last + 1 < numWindows && !taken[last + 1] && scores[last + 1] >= threshold )
+      {
+        ++last;
+      }
+
+      for( int32_t window = first; window <= last; ++window )
+      {
+        taken[window] = true;
+      }
+
+      const size_t start{ static_cast<size_t>( first ) * blockBytes };
+      const size_t end{ std::min( size, static_cast<size_t>( last + windowBlocks ) * blockBytes ) };
+      regions.push_back( { encoding, stride, start, end, scores[best], stats.entropies[best] } );
+    }
+  }
+
+
+  // Differences between every pixel and the one stride bytes on, as running totals of blocks
+  void CountRowDifferences( const uint8_t* data, size_t size, int32_t stride, const PixelDifferenceTable& table,
+                            std::vector<int64_t>& totals )
+  {
+    const DecodeKernels& kernels{ Kernels() };
+    const int32_t numBlocks{ static_cast<int32_t>( totals.size() ) - 1 };
+
+    for( int32_t block = 0; block < numBlocks; ++block )
+    {
+      const size_t start{ static_cast<size_t>( block ) * blockBytes };
+      const size_t available{ start + stride < size ? size - start - stride : 0 };
+      const int32_t count{ static_cast<int32_t>( std::min<size_t>( blockBytes, available ) ) };
+      totals[block + 1] = totals[block] + kernels.countPixelDifferences( data + start, data + start + stride, count,
+                                                                          table );
+    }
+  }
+
+
+  // Scores every window with one stride, in every encoding, and returns the best regions of each.
+  //
+  // Pixels a row apart match more often than pixels a row and a byte apart, so a stride that's right scores higher than
+  // its neighbours, while horizontal patterns, fills and noise score the same at every stride. A window's score is
+  // how far its stride stands out from the ones a byte either side, times how alike its neighbouring pixels are, which
+  // is what tells the encodings apart.
+  void ScoreStride( const uint8_t* data, size_t size, int32_t stride, int32_t windowBlocks, int32_t maxRegions,
+                    const WindowStats* windowStats, std::vector<Region>& regions )
+  {
+    const int32_t numBlocks{ static_cast<int32_t>( size / blockBytes ) };
+    const int32_t numWindows{ numBlocks - windowBlocks + 1 };
+
+    // Whole bytes that repeat a row on. Rows that are nearly all copies are fill patterns or duplicated sectors, not
+    // pictures.
+    std::vector<int64_t> byteTotals( static_cast<size_t>( numBlocks ) + 1, 0 );
+    CountRowDifferences( data, size, stride, MakeDifferenceTable( SNIFF_8BPP ), byteTotals );
+
+    std::vector<int64_t> differenceTotals[3];
+    for( std::vector<int64_t>& totals : differenceTotals )
+    {
+      totals.assign( static_cast<size_t>( numBlocks ) + 1, 0 );
+    }
+
+    std::vector<double> scores( static_cast<size_t>( numWindows ) );
+
+    for( int32_t encoding = 0; encoding < NUM_SNIFF_ENCODINGS; ++encoding )
+    {
+      const WindowStats& stats{ windowStats[encoding] };
+      const int32_t pixelsPerByte{ encodings[encoding].pixelsPerByte };
+      const PixelDifferenceTable table{ MakeDifferenceTable( static_cast<SniffEncoding>( encoding ) ) };
+
+      // The stride itself, then the ones either side of it (a stride of 0 has nothing to compare)
+      for( int32_t i = 0; i < 3; ++i )
+      {
+        const int32_t neighbour{ stride + ( i == 0 ? 0 : i == 1 ? -1 : 1 ) };
+        if( neighbour > 0 )
+        {
+          CountRowDifferences( data, size, neighbour, table, differenceTotals[i] );
+        }
+      }
+
+      for( int32_t window = 0; window < numWindows; ++window )
+      {
+        const size_t start{ static_cast<size_t>( window ) * blockBytes };
+        const size_t end{ start + static_cast<size_t>( windowBlocks ) * blockBytes };
+        const double impurity{ stats.impurities[window] };
+
+        scores[window] = 0.0;
+        if( start + stride + 1 >= size || impurity < minImpurity )
+        {
+          continue;
+        }
+
+        // Pixels near the end of the data have nothing a row on to compare with
+        double coherence[3];
+        for( int32_t i = 0; i < 3; ++i )
+        {
+          const size_t pairsEnd{ std::min( end, size - stride - ( i == 2 ? 1 : 0 ) ) };
+          const double differences{ static_cast<double>( differenceTotals[i][window + windowBlocks] -
+                                                         differenceTotals[i][window] ) };
+          coherence[i] = 1.0 - differences / ( static_cast<double>( pairsEnd - start ) * pixelsPerByte ) / impurity;
+        }
+
+        const double neighbours{ stride > 1 ? std::max( coherence[1], coherence[2] ) : coherence[2] };
+        const double changedBytes{ static_cast<double>( byteTotals[window + windowBlocks] - byteTotals[window] ) };
+        const double repeats{ std::min( 1.0, changedBytes / ( end - start ) / minChangedRows ) };
+        scores[window] = std::max( 0.0, coherence[0] - neighbours ) * stats.horizontal[window] * repeats;
+      }
+
+      FindRegions( scores, static_cast<SniffEncoding>( encoding ), stride, size, windowBlocks, maxRegions, stats,
+                   regions );
+    }
+  }
+
+
+  // True if the regions share more than half the shorter one
+  bool Overlap( const Region& a, const Region& b )
+  {
+    const size_t overlapStart{ std::max( a.start, b.start ) };
+    const size_t overlapEnd{ std::min( a.end, b.end ) };
+    const size_t shorter{ std::min( a.end - a.start, b.end - b.start ) };
+    return overlapEnd > overlapStart && ( overlapEnd - overlapStart ) * 2 > shorter;
+  }
+
+
+  // Pixels that differ from their neighbours, and the pairs of neighbours that count: the ones that aren't both the
+  // background color, since tiles drawn on a plain background match each other along their edges
+  struct Seams
+  {
+    std::vector<int64_t> differences;
+    std::vector<int64_t> pairs;
+  };
+
+
+  // How much more or less often pixels differ across the seams before every period'th entry, from the best phase, than
+  // anywhere else. Entry i counts the differences between i and i + 1.
+  double SeamContrast( const Seams& seams, int32_t period, int32_t phaseStep, int32_t& phase )
+  {
+    double bestContrast{ 0.0 };
+    phase = 0;
+
+    for( int32_t candidate = 0; candidate < period; candidate += phaseStep )
+    {
+      int64_t seamDifferences{ 0 };
+      int64_t seamPairs{ 0 };
+      int64_t restDifferences{ 0 };
+      int64_t restPairs{ 0 };
+
+      for( size_t i = 0; i < seams.differences.size(); ++i )
+      {
+        if( ( static_cast<int32_t>( i % period ) + 1 ) % period == candidate )
+        {
+          seamDifferences += seams.differences[i];
+          seamPairs += seams.pairs[i];
+        }
+        else
+        {
+          restDifferences += seams.differences[i];
+          restPairs += seams.pairs[i];
+        }
+      }
+
+      if( seamPairs == 0 || restPairs == 0 )
+      {
+        continue;
+      }
+
+      const double contrast{ std::fabs( static_cast<double>( seamDifferences ) / seamPairs -
+                                        static_cast<double>( restDifferences ) / restPairs ) };
+      if( contrast > bestContrast )
+      {
+        bestContrast = contrast;
+        phase = candidate;
+      }
+    }
+
+    return bestContrast;
+  }
+
+
+  // Picks the tile size (of the ones that fit) and phase with the seams that stand out the most. Multiples of the real
+  // size have the same seams, just fewer of them, so a near tie goes to the smaller size. Leaves size and phase alone
+  // if no seams stand out.
+  template<size_t numSizes, typename Fits>
+  void FindSeams( const Seams& seams, const int32_t ( &sizes )[numSizes], int32_t phaseStep, Fits&& fits,
+                  int32_t& size, int32_t& phase )
+  {
+    double bestContrast{ minSeamContrast };
+    for( const int32_t candidate : sizes )
+    {
+      int32_t candidatePhase;
+      const double contrast{ fits( candidate ) ? SeamContrast( seams, candidate, phaseStep, candidatePhase ) : 0.0 };
+      const bool multiple{ size != 0 && candidate % size == 0 && bestContrast > minSeamContrast };
+      if( multiple ? contrast > bestContrast * seamMultipleFactor : contrast > bestContrast + seamTieMargin )
+      {
+        bestContrast = contrast;
+        size = candidate;
+        phase = candidatePhase;
+      }
+    }
+  }
+
+
+  // Works out the tile size and the first whole tile of a region from where its rows and columns stop matching
+  void FindTiles( const uint8_t* data, const Region& region, SniffCandidate& candidate )
+  {
+    const int32_t pixelsPerByte{ encodings[region.encoding].pixelsPerByte };
+    const int32_t stride{ region.stride };
+    const int32_t rowPixels{ stride * pixelsPerByte };
+    const int32_t numRows{ static_cast<int32_t>( ( region.end - region.start ) / stride ) };
+
+    std::vector<uint8_t> pixels( static_cast<size_t>( numRows ) * rowPixels );
+    ExpandSniffPixels( region.encoding, data + region.start, numRows * stride, pixels.data() );
+
+    uint8_t background{ 0 };
+    std::vector<int32_t> colorCounts( static_cast<size_t>( encodings[region.encoding].numColors ), 0 );
+    for( const uint8_t pixel : pixels )
+    {
+      background = ++colorCounts[pixel] > colorCounts[background] ? pixel : background;
+    }
+
+    // Row y against row y + 1, and column x against the pixel after it (the next row's first for the last column)
+    Seams rows;
+    Seams columns;
+    rows.differences.assign( static_cast<size_t>( numRows > 1 ? numRows - 1 : 0 ), 0 );
+    rows.pairs.assign( rows.differences.size(), 0 );
+    columns.differences.assign( static_cast<size_t>( rowPixels ), 0 );
+    columns.pairs.assign( columns.differences.size(), 0 );
+
+    const size_t numPixels{ pixels.size() };
+    for( size_t i = 0; i + 1 < numPixels; ++i )
+    {
+      const uint8_t pixel{ pixels[i] };
+      const uint8_t right{ pixels[i + 1] };
+      columns.differences[i % rowPixels] += pixel != right ? 1 : 0;
+      columns.pairs[i % rowPixels] += pixel != background || right != background ? 1 : 0;
+
+      if( i + rowPixels < numPixels )
+      {
+        const uint8_t below{ pixels[i + rowPixels] };
+        rows.differences[i / rowPixels] += pixel != below ? 1 : 0;
+        rows.pairs[i / rowPixels] += pixel != background || below != background ? 1 : 0;
+      }
+    }
+
+    int32_t tileHeight{ std::min( numRows, 8 ) };
+    int32_t rowPhase{ 0 };
+    FindSeams( rows, tileHeights, 1, [&]( int32_t height )
+    {
+      return height * 2 <= numRows;
+    }, tileHeight, rowPhase );
+
+    // With no seams across the rows, the rows are the tiles
+    int32_t tileWidth{ rowPixels };
+    int32_t columnPhase{ 0 };
+    FindSeams( columns, tileWidths, pixelsPerByte, [&]( int32_t width )
+    {
+      return width <= rowPixels && rowPixels % width == 0 && width % pixelsPerByte == 0;
+    }, tileWidth, columnPhase );
+
+    // A tile as wide as the row starts where the row does
+    columnPhase = tileWidth == rowPixels ? 0 : columnPhase;
+
+    candidate.encoding = region.encoding;
+    candidate.offset = region.start + static_cast<size_t>( rowPhase ) * stride + columnPhase / pixelsPerByte;
+    candidate.length = region.end - candidate.offset;
+    candidate.stride = stride;
+    candidate.tileWidth = tileWidth;
+    candidate.tileHeight = tileHeight;
+    candidate.tilesPerRow = rowPixels / tileWidth;
+    candidate.numTiles = static_cast<int32_t>( candidate.length / ( static_cast<size_t>( stride ) * tileHeight ) ) *
+                         candidate.tilesPerRow;
+    candidate.score = static_cast<float>( region.score );
+    candidate.entropy = static_cast<float>( region.entropy );
+  }
+} // namespace
+
+
+const char* SniffEncodingName( SniffEncoding encoding )
+{
+  return encoding >= 0 && encoding < NUM_SNIFF_ENCODINGS ? encodings[encoding].name : "unknown";
+}
+
+
+int32_t SniffPixelsPerByte( SniffEncoding encoding )
+{
+  return encodings[encoding].pixelsPerByte;
+}
+
+
+void ExpandSniffPixels( SniffEncoding encoding, const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  switch( encoding )
+  {
+    case SNIFF_1BPP:
+      for( int32_t i = 0; i < count; ++i )
+      {
+        for( int32_t bit = 0; bit < 8; ++bit )
+        {
+          *dest++ = static_cast<uint8_t>( ( src[i] >> ( 7 - bit ) ) & 1 );
+        }
+      }
+      break;
+    case SNIFF_APPLE_HIRES:
+      for( int32_t i = 0; i < count; ++i )
+      {
+        for( int32_t bit = 0; bit < 7; ++bit )
+        {
+          *dest++ = static_cast<uint8_t>( ( src[i] >> bit ) & 1 );
+        }
+      }
+      break;
+    case SNIFF_2BPP:
+      Kernels().expand2bpp( src, count, dest );
+      break;
+    case SNIFF_4BPP:
+      Kernels().expandNibbles( src, count, dest );
+      break;
+    default:
+      memcpy( dest, src, static_cast<size_t>( count ) );
+      break;
+  }
+}
+
+
+void SniffGeometry( const uint8_t* data, size_t size, const SniffOptions& options,
+                    std::vector<SniffCandidate>& candidates )
+{
+  INSTRUMENT_SCOPE( "sniff" );
+
+  candidates.clear();
+
+  const int32_t numBlocks{ static_cast<int32_t>( size / blockBytes ) };
+  const int32_t windowBlocks{ std::min( std::max( options.windowBytes / blockBytes, 4 ), numBlocks ) };
+  const int32_t maxStride{ std::min( options.maxStride, windowBlocks * blockBytes / 4 ) };
+  if( windowBlocks < 4 || maxStride < 1 || options.numResults < 1 )
+  {
+    return;
+  }
+
+  const int32_t numWindows{ numBlocks - windowBlocks + 1 };
+
+  // Colors and horizontal differences don't depend on the stride, so each encoding gathers them once
+  WindowStats windowStats[NUM_SNIFF_ENCODINGS];
+  ParallelFor( NUM_SNIFF_ENCODINGS, options.numThreads, [&]( int32_t encoding )
+  {
+    EncodingStats stats;
+    GatherStats( data, size, static_cast<SniffEncoding>( encoding ), numBlocks, stats );
+
+    const double windowPixels{ static_cast<double>( windowBlocks ) * blockBytes * encodings[encoding].pixelsPerByte };
+    WindowStats& window{ windowStats[encoding] };
+    window.impurities.resize( static_cast<size_t>( numWindows ) );
+    window.entropies.resize( static_cast<size_t>( numWindows ) );
+    window.horizontal.resize( static_cast<size_t>( numWindows ) );
+    for( int32_t i = 0; i < numWindows; ++i )
+    {
+      const double impurity{ Impurity( stats, i, i + windowBlocks, window.entropies[i] ) };
+      const double differences{ static_cast<double>( stats.differenceTotals[i + windowBlocks] -
+                                                     stats.differenceTotals[i] ) };
+      window.impurities[i] = impurity;
+      window.horizontal[i] = impurity > 0.0 ? std::max( 0.0, 1.0 - differences / windowPixels / impurity ) : 0.0;
+    }
+  } );
+
+  // Every stride on its own
+  const int32_t regionsPerStride{ options.numResults * 2 };
+  std::vector<std::vector<Region>> strideRegions( static_cast<size_t>( maxStride ) );
+  ParallelFor( maxStride, options.numThreads, [&]( int32_t item )
+  {
+    ScoreStride( data, size, item + 1, windowBlocks, regionsPerStride, windowStats, strideRegions[item] );
+  } );
+
+  std::vector<Region> regions;
+  for( const std::vector<Region>& stride : strideRegions )
+  {
+    regions.insert( regions.end(), stride.begin(), stride.end() );
+  }
+
+  std::stable_sort( regions.begin(), regions.end(), []( const Region& a, const Region& b )
+  {
+    return a.score > b.score;
+  } );
+
+  // The best region for a stretch of bytes hides the other encodings and strides that found it too
+  std::vector<Region> accepted;
+  for( const Region& region : regions )
+  {
+    bool overlaps{ false };
+    for( const Region& better : accepted )
+    {
+      overlaps |= Overlap( region, better );
+    }
+
+    if( !overlaps )
+    {
+      accepted.push_back( region );
+      if( static_cast<int32_t>( accepted.size() ) == options.numResults )
+      {
+        break;
+      }
+    }
+  }
+
+  candidates.resize( accepted.size() );
+  ParallelFor( static_cast<int32_t>( accepted.size() ), options.numThreads, [&]( int32_t i )
+  {
+    FindTiles( data, accepted[i], candidates[i] );
+  } );
+}
+
+
+int32_t SniffPalette( SniffEncoding encoding, PaletteEntry palette[256] )
+{
+  const PaletteEntry gap{ 96, 0, 96 };
+
+  switch( encoding )
+  {
+    case SNIFF_2BPP:
+      memcpy( palette, cgaPalette, sizeof( PaletteEntry ) * 4 );
+      palette[4] = gap;
+      return 5;
+    case SNIFF_4BPP:
+      memcpy( palette, egaPalette, sizeof( PaletteEntry ) * 16 );
+      palette[16] = gap;
+      return 17;
+    case SNIFF_8BPP:
+      for( int32_t i = 0; i < 255; ++i )
+      {
+        palette[i] = { static_cast<uint8_t>( i ), static_cast<uint8_t>( i ), static_cast<uint8_t>( i ) };
+      }
+
+      palette[255] = gap;
+      return 256;
+    default:
+      palette[0] = { 0, 0, 0 };
+      palette[1] = { 255, 255, 255 };
+      palette[2] = gap;
+      return 3;
+  }
+}
+
+
+void DrawSniffContactSheet( const uint8_t* data, size_t size, const SniffCandidate& candidate, int32_t maxTiles,
+                            IndexSurface& sheet )
+{
+  PaletteEntry palette[256];
+  const uint8_t gap{ static_cast<uint8_t>( SniffPalette( candidate.encoding, palette ) - 1 ) };
+  const int32_t pixelsPerByte{ SniffPixelsPerByte( candidate.encoding ) };
+  const int32_t tileBytes{ candidate.tileWidth / pixelsPerByte };
+
+  const int32_t numTiles{ std::max( 1, std::min( candidate.numTiles, maxTiles ) ) };
+  const int32_t across{ std::min( numTiles, sheetTilesAcross ) };
+  const int32_t down{ ( numTiles + across - 1 ) / across };
+  sheet.Create( across * ( candidate.tileWidth + 1 ) + 1, down * ( candidate.tileHeight + 1 ) + 1, gap );
+
+  for( int32_t tile = 0; tile < numTiles; ++tile )
+  {
+    const int32_t tileRow{ tile / candidate.tilesPerRow };
+    const int32_t tileColumn{ tile % candidate.tilesPerRow };
+    const int32_t x{ ( tile % across ) * ( candidate.tileWidth + 1 ) + 1 };
+    const int32_t y{ ( tile / across ) * ( candidate.tileHeight + 1 ) + 1 };
+
+    for( int32_t line = 0; line < candidate.tileHeight; ++line )
+    {
+      const size_t start{ candidate.offset +
+                          ( static_cast<size_t>( tileRow ) * candidate.tileHeight + line ) * candidate.stride +
+                          static_cast<size_t>( tileColumn ) * tileBytes };
+      if( start + tileBytes <= size )
+      {
+        ExpandSniffPixels( candidate.encoding, data + start, tileBytes, sheet.Row( y + line ) + x );
+      }
+    }
+  }
+
+  // 8bpp pixels of 255 would look like the gap
+  if( candidate.encoding == SNIFF_8BPP )
+  {
+    for( int32_t tile = 0; tile < numTiles; ++tile )
+    {
+      const int32_t x{ ( tile % across ) * ( candidate.tileWidth + 1 ) + 1 };
+      const int32_t y{ ( tile / across ) * ( candidate.tileHeight + 1 ) + 1 };
+      for( int32_t line = 0; line < candidate.tileHeight; ++line )
+      {
+        uint8_t* row{ sheet.Row( y + line ) + x };
+        for( int32_t i = 0; i < candidate.tileWidth; ++i )
+        {
+          row[i] = row[i] == gap ? static_cast<uint8_t>( gap - 1 ) : row[i];
+        }
+      }
+    }
+  }
+}
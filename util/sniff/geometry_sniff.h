@@ -0,0 +1,69 @@
+// Finds tile graphics in unknown binaries and disk images by brute force, for locating them in a new game version.
+//
+// Every offset, pixel format and row stride is scored by how much each row of pixels looks like the one below it,
+// measured against how often two random pixels of the same colors would match (so empty space and noise both score
+// near 0). The best regions are then split into tiles where the rows and columns stop matching their neighbours, which
+// gives the tile size and the offset of the first whole tile.
+
+#ifndef SNIFF_GEOMETRY_SNIFF_H
+#define SNIFF_GEOMETRY_SNIFF_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../tile_decode/surface.h"
+
+enum SniffEncoding
+{
+  SNIFF_1BPP,        // 8 pixels a byte, high bit first (C64 hires, CGA and Hercules monochrome)
+  SNIFF_APPLE_HIRES, // 7 pixels a byte, low bit first, the high bit ignored (Apple II hi-res, without its colors)
+  SNIFF_2BPP,        // 4 pixels a byte, high bits first (CGA)
+  SNIFF_4BPP,        // 2 pixels a byte, high nibble first (EGA packed)
+  SNIFF_8BPP,        // 1 pixel a byte (VGA)
+  NUM_SNIFF_ENCODINGS
+};
+
+const char* SniffEncodingName( SniffEncoding encoding );
+
+int32_t SniffPixelsPerByte( SniffEncoding encoding );
+
+// Expands count bytes into count * SniffPixelsPerByte() palette indices
+void ExpandSniffPixels( SniffEncoding encoding, const uint8_t* src, int32_t count, uint8_t* dest );
+
+struct SniffOptions
+{
+  int32_t maxStride{ 256 };     // Longest row stride tried, in bytes. Capped at a quarter of the window.
+  int32_t windowBytes{ 2048 };  // How much of the data each score looks at (rounded down to 64 bytes)
+  int32_t numResults{ 8 };
+  int32_t numThreads{ 0 };      // 0 for one per core
+};
+
+struct SniffCandidate
+{
+  SniffEncoding encoding;
+  size_t offset;        // The first byte of the first whole tile
+  size_t length;        // Bytes from offset to the end of the region that looks like graphics
+  int32_t stride;       // Bytes from one row of pixels to the next
+  int32_t tileWidth;    // In pixels
+  int32_t tileHeight;
+  int32_t tilesPerRow;  // Tiles side by side in stride bytes: 1 for tiles stored one after another
+  int32_t numTiles;     // Whole tiles in the region
+  float score;          // How alike neighbouring rows are, from 0 (noise or blank) to 1 (every row the same)
+  float entropy;        // Bits per pixel of the region's colors
+};
+
+// Scores every offset, encoding and stride up to options.maxStride on all cores, and returns the best
+// options.numResults regions that don't overlap, best first.
+void SniffGeometry( const uint8_t* data, size_t size, const SniffOptions& options,
+                    std::vector<SniffCandidate>& candidates );
+
+// The palette that contact sheets of an encoding use: gray levels for 8bpp, the EGA or CGA colors, or black and white.
+// The entry after the encoding's colors (255 for 8bpp) is the gap between tiles. Returns the number of entries.
+int32_t SniffPalette( SniffEncoding encoding, PaletteEntry palette[256] );
+
+// Draws up to maxTiles of a candidate's tiles, 16 to a row and a pixel apart, for a quick look at whether it's right
+void DrawSniffContactSheet( const uint8_t* data, size_t size, const SniffCandidate& candidate, int32_t maxTiles,
+                            IndexSurface& sheet );
+
+#endif // SNIFF_GEOMETRY_SNIFF_H
@@ -0,0 +1,122 @@
+// sniff: looks for tile graphics in a file whose layout isn't known yet, such as a new disk image or game version.
+//
+//   sniff FILE [--top N] [--max-stride N] [--window N] [--threads N] [--sheets PREFIX] [--sheet-tiles N]
+//              [--force-isa scalar|sse2|ssse3|avx2|avx512]
+//
+// Prints the best candidates (offset, pixel format, row stride and tile size) and writes a contact sheet of each
+// one's tiles to PREFIX_1.png, PREFIX_2.png and so on (sniff_1.png... by default), so the right one can be picked at
+// a glance and its numbers put in a ripper.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../png/png_writer.h"
+#include "../tile_decode/cpu_dispatch.h"
+#include "../tile_decode/mapped_file.h"
+#include "geometry_sniff.h"
+
+
+namespace
+{
+  const char* FindOption( int32_t argc, char* argv[], const char* option, const char* fallback )
+  {
+    for( int32_t i = 1; i + 1 < argc; ++i )
+    {
+      if( strcmp( argv[i], option ) == 0 )
+      {
+        return argv[i + 1];
+      }
+    }
+
+    return fallback;
+  }
+
+
+  int32_t FindNumber( int32_t argc, char* argv[], const char* option, int32_t fallback )
+  {
+    const char* value{ FindOption( argc, argv, option, nullptr ) };
+    return value != nullptr ? static_cast<int32_t>( strtol( value, nullptr, 0 ) ) : fallback;
+  }
+
+
+  bool WriteContactSheet( const char* filename, const MappedFile& file, const SniffCandidate& candidate,
+                          int32_t maxTiles )
+  {
+    IndexSurface sheet;
+    DrawSniffContactSheet( file.Data(), file.Size(), candidate, maxTiles, sheet );
+
+    PaletteEntry palette[256];
+    const int32_t paletteSize{ SniffPalette( candidate.encoding, palette ) };
+
+    std::vector<uint8_t> png;
+    return EncodePngIndexed( sheet, palette, paletteSize, png ) && WriteFileBytes( filename, png );
+  }
+} // namespace
+
+
+int32_t main( int32_t argc, char* argv[] )
+{
+  if( argc < 2 || argv[1][0] == '-' )
+  {
+    printf( "Usage: sniff FILE [--top N] [--max-stride N] [--window N] [--threads N] [--sheets PREFIX] "
+            "[--sheet-tiles N] [--force-isa ISA]\n" );
+    return -1;
+  }
+
+  if( !ApplyForceIsaOption( argc, argv ) )
+  {
+    return -1;
+  }
+
+  MappedFile file;
+  if( !file.Open( argv[1] ) )
+  {
+    printf( "%s: can't be read\n", argv[1] );
+    return -1;
+  }
+
+  SniffOptions options;
+  options.numResults = FindNumber( argc, argv, "--top", options.numResults );
+  options.maxStride = FindNumber( argc, argv, "--max-stride", options.maxStride );
+  options.windowBytes = FindNumber( argc, argv, "--window", options.windowBytes );
+  options.numThreads = FindNumber( argc, argv, "--threads", options.numThreads );
+
+  const char* sheetPrefix{ FindOption( argc, argv, "--sheets", "sniff" ) };
+  const int32_t sheetTiles{ FindNumber( argc, argv, "--sheet-tiles", 256 ) };
+
+  const auto startTime = std::chrono::steady_clock::now();
+
+  std::vector<SniffCandidate> candidates;
+  SniffGeometry( file.Data(), file.Size(), options, candidates );
+
+  const std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - startTime };
+  printf( "%s: %u bytes sniffed in %.0f ms with %s kernels\n", argv[1], static_cast<uint32_t>( file.Size() ),
+          elapsed.count(), IsaName( Kernels().isa ) );
+
+  if( candidates.empty() )
+  {
+    printf( "Nothing that looks like tiles\n" );
+    return 1;
+  }
+
+  printf( " #  offset    length  format  stride   tile  across  tiles  score  entropy  contact sheet\n" );
+  for( size_t i = 0; i < candidates.size(); ++i )
+  {
+    const SniffCandidate& candidate{ candidates[i] };
+    const std::string sheetName{ std::string( sheetPrefix ) + "_" + std::to_string( i + 1 ) + ".png" };
+    const bool written{ WriteContactSheet( sheetName.c_str(), file, candidate, sheetTiles ) };
+
+    char tileSize[16];
+    snprintf( tileSize, sizeof( tileSize ), "%dx%d", candidate.tileWidth, candidate.tileHeight );
+    printf( "%2d  0x%06x %7u  %-6s  %6d  %5s  %6d  %5d  %5.2f  %7.2f  %s\n", static_cast<int32_t>( i + 1 ),
+            static_cast<uint32_t>( candidate.offset ), static_cast<uint32_t>( candidate.length ),
+            SniffEncodingName( candidate.encoding ), candidate.stride, tileSize, candidate.tilesPerRow,
+            candidate.numTiles, candidate.score, candidate.entropy, written ? sheetName.c_str() : "(not written)" );
+  }
+
+  return 0;
+}
@@ -0,0 +1,111 @@
+// Converts index surfaces into Allegro bitmaps and saves them as .pcx files or datafiles.
+// Include after allegro.h, once the color depth has been set.
+
+#ifndef TILE_DECODE_ALLEGRO_SURFACE_H
+#define TILE_DECODE_ALLEGRO_SURFACE_H
+
+#include "cpu_dispatch.h"
+#include "datafile_writer.h"
+#include "surface.h"
+
+// Fills colorTable with the makecol() value of every palette entry
+inline void MakeColorTable( const PaletteEntry* palette, int32_t paletteSize, int32_t* colorTable )
+{
+  for( int32_t i = 0; i < paletteSize; ++i )
+  {
+    colorTable[i] = makecol( palette[i].r, palette[i].g, palette[i].b );
+  }
+}
+
+// Creates a bitmap the size of the surface and draws every pixel through colorTable. Rows of 15, 16 and 32-bit memory
+// bitmaps are written directly with the palette kernel (see cpu_dispatch.h), anything else goes through putpixel().
+template<size_t N>
+inline BITMAP* CreateBitmapFromSurface( const IndexSurface& surface, const int32_t ( &colorTable )[N] )
+{
+  static_assert( N <= 256, "Surface indices are bytes" );
+
+  INSTRUMENT_SCOPE( "convert" );
+  INSTRUMENT_COUNT( COUNTER_ALLOCATIONS, 1 );
+
+  BITMAP* bitmap{ create_bitmap( surface.width, surface.height ) };
+  if( bitmap == nullptr )
+  {
+    return nullptr;
+  }
+
+  const int32_t depth{ bitmap_color_depth( bitmap ) };
+  const DecodeKernels& kernels{ Kernels() };
+
+  if( is_memory_bitmap( bitmap ) && depth == 32 )
+  {
+    // The kernels read a full 256 entry table
+    uint32_t table[256]{};
+    for( size_t i = 0; i < N; ++i )
+    {
+      table[i] = static_cast<uint32_t>( colorTable[i] );
+    }
+
+    for( int32_t y = 0; y < surface.height; ++y )
+    {
+      kernels.mapIndices32( surface.Row( y ), surface.width, table, static_cast<int32_t>( N ),
+                            reinterpret_cast<uint32_t*>( bitmap->line[y] ) );
+    }
+  }
+  else if( is_memory_bitmap( bitmap ) && ( depth == 15 || depth == 16 ) )
+  {
+    uint16_t table[256]{};
+    for( size_t i = 0; i < N; ++i )
+    {
+      table[i] = static_cast<uint16_t>( colorTable[i] );
+    }
+
+    for( int32_t y = 0; y < surface.height; ++y )
+    {
+      kernels.mapIndices16( surface.Row( y ), surface.width, table, static_cast<int32_t>( N ),
+                            reinterpret_cast<uint16_t*>( bitmap->line[y] ) );
+    }
+  }
+  else
+  {
+    for( int32_t y = 0; y < surface.height; ++y )
+    {
+      const uint8_t* row{ surface.Row( y ) };
+      for( int32_t x = 0; x < surface.width; ++x )
+      {
+        putpixel( bitmap, x, y, colorTable[row[x]] );
+      }
+    }
+  }
+
+  return bitmap;
+}
+
+// save_pcx() without a palette, timed as its own stage
+inline int32_t SavePcx( const char* filename, BITMAP* bitmap )
+{
+  INSTRUMENT_SCOPE( "save_pcx" );
+
+  return save_pcx( filename, bitmap, nullptr );
+}
+
+// Writes a datafile through a packfile, which puts the packfile magic in front and with compress LZSS packs the whole
+// file (F_WRITE_PACKED), so load_datafile() reads it either way
+inline bool SaveDatafile( const char* filename, const DatafileWriter& writer, bool compress )
+{
+  std::vector<uint8_t> bytes;
+  writer.Store( bytes );
+
+  INSTRUMENT_SCOPE( "save_datafile" );
+
+  PACKFILE* file{ pack_fopen( filename, compress ? F_WRITE_PACKED : F_WRITE_NOPACK ) };
+  if( file == nullptr )
+  {
+    return false;
+  }
+
+  const bool written{ pack_fwrite( bytes.data(), static_cast<long>( bytes.size() ), file ) ==
+                      static_cast<long>( bytes.size() ) };
+  return pack_fclose( file ) == 0 && written;
+}
+
+#endif // TILE_DECODE_ALLEGRO_SURFACE_H
@@ -0,0 +1,256 @@
+#include "apple2_decode.h"
+
+#include <cstring>
+
+#include "../instrument/instrument.h"
+#include "parallel.h"
+
+// Rows per work item. 8 rows are 8 different 0x400 blocks of the page, so bands stay cheap to hand out.
+#define SCREEN_BAND_HEIGHT 8
+
+
+const PaletteEntry apple2Palette[6] =
+{
+  { 0x25, 0xBE, 0x00 }, // Green
+  { 0xE5, 0x50, 0x00 }, // Orange
+  { 0x9E, 0x00, 0xFF }, // Violet
+  { 0x00, 0x7E, 0xFF }, // Blue
+  { 0xFF, 0xFF, 0xFF }, // White
+  { 0x00, 0x00, 0x00 }, // Black
+};
+
+
+colorType ApplePixelColor( uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd )
+{
+  colorType color{ Black };
+
+  if( ( value & 0x1 ) == 1 )
+  {
+    if( lastBitOn || ( ( value >> 1 ) & 0x1 ) )
+    {
+      color = White;
+    }
+    else if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    {
+      if( odd )
+      {
+        color = firstColorGroup ? Green : Orange;
+      }
+      else
+      {
+        color = firstColorGroup ? Violet : Blue;
+      }
+    }
+  }
+  else
+  {
+    if( !lastBitOn && ( ( ( value >> 1 ) & 0x1 ) == 0 ) )
+    {
+      color = Black;
+    }
+    if( lastBitOn && ( ( value >> 1 ) & 0x1 ) )
+    {
+      if( odd )
+      {
+        color = firstColorGroup ? Violet : Blue;
+      }
+      else
+      {
+        color = firstColorGroup ? Green : Orange;
+      }
+    }
+  }
+
+  return color;
+}
+
+
+namespace
+{
+  // The 7 colors of every byte for every combination of phase, left neighbour and right neighbour. Entries are padded
+  // to 8 bytes.
+  struct ByteColorTable
+  {
+    uint8_t colors[2][2][2][256][8];
+
+    ByteColorTable()
+    {
+      memset( colors, Black, sizeof( colors ) );
+
+      for( int32_t odd = 0; odd < 2; ++odd )
+      {
+        for( int32_t carryIn = 0; carryIn < 2; ++carryIn )
+        {
+          for( int32_t nextBit = 0; nextBit < 2; ++nextBit )
+          {
+            for( int32_t value = 0; value < 256; ++value )
+            {
+              // The right-hand neighbour of the 7th pixel sits just above the 7 data bits
+              const uint32_t bits{ static_cast<uint32_t>( ( value & 0x7f ) | ( nextBit << 7 ) ) };
+              const bool firstColorGroup{ ( ( value >> 7 ) & 0x1 ) == 0 };
+
+              for( int32_t i = 0; i < APPLE2_PIXELS_PER_BYTE; ++i )
+              {
+                const bool lastBitOn{ i == 0 ? carryIn != 0 : ( ( bits >> ( i - 1 ) ) & 0x1 ) != 0 };
+                const bool pixelOdd{ ( ( odd ^ i ) & 0x1 ) != 0 };
+                colors[odd][carryIn][nextBit][value][i] = static_cast<uint8_t>(
+                  ApplePixelColor( static_cast<uint8_t>( ( bits >> i ) & 0x3 ), lastBitOn, firstColorGroup, pixelOdd ) );
+              }
+            }
+          }
+        }
+      }
+    }
+  };
+
+  // The page is split into thirds of 64 rows, each third into 8 groups of 8, and row n of each group lives in the
+  // n-th 0x400 block
+  uint16_t ScreenRowOffset( int32_t row )
+  {
+    return static_cast<uint16_t>( ( row & 0x7 ) * 0x400 + ( ( row >> 3 ) & 0x7 ) * 0x80 +
+                                  ( row >> 6 ) * APPLE2_SCREEN_BYTES_PER_ROW );
+  }
+
+
+  // The base address of every screen row, so whole rows decode without any address arithmetic
+  struct ScreenRowTable
+  {
+    uint16_t offsets[APPLE2_SCREEN_HEIGHT];
+
+    ScreenRowTable()
+    {
+      for( int32_t row = 0; row < APPLE2_SCREEN_HEIGHT; ++row )
+      {
+        offsets[row] = ScreenRowOffset( row );
+      }
+    }
+  };
+
+  const ScreenRowTable screenRowTable;
+
+
+  const ByteColorTable& GetByteColorTable()
+  {
+    static const ByteColorTable table;
+    return table;
+  }
+} // namespace
+
+
+void DecodeAppleSpan( const uint8_t* bytes, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* dest )
+{
+  const ByteColorTable& table{ GetByteColorTable() };
+
+  int32_t carry{ carryIn ? 1 : 0 };
+
+  for( int32_t k = 0; k < numBytes; ++k )
+  {
+    const uint8_t value{ bytes[k] };
+    const int32_t nextBit{ k + 1 < numBytes ? bytes[k + 1] & 0x1 : 0 };
+
+    // 7 pixels per byte, so the phase flips from one byte to the next
+    const int32_t odd{ ( startOdd ? 1 : 0 ) ^ ( k & 0x1 ) };
+
+    memcpy( dest, table.colors[odd][carry][nextBit][value], APPLE2_PIXELS_PER_BYTE );
+    dest += APPLE2_PIXELS_PER_BYTE;
+
+    carry = ( value >> 6 ) & 0x1;
+  }
+}
+
+
+void DecodeAppleSpanReference( const uint8_t* bytes, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* dest )
+{
+  const int32_t numPixels{ numBytes * APPLE2_PIXELS_PER_BYTE };
+
+  // Data bit i of the span, with everything outside the span off
+  auto bitAt = [bytes, numPixels]( int32_t i ) -> uint8_t
+  {
+    if( i < 0 || i >= numPixels )
+    {
+      return 0;
+    }
+
+    return ( bytes[i / APPLE2_PIXELS_PER_BYTE] >> ( i % APPLE2_PIXELS_PER_BYTE ) ) & 0x1;
+  };
+
+  for( int32_t i = 0; i < numPixels; ++i )
+  {
+    const uint8_t value{ static_cast<uint8_t>( bitAt( i ) | ( bitAt( i + 1 ) << 1 ) ) };
+    const bool lastBitOn{ i == 0 ? carryIn : bitAt( i - 1 ) != 0 };
+    const bool firstColorGroup{ ( ( bytes[i / APPLE2_PIXELS_PER_BYTE] >> 7 ) & 0x1 ) == 0 };
+    const bool odd{ startOdd != ( ( i & 0x1 ) != 0 ) };
+
+    dest[i] = static_cast<uint8_t>( ApplePixelColor( value, lastBitOn, firstColorGroup, odd ) );
+  }
+}
+
+
+bool DecodeAppleScreen( const uint8_t* data, size_t size, IndexSurface& surface, int32_t numThreads )
+{
+  const uint8_t* picture{ FindAppleScreenData( data, size ) };
+  if( picture == nullptr )
+  {
+    return false;
+  }
+
+  surface.Create( APPLE2_SCREEN_WIDTH, APPLE2_SCREEN_HEIGHT );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, APPLE2_SCREEN_MIN_SIZE );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  // Each row is one span: the neighbour bit carries across all 40 bytes, and column 0 starts on the same phase as the
+  // tiles and glyphs
+  ParallelFor( APPLE2_SCREEN_HEIGHT / SCREEN_BAND_HEIGHT, numThreads, [&]( int32_t band )
+  {
+    for( int32_t y = band * SCREEN_BAND_HEIGHT; y < ( band + 1 ) * SCREEN_BAND_HEIGHT; ++y )
+    {
+      DecodeAppleSpan( picture + screenRowTable.offsets[y], APPLE2_SCREEN_BYTES_PER_ROW, true, false,
+                       surface.Row( y ) );
+    }
+  } );
+
+  return true;
+}
+
+
+bool DecodeAppleScreenReference( const uint8_t* data, size_t size, IndexSurface& surface )
+{
+  const uint8_t* picture{ FindAppleScreenData( data, size ) };
+  if( picture == nullptr )
+  {
+    return false;
+  }
+
+  surface.Create( APPLE2_SCREEN_WIDTH, APPLE2_SCREEN_HEIGHT );
+
+  for( int32_t y = 0; y < APPLE2_SCREEN_HEIGHT; ++y )
+  {
+    DecodeAppleSpanReference( picture + ScreenRowOffset( y ), APPLE2_SCREEN_BYTES_PER_ROW, true, false,
+                              surface.Row( y ) );
+  }
+
+  return true;
+}
+
+
+const uint8_t* FindAppleScreenData( const uint8_t* data, size_t size )
+{
+  if( size >= 4 + APPLE2_SCREEN_MIN_SIZE && data[0] == 0x00 && data[1] == 0x20 )
+  {
+    const size_t length{ static_cast<size_t>( data[2] | ( data[3] << 8 ) ) };
+    if( length + 4 == size )
+    {
+      return data + 4;
+    }
+  }
+
+  return size >= APPLE2_SCREEN_MIN_SIZE ? data : nullptr;
+}
+
+
+uint16_t AppleScreenRowOffset( int32_t row )
+{
+  return screenRowTable.offsets[row];
+}
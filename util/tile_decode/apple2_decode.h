@@ -0,0 +1,77 @@
+// Apple ][ hi-res decoding shared by the apple2 rippers.
+// Each byte holds 7 pixels (LSB first) plus a palette bit (MSB). The color of a pixel depends on its neighbours, the
+// palette bit of the byte it lives in, and whether it sits on an odd or even column.
+
+// Resources:
+// https://en.wikipedia.org/wiki/Apple_II_graphics
+// https://retrocomputing.stackexchange.com/questions/6271/what-determines-the-color-of-every-8th-pixel-on-the-apple-ii
+// https://www.xtof.info/hires-graphics-apple-ii.html
+// Gil Megidish's pixel rendering algorithm
+
+#ifndef TILE_DECODE_APPLE2_DECODE_H
+#define TILE_DECODE_APPLE2_DECODE_H
+
+#include "surface.h"
+
+#define APPLE2_PIXELS_PER_BYTE 7
+
+// Full-screen hi-res pictures: the 8 KB page at $2000 holds 192 rows of 40 bytes (280 pixels), interleaved so that
+// consecutive rows are 0x400 bytes apart, every 8th row 0x80 apart and every 64th row 0x28 apart. The last 8 bytes of
+// each 0x80 block are unused "screen holes".
+#define APPLE2_SCREEN_BYTES_PER_ROW 40
+#define APPLE2_SCREEN_WIDTH         ( APPLE2_SCREEN_BYTES_PER_ROW * APPLE2_PIXELS_PER_BYTE )
+#define APPLE2_SCREEN_HEIGHT        192
+#define APPLE2_SCREEN_SIZE          0x2000
+
+// Pictures saved with BSAVE stop after the last visible byte, 8 bytes short of the full page
+#define APPLE2_SCREEN_MIN_SIZE      0x1ff8
+
+enum colorType
+{
+  Green,
+  Orange,
+  Violet,
+  Blue,
+  White,
+  Black
+};
+
+extern const PaletteEntry apple2Palette[6];
+
+// From Gil Megidish:
+// The algorithm is this: for any given pixel at x, if x is 1 and any of( x - 1 ), ( x + 1 ) are 1s, then pixel at x is
+// white. if x is 0 and the two adjacent are also zero, then pixel at x is black. Now it's tricky. If x is 1 and both
+// adjacent pixels are 0, then pixel at x is green/purple (if odd or even), there's also blue / orange for second
+// palette. If x is 0, and both adjacent are 1, then the previous algorithm also catches. Sum it up, color at pixel x
+// depends on the two adjacent pixels, the MSB of the byte being rendered, and if this pixel is odd / even.
+//
+// value holds the pixel in bit 0 and its right-hand neighbour in bit 1.
+colorType ApplePixelColor( uint8_t value, bool lastBitOn, bool firstColorGroup, bool odd );
+
+// Decodes numBytes consecutive hi-res bytes that render as one continuous span of 7 * numBytes pixels. Neighbour bits
+// carry across byte boundaries inside the span. startOdd is the phase of the first pixel and carryIn is the pixel to
+// the left of the span (false at the edge of a tile). The pixel to the right of the span is always treated as off.
+void DecodeAppleSpan( const uint8_t* bytes, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* dest );
+
+// Per-pixel version of DecodeAppleSpan() built directly on ApplePixelColor(). DecodeAppleSpan() is table driven and is
+// verified against this.
+void DecodeAppleSpanReference( const uint8_t* bytes, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* dest );
+
+// Returns where the picture starts in a hi-res screen file, past a 4 byte DOS 3.3 binary file header (load address
+// $2000, then the length) if it has one. Returns nullptr if there are fewer than APPLE2_SCREEN_MIN_SIZE bytes of
+// picture data.
+const uint8_t* FindAppleScreenData( const uint8_t* data, size_t size );
+
+// Offset of a screen row within the hi-res page, from a table built at startup
+uint16_t AppleScreenRowOffset( int32_t row );
+
+// Decodes a full-screen hi-res picture into a 280x192 surface, one 40 byte span per row found through a precomputed
+// row address table, with the rows split across numThreads threads (0 = one per core). Returns false if
+// FindAppleScreenData() can't find the picture.
+bool DecodeAppleScreen( const uint8_t* data, size_t size, IndexSurface& surface, int32_t numThreads );
+
+// Single-threaded version of DecodeAppleScreen() that computes every row address from scratch and decodes it with
+// DecodeAppleSpanReference(). DecodeAppleScreen() is verified against this.
+bool DecodeAppleScreenReference( const uint8_t* data, size_t size, IndexSurface& surface );
+
+#endif // TILE_DECODE_APPLE2_DECODE_H
@@ -0,0 +1,238 @@
+#include "apple2_encode.h"
+
+#include <cstring>
+
+#include "../instrument/instrument.h"
+#include "parallel.h"
+
+// Larger than any span's total difference
+#define NO_PATH ( INT64_MAX / 2 )
+
+
+namespace
+{
+  // The color of a pixel for each phase and palette bit, indexed by the bit to its left, its own bit and the bit to
+  // its right, from bit 0 up
+  struct PixelColorTable
+  {
+    uint8_t colors[2][2][8];
+
+    PixelColorTable()
+    {
+      for( int32_t odd = 0; odd < 2; ++odd )
+      {
+        for( int32_t palette = 0; palette < 2; ++palette )
+        {
+          for( int32_t bits = 0; bits < 8; ++bits )
+          {
+            colors[odd][palette][bits] = static_cast<uint8_t>( ApplePixelColor(
+              static_cast<uint8_t>( bits >> 1 ), ( bits & 0x1 ) != 0, palette == 0, odd != 0 ) );
+          }
+        }
+      }
+    }
+  };
+
+
+  const PixelColorTable& GetPixelColorTable()
+  {
+    static const PixelColorTable table;
+    return table;
+  }
+
+
+  int32_t ColorDistance( const PaletteEntry& a, const PaletteEntry& b )
+  {
+    const int32_t dr{ a.r - b.r };
+    const int32_t dg{ a.g - b.g };
+    const int32_t db{ a.b - b.b };
+    return dr * dr + dg * dg + db * db;
+  }
+} // namespace
+
+
+int64_t EncodeAppleSpan( const PaletteEntry* target, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* bytes )
+{
+  if( numBytes < 1 || numBytes > APPLE2_MAX_ENCODE_BYTES )
+  {
+    return -1;
+  }
+
+  const PixelColorTable& table{ GetPixelColorTable() };
+  const int32_t numPixels{ numBytes * APPLE2_PIXELS_PER_BYTE };
+
+  // What each Apple color costs at each pixel
+  int32_t colorCosts[APPLE2_MAX_ENCODE_BYTES * APPLE2_PIXELS_PER_BYTE][6];
+  for( int32_t i = 0; i < numPixels; ++i )
+  {
+    for( int32_t color = 0; color < 6; ++color )
+    {
+      colorCosts[i][color] = ColorDistance( target[i], apple2Palette[color] );
+    }
+  }
+
+  // A state is the bit to the left of a pixel plus the pixel's own bit << 1, which is all it needs besides the bit to
+  // its right. For each byte, palette bit and pixel, the left bit on the cheapest path into each state that follows
+  // the pixel, and which palette bit was cheaper for each state at the end of the byte.
+  uint8_t leftBits[APPLE2_MAX_ENCODE_BYTES][2][APPLE2_PIXELS_PER_BYTE][4];
+  uint8_t paletteBits[APPLE2_MAX_ENCODE_BYTES][4];
+
+  // Before the first pixel, the state is the carry plus a free first bit
+  int64_t cost[4];
+  for( int32_t state = 0; state < 4; ++state )
+  {
+    cost[state] = ( state & 0x1 ) == ( carryIn ? 1 : 0 ) ? 0 : NO_PATH;
+  }
+
+  for( int32_t k = 0; k < numBytes; ++k )
+  {
+    int64_t byteCost[2][4];
+
+    for( int32_t palette = 0; palette < 2; ++palette )
+    {
+      int64_t current[4];
+      memcpy( current, cost, sizeof( current ) );
+
+      for( int32_t j = 0; j < APPLE2_PIXELS_PER_BYTE; ++j )
+      {
+        const int32_t i{ k * APPLE2_PIXELS_PER_BYTE + j };
+        const uint8_t* colors{ table.colors[( startOdd ? 1 : 0 ) ^ ( i & 0x1 )][palette] };
+
+        const int32_t* pixelCosts{ colorCosts[i] };
+
+        // The pixel to the right of the span is always off
+        const int32_t numRightBits{ i + 1 < numPixels ? 2 : 1 };
+
+        int64_t next[4] = { NO_PATH, NO_PATH, NO_PATH, NO_PATH };
+        for( int32_t state = 0; state < 4; ++state )
+        {
+          for( int32_t right = 0; right < numRightBits; ++right )
+          {
+            const int32_t bits{ state | ( right << 2 ) };
+            const int32_t nextState{ bits >> 1 };
+            const int64_t total{ current[state] + pixelCosts[colors[bits]] };
+
+            if( total < next[nextState] )
+            {
+              next[nextState] = total;
+              leftBits[k][palette][j][nextState] = static_cast<uint8_t>( state & 0x1 );
+            }
+          }
+        }
+
+        memcpy( current, next, sizeof( current ) );
+      }
+
+      memcpy( byteCost[palette], current, sizeof( current ) );
+    }
+
+    for( int32_t state = 0; state < 4; ++state )
+    {
+      paletteBits[k][state] = byteCost[1][state] < byteCost[0][state] ? 1 : 0;
+      cost[state] = byteCost[paletteBits[k][state]][state];
+    }
+  }
+
+  // The bit past the span is off, so the span ends in state 0 or 1
+  int32_t state{ cost[1] < cost[0] ? 1 : 0 };
+  const int64_t total{ cost[state] };
+
+  for( int32_t k = numBytes - 1; k >= 0; --k )
+  {
+    const int32_t palette{ paletteBits[k][state] };
+    uint8_t value{ static_cast<uint8_t>( palette << 7 ) };
+
+    for( int32_t j = APPLE2_PIXELS_PER_BYTE - 1; j >= 0; --j )
+    {
+      // Stepping back over pixel j: its own bit is the left bit of the state after it
+      const int32_t ownBit{ state & 0x1 };
+      value = static_cast<uint8_t>( value | ( ownBit << j ) );
+      state = leftBits[k][palette][j][state] | ( ownBit << 1 );
+    }
+
+    bytes[k] = value;
+  }
+
+  return total;
+}
+
+
+int64_t EncodeAppleTiles( const IndexSurface& image, const PaletteEntry* palette, int32_t paletteSize,
+                          int32_t numTiles, int32_t tilesPerRow, int32_t tileWidth, int32_t tileHeight, bool startOdd,
+                          std::vector<uint8_t>& bytes, int32_t numThreads )
+{
+  const int32_t bytesPerRow{ tileWidth / APPLE2_PIXELS_PER_BYTE };
+  const int32_t tilesPerCol{ ( numTiles + tilesPerRow - 1 ) / tilesPerRow };
+
+  if( bytesPerRow < 1 || bytesPerRow > APPLE2_MAX_ENCODE_BYTES || tileWidth % APPLE2_PIXELS_PER_BYTE != 0 ||
+      image.width < tilesPerRow * tileWidth || image.height < tilesPerCol * tileHeight )
+  {
+    return -1;
+  }
+
+  INSTRUMENT_SCOPE( "encode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, static_cast<size_t>( numTiles ) * tileWidth * tileHeight );
+
+  const size_t numBytes{ static_cast<size_t>( numTiles ) * tileHeight * bytesPerRow };
+  const bool haveCurrent{ bytes.size() == numBytes };
+  if( !haveCurrent )
+  {
+    bytes.assign( numBytes, 0 );
+  }
+
+  std::vector<int64_t> tileTotals( numTiles, 0 );
+
+  ParallelFor( numTiles, numThreads, [&]( int32_t tile )
+  {
+    const int32_t x{ ( tile % tilesPerRow ) * tileWidth };
+    const int32_t y{ ( tile / tilesPerRow ) * tileHeight };
+
+    PaletteEntry target[APPLE2_MAX_ENCODE_BYTES * APPLE2_PIXELS_PER_BYTE];
+    for( int32_t row = 0; row < tileHeight; ++row )
+    {
+      const uint8_t* pixels{ image.Row( y + row ) + x };
+      for( int32_t i = 0; i < tileWidth; ++i )
+      {
+        target[i] = pixels[i] < paletteSize ? palette[pixels[i]] : PaletteEntry{ 0, 0, 0 };
+      }
+
+      uint8_t* dest{ bytes.data() + ( static_cast<size_t>( tile ) * tileHeight + row ) * bytesPerRow };
+      if( !haveCurrent )
+      {
+        tileTotals[tile] += EncodeAppleSpan( target, bytesPerRow, startOdd, false, dest );
+        continue;
+      }
+
+      // The row's current bytes stay unless the encoder comes strictly closer, since many bit patterns render the
+      // same and an unedited row shouldn't change
+      uint8_t colors[APPLE2_MAX_ENCODE_BYTES * APPLE2_PIXELS_PER_BYTE];
+      DecodeAppleSpan( dest, bytesPerRow, startOdd, false, colors );
+
+      int64_t current{ 0 };
+      for( int32_t i = 0; i < tileWidth; ++i )
+      {
+        current += ColorDistance( target[i], apple2Palette[colors[i]] );
+      }
+
+      uint8_t encoded[APPLE2_MAX_ENCODE_BYTES];
+      const int64_t difference{ current > 0 ? EncodeAppleSpan( target, bytesPerRow, startOdd, false, encoded ) : 0 };
+      if( difference < current )
+      {
+        memcpy( dest, encoded, bytesPerRow );
+        current = difference;
+      }
+
+      tileTotals[tile] += current;
+    }
+  } );
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, bytes.size() );
+
+  int64_t total{ 0 };
+  for( const int64_t tileTotal : tileTotals )
+  {
+    total += tileTotal;
+  }
+
+  return total;
+}
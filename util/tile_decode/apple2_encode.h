@@ -0,0 +1,37 @@
+// Apple ][ hi-res encoding, the reverse of DecodeAppleSpan(): picks the 7 pixel bits and the palette bit of every byte
+// so the span renders as close as possible to a target picture, for putting edited tiles back into the games.
+//
+// A pixel's color depends on the bits on either side of it, so the bits of a span can't be picked one by one, and
+// trying every byte value against every neighbour is far too slow for a whole tile set. Instead the encoder walks the
+// span a pixel at a time, keeping the cheapest way to reach each of the 4 combinations of the last two bits. The
+// palette bit is tried both ways for each byte and only the cheaper result is kept at the byte boundary, so the carry
+// into the next byte is accounted for and the result is the best possible span, in a few dozen operations per pixel.
+
+#ifndef TILE_DECODE_APPLE2_ENCODE_H
+#define TILE_DECODE_APPLE2_ENCODE_H
+
+#include "apple2_decode.h"
+
+// The longest span EncodeAppleSpan() takes, a full screen row
+#define APPLE2_MAX_ENCODE_BYTES APPLE2_SCREEN_BYTES_PER_ROW
+
+// Encodes 7 * numBytes target colors into numBytes bytes that DecodeAppleSpan() with the same startOdd and carryIn
+// renders as close to them as possible. The difference is measured as the squared RGB distance from each target color
+// to the Apple color that shows in its place. Returns the total difference, or -1 if numBytes is outside
+// 1..APPLE2_MAX_ENCODE_BYTES.
+int64_t EncodeAppleSpan( const PaletteEntry* target, int32_t numBytes, bool startOdd, bool carryIn, uint8_t* bytes );
+
+// Encodes numTiles tiles of tileWidth x tileHeight pixels, laid out tilesPerRow across the image in the order the
+// rippers write them. Each row of a tile becomes one span of tileWidth / 7 bytes, decoded with startOdd and no carry,
+// and bytes receives the rows of each tile in turn. Tiles are encoded in parallel on numThreads threads (0 = one per
+// core). Indices outside the palette count as black. Returns the total difference, or -1 if the image is too small
+// or the tile width doesn't fit.
+//
+// If bytes already holds numTiles tiles in that layout, they are the ones there now, and a row keeps its bytes unless
+// the encoder comes strictly closer. So tiles encoded from their own decoding come out the same bytes, even where
+// other bit patterns would render the same. Otherwise every row is encoded afresh.
+int64_t EncodeAppleTiles( const IndexSurface& image, const PaletteEntry* palette, int32_t paletteSize,
+                          int32_t numTiles, int32_t tilesPerRow, int32_t tileWidth, int32_t tileHeight, bool startOdd,
+                          std::vector<uint8_t>& bytes, int32_t numThreads );
+
+#endif // TILE_DECODE_APPLE2_ENCODE_H
@@ -0,0 +1,271 @@
+#include "apple2_ntsc.h"
+
+#include <cmath>
+#include <vector>
+
+#include "../instrument/instrument.h"
+#include "apple2_decode.h"
+#include "parallel.h"
+
+// 14 samples per byte: 2 per pixel, at 4 samples per subcarrier cycle
+#define SAMPLES_PER_BYTE ( APPLE2_PIXELS_PER_BYTE * 2 )
+
+// The samples that feed one pixel: the window starts WINDOW_LEAD samples before the pixel's first sample
+#define WINDOW_SIZE 12
+#define WINDOW_LEAD 5
+
+// Rotates and scales the demodulated chroma so that the four solid colors come out close to apple2Palette
+#define HUE_DEGREES 226.0
+#define CHROMA_GAIN 0.65
+
+// Rows per work item, as in DecodeAppleScreen()
+#define SCREEN_BAND_HEIGHT 8
+
+
+namespace
+{
+  // Window tap weights for both subcarrier phases a pixel can start on. Luma is a 6 tap box/triangle filter, which
+  // has a zero at the subcarrier frequency. I and Q are demodulated over all 12 taps with a Hann window.
+  struct NtscFilters
+  {
+    float luma[WINDOW_SIZE];
+    float i[2][WINDOW_SIZE];
+    float q[2][WINDOW_SIZE];
+
+    NtscFilters()
+    {
+      const float lumaTaps[6] = { 1.0f, 3.0f, 4.0f, 4.0f, 3.0f, 1.0f };
+
+      for( int32_t j = 0; j < WINDOW_SIZE; ++j )
+      {
+        luma[j] = j >= 3 && j < 9 ? lumaTaps[j - 3] / 16.0f : 0.0f;
+      }
+
+      const double pi{ 3.14159265358979323846 };
+
+      double window[WINDOW_SIZE];
+      double windowSum{ 0.0 };
+      for( int32_t j = 0; j < WINDOW_SIZE; ++j )
+      {
+        window[j] = 0.5 - 0.5 * cos( 2.0 * pi * ( j + 0.5 ) / WINDOW_SIZE );
+        windowSum += window[j];
+      }
+
+      for( int32_t phase = 0; phase < 2; ++phase )
+      {
+        for( int32_t j = 0; j < WINDOW_SIZE; ++j )
+        {
+          // Sample j of the window is this many samples into the subcarrier cycle
+          const int32_t sample{ phase * 2 - WINDOW_LEAD + j };
+          const double angle{ pi / 2.0 * sample + HUE_DEGREES * pi / 180.0 };
+          const double gain{ 2.0 * CHROMA_GAIN * window[j] / windowSum };
+
+          i[phase][j] = static_cast<float>( gain * cos( angle ) );
+          q[phase][j] = static_cast<float>( gain * sin( angle ) );
+        }
+      }
+    }
+  };
+
+  const NtscFilters& GetNtscFilters()
+  {
+    static const NtscFilters filters;
+    return filters;
+  }
+
+
+  uint8_t ToChannel( float value )
+  {
+    if( value <= 0.0f )
+    {
+      return 0;
+    }
+
+    return value >= 1.0f ? 255 : static_cast<uint8_t>( value * 255.0f + 0.5f );
+  }
+
+
+  // The color of a pixel given its window of samples (bit j = sample j) and the subcarrier phase it starts on
+  uint32_t Demodulate( uint32_t window, int32_t phase )
+  {
+    const NtscFilters& filters{ GetNtscFilters() };
+
+    float y{ 0.0f };
+    float i{ 0.0f };
+    float q{ 0.0f };
+
+    for( int32_t j = 0; j < WINDOW_SIZE; ++j )
+    {
+      if( ( window >> j ) & 0x1 )
+      {
+        y += filters.luma[j];
+        i += filters.i[phase][j];
+        q += filters.q[phase][j];
+      }
+    }
+
+    const uint8_t r{ ToChannel( y + 0.956f * i + 0.621f * q ) };
+    const uint8_t g{ ToChannel( y - 0.272f * i - 0.647f * q ) };
+    const uint8_t b{ ToChannel( y - 1.106f * i + 1.703f * q ) };
+
+    return static_cast<uint32_t>( r | ( g << 8 ) | ( b << 16 ) );
+  }
+
+
+  struct NtscTables
+  {
+    // Every window for both phases
+    uint32_t colors[2][1 << WINDOW_SIZE];
+
+    // The 14 samples of every byte (bit k = sample k), for both levels the previous sample can be at. With the
+    // palette bit set, the byte starts one sample late and its first sample holds the previous level.
+    uint16_t byteSamples[2][256];
+
+    NtscTables()
+    {
+      for( int32_t phase = 0; phase < 2; ++phase )
+      {
+        for( uint32_t window = 0; window < ( 1u << WINDOW_SIZE ); ++window )
+        {
+          colors[phase][window] = Demodulate( window, phase );
+        }
+      }
+
+      for( int32_t level = 0; level < 2; ++level )
+      {
+        for( int32_t value = 0; value < 256; ++value )
+        {
+          const bool delayed{ ( value & 0x80 ) != 0 };
+
+          uint32_t samples{ 0 };
+          for( int32_t k = 0; k < SAMPLES_PER_BYTE; ++k )
+          {
+            const int32_t on{ delayed ? ( k == 0 ? level : ( value >> ( ( k - 1 ) / 2 ) ) & 0x1 )
+                                      : ( value >> ( k / 2 ) ) & 0x1 };
+            samples |= static_cast<uint32_t>( on ) << k;
+          }
+
+          byteSamples[level][value] = static_cast<uint16_t>( samples );
+        }
+      }
+    }
+  };
+
+  const NtscTables& GetNtscTables()
+  {
+    static const NtscTables tables;
+    return tables;
+  }
+} // namespace
+
+
+void DecodeAppleSpanNtsc( const uint8_t* bytes, int32_t numBytes, bool startOdd, uint32_t* dest )
+{
+  const NtscTables& tables{ GetNtscTables() };
+  const int32_t numPixels{ numBytes * APPLE2_PIXELS_PER_BYTE };
+  const int32_t startPhase{ startOdd ? 0 : 1 };
+
+  // The last WINDOW_SIZE samples, the newest in the top bit. Everything before the span is black.
+  uint32_t window{ 0 };
+  int32_t level{ 0 };
+  int32_t pixel{ 0 };
+  int32_t sample{ 0 };
+
+  // Pixel p starts at sample 2p, so its window is complete once sample 2p + 6 is in
+  auto push = [&]( uint32_t on )
+  {
+    window = ( window >> 1 ) | ( on << ( WINDOW_SIZE - 1 ) );
+
+    if( sample >= WINDOW_SIZE - WINDOW_LEAD - 1 && ( ( sample - ( WINDOW_SIZE - WINDOW_LEAD - 1 ) ) & 0x1 ) == 0 )
+    {
+      dest[pixel] = tables.colors[( pixel & 0x1 ) ^ startPhase][window];
+      ++pixel;
+    }
+
+    ++sample;
+  };
+
+  for( int32_t k = 0; k < numBytes; ++k )
+  {
+    const uint32_t samples{ tables.byteSamples[level][bytes[k]] };
+    for( int32_t j = 0; j < SAMPLES_PER_BYTE; ++j )
+    {
+      push( ( samples >> j ) & 0x1 );
+    }
+
+    level = ( samples >> ( SAMPLES_PER_BYTE - 1 ) ) & 0x1;
+  }
+
+  // Black after the span, until the last pixels' windows are complete
+  while( pixel < numPixels )
+  {
+    push( 0 );
+  }
+}
+
+
+void DecodeAppleSpanNtscReference( const uint8_t* bytes, int32_t numBytes, bool startOdd, uint32_t* dest )
+{
+  const int32_t numSamples{ numBytes * SAMPLES_PER_BYTE };
+  std::vector<uint8_t> signal( static_cast<size_t>( numSamples ) );
+
+  for( int32_t n = 0; n < numSamples; ++n )
+  {
+    const uint8_t value{ bytes[n / SAMPLES_PER_BYTE] };
+    const int32_t offset{ n % SAMPLES_PER_BYTE };
+
+    if( value & 0x80 )
+    {
+      // Half a pixel late: the first sample repeats whatever came before
+      signal[n] = offset == 0 ? ( n > 0 ? signal[n - 1] : 0 ) : ( value >> ( ( offset - 1 ) / 2 ) ) & 0x1;
+    }
+    else
+    {
+      signal[n] = ( value >> ( offset / 2 ) ) & 0x1;
+    }
+  }
+
+  for( int32_t x = 0; x < numBytes * APPLE2_PIXELS_PER_BYTE; ++x )
+  {
+    uint32_t window{ 0 };
+    for( int32_t j = 0; j < WINDOW_SIZE; ++j )
+    {
+      const int32_t n{ x * 2 - WINDOW_LEAD + j };
+      if( n >= 0 && n < numSamples && signal[n] != 0 )
+      {
+        window |= 1u << j;
+      }
+    }
+
+    dest[x] = Demodulate( window, ( x & 0x1 ) ^ ( startOdd ? 0 : 1 ) );
+  }
+}
+
+
+bool DecodeAppleScreenNtsc( const uint8_t* data, size_t size, RgbSurface& surface, int32_t numThreads )
+{
+  const uint8_t* picture{ FindAppleScreenData( data, size ) };
+  if( picture == nullptr )
+  {
+    return false;
+  }
+
+  surface.Create( APPLE2_SCREEN_WIDTH, APPLE2_SCREEN_HEIGHT );
+
+  // Build the tables before the threads start
+  GetNtscTables();
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, APPLE2_SCREEN_MIN_SIZE );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() * sizeof( uint32_t ) );
+
+  ParallelFor( APPLE2_SCREEN_HEIGHT / SCREEN_BAND_HEIGHT, numThreads, [&]( int32_t band )
+  {
+    for( int32_t y = band * SCREEN_BAND_HEIGHT; y < ( band + 1 ) * SCREEN_BAND_HEIGHT; ++y )
+    {
+      DecodeAppleSpanNtsc( picture + AppleScreenRowOffset( y ), APPLE2_SCREEN_BYTES_PER_ROW, true, surface.Row( y ) );
+    }
+  } );
+
+  return true;
+}
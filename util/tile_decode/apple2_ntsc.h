@@ -0,0 +1,29 @@
+// NTSC composite simulation of Apple ][ hi-res output, an alternative to the six flat colors of ApplePixelColor().
+// The video signal is rebuilt at 4x the color subcarrier (2 samples per hi-res pixel), including the half pixel delay
+// the palette bit gives its byte, and demodulated to RGB through a YIQ decoder. That brings back the color fringing
+// and blending that real monitors show, which the flat colors can't.
+
+// Resources:
+// Understanding the Apple II, Jim Sather, chapter 8
+// https://en.wikipedia.org/wiki/YIQ
+
+#ifndef TILE_DECODE_APPLE2_NTSC_H
+#define TILE_DECODE_APPLE2_NTSC_H
+
+#include "surface.h"
+
+// Renders numBytes consecutive hi-res bytes as one span of 7 * numBytes 0x00BBGGRR pixels, with black on either side.
+// startOdd has the same meaning as in DecodeAppleSpan(), so both renderings of a sheet line up.
+//
+// Every pixel depends only on the 12 signal samples around it and the subcarrier phase, so each one is a single
+// lookup into a table of every window built once from the filters.
+void DecodeAppleSpanNtsc( const uint8_t* bytes, int32_t numBytes, bool startOdd, uint32_t* dest );
+
+// Per-pixel version of DecodeAppleSpanNtsc() that builds the signal sample by sample and runs the filters on it
+// directly. DecodeAppleSpanNtsc() is verified against this.
+void DecodeAppleSpanNtscReference( const uint8_t* bytes, int32_t numBytes, bool startOdd, uint32_t* dest );
+
+// DecodeAppleScreen() through the NTSC simulation, into a 280x192 surface
+bool DecodeAppleScreenNtsc( const uint8_t* data, size_t size, RgbSurface& surface, int32_t numThreads );
+
+#endif // TILE_DECODE_APPLE2_NTSC_H
@@ -0,0 +1,90 @@
+#include "c64_decode.h"
+
+#include <cstring>
+
+#include "cpu_dispatch.h"
+
+
+const PaletteEntry c64Palette[16] =
+{
+  { 0x00, 0x00, 0x00 }, // Black
+  { 0xff, 0xff, 0xff }, // White
+  { 0x93, 0x3a, 0x4c }, // Red
+  { 0xb6, 0xfa, 0xfa }, // Cyan
+  { 0xd2, 0x7d, 0xed }, // Purple
+  { 0x6a, 0xcf, 0x6f }, // Green
+  { 0x4f, 0x44, 0xd8 }, // Blue
+  { 0xfb, 0xfb, 0x8b }, // Yellow
+  { 0xd8, 0x9c, 0x5b }, // Orange
+  { 0x7f, 0x53, 0x07 }, // Brown
+  { 0xef, 0x83, 0x9f }, // Light Red
+  { 0x57, 0x57, 0x53 }, // Dark Gray
+  { 0x57, 0x57, 0x53 }, // Gray
+  { 0xb7, 0xfb, 0xbf }, // Light Green
+  { 0xa3, 0x97, 0xff }, // Light Blue
+  { 0xa3, 0xa7, 0xa7 }  // Light Gray
+};
+
+
+namespace
+{
+  // 0xff for every set bit of every bitmap byte, MSB first, so a byte can be expanded with two masks
+  struct BitMaskTable
+  {
+    uint64_t masks[256];
+
+    BitMaskTable()
+    {
+      for( int32_t value = 0; value < 256; ++value )
+      {
+        uint8_t bytes[C64_PIXELS_PER_BYTE];
+        for( int32_t i = 0; i < C64_PIXELS_PER_BYTE; ++i )
+        {
+          bytes[i] = ( value << i ) & 0x80 ? 0xff : 0x00;
+        }
+
+        memcpy( &masks[value], bytes, sizeof( bytes ) );
+      }
+    }
+  };
+
+  const BitMaskTable bitMaskTable;
+
+  const uint64_t everyByte{ 0x0101010101010101ull };
+} // namespace
+
+
+void DecodeC64HiresByte( uint8_t bits, uint8_t colors, uint8_t* dest )
+{
+  const uint64_t mask{ bitMaskTable.masks[bits] };
+  const uint64_t fore{ ( ( colors >> 4 ) & 0x0f ) * everyByte };
+  const uint64_t back{ ( colors & 0x0f ) * everyByte };
+
+  const uint64_t pixels{ ( fore & mask ) | ( back & ~mask ) };
+  memcpy( dest, &pixels, C64_PIXELS_PER_BYTE );
+}
+
+
+void DecodeC64HiresSpan( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest )
+{
+  Kernels().expandHires( bits, colors, count, dest );
+}
+
+
+void DecodeC64HiresByteReference( uint8_t bits, uint8_t colors, uint8_t* dest )
+{
+  const uint8_t backIndex{ static_cast<uint8_t>( colors & 0x0f ) };        // Background color
+  const uint8_t foreIndex{ static_cast<uint8_t>( ( colors & 0xf0 ) >> 4 ) }; // Foreground color
+
+  int32_t val{ bits };
+
+  for( int32_t i = 0; i < C64_PIXELS_PER_BYTE; ++i )
+  {
+    // We are only interested in the most significant bit per pass
+    dest[i] = val & 0x80 ? foreIndex : backIndex;
+
+    // Shift into most significant bit, keeping val to byte-size
+    val = ( val << 1 );
+    val &= 0xff;
+  }
+}
@@ -0,0 +1,24 @@
+// Commodore 64 hires decoding shared by the c64 rippers.
+// Each bitmap byte is 8 pixels, MSB first. A set bit uses the foreground color (high nibble of the color byte) and a
+// clear bit uses the background color (low nibble).
+
+#ifndef TILE_DECODE_C64_DECODE_H
+#define TILE_DECODE_C64_DECODE_H
+
+#include "surface.h"
+
+#define C64_PIXELS_PER_BYTE 8
+
+extern const PaletteEntry c64Palette[16];
+
+// Expands one bitmap byte into 8 palette indices
+void DecodeC64HiresByte( uint8_t bits, uint8_t colors, uint8_t* dest );
+
+// Expands count bitmap bytes into 8 * count indices, where colors[i] is the color byte of bits[i]. Runs on the
+// widest kernel the CPU supports (see cpu_dispatch.h).
+void DecodeC64HiresSpan( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+
+// Per-pixel version of DecodeC64HiresByte(), which is table driven and verified against this
+void DecodeC64HiresByteReference( uint8_t bits, uint8_t colors, uint8_t* dest );
+
+#endif // TILE_DECODE_C64_DECODE_H
@@ -0,0 +1,120 @@
+#include "c64_encode.h"
+
+
+int64_t EncodeC64HiresBlock( const IndexSurface& image, const PaletteEntry* palette, int32_t paletteSize, int32_t x,
+                             int32_t y, int32_t width, int32_t height, uint8_t* bits, int32_t bitsPitch,
+                             uint8_t& colors )
+{
+  if( x < 0 || y < 0 || width % C64_PIXELS_PER_BYTE != 0 || x + width > image.width || y + height > image.height )
+  {
+    return -1;
+  }
+
+  // How many pixels use each index, so the color search only looks at the handful of colors a block has
+  int32_t counts[256] = {};
+  for( int32_t row = 0; row < height; ++row )
+  {
+    const uint8_t* pixels{ image.Row( y + row ) + x };
+    for( int32_t i = 0; i < width; ++i )
+    {
+      ++counts[pixels[i]];
+    }
+  }
+
+  // The distance from each index the block uses to each C64 color
+  int32_t used[256];
+  int32_t distances[256][16];
+  int32_t numUsed{ 0 };
+
+  for( int32_t index = 0; index < 256; ++index )
+  {
+    if( counts[index] == 0 )
+    {
+      continue;
+    }
+
+    const PaletteEntry color{ index < paletteSize ? palette[index] : PaletteEntry{ 0, 0, 0 } };
+    for( int32_t c = 0; c < 16; ++c )
+    {
+      const int32_t dr{ color.r - c64Palette[c].r };
+      const int32_t dg{ color.g - c64Palette[c].g };
+      const int32_t db{ color.b - c64Palette[c].b };
+      distances[index][c] = dr * dr + dg * dg + db * db;
+    }
+
+    used[numUsed++] = index;
+  }
+
+  auto pairDifference = [&]( int32_t a, int32_t b )
+  {
+    int64_t total{ 0 };
+    for( int32_t j = 0; j < numUsed; ++j )
+    {
+      const int32_t* d{ distances[used[j]] };
+      total += static_cast<int64_t>( counts[used[j]] ) * ( d[a] < d[b] ? d[a] : d[b] );
+    }
+    return total;
+  };
+
+  int32_t foreground{ ( colors >> 4 ) & 0x0f };
+  int32_t background{ colors & 0x0f };
+  int64_t best{ pairDifference( foreground, background ) };
+
+  for( int32_t a = 0; a < 16 && best > 0; ++a )
+  {
+    for( int32_t b = a; b < 16; ++b )
+    {
+      const int64_t difference{ pairDifference( a, b ) };
+      if( difference < best )
+      {
+        best = difference;
+        foreground = a;
+        background = b;
+      }
+    }
+  }
+
+  // A new pair puts the color most pixels get in the background
+  if( foreground != ( ( colors >> 4 ) & 0x0f ) || background != ( colors & 0x0f ) )
+  {
+    int64_t numForeground{ 0 };
+    for( int32_t j = 0; j < numUsed; ++j )
+    {
+      const int32_t* d{ distances[used[j]] };
+      numForeground += d[foreground] < d[background] ? counts[used[j]] : 0;
+    }
+
+    if( numForeground * 2 > static_cast<int64_t>( width ) * height )
+    {
+      const int32_t swap{ foreground };
+      foreground = background;
+      background = swap;
+    }
+
+    colors = static_cast<uint8_t>( ( foreground << 4 ) | background );
+  }
+
+  for( int32_t row = 0; row < height; ++row )
+  {
+    const uint8_t* pixels{ image.Row( y + row ) + x };
+    uint8_t* dest{ bits + static_cast<size_t>( row ) * bitsPitch };
+
+    for( int32_t i = 0; i < width; ++i )
+    {
+      const int32_t* d{ distances[pixels[i]] };
+      const uint8_t mask{ static_cast<uint8_t>( 0x80 >> ( i % C64_PIXELS_PER_BYTE ) ) };
+      uint8_t& value{ dest[i / C64_PIXELS_PER_BYTE] };
+
+      if( d[foreground] < d[background] )
+      {
+        value = static_cast<uint8_t>( value | mask );
+      }
+      else if( d[background] < d[foreground] )
+      {
+        value = static_cast<uint8_t>( value & ~mask );
+      }
+    }
+  }
+
+  return best;
+}
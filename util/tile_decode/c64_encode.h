@@ -0,0 +1,23 @@
+// Commodore 64 hires encoding, the reverse of DecodeC64HiresSpan(), for putting edited tiles back onto the disks.
+// Every pixel of a block shares one color byte, so encoding a block is picking the two colors that come closest to
+// it, then giving each pixel whichever of the two is closer.
+
+#ifndef TILE_DECODE_C64_ENCODE_H
+#define TILE_DECODE_C64_ENCODE_H
+
+#include "c64_decode.h"
+
+// Encodes the width x height block at x, y of an image (width a multiple of 8) into hires bitmap bytes, with row r of
+// the block at bits + r * bitsPitch, and a color byte for the whole block. The difference is measured as the squared
+// RGB distance from each pixel's color in palette to the C64 color it gets, and indices outside the palette count as
+// black.
+//
+// bits and colors start out holding what's there now, and are only changed where that makes a difference: the color
+// byte is kept unless another pair of colors comes strictly closer, and a pixel that's as close in either color keeps
+// its bit. So a block that's encoded from its own decoding comes out the same bytes. Returns the total difference, or
+// -1 if the block doesn't fit in the image.
+int64_t EncodeC64HiresBlock( const IndexSurface& image, const PaletteEntry* palette, int32_t paletteSize, int32_t x,
+                             int32_t y, int32_t width, int32_t height, uint8_t* bits, int32_t bitsPitch,
+                             uint8_t& colors );
+
+#endif // TILE_DECODE_C64_ENCODE_H
@@ -0,0 +1,213 @@
+#include "c64_tiles.h"
+
+#include <cstring>
+#include <utility>
+
+
+bool C64TileSet::Create( int32_t width, int32_t height )
+{
+  if( width <= 0 || width % C64_PIXELS_PER_BYTE != 0 || height <= 0 )
+  {
+    return false;
+  }
+
+  tileWidth = width;
+  tileHeight = height;
+  numTiles = 0;
+  bits.clear();
+  colors.clear();
+  return true;
+}
+
+
+void C64TileSet::AddInterleaved( const uint8_t* data, int32_t rowPitch, const uint8_t* tileColors, int32_t count )
+{
+  const int32_t bytesPerRow{ BytesPerRow() };
+
+  bits.resize( bits.size() + count * BytesPerTile() );
+  colors.insert( colors.end(), tileColors, tileColors + count );
+
+  INSTRUMENT_COUNT( COUNTER_ALLOCATIONS, 1 );
+  INSTRUMENT_COUNT( COUNTER_ALLOCATED_BYTES, count * ( BytesPerTile() + 1 ) );
+
+  for( int32_t tile = 0; tile < count; ++tile )
+  {
+    uint8_t* dest{ bits.data() + ( numTiles + tile ) * BytesPerTile() };
+    for( int32_t y = 0; y < tileHeight; ++y, dest += bytesPerRow )
+    {
+      memcpy( dest, data + static_cast<size_t>( y ) * rowPitch + tile * bytesPerRow, bytesPerRow );
+    }
+  }
+
+  numTiles += count;
+}
+
+
+void DrawC64Tile( const C64TileSet& set, int32_t tile, uint8_t* dest, int32_t destPitch )
+{
+  const int32_t bytesPerRow{ set.BytesPerRow() };
+
+  const std::vector<uint8_t> rowColors( static_cast<size_t>( bytesPerRow ), set.colors[tile] );
+
+  for( int32_t y = 0; y < set.tileHeight; ++y, dest += destPitch )
+  {
+    DecodeC64HiresSpan( set.TileRow( tile, y ), rowColors.data(), bytesPerRow, dest );
+  }
+}
+
+
+int32_t DrawC64TileMap( const C64TileSet& set, const TileMapView& map, const TileRegion& region, uint8_t* dest,
+                        int32_t destPitch, uint8_t fill )
+{
+  const int32_t entrySize{ TileMapEntrySize( map.encoding ) };
+  const int32_t bytesPerRow{ set.BytesPerRow() };
+  const int32_t numBytes{ region.width * bytesPerRow };
+
+  // The first row of every tile in the map row (null for tiles that stay as fill), and the bits and colors of one
+  // pixel row of the map row, gathered so the whole row expands in one span
+  std::vector<const uint8_t*> tiles( static_cast<size_t>( region.width ) );
+  std::vector<uint8_t> rowBits( static_cast<size_t>( numBytes ) );
+  std::vector<uint8_t> rowColors( static_cast<size_t>( numBytes ) );
+  int32_t numMissing{ 0 };
+
+  for( int32_t mapRow = 0; mapRow < region.height; ++mapRow )
+  {
+    const uint8_t* entry{ TileMapEntry( map, region.x, region.y + mapRow ) };
+    bool anyMissing{ false };
+
+    for( int32_t column = 0; column < region.width; ++column, entry += entrySize )
+    {
+      const int32_t tile{ TileMapNumber( entry, map.encoding ) };
+      uint8_t color{ 0 };
+
+      if( tile < set.numTiles )
+      {
+        tiles[column] = set.TileRow( tile, 0 );
+        color = set.colors[tile];
+      }
+      else
+      {
+        tiles[column] = nullptr;
+        anyMissing = true;
+        ++numMissing;
+      }
+
+      memset( &rowColors[column * bytesPerRow], color, bytesPerRow );
+    }
+
+    for( int32_t tileY = 0; tileY < set.tileHeight; ++tileY )
+    {
+      const size_t offset{ static_cast<size_t>( tileY ) * bytesPerRow };
+      for( int32_t column = 0; column < region.width; ++column )
+      {
+        uint8_t* out{ &rowBits[column * bytesPerRow] };
+        if( tiles[column] != nullptr )
+        {
+          memcpy( out, tiles[column] + offset, bytesPerRow );
+        }
+        else
+        {
+          memset( out, 0, bytesPerRow );
+        }
+      }
+
+      uint8_t* out{ dest + static_cast<size_t>( mapRow * set.tileHeight + tileY ) * destPitch };
+      DecodeC64HiresSpan( rowBits.data(), rowColors.data(), numBytes, out );
+
+      if( anyMissing )
+      {
+        for( int32_t column = 0; column < region.width; ++column )
+        {
+          if( tiles[column] == nullptr )
+          {
+            memset( out + column * set.tileWidth, fill, set.tileWidth );
+          }
+        }
+      }
+    }
+  }
+
+  return numMissing;
+}
+
+
+int32_t RenderC64TileMap( const C64TileSet& set, const TileMapView& map, const TileRegion& region,
+                          IndexSurface& dest, int32_t numThreads, uint8_t fill )
+{
+  return RenderTileMapBands( region, set.tileWidth, set.tileHeight, dest, numThreads, fill,
+                             [&]( const TileRegion& rows, uint8_t* destRow )
+  {
+    return DrawC64TileMap( set, map, rows, destRow, dest.pitch, fill );
+  } );
+}
+
+
+void StoreC64TileSet( const C64TileSet& set, std::vector<uint8_t>& bytes )
+{
+  bytes.assign( { 'C', '6', '4', 'T' } );
+
+  const uint32_t values[] = { static_cast<uint32_t>( set.tileWidth ), static_cast<uint32_t>( set.tileHeight ),
+                              static_cast<uint32_t>( set.numTiles ) };
+  const int32_t sizes[] = { 2, 2, 4 };
+  for( int32_t i = 0; i < 3; ++i )
+  {
+    for( int32_t j = 0; j < sizes[i]; ++j )
+    {
+      bytes.push_back( static_cast<uint8_t>( values[i] >> ( j * 8 ) ) );
+    }
+  }
+
+  bytes.insert( bytes.end(), set.bits.begin(), set.bits.end() );
+  bytes.insert( bytes.end(), set.colors.begin(), set.colors.end() );
+}
+
+
+bool ParseC64TileSet( const uint8_t* data, size_t size, C64TileSet& set )
+{
+  if( size < C64_TILE_SET_HEADER_SIZE || memcmp( data, "C64T", 4 ) != 0 )
+  {
+    return false;
+  }
+
+  const int32_t width{ data[4] | ( data[5] << 8 ) };
+  const int32_t height{ data[6] | ( data[7] << 8 ) };
+  const uint32_t count{ data[8] | ( data[9] << 8 ) | ( data[10] << 16 ) | ( static_cast<uint32_t>( data[11] ) << 24 ) };
+
+  C64TileSet parsed;
+  if( !parsed.Create( width, height ) || count > 0x7fffffff )
+  {
+    return false;
+  }
+
+  // Checked by division so a huge count can't overflow the size
+  const size_t available{ size - C64_TILE_SET_HEADER_SIZE };
+  if( available / ( parsed.BytesPerTile() + 1 ) < count || available != count * ( parsed.BytesPerTile() + 1 ) )
+  {
+    return false;
+  }
+
+  const uint8_t* bits{ data + C64_TILE_SET_HEADER_SIZE };
+  const size_t numBits{ count * parsed.BytesPerTile() };
+
+  parsed.numTiles = static_cast<int32_t>( count );
+  parsed.bits.assign( bits, bits + numBits );
+  parsed.colors.assign( bits + numBits, bits + numBits + count );
+
+  set = std::move( parsed );
+  return true;
+}
+
+
+bool SaveC64TileSet( const char* filename, const C64TileSet& set )
+{
+  std::vector<uint8_t> bytes;
+  StoreC64TileSet( set, bytes );
+  return WriteFileBytes( filename, bytes );
+}
+
+
+bool LoadC64TileSet( const char* filename, C64TileSet& set )
+{
+  std::vector<uint8_t> bytes;
+  return ReadFileBytes( filename, bytes ) && ParseC64TileSet( bytes.data(), bytes.size(), set );
+}
@@ -0,0 +1,79 @@
+// Commodore 64 hires tiles kept the way the machine keeps them: a 1 bit per pixel plane and one color byte per tile.
+// A 16x16 tile is 33 bytes instead of the 256 an index atlas holds (or 512 once it's a 16-bit bitmap), so a renderer
+// can keep thousands of tile sets resident. Tiles are expanded only as they're drawn, a whole output row at a time
+// through the hires span kernel (see c64_decode.h).
+//
+// Tile sets can be saved to and loaded from .c64t files:
+//   "C64T", tile width (16 bits), tile height (16 bits), number of tiles (32 bits), all little endian
+//   the bit plane, tile after tile, each tileWidth / 8 bytes per row, MSB first
+//   the color bytes, one per tile (foreground in the high nibble, background in the low nibble)
+
+#ifndef TILE_DECODE_C64_TILES_H
+#define TILE_DECODE_C64_TILES_H
+
+#include "c64_decode.h"
+#include "tile_map.h"
+
+#define C64_TILE_SET_HEADER_SIZE 12
+
+struct C64TileSet
+{
+  int32_t tileWidth{ 0 };  // A multiple of 8
+  int32_t tileHeight{ 0 };
+  int32_t numTiles{ 0 };
+  std::vector<uint8_t> bits;
+  std::vector<uint8_t> colors;
+
+  // Starts an empty set. Returns false if the width isn't a whole number of bytes.
+  bool Create( int32_t width, int32_t height );
+
+  // Appends count tiles stored the way the C64 games store them, a row of every tile at a time: row y of tile t is at
+  // data + y * rowPitch + t * BytesPerRow(). tileColors holds one color byte per tile.
+  void AddInterleaved( const uint8_t* data, int32_t rowPitch, const uint8_t* tileColors, int32_t count );
+
+  int32_t BytesPerRow() const
+  {
+    return tileWidth / C64_PIXELS_PER_BYTE;
+  }
+
+  size_t BytesPerTile() const
+  {
+    return static_cast<size_t>( BytesPerRow() ) * tileHeight;
+  }
+
+  const uint8_t* TileRow( int32_t tile, int32_t y ) const
+  {
+    return bits.data() + tile * BytesPerTile() + static_cast<size_t>( y ) * BytesPerRow();
+  }
+
+  // The palette index of one pixel
+  uint8_t Sample( int32_t tile, int32_t x, int32_t y ) const
+  {
+    const bool set{ ( TileRow( tile, y )[x / C64_PIXELS_PER_BYTE] & ( 0x80 >> ( x % C64_PIXELS_PER_BYTE ) ) ) != 0 };
+    return static_cast<uint8_t>( set ? colors[tile] >> 4 : colors[tile] & 0x0f );
+  }
+
+  // Bytes the set keeps in memory
+  size_t MemorySize() const
+  {
+    return bits.size() + colors.size();
+  }
+};
+
+// Expands one tile into dest, which is destPitch bytes per row
+void DrawC64Tile( const C64TileSet& set, int32_t tile, uint8_t* dest, int32_t destPitch );
+
+// The same as DrawTileMap() and RenderTileMap() in tile_map.h, expanding the tiles as they're drawn
+int32_t DrawC64TileMap( const C64TileSet& set, const TileMapView& map, const TileRegion& region, uint8_t* dest,
+                        int32_t destPitch, uint8_t fill = 0 );
+int32_t RenderC64TileMap( const C64TileSet& set, const TileMapView& map, const TileRegion& region,
+                          IndexSurface& dest, int32_t numThreads = 0, uint8_t fill = 0 );
+
+// Converts a set to and from the .c64t layout. Parsing returns false if the data is cut short or isn't a tile set.
+void StoreC64TileSet( const C64TileSet& set, std::vector<uint8_t>& bytes );
+bool ParseC64TileSet( const uint8_t* data, size_t size, C64TileSet& set );
+
+bool SaveC64TileSet( const char* filename, const C64TileSet& set );
+bool LoadC64TileSet( const char* filename, C64TileSet& set );
+
+#endif // TILE_DECODE_C64_TILES_H
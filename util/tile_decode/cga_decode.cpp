@@ -0,0 +1,91 @@
+#include "cga_decode.h"
+
+#include "cpu_dispatch.h"
+
+
+const PaletteEntry cgaPalette[4] =
+{
+  { 0x00, 0x00, 0x00 }, // Black
+  { 0x55, 0xFF, 0xFF }, // Light Cyan
+  { 0xFF, 0x55, 0xFF }, // Light Magenta
+  { 0xFF, 0xFF, 0xFF }, // White
+};
+
+
+namespace
+{
+  // Where row y starts in the data. The callers check that the row fits.
+  inline size_t CgaRowOffset( const CgaLayout& layout, int32_t y )
+  {
+    const int32_t block{ y / layout.blockHeight };
+    const int32_t row{ y % layout.blockHeight };
+
+    return static_cast<size_t>( block ) * layout.bankSize * 2 + static_cast<size_t>( row & 1 ) * layout.bankSize +
+           static_cast<size_t>( row >> 1 ) * layout.bytesPerRow;
+  }
+} // namespace
+
+
+CgaLayout CgaItemLayout( int32_t width, int32_t height )
+{
+  const int32_t bytesPerRow{ width / CGA_PIXELS_PER_BYTE };
+  return CgaLayout{ bytesPerRow, height, bytesPerRow * ( height / 2 ) };
+}
+
+
+CgaLayout CgaScreenLayout( size_t size )
+{
+  return CgaLayout{ CGA_SCREEN_WIDTH / CGA_PIXELS_PER_BYTE, CGA_SCREEN_HEIGHT, static_cast<int32_t>( size / 2 ) };
+}
+
+
+int32_t DecodeCgaPacked( const uint8_t* data, size_t numBytes, const CgaLayout& layout, uint8_t* dest,
+                         int32_t destPitch, int32_t maxRows )
+{
+  const DecodeKernels& kernels{ Kernels() };
+
+  int32_t y{ 0 };
+  for( ; y < maxRows; ++y )
+  {
+    const size_t offset{ CgaRowOffset( layout, y ) };
+    if( offset + layout.bytesPerRow > numBytes )
+    {
+      break;
+    }
+
+    kernels.expand2bpp( data + offset, layout.bytesPerRow, dest + static_cast<size_t>( y ) * destPitch );
+  }
+
+  return y;
+}
+
+
+int32_t DecodeCgaPackedReference( const uint8_t* data, size_t numBytes, const CgaLayout& layout, uint8_t* dest,
+                                  int32_t destPitch, int32_t maxRows )
+{
+  const int32_t width{ layout.bytesPerRow * CGA_PIXELS_PER_BYTE };
+
+  for( int32_t y = 0; y < maxRows; ++y )
+  {
+    // Even rows of a block are in its first bank, odd rows in its second
+    const int32_t block{ y / layout.blockHeight };
+    const int32_t bank{ ( y % layout.blockHeight ) % 2 };
+    const int32_t line{ ( y % layout.blockHeight ) / 2 };
+    const size_t rowStart{ static_cast<size_t>( block * 2 + bank ) * layout.bankSize +
+                           static_cast<size_t>( line ) * layout.bytesPerRow };
+
+    if( rowStart + layout.bytesPerRow > numBytes )
+    {
+      return y;
+    }
+
+    for( int32_t x = 0; x < width; ++x )
+    {
+      const uint8_t value{ data[rowStart + x / CGA_PIXELS_PER_BYTE] };
+      const int32_t shift{ 6 - ( x % CGA_PIXELS_PER_BYTE ) * 2 };
+      dest[static_cast<size_t>( y ) * destPitch + x] = static_cast<uint8_t>( ( value >> shift ) & 0x3 );
+    }
+  }
+
+  return maxRows;
+}
@@ -0,0 +1,52 @@
+// CGA decoders for the PC Ultima 4 files.
+// CGA packs 4 pixels per byte, 2 bits each, high bits first, drawn with palette 1 (black, cyan, magenta, white).
+// Video memory keeps the even scanlines in one bank and the odd scanlines in another, and the files follow it: each
+// tile and character stores its even rows and then its odd rows, so it can be copied into both banks as two blocks,
+// and the full-screen pictures expand to a dump of both banks.
+
+// Resources:
+// https://en.wikipedia.org/wiki/Color_Graphics_Adapter
+
+#ifndef TILE_DECODE_CGA_DECODE_H
+#define TILE_DECODE_CGA_DECODE_H
+
+#include "surface.h"
+
+#define CGA_PIXELS_PER_BYTE 4
+
+#define CGA_SCREEN_WIDTH  320
+#define CGA_SCREEN_HEIGHT 200
+
+// Each bank of video memory is 8K, of which 8000 bytes are shown. Pictures are either the 16000 visible bytes or the
+// whole 16K dump.
+#define CGA_SCREEN_SIZE      16000
+#define CGA_SCREEN_DUMP_SIZE 0x4000
+
+extern const PaletteEntry cgaPalette[4];
+
+// Where the rows of interleaved data are. The data is a sequence of blocks blockHeight rows high. Within a block, the
+// even rows come first and the odd rows start bankSize bytes in, bytesPerRow bytes per row.
+struct CgaLayout
+{
+  int32_t bytesPerRow{ 0 };
+  int32_t blockHeight{ 0 };
+  int32_t bankSize{ 0 };
+};
+
+// The layout of a strip of items (tiles or characters) each width x height pixels. The height must be even.
+CgaLayout CgaItemLayout( int32_t width, int32_t height );
+
+// The layout of a 320x200 picture that expanded to size bytes: CGA_SCREEN_SIZE or CGA_SCREEN_DUMP_SIZE
+CgaLayout CgaScreenLayout( size_t size );
+
+// Decodes interleaved 2bpp rows, a row at a time through the 2bpp unpack kernel (see cpu_dispatch.h). Decoding stops
+// at the first row that runs past the end of the data, or after maxRows rows. Returns the number of rows written.
+int32_t DecodeCgaPacked( const uint8_t* data, size_t numBytes, const CgaLayout& layout, uint8_t* dest,
+                         int32_t destPitch, int32_t maxRows );
+
+// Per-pixel version of DecodeCgaPacked() that finds every pixel's byte and bit pair on its own. DecodeCgaPacked() is
+// verified against this.
+int32_t DecodeCgaPackedReference( const uint8_t* data, size_t numBytes, const CgaLayout& layout, uint8_t* dest,
+                                  int32_t destPitch, int32_t maxRows );
+
+#endif // TILE_DECODE_CGA_DECODE_H
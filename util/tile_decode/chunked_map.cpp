@@ -0,0 +1,161 @@
+#include "chunked_map.h"
+
+#include <cstring>
+#include <unordered_map>
+
+#include "parallel.h"
+
+
+namespace
+{
+  // 64-bit FNV-1a
+  uint64_t HashBytes( const uint8_t* data, size_t numBytes )
+  {
+    uint64_t hash{ 0xcbf29ce484222325ull };
+    for( size_t i = 0; i < numBytes; ++i )
+    {
+      hash ^= data[i];
+      hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+  }
+
+
+  uint8_t* ChunkPixels( IndexSurface& dest, const TileAtlas& atlas, const ChunkedMapLayout& layout, int32_t chunk )
+  {
+    const int32_t x{ ( chunk % layout.chunksWide ) * layout.chunkWidth * atlas.tileWidth };
+    const int32_t y{ ( chunk / layout.chunksWide ) * layout.chunkHeight * atlas.tileHeight };
+    return dest.Row( y ) + x;
+  }
+} // namespace
+
+
+bool RenderChunkedMap( const TileAtlas& atlas, const uint8_t* data, size_t numBytes, const ChunkedMapLayout& layout,
+                       IndexSurface& dest, int32_t numThreads, ChunkedMapStats* stats )
+{
+  INSTRUMENT_SCOPE( "render" );
+
+  if( numBytes < ChunkedMapSize( layout ) )
+  {
+    return false;
+  }
+
+  const int32_t numChunks{ layout.chunksWide * layout.chunksHigh };
+  const size_t chunkBytes{ static_cast<size_t>( layout.chunkWidth ) * layout.chunkHeight };
+
+  // Every chunk is either drawn, or a copy of the first chunk with the same contents. Hash collisions are settled by
+  // comparing the chunks, and a chunk that collides with a different one is simply drawn.
+  std::vector<int32_t> sourceChunk( static_cast<size_t>( numChunks ) );
+  std::vector<int32_t> drawnChunks;
+  {
+    INSTRUMENT_SCOPE( "hash_chunks" );
+
+    std::unordered_map<uint64_t, int32_t> firstByHash;
+    for( int32_t chunk = 0; chunk < numChunks; ++chunk )
+    {
+      const uint8_t* chunkData{ data + chunk * chunkBytes };
+      const auto inserted = firstByHash.emplace( HashBytes( chunkData, chunkBytes ), chunk );
+      const int32_t first{ inserted.first->second };
+
+      if( inserted.second || memcmp( data + first * chunkBytes, chunkData, chunkBytes ) != 0 )
+      {
+        sourceChunk[chunk] = chunk;
+        drawnChunks.push_back( chunk );
+      }
+      else
+      {
+        sourceChunk[chunk] = first;
+      }
+    }
+  }
+
+  dest.Create( layout.chunksWide * layout.chunkWidth * atlas.tileWidth,
+               layout.chunksHigh * layout.chunkHeight * atlas.tileHeight );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, dest.pixels.size() );
+
+  const TileRegion chunkRegion{ 0, 0, layout.chunkWidth, layout.chunkHeight };
+  std::vector<int32_t> numMissing( static_cast<size_t>( numChunks ), 0 );
+
+  ParallelFor( static_cast<int32_t>( drawnChunks.size() ), numThreads, [&]( int32_t item )
+  {
+    INSTRUMENT_SCOPE( "draw_chunk" );
+
+    const int32_t chunk{ drawnChunks[item] };
+    const TileMapView chunkMap{ data + chunk * chunkBytes, layout.chunkWidth, layout.chunkHeight, layout.chunkWidth,
+                                TILE_MAP_BYTE };
+
+    numMissing[chunk] = DrawTileMap( atlas, chunkMap, chunkRegion, ChunkPixels( dest, atlas, layout, chunk ),
+                                    dest.pitch );
+  } );
+
+  // Copies only read chunks drawn above, so they can run in any order
+  const size_t chunkRowBytes{ static_cast<size_t>( layout.chunkWidth ) * atlas.tileWidth };
+  const int32_t chunkPixelRows{ layout.chunkHeight * atlas.tileHeight };
+
+  ParallelFor( numChunks, numThreads, [&]( int32_t chunk )
+  {
+    if( sourceChunk[chunk] == chunk )
+    {
+      return;
+    }
+
+    INSTRUMENT_SCOPE( "copy_chunk" );
+
+    const uint8_t* src{ ChunkPixels( dest, atlas, layout, sourceChunk[chunk] ) };
+    uint8_t* out{ ChunkPixels( dest, atlas, layout, chunk ) };
+
+    for( int32_t y = 0; y < chunkPixelRows; ++y )
+    {
+      memcpy( out + static_cast<size_t>( y ) * dest.pitch, src + static_cast<size_t>( y ) * dest.pitch, chunkRowBytes );
+    }
+  } );
+
+  if( stats != nullptr )
+  {
+    stats->numChunks = numChunks;
+    stats->numDistinctChunks = static_cast<int32_t>( drawnChunks.size() );
+    stats->numMissingTiles = 0;
+
+    // Copied chunks miss the same tiles as their source
+    for( int32_t chunk = 0; chunk < numChunks; ++chunk )
+    {
+      stats->numMissingTiles += numMissing[sourceChunk[chunk]];
+    }
+  }
+
+  return true;
+}
+
+
+bool RenderChunkedMapReference( const TileAtlas& atlas, const uint8_t* data, size_t numBytes,
+                                const ChunkedMapLayout& layout, IndexSurface& dest )
+{
+  if( numBytes < ChunkedMapSize( layout ) )
+  {
+    return false;
+  }
+
+  dest.Create( layout.chunksWide * layout.chunkWidth * atlas.tileWidth,
+               layout.chunksHigh * layout.chunkHeight * atlas.tileHeight );
+
+  for( int32_t y = 0; y < dest.height; ++y )
+  {
+    for( int32_t x = 0; x < dest.width; ++x )
+    {
+      const int32_t tileX{ x / atlas.tileWidth };
+      const int32_t tileY{ y / atlas.tileHeight };
+      const int32_t chunk{ ( tileY / layout.chunkHeight ) * layout.chunksWide + tileX / layout.chunkWidth };
+      const size_t entry{ static_cast<size_t>( chunk ) * layout.chunkWidth * layout.chunkHeight +
+                          ( tileY % layout.chunkHeight ) * layout.chunkWidth + tileX % layout.chunkWidth };
+
+      const int32_t tile{ data[entry] };
+      if( tile < atlas.numTiles )
+      {
+        dest.Row( y )[x] = atlas.TileRow( tile, y % atlas.tileHeight )[x % atlas.tileWidth];
+      }
+    }
+  }
+
+  return true;
+}
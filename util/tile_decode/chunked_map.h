@@ -0,0 +1,40 @@
+// Chunked tile maps, such as the PC Ultima IV WORLD.MAP: a grid of chunks, each stored as a contiguous one byte per
+// tile map. Every distinct chunk is drawn once, straight into the output, and chunks with the same contents (the open
+// ocean) are copied from the first one drawn.
+
+#ifndef TILE_DECODE_CHUNKED_MAP_H
+#define TILE_DECODE_CHUNKED_MAP_H
+
+#include "tile_map.h"
+
+struct ChunkedMapLayout
+{
+  int32_t chunksWide;
+  int32_t chunksHigh;
+  int32_t chunkWidth;  // In tiles
+  int32_t chunkHeight; // In tiles
+};
+
+struct ChunkedMapStats
+{
+  int32_t numChunks{ 0 };
+  int32_t numDistinctChunks{ 0 };
+  int32_t numMissingTiles{ 0 };
+};
+
+// Bytes of map data the layout needs
+inline size_t ChunkedMapSize( const ChunkedMapLayout& layout )
+{
+  return static_cast<size_t>( layout.chunksWide ) * layout.chunksHigh * layout.chunkWidth * layout.chunkHeight;
+}
+
+// Draws the whole map into dest (recreated at the full pixel size) with numThreads threads, or one per core when
+// numThreads is 0. Returns false if data is shorter than the layout needs.
+bool RenderChunkedMap( const TileAtlas& atlas, const uint8_t* data, size_t numBytes, const ChunkedMapLayout& layout,
+                       IndexSurface& dest, int32_t numThreads = 0, ChunkedMapStats* stats = nullptr );
+
+// Per-pixel version of RenderChunkedMap(), which is verified against this
+bool RenderChunkedMapReference( const TileAtlas& atlas, const uint8_t* data, size_t numBytes,
+                                const ChunkedMapLayout& layout, IndexSurface& dest );
+
+#endif // TILE_DECODE_CHUNKED_MAP_H
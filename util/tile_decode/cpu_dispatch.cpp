@@ -0,0 +1,245 @@
+#include "cpu_dispatch.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "kernels.h"
+
+#if KERNELS_X86
+#if defined( _MSC_VER )
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+
+namespace
+{
+  const char* const isaNames[NumIsas] = { "scalar", "sse2", "ssse3", "avx2", "avx512" };
+
+#if KERNELS_X86
+
+  void CpuId( uint32_t leaf, uint32_t subLeaf, uint32_t registers[4] )
+  {
+#if defined( _MSC_VER )
+    int32_t values[4];
+    __cpuidex( reinterpret_cast<int*>( values ), static_cast<int>( leaf ), static_cast<int>( subLeaf ) );
+    memcpy( registers, values, sizeof( values ) );
+#else
+    __cpuid_count( leaf, subLeaf, registers[0], registers[1], registers[2], registers[3] );
+#endif
+  }
+
+
+  // The register state the OS saves on a context switch. AVX needs XMM and YMM, AVX-512 also needs the opmask and
+  // ZMM state.
+  uint64_t EnabledXStateFeatures()
+  {
+#if defined( _MSC_VER )
+    return _xgetbv( 0 );
+#else
+    uint32_t low;
+    uint32_t high;
+    __asm__( "xgetbv" : "=a"( low ), "=d"( high ) : "c"( 0 ) );
+    return ( static_cast<uint64_t>( high ) << 32 ) | low;
+#endif
+  }
+
+
+  Isa ProbeIsa()
+  {
+    uint32_t registers[4];
+    CpuId( 0, 0, registers );
+    const uint32_t maxLeaf{ registers[0] };
+
+    CpuId( 1, 0, registers );
+    const bool sse2{ ( registers[3] & ( 1u << 26 ) ) != 0 };
+    const bool ssse3{ ( registers[2] & ( 1u << 9 ) ) != 0 };
+    const bool osxsave{ ( registers[2] & ( 1u << 27 ) ) != 0 };
+    const bool avx{ ( registers[2] & ( 1u << 28 ) ) != 0 };
+
+    if( !sse2 )
+    {
+      return IsaScalar;
+    }
+
+    if( !ssse3 )
+    {
+      return IsaSse2;
+    }
+
+    if( !osxsave || !avx || maxLeaf < 7 )
+    {
+      return IsaSsse3;
+    }
+
+    const uint64_t xstate{ EnabledXStateFeatures() };
+    if( ( xstate & 0x6 ) != 0x6 )
+    {
+      return IsaSsse3;
+    }
+
+    CpuId( 7, 0, registers );
+    const bool avx2{ ( registers[1] & ( 1u << 5 ) ) != 0 };
+    const bool avx512f{ ( registers[1] & ( 1u << 16 ) ) != 0 };
+    const bool avx512bw{ ( registers[1] & ( 1u << 30 ) ) != 0 };
+
+    if( !avx2 )
+    {
+      return IsaSsse3;
+    }
+
+    if( !avx512f || !avx512bw || ( xstate & 0xe6 ) != 0xe6 )
+    {
+      return IsaAvx2;
+    }
+
+    return IsaAvx512;
+  }
+
+#else
+
+  Isa ProbeIsa()
+  {
+    return IsaScalar;
+  }
+
+#endif // KERNELS_X86
+
+
+  DecodeKernels& BoundKernels()
+  {
+    static DecodeKernels kernels{ BindKernels( DetectIsa() ) };
+    return kernels;
+  }
+} // namespace
+
+
+const char* IsaName( Isa isa )
+{
+  return isa >= IsaScalar && isa < NumIsas ? isaNames[isa] : "unknown";
+}
+
+
+Isa DetectIsa()
+{
+  static const Isa detected{ ProbeIsa() };
+  return detected;
+}
+
+
+bool IsaSupported( Isa isa )
+{
+  return isa >= IsaScalar && isa <= DetectIsa();
+}
+
+
+DecodeKernels BindKernels( Isa isa )
+{
+  DecodeKernels kernels{ isa, ExpandNibblesScalar, Expand2bppScalar, FillPairsScalar, ExpandHiresScalar,
+                         MapIndices32Scalar, MapIndices16Scalar, BoxFilter2xScalar, RunLengthScalar,
+                         CountPixelDifferencesScalar };
+
+#if KERNELS_X86
+  if( isa >= IsaSse2 )
+  {
+    kernels.expandNibbles = ExpandNibblesSse2;
+    kernels.expand2bpp = Expand2bppSse2;
+    kernels.fillPairs = FillPairsSse2;
+    kernels.expandHires = ExpandHiresSse2;
+    kernels.boxFilter2x = BoxFilter2xSse2;
+    kernels.runLength = RunLengthSse2;
+  }
+
+  if( isa >= IsaSsse3 )
+  {
+    kernels.mapIndices32 = MapIndices32Ssse3;
+    kernels.mapIndices16 = MapIndices16Ssse3;
+    kernels.countPixelDifferences = CountPixelDifferencesSsse3;
+  }
+
+  // There is no 256-bit 16-bit permute below AVX-512, so 16-bit palettes stay on the SSSE3 lookup at this level
+  if( isa >= IsaAvx2 )
+  {
+    kernels.expandNibbles = ExpandNibblesAvx2;
+    kernels.expand2bpp = Expand2bppAvx2;
+    kernels.fillPairs = FillPairsAvx2;
+    kernels.expandHires = ExpandHiresAvx2;
+    kernels.mapIndices32 = MapIndices32Avx2;
+    kernels.boxFilter2x = BoxFilter2xAvx2;
+    kernels.runLength = RunLengthAvx2;
+    kernels.countPixelDifferences = CountPixelDifferencesAvx2;
+  }
+
+  // RLE runs are too short for 512-bit stores to pay off, so fillPairs stays on AVX2. So do the pyramid rows, which
+  // are only 256 pixels, the CGA rows, which are only 4 bytes in tiles, and the RLE run scans, since most runs end
+  // within 32 bytes. The pixel difference counts only ever see 64 byte blocks, so they stay on AVX2 as well.
+  if( isa >= IsaAvx512 )
+  {
+    kernels.expandNibbles = ExpandNibblesAvx512;
+    kernels.expandHires = ExpandHiresAvx512;
+    kernels.mapIndices32 = MapIndices32Avx512;
+    kernels.mapIndices16 = MapIndices16Avx512;
+  }
+#endif // KERNELS_X86
+
+  return kernels;
+}
+
+
+const DecodeKernels& Kernels()
+{
+  return BoundKernels();
+}
+
+
+bool SetKernelIsa( Isa isa )
+{
+  if( !IsaSupported( isa ) )
+  {
+    return false;
+  }
+
+  BoundKernels() = BindKernels( isa );
+  return true;
+}
+
+
+bool ApplyForceIsaOption( int argc, char* argv[] )
+{
+  for( int i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--force-isa" ) != 0 )
+    {
+      continue;
+    }
+
+    if( i + 1 >= argc )
+    {
+      printf( "--force-isa needs one of: scalar sse2 ssse3 avx2 avx512\n" );
+      return false;
+    }
+
+    const char* name{ argv[i + 1] };
+    for( int32_t isa = IsaScalar; isa < NumIsas; ++isa )
+    {
+      if( strcmp( name, isaNames[isa] ) == 0 )
+      {
+        if( !SetKernelIsa( static_cast<Isa>( isa ) ) )
+        {
+          printf( "--force-isa %s: this CPU only supports up to %s\n", name, IsaName( DetectIsa() ) );
+          return false;
+        }
+
+        printf( "Using %s kernels\n", name );
+        return true;
+      }
+    }
+
+    printf( "--force-isa: unknown instruction set '%s', expected one of: scalar sse2 ssse3 avx2 avx512\n", name );
+    return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,88 @@
+// Runtime CPU-feature dispatch for the decode kernels.
+// The CPU is probed once, and every kernel is bound to the best variant it supports. --force-isa picks a lower level
+// instead, so every variant can be tested and benchmarked on one machine.
+//
+// The Apple hi-res span decoder isn't dispatched: each pixel depends on the one before it through the carry bit, and
+// the byte-at-a-time table lookup in DecodeAppleSpan() is already faster than anything the vector units can do with
+// that dependency.
+
+#ifndef TILE_DECODE_CPU_DISPATCH_H
+#define TILE_DECODE_CPU_DISPATCH_H
+
+#include "surface.h"
+
+enum Isa
+{
+  IsaScalar,
+  IsaSse2,
+  IsaSsse3,
+  IsaAvx2,
+  IsaAvx512, // AVX-512 F + BW
+  NumIsas
+};
+
+// How many pixels differ between two bytes of packed pixels, given their XOR x: low[x & 15] + high[x >> 4], but no
+// more than cap. 8bpp pixels, which differ or don't as a whole byte, use a cap of 1.
+struct PixelDifferenceTable
+{
+  uint8_t low[16];
+  uint8_t high[16];
+  uint8_t cap;
+};
+
+struct DecodeKernels
+{
+  Isa isa;
+
+  // EGA: expands count packed 4bpp bytes into 2 * count indices, high nibble first
+  void ( *expandNibbles )( const uint8_t* src, int32_t count, uint8_t* dest );
+
+  // CGA: expands count packed 2bpp bytes into 4 * count indices, high bits first
+  void ( *expand2bpp )( const uint8_t* src, int32_t count, uint8_t* dest );
+
+  // EGA RLE: writes count copies of the pixel pair first, second
+  void ( *fillPairs )( uint8_t* dest, int32_t count, uint8_t first, uint8_t second );
+
+  // C64: expands count hires bitmap bytes into 8 * count indices. colors[i] holds the foreground (high nibble) and
+  // background (low nibble) of bits[i].
+  void ( *expandHires )( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+
+  // Palette: maps count indices through a 256 entry color table, of which the first tableSize entries are in use.
+  // Every index must be below tableSize. Small tables (every palette the rippers use) take the register lookup paths.
+  void ( *mapIndices32 )( const uint8_t* src, int32_t count, const uint32_t* table, int32_t tableSize,
+                          uint32_t* dest );
+  void ( *mapIndices16 )( const uint8_t* src, int32_t count, const uint16_t* table, int32_t tableSize,
+                          uint16_t* dest );
+
+  // Pyramids: halves two rows of 32-bit pixels into count pixels, each byte the rounded mean of a 2x2 block
+  void ( *boxFilter2x )( const uint32_t* row0, const uint32_t* row1, int32_t count, uint32_t* dest );
+
+  // RLE encoding: the number of leading bytes of src[0, count) that equal src[0] (0 if count is 0)
+  int32_t ( *runLength )( const uint8_t* src, int32_t count );
+
+  // Geometry sniffing: the number of pixels that differ between count bytes of packed pixels at a and at b
+  int32_t ( *countPixelDifferences )( const uint8_t* a, const uint8_t* b, int32_t count,
+                                      const PixelDifferenceTable& table );
+};
+
+const char* IsaName( Isa isa );
+
+// The best level this CPU (and OS) supports, probed on the first call
+Isa DetectIsa();
+
+bool IsaSupported( Isa isa );
+
+// The kernels for a given level, for testing. Levels the CPU doesn't support must not be called.
+DecodeKernels BindKernels( Isa isa );
+
+// The kernels in use, bound to DetectIsa() on first use
+const DecodeKernels& Kernels();
+
+// Rebinds Kernels() to a lower level. Returns false if the CPU doesn't support it.
+bool SetKernelIsa( Isa isa );
+
+// Handles --force-isa scalar|sse2|ssse3|avx2|avx512. Returns false (after printing why) if the name is unknown or
+// this CPU can't run it.
+bool ApplyForceIsaOption( int argc, char* argv[] );
+
+#endif // TILE_DECODE_CPU_DISPATCH_H
@@ -0,0 +1,565 @@
+#include "d64_image.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "../instrument/instrument.h"
+
+#define D64_SECTORS_35_TRACKS 683
+#define D64_SECTORS_40_TRACKS 768
+
+// Where 1541 DOS puts the directory, and how far it steps between a file's sectors
+#define BAM_SECTOR       0
+#define DIRECTORY_SECTOR 1
+#define SECTOR_INTERLEAVE 10
+
+#define DIRECTORY_ENTRY_SIZE   32
+#define ENTRIES_PER_SECTOR     ( D64_SECTOR_SIZE / DIRECTORY_ENTRY_SIZE )
+#define ENTRY_TYPE             2
+#define ENTRY_FIRST_TRACK      3
+#define ENTRY_FIRST_SECTOR     4
+#define ENTRY_NAME             5
+#define ENTRY_NUM_SECTORS      30
+#define FILE_TYPE_CLOSED_PRG   0x82
+#define NAME_PADDING           0xa0
+
+// Track n's entry in the BAM sector: the number of free sectors, then a bit per sector
+#define BAM_ENTRIES_OFFSET 4
+#define BAM_DISK_NAME      0x90
+
+
+namespace
+{
+  int32_t SectorsPerTrack( int32_t track )
+  {
+    return track <= 17 ? 21 : track <= 24 ? 19 : track <= 30 ? 18 : 17;
+  }
+
+
+  // The index of the first sector of every track
+  struct TrackTable
+  {
+    int32_t firstSector[D64_MAX_TRACKS + 2];
+
+    TrackTable()
+    {
+      firstSector[0] = 0;
+      firstSector[1] = 0;
+      for( int32_t track = 1; track <= D64_MAX_TRACKS; ++track )
+      {
+        firstSector[track + 1] = firstSector[track] + SectorsPerTrack( track );
+      }
+    }
+  };
+
+  const TrackTable trackTable;
+
+
+  int32_t CountBits( uint32_t value )
+  {
+    int32_t count{ 0 };
+    for( ; value != 0; value &= value - 1 )
+    {
+      ++count;
+    }
+
+    return count;
+  }
+
+
+  // A directory name: the name's bytes, padded out with shifted spaces
+  void MakeName( const char* name, uint8_t padded[D64_NAME_SIZE] )
+  {
+    memset( padded, NAME_PADDING, D64_NAME_SIZE );
+
+    const size_t length{ strlen( name ) };
+    memcpy( padded, name, length < D64_NAME_SIZE ? length : D64_NAME_SIZE );
+  }
+} // namespace
+
+
+bool D64Image::Open( const char* filename )
+{
+  std::vector<uint8_t> bytes;
+  if( !ReadFileBytes( filename, bytes ) || !Load( bytes.data(), bytes.size() ) )
+  {
+    return false;
+  }
+
+  m_filename = filename;
+  return true;
+}
+
+
+bool D64Image::Load( const uint8_t* data, size_t size )
+{
+  if( size == D64_SECTORS_35_TRACKS * D64_SECTOR_SIZE || size == D64_SECTORS_35_TRACKS * ( D64_SECTOR_SIZE + 1 ) )
+  {
+    m_numTracks = D64_NUM_TRACKS;
+    m_numSectors = D64_SECTORS_35_TRACKS;
+  }
+  else if( size == D64_SECTORS_40_TRACKS * D64_SECTOR_SIZE ||
+           size == D64_SECTORS_40_TRACKS * ( D64_SECTOR_SIZE + 1 ) )
+  {
+    m_numTracks = D64_MAX_TRACKS;
+    m_numSectors = D64_SECTORS_40_TRACKS;
+  }
+  else
+  {
+    return false;
+  }
+
+  m_bytes.assign( data, data + size );
+  m_filename.clear();
+
+  ResetChanges();
+  ReadBam();
+  return true;
+}
+
+
+void D64Image::Format( const char* diskName )
+{
+  m_bytes.assign( D64_SECTORS_35_TRACKS * D64_SECTOR_SIZE, 0 );
+  m_filename.clear();
+  m_numTracks = D64_NUM_TRACKS;
+  m_numSectors = D64_SECTORS_35_TRACKS;
+
+  // The BAM sector links to the first directory sector, and holds the disk name and ID
+  uint8_t* bam{ &m_bytes[SectorOffset( D64_DIRECTORY_TRACK, BAM_SECTOR )] };
+  bam[0] = D64_DIRECTORY_TRACK;
+  bam[1] = DIRECTORY_SECTOR;
+  bam[2] = 0x41;
+
+  MakeName( diskName, bam + BAM_DISK_NAME );
+  memset( bam + BAM_DISK_NAME + D64_NAME_SIZE, NAME_PADDING, 11 );
+  memcpy( bam + BAM_DISK_NAME + D64_NAME_SIZE + 2, "00", 2 );
+  memcpy( bam + BAM_DISK_NAME + D64_NAME_SIZE + 5, "2A", 2 );
+
+  // An empty directory sector that ends the chain
+  uint8_t* directory{ &m_bytes[SectorOffset( D64_DIRECTORY_TRACK, DIRECTORY_SECTOR )] };
+  directory[1] = 0xff;
+
+  ResetChanges();
+
+  for( int32_t track = 1; track <= D64_NUM_TRACKS; ++track )
+  {
+    m_freeMaps[track] = ( 1u << SectorsPerTrack( track ) ) - 1;
+  }
+
+  m_freeMaps[D64_DIRECTORY_TRACK] &= ~( ( 1u << BAM_SECTOR ) | ( 1u << DIRECTORY_SECTOR ) );
+  m_bamChanged = true;
+  StoreBam();
+
+  ResetChanges();
+}
+
+
+long D64Image::SectorOffset( int32_t track, int32_t sector ) const
+{
+  if( track < 1 || track > m_numTracks || sector < 0 || sector >= SectorsPerTrack( track ) )
+  {
+    return -1;
+  }
+
+  return static_cast<long>( trackTable.firstSector[track] + sector ) * D64_SECTOR_SIZE;
+}
+
+
+bool D64Image::WriteBytes( size_t offset, const uint8_t* data, size_t size )
+{
+  const size_t imageSize{ static_cast<size_t>( m_numSectors ) * D64_SECTOR_SIZE };
+  if( offset > imageSize || size > imageSize - offset )
+  {
+    return false;
+  }
+
+  while( size > 0 )
+  {
+    const int32_t index{ static_cast<int32_t>( offset / D64_SECTOR_SIZE ) };
+    const size_t start{ offset % D64_SECTOR_SIZE };
+    const size_t count{ D64_SECTOR_SIZE - start < size ? D64_SECTOR_SIZE - start : size };
+
+    uint8_t sector[D64_SECTOR_SIZE];
+    memcpy( sector, &m_bytes[static_cast<size_t>( index ) * D64_SECTOR_SIZE], D64_SECTOR_SIZE );
+    memcpy( sector + start, data, count );
+    WriteSector( index, sector );
+
+    offset += count;
+    data += count;
+    size -= count;
+  }
+
+  return true;
+}
+
+
+bool D64Image::ReadFile( const char* name, std::vector<uint8_t>& data ) const
+{
+  DirectoryEntry entry;
+  if( !FindEntry( name, entry ) || !entry.exists )
+  {
+    return false;
+  }
+
+  std::vector<int32_t> chain;
+  if( !ReadChain( m_bytes[entry.offset + ENTRY_FIRST_TRACK], m_bytes[entry.offset + ENTRY_FIRST_SECTOR], chain ) )
+  {
+    return false;
+  }
+
+  data.clear();
+  for( size_t i = 0; i < chain.size(); ++i )
+  {
+    const uint8_t* sector{ &m_bytes[SectorOffset( chain[i] >> 8, chain[i] & 0xff )] };
+
+    // The last sector's link holds the offset of its last byte instead
+    const size_t count{ i + 1 < chain.size() ? D64_SECTOR_DATA_SIZE : ( sector[1] > 1 ? sector[1] - 1u : 0u ) };
+    data.insert( data.end(), sector + 2, sector + 2 + count );
+  }
+
+  return true;
+}
+
+
+bool D64Image::WriteFile( const char* name, const std::vector<uint8_t>& data )
+{
+  INSTRUMENT_SCOPE( "write_file" );
+
+  DirectoryEntry entry;
+  if( !FindEntry( name, entry ) )
+  {
+    return false;
+  }
+
+  std::vector<int32_t> chain;
+  if( entry.exists &&
+      !ReadChain( m_bytes[entry.offset + ENTRY_FIRST_TRACK], m_bytes[entry.offset + ENTRY_FIRST_SECTOR], chain ) )
+  {
+    return false;
+  }
+
+  // Even an empty file takes a sector
+  const size_t numNeeded{ data.empty() ? 1 : ( data.size() + D64_SECTOR_DATA_SIZE - 1 ) / D64_SECTOR_DATA_SIZE };
+  if( numNeeded > chain.size() && static_cast<size_t>( FreeSectors() ) < numNeeded - chain.size() )
+  {
+    return false;
+  }
+
+  while( chain.size() < numNeeded )
+  {
+    const int32_t last{ chain.empty() ? ( ( D64_DIRECTORY_TRACK - 1 ) << 8 ) : chain.back() };
+
+    int32_t track;
+    int32_t sector;
+    AllocateSector( last >> 8, chain.empty() ? -SECTOR_INTERLEAVE : last & 0xff, track, sector );
+    chain.push_back( ( track << 8 ) | sector );
+  }
+
+  while( chain.size() > numNeeded )
+  {
+    FreeSector( chain.back() >> 8, chain.back() & 0xff );
+    chain.pop_back();
+  }
+
+  for( size_t i = 0; i < chain.size(); ++i )
+  {
+    const size_t start{ i * D64_SECTOR_DATA_SIZE };
+    const size_t count{ data.size() - start < D64_SECTOR_DATA_SIZE ? data.size() - start : D64_SECTOR_DATA_SIZE };
+
+    uint8_t sector[D64_SECTOR_SIZE];
+    memcpy( sector, &m_bytes[SectorOffset( chain[i] >> 8, chain[i] & 0xff )], D64_SECTOR_SIZE );
+
+    if( i + 1 < chain.size() )
+    {
+      sector[0] = static_cast<uint8_t>( chain[i + 1] >> 8 );
+      sector[1] = static_cast<uint8_t>( chain[i + 1] & 0xff );
+    }
+    else
+    {
+      sector[0] = 0;
+      sector[1] = static_cast<uint8_t>( count + 1 );
+    }
+
+    if( count > 0 )
+    {
+      memcpy( sector + 2, &data[start], count );
+    }
+
+    WriteSector( SectorOffset( chain[i] >> 8, chain[i] & 0xff ) / D64_SECTOR_SIZE, sector );
+  }
+
+  // The entry itself, leaving the directory link that shares the first entry's bytes alone
+  uint8_t fields[DIRECTORY_ENTRY_SIZE];
+  memcpy( fields, &m_bytes[entry.offset], DIRECTORY_ENTRY_SIZE );
+
+  if( !entry.exists )
+  {
+    memset( fields + ENTRY_TYPE, 0, DIRECTORY_ENTRY_SIZE - ENTRY_TYPE );
+    fields[ENTRY_TYPE] = FILE_TYPE_CLOSED_PRG;
+    MakeName( name, fields + ENTRY_NAME );
+  }
+
+  fields[ENTRY_FIRST_TRACK] = static_cast<uint8_t>( chain[0] >> 8 );
+  fields[ENTRY_FIRST_SECTOR] = static_cast<uint8_t>( chain[0] & 0xff );
+  fields[ENTRY_NUM_SECTORS] = static_cast<uint8_t>( chain.size() & 0xff );
+  fields[ENTRY_NUM_SECTORS + 1] = static_cast<uint8_t>( chain.size() >> 8 );
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, data.size() );
+  StoreBam();
+  return WriteBytes( static_cast<size_t>( entry.offset ), fields, DIRECTORY_ENTRY_SIZE );
+}
+
+
+int32_t D64Image::FreeSectors() const
+{
+  int32_t count{ 0 };
+  for( int32_t track = 1; track <= D64_NUM_TRACKS; ++track )
+  {
+    if( track != D64_DIRECTORY_TRACK )
+    {
+      count += CountBits( m_freeMaps[track] );
+    }
+  }
+
+  return count;
+}
+
+
+int32_t D64Image::NumChangedSectors() const
+{
+  int32_t count{ 0 };
+  for( const uint8_t changed : m_changed )
+  {
+    count += changed;
+  }
+
+  return count;
+}
+
+
+bool D64Image::Save( const char* filename )
+{
+  return WriteFileBytes( filename, m_bytes );
+}
+
+
+bool D64Image::SaveChanges()
+{
+  INSTRUMENT_SCOPE( "write" );
+
+  if( m_filename.empty() )
+  {
+    return false;
+  }
+
+  FILE* file{ fopen( m_filename.c_str(), "r+b" ) };
+  if( file == nullptr )
+  {
+    return false;
+  }
+
+  // Runs of changed sectors go out in one write each
+  bool written{ true };
+  for( int32_t index = 0; index < m_numSectors && written; ++index )
+  {
+    if( !m_changed[index] )
+    {
+      continue;
+    }
+
+    int32_t end{ index + 1 };
+    while( end < m_numSectors && m_changed[end] )
+    {
+      ++end;
+    }
+
+    const size_t offset{ static_cast<size_t>( index ) * D64_SECTOR_SIZE };
+    const size_t size{ static_cast<size_t>( end - index ) * D64_SECTOR_SIZE };
+    written = fseek( file, static_cast<long>( offset ), SEEK_SET ) == 0 &&
+              fwrite( &m_bytes[offset], size, 1, file ) == 1;
+
+    INSTRUMENT_COUNT( COUNTER_BYTES_OUT, size );
+    index = end;
+  }
+
+  const bool closed{ fclose( file ) == 0 };
+  if( !written || !closed )
+  {
+    return false;
+  }
+
+  ResetChanges();
+  return true;
+}
+
+
+void D64Image::ResetChanges()
+{
+  m_changed.assign( static_cast<size_t>( m_numSectors ), 0 );
+  m_bamChanged = false;
+}
+
+
+void D64Image::ReadBam()
+{
+  const uint8_t* bam{ &m_bytes[SectorOffset( D64_DIRECTORY_TRACK, BAM_SECTOR )] };
+
+  m_freeMaps[0] = 0;
+  for( int32_t track = 1; track <= D64_NUM_TRACKS; ++track )
+  {
+    const uint8_t* bits{ bam + BAM_ENTRIES_OFFSET + ( track - 1 ) * 4 + 1 };
+    m_freeMaps[track] = ( bits[0] | ( bits[1] << 8 ) | ( bits[2] << 16 ) ) & ( ( 1u << SectorsPerTrack( track ) ) - 1 );
+  }
+}
+
+
+// Stores the cached BAM back into its sector in the image, if any sector changed hands. The free counts are rebuilt
+// from the bits.
+void D64Image::StoreBam()
+{
+  if( !m_bamChanged )
+  {
+    return;
+  }
+
+  const int32_t index{ trackTable.firstSector[D64_DIRECTORY_TRACK] + BAM_SECTOR };
+
+  uint8_t bam[D64_SECTOR_SIZE];
+  memcpy( bam, &m_bytes[static_cast<size_t>( index ) * D64_SECTOR_SIZE], D64_SECTOR_SIZE );
+
+  for( int32_t track = 1; track <= D64_NUM_TRACKS; ++track )
+  {
+    uint8_t* entry{ bam + BAM_ENTRIES_OFFSET + ( track - 1 ) * 4 };
+    entry[0] = static_cast<uint8_t>( CountBits( m_freeMaps[track] ) );
+    entry[1] = static_cast<uint8_t>( m_freeMaps[track] );
+    entry[2] = static_cast<uint8_t>( m_freeMaps[track] >> 8 );
+    entry[3] = static_cast<uint8_t>( m_freeMaps[track] >> 16 );
+  }
+
+  WriteSector( index, bam );
+  m_bamChanged = false;
+}
+
+
+void D64Image::WriteSector( int32_t index, const uint8_t* data )
+{
+  uint8_t* sector{ &m_bytes[static_cast<size_t>( index ) * D64_SECTOR_SIZE] };
+  if( memcmp( sector, data, D64_SECTOR_SIZE ) != 0 )
+  {
+    memcpy( sector, data, D64_SECTOR_SIZE );
+    m_changed[index] = 1;
+  }
+}
+
+
+// Finds the file's entry, or the first free one if it doesn't exist. Returns false if the file doesn't exist and
+// there's no free entry, or the directory chain is broken.
+bool D64Image::FindEntry( const char* name, DirectoryEntry& entry ) const
+{
+  uint8_t padded[D64_NAME_SIZE];
+  MakeName( name, padded );
+
+  std::vector<int32_t> directory;
+  if( !ReadChain( D64_DIRECTORY_TRACK, DIRECTORY_SECTOR, directory ) )
+  {
+    return false;
+  }
+
+  entry = DirectoryEntry();
+  for( const int32_t location : directory )
+  {
+    const long sectorOffset{ SectorOffset( location >> 8, location & 0xff ) };
+
+    for( int32_t i = 0; i < ENTRIES_PER_SECTOR; ++i )
+    {
+      const long offset{ sectorOffset + i * DIRECTORY_ENTRY_SIZE };
+      const uint8_t* fields{ &m_bytes[offset] };
+
+      if( fields[ENTRY_TYPE] == 0 )
+      {
+        if( entry.offset < 0 )
+        {
+          entry.offset = offset;
+        }
+      }
+      else if( memcmp( fields + ENTRY_NAME, padded, D64_NAME_SIZE ) == 0 )
+      {
+        entry.offset = offset;
+        entry.exists = true;
+        return true;
+      }
+    }
+  }
+
+  return entry.offset >= 0;
+}
+
+
+// Follows a sector chain from its first sector, as packed track << 8 | sector values. Returns false if a link points
+// off the disk or the chain loops.
+bool D64Image::ReadChain( int32_t track, int32_t sector, std::vector<int32_t>& chain ) const
+{
+  chain.clear();
+
+  while( track != 0 )
+  {
+    const long offset{ SectorOffset( track, sector ) };
+    if( offset < 0 || chain.size() >= static_cast<size_t>( m_numSectors ) )
+    {
+      return false;
+    }
+
+    chain.push_back( ( track << 8 ) | sector );
+    track = m_bytes[offset];
+    sector = m_bytes[offset + 1];
+  }
+
+  return true;
+}
+
+
+// Takes the first free sector on the track nearest nearTrack, starting an interleave step past nearSector on
+// nearTrack itself, the way 1541 DOS spreads a file out. The directory track is never used.
+bool D64Image::AllocateSector( int32_t nearTrack, int32_t nearSector, int32_t& track, int32_t& sector )
+{
+  for( int32_t distance = 0; distance < D64_NUM_TRACKS; ++distance )
+  {
+    const int32_t candidates[2] = { nearTrack - distance, nearTrack + distance };
+
+    for( int32_t j = 0; j < ( distance == 0 ? 1 : 2 ); ++j )
+    {
+      track = candidates[j];
+      if( track < 1 || track > D64_NUM_TRACKS || track == D64_DIRECTORY_TRACK || m_freeMaps[track] == 0 )
+      {
+        continue;
+      }
+
+      const int32_t numSectors{ SectorsPerTrack( track ) };
+      const int32_t start{ track == nearTrack ? ( nearSector + SECTOR_INTERLEAVE + numSectors ) % numSectors : 0 };
+
+      for( int32_t i = 0; i < numSectors; ++i )
+      {
+        sector = ( start + i ) % numSectors;
+        if( m_freeMaps[track] & ( 1u << sector ) )
+        {
+          m_freeMaps[track] &= ~( 1u << sector );
+          m_bamChanged = true;
+          return true;
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+
+void D64Image::FreeSector( int32_t track, int32_t sector )
+{
+  if( track >= 1 && track <= D64_NUM_TRACKS )
+  {
+    m_freeMaps[track] |= 1u << sector;
+    m_bamChanged = true;
+  }
+}
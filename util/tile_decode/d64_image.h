@@ -0,0 +1,112 @@
+// Commodore 1541 disk images (.d64), read and patched in memory for putting edited graphics back onto the disks.
+//
+// An image is the disk's 256 byte sectors one after another, track 1 first. Tracks 1-17 have 21 sectors, 18-24 have
+// 19, 25-30 have 18 and 31-40 have 17. Images of 35 and 40 tracks are accepted, with or without the error byte per
+// sector that some dumps append; the error bytes are kept as they are.
+//
+// Graphics that the games load from fixed sectors are patched in place with WriteBytes(). DOS files go through
+// WriteFile(), which rewrites the file's sector chain, taking sectors from or giving them back to the block
+// availability map (BAM) on track 18. The BAM is decoded once when the image is loaded and kept as a bitmap per track, so
+// allocating a sector is a bit test, and the BAM sector is only rebuilt when a file gained or lost sectors.
+//
+// Every write compares against what's already on the disk and only marks sectors whose bytes actually change, so
+// SaveChanges() can update an image in place without touching anything else.
+
+#ifndef TILE_DECODE_D64_IMAGE_H
+#define TILE_DECODE_D64_IMAGE_H
+
+#include <string>
+
+#include "surface.h"
+
+#define D64_SECTOR_SIZE      256
+#define D64_SECTOR_DATA_SIZE 254
+#define D64_NUM_TRACKS       35
+#define D64_MAX_TRACKS       40
+#define D64_DIRECTORY_TRACK  18
+
+// The longest file name the directory holds
+#define D64_NAME_SIZE 16
+
+class D64Image
+{
+public:
+  // Reads an image from a file and remembers the file for SaveChanges(). Returns false if it can't be read or isn't
+  // the size of a 35 or 40 track image.
+  bool Open( const char* filename );
+
+  // Takes an image from memory. SaveChanges() can't be used on it.
+  bool Load( const uint8_t* data, size_t size );
+
+  // Starts a blank formatted 35 track disk in memory, with an empty directory
+  void Format( const char* diskName );
+
+  const uint8_t* Data() const
+  {
+    return m_bytes.data();
+  }
+
+  size_t Size() const
+  {
+    return m_bytes.size();
+  }
+
+  // Offset of a sector in the image, or -1 if the disk doesn't have it
+  long SectorOffset( int32_t track, int32_t sector ) const;
+
+  // Overwrites bytes at an image offset, as the games that load from fixed sectors see it. Returns false if the range
+  // runs past the last sector.
+  bool WriteBytes( size_t offset, const uint8_t* data, size_t size );
+
+  // Reads a file through its sector chain. Returns false if there's no such file or its chain is broken.
+  bool ReadFile( const char* name, std::vector<uint8_t>& data ) const;
+
+  // Replaces the contents of a file, or creates it as a PRG file if it doesn't exist. The file's sectors are reused in
+  // order, and any it needs beyond them come from the BAM, as close to its last sector as possible. Sectors it no
+  // longer needs are freed. Returns false, without changing anything, if the disk is full, the directory has no free
+  // entry, or the file's chain is broken.
+  bool WriteFile( const char* name, const std::vector<uint8_t>& data );
+
+  // The number of free sectors, outside the directory track
+  int32_t FreeSectors() const;
+
+  // The number of sectors that differ from the image as it was opened
+  int32_t NumChangedSectors() const;
+
+  // Writes the whole image to a file
+  bool Save( const char* filename );
+
+  // Writes just the changed sectors back to the file the image was opened from
+  bool SaveChanges();
+
+private:
+  struct DirectoryEntry
+  {
+    long offset{ -1 };
+    bool exists{ false };
+  };
+
+  void ResetChanges();
+  void ReadBam();
+  void StoreBam();
+  void WriteSector( int32_t index, const uint8_t* data );
+
+  bool FindEntry( const char* name, DirectoryEntry& entry ) const;
+  bool ReadChain( int32_t track, int32_t sector, std::vector<int32_t>& chain ) const;
+  bool AllocateSector( int32_t nearTrack, int32_t nearSector, int32_t& track, int32_t& sector );
+  void FreeSector( int32_t track, int32_t sector );
+
+  std::vector<uint8_t> m_bytes;
+  std::string m_filename;
+  int32_t m_numTracks{ 0 };
+  int32_t m_numSectors{ 0 };
+
+  // One flag per sector
+  std::vector<uint8_t> m_changed;
+
+  // The free sectors of each track, bit n for sector n, as last read from or stored to the BAM sector
+  uint32_t m_freeMaps[D64_NUM_TRACKS + 1]{};
+  bool m_bamChanged{ false };
+};
+
+#endif // TILE_DECODE_D64_IMAGE_H
@@ -0,0 +1,137 @@
+#include "datafile_writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <utility>
+
+
+namespace
+{
+  // pack_mputl() and pack_mputw(): most significant byte first
+  void PutLong( std::vector<uint8_t>& bytes, uint32_t value )
+  {
+    const uint8_t data[] = { static_cast<uint8_t>( value >> 24 ), static_cast<uint8_t>( value >> 16 ),
+                             static_cast<uint8_t>( value >> 8 ), static_cast<uint8_t>( value ) };
+    bytes.insert( bytes.end(), data, data + 4 );
+  }
+
+
+  void PutWord( std::vector<uint8_t>& bytes, uint16_t value )
+  {
+    bytes.push_back( static_cast<uint8_t>( value >> 8 ) );
+    bytes.push_back( static_cast<uint8_t>( value ) );
+  }
+} // namespace
+
+
+void DatafileWriter::AddPalette( const char* name, const PaletteEntry* palette, int32_t paletteSize )
+{
+  Object object{ DATAFILE_PALETTE, name, {} };
+  object.data.assign( DATAFILE_PALETTE_SIZE * 3, 0 );
+
+  for( int32_t i = 0; i < paletteSize && i < DATAFILE_PALETTE_SIZE; ++i )
+  {
+    object.data[i * 3] = static_cast<uint8_t>( palette[i].r >> 2 );
+    object.data[i * 3 + 1] = static_cast<uint8_t>( palette[i].g >> 2 );
+    object.data[i * 3 + 2] = static_cast<uint8_t>( palette[i].b >> 2 );
+  }
+
+  m_objects.push_back( std::move( object ) );
+}
+
+
+void DatafileWriter::AddBitmap( const char* name, const uint8_t* pixels, int32_t pitch, int32_t width,
+                                int32_t height )
+{
+  // Bits per pixel, width and height, then the rows
+  Object object{ DATAFILE_BITMAP, name, {} };
+  object.data.reserve( 6 + static_cast<size_t>( width ) * height );
+  PutWord( object.data, 8 );
+  PutWord( object.data, static_cast<uint16_t>( width ) );
+  PutWord( object.data, static_cast<uint16_t>( height ) );
+
+  for( int32_t y = 0; y < height; ++y )
+  {
+    const uint8_t* row{ pixels + static_cast<size_t>( y ) * pitch };
+    object.data.insert( object.data.end(), row, row + width );
+  }
+
+  m_objects.push_back( std::move( object ) );
+}
+
+
+int32_t DatafileWriter::AddSheet( const char* prefix, const IndexSurface& sheet, int32_t tileWidth,
+                                  int32_t tileHeight, int32_t numTiles )
+{
+  const int32_t tilesPerRow{ tileWidth > 0 ? sheet.width / tileWidth : 0 };
+  const int32_t tilesPerColumn{ tileHeight > 0 ? sheet.height / tileHeight : 0 };
+  const int32_t count{ numTiles >= 0 && numTiles < tilesPerRow * tilesPerColumn ? numTiles
+                                                                                   : tilesPerRow * tilesPerColumn };
+
+  for( int32_t tile = 0; tile < count; ++tile )
+  {
+    char name[64];
+    snprintf( name, sizeof( name ), "%s_%03d", prefix, tile );
+
+    const int32_t x{ ( tile % tilesPerRow ) * tileWidth };
+    const int32_t y{ ( tile / tilesPerRow ) * tileHeight };
+    AddBitmap( name, sheet.Row( y ) + x, sheet.pitch, tileWidth, tileHeight );
+  }
+
+  return count;
+}
+
+
+void DatafileWriter::Store( std::vector<uint8_t>& bytes ) const
+{
+  INSTRUMENT_SCOPE( "datafile" );
+
+  size_t size{ 8 };
+  for( const Object& object : m_objects )
+  {
+    size += 12 + object.name.size() + 12 + object.data.size();
+  }
+
+  bytes.clear();
+  bytes.reserve( size );
+
+  PutLong( bytes, DATAFILE_MAGIC );
+  PutLong( bytes, static_cast<uint32_t>( m_objects.size() ) );
+
+  for( const Object& object : m_objects )
+  {
+    PutLong( bytes, DATAFILE_PROPERTY );
+    PutLong( bytes, DATAFILE_NAME );
+    PutLong( bytes, static_cast<uint32_t>( object.name.size() ) );
+    bytes.insert( bytes.end(), object.name.begin(), object.name.end() );
+
+    // The chunk's stored size and its data size, which only differ for chunks compressed on their own
+    PutLong( bytes, static_cast<uint32_t>( object.type ) );
+    PutLong( bytes, static_cast<uint32_t>( object.data.size() ) );
+    PutLong( bytes, static_cast<uint32_t>( object.data.size() ) );
+    bytes.insert( bytes.end(), object.data.begin(), object.data.end() );
+  }
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, bytes.size() );
+}
+
+
+const char* FindDatafileOption( int32_t argc, char* argv[], bool& compress )
+{
+  const char* filename{ nullptr };
+  compress = false;
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--datafile" ) == 0 && i + 1 < argc )
+    {
+      filename = argv[++i];
+    }
+    else if( strcmp( argv[i], "--datafile-packed" ) == 0 )
+    {
+      compress = true;
+    }
+  }
+
+  return filename;
+}
@@ -0,0 +1,66 @@
+// Allegro 4 datafiles (.dat) of ripped sheets, for the Allegro tools that load their assets with load_datafile().
+// Every tile and glyph becomes its own 8-bit BITMAP object, named after its sheet and number (TILE_000, ...), next to
+// the PALETTE objects its indices refer to. Tools can then load a whole game in one call and look objects up with
+// find_datafile_object().
+//
+// The objects are laid out here without Allegro: the "ALL." magic, the object count, and then for each object its
+// NAME property and a chunk of its data, all big endian as pack_mputl() writes them. SaveDatafile() in
+// allegro_surface.h writes that through a packfile, which adds the packfile magic and optionally LZSS compresses the
+// whole file, the same as the grabber's global compression.
+
+#ifndef TILE_DECODE_DATAFILE_WRITER_H
+#define TILE_DECODE_DATAFILE_WRITER_H
+
+#include <string>
+
+#include "surface.h"
+
+// The same values as allegro/datafile.h
+#define DATAFILE_ID( a, b, c, d ) ( ( ( a ) << 24 ) | ( ( b ) << 16 ) | ( ( c ) << 8 ) | ( d ) )
+#define DATAFILE_MAGIC            DATAFILE_ID( 'A', 'L', 'L', '.' )
+#define DATAFILE_BITMAP           DATAFILE_ID( 'B', 'M', 'P', ' ' )
+#define DATAFILE_PALETTE          DATAFILE_ID( 'P', 'A', 'L', ' ' )
+#define DATAFILE_PROPERTY         DATAFILE_ID( 'p', 'r', 'o', 'p' )
+#define DATAFILE_NAME             DATAFILE_ID( 'N', 'A', 'M', 'E' )
+
+// Allegro palettes have 256 entries of 6 bits per component
+#define DATAFILE_PALETTE_SIZE 256
+
+class DatafileWriter
+{
+public:
+  // Adds a PALETTE object. Entries past paletteSize are black.
+  void AddPalette( const char* name, const PaletteEntry* palette, int32_t paletteSize );
+
+  // Adds an 8-bit BITMAP object, copied out of pixels (pitch bytes per row)
+  void AddBitmap( const char* name, const uint8_t* pixels, int32_t pitch, int32_t width, int32_t height );
+
+  // Adds every whole tile of a sheet (or the first numTiles), left to right and then top to bottom, as bitmaps named
+  // PREFIX_000, PREFIX_001, ... Returns the number added.
+  int32_t AddSheet( const char* prefix, const IndexSurface& sheet, int32_t tileWidth, int32_t tileHeight,
+                    int32_t numTiles = -1 );
+
+  int32_t NumObjects() const
+  {
+    return static_cast<int32_t>( m_objects.size() );
+  }
+
+  // Lays the datafile out in memory, from the "ALL." magic on (without the packfile magic)
+  void Store( std::vector<uint8_t>& bytes ) const;
+
+private:
+  struct Object
+  {
+    int32_t type;
+    std::string name;
+    std::vector<uint8_t> data;
+  };
+
+  std::vector<Object> m_objects;
+};
+
+// Finds --datafile FILE on the command line, and --datafile-packed to compress it. Returns FILE, or null if there's
+// no --datafile.
+const char* FindDatafileOption( int32_t argc, char* argv[], bool& compress );
+
+#endif // TILE_DECODE_DATAFILE_WRITER_H
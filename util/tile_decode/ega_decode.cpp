@@ -0,0 +1,296 @@
+#include "ega_decode.h"
+
+#include <cstring>
+
+#include "cpu_dispatch.h"
+
+
+const PaletteEntry egaPalette[16] =
+{
+  { 0x00, 0x00, 0x00 }, // Black
+  { 0x00, 0x00, 0xAA }, // Blue
+  { 0x00, 0xAA, 0x00 }, // Green
+  { 0x00, 0xAA, 0xAA }, // Cyan
+  { 0xAA, 0x00, 0x00 }, // Red
+  { 0xAA, 0x00, 0xAA }, // Magenta
+  { 0xAA, 0x55, 0x00 }, // Brown
+  { 0xAA, 0xAA, 0xAA }, // Light Gray
+  { 0x55, 0x55, 0x55 }, // Dark Gray
+  { 0x55, 0x55, 0xFF }, // Bright Blue
+  { 0x55, 0xFF, 0x55 }, // Bright Green
+  { 0x55, 0xFF, 0xFF }, // Bright Cyan
+  { 0xFF, 0x55, 0x55 }, // Bright Red
+  { 0xFF, 0x55, 0xFF }, // Bright Magenta
+  { 0xFF, 0xFF, 0x55 }, // Bright Yellow
+  { 0xFF, 0xFF, 0xFF }, // White
+};
+
+
+namespace
+{
+  // Both pixels of every possible packed byte, so a byte expands with a single 2-byte copy
+  struct NibbleTable
+  {
+    uint8_t pixels[256][2];
+
+    NibbleTable()
+    {
+      for( int32_t i = 0; i < 256; ++i )
+      {
+        pixels[i][0] = static_cast<uint8_t>( ( i >> 4 ) & 0xF );
+        pixels[i][1] = static_cast<uint8_t>( i & 0xF );
+      }
+    }
+  };
+
+  const NibbleTable nibbleTable;
+} // namespace
+
+
+int32_t DecodeEgaPacked( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest, int32_t destPitch,
+                         int32_t maxRows )
+{
+  int32_t rows{ static_cast<int32_t>( numBytes / bytesPerRow ) };
+  if( rows > maxRows )
+  {
+    rows = maxRows;
+  }
+
+  const DecodeKernels& kernels{ Kernels() };
+
+  for( int32_t y = 0; y < rows; ++y )
+  {
+    kernels.expandNibbles( data + static_cast<size_t>( y ) * bytesPerRow, bytesPerRow,
+                           dest + static_cast<size_t>( y ) * destPitch );
+  }
+
+  return rows;
+}
+
+
+void DecodeEgaRle( const uint8_t* data, size_t numBytes, uint8_t* dest, int32_t width, int32_t height,
+                   int32_t destPitch )
+{
+  // Runs are filled a row segment at a time, which relies on pixel pairs never straddling a row
+  if( ( width & 1 ) != 0 )
+  {
+    DecodeEgaRleReference( data, numBytes, dest, width, height, destPitch );
+    return;
+  }
+
+  const DecodeKernels& kernels{ Kernels() };
+  const uint8_t* const end{ data + numBytes };
+  const uint8_t* src{ data };
+
+  int32_t x{ 0 };
+  int32_t y{ 0 };
+
+  while( src < end && y < height )
+  {
+    uint8_t* row{ dest + static_cast<size_t>( y ) * destPitch };
+    const uint8_t tileData{ *src++ };
+
+    if( tileData == EGA_RLE_MARKER )
+    {
+      // A truncated run reads 0xFF, the same as the EOF value the original loop got from infile.get(). src never moves
+      // past end.
+      const size_t remaining{ static_cast<size_t>( end - src ) };
+      int32_t numPixels{ remaining > 0 ? src[0] : 0xFF };
+      const uint8_t color{ remaining > 1 ? src[1] : static_cast<uint8_t>( 0xFF ) };
+      src += remaining < 2 ? remaining : 2;
+
+      INSTRUMENT_RUN_LENGTH( static_cast<unsigned int>( numPixels ) );
+
+      const uint8_t* pair{ nibbleTable.pixels[color] };
+
+      while( numPixels > 0 && y < height )
+      {
+        int32_t count{ ( width - x ) / 2 };
+        if( count > numPixels )
+        {
+          count = numPixels;
+        }
+
+        kernels.fillPairs( row + x, count, pair[0], pair[1] );
+
+        x += count * 2;
+        numPixels -= count;
+
+        if( x >= width )
+        {
+          x = 0;
+          ++y;
+          row += destPitch;
+        }
+      }
+    }
+    else
+    {
+      // Simple pixel data
+      memcpy( row + x, nibbleTable.pixels[tileData], 2 );
+      x += 2;
+
+      if( x >= width )
+      {
+        x = 0;
+        ++y;
+      }
+    }
+  }
+}
+
+
+size_t ExpandEgaRle( const uint8_t* data, size_t numBytes, uint8_t* dest, size_t maxBytes )
+{
+  const uint8_t* const end{ data + numBytes };
+  const uint8_t* src{ data };
+  size_t written{ 0 };
+
+  while( src < end && written < maxBytes )
+  {
+    const uint8_t value{ *src++ };
+
+    if( value == EGA_RLE_MARKER )
+    {
+      // Truncated runs read 0xFF, as in DecodeEgaRle(). src never moves past end.
+      const size_t remaining{ static_cast<size_t>( end - src ) };
+      size_t count{ remaining > 0 ? src[0] : static_cast<size_t>( 0xFF ) };
+      const uint8_t repeated{ remaining > 1 ? src[1] : static_cast<uint8_t>( 0xFF ) };
+      src += remaining < 2 ? remaining : 2;
+
+      if( count > maxBytes - written )
+      {
+        count = maxBytes - written;
+      }
+
+      memset( dest + written, repeated, count );
+      written += count;
+    }
+    else
+    {
+      dest[written++] = value;
+    }
+  }
+
+  return written;
+}
+
+
+size_t EgaRleExpandedSize( const uint8_t* data, size_t numBytes )
+{
+  size_t size{ 0 };
+
+  for( size_t position = 0; position < numBytes; )
+  {
+    if( data[position] == EGA_RLE_MARKER )
+    {
+      size += position + 1 < numBytes ? data[position + 1] : 0xFF;
+      position += 3;
+    }
+    else
+    {
+      ++size;
+      ++position;
+    }
+  }
+
+  return size;
+}
+
+
+// ---------------------
+// Reference decoders
+// ---------------------
+
+namespace
+{
+  // Mirrors ifstream::get() followed by a uint8_t cast, which produces 0xFF once the end of the file is reached
+  inline uint8_t GetByte( const uint8_t* data, size_t numBytes, size_t& position )
+  {
+    const uint8_t value{ position < numBytes ? data[position] : static_cast<uint8_t>( 0xFF ) };
+    ++position;
+    return value;
+  }
+
+  // Mirrors putpixel(), which silently clips
+  inline void PutIndex( uint8_t* dest, int32_t width, int32_t height, int32_t destPitch, int32_t x, int32_t y,
+                        uint8_t index )
+  {
+    if( x >= 0 && x < width && y >= 0 && y < height )
+    {
+      dest[static_cast<size_t>( y ) * destPitch + x] = index;
+    }
+  }
+} // namespace
+
+
+int32_t DecodeEgaPackedReference( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest,
+                                  int32_t destPitch, int32_t maxRows )
+{
+  int32_t rows{ 0 };
+  size_t position{ 0 };
+
+  while( position + bytesPerRow <= numBytes && rows < maxRows )
+  {
+    uint8_t* row{ dest + static_cast<size_t>( rows ) * destPitch };
+    int32_t x{ 0 };
+
+    for( int32_t i = 0; i < bytesPerRow; ++i )
+    {
+      // 2 pixels per byte
+      const uint8_t tileData{ data[position++] };
+      row[x++] = ( tileData >> 4 ) & 0xF;
+      row[x++] = tileData & 0xF;
+    }
+
+    ++rows;
+  }
+
+  return rows;
+}
+
+
+void DecodeEgaRleReference( const uint8_t* data, size_t numBytes, uint8_t* dest, int32_t width, int32_t height,
+                            int32_t destPitch )
+{
+  size_t position{ 0 };
+
+  int32_t x{ 0 };
+  int32_t y{ 0 };
+
+  while( position < numBytes )
+  {
+    const uint8_t tileData{ GetByte( data, numBytes, position ) };
+
+    if( tileData == EGA_RLE_MARKER )
+    {
+      // Handle the run of info
+      const uint8_t numPixels{ GetByte( data, numBytes, position ) };
+      const uint8_t color{ GetByte( data, numBytes, position ) };
+
+      for( uint16_t i = 0; i < numPixels; ++i )
+      {
+        PutIndex( dest, width, height, destPitch, x++, y, ( color >> 4 ) & 0xF );
+        PutIndex( dest, width, height, destPitch, x++, y, color & 0xF );
+
+        if( x >= width )
+        {
+          x = 0;
+          ++y;
+        }
+      }
+    }
+    else
+    {
+      // Simple pixel data
+      PutIndex( dest, width, height, destPitch, x++, y, ( tileData >> 4 ) & 0xF );
+      PutIndex( dest, width, height, destPitch, x++, y, tileData & 0xF );
+    }
+
+    if( x >= width )
+    {
+      x = 0;
+      ++y;
+    }
+  }
+}
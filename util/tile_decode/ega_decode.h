@@ -0,0 +1,38 @@
+// EGA decoders for the PC Ultima 4 and u4graph files.
+// Tile and charset files are packed 4 bits per pixel, high nibble first. The intro / endgame pictures use a simple
+// RLE: 0x02 is followed by a byte count and the byte to repeat, anything else is a literal byte of two pixels.
+
+#ifndef TILE_DECODE_EGA_DECODE_H
+#define TILE_DECODE_EGA_DECODE_H
+
+#include "surface.h"
+
+#define EGA_RLE_MARKER 0x02
+
+extern const PaletteEntry egaPalette[16];
+
+// Decodes packed 4bpp rows. Each destination row consumes bytesPerRow bytes. Decoding stops at the end of the data
+// or after maxRows rows, whichever comes first. Returns the number of rows written.
+int32_t DecodeEgaPacked( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest, int32_t destPitch,
+                         int32_t maxRows );
+
+// Decodes an RLE picture into a width x height surface. Pixels that fall outside the surface are dropped, just like
+// putpixel() would drop them.
+void DecodeEgaRle( const uint8_t* data, size_t numBytes, uint8_t* dest, int32_t width, int32_t height,
+                   int32_t destPitch );
+
+// Expands an RLE picture to its raw bytes, whatever their pixel format. The CGA and VGA upgrade pictures use the same
+// RLE and go through this before their own unpacking. Writes at most maxBytes bytes and returns how many it wrote.
+size_t ExpandEgaRle( const uint8_t* data, size_t numBytes, uint8_t* dest, size_t maxBytes );
+
+// The number of bytes an RLE picture expands to, without expanding it. This tells the picture formats apart.
+size_t EgaRleExpandedSize( const uint8_t* data, size_t numBytes );
+
+// Straightforward per-pixel versions of the decoders above. These mirror the original ripper loops and are what the
+// optimized versions are verified against.
+int32_t DecodeEgaPackedReference( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest,
+                                  int32_t destPitch, int32_t maxRows );
+void DecodeEgaRleReference( const uint8_t* data, size_t numBytes, uint8_t* dest, int32_t width, int32_t height,
+                            int32_t destPitch );
+
+#endif // TILE_DECODE_EGA_DECODE_H
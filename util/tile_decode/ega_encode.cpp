@@ -0,0 +1,108 @@
+#include "ega_encode.h"
+
+#include <climits>
+
+#include "cpu_dispatch.h"
+#include "ega_decode.h"
+
+// Runs this long or shorter cost no more as literals
+#define MAX_LITERAL_RUN 3
+
+
+void EncodeEgaRle( const uint8_t* data, size_t numBytes, std::vector<uint8_t>& out )
+{
+  INSTRUMENT_SCOPE( "encode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, numBytes );
+
+  out.clear();
+  out.reserve( numBytes / 2 + 16 );
+
+  const DecodeKernels& kernels{ Kernels() };
+
+  size_t position{ 0 };
+  while( position < numBytes )
+  {
+    const size_t remaining{ numBytes - position };
+    const int32_t scanLength{ remaining < INT_MAX ? static_cast<int32_t>( remaining ) : INT_MAX };
+
+    const uint8_t value{ data[position] };
+    size_t run{ static_cast<size_t>( kernels.runLength( data + position, scanLength ) ) };
+    position += run;
+
+    INSTRUMENT_RUN_LENGTH( static_cast<unsigned int>( run ) );
+
+    while( run > 0 )
+    {
+      if( run <= MAX_LITERAL_RUN && value != EGA_RLE_MARKER )
+      {
+        out.insert( out.end(), run, value );
+        break;
+      }
+
+      const size_t count{ run < EGA_RLE_MAX_RUN ? run : EGA_RLE_MAX_RUN };
+      out.push_back( EGA_RLE_MARKER );
+      out.push_back( static_cast<uint8_t>( count ) );
+      out.push_back( value );
+      run -= count;
+    }
+  }
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, out.size() );
+}
+
+
+void EncodeEgaRlePicture( const IndexSurface& surface, std::vector<uint8_t>& out )
+{
+  const int32_t bytesPerRow{ ( surface.width + 1 ) / 2 };
+  std::vector<uint8_t> packed( static_cast<size_t>( bytesPerRow ) * surface.height );
+
+  for( int32_t y = 0; y < surface.height; ++y )
+  {
+    const uint8_t* row{ surface.Row( y ) };
+    uint8_t* dest{ packed.data() + static_cast<size_t>( y ) * bytesPerRow };
+
+    for( int32_t x = 0; x + 1 < surface.width; x += 2 )
+    {
+      dest[x / 2] = static_cast<uint8_t>( ( ( row[x] & 0x0f ) << 4 ) | ( row[x + 1] & 0x0f ) );
+    }
+
+    if( surface.width & 1 )
+    {
+      dest[bytesPerRow - 1] = static_cast<uint8_t>( ( row[surface.width - 1] & 0x0f ) << 4 );
+    }
+  }
+
+  EncodeEgaRle( packed.data(), packed.size(), out );
+}
+
+
+void MapToEgaPalette( IndexSurface& surface, const PaletteEntry* palette, int32_t paletteSize )
+{
+  uint8_t map[256] = {};
+  for( int32_t i = 0; i < paletteSize && i < 256; ++i )
+  {
+    int32_t bestDistance{ 0x7fffffff };
+    for( int32_t j = 0; j < 16; ++j )
+    {
+      const int32_t dr{ palette[i].r - egaPalette[j].r };
+      const int32_t dg{ palette[i].g - egaPalette[j].g };
+      const int32_t db{ palette[i].b - egaPalette[j].b };
+      const int32_t distance{ dr * dr + dg * dg + db * db };
+
+      if( distance < bestDistance )
+      {
+        map[i] = static_cast<uint8_t>( j );
+        bestDistance = distance;
+      }
+    }
+  }
+
+  for( int32_t y = 0; y < surface.height; ++y )
+  {
+    uint8_t* row{ surface.Row( y ) };
+    for( int32_t x = 0; x < surface.width; ++x )
+    {
+      row[x] = map[row[x]];
+    }
+  }
+}
@@ -0,0 +1,27 @@
+// Encoders for the EGA RLE pictures, the reverse of DecodeEgaRle() and ExpandEgaRle(), for putting edited pictures
+// back into the game. The output decodes the same through the pc/ultima4 and u4graph rippers.
+//
+// Every run of equal bytes is encoded on its own, in the fewest bytes possible: a run token costs 3 bytes and covers
+// up to 255 bytes, and a literal costs 1. So runs of up to 3 bytes are written as literals, except for bytes equal to
+// EGA_RLE_MARKER, which can only be written as runs (of 1 if need be).
+
+#ifndef TILE_DECODE_EGA_ENCODE_H
+#define TILE_DECODE_EGA_ENCODE_H
+
+#include "surface.h"
+
+#define EGA_RLE_MAX_RUN 255
+
+// Encodes raw bytes (of any pixel format) into out, replacing its contents. Runs are found with the run length kernel
+// (see cpu_dispatch.h).
+void EncodeEgaRle( const uint8_t* data, size_t numBytes, std::vector<uint8_t>& out );
+
+// Packs an EGA picture 2 pixels per byte, high nibble first, and encodes it. Odd width rows get a padding pixel,
+// which the decoders drop. Only the low 4 bits of each index are used.
+void EncodeEgaRlePicture( const IndexSurface& surface, std::vector<uint8_t>& out );
+
+// Replaces every index with the EGA palette index nearest to its color in palette, for pictures edited in other
+// palettes. Indices past the end of palette become black.
+void MapToEgaPalette( IndexSurface& surface, const PaletteEntry* palette, int32_t paletteSize );
+
+#endif // TILE_DECODE_EGA_ENCODE_H
@@ -0,0 +1,91 @@
+// Every variant of the dispatched decode kernels. Only cpu_dispatch.cpp and the kernel checks should need this; the
+// decoders go through Kernels().
+//
+// The vector variants live in one file per instruction set. GCC and Clang compile each function for its own target
+// through KERNEL_TARGET, so the rest of the program keeps the baseline instruction set. MSVC allows any intrinsic in
+// any function and needs no per-file /arch flags.
+
+#ifndef TILE_DECODE_KERNELS_H
+#define TILE_DECODE_KERNELS_H
+
+#include "cpu_dispatch.h"
+#include "surface.h"
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+#if defined( _M_IX86 ) || defined( _M_X64 ) || defined( __i386__ ) || defined( __x86_64__ )
+#define KERNELS_X86 1
+#else
+#define KERNELS_X86 0
+#endif
+
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define KERNEL_TARGET( isa ) __attribute__( ( target( isa ) ) )
+#else
+#define KERNEL_TARGET( isa )
+#endif
+
+// The index of the lowest set bit. value must not be 0.
+inline int32_t CountTrailingZeros( uint32_t value )
+{
+#if defined( _MSC_VER )
+  unsigned long index;
+  _BitScanForward( &index, value );
+  return static_cast<int32_t>( index );
+#else
+  return __builtin_ctz( value );
+#endif
+}
+
+void ExpandNibblesScalar( const uint8_t* src, int32_t count, uint8_t* dest );
+void Expand2bppScalar( const uint8_t* src, int32_t count, uint8_t* dest );
+void FillPairsScalar( uint8_t* dest, int32_t count, uint8_t first, uint8_t second );
+void ExpandHiresScalar( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+void MapIndices32Scalar( const uint8_t* src, int32_t count, const uint32_t* table, int32_t tableSize,
+                         uint32_t* dest );
+void MapIndices16Scalar( const uint8_t* src, int32_t count, const uint16_t* table, int32_t tableSize,
+                         uint16_t* dest );
+void BoxFilter2xScalar( const uint32_t* row0, const uint32_t* row1, int32_t count, uint32_t* dest );
+int32_t RunLengthScalar( const uint8_t* src, int32_t count );
+int32_t CountPixelDifferencesScalar( const uint8_t* a, const uint8_t* b, int32_t count,
+                                     const PixelDifferenceTable& table );
+
+#if KERNELS_X86
+
+void ExpandNibblesSse2( const uint8_t* src, int32_t count, uint8_t* dest );
+void Expand2bppSse2( const uint8_t* src, int32_t count, uint8_t* dest );
+void FillPairsSse2( uint8_t* dest, int32_t count, uint8_t first, uint8_t second );
+void ExpandHiresSse2( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+void BoxFilter2xSse2( const uint32_t* row0, const uint32_t* row1, int32_t count, uint32_t* dest );
+int32_t RunLengthSse2( const uint8_t* src, int32_t count );
+
+void MapIndices32Ssse3( const uint8_t* src, int32_t count, const uint32_t* table, int32_t tableSize,
+                        uint32_t* dest );
+void MapIndices16Ssse3( const uint8_t* src, int32_t count, const uint16_t* table, int32_t tableSize,
+                        uint16_t* dest );
+int32_t CountPixelDifferencesSsse3( const uint8_t* a, const uint8_t* b, int32_t count,
+                                    const PixelDifferenceTable& table );
+
+void ExpandNibblesAvx2( const uint8_t* src, int32_t count, uint8_t* dest );
+void Expand2bppAvx2( const uint8_t* src, int32_t count, uint8_t* dest );
+void FillPairsAvx2( uint8_t* dest, int32_t count, uint8_t first, uint8_t second );
+void ExpandHiresAvx2( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+void MapIndices32Avx2( const uint8_t* src, int32_t count, const uint32_t* table, int32_t tableSize,
+                       uint32_t* dest );
+void BoxFilter2xAvx2( const uint32_t* row0, const uint32_t* row1, int32_t count, uint32_t* dest );
+int32_t RunLengthAvx2( const uint8_t* src, int32_t count );
+int32_t CountPixelDifferencesAvx2( const uint8_t* a, const uint8_t* b, int32_t count,
+                                   const PixelDifferenceTable& table );
+
+void ExpandNibblesAvx512( const uint8_t* src, int32_t count, uint8_t* dest );
+void ExpandHiresAvx512( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest );
+void MapIndices32Avx512( const uint8_t* src, int32_t count, const uint32_t* table, int32_t tableSize,
+                         uint32_t* dest );
+void MapIndices16Avx512( const uint8_t* src, int32_t count, const uint16_t* table, int32_t tableSize,
+                         uint16_t* dest );
+
+#endif // KERNELS_X86
+
+#endif // TILE_DECODE_KERNELS_H
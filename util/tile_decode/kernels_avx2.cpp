@@ -0,0 +1,256 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include <cstring>
+#include <immintrin.h>
+
+
+KERNEL_TARGET( "avx2" ) void ExpandNibblesAvx2( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  const __m256i lowNibbles{ _mm256_set1_epi8( 0x0f ) };
+
+  int32_t i{ 0 };
+  for( ; i + 32 <= count; i += 32 )
+  {
+    const __m256i packed{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) ) };
+    const __m256i high{ _mm256_and_si256( _mm256_srli_epi16( packed, 4 ), lowNibbles ) };
+    const __m256i low{ _mm256_and_si256( packed, lowNibbles ) };
+
+    // The unpacks work within each 128-bit lane, so the lanes are put back in order afterwards
+    const __m256i first{ _mm256_unpacklo_epi8( high, low ) };  // Bytes 0-7 | 16-23
+    const __m256i second{ _mm256_unpackhi_epi8( high, low ) }; // Bytes 8-15 | 24-31
+
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 2 ),
+                         _mm256_permute2x128_si256( first, second, 0x20 ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 2 + 32 ),
+                         _mm256_permute2x128_si256( first, second, 0x31 ) );
+  }
+
+  ExpandNibblesSse2( src + i, count - i, dest + i * 2 );
+}
+
+
+KERNEL_TARGET( "avx2" ) void Expand2bppAvx2( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  const __m256i lowPairs{ _mm256_set1_epi8( 0x03 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 32 <= count; i += 32 )
+  {
+    const __m256i packed{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) ) };
+    const __m256i p0{ _mm256_and_si256( _mm256_srli_epi16( packed, 6 ), lowPairs ) };
+    const __m256i p1{ _mm256_and_si256( _mm256_srli_epi16( packed, 4 ), lowPairs ) };
+    const __m256i p2{ _mm256_and_si256( _mm256_srli_epi16( packed, 2 ), lowPairs ) };
+    const __m256i p3{ _mm256_and_si256( packed, lowPairs ) };
+
+    const __m256i front{ _mm256_unpacklo_epi8( p0, p1 ) };
+    const __m256i back{ _mm256_unpacklo_epi8( p2, p3 ) };
+    const __m256i frontHigh{ _mm256_unpackhi_epi8( p0, p1 ) };
+    const __m256i backHigh{ _mm256_unpackhi_epi8( p2, p3 ) };
+
+    // As in ExpandNibblesAvx2(), the unpacks stay within each 128-bit lane
+    const __m256i quarter0{ _mm256_unpacklo_epi16( front, back ) };         // Bytes 0-3 | 16-19
+    const __m256i quarter1{ _mm256_unpackhi_epi16( front, back ) };         // Bytes 4-7 | 20-23
+    const __m256i quarter2{ _mm256_unpacklo_epi16( frontHigh, backHigh ) }; // Bytes 8-11 | 24-27
+    const __m256i quarter3{ _mm256_unpackhi_epi16( frontHigh, backHigh ) }; // Bytes 12-15 | 28-31
+
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 4 ),
+                         _mm256_permute2x128_si256( quarter0, quarter1, 0x20 ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 4 + 32 ),
+                         _mm256_permute2x128_si256( quarter2, quarter3, 0x20 ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 4 + 64 ),
+                         _mm256_permute2x128_si256( quarter0, quarter1, 0x31 ) );
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 4 + 96 ),
+                         _mm256_permute2x128_si256( quarter2, quarter3, 0x31 ) );
+  }
+
+  Expand2bppSse2( src + i, count - i, dest + i * 4 );
+}
+
+
+KERNEL_TARGET( "avx2" ) void FillPairsAvx2( uint8_t* dest, int32_t count, uint8_t first, uint8_t second )
+{
+  const __m256i pattern{ _mm256_set1_epi16( static_cast<int16_t>( first | ( second << 8 ) ) ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 2 ), pattern );
+  }
+
+  FillPairsSse2( dest + i * 2, count - i, first, second );
+}
+
+
+// 4 bitmap bytes (32 pixels) per step
+KERNEL_TARGET( "avx2" ) void ExpandHiresAvx2( const uint8_t* bits, const uint8_t* colors, int32_t count,
+                                              uint8_t* dest )
+{
+  // Byte n of the 4 goes to lanes 8n to 8n + 7
+  const __m256i spread{ _mm256_setr_epi8( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                          2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3 ) };
+
+  // Pixel n of a byte tests bit 7 - n
+  const __m256i bitSelect{ _mm256_set1_epi64x( 0x0102040810204080ll ) };
+  const __m256i lowNibbles{ _mm256_set1_epi8( 0x0f ) };
+
+  int32_t i{ 0 };
+  for( ; i + 4 <= count; i += 4 )
+  {
+    int32_t bitWord;
+    int32_t colorWord;
+    memcpy( &bitWord, bits + i, 4 );
+    memcpy( &colorWord, colors + i, 4 );
+
+    const __m256i bitBytes{ _mm256_shuffle_epi8( _mm256_set1_epi32( bitWord ), spread ) };
+    const __m256i colorBytes{ _mm256_shuffle_epi8( _mm256_set1_epi32( colorWord ), spread ) };
+
+    const __m256i fore{ _mm256_and_si256( _mm256_srli_epi16( colorBytes, 4 ), lowNibbles ) };
+    const __m256i back{ _mm256_and_si256( colorBytes, lowNibbles ) };
+
+    const __m256i mask{ _mm256_cmpeq_epi8( _mm256_and_si256( bitBytes, bitSelect ), bitSelect ) };
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i * 8 ), _mm256_blendv_epi8( back, fore, mask ) );
+  }
+
+  ExpandHiresSse2( bits + i, colors + i, count - i, dest + i * 8 );
+}
+
+
+// 8 pixels per step: two 8-entry permutes for palettes of up to 16 colors, a gather for anything bigger
+KERNEL_TARGET( "avx2" ) void MapIndices32Avx2( const uint8_t* src, int32_t count, const uint32_t* table,
+                                               int32_t tableSize, uint32_t* dest )
+{
+  int32_t i{ 0 };
+
+  if( tableSize <= 16 )
+  {
+    const __m256i lowColors{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( table ) ) };
+    const __m256i highColors{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( table + 8 ) ) };
+    const __m256i seven{ _mm256_set1_epi32( 7 ) };
+
+    for( ; i + 8 <= count; i += 8 )
+    {
+      const __m256i indices{ _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( src + i ) ) ) };
+
+      // permutevar8x32 only looks at the low 3 bits, so the high half is picked with a blend
+      const __m256i low{ _mm256_permutevar8x32_epi32( lowColors, indices ) };
+      const __m256i high{ _mm256_permutevar8x32_epi32( highColors, indices ) };
+      const __m256i useHigh{ _mm256_cmpgt_epi32( indices, seven ) };
+
+      _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i ), _mm256_blendv_epi8( low, high, useHigh ) );
+    }
+  }
+  else
+  {
+    for( ; i + 8 <= count; i += 8 )
+    {
+      const __m256i indices{ _mm256_cvtepu8_epi32( _mm_loadl_epi64( reinterpret_cast<const __m128i*>( src + i ) ) ) };
+      const __m256i colors{ _mm256_i32gather_epi32( reinterpret_cast<const int*>( table ), indices, 4 ) };
+
+      _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i ), colors );
+    }
+  }
+
+  MapIndices32Scalar( src + i, count - i, table, tableSize, dest + i );
+}
+
+
+// 8 output pixels per step, the same way as the SSE2 version within each 128-bit lane
+KERNEL_TARGET( "avx2" ) void BoxFilter2xAvx2( const uint32_t* row0, const uint32_t* row1, int32_t count,
+                                              uint32_t* dest )
+{
+  const __m256i zero{ _mm256_setzero_si256() };
+  const __m256i two{ _mm256_set1_epi16( 2 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 8 <= count; i += 8 )
+  {
+    __m256i sums[2];
+
+    for( int32_t half = 0; half < 2; ++half )
+    {
+      const __m256i top{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( row0 + i * 2 + half * 8 ) ) };
+      const __m256i bottom{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( row1 + i * 2 + half * 8 ) ) };
+
+      const __m256i low{ _mm256_add_epi16( _mm256_unpacklo_epi8( top, zero ), _mm256_unpacklo_epi8( bottom, zero ) ) };
+      const __m256i high{ _mm256_add_epi16( _mm256_unpackhi_epi8( top, zero ),
+                                            _mm256_unpackhi_epi8( bottom, zero ) ) };
+
+      const __m256i lowSum{ _mm256_add_epi16( low, _mm256_srli_si256( low, 8 ) ) };
+      const __m256i highSum{ _mm256_add_epi16( high, _mm256_srli_si256( high, 8 ) ) };
+
+      // Lane 0 holds this half's output pixels 0 and 1, lane 1 holds 2 and 3
+      sums[half] = _mm256_srli_epi16( _mm256_add_epi16( _mm256_unpacklo_epi64( lowSum, highSum ), two ), 2 );
+    }
+
+    // The pack interleaves the lanes of both halves, so put the 64-bit groups back in order
+    const __m256i packed{ _mm256_packus_epi16( sums[0], sums[1] ) };
+    _mm256_storeu_si256( reinterpret_cast<__m256i*>( dest + i ),
+                         _mm256_permute4x64_epi64( packed, _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+  }
+
+  BoxFilter2xSse2( row0 + i * 2, row1 + i * 2, count - i, dest + i );
+}
+
+
+KERNEL_TARGET( "avx2" ) int32_t RunLengthAvx2( const uint8_t* src, int32_t count )
+{
+  if( count <= 0 )
+  {
+    return 0;
+  }
+
+  const __m256i first{ _mm256_set1_epi8( static_cast<char>( src[0] ) ) };
+
+  int32_t i{ 0 };
+  for( ; i + 32 <= count; i += 32 )
+  {
+    const __m256i bytes{ _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) ) };
+    const uint32_t equal{ static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( bytes, first ) ) ) };
+    if( equal != 0xffffffffu )
+    {
+      return i + CountTrailingZeros( ~equal );
+    }
+  }
+
+  while( i < count && src[i] == src[0] )
+  {
+    ++i;
+  }
+
+  return i;
+}
+
+
+
+KERNEL_TARGET( "avx2" ) int32_t CountPixelDifferencesAvx2( const uint8_t* a, const uint8_t* b, int32_t count,
+                                                           const PixelDifferenceTable& table )
+{
+  const __m256i low{ _mm256_broadcastsi128_si256( _mm_loadu_si128( reinterpret_cast<const __m128i*>( table.low ) ) ) };
+  const __m256i high{ _mm256_broadcastsi128_si256(
+    _mm_loadu_si128( reinterpret_cast<const __m128i*>( table.high ) ) ) };
+  const __m256i cap{ _mm256_set1_epi8( static_cast<char>( table.cap ) ) };
+  const __m256i lowNibbles{ _mm256_set1_epi8( 0x0f ) };
+
+  __m256i sums{ _mm256_setzero_si256() };
+
+  int32_t i{ 0 };
+  for( ; i + 32 <= count; i += 32 )
+  {
+    const __m256i x{ _mm256_xor_si256( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( a + i ) ),
+                                       _mm256_loadu_si256( reinterpret_cast<const __m256i*>( b + i ) ) ) };
+    const __m256i lowCounts{ _mm256_shuffle_epi8( low, _mm256_and_si256( x, lowNibbles ) ) };
+    const __m256i highCounts{ _mm256_shuffle_epi8( high,
+                                                   _mm256_and_si256( _mm256_srli_epi16( x, 4 ), lowNibbles ) ) };
+    const __m256i pixels{ _mm256_min_epu8( _mm256_add_epi8( lowCounts, highCounts ), cap ) };
+    sums = _mm256_add_epi64( sums, _mm256_sad_epu8( pixels, _mm256_setzero_si256() ) );
+  }
+
+  // The total is at most 8 * count, so the low 32 bits of each lane hold its part of it
+  const __m128i halves{ _mm_add_epi64( _mm256_castsi256_si128( sums ), _mm256_extracti128_si256( sums, 1 ) ) };
+  const int32_t vectorSum{ _mm_cvtsi128_si32( halves ) + _mm_cvtsi128_si32( _mm_srli_si128( halves, 8 ) ) };
+  return vectorSum + CountPixelDifferencesSsse3( a + i, b + i, count - i, table );
+}
+
+#endif // KERNELS_X86
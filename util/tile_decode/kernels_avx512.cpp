@@ -0,0 +1,149 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include <cstring>
+#include <immintrin.h>
+
+
+namespace
+{
+  // Every byte with its bits reversed, so a bitmap byte (MSB = leftmost pixel) becomes a blend mask (bit 0 = lane 0)
+  struct ReversedBits
+  {
+    uint8_t bytes[256];
+
+    ReversedBits()
+    {
+      for( int32_t value = 0; value < 256; ++value )
+      {
+        uint8_t reversed{ 0 };
+        for( int32_t bit = 0; bit < 8; ++bit )
+        {
+          if( value & ( 1 << bit ) )
+          {
+            reversed |= static_cast<uint8_t>( 0x80 >> bit );
+          }
+        }
+
+        bytes[value] = reversed;
+      }
+    }
+  };
+
+  const ReversedBits reversedBits;
+} // namespace
+
+
+KERNEL_TARGET( "avx512f,avx512bw" ) void ExpandNibblesAvx512( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  const __m512i lowNibbles{ _mm512_set1_epi8( 0x0f ) };
+
+  // The unpacks work within each 128-bit lane. These put the 64-bit halves back in order.
+  const __m512i firstOrder{ _mm512_set_epi64( 11, 10, 3, 2, 9, 8, 1, 0 ) };
+  const __m512i secondOrder{ _mm512_set_epi64( 15, 14, 7, 6, 13, 12, 5, 4 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 64 <= count; i += 64 )
+  {
+    const __m512i packed{ _mm512_loadu_si512( src + i ) };
+    const __m512i high{ _mm512_and_si512( _mm512_srli_epi16( packed, 4 ), lowNibbles ) };
+    const __m512i low{ _mm512_and_si512( packed, lowNibbles ) };
+
+    const __m512i first{ _mm512_unpacklo_epi8( high, low ) };  // Bytes 0-7 | 16-23 | 32-39 | 48-55
+    const __m512i second{ _mm512_unpackhi_epi8( high, low ) }; // Bytes 8-15 | 24-31 | 40-47 | 56-63
+
+    _mm512_storeu_si512( dest + i * 2, _mm512_permutex2var_epi64( first, firstOrder, second ) );
+    _mm512_storeu_si512( dest + i * 2 + 64, _mm512_permutex2var_epi64( first, secondOrder, second ) );
+  }
+
+  ExpandNibblesAvx2( src + i, count - i, dest + i * 2 );
+}
+
+
+// 8 bitmap bytes (64 pixels) per step, with the bitmap bytes used directly as the blend mask
+KERNEL_TARGET( "avx512f,avx512bw" ) void ExpandHiresAvx512( const uint8_t* bits, const uint8_t* colors, int32_t count,
+                                                            uint8_t* dest )
+{
+  // Byte n of the 8 goes to lanes 8n to 8n + 7. The shuffle works within 128-bit lanes, and each lane holds a copy of
+  // all 8 bytes, so lane k picks bytes 2k and 2k + 1.
+  const __m512i spread{ _mm512_set_epi64( 0x0707070707070707ll, 0x0606060606060606ll, 0x0505050505050505ll,
+                                          0x0404040404040404ll, 0x0303030303030303ll, 0x0202020202020202ll,
+                                          0x0101010101010101ll, 0x0000000000000000ll ) };
+  const __m512i lowNibbles{ _mm512_set1_epi8( 0x0f ) };
+
+  int32_t i{ 0 };
+  for( ; i + 8 <= count; i += 8 )
+  {
+    uint64_t mask{ 0 };
+    for( int32_t j = 0; j < 8; ++j )
+    {
+      mask |= static_cast<uint64_t>( reversedBits.bytes[bits[i + j]] ) << ( j * 8 );
+    }
+
+    int64_t colorWord;
+    memcpy( &colorWord, colors + i, 8 );
+
+    const __m512i colorBytes{ _mm512_shuffle_epi8( _mm512_set1_epi64( colorWord ), spread ) };
+    const __m512i fore{ _mm512_and_si512( _mm512_srli_epi16( colorBytes, 4 ), lowNibbles ) };
+    const __m512i back{ _mm512_and_si512( colorBytes, lowNibbles ) };
+
+    _mm512_storeu_si512( dest + i * 8, _mm512_mask_blend_epi8( mask, back, fore ) );
+  }
+
+  ExpandHiresAvx2( bits + i, colors + i, count - i, dest + i * 8 );
+}
+
+
+// 16 pixels per step: a single permute for palettes of up to 16 colors, a gather for anything bigger
+KERNEL_TARGET( "avx512f,avx512bw" ) void MapIndices32Avx512( const uint8_t* src, int32_t count, const uint32_t* table,
+                                                             int32_t tableSize, uint32_t* dest )
+{
+  int32_t i{ 0 };
+
+  if( tableSize <= 16 )
+  {
+    const __m512i colors{ _mm512_loadu_si512( table ) };
+
+    for( ; i + 16 <= count; i += 16 )
+    {
+      const __m512i indices{ _mm512_cvtepu8_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) ) };
+      _mm512_storeu_si512( dest + i, _mm512_permutexvar_epi32( indices, colors ) );
+    }
+  }
+  else
+  {
+    for( ; i + 16 <= count; i += 16 )
+    {
+      const __m512i indices{ _mm512_cvtepu8_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) ) };
+      _mm512_storeu_si512( dest + i, _mm512_i32gather_epi32( indices, table, 4 ) );
+    }
+  }
+
+  MapIndices32Avx2( src + i, count - i, table, tableSize, dest + i );
+}
+
+
+// 32 pixels per step for palettes of up to 32 colors
+KERNEL_TARGET( "avx512f,avx512bw" ) void MapIndices16Avx512( const uint8_t* src, int32_t count, const uint16_t* table,
+                                                             int32_t tableSize, uint16_t* dest )
+{
+  if( tableSize > 32 )
+  {
+    MapIndices16Scalar( src, count, table, tableSize, dest );
+    return;
+  }
+
+  const __m512i colors{ _mm512_loadu_si512( table ) };
+
+  int32_t i{ 0 };
+  for( ; i + 32 <= count; i += 32 )
+  {
+    const __m512i indices{ _mm512_cvtepu8_epi16( _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) ) ) };
+    _mm512_storeu_si512( dest + i, _mm512_permutexvar_epi16( indices, colors ) );
+  }
+
+  MapIndices16Ssse3( src + i, count - i, table, tableSize, dest + i );
+}
+
+#endif // KERNELS_X86
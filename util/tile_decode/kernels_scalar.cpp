@@ -0,0 +1,121 @@
+#include "kernels.h"
+
+#include <cstring>
+
+#include "c64_decode.h"
+
+
+void ExpandNibblesScalar( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    dest[i * 2] = static_cast<uint8_t>( src[i] >> 4 );
+    dest[i * 2 + 1] = static_cast<uint8_t>( src[i] & 0x0f );
+  }
+}
+
+
+void Expand2bppScalar( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    dest[i * 4] = static_cast<uint8_t>( src[i] >> 6 );
+    dest[i * 4 + 1] = static_cast<uint8_t>( ( src[i] >> 4 ) & 0x03 );
+    dest[i * 4 + 2] = static_cast<uint8_t>( ( src[i] >> 2 ) & 0x03 );
+    dest[i * 4 + 3] = static_cast<uint8_t>( src[i] & 0x03 );
+  }
+}
+
+
+void FillPairsScalar( uint8_t* dest, int32_t count, uint8_t first, uint8_t second )
+{
+  if( first == second )
+  {
+    memset( dest, first, static_cast<size_t>( count ) * 2 );
+    return;
+  }
+
+  for( int32_t i = 0; i < count; ++i )
+  {
+    dest[i * 2] = first;
+    dest[i * 2 + 1] = second;
+  }
+}
+
+
+void ExpandHiresScalar( const uint8_t* bits, const uint8_t* colors, int32_t count, uint8_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    DecodeC64HiresByte( bits[i], colors[i], dest + i * C64_PIXELS_PER_BYTE );
+  }
+}
+
+
+void MapIndices32Scalar( const uint8_t* src, int32_t count, const uint32_t* table, int32_t /*tableSize*/,
+                         uint32_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    dest[i] = table[src[i]];
+  }
+}
+
+
+void MapIndices16Scalar( const uint8_t* src, int32_t count, const uint16_t* table, int32_t /*tableSize*/,
+                         uint16_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    dest[i] = table[src[i]];
+  }
+}
+
+
+void BoxFilter2xScalar( const uint32_t* row0, const uint32_t* row1, int32_t count, uint32_t* dest )
+{
+  for( int32_t i = 0; i < count; ++i )
+  {
+    const uint32_t a{ row0[i * 2] };
+    const uint32_t b{ row0[i * 2 + 1] };
+    const uint32_t c{ row1[i * 2] };
+    const uint32_t d{ row1[i * 2 + 1] };
+
+    uint32_t pixel{ 0 };
+    for( int32_t shift = 0; shift < 32; shift += 8 )
+    {
+      const uint32_t sum{ ( ( a >> shift ) & 0xff ) + ( ( b >> shift ) & 0xff ) + ( ( c >> shift ) & 0xff ) +
+                          ( ( d >> shift ) & 0xff ) };
+      pixel |= ( ( sum + 2 ) >> 2 ) << shift;
+    }
+
+    dest[i] = pixel;
+  }
+}
+
+
+int32_t RunLengthScalar( const uint8_t* src, int32_t count )
+{
+  int32_t i{ count > 0 ? 1 : 0 };
+  while( i < count && src[i] == src[0] )
+  {
+    ++i;
+  }
+
+  return i;
+}
+
+
+int32_t CountPixelDifferencesScalar( const uint8_t* a, const uint8_t* b, int32_t count,
+                                     const PixelDifferenceTable& table )
+{
+  int32_t differences{ 0 };
+  for( int32_t i = 0; i < count; ++i )
+  {
+    const uint8_t x{ static_cast<uint8_t>( a[i] ^ b[i] ) };
+    const int32_t pixels{ table.low[x & 0x0f] + table.high[x >> 4] };
+    differences += pixels < table.cap ? pixels : table.cap;
+  }
+
+  return differences;
+}
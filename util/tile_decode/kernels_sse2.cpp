@@ -0,0 +1,172 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include <emmintrin.h>
+
+
+namespace
+{
+  // Spreads byte 0 across the low 8 lanes and byte 1 across the high 8 lanes
+  KERNEL_TARGET( "sse2" ) inline __m128i BroadcastPair( int32_t pair )
+  {
+    __m128i value{ _mm_cvtsi32_si128( pair ) };
+    value = _mm_unpacklo_epi8( value, value );
+    value = _mm_unpacklo_epi16( value, value );
+    return _mm_unpacklo_epi32( value, value );
+  }
+} // namespace
+
+
+KERNEL_TARGET( "sse2" ) void ExpandNibblesSse2( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  const __m128i lowNibbles{ _mm_set1_epi8( 0x0f ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i packed{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) };
+    const __m128i high{ _mm_and_si128( _mm_srli_epi16( packed, 4 ), lowNibbles ) };
+    const __m128i low{ _mm_and_si128( packed, lowNibbles ) };
+
+    // Interleaving puts each high nibble in front of its low nibble
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 2 ), _mm_unpacklo_epi8( high, low ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 2 + 16 ), _mm_unpackhi_epi8( high, low ) );
+  }
+
+  ExpandNibblesScalar( src + i, count - i, dest + i * 2 );
+}
+
+
+KERNEL_TARGET( "sse2" ) void Expand2bppSse2( const uint8_t* src, int32_t count, uint8_t* dest )
+{
+  const __m128i lowPairs{ _mm_set1_epi8( 0x03 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i packed{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) };
+    const __m128i p0{ _mm_and_si128( _mm_srli_epi16( packed, 6 ), lowPairs ) };
+    const __m128i p1{ _mm_and_si128( _mm_srli_epi16( packed, 4 ), lowPairs ) };
+    const __m128i p2{ _mm_and_si128( _mm_srli_epi16( packed, 2 ), lowPairs ) };
+    const __m128i p3{ _mm_and_si128( packed, lowPairs ) };
+
+    // Pair up pixels 0/1 and 2/3 of each byte, then interleave the pairs into runs of 4
+    const __m128i front{ _mm_unpacklo_epi8( p0, p1 ) };
+    const __m128i back{ _mm_unpacklo_epi8( p2, p3 ) };
+    const __m128i frontHigh{ _mm_unpackhi_epi8( p0, p1 ) };
+    const __m128i backHigh{ _mm_unpackhi_epi8( p2, p3 ) };
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 4 ), _mm_unpacklo_epi16( front, back ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 4 + 16 ), _mm_unpackhi_epi16( front, back ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 4 + 32 ), _mm_unpacklo_epi16( frontHigh, backHigh ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 4 + 48 ), _mm_unpackhi_epi16( frontHigh, backHigh ) );
+  }
+
+  Expand2bppScalar( src + i, count - i, dest + i * 4 );
+}
+
+
+KERNEL_TARGET( "sse2" ) void FillPairsSse2( uint8_t* dest, int32_t count, uint8_t first, uint8_t second )
+{
+  const __m128i pattern{ _mm_set1_epi16( static_cast<int16_t>( first | ( second << 8 ) ) ) };
+
+  int32_t i{ 0 };
+  for( ; i + 8 <= count; i += 8 )
+  {
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 2 ), pattern );
+  }
+
+  FillPairsScalar( dest + i * 2, count - i, first, second );
+}
+
+
+// 2 bitmap bytes (16 pixels) per step
+KERNEL_TARGET( "sse2" ) void ExpandHiresSse2( const uint8_t* bits, const uint8_t* colors, int32_t count,
+                                              uint8_t* dest )
+{
+  // Pixel n of a byte tests bit 7 - n
+  const __m128i bitSelect{ _mm_set_epi8( 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>( 0x80 ),
+                                         0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, static_cast<char>( 0x80 ) ) };
+
+  int32_t i{ 0 };
+  for( ; i + 2 <= count; i += 2 )
+  {
+    const __m128i bitBytes{ BroadcastPair( bits[i] | ( bits[i + 1] << 8 ) ) };
+    const __m128i fore{ BroadcastPair( ( colors[i] >> 4 ) | ( ( colors[i + 1] >> 4 ) << 8 ) ) };
+    const __m128i back{ BroadcastPair( ( colors[i] & 0x0f ) | ( ( colors[i + 1] & 0x0f ) << 8 ) ) };
+
+    const __m128i mask{ _mm_cmpeq_epi8( _mm_and_si128( bitBytes, bitSelect ), bitSelect ) };
+    const __m128i pixels{ _mm_or_si128( _mm_and_si128( mask, fore ), _mm_andnot_si128( mask, back ) ) };
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i * 8 ), pixels );
+  }
+
+  ExpandHiresScalar( bits + i, colors + i, count - i, dest + i * 8 );
+}
+
+// 4 output pixels per step. Each 2x2 block is summed in 16-bit lanes, so the rounding matches the scalar version.
+KERNEL_TARGET( "sse2" ) void BoxFilter2xSse2( const uint32_t* row0, const uint32_t* row1, int32_t count,
+                                              uint32_t* dest )
+{
+  const __m128i zero{ _mm_setzero_si128() };
+  const __m128i two{ _mm_set1_epi16( 2 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 4 <= count; i += 4 )
+  {
+    __m128i sums[2];
+
+    for( int32_t half = 0; half < 2; ++half )
+    {
+      const __m128i top{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( row0 + i * 2 + half * 4 ) ) };
+      const __m128i bottom{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( row1 + i * 2 + half * 4 ) ) };
+
+      // Pixels 0 and 1 in the low half, 2 and 3 in the high half
+      const __m128i low{ _mm_add_epi16( _mm_unpacklo_epi8( top, zero ), _mm_unpacklo_epi8( bottom, zero ) ) };
+      const __m128i high{ _mm_add_epi16( _mm_unpackhi_epi8( top, zero ), _mm_unpackhi_epi8( bottom, zero ) ) };
+
+      // Add the horizontal neighbours, leaving each block's sum in the low 64 bits
+      const __m128i lowSum{ _mm_add_epi16( low, _mm_srli_si128( low, 8 ) ) };
+      const __m128i highSum{ _mm_add_epi16( high, _mm_srli_si128( high, 8 ) ) };
+
+      sums[half] = _mm_srli_epi16( _mm_add_epi16( _mm_unpacklo_epi64( lowSum, highSum ), two ), 2 );
+    }
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( dest + i ), _mm_packus_epi16( sums[0], sums[1] ) );
+  }
+
+  BoxFilter2xScalar( row0 + i * 2, row1 + i * 2, count - i, dest + i );
+}
+
+
+// 16 bytes per step, stopping at the first block with a byte that differs
+KERNEL_TARGET( "sse2" ) int32_t RunLengthSse2( const uint8_t* src, int32_t count )
+{
+  if( count <= 0 )
+  {
+    return 0;
+  }
+
+  const __m128i first{ _mm_set1_epi8( static_cast<char>( src[0] ) ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i bytes{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) };
+    const uint32_t equal{ static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( bytes, first ) ) ) };
+    if( equal != 0xffff )
+    {
+      return i + CountTrailingZeros( ~equal );
+    }
+  }
+
+  while( i < count && src[i] == src[0] )
+  {
+    ++i;
+  }
+
+  return i;
+}
+
+#endif // KERNELS_X86
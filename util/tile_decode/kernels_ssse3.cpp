@@ -0,0 +1,123 @@
+#include "kernels.h"
+
+#if KERNELS_X86
+
+#include <tmmintrin.h>
+
+
+namespace
+{
+  // Byte plane 'shift' of the first 16 table entries, as a pshufb lookup table
+  template<typename Color>
+  KERNEL_TARGET( "ssse3" ) __m128i TablePlane( const Color* table, int32_t shift )
+  {
+    alignas( 16 ) uint8_t plane[16];
+    for( int32_t i = 0; i < 16; ++i )
+    {
+      plane[i] = static_cast<uint8_t>( table[i] >> shift );
+    }
+
+    return _mm_load_si128( reinterpret_cast<const __m128i*>( plane ) );
+  }
+} // namespace
+
+
+// Palettes of up to 16 colors are looked up 16 pixels at a time, one byte plane per pshufb
+KERNEL_TARGET( "ssse3" ) void MapIndices32Ssse3( const uint8_t* src, int32_t count, const uint32_t* table,
+                                                 int32_t tableSize, uint32_t* dest )
+{
+  if( tableSize > 16 )
+  {
+    MapIndices32Scalar( src, count, table, tableSize, dest );
+    return;
+  }
+
+  const __m128i plane0{ TablePlane( table, 0 ) };
+  const __m128i plane1{ TablePlane( table, 8 ) };
+  const __m128i plane2{ TablePlane( table, 16 ) };
+  const __m128i plane3{ TablePlane( table, 24 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i indices{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) };
+
+    const __m128i byte0{ _mm_shuffle_epi8( plane0, indices ) };
+    const __m128i byte1{ _mm_shuffle_epi8( plane1, indices ) };
+    const __m128i byte2{ _mm_shuffle_epi8( plane2, indices ) };
+    const __m128i byte3{ _mm_shuffle_epi8( plane3, indices ) };
+
+    // Reassemble the planes into little-endian 32-bit colors
+    const __m128i low01{ _mm_unpacklo_epi8( byte0, byte1 ) };
+    const __m128i high01{ _mm_unpackhi_epi8( byte0, byte1 ) };
+    const __m128i low23{ _mm_unpacklo_epi8( byte2, byte3 ) };
+    const __m128i high23{ _mm_unpackhi_epi8( byte2, byte3 ) };
+
+    __m128i* out{ reinterpret_cast<__m128i*>( dest + i ) };
+    _mm_storeu_si128( out, _mm_unpacklo_epi16( low01, low23 ) );
+    _mm_storeu_si128( out + 1, _mm_unpackhi_epi16( low01, low23 ) );
+    _mm_storeu_si128( out + 2, _mm_unpacklo_epi16( high01, high23 ) );
+    _mm_storeu_si128( out + 3, _mm_unpackhi_epi16( high01, high23 ) );
+  }
+
+  MapIndices32Scalar( src + i, count - i, table, tableSize, dest + i );
+}
+
+
+KERNEL_TARGET( "ssse3" ) void MapIndices16Ssse3( const uint8_t* src, int32_t count, const uint16_t* table,
+                                                 int32_t tableSize, uint16_t* dest )
+{
+  if( tableSize > 16 )
+  {
+    MapIndices16Scalar( src, count, table, tableSize, dest );
+    return;
+  }
+
+  const __m128i plane0{ TablePlane( table, 0 ) };
+  const __m128i plane1{ TablePlane( table, 8 ) };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i indices{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) ) };
+
+    const __m128i byte0{ _mm_shuffle_epi8( plane0, indices ) };
+    const __m128i byte1{ _mm_shuffle_epi8( plane1, indices ) };
+
+    __m128i* out{ reinterpret_cast<__m128i*>( dest + i ) };
+    _mm_storeu_si128( out, _mm_unpacklo_epi8( byte0, byte1 ) );
+    _mm_storeu_si128( out + 1, _mm_unpackhi_epi8( byte0, byte1 ) );
+  }
+
+  MapIndices16Scalar( src + i, count - i, table, tableSize, dest + i );
+}
+
+
+
+// The XOR's nibbles look up their counts 16 bytes at a time, and psadbw adds the bytes up
+KERNEL_TARGET( "ssse3" ) int32_t CountPixelDifferencesSsse3( const uint8_t* a, const uint8_t* b, int32_t count,
+                                                             const PixelDifferenceTable& table )
+{
+  const __m128i low{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( table.low ) ) };
+  const __m128i high{ _mm_loadu_si128( reinterpret_cast<const __m128i*>( table.high ) ) };
+  const __m128i cap{ _mm_set1_epi8( static_cast<char>( table.cap ) ) };
+  const __m128i lowNibbles{ _mm_set1_epi8( 0x0f ) };
+
+  __m128i sums{ _mm_setzero_si128() };
+
+  int32_t i{ 0 };
+  for( ; i + 16 <= count; i += 16 )
+  {
+    const __m128i x{ _mm_xor_si128( _mm_loadu_si128( reinterpret_cast<const __m128i*>( a + i ) ),
+                                    _mm_loadu_si128( reinterpret_cast<const __m128i*>( b + i ) ) ) };
+    const __m128i lowCounts{ _mm_shuffle_epi8( low, _mm_and_si128( x, lowNibbles ) ) };
+    const __m128i highCounts{ _mm_shuffle_epi8( high, _mm_and_si128( _mm_srli_epi16( x, 4 ), lowNibbles ) ) };
+    const __m128i pixels{ _mm_min_epu8( _mm_add_epi8( lowCounts, highCounts ), cap ) };
+    sums = _mm_add_epi64( sums, _mm_sad_epu8( pixels, _mm_setzero_si128() ) );
+  }
+
+  const int32_t vectorSum{ _mm_cvtsi128_si32( sums ) + _mm_cvtsi128_si32( _mm_srli_si128( sums, 8 ) ) };
+  return vectorSum + CountPixelDifferencesScalar( a + i, b + i, count - i, table );
+}
+
+#endif // KERNELS_X86
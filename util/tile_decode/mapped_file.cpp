@@ -0,0 +1,150 @@
+#include "mapped_file.h"
+
+#include "../instrument/instrument.h"
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::~MappedFile()
+{
+  Close();
+}
+
+
+#if defined( _WIN32 )
+
+bool MappedFile::Open( const char* filename )
+{
+  INSTRUMENT_SCOPE( "map_file" );
+
+  Close();
+
+  HANDLE file{ CreateFileA( filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr ) };
+  if( file == INVALID_HANDLE_VALUE )
+  {
+    return false;
+  }
+
+  LARGE_INTEGER fileSize;
+  if( !GetFileSizeEx( file, &fileSize ) || static_cast<uint64_t>( fileSize.QuadPart ) > SIZE_MAX )
+  {
+    CloseHandle( file );
+    return false;
+  }
+
+  m_file = file;
+  m_size = static_cast<size_t>( fileSize.QuadPart );
+
+  // Empty files can't be mapped
+  if( m_size == 0 )
+  {
+    return true;
+  }
+
+  m_mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+  if( m_mapping == nullptr )
+  {
+    Close();
+    return false;
+  }
+
+  m_data = static_cast<const uint8_t*>( MapViewOfFile( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+  if( m_data == nullptr )
+  {
+    Close();
+    return false;
+  }
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, m_size );
+  return true;
+}
+
+
+void MappedFile::Close()
+{
+  if( m_data != nullptr )
+  {
+    UnmapViewOfFile( m_data );
+  }
+
+  if( m_mapping != nullptr )
+  {
+    CloseHandle( m_mapping );
+  }
+
+  if( m_file != nullptr )
+  {
+    CloseHandle( m_file );
+  }
+
+  m_data = nullptr;
+  m_size = 0;
+  m_mapping = nullptr;
+  m_file = nullptr;
+}
+
+#else
+
+bool MappedFile::Open( const char* filename )
+{
+  INSTRUMENT_SCOPE( "map_file" );
+
+  Close();
+
+  const int file{ open( filename, O_RDONLY ) };
+  if( file < 0 )
+  {
+    return false;
+  }
+
+  struct stat status;
+  if( fstat( file, &status ) != 0 )
+  {
+    close( file );
+    return false;
+  }
+
+  m_size = static_cast<size_t>( status.st_size );
+
+  if( m_size > 0 )
+  {
+    void* data{ mmap( nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0 ) };
+    if( data == MAP_FAILED )
+    {
+      close( file );
+      m_size = 0;
+      return false;
+    }
+
+    m_data = static_cast<const uint8_t*>( data );
+  }
+
+  // The mapping keeps the file alive
+  close( file );
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, m_size );
+  return true;
+}
+
+
+void MappedFile::Close()
+{
+  if( m_data != nullptr )
+  {
+    munmap( const_cast<uint8_t*>( m_data ), m_size );
+  }
+
+  m_data = nullptr;
+  m_size = 0;
+}
+
+#endif // _WIN32
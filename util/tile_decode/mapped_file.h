@@ -0,0 +1,42 @@
+// Read-only memory-mapped files, for inputs that are read in place instead of copied (game executables, map data).
+
+#ifndef TILE_DECODE_MAPPED_FILE_H
+#define TILE_DECODE_MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+class MappedFile
+{
+public:
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile( const MappedFile& ) = delete;
+  MappedFile& operator=( const MappedFile& ) = delete;
+
+  // Maps the whole file. Returns false if it can't be opened or mapped. An empty file opens with no data.
+  bool Open( const char* filename );
+  void Close();
+
+  const uint8_t* Data() const
+  {
+    return m_data;
+  }
+
+  size_t Size() const
+  {
+    return m_size;
+  }
+
+private:
+  const uint8_t* m_data{ nullptr };
+  size_t m_size{ 0 };
+
+#if defined( _WIN32 )
+  void* m_file{ nullptr };
+  void* m_mapping{ nullptr };
+#endif
+};
+
+#endif // TILE_DECODE_MAPPED_FILE_H
@@ -0,0 +1,69 @@
+// A minimal fork-join pool for the renderers: ParallelFor() hands out work items to a set of threads and returns once
+// every item is done. Items are taken in order from a shared counter, so uneven items balance themselves.
+
+#ifndef TILE_DECODE_PARALLEL_H
+#define TILE_DECODE_PARALLEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "../instrument/instrument.h"
+
+// numThreads, or one per core when it's 0 or less
+inline int32_t ResolveThreadCount( int32_t numThreads )
+{
+  if( numThreads <= 0 )
+  {
+    numThreads = static_cast<int32_t>( std::thread::hardware_concurrency() );
+  }
+
+  return numThreads > 0 ? numThreads : 1;
+}
+
+// Calls function( item ) for every item in [0, count) on up to numThreads threads (0 = one per core), including the
+// calling thread. Items must not depend on each other.
+template<typename Function>
+void ParallelFor( int32_t count, int32_t numThreads, Function&& function )
+{
+  numThreads = ResolveThreadCount( numThreads );
+  if( numThreads > count )
+  {
+    numThreads = count;
+  }
+
+  std::atomic<int32_t> nextItem{ 0 };
+
+  auto work = [&]()
+  {
+    for( int32_t item = nextItem++; item < count; item = nextItem++ )
+    {
+      function( item );
+    }
+  };
+
+  std::vector<std::thread> workers;
+  if( numThreads > 1 )
+  {
+    workers.reserve( static_cast<size_t>( numThreads - 1 ) );
+  }
+
+  for( int32_t i = 1; i < numThreads; ++i )
+  {
+    workers.emplace_back( [&work]()
+    {
+      INSTRUMENT_THREAD_NAME( "worker" );
+      work();
+    } );
+  }
+
+  work();
+
+  for( std::thread& worker : workers )
+  {
+    worker.join();
+  }
+}
+
+#endif // TILE_DECODE_PARALLEL_H
@@ -0,0 +1,17 @@
+#include "ripper_options.h"
+
+#include <cstring>
+
+
+bool HasVerifyOption( int32_t argc, char* argv[] )
+{
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--verify" ) == 0 )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
@@ -0,0 +1,29 @@
+// The command line options every ripper takes. Each ripper's own notes only add what's particular to it: the reference
+// files --verify compares against, what goes into a pack or datafile, and which inputs --watch follows.
+//
+// --verify compares the decoded graphics against the reference .png files in the ripper's folder instead of writing
+// .pcx files (see golden_verify.h). Decoding doesn't need Allegro, so verification runs headless.
+//
+// --pack FILE.utp writes the tiles and characters as a tile pack (see tile_pack.h) that an engine can map and use as
+// is, instead of the .pcx files and without opening a window. Add --pack-rle to compress the tiles. Where a ripper
+// takes --watch, it keeps running after that and patches the pack in place whenever one of its inputs is saved,
+// decoding only the tiles whose bytes changed (see tile_watch.h). The pack is written raw so tiles can be patched.
+//
+// --datafile FILE.dat writes every tile and character as a BITMAP object of an Allegro datafile (see
+// datafile_writer.h), with the palette, so Allegro tools can load them all with load_datafile(). That replaces the
+// .pcx files. Add --datafile-packed to compress it.
+//
+// --stats writes per-stage timings and counters to stats.json and a Chrome trace to trace.json (see instrument.h).
+//
+// The decode kernels use the widest vector instructions the CPU supports. --force-isa scalar|sse2|ssse3|avx2|avx512
+// picks a lower level (see cpu_dispatch.h).
+
+#ifndef TILE_DECODE_RIPPER_OPTIONS_H
+#define TILE_DECODE_RIPPER_OPTIONS_H
+
+#include <cstdint>
+
+// Scans the command line for --verify, which the rippers check before starting Allegro
+bool HasVerifyOption( int32_t argc, char* argv[] );
+
+#endif // TILE_DECODE_RIPPER_OPTIONS_H
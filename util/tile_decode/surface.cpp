@@ -0,0 +1,56 @@
+#include "surface.h"
+
+#include <cstdio>
+#include <fstream>
+
+
+bool ReadFileBytes( const char* filename, std::vector<uint8_t>& bytes )
+{
+  INSTRUMENT_SCOPE( "read" );
+
+  std::ifstream infile;
+  infile.open( filename, std::ios::in | std::ios::binary | std::ios::ate );
+
+  if( !infile.is_open() )
+  {
+    return false;
+  }
+
+  // Get file size (note that the file was opened with ios::ate so the size can be fetched)
+  const std::streamoff numBytes{ infile.tellg() };
+
+  // Reset to the beginning
+  infile.seekg( 0, std::ios::beg );
+
+  bytes.resize( static_cast<size_t>( numBytes ) );
+  if( numBytes > 0 )
+  {
+    infile.read( reinterpret_cast<char*>( bytes.data() ), numBytes );
+  }
+
+  infile.close();
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_IN, bytes.size() );
+  INSTRUMENT_COUNT( COUNTER_ALLOCATIONS, 1 );
+  INSTRUMENT_COUNT( COUNTER_ALLOCATED_BYTES, bytes.size() );
+
+  return true;
+}
+
+
+bool WriteFileBytes( const char* filename, const std::vector<uint8_t>& bytes )
+{
+  INSTRUMENT_SCOPE( "write" );
+
+  FILE* file{ fopen( filename, "wb" ) };
+  if( file == nullptr )
+  {
+    return false;
+  }
+
+  const bool written{ bytes.empty() || fwrite( bytes.data(), bytes.size(), 1, file ) == 1 };
+  const bool closed{ fclose( file ) == 0 };
+
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, bytes.size() );
+  return written && closed;
+}
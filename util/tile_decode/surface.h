@@ -0,0 +1,88 @@
+// Indexed pixel surfaces shared by the rippers.
+// Decoders write palette indices (not makecol() colors) so the output can be compared, cached, and converted to any
+// color depth after the fact.
+
+#ifndef TILE_DECODE_SURFACE_H
+#define TILE_DECODE_SURFACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "../instrument/instrument.h"
+
+struct IndexSurface
+{
+  int32_t width{ 0 };
+  int32_t height{ 0 };
+  int32_t pitch{ 0 };
+  std::vector<uint8_t> pixels;
+
+  void Create( int32_t w, int32_t h, uint8_t fill = 0 )
+  {
+    width = w;
+    height = h;
+    pitch = w;
+    pixels.assign( static_cast<size_t>( w ) * static_cast<size_t>( h ), fill );
+
+    INSTRUMENT_COUNT( COUNTER_ALLOCATIONS, 1 );
+    INSTRUMENT_COUNT( COUNTER_ALLOCATED_BYTES, pixels.size() );
+  }
+
+  uint8_t* Row( int32_t y )
+  {
+    return pixels.data() + static_cast<size_t>( y ) * pitch;
+  }
+
+  const uint8_t* Row( int32_t y ) const
+  {
+    return pixels.data() + static_cast<size_t>( y ) * pitch;
+  }
+};
+
+// True color pixels for output that doesn't fit a palette, such as the NTSC simulation. Pixels are 0x00BBGGRR (R in
+// the lowest byte), the layout EncodePngRgb() takes.
+struct RgbSurface
+{
+  int32_t width{ 0 };
+  int32_t height{ 0 };
+  int32_t pitch{ 0 };
+  std::vector<uint32_t> pixels;
+
+  void Create( int32_t w, int32_t h )
+  {
+    width = w;
+    height = h;
+    pitch = w;
+    pixels.assign( static_cast<size_t>( w ) * static_cast<size_t>( h ), 0 );
+
+    INSTRUMENT_COUNT( COUNTER_ALLOCATIONS, 1 );
+    INSTRUMENT_COUNT( COUNTER_ALLOCATED_BYTES, pixels.size() * sizeof( uint32_t ) );
+  }
+
+  uint32_t* Row( int32_t y )
+  {
+    return pixels.data() + static_cast<size_t>( y ) * pitch;
+  }
+
+  const uint32_t* Row( int32_t y ) const
+  {
+    return pixels.data() + static_cast<size_t>( y ) * pitch;
+  }
+};
+
+// An RGB palette, one entry per palette index
+struct PaletteEntry
+{
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+};
+
+// Reads an entire file into memory. Returns false if the file can't be opened.
+bool ReadFileBytes( const char* filename, std::vector<uint8_t>& bytes );
+
+// Writes bytes to filename, replacing it. Returns false if the file can't be written.
+bool WriteFileBytes( const char* filename, const std::vector<uint8_t>& bytes );
+
+#endif // TILE_DECODE_SURFACE_H
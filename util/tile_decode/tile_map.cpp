@@ -0,0 +1,151 @@
+#include "tile_map.h"
+
+#include <cstring>
+
+
+int32_t TileAtlas::AddStrip( const IndexSurface& strip )
+{
+  if( strip.width != tileWidth || tileHeight <= 0 )
+  {
+    return -1;
+  }
+
+  const int32_t count{ strip.height / tileHeight };
+  const int32_t rows{ count * tileHeight };
+
+  tiles.pixels.reserve( tiles.pixels.size() + static_cast<size_t>( rows ) * tileWidth );
+  for( int32_t y = 0; y < rows; ++y )
+  {
+    const uint8_t* row{ strip.Row( y ) };
+    tiles.pixels.insert( tiles.pixels.end(), row, row + tileWidth );
+  }
+
+  tiles.height += rows;
+  numTiles += count;
+
+  return count;
+}
+
+
+bool ClipTileRegion( const TileMapView& map, TileRegion& region )
+{
+  if( region.x < 0 )
+  {
+    region.width += region.x;
+    region.x = 0;
+  }
+
+  if( region.y < 0 )
+  {
+    region.height += region.y;
+    region.y = 0;
+  }
+
+  if( region.x + region.width > map.width )
+  {
+    region.width = map.width - region.x;
+  }
+
+  if( region.y + region.height > map.height )
+  {
+    region.height = map.height - region.y;
+  }
+
+  if( region.width <= 0 || region.height <= 0 )
+  {
+    region.width = 0;
+    region.height = 0;
+    return false;
+  }
+
+  return true;
+}
+
+
+int32_t DrawTileMap( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region, uint8_t* dest,
+                     int32_t destPitch )
+{
+  const int32_t entrySize{ TileMapEntrySize( map.encoding ) };
+  const size_t tileRowBytes{ static_cast<size_t>( atlas.tileWidth ) };
+  const size_t tileBytes{ tileRowBytes * atlas.tileHeight };
+
+  // The first row of every tile in the map row, or null for tiles that stay as fill
+  std::vector<const uint8_t*> tiles( static_cast<size_t>( region.width ) );
+  int32_t numMissing{ 0 };
+
+  for( int32_t mapRow = 0; mapRow < region.height; ++mapRow )
+  {
+    const uint8_t* entry{ TileMapEntry( map, region.x, region.y + mapRow ) };
+
+    for( int32_t column = 0; column < region.width; ++column, entry += entrySize )
+    {
+      const int32_t tile{ TileMapNumber( entry, map.encoding ) };
+      if( tile < atlas.numTiles )
+      {
+        tiles[column] = atlas.tiles.pixels.data() + tile * tileBytes;
+      }
+      else
+      {
+        tiles[column] = nullptr;
+        ++numMissing;
+      }
+    }
+
+    for( int32_t tileY = 0; tileY < atlas.tileHeight; ++tileY )
+    {
+      uint8_t* out{ dest + static_cast<size_t>( mapRow * atlas.tileHeight + tileY ) * destPitch };
+      const size_t offset{ tileY * tileRowBytes };
+
+      for( int32_t column = 0; column < region.width; ++column, out += tileRowBytes )
+      {
+        if( tiles[column] != nullptr )
+        {
+          memcpy( out, tiles[column] + offset, tileRowBytes );
+        }
+      }
+    }
+  }
+
+  return numMissing;
+}
+
+
+int32_t RenderTileMap( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region, IndexSurface& dest,
+                       int32_t numThreads, uint8_t fill )
+{
+  return RenderTileMapBands( region, atlas.tileWidth, atlas.tileHeight, dest, numThreads, fill,
+                             [&]( const TileRegion& rows, uint8_t* destRow )
+  {
+    return DrawTileMap( atlas, map, rows, destRow, dest.pitch );
+  } );
+}
+
+
+int32_t RenderTileMapReference( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region,
+                                IndexSurface& dest, uint8_t fill )
+{
+  dest.Create( region.width * atlas.tileWidth, region.height * atlas.tileHeight, fill );
+
+  int32_t numMissing{ 0 };
+
+  for( int32_t y = 0; y < dest.height; ++y )
+  {
+    for( int32_t x = 0; x < dest.width; ++x )
+    {
+      const int32_t column{ x / atlas.tileWidth };
+      const int32_t mapRow{ y / atlas.tileHeight };
+      const int32_t tile{ TileMapNumber( TileMapEntry( map, region.x + column, region.y + mapRow ), map.encoding ) };
+
+      if( tile < atlas.numTiles )
+      {
+        dest.Row( y )[x] = atlas.TileRow( tile, y % atlas.tileHeight )[x % atlas.tileWidth];
+      }
+      else if( x % atlas.tileWidth == 0 && y % atlas.tileHeight == 0 )
+      {
+        ++numMissing;
+      }
+    }
+  }
+
+  return numMissing;
+}
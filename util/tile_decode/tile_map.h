@@ -0,0 +1,159 @@
+// Tile map composition shared by the map renderers.
+// A tile map is a grid of tile numbers. The tiles are decoded once into an atlas, and the map is drawn from it one
+// output row at a time: each pixel row of a map row is a run of tile-row copies, so the destination is written in order
+// and the atlas tiles (each one contiguous) stay in cache. Bands of map rows are drawn on separate threads.
+
+#ifndef TILE_DECODE_TILE_MAP_H
+#define TILE_DECODE_TILE_MAP_H
+
+#include <vector>
+
+#include "parallel.h"
+#include "surface.h"
+
+// Every tile of every tile set, each stored as one contiguous block of tileWidth * tileHeight indices
+struct TileAtlas
+{
+  int32_t tileWidth{ 0 };
+  int32_t tileHeight{ 0 };
+  int32_t numTiles{ 0 };
+  IndexSurface tiles;
+
+  void Create( int32_t width, int32_t height )
+  {
+    tileWidth = width;
+    tileHeight = height;
+    numTiles = 0;
+    tiles.Create( width, 0 );
+  }
+
+  // Appends every whole tile of a sheet that is one tile wide (a vertical strip, like shapes.ega). Returns the number
+  // of tiles added, or -1 if the sheet is the wrong width.
+  int32_t AddStrip( const IndexSurface& strip );
+
+  const uint8_t* TileRow( int32_t tile, int32_t y ) const
+  {
+    return tiles.Row( tile * tileHeight + y );
+  }
+};
+
+enum TileMapEncoding
+{
+  TILE_MAP_BYTE,          // One byte per tile: the tile number
+  TILE_MAP_SET_AND_INDEX  // Two bytes per tile: the tile set, then the tile within the set (256 per set)
+};
+
+// A tile map read in place. Row y starts at data + y * stride.
+struct TileMapView
+{
+  const uint8_t* data{ nullptr };
+  int32_t width{ 0 };
+  int32_t height{ 0 };
+  int32_t stride{ 0 };
+  TileMapEncoding encoding{ TILE_MAP_BYTE };
+};
+
+// A rectangle of the map, in tiles
+struct TileRegion
+{
+  int32_t x{ 0 };
+  int32_t y{ 0 };
+  int32_t width{ 0 };
+  int32_t height{ 0 };
+};
+
+inline int32_t TileMapEntrySize( TileMapEncoding encoding )
+{
+  return encoding == TILE_MAP_SET_AND_INDEX ? 2 : 1;
+}
+
+// The entry at (x, y) of the map
+inline const uint8_t* TileMapEntry( const TileMapView& map, int32_t x, int32_t y )
+{
+  return map.data + static_cast<size_t>( y ) * map.stride + static_cast<size_t>( x ) * TileMapEntrySize( map.encoding );
+}
+
+// The tile number an entry holds, counting across tile sets
+inline int32_t TileMapNumber( const uint8_t* entry, TileMapEncoding encoding )
+{
+  return encoding == TILE_MAP_SET_AND_INDEX ? entry[0] * 256 + entry[1] : entry[0];
+}
+
+// Clips region to the map. Returns false if nothing is left.
+bool ClipTileRegion( const TileMapView& map, TileRegion& region );
+
+// Draws region of the map on the calling thread into dest, which is destPitch bytes per row and big enough for the
+// region. Tiles the atlas doesn't have are skipped. Returns the number of those.
+int32_t DrawTileMap( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region, uint8_t* dest,
+                     int32_t destPitch );
+
+// Draws region of the map into dest (which is recreated at the region's pixel size) using numThreads bands, or one
+// per core when numThreads is 0. Tiles the atlas doesn't have are left as fill. Returns the number of those.
+int32_t RenderTileMap( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region, IndexSurface& dest,
+                       int32_t numThreads = 0, uint8_t fill = 0 );
+
+// The banding behind RenderTileMap(), for renderers that draw from other kinds of tile sets. Recreates dest at the
+// region's pixel size, splits the region into bands of map rows on numThreads threads (0 = one per core), and calls
+// drawBand( rows, destRow ) for each, which draws the map rows of one band starting at destRow and returns the number
+// of tiles it couldn't draw. Returns the sum of those.
+template<typename DrawBand>
+int32_t RenderTileMapBands( const TileRegion& region, int32_t tileWidth, int32_t tileHeight, IndexSurface& dest,
+                            int32_t numThreads, uint8_t fill, DrawBand&& drawBand );
+
+// Per-pixel version of RenderTileMap(), which is verified against this
+int32_t RenderTileMapReference( const TileAtlas& atlas, const TileMapView& map, const TileRegion& region,
+                                IndexSurface& dest, uint8_t fill = 0 );
+
+
+
+template<typename DrawBand>
+int32_t RenderTileMapBands( const TileRegion& region, int32_t tileWidth, int32_t tileHeight, IndexSurface& dest,
+                            int32_t numThreads, uint8_t fill, DrawBand&& drawBand )
+{
+  INSTRUMENT_SCOPE( "render" );
+
+  dest.Create( region.width * tileWidth, region.height * tileHeight, fill );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, dest.pixels.size() );
+
+  if( region.width <= 0 || region.height <= 0 )
+  {
+    return 0;
+  }
+
+  numThreads = ResolveThreadCount( numThreads );
+
+  // Small maps aren't worth a thread per band
+  const int32_t minRowsPerBand{ 4 };
+  if( numThreads > region.height / minRowsPerBand )
+  {
+    numThreads = region.height / minRowsPerBand;
+  }
+
+  if( numThreads < 1 )
+  {
+    numThreads = 1;
+  }
+
+  std::vector<int32_t> numMissing( static_cast<size_t>( numThreads ), 0 );
+
+  ParallelFor( numThreads, numThreads, [&]( int32_t band )
+  {
+    INSTRUMENT_SCOPE( "render_band" );
+
+    const int32_t firstRow{ static_cast<int32_t>( static_cast<int64_t>( region.height ) * band / numThreads ) };
+    const int32_t endRow{ static_cast<int32_t>( static_cast<int64_t>( region.height ) * ( band + 1 ) / numThreads ) };
+    const TileRegion rows{ region.x, region.y + firstRow, region.width, endRow - firstRow };
+
+    numMissing[band] = drawBand( rows, dest.Row( firstRow * tileHeight ) );
+  } );
+
+  int32_t totalMissing{ 0 };
+  for( const int32_t bandMissing : numMissing )
+  {
+    totalMissing += bandMissing;
+  }
+
+  return totalMissing;
+}
+
+#endif // TILE_DECODE_TILE_MAP_H
@@ -0,0 +1,345 @@
+#include "tile_pack.h"
+
+#include <cstdio>
+#include <cstring>
+
+#include "ega_decode.h"
+#include "ega_encode.h"
+#include "parallel.h"
+
+
+namespace
+{
+  inline size_t AlignUp( size_t value )
+  {
+    return ( value + TILE_PACK_ALIGNMENT - 1 ) & ~static_cast<size_t>( TILE_PACK_ALIGNMENT - 1 );
+  }
+} // namespace
+
+
+int32_t TilePackWriter::AddPalette( const PaletteEntry* palette, int32_t paletteSize )
+{
+  const int32_t id{ static_cast<int32_t>( m_palettes.size() / TILE_PACK_PALETTE_ENTRIES ) };
+
+  m_palettes.resize( m_palettes.size() + TILE_PACK_PALETTE_ENTRIES, TilePackColor{ 0, 0, 0, 0 } );
+  TilePackColor* colors{ &m_palettes[static_cast<size_t>( id ) * TILE_PACK_PALETTE_ENTRIES] };
+
+  for( int32_t i = 0; i < paletteSize && i < TILE_PACK_PALETTE_ENTRIES; ++i )
+  {
+    colors[i] = TilePackColor{ palette[i].r, palette[i].g, palette[i].b, 0 };
+  }
+
+  return id;
+}
+
+
+int32_t TilePackWriter::AddTile( const uint8_t* pixels, int32_t pitch, int32_t width, int32_t height,
+                                 int32_t palette )
+{
+  m_tiles.push_back( Tile{ width, height, palette, m_pixels.size() } );
+
+  for( int32_t y = 0; y < height; ++y )
+  {
+    const uint8_t* row{ pixels + static_cast<size_t>( y ) * pitch };
+    m_pixels.insert( m_pixels.end(), row, row + width );
+  }
+
+  return static_cast<int32_t>( m_tiles.size() ) - 1;
+}
+
+
+int32_t TilePackWriter::AddSheet( const IndexSurface& sheet, int32_t tileWidth, int32_t tileHeight, int32_t palette,
+                                  int32_t numTiles )
+{
+  const int32_t tilesPerRow{ tileWidth > 0 ? sheet.width / tileWidth : 0 };
+  const int32_t tilesPerColumn{ tileHeight > 0 ? sheet.height / tileHeight : 0 };
+  const int32_t count{ numTiles >= 0 && numTiles < tilesPerRow * tilesPerColumn ? numTiles
+                                                                                   : tilesPerRow * tilesPerColumn };
+  if( count <= 0 )
+  {
+    return -1;
+  }
+
+  m_pixels.reserve( m_pixels.size() + static_cast<size_t>( count ) * tileWidth * tileHeight );
+
+  const int32_t first{ static_cast<int32_t>( m_tiles.size() ) };
+  for( int32_t tile = 0; tile < count; ++tile )
+  {
+    const int32_t x{ ( tile % tilesPerRow ) * tileWidth };
+    const int32_t y{ ( tile / tilesPerRow ) * tileHeight };
+    AddTile( sheet.Row( y ) + x, sheet.pitch, tileWidth, tileHeight, palette );
+  }
+
+  return first;
+}
+
+
+void TilePackWriter::Store( std::vector<uint8_t>& bytes, bool compress, int32_t numThreads ) const
+{
+  INSTRUMENT_SCOPE( "pack" );
+
+  const int32_t numTiles{ static_cast<int32_t>( m_tiles.size() ) };
+
+  // Each tile's stored bytes, when compression pays off
+  std::vector<std::vector<uint8_t>> encoded( compress ? m_tiles.size() : 0 );
+  if( compress )
+  {
+    ParallelFor( numTiles, numThreads, [&]( int32_t tile )
+    {
+      const Tile& source{ m_tiles[tile] };
+      const size_t size{ static_cast<size_t>( source.width ) * source.height };
+
+      EncodeEgaRle( &m_pixels[source.offset], size, encoded[tile] );
+      if( encoded[tile].size() >= size )
+      {
+        encoded[tile].clear();
+        encoded[tile].shrink_to_fit();
+      }
+    } );
+  }
+
+  TilePackHeader header{};
+  memcpy( header.magic, "UTPK", 4 );
+  header.version = TILE_PACK_VERSION;
+  header.headerSize = sizeof( TilePackHeader );
+  header.numTiles = static_cast<uint32_t>( numTiles );
+  header.numPalettes = static_cast<uint32_t>( m_palettes.size() / TILE_PACK_PALETTE_ENTRIES );
+  header.indexOffset = static_cast<uint32_t>( AlignUp( sizeof( TilePackHeader ) ) );
+  header.paletteOffset = static_cast<uint32_t>( AlignUp( header.indexOffset + numTiles * sizeof( TilePackEntry ) ) );
+  header.pixelOffset = static_cast<uint32_t>( AlignUp( header.paletteOffset +
+                                                       m_palettes.size() * sizeof( TilePackColor ) ) );
+
+  std::vector<TilePackEntry> entries( m_tiles.size() );
+  size_t offset{ header.pixelOffset };
+  for( int32_t tile = 0; tile < numTiles; ++tile )
+  {
+    const Tile& source{ m_tiles[tile] };
+    const bool packed{ compress && !encoded[tile].empty() };
+
+    TilePackEntry& entry{ entries[tile] };
+    entry.width = static_cast<uint16_t>( source.width );
+    entry.height = static_cast<uint16_t>( source.height );
+    entry.palette = static_cast<uint16_t>( source.palette );
+    entry.codec = static_cast<uint16_t>( packed ? TILE_PACK_CODEC_RLE : TILE_PACK_CODEC_RAW );
+    entry.offset = static_cast<uint32_t>( offset );
+    entry.size = static_cast<uint32_t>( packed ? encoded[tile].size()
+                                               : static_cast<size_t>( source.width ) * source.height );
+
+    offset = AlignUp( offset + entry.size );
+  }
+
+  header.fileSize = static_cast<uint32_t>( offset );
+
+  bytes.assign( offset, 0 );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, bytes.size() );
+
+  memcpy( bytes.data(), &header, sizeof( header ) );
+  if( numTiles > 0 )
+  {
+    memcpy( &bytes[header.indexOffset], entries.data(), entries.size() * sizeof( TilePackEntry ) );
+  }
+
+  if( !m_palettes.empty() )
+  {
+    memcpy( &bytes[header.paletteOffset], m_palettes.data(), m_palettes.size() * sizeof( TilePackColor ) );
+  }
+
+  for( int32_t tile = 0; tile < numTiles; ++tile )
+  {
+    const uint8_t* source{ entries[tile].codec == TILE_PACK_CODEC_RLE ? encoded[tile].data()
+                                                                      : &m_pixels[m_tiles[tile].offset] };
+    memcpy( &bytes[entries[tile].offset], source, entries[tile].size );
+  }
+}
+
+
+bool TilePackWriter::Save( const char* filename, bool compress ) const
+{
+  std::vector<uint8_t> bytes;
+  Store( bytes, compress );
+  return WriteFileBytes( filename, bytes );
+}
+
+
+bool TilePackView::Open( const uint8_t* data, size_t size )
+{
+  m_data = nullptr;
+  m_header = nullptr;
+  m_entries = nullptr;
+  m_palettes = nullptr;
+
+  // The structs are read in place, so the buffer has to be aligned for them (mappings always are)
+  if( data == nullptr || size < sizeof( TilePackHeader ) ||
+      reinterpret_cast<uintptr_t>( data ) % alignof( TilePackHeader ) != 0 )
+  {
+    return false;
+  }
+
+  const TilePackHeader* header{ reinterpret_cast<const TilePackHeader*>( data ) };
+  if( memcmp( header->magic, "UTPK", 4 ) != 0 || header->version != TILE_PACK_VERSION ||
+      header->headerSize != sizeof( TilePackHeader ) || header->fileSize > size )
+  {
+    return false;
+  }
+
+  const uint64_t indexEnd{ header->indexOffset + static_cast<uint64_t>( header->numTiles ) * sizeof( TilePackEntry ) };
+  const uint64_t paletteEnd{ header->paletteOffset + static_cast<uint64_t>( header->numPalettes ) *
+                             TILE_PACK_PALETTE_ENTRIES * sizeof( TilePackColor ) };
+  if( header->indexOffset % TILE_PACK_ALIGNMENT != 0 || header->paletteOffset % TILE_PACK_ALIGNMENT != 0 ||
+      header->indexOffset < sizeof( TilePackHeader ) || indexEnd > header->fileSize ||
+      paletteEnd > header->fileSize || header->numPalettes > 0xffff )
+  {
+    return false;
+  }
+
+  const TilePackEntry* entries{ reinterpret_cast<const TilePackEntry*>( data + header->indexOffset ) };
+  for( uint32_t tile = 0; tile < header->numTiles; ++tile )
+  {
+    const TilePackEntry& entry{ entries[tile] };
+    const uint32_t rawSize{ static_cast<uint32_t>( entry.width ) * entry.height };
+
+    if( entry.palette >= header->numPalettes || entry.offset + static_cast<uint64_t>( entry.size ) > header->fileSize ||
+        ( entry.codec == TILE_PACK_CODEC_RAW && entry.size != rawSize ) ||
+        ( entry.codec != TILE_PACK_CODEC_RAW && entry.codec != TILE_PACK_CODEC_RLE ) )
+    {
+      return false;
+    }
+  }
+
+  m_data = data;
+  m_header = header;
+  m_entries = entries;
+  m_palettes = reinterpret_cast<const TilePackColor*>( data + header->paletteOffset );
+  return true;
+}
+
+
+bool TilePackView::ExtractTile( int32_t tile, uint8_t* dest, int32_t destPitch ) const
+{
+  const TilePackEntry& entry{ m_entries[tile] };
+  const uint8_t* source{ m_data + entry.offset };
+  const size_t size{ static_cast<size_t>( entry.width ) * entry.height };
+
+  // Compressed tiles expand straight into dest when its rows are back to back
+  std::vector<uint8_t> expanded;
+  if( entry.codec == TILE_PACK_CODEC_RLE )
+  {
+    if( destPitch == entry.width )
+    {
+      return ExpandEgaRle( source, entry.size, dest, size ) == size;
+    }
+
+    expanded.resize( size );
+    if( ExpandEgaRle( source, entry.size, expanded.data(), size ) != size )
+    {
+      return false;
+    }
+
+    source = expanded.data();
+  }
+
+  for( int32_t y = 0; y < entry.height; ++y )
+  {
+    memcpy( dest + static_cast<size_t>( y ) * destPitch, source + static_cast<size_t>( y ) * entry.width,
+            entry.width );
+  }
+
+  return true;
+}
+
+
+TilePackPatcher::~TilePackPatcher()
+{
+  Close();
+}
+
+
+bool TilePackPatcher::Open( const char* filename )
+{
+  Close();
+
+  std::vector<uint8_t> bytes;
+  TilePackView view;
+  if( !ReadFileBytes( filename, bytes ) || !view.Open( bytes.data(), bytes.size() ) )
+  {
+    return false;
+  }
+
+  m_file = fopen( filename, "r+b" );
+  if( m_file == nullptr )
+  {
+    return false;
+  }
+
+  m_entries.resize( static_cast<size_t>( view.NumTiles() ) );
+  for( int32_t tile = 0; tile < view.NumTiles(); ++tile )
+  {
+    m_entries[tile] = view.Tile( tile );
+  }
+
+  return true;
+}
+
+
+void TilePackPatcher::Close()
+{
+  if( m_file != nullptr )
+  {
+    fclose( m_file );
+    m_file = nullptr;
+  }
+
+  m_entries.clear();
+}
+
+
+bool TilePackPatcher::PatchTile( int32_t tile, const uint8_t* pixels, int32_t pitch )
+{
+  const TilePackEntry& entry{ m_entries[tile] };
+  if( m_file == nullptr || entry.codec != TILE_PACK_CODEC_RAW ||
+      fseek( m_file, static_cast<long>( entry.offset ), SEEK_SET ) != 0 )
+  {
+    return false;
+  }
+
+  // Raw tiles are stored without padding, so a tile with back to back rows goes in one write
+  const size_t rowBytes{ pitch == entry.width ? entry.size : entry.width };
+  const int32_t numRows{ pitch == entry.width ? 1 : entry.height };
+
+  for( int32_t y = 0; y < numRows; ++y )
+  {
+    if( fwrite( pixels + static_cast<size_t>( y ) * pitch, 1, rowBytes, m_file ) != rowBytes )
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool TilePackPatcher::Flush()
+{
+  return m_file != nullptr && fflush( m_file ) == 0;
+}
+
+
+const char* FindPackOption( int32_t argc, char* argv[], bool& compress )
+{
+  const char* filename{ nullptr };
+  compress = false;
+
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--pack" ) == 0 && i + 1 < argc )
+    {
+      filename = argv[++i];
+    }
+    else if( strcmp( argv[i], "--pack-rle" ) == 0 )
+    {
+      compress = true;
+    }
+  }
+
+  return filename;
+}
@@ -0,0 +1,187 @@
+// Tile packs (.utp): ripped tiles in a single file that an engine maps and uses in place, with nothing to decode at
+// load time.
+//
+// The file is the structs below laid out one after another, each section starting on a TILE_PACK_ALIGNMENT byte
+// boundary. All values are little endian:
+//   TilePackHeader
+//   one TilePackEntry per tile
+//   256 TilePackColor entries per palette (entries past the source palette are black)
+//   the pixels: every tile's palette indices, row after row with no padding, each tile starting on an aligned offset
+// A tile stored with TILE_PACK_CODEC_RLE holds the EGA RLE of those bytes instead (see ega_encode.h), which expands
+// with a memset per run. Tiles are only compressed when it makes them smaller, and a pack written without compression
+// can be blitted from straight out of the mapping.
+
+#ifndef TILE_DECODE_TILE_PACK_H
+#define TILE_DECODE_TILE_PACK_H
+
+#include <cstdio>
+
+#include "surface.h"
+
+#define TILE_PACK_VERSION         1
+#define TILE_PACK_ALIGNMENT       16
+#define TILE_PACK_PALETTE_ENTRIES 256
+
+enum TilePackCodec
+{
+  TILE_PACK_CODEC_RAW,
+  TILE_PACK_CODEC_RLE
+};
+
+struct TilePackHeader
+{
+  char magic[4];         // "UTPK"
+  uint16_t version;      // TILE_PACK_VERSION
+  uint16_t headerSize;   // sizeof( TilePackHeader )
+  uint32_t numTiles;
+  uint32_t numPalettes;
+  uint32_t indexOffset;  // From the start of the file, like every offset
+  uint32_t paletteOffset;
+  uint32_t pixelOffset;
+  uint32_t fileSize;
+};
+
+struct TilePackEntry
+{
+  uint16_t width;
+  uint16_t height;
+  uint16_t palette;
+  uint16_t codec;        // TilePackCodec
+  uint32_t offset;
+  uint32_t size;         // Stored bytes: width * height for raw tiles
+};
+
+struct TilePackColor
+{
+  uint8_t r;
+  uint8_t g;
+  uint8_t b;
+  uint8_t unused;
+};
+
+static_assert( sizeof( TilePackHeader ) == 32 && sizeof( TilePackEntry ) == 16 && sizeof( TilePackColor ) == 4,
+               "Tile pack structs are read straight from the file" );
+
+// Collects tiles from decoded sheets and writes them out as a pack
+class TilePackWriter
+{
+public:
+  // Returns the palette's id
+  int32_t AddPalette( const PaletteEntry* palette, int32_t paletteSize );
+
+  // Adds one tile, copied out of pixels (pitch bytes per row). Returns its tile number.
+  int32_t AddTile( const uint8_t* pixels, int32_t pitch, int32_t width, int32_t height, int32_t palette );
+
+  // Adds every whole tile of a sheet, left to right and then top to bottom, or the first numTiles of them. Returns the
+  // tile number of the first one, or -1 if the sheet has none.
+  int32_t AddSheet( const IndexSurface& sheet, int32_t tileWidth, int32_t tileHeight, int32_t palette,
+                    int32_t numTiles = -1 );
+
+  // Lays the pack out in memory. With compress, tiles are RLE encoded on numThreads threads (0 for one per core) and
+  // kept that way where it's smaller.
+  void Store( std::vector<uint8_t>& bytes, bool compress, int32_t numThreads = 0 ) const;
+
+  bool Save( const char* filename, bool compress ) const;
+
+private:
+  struct Tile
+  {
+    int32_t width;
+    int32_t height;
+    int32_t palette;
+    size_t offset;  // Into m_pixels
+  };
+
+  std::vector<Tile> m_tiles;
+  std::vector<uint8_t> m_pixels;
+  std::vector<TilePackColor> m_palettes;
+};
+
+// A pack read in place, from a MappedFile or any other buffer that outlives the view. Open() checks that every table
+// and tile lies inside the data, once, so the accessors never have to.
+class TilePackView
+{
+public:
+  // Returns false if the data isn't a pack this version reads, or anything in it points outside the data
+  bool Open( const uint8_t* data, size_t size );
+
+  int32_t NumTiles() const
+  {
+    return m_header != nullptr ? static_cast<int32_t>( m_header->numTiles ) : 0;
+  }
+
+  int32_t NumPalettes() const
+  {
+    return m_header != nullptr ? static_cast<int32_t>( m_header->numPalettes ) : 0;
+  }
+
+  const TilePackEntry& Tile( int32_t tile ) const
+  {
+    return m_entries[tile];
+  }
+
+  // TILE_PACK_PALETTE_ENTRIES colors
+  const TilePackColor* Palette( int32_t palette ) const
+  {
+    return m_palettes + static_cast<size_t>( palette ) * TILE_PACK_PALETTE_ENTRIES;
+  }
+
+  // The tile's pixels in place (width bytes per row), or null if it's compressed
+  const uint8_t* Pixels( int32_t tile ) const
+  {
+    return m_entries[tile].codec == TILE_PACK_CODEC_RAW ? m_data + m_entries[tile].offset : nullptr;
+  }
+
+  // Copies or expands a tile into dest, which is destPitch bytes per row. Returns false if a compressed tile expands
+  // short.
+  bool ExtractTile( int32_t tile, uint8_t* dest, int32_t destPitch ) const;
+
+private:
+  const uint8_t* m_data{ nullptr };
+  const TilePackHeader* m_header{ nullptr };
+  const TilePackEntry* m_entries{ nullptr };
+  const TilePackColor* m_palettes{ nullptr };
+};
+
+// Rewrites tiles of a pack file in place, for --watch: anything that has the pack mapped sees the new pixels without
+// reopening it. Only raw tiles can be patched, since a compressed tile's size depends on its pixels.
+class TilePackPatcher
+{
+public:
+  TilePackPatcher() = default;
+  ~TilePackPatcher();
+
+  TilePackPatcher( const TilePackPatcher& ) = delete;
+  TilePackPatcher& operator=( const TilePackPatcher& ) = delete;
+
+  // Returns false if the file can't be opened for writing or isn't a pack this version reads
+  bool Open( const char* filename );
+  void Close();
+
+  int32_t NumTiles() const
+  {
+    return static_cast<int32_t>( m_entries.size() );
+  }
+
+  const TilePackEntry& Tile( int32_t tile ) const
+  {
+    return m_entries[tile];
+  }
+
+  // Writes the tile's width x height pixels from pixels (pitch bytes per row) over the stored ones. Returns false if
+  // the tile is compressed or the write fails.
+  bool PatchTile( int32_t tile, const uint8_t* pixels, int32_t pitch );
+
+  // Hands the patches to the OS, after which every mapping of the file has them
+  bool Flush();
+
+private:
+  FILE* m_file{ nullptr };
+  std::vector<TilePackEntry> m_entries;
+};
+
+// Finds --pack FILE on the command line, and --pack-rle to compress the tiles. Returns FILE, or null if there's no
+// --pack.
+const char* FindPackOption( int32_t argc, char* argv[], bool& compress );
+
+#endif // TILE_DECODE_TILE_PACK_H
@@ -0,0 +1,41 @@
+#include "vga_decode.h"
+
+#include <cstring>
+
+
+bool LoadVgaPalette( const uint8_t* data, size_t numBytes, PaletteEntry palette[VGA_PALETTE_SIZE] )
+{
+  if( numBytes < VGA_PALETTE_FILE_SIZE )
+  {
+    return false;
+  }
+
+  // Rounded, so 63 becomes 255. The DAC only uses the low 6 bits.
+  for( int32_t i = 0; i < VGA_PALETTE_SIZE; ++i )
+  {
+    palette[i].r = static_cast<uint8_t>( ( ( data[i * 3] & 0x3f ) * 255 + 31 ) / 63 );
+    palette[i].g = static_cast<uint8_t>( ( ( data[i * 3 + 1] & 0x3f ) * 255 + 31 ) / 63 );
+    palette[i].b = static_cast<uint8_t>( ( ( data[i * 3 + 2] & 0x3f ) * 255 + 31 ) / 63 );
+  }
+
+  return true;
+}
+
+
+int32_t DecodeVgaPacked( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest, int32_t destPitch,
+                         int32_t maxRows )
+{
+  int32_t rows{ static_cast<int32_t>( numBytes / bytesPerRow ) };
+  if( rows > maxRows )
+  {
+    rows = maxRows;
+  }
+
+  for( int32_t y = 0; y < rows; ++y )
+  {
+    memcpy( dest + static_cast<size_t>( y ) * destPitch, data + static_cast<size_t>( y ) * bytesPerRow,
+            static_cast<size_t>( bytesPerRow ) );
+  }
+
+  return rows;
+}
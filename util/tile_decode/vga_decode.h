@@ -0,0 +1,25 @@
+// Decoders for the VGA upgrade to PC Ultima 4.
+// The upgrade replaces the tiles, charset and pictures with 8 bits per pixel versions that share one 256 color palette,
+// u4vga.pal. That file holds 256 red, green, blue triplets of 6-bit VGA DAC values.
+
+#ifndef TILE_DECODE_VGA_DECODE_H
+#define TILE_DECODE_VGA_DECODE_H
+
+#include "surface.h"
+
+#define VGA_PALETTE_SIZE      256
+#define VGA_PALETTE_FILE_SIZE ( VGA_PALETTE_SIZE * 3 )
+
+#define VGA_SCREEN_WIDTH  320
+#define VGA_SCREEN_HEIGHT 200
+#define VGA_SCREEN_SIZE   ( VGA_SCREEN_WIDTH * VGA_SCREEN_HEIGHT )
+
+// Converts a u4vga.pal file, scaling each DAC value from 0-63 to 0-255. Returns false if the data is too short.
+bool LoadVgaPalette( const uint8_t* data, size_t numBytes, PaletteEntry palette[VGA_PALETTE_SIZE] );
+
+// Copies 8bpp rows, which are already palette indices. Decoding stops at the end of the data or after maxRows rows,
+// whichever comes first. Returns the number of rows written.
+int32_t DecodeVgaPacked( const uint8_t* data, size_t numBytes, int32_t bytesPerRow, uint8_t* dest, int32_t destPitch,
+                         int32_t maxRows );
+
+#endif // TILE_DECODE_VGA_DECODE_H
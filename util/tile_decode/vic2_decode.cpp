@@ -0,0 +1,375 @@
+#include "vic2_decode.h"
+
+#include <cstring>
+
+#include "../instrument/instrument.h"
+#include "c64_decode.h"
+#include "parallel.h"
+
+
+namespace
+{
+  const char* const modeNames[NUM_VIC2_MODES] =
+  {
+    "charset", "mccharset", "bitmap", "mcbitmap", "sprites", "mcsprites"
+  };
+
+  // 0xff in every pixel of every byte whose bit pair is n, for n = 0 to 3, so a byte can be expanded with 4 masks
+  struct PairMaskTable
+  {
+    uint64_t masks[256][4];
+
+    PairMaskTable()
+    {
+      for( int32_t value = 0; value < 256; ++value )
+      {
+        uint8_t bytes[4][C64_PIXELS_PER_BYTE]{};
+        for( int32_t i = 0; i < C64_PIXELS_PER_BYTE; ++i )
+        {
+          bytes[( value >> ( 6 - ( i & ~1 ) ) ) & 0x3][i] = 0xff;
+        }
+
+        memcpy( masks[value], bytes, sizeof( bytes ) );
+      }
+    }
+  };
+
+  const PairMaskTable pairMaskTable;
+
+  const uint64_t everyByte{ 0x0101010101010101ull };
+
+
+  bool IsMulticolor( Vic2Mode mode )
+  {
+    return mode == VIC2_MULTICOLOR_CHARSET || mode == VIC2_MULTICOLOR_BITMAP || mode == VIC2_MULTICOLOR_SPRITES;
+  }
+
+
+  bool IsSprites( Vic2Mode mode )
+  {
+    return mode == VIC2_SPRITES || mode == VIC2_MULTICOLOR_SPRITES;
+  }
+
+
+  bool IsBitmap( Vic2Mode mode )
+  {
+    return mode == VIC2_BITMAP || mode == VIC2_MULTICOLOR_BITMAP;
+  }
+
+
+  // The layout of one character or sprite
+  struct ItemLayout
+  {
+    int32_t width;
+    int32_t height;
+    int32_t bytesPerRow;
+    int32_t stride;
+  };
+
+  ItemLayout GetItemLayout( Vic2Mode mode )
+  {
+    if( IsSprites( mode ) )
+    {
+      return ItemLayout{ VIC2_SPRITE_WIDTH, VIC2_SPRITE_HEIGHT, VIC2_SPRITE_WIDTH / C64_PIXELS_PER_BYTE,
+                         VIC2_SPRITE_STRIDE };
+    }
+
+    return ItemLayout{ C64_PIXELS_PER_BYTE, C64_PIXELS_PER_BYTE, 1, VIC2_CHAR_SIZE };
+  }
+
+
+  int32_t ItemsPerRow( const Vic2Source& source )
+  {
+    const int32_t itemsPerRow{ source.itemsPerRow > 0 ? source.itemsPerRow : 1 };
+    return source.count < itemsPerRow ? ( source.count > 0 ? source.count : 1 ) : itemsPerRow;
+  }
+
+
+  void CreateSurface( const Vic2Source& source, IndexSurface& surface )
+  {
+    if( IsBitmap( source.mode ) )
+    {
+      surface.Create( VIC2_SCREEN_WIDTH, VIC2_SCREEN_HEIGHT );
+      return;
+    }
+
+    const ItemLayout layout{ GetItemLayout( source.mode ) };
+    const int32_t itemsPerRow{ ItemsPerRow( source ) };
+    const int32_t numRows{ ( source.count + itemsPerRow - 1 ) / itemsPerRow };
+
+    surface.Create( itemsPerRow * layout.width, numRows * layout.height, source.colors.background );
+  }
+
+
+  // The 4 colors of a sheet's bit pairs, or false if the sheet is drawn in hires
+  bool SheetMulticolors( const Vic2Source& source, uint8_t colors[4] )
+  {
+    const Vic2Colors& registers{ source.colors };
+
+    if( source.mode == VIC2_MULTICOLOR_CHARSET && ( registers.foreground & 0x8 ) != 0 )
+    {
+      const uint8_t chosen[4] = { registers.background, registers.multicolor1, registers.multicolor2,
+                                  static_cast<uint8_t>( registers.foreground & 0x7 ) };
+      memcpy( colors, chosen, sizeof( chosen ) );
+      return true;
+    }
+
+    if( source.mode == VIC2_MULTICOLOR_SPRITES )
+    {
+      const uint8_t chosen[4] = { registers.background, registers.multicolor1, registers.foreground,
+                                  registers.multicolor2 };
+      memcpy( colors, chosen, sizeof( chosen ) );
+      return true;
+    }
+
+    return false;
+  }
+
+
+  // The hires color byte of a sheet: foreground in the high nibble, background in the low nibble
+  uint8_t SheetHiresColors( const Vic2Source& source )
+  {
+    // In multicolor character mode, color RAM values below 8 pick a hires character with only 8 colors
+    const uint8_t foreground{ static_cast<uint8_t>( source.colors.foreground &
+                                                    ( source.mode == VIC2_MULTICOLOR_CHARSET ? 0x7 : 0xf ) ) };
+    return static_cast<uint8_t>( ( foreground << 4 ) | ( source.colors.background & 0xf ) );
+  }
+
+
+  // One row of bitmap cells: 8 pixel rows of 40 cells
+  void DrawBitmapRow( const Vic2Source& source, int32_t cellRow, IndexSurface& surface )
+  {
+    const uint8_t* screen{ source.screenRam + cellRow * VIC2_SCREEN_COLUMNS };
+    const uint8_t* cells{ source.data + cellRow * VIC2_SCREEN_COLUMNS * 8 };
+
+    if( source.mode == VIC2_BITMAP )
+    {
+      // The 8 bytes of each cell are consecutive, so each pixel row is gathered from every 8th byte
+      uint8_t bits[VIC2_SCREEN_COLUMNS];
+
+      for( int32_t y = 0; y < 8; ++y )
+      {
+        for( int32_t column = 0; column < VIC2_SCREEN_COLUMNS; ++column )
+        {
+          bits[column] = cells[column * 8 + y];
+        }
+
+        DecodeC64HiresSpan( bits, screen, VIC2_SCREEN_COLUMNS, surface.Row( cellRow * 8 + y ) );
+      }
+
+      return;
+    }
+
+    const uint8_t* colorRam{ source.colorRam + cellRow * VIC2_SCREEN_COLUMNS };
+
+    for( int32_t column = 0; column < VIC2_SCREEN_COLUMNS; ++column )
+    {
+      const uint8_t colors[4] = { static_cast<uint8_t>( source.colors.background & 0xf ),
+                                  static_cast<uint8_t>( screen[column] >> 4 ),
+                                  static_cast<uint8_t>( screen[column] & 0xf ),
+                                  static_cast<uint8_t>( colorRam[column] & 0xf ) };
+
+      for( int32_t y = 0; y < 8; ++y )
+      {
+        DecodeVic2MulticolorByte( cells[column * 8 + y], colors, surface.Row( cellRow * 8 + y ) + column * 8 );
+      }
+    }
+  }
+
+
+  // One row of characters or sprites
+  void DrawSheetRow( const Vic2Source& source, int32_t itemRow, IndexSurface& surface )
+  {
+    const ItemLayout layout{ GetItemLayout( source.mode ) };
+    const int32_t itemsPerRow{ ItemsPerRow( source ) };
+    const int32_t firstItem{ itemRow * itemsPerRow };
+    const int32_t numItems{ source.count - firstItem < itemsPerRow ? source.count - firstItem : itemsPerRow };
+    const int32_t numBytes{ numItems * layout.bytesPerRow };
+
+    uint8_t colors[4];
+    const bool multicolor{ SheetMulticolors( source, colors ) };
+
+    std::vector<uint8_t> bits( static_cast<size_t>( numBytes ) );
+    std::vector<uint8_t> hiresColors( multicolor ? 0 : static_cast<size_t>( numBytes ), SheetHiresColors( source ) );
+
+    for( int32_t y = 0; y < layout.height; ++y )
+    {
+      // Gather this pixel row of every item on the row, left to right
+      for( int32_t i = 0; i < numItems; ++i )
+      {
+        memcpy( &bits[i * layout.bytesPerRow],
+                source.data + static_cast<size_t>( firstItem + i ) * layout.stride + y * layout.bytesPerRow,
+                layout.bytesPerRow );
+      }
+
+      uint8_t* row{ surface.Row( itemRow * layout.height + y ) };
+
+      if( multicolor )
+      {
+        for( int32_t i = 0; i < numBytes; ++i )
+        {
+          DecodeVic2MulticolorByte( bits[i], colors, row + i * C64_PIXELS_PER_BYTE );
+        }
+      }
+      else
+      {
+        DecodeC64HiresSpan( bits.data(), hiresColors.data(), numBytes, row );
+      }
+    }
+  }
+} // namespace
+
+
+const char* Vic2ModeName( Vic2Mode mode )
+{
+  return mode >= VIC2_CHARSET && mode < NUM_VIC2_MODES ? modeNames[mode] : "unknown";
+}
+
+
+bool FindVic2Mode( const char* name, Vic2Mode& mode )
+{
+  for( int32_t i = 0; i < NUM_VIC2_MODES; ++i )
+  {
+    if( strcmp( name, modeNames[i] ) == 0 )
+    {
+      mode = static_cast<Vic2Mode>( i );
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+size_t Vic2DataSize( Vic2Mode mode, int32_t count )
+{
+  if( IsBitmap( mode ) )
+  {
+    return VIC2_BITMAP_SIZE;
+  }
+
+  if( count <= 0 )
+  {
+    return 0;
+  }
+
+  // The last sprite doesn't need its padding byte
+  const ItemLayout layout{ GetItemLayout( mode ) };
+  return static_cast<size_t>( count - 1 ) * layout.stride + layout.height * layout.bytesPerRow;
+}
+
+
+void DecodeVic2MulticolorByte( uint8_t bits, const uint8_t colors[4], uint8_t* dest )
+{
+  const uint64_t* masks{ pairMaskTable.masks[bits] };
+
+  const uint64_t pixels{ ( masks[0] & ( colors[0] * everyByte ) ) | ( masks[1] & ( colors[1] * everyByte ) ) |
+                         ( masks[2] & ( colors[2] * everyByte ) ) | ( masks[3] & ( colors[3] * everyByte ) ) };
+  memcpy( dest, &pixels, C64_PIXELS_PER_BYTE );
+}
+
+
+void DecodeVic2( const Vic2Source& source, IndexSurface& surface, int32_t numThreads )
+{
+  CreateSurface( source, surface );
+
+  INSTRUMENT_SCOPE( "decode" );
+  INSTRUMENT_COUNT( COUNTER_BYTES_OUT, surface.pixels.size() );
+
+  if( IsBitmap( source.mode ) )
+  {
+    ParallelFor( VIC2_SCREEN_ROWS, numThreads, [&]( int32_t cellRow )
+    {
+      DrawBitmapRow( source, cellRow, surface );
+    } );
+
+    return;
+  }
+
+  if( source.count <= 0 )
+  {
+    return;
+  }
+
+  const int32_t itemsPerRow{ ItemsPerRow( source ) };
+  ParallelFor( ( source.count + itemsPerRow - 1 ) / itemsPerRow, numThreads, [&]( int32_t itemRow )
+  {
+    DrawSheetRow( source, itemRow, surface );
+  } );
+}
+
+
+void DecodeVic2Reference( const Vic2Source& source, IndexSurface& surface )
+{
+  CreateSurface( source, surface );
+
+  const Vic2Colors& registers{ source.colors };
+  const bool multicolor{ IsMulticolor( source.mode ) };
+
+  for( int32_t y = 0; y < surface.height; ++y )
+  {
+    for( int32_t x = 0; x < surface.width; ++x )
+    {
+      uint8_t bits{ 0 };
+      uint8_t colors[4] = { registers.background, registers.multicolor1, registers.multicolor2, registers.foreground };
+
+      if( IsBitmap( source.mode ) )
+      {
+        const int32_t cell{ ( y / 8 ) * VIC2_SCREEN_COLUMNS + x / 8 };
+        bits = source.data[cell * 8 + y % 8];
+
+        if( multicolor )
+        {
+          colors[1] = source.screenRam[cell] >> 4;
+          colors[2] = source.screenRam[cell] & 0xf;
+          colors[3] = source.colorRam[cell] & 0xf;
+        }
+        else
+        {
+          // Hires bitmaps use pair values 0 and 3 below
+          colors[0] = source.screenRam[cell] & 0xf;
+          colors[3] = source.screenRam[cell] >> 4;
+        }
+      }
+      else
+      {
+        const ItemLayout layout{ GetItemLayout( source.mode ) };
+        const int32_t item{ ( y / layout.height ) * ItemsPerRow( source ) + x / layout.width };
+
+        if( item >= source.count )
+        {
+          surface.Row( y )[x] = registers.background;
+          continue;
+        }
+
+        bits = source.data[item * layout.stride + ( y % layout.height ) * layout.bytesPerRow +
+                           ( x % layout.width ) / 8];
+
+        if( source.mode == VIC2_MULTICOLOR_SPRITES )
+        {
+          colors[2] = registers.foreground;
+          colors[3] = registers.multicolor2;
+        }
+        else if( source.mode == VIC2_MULTICOLOR_CHARSET )
+        {
+          colors[3] = registers.foreground & 0x7;
+        }
+      }
+
+      const int32_t bit{ x % 8 };
+      uint8_t pair;
+
+      if( multicolor && !( source.mode == VIC2_MULTICOLOR_CHARSET && ( registers.foreground & 0x8 ) == 0 ) )
+      {
+        // Both pixels of a pair show the same 2 bits
+        pair = ( bits >> ( 6 - ( bit & ~1 ) ) ) & 0x3;
+      }
+      else
+      {
+        pair = ( bits >> ( 7 - bit ) ) & 0x1 ? 3 : 0;
+      }
+
+      surface.Row( y )[x] = colors[pair];
+    }
+  }
+}
@@ -0,0 +1,93 @@
+// Commodore 64 VIC-II graphics modes: character sets, full-screen bitmaps and sprites, in hires and multicolor.
+// Multicolor modes use 2 bits per double-wide pixel, MSB first. Which of the 4 colors a bit pair picks depends on the
+// mode:
+//
+//   Mode                00          01                 10                 11
+//   Multicolor chars    background  multicolor1        multicolor2        color RAM & 7
+//   Multicolor bitmap   background  screen RAM >> 4    screen RAM & 0xf   color RAM
+//   Multicolor sprites  background  multicolor1        sprite color       multicolor2
+//
+// Multicolor characters whose color RAM value doesn't have bit 3 set are drawn in hires with color RAM & 7 instead.
+// Hires bitmaps take both colors of each 8x8 cell from screen RAM, as DecodeC64HiresByte() does.
+
+// Resources:
+// https://www.c64-wiki.com/wiki/Graphics_Modes
+// https://www.c64-wiki.com/wiki/Sprite
+
+#ifndef TILE_DECODE_VIC2_DECODE_H
+#define TILE_DECODE_VIC2_DECODE_H
+
+#include "surface.h"
+
+#define VIC2_SCREEN_COLUMNS 40
+#define VIC2_SCREEN_ROWS    25
+#define VIC2_SCREEN_WIDTH   ( VIC2_SCREEN_COLUMNS * 8 )
+#define VIC2_SCREEN_HEIGHT  ( VIC2_SCREEN_ROWS * 8 )
+#define VIC2_SCREEN_CELLS   ( VIC2_SCREEN_COLUMNS * VIC2_SCREEN_ROWS )
+#define VIC2_BITMAP_SIZE    ( VIC2_SCREEN_CELLS * 8 )
+
+#define VIC2_CHAR_SIZE 8
+
+// 3 bytes per row. Sprites are stored 64 bytes apart, the last byte unused.
+#define VIC2_SPRITE_WIDTH  24
+#define VIC2_SPRITE_HEIGHT 21
+#define VIC2_SPRITE_STRIDE 64
+
+enum Vic2Mode
+{
+  VIC2_CHARSET,
+  VIC2_MULTICOLOR_CHARSET,
+  VIC2_BITMAP,
+  VIC2_MULTICOLOR_BITMAP,
+  VIC2_SPRITES,
+  VIC2_MULTICOLOR_SPRITES,
+  NUM_VIC2_MODES
+};
+
+// The color registers. Character sets and sprites on disk have no color RAM or sprite registers of their own, so a
+// whole sheet is drawn with foreground as the color RAM value ($d800) or the sprite color ($d027), and the two
+// multicolor registers double as $d022/$d023 for characters and $d025/$d026 for sprites. Areas of a sheet with no
+// character or sprite, and transparent sprite pixels, are background ($d021).
+struct Vic2Colors
+{
+  uint8_t background{ 0 };
+  uint8_t multicolor1{ 11 };
+  uint8_t multicolor2{ 12 };
+  uint8_t foreground{ 1 };
+};
+
+// Something to draw, with everything it reads. Bitmaps read VIC2_BITMAP_SIZE bytes of data, VIC2_SCREEN_CELLS bytes of
+// screenRam and, in multicolor, VIC2_SCREEN_CELLS bytes of colorRam (low nibbles). Character sets and sprites read
+// count items from data and are laid out itemsPerRow across.
+struct Vic2Source
+{
+  Vic2Mode mode{ VIC2_CHARSET };
+  const uint8_t* data{ nullptr };
+  const uint8_t* screenRam{ nullptr };
+  const uint8_t* colorRam{ nullptr };
+  int32_t count{ 0 };
+  int32_t itemsPerRow{ 16 };
+  Vic2Colors colors;
+};
+
+// Mode names for the command line: charset, mccharset, bitmap, mcbitmap, sprites, mcsprites
+const char* Vic2ModeName( Vic2Mode mode );
+
+// Returns false if name isn't one of the mode names
+bool FindVic2Mode( const char* name, Vic2Mode& mode );
+
+// Bytes read from data for count items (count is ignored for bitmaps)
+size_t Vic2DataSize( Vic2Mode mode, int32_t count );
+
+// Expands one multicolor byte into 8 palette indices (4 double-wide pixels). colors[n] is the color of bit pair n.
+void DecodeVic2MulticolorByte( uint8_t bits, const uint8_t colors[4], uint8_t* dest );
+
+// Draws the source into a surface sized to fit it, splitting the rows of cells, characters or sprites across
+// numThreads threads (0 = one per core). Hires rows go through the hires span kernel (see cpu_dispatch.h) and
+// multicolor bytes through a table of bit pair masks.
+void DecodeVic2( const Vic2Source& source, IndexSurface& surface, int32_t numThreads );
+
+// Per-pixel version of DecodeVic2() that applies the mode rules bit by bit. DecodeVic2() is verified against this.
+void DecodeVic2Reference( const Vic2Source& source, IndexSurface& surface );
+
+#endif // TILE_DECODE_VIC2_DECODE_H
@@ -0,0 +1,316 @@
+#include "tilerip.h"
+
+#include <climits>
+#include <new>
+
+#include "../tile_decode/apple2_decode.h"
+#include "../tile_decode/c64_decode.h"
+#include "../tile_decode/ega_decode.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+#include "../lzw_decode/lzwvar.h"
+}
+
+
+// Both dictionaries, so one context handles either format
+struct tilerip_lzw
+{
+  lzwContext* fixed;
+  lzwVarContext* variable;
+};
+
+
+namespace
+{
+  bool ValidImage( const tilerip_image* image )
+  {
+    return image != nullptr && image->pixels != nullptr && image->width >= 0 && image->height >= 0 &&
+           image->pitch >= image->width;
+  }
+
+
+  uint8_t* ImageRow( const tilerip_image* image, int32_t y )
+  {
+    return image->pixels + static_cast<size_t>( y ) * image->pitch;
+  }
+
+
+  // Whether rows of rowBytes bytes, pitch bytes apart, fit in size bytes
+  bool RowsFit( size_t size, int32_t numRows, int32_t pitch, int32_t rowBytes )
+  {
+    return numRows == 0 || static_cast<uint64_t>( numRows - 1 ) * pitch + rowBytes <= size;
+  }
+
+
+  long DecompressedSize( tilerip_lzw* context, tilerip_lzw_format format, unsigned char* data, long size )
+  {
+    return format == TILERIP_LZW_U4 ? lzwContextGetDecompressedSize( context->fixed, data, size )
+                                    : lzwVarGetDecompressedSize( context->variable, data, size );
+  }
+} // namespace
+
+
+int32_t tilerip_abi_version( void )
+{
+  return TILERIP_ABI_VERSION;
+}
+
+
+int32_t tilerip_palette( tilerip_palette_id palette, uint8_t* rgb, int32_t maxEntries )
+{
+  const PaletteEntry* entries{ nullptr };
+  int32_t numEntries{ 0 };
+
+  switch( palette )
+  {
+    case TILERIP_PALETTE_EGA:
+      entries = egaPalette;
+      numEntries = 16;
+      break;
+
+    case TILERIP_PALETTE_APPLE2:
+      entries = apple2Palette;
+      numEntries = 6;
+      break;
+
+    case TILERIP_PALETTE_C64:
+      entries = c64Palette;
+      numEntries = 16;
+      break;
+
+    default:
+      return -1;
+  }
+
+  for( int32_t i = 0; rgb != nullptr && i < maxEntries && i < numEntries; ++i )
+  {
+    rgb[i * 3] = entries[i].r;
+    rgb[i * 3 + 1] = entries[i].g;
+    rgb[i * 3 + 2] = entries[i].b;
+  }
+
+  return numEntries;
+}
+
+
+tilerip_status tilerip_decode_ega_packed( const uint8_t* data, size_t size, int32_t bytesPerRow,
+                                          const tilerip_image* dest, int32_t* rowsWritten )
+{
+  if( ( data == nullptr && size > 0 ) || bytesPerRow <= 0 || !ValidImage( dest ) || dest->width / 2 < bytesPerRow )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  const int32_t numRows{ DecodeEgaPacked( data, size, bytesPerRow, dest->pixels, dest->pitch, dest->height ) };
+  if( rowsWritten != nullptr )
+  {
+    *rowsWritten = numRows;
+  }
+
+  return TILERIP_OK;
+}
+
+
+tilerip_status tilerip_decode_ega_rle( const uint8_t* data, size_t size, const tilerip_image* dest )
+{
+  if( ( data == nullptr && size > 0 ) || !ValidImage( dest ) )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  DecodeEgaRle( data, size, dest->pixels, dest->width, dest->height, dest->pitch );
+  return TILERIP_OK;
+}
+
+
+tilerip_status tilerip_expand_rle( const uint8_t* data, size_t size, uint8_t* dest, size_t capacity,
+                                   size_t* written )
+{
+  if( ( data == nullptr && size > 0 ) || written == nullptr )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  *written = EgaRleExpandedSize( data, size );
+  if( dest == nullptr )
+  {
+    return TILERIP_OK;
+  }
+
+  if( *written > capacity )
+  {
+    return TILERIP_ERROR_SPACE;
+  }
+
+  return ExpandEgaRle( data, size, dest, capacity ) == *written ? TILERIP_OK : TILERIP_ERROR_DATA;
+}
+
+
+tilerip_status tilerip_decode_apple_rows( const uint8_t* data, size_t size, int32_t bytesPerRow, int32_t srcPitch,
+                                          int32_t startOdd, const tilerip_image* dest )
+{
+  if( data == nullptr || bytesPerRow <= 0 || srcPitch < bytesPerRow || !ValidImage( dest ) ||
+      dest->width / APPLE2_PIXELS_PER_BYTE < bytesPerRow )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  if( !RowsFit( size, dest->height, srcPitch, bytesPerRow ) )
+  {
+    return TILERIP_ERROR_DATA;
+  }
+
+  for( int32_t y = 0; y < dest->height; ++y )
+  {
+    DecodeAppleSpan( data + static_cast<size_t>( y ) * srcPitch, bytesPerRow, startOdd != 0, false,
+                     ImageRow( dest, y ) );
+  }
+
+  return TILERIP_OK;
+}
+
+
+tilerip_status tilerip_decode_apple_screen( const uint8_t* data, size_t size, const tilerip_image* dest )
+{
+  if( data == nullptr || !ValidImage( dest ) || dest->width < APPLE2_SCREEN_WIDTH ||
+      dest->height < APPLE2_SCREEN_HEIGHT )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  const uint8_t* picture{ FindAppleScreenData( data, size ) };
+  if( picture == nullptr )
+  {
+    return TILERIP_ERROR_DATA;
+  }
+
+  // The same phase and row addresses as DecodeAppleScreen(), on the caller's thread
+  for( int32_t y = 0; y < APPLE2_SCREEN_HEIGHT; ++y )
+  {
+    DecodeAppleSpan( picture + AppleScreenRowOffset( y ), APPLE2_SCREEN_BYTES_PER_ROW, true, false,
+                     ImageRow( dest, y ) );
+  }
+
+  return TILERIP_OK;
+}
+
+
+tilerip_status tilerip_decode_c64_hires( const uint8_t* bits, size_t bitsSize, int32_t bitsPitch,
+                                         const uint8_t* colors, size_t colorsSize, int32_t colorsPitch,
+                                         int32_t bytesPerRow, const tilerip_image* dest )
+{
+  if( bits == nullptr || colors == nullptr || bytesPerRow <= 0 || bitsPitch < bytesPerRow ||
+      ( colorsPitch != 0 && colorsPitch < bytesPerRow ) || !ValidImage( dest ) ||
+      dest->width / C64_PIXELS_PER_BYTE < bytesPerRow )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  if( !RowsFit( bitsSize, dest->height, bitsPitch, bytesPerRow ) ||
+      !RowsFit( colorsSize, dest->height, colorsPitch, bytesPerRow ) )
+  {
+    return TILERIP_ERROR_DATA;
+  }
+
+  for( int32_t y = 0; y < dest->height; ++y )
+  {
+    DecodeC64HiresSpan( bits + static_cast<size_t>( y ) * bitsPitch, colors + static_cast<size_t>( y ) * colorsPitch,
+                        bytesPerRow, ImageRow( dest, y ) );
+  }
+
+  return TILERIP_OK;
+}
+
+
+tilerip_lzw* tilerip_lzw_create( void )
+{
+  tilerip_lzw* context{ new( std::nothrow ) tilerip_lzw{ lzwCreateContext(), lzwVarCreateContext() } };
+  if( context != nullptr && ( context->fixed == nullptr || context->variable == nullptr ) )
+  {
+    tilerip_lzw_destroy( context );
+    context = nullptr;
+  }
+
+  return context;
+}
+
+
+void tilerip_lzw_destroy( tilerip_lzw* context )
+{
+  if( context != nullptr )
+  {
+    lzwDestroyContext( context->fixed );
+    lzwVarDestroyContext( context->variable );
+    delete context;
+  }
+}
+
+
+tilerip_status tilerip_lzw_read_header( const uint8_t* data, size_t size, size_t* decompressedSize, size_t* header )
+{
+  if( data == nullptr || decompressedSize == nullptr || header == nullptr )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  // Only the start of the file is read
+  const long result{ lzwVarReadHeader( const_cast<uint8_t*>( data ), size < LONG_MAX ? static_cast<long>( size )
+                                                                                      : LONG_MAX ) };
+  if( result < 0 )
+  {
+    return TILERIP_ERROR_DATA;
+  }
+
+  *decompressedSize = static_cast<size_t>( result );
+  *header = LZWVAR_HEADER_SIZE;
+  return TILERIP_OK;
+}
+
+
+tilerip_status tilerip_lzw_decompress( tilerip_lzw* context, tilerip_lzw_format format, const uint8_t* data,
+                                       size_t size, uint8_t* dest, size_t capacity, size_t* written )
+{
+  if( context == nullptr || ( data == nullptr && size > 0 ) || written == nullptr || size > LONG_MAX ||
+      ( format != TILERIP_LZW_U4 && format != TILERIP_LZW_VARIABLE ) )
+  {
+    return TILERIP_ERROR_ARGUMENT;
+  }
+
+  // The decoders take non-const pointers but never write through them
+  unsigned char* input{ const_cast<uint8_t*>( data ) };
+  const long inputSize{ static_cast<long>( size ) };
+
+  if( dest == nullptr )
+  {
+    const long result{ DecompressedSize( context, format, input, inputSize ) };
+    if( result < 0 )
+    {
+      return TILERIP_ERROR_DATA;
+    }
+
+    *written = static_cast<size_t>( result );
+    return TILERIP_OK;
+  }
+
+  const long limit{ capacity < LONG_MAX ? static_cast<long>( capacity ) : LONG_MAX };
+  const long result{ format == TILERIP_LZW_U4
+                       ? lzwContextDecompressBounded( context->fixed, input, dest, inputSize, limit )
+                       : lzwVarDecompressBounded( context->variable, input, dest, inputSize, limit ) };
+  if( result >= 0 )
+  {
+    *written = static_cast<size_t>( result );
+    return TILERIP_OK;
+  }
+
+  // The decoders fail the same way for corrupt data and a full buffer, so a failure is measured to tell them apart
+  const long needed{ DecompressedSize( context, format, input, inputSize ) };
+  if( needed < 0 )
+  {
+    return TILERIP_ERROR_DATA;
+  }
+
+  *written = static_cast<size_t>( needed );
+  return TILERIP_ERROR_SPACE;
+}
@@ -0,0 +1,153 @@
+/*
+ * tilerip.h - the rippers' decoders behind a stable C ABI
+ *
+ * For engines and tools that load the original game files themselves and want the decoders without the rippers:
+ * TileRip.vcxproj builds this into TileRip.dll, and elsewhere the same sources build a shared library with
+ *   g++ -std=c++14 -O2 -shared -fPIC -fvisibility=hidden tilerip.cpp ../tile_decode/ega_decode.cpp
+ *     ../tile_decode/apple2_decode.cpp ../tile_decode/c64_decode.cpp ../tile_decode/surface.cpp
+ *     ../tile_decode/cpu_dispatch.cpp ../tile_decode/kernels_*.cpp ../instrument/instrument.cpp
+ *     ../lzw_decode/lzw.c ../lzw_decode/lzwvar.c -o libtilerip.so
+ * (with the .c files compiled as C, with the same flags).
+ *
+ * Every decoder writes into memory the caller owns: palette indices go to a tilerip_image, which can point into a
+ * texture, a surface, or a tile of a larger atlas, since its pitch is independent of its width. Nothing is allocated
+ * or locked on the decoding path, and the only global state is lookup tables that are built when the library loads
+ * (or, thread-safely, on first use), so any number of threads can decode at once. The LZW decoders keep their
+ * dictionaries in a tilerip_lzw context that is created once and reused; a context holds one decompression at a time.
+ *
+ * The structs only ever grow at the end, and tilerip_abi_version() goes up whenever they or the functions change.
+ */
+
+#ifndef TILERIP_TILERIP_H
+#define TILERIP_TILERIP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined( _WIN32 )
+#if defined( TILERIP_EXPORTS )
+#define TILERIP_API __declspec( dllexport )
+#else
+#define TILERIP_API
+#endif
+#else
+#define TILERIP_API __attribute__( ( visibility( "default" ) ) )
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define TILERIP_ABI_VERSION 1
+
+typedef enum tilerip_status
+{
+  TILERIP_OK = 0,
+  TILERIP_ERROR_ARGUMENT = -1, /* A null pointer, a negative size, or an image too small for what was asked */
+  TILERIP_ERROR_DATA = -2,     /* The input is corrupt or isn't in the format asked for */
+  TILERIP_ERROR_SPACE = -3     /* The output doesn't fit in the buffer */
+} tilerip_status;
+
+typedef enum tilerip_palette_id
+{
+  TILERIP_PALETTE_EGA,    /* 16 entries */
+  TILERIP_PALETTE_APPLE2, /* 6 entries, in the order of the Apple hi-res decoder's indices */
+  TILERIP_PALETTE_C64     /* 16 entries */
+} tilerip_palette_id;
+
+typedef enum tilerip_lzw_format
+{
+  TILERIP_LZW_U4,      /* Ultima 4: fixed 12-bit codewords and a hashed dictionary */
+  TILERIP_LZW_VARIABLE /* Ultima 5 and 6: 9 to 12 bit codewords, the stream after the 4 byte size header */
+} tilerip_lzw_format;
+
+/* One byte per pixel, pitch bytes from the start of a row to the start of the next */
+typedef struct tilerip_image
+{
+  uint8_t* pixels;
+  int32_t width;
+  int32_t height;
+  int32_t pitch;
+} tilerip_image;
+
+typedef struct tilerip_lzw tilerip_lzw;
+
+/* TILERIP_ABI_VERSION as the library was built, to check against the header a caller was built with */
+TILERIP_API int32_t tilerip_abi_version( void );
+
+/* Copies up to maxEntries colors of a palette to rgb, 3 bytes each. Returns the palette's size, or -1. */
+TILERIP_API int32_t tilerip_palette( tilerip_palette_id palette, uint8_t* rgb, int32_t maxEntries );
+
+/*
+ * EGA packed 4bpp rows, high nibble first, bytesPerRow bytes per row: the PC Ultima 4 tile and charset files. Decodes
+ * until the data or the image's rows run out, and stores the number of rows written in *rowsWritten (if not null).
+ * The image must be at least 2 * bytesPerRow pixels wide.
+ */
+TILERIP_API tilerip_status tilerip_decode_ega_packed( const uint8_t* data, size_t size, int32_t bytesPerRow,
+                                                      const tilerip_image* dest, int32_t* rowsWritten );
+
+/*
+ * An EGA RLE picture (0x02, count, byte runs; anything else is a literal byte of two pixels) into the whole image.
+ * Pixels past the image are dropped.
+ */
+TILERIP_API tilerip_status tilerip_decode_ega_rle( const uint8_t* data, size_t size, const tilerip_image* dest );
+
+/*
+ * Expands the same RLE to its raw bytes, whatever their pixel format (the CGA and VGA upgrade pictures). With a null
+ * dest, only stores the expanded size. Returns TILERIP_ERROR_SPACE if it's bigger than capacity, with *written set to
+ * the size needed either way.
+ */
+TILERIP_API tilerip_status tilerip_expand_rle( const uint8_t* data, size_t size, uint8_t* dest, size_t capacity,
+                                               size_t* written );
+
+/*
+ * Apple ][ hi-res rows: bytesPerRow bytes per row, rows srcPitch bytes apart, decoded to 7 pixels a byte. Each row is
+ * one span whose first pixel is on an odd column when startOdd is set, with nothing lit to its left or right, as the
+ * tile and font files are laid out. The image must be at least 7 * bytesPerRow pixels wide, and every one of its rows
+ * is decoded.
+ */
+TILERIP_API tilerip_status tilerip_decode_apple_rows( const uint8_t* data, size_t size, int32_t bytesPerRow,
+                                                      int32_t srcPitch, int32_t startOdd, const tilerip_image* dest );
+
+/*
+ * A full-screen hi-res picture (the 8 KB page, with or without a DOS 3.3 binary file header) into a 280x192 image or
+ * larger.
+ */
+TILERIP_API tilerip_status tilerip_decode_apple_screen( const uint8_t* data, size_t size, const tilerip_image* dest );
+
+/*
+ * C64 hi-res rows: bytesPerRow bitmap bytes per row, 8 pixels each, with a color byte per bitmap byte (high nibble
+ * for set bits, low nibble for clear ones). Rows of bits are bitsPitch bytes apart and rows of colors colorsPitch
+ * bytes apart, so a colorsPitch of 0 uses the same colors on every row, as for a tile with one color byte. The image
+ * must be at least 8 * bytesPerRow pixels wide, and every one of its rows is decoded.
+ */
+TILERIP_API tilerip_status tilerip_decode_c64_hires( const uint8_t* bits, size_t bitsSize, int32_t bitsPitch,
+                                                     const uint8_t* colors, size_t colorsSize, int32_t colorsPitch,
+                                                     int32_t bytesPerRow, const tilerip_image* dest );
+
+/* An LZW context, or null if it can't be allocated. This and tilerip_lzw_destroy() are the only calls that allocate. */
+TILERIP_API tilerip_lzw* tilerip_lzw_create( void );
+TILERIP_API void tilerip_lzw_destroy( tilerip_lzw* context );
+
+/*
+ * The size a TILERIP_LZW_VARIABLE file's header gives for its stream, which starts header bytes in (4). Returns
+ * TILERIP_ERROR_DATA if the file doesn't start like one.
+ */
+TILERIP_API tilerip_status tilerip_lzw_read_header( const uint8_t* data, size_t size, size_t* decompressedSize,
+                                                    size_t* header );
+
+/*
+ * Decompresses an LZW stream into dest. With a null dest, only stores the decompressed size in *written, by decoding
+ * the whole stream without output. Returns TILERIP_ERROR_SPACE if it doesn't fit in capacity bytes, in which case the
+ * contents of dest are undefined.
+ */
+TILERIP_API tilerip_status tilerip_lzw_decompress( tilerip_lzw* context, tilerip_lzw_format format,
+                                                   const uint8_t* data, size_t size, uint8_t* dest, size_t capacity,
+                                                   size_t* written );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TILERIP_TILERIP_H */
@@ -0,0 +1,141 @@
+#include "apple2_encode_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "../tile_decode/apple2_decode.h"
+#include "../tile_decode/apple2_encode.h"
+#include "golden_verify.h"
+
+
+bool VerifyAppleEncoder()
+{
+  INSTRUMENT_BEGIN_FILE( "Apple encoder checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x1e3779b9 };
+
+  PaletteEntry target[APPLE2_SCREEN_WIDTH];
+  uint8_t bytes[APPLE2_SCREEN_BYTES_PER_ROW];
+  uint8_t encoded[APPLE2_SCREEN_BYTES_PER_ROW];
+  uint8_t expected[APPLE2_SCREEN_WIDTH];
+  uint8_t actual[APPLE2_SCREEN_WIDTH];
+
+  // The difference a span really renders with
+  auto spanDifference = [&target]( const uint8_t* colors, int32_t numPixels )
+  {
+    int64_t total{ 0 };
+    for( int32_t i = 0; i < numPixels; ++i )
+    {
+      const int32_t dr{ target[i].r - apple2Palette[colors[i]].r };
+      const int32_t dg{ target[i].g - apple2Palette[colors[i]].g };
+      const int32_t db{ target[i].b - apple2Palette[colors[i]].b };
+      total += dr * dr + dg * dg + db * db;
+    }
+    return total;
+  };
+
+  // Short spans against every possible encoding, for targets in Apple colors, in random colors, and a mix
+  for( int32_t pass = 0; pass < 48; ++pass )
+  {
+    const int32_t numBytes{ 1 + ( pass & 1 ) };
+    const int32_t numPixels{ numBytes * APPLE2_PIXELS_PER_BYTE };
+    const bool startOdd{ ( pass & 2 ) != 0 };
+    const bool carryIn{ ( pass & 4 ) != 0 };
+
+    for( int32_t i = 0; i < numPixels; ++i )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      target[i] = ( pass / 8 ) % 3 == 0 || ( ( pass / 8 ) % 3 == 2 && ( r & 1 ) )
+                    ? apple2Palette[( r >> 8 ) % 6]
+                    : PaletteEntry{ static_cast<uint8_t>( r >> 8 ), static_cast<uint8_t>( r >> 16 ),
+                                    static_cast<uint8_t>( r >> 24 ) };
+    }
+
+    int64_t best{ INT64_MAX };
+    for( int32_t value = 0; value < ( 1 << ( 8 * numBytes ) ); ++value )
+    {
+      bytes[0] = static_cast<uint8_t>( value );
+      bytes[1] = static_cast<uint8_t>( value >> 8 );
+      DecodeAppleSpan( bytes, numBytes, startOdd, carryIn, expected );
+
+      const int64_t difference{ spanDifference( expected, numPixels ) };
+      if( difference < best )
+      {
+        best = difference;
+      }
+    }
+
+    const int64_t difference{ EncodeAppleSpan( target, numBytes, startOdd, carryIn, encoded ) };
+    DecodeAppleSpan( encoded, numBytes, startOdd, carryIn, actual );
+
+    if( difference != best || spanDifference( actual, numPixels ) != best )
+    {
+      printf( "FAIL Apple encoder misses the best %d byte span (odd %d, carry %d)\n", numBytes, startOdd, carryIn );
+      return false;
+    }
+  }
+
+  // Anything the decoder renders encodes back to bytes that render the same, at every length
+  for( int32_t pass = 0; pass < 1000; ++pass )
+  {
+    const int32_t numBytes{ 1 + static_cast<int32_t>( NextRandom( state ) % APPLE2_SCREEN_BYTES_PER_ROW ) };
+    const int32_t numPixels{ numBytes * APPLE2_PIXELS_PER_BYTE };
+    const bool startOdd{ ( pass & 1 ) != 0 };
+    const bool carryIn{ ( pass & 2 ) != 0 };
+
+    for( int32_t i = 0; i < numBytes; ++i )
+    {
+      bytes[i] = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    DecodeAppleSpan( bytes, numBytes, startOdd, carryIn, expected );
+    for( int32_t i = 0; i < numPixels; ++i )
+    {
+      target[i] = apple2Palette[expected[i]];
+    }
+
+    const int64_t difference{ EncodeAppleSpan( target, numBytes, startOdd, carryIn, encoded ) };
+    DecodeAppleSpan( encoded, numBytes, startOdd, carryIn, actual );
+
+    if( difference != 0 || memcmp( expected, actual, numPixels ) != 0 )
+    {
+      printf( "FAIL Apple encoder doesn't reproduce a decoded %d byte span (odd %d, carry %d)\n", numBytes, startOdd,
+              carryIn );
+      return false;
+    }
+  }
+
+  // Tiles encoded over the bytes they were decoded from keep those bytes, including patterns that render like others
+  const int32_t numTiles{ 12 };
+  const int32_t tilesPerRow{ 4 };
+  IndexSurface image;
+  image.Create( tilesPerRow * 14, ( numTiles / tilesPerRow ) * 16 );
+
+  std::vector<uint8_t> tiles( numTiles * 16 * 2 );
+  for( uint8_t& tileByte : tiles )
+  {
+    tileByte = static_cast<uint8_t>( NextRandom( state ) );
+  }
+
+  for( int32_t tile = 0; tile < numTiles; ++tile )
+  {
+    for( int32_t row = 0; row < 16; ++row )
+    {
+      DecodeAppleSpan( &tiles[( tile * 16 + row ) * 2], 2, true, false,
+                       image.Row( ( tile / tilesPerRow ) * 16 + row ) + ( tile % tilesPerRow ) * 14 );
+    }
+  }
+
+  std::vector<uint8_t> kept{ tiles };
+  if( EncodeAppleTiles( image, apple2Palette, 6, numTiles, tilesPerRow, 14, 16, true, kept, 0 ) != 0 || kept != tiles )
+  {
+    printf( "FAIL Apple encoder changes the bytes of unedited tiles\n" );
+    return false;
+  }
+
+  printf( "OK   Apple encoder finds the best spans, reproduces decoded ones and keeps unedited tiles\n" );
+  return true;
+}
@@ -0,0 +1,10 @@
+// Golden checks for the Apple II hi-res tile encoder (apple2_encode.h).
+
+#ifndef VERIFY_APPLE2_ENCODE_VERIFY_H
+#define VERIFY_APPLE2_ENCODE_VERIFY_H
+
+// Checks the Apple hi-res encoder against every possible encoding of short spans, that it reproduces decoded spans
+// of every length, and that tiles encoded over their own bytes keep them
+bool VerifyAppleEncoder();
+
+#endif // VERIFY_APPLE2_ENCODE_VERIFY_H
@@ -0,0 +1,166 @@
+#include "apple2_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/apple2_decode.h"
+#include "../tile_decode/apple2_ntsc.h"
+#include "golden_verify.h"
+
+
+bool VerifyAppleKernels()
+{
+  INSTRUMENT_BEGIN_FILE( "Apple kernel checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint8_t expected[APPLE2_PIXELS_PER_BYTE * 2];
+  uint8_t actual[APPLE2_PIXELS_PER_BYTE * 2];
+
+  // Every byte pair with every carry / phase state
+  for( int32_t pair = 0; pair < 0x10000; ++pair )
+  {
+    const uint8_t bytes[2] = { static_cast<uint8_t>( pair & 0xff ), static_cast<uint8_t>( pair >> 8 ) };
+
+    for( int32_t state = 0; state < 4; ++state )
+    {
+      const bool startOdd{ ( state & 1 ) != 0 };
+      const bool carryIn{ ( state & 2 ) != 0 };
+
+      DecodeAppleSpanReference( bytes, 2, startOdd, carryIn, expected );
+      DecodeAppleSpan( bytes, 2, startOdd, carryIn, actual );
+
+      if( memcmp( expected, actual, sizeof( expected ) ) != 0 )
+      {
+        printf( "FAIL Apple span kernel differs for bytes %02x %02x (odd %d, carry %d)\n", bytes[0], bytes[1],
+                startOdd, carryIn );
+        return false;
+      }
+
+      // Single bytes (the text and MAPCHARS glyphs) never see a right-hand neighbour
+      DecodeAppleSpanReference( bytes, 1, startOdd, carryIn, expected );
+      DecodeAppleSpan( bytes, 1, startOdd, carryIn, actual );
+
+      if( memcmp( expected, actual, APPLE2_PIXELS_PER_BYTE ) != 0 )
+      {
+        printf( "FAIL Apple span kernel differs for byte %02x (odd %d, carry %d)\n", bytes[0], startOdd, carryIn );
+        return false;
+      }
+    }
+  }
+
+  printf( "OK   Apple span kernel matches the reference decoder for all 65536 byte pairs\n" );
+  return true;
+}
+
+
+bool VerifyAppleScreenDecoder()
+{
+  INSTRUMENT_BEGIN_FILE( "Apple screen checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x2000 };
+
+  std::vector<uint8_t> picture;
+  IndexSurface expected;
+  IndexSurface actual;
+
+  // Full pages, BSAVEd pages that stop before the last screen hole, and a page behind a DOS binary header
+  const size_t sizes[] = { APPLE2_SCREEN_SIZE, APPLE2_SCREEN_MIN_SIZE, APPLE2_SCREEN_MIN_SIZE + 4 };
+
+  for( int32_t pass = 0; pass < 3; ++pass )
+  {
+    picture.resize( sizes[pass] );
+    for( uint8_t& value : picture )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    if( pass == 2 )
+    {
+      picture[0] = 0x00;
+      picture[1] = 0x20;
+      picture[2] = static_cast<uint8_t>( APPLE2_SCREEN_MIN_SIZE & 0xff );
+      picture[3] = static_cast<uint8_t>( APPLE2_SCREEN_MIN_SIZE >> 8 );
+    }
+
+    for( int32_t numThreads = 1; numThreads <= 4; numThreads += 3 )
+    {
+      if( !DecodeAppleScreenReference( picture.data(), picture.size(), expected ) ||
+          !DecodeAppleScreen( picture.data(), picture.size(), actual, numThreads ) )
+      {
+        printf( "FAIL Apple screen decoder rejected a %d byte picture\n", static_cast<int32_t>( picture.size() ) );
+        return false;
+      }
+
+      if( HashSurface( expected ) != HashSurface( actual ) )
+      {
+        printf( "FAIL Apple screen decoder differs from the reference on a %d byte picture (%d threads)\n",
+                static_cast<int32_t>( picture.size() ), numThreads );
+        return false;
+      }
+    }
+  }
+
+  if( DecodeAppleScreen( picture.data(), APPLE2_SCREEN_MIN_SIZE - 1, actual, 1 ) )
+  {
+    printf( "FAIL Apple screen decoder accepted a short picture\n" );
+    return false;
+  }
+
+  printf( "OK   Apple screen decoder matches the reference decoder\n" );
+  return true;
+}
+
+
+bool VerifyAppleNtsc()
+{
+  INSTRUMENT_BEGIN_FILE( "Apple NTSC checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x3579545 };
+
+  uint8_t bytes[APPLE2_SCREEN_BYTES_PER_ROW];
+  uint32_t expected[APPLE2_SCREEN_WIDTH];
+  uint32_t actual[APPLE2_SCREEN_WIDTH];
+
+  for( int32_t pass = 0; pass < 2000; ++pass )
+  {
+    const int32_t numBytes{ 1 + static_cast<int32_t>( NextRandom( state ) % APPLE2_SCREEN_BYTES_PER_ROW ) };
+    const bool startOdd{ ( pass & 1 ) != 0 };
+
+    for( int32_t i = 0; i < numBytes; ++i )
+    {
+      bytes[i] = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    DecodeAppleSpanNtscReference( bytes, numBytes, startOdd, expected );
+    DecodeAppleSpanNtsc( bytes, numBytes, startOdd, actual );
+
+    if( memcmp( expected, actual, numBytes * APPLE2_PIXELS_PER_BYTE * sizeof( uint32_t ) ) != 0 )
+    {
+      printf( "FAIL Apple NTSC simulation differs from the reference on a %d byte span (odd %d)\n", numBytes,
+              startOdd );
+      return false;
+    }
+  }
+
+  // Away from the edges, a solid run of either palette is white and nothing is black
+  for( int32_t palette = 0; palette < 2; ++palette )
+  {
+    memset( bytes, palette ? 0xff : 0x7f, 4 );
+    DecodeAppleSpanNtsc( bytes, 4, true, actual );
+
+    memset( bytes, palette ? 0x80 : 0x00, 4 );
+    DecodeAppleSpanNtsc( bytes, 4, true, expected );
+
+    if( ( actual[14] & 0xffffff ) != 0xffffff || ( expected[14] & 0xffffff ) != 0 )
+    {
+      printf( "FAIL Apple NTSC simulation doesn't keep white and black neutral (palette %d)\n", palette );
+      return false;
+    }
+  }
+
+  printf( "OK   Apple NTSC simulation matches the reference simulation\n" );
+  return true;
+}
@@ -0,0 +1,17 @@
+// Golden checks for the Apple II hi-res decoders (apple2_decode.h, apple2_ntsc.h).
+
+#ifndef VERIFY_APPLE2_VERIFY_H
+#define VERIFY_APPLE2_VERIFY_H
+
+// Exhaustive equivalence check between the reference Apple decoder and the optimized kernels
+bool VerifyAppleKernels();
+
+// Checks the threaded full-screen Apple hi-res decoder against the per-pixel one on random pictures, with and without
+// a DOS file header
+bool VerifyAppleScreenDecoder();
+
+// Checks the table driven NTSC simulation against the per-pixel one on random spans, and that black and white come out
+// black and white
+bool VerifyAppleNtsc();
+
+#endif // VERIFY_APPLE2_VERIFY_H
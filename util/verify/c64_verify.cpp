@@ -0,0 +1,372 @@
+#include "c64_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/c64_decode.h"
+#include "../tile_decode/c64_encode.h"
+#include "../tile_decode/c64_tiles.h"
+#include "../tile_decode/d64_image.h"
+#include "../tile_decode/tile_map.h"
+#include "../tile_decode/vic2_decode.h"
+#include "golden_verify.h"
+
+
+bool VerifyC64Kernels()
+{
+  INSTRUMENT_BEGIN_FILE( "C64 kernel checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint8_t expected[C64_PIXELS_PER_BYTE];
+  uint8_t actual[C64_PIXELS_PER_BYTE];
+
+  for( int32_t bits = 0; bits < 256; ++bits )
+  {
+    for( int32_t colors = 0; colors < 256; ++colors )
+    {
+      DecodeC64HiresByteReference( static_cast<uint8_t>( bits ), static_cast<uint8_t>( colors ), expected );
+      DecodeC64HiresByte( static_cast<uint8_t>( bits ), static_cast<uint8_t>( colors ), actual );
+
+      if( memcmp( expected, actual, sizeof( expected ) ) != 0 )
+      {
+        printf( "FAIL C64 hires kernel differs for bits %02x colors %02x\n", bits, colors );
+        return false;
+      }
+    }
+  }
+
+  printf( "OK   C64 hires kernel matches the reference decoder for all bitmap / color bytes\n" );
+  return true;
+}
+
+
+bool VerifyC64Writer()
+{
+  INSTRUMENT_BEGIN_FILE( "C64 writer checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x64d64d64 };
+
+  // Two-color blocks encode to the same colors (dark gray and gray share an RGB value, so not always the same
+  // indices), and a block encoded from its own decoding keeps its bytes
+  IndexSurface block;
+  block.Create( 16, 16 );
+  uint8_t bits[32];
+  uint8_t decoded[16];
+
+  for( int32_t pass = 0; pass < 200; ++pass )
+  {
+    const uint8_t original{ static_cast<uint8_t>( NextRandom( state ) ) };
+    uint8_t originalBits[32];
+    for( uint8_t& value : originalBits )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    for( int32_t row = 0; row < 16; ++row )
+    {
+      DecodeC64HiresByte( originalBits[row * 2], original, block.Row( row ) );
+      DecodeC64HiresByte( originalBits[row * 2 + 1], original, block.Row( row ) + 8 );
+    }
+
+    // Half the passes start from other bytes, and only have to decode the same
+    const bool sameStart{ ( pass & 1 ) == 0 };
+    uint8_t colors{ sameStart ? original : static_cast<uint8_t>( NextRandom( state ) ) };
+    for( int32_t i = 0; i < 32; ++i )
+    {
+      bits[i] = sameStart ? originalBits[i] : static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    const int64_t difference{ EncodeC64HiresBlock( block, c64Palette, 16, 0, 0, 16, 16, bits, 2, colors ) };
+
+    bool matched{ difference == 0 };
+    for( int32_t row = 0; row < 16 && matched; ++row )
+    {
+      DecodeC64HiresByte( bits[row * 2], colors, decoded );
+      DecodeC64HiresByte( bits[row * 2 + 1], colors, decoded + 8 );
+      for( int32_t i = 0; i < 16 && matched; ++i )
+      {
+        const PaletteEntry& want{ c64Palette[block.Row( row )[i]] };
+        const PaletteEntry& got{ c64Palette[decoded[i]] };
+        matched = want.r == got.r && want.g == got.g && want.b == got.b;
+      }
+    }
+
+    if( !matched || ( sameStart && ( colors != original || memcmp( bits, originalBits, 32 ) != 0 ) ) )
+    {
+      printf( "FAIL C64 hires encoder doesn't reproduce a decoded block (pass %d)\n", pass );
+      return false;
+    }
+  }
+
+  // Files of every size class through the sector chains and the BAM
+  D64Image disk;
+  disk.Format( "VERIFY" );
+  const int32_t freeSectors{ disk.FreeSectors() };
+
+  const size_t sizes[] = { 0, 1, 253, 254, 255, 5000, 20000, 300 };
+  std::vector<uint8_t> contents[8];
+  std::vector<uint8_t> readBack;
+  int32_t usedSectors{ 0 };
+
+  for( int32_t pass = 0; pass < 16; ++pass )
+  {
+    const int32_t file{ pass % 8 };
+    char name[16];
+    snprintf( name, sizeof( name ), "FILE%d", file );
+
+    // The second time around every file changes size, growing or shrinking its chain
+    const size_t size{ pass < 8 ? sizes[file] : sizes[7 - file] };
+    if( pass >= 8 )
+    {
+      usedSectors -= contents[file].empty() ? 1 : static_cast<int32_t>( ( contents[file].size() + 253 ) / 254 );
+    }
+
+    contents[file].resize( size );
+    for( uint8_t& value : contents[file] )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    usedSectors += size == 0 ? 1 : static_cast<int32_t>( ( size + 253 ) / 254 );
+
+    if( !disk.WriteFile( name, contents[file] ) || disk.FreeSectors() != freeSectors - usedSectors )
+    {
+      printf( "FAIL D64 writer can't write %s (%d bytes)\n", name, static_cast<int32_t>( size ) );
+      return false;
+    }
+  }
+
+  // The BAM as stored has to match the one in memory, and every file has to read back
+  D64Image reloaded;
+  if( !reloaded.Load( disk.Data(), disk.Size() ) || reloaded.FreeSectors() != disk.FreeSectors() )
+  {
+    printf( "FAIL D64 writer doesn't store the BAM\n" );
+    return false;
+  }
+
+  for( int32_t file = 0; file < 8; ++file )
+  {
+    char name[16];
+    snprintf( name, sizeof( name ), "FILE%d", file );
+
+    if( !reloaded.ReadFile( name, readBack ) || readBack != contents[file] )
+    {
+      printf( "FAIL D64 writer doesn't read back %s\n", name );
+      return false;
+    }
+  }
+
+  // Writing what's already there changes nothing. A file too big for the disk, or a new one when the directory sector
+  // is full, is turned down untouched.
+  const uint8_t* patch{ disk.Data() + 0x8800 };
+  std::vector<uint8_t> tooBig( static_cast<size_t>( disk.FreeSectors() + 20 ) * 254 );
+  if( !reloaded.WriteBytes( 0x8800, patch, 2048 ) || !reloaded.WriteFile( "FILE5", contents[5] ) ||
+      reloaded.WriteFile( "FILE0", tooBig ) || reloaded.WriteFile( "NEW", contents[1] ) ||
+      reloaded.NumChangedSectors() != 0 )
+  {
+    printf( "FAIL D64 writer rewrote unchanged sectors\n" );
+    return false;
+  }
+
+  const uint8_t marker{ static_cast<uint8_t>( disk.Data()[0x88ff] ^ 0xff ) };
+  if( !reloaded.WriteBytes( 0x88ff, &marker, 1 ) || reloaded.NumChangedSectors() != 1 ||
+      reloaded.WriteBytes( reloaded.Size(), &marker, 1 ) )
+  {
+    printf( "FAIL D64 writer doesn't track changed sectors\n" );
+    return false;
+  }
+
+  printf( "OK   C64 hires encoder reproduces decoded blocks, and the D64 writer keeps its chains and BAM\n" );
+  return true;
+}
+
+
+bool VerifyVic2Decoder()
+{
+  INSTRUMENT_BEGIN_FILE( "VIC-II checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0xd020 };
+
+  // Enough for a bitmap or 70 sprites
+  std::vector<uint8_t> data( VIC2_BITMAP_SIZE );
+  std::vector<uint8_t> screenRam( VIC2_SCREEN_CELLS );
+  std::vector<uint8_t> colorRam( VIC2_SCREEN_CELLS );
+
+  IndexSurface expected;
+  IndexSurface actual;
+
+  for( int32_t pass = 0; pass < 8; ++pass )
+  {
+    for( std::vector<uint8_t>* bytes : { &data, &screenRam, &colorRam } )
+    {
+      for( uint8_t& value : *bytes )
+      {
+        value = static_cast<uint8_t>( NextRandom( state ) );
+      }
+    }
+
+    // Color RAM is only 4 bits wide
+    for( uint8_t& value : colorRam )
+    {
+      value &= 0xf;
+    }
+
+    Vic2Source source;
+    source.data = data.data();
+    source.screenRam = screenRam.data();
+    source.colorRam = colorRam.data();
+    source.colors.background = static_cast<uint8_t>( NextRandom( state ) & 0xf );
+    source.colors.multicolor1 = static_cast<uint8_t>( NextRandom( state ) & 0xf );
+    source.colors.multicolor2 = static_cast<uint8_t>( NextRandom( state ) & 0xf );
+
+    // Alternate passes draw multicolor characters in hires (color RAM bit 3 clear)
+    source.colors.foreground = static_cast<uint8_t>( ( NextRandom( state ) & 0x7 ) | ( pass & 1 ? 0x8 : 0x0 ) );
+
+    // Odd counts and row widths leave the last sheet row partly filled
+    source.count = 1 + static_cast<int32_t>( NextRandom( state ) % 70 );
+    source.itemsPerRow = 1 + static_cast<int32_t>( NextRandom( state ) % 17 );
+
+    for( int32_t mode = 0; mode < NUM_VIC2_MODES; ++mode )
+    {
+      source.mode = static_cast<Vic2Mode>( mode );
+
+      DecodeVic2Reference( source, expected );
+      DecodeVic2( source, actual, pass % 4 + 1 );
+
+      if( expected.width != actual.width || expected.height != actual.height ||
+          HashSurface( expected ) != HashSurface( actual ) )
+      {
+        printf( "FAIL VIC-II %s decoder differs from the reference (%d items, %d per row)\n",
+                Vic2ModeName( source.mode ), source.count, source.itemsPerRow );
+        return false;
+      }
+    }
+  }
+
+  printf( "OK   VIC-II decoder matches the reference decoder in every mode\n" );
+  return true;
+}
+
+
+bool VerifyC64TileSets()
+{
+  INSTRUMENT_BEGIN_FILE( "C64 tile set checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x64c0ffee };
+
+  // A 16x16 set and a 24x8 one (3 bytes per row), both short of 256 tiles so some map entries are missing
+  const int32_t sizes[][3] = { { 16, 16, 200 }, { 24, 8, 77 } };
+  for( const auto& size : sizes )
+  {
+    const int32_t count{ size[2] };
+    C64TileSet set;
+    set.Create( size[0], size[1] );
+
+    // Stored interleaved, the way the games store them
+    const int32_t rowPitch{ count * set.BytesPerRow() };
+    std::vector<uint8_t> data( static_cast<size_t>( rowPitch ) * set.tileHeight );
+    std::vector<uint8_t> tileColors( static_cast<size_t>( count ) );
+    for( uint8_t& value : data )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    for( uint8_t& value : tileColors )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    set.AddInterleaved( data.data(), rowPitch, tileColors.data(), count );
+
+    // The same tiles expanded into an atlas, pixel by pixel, and tile by tile
+    IndexSurface strip;
+    strip.Create( set.tileWidth, set.tileHeight * count );
+    IndexSurface drawn;
+    drawn.Create( set.tileWidth, set.tileHeight * count );
+
+    for( int32_t tile = 0; tile < count; ++tile )
+    {
+      for( int32_t y = 0; y < set.tileHeight; ++y )
+      {
+        const uint8_t* bits{ &data[static_cast<size_t>( y ) * rowPitch + tile * set.BytesPerRow()] };
+        DecodeC64HiresSpan( bits, std::vector<uint8_t>( set.BytesPerRow(), tileColors[tile] ).data(),
+                            set.BytesPerRow(), strip.Row( tile * set.tileHeight + y ) );
+
+        for( int32_t x = 0; x < set.tileWidth; ++x )
+        {
+          if( set.Sample( tile, x, y ) != strip.Row( tile * set.tileHeight + y )[x] )
+          {
+            printf( "FAIL C64 tile set sample differs from the decoder (tile %d, %d,%d)\n", tile, x, y );
+            return false;
+          }
+        }
+      }
+
+      DrawC64Tile( set, tile, drawn.Row( tile * set.tileHeight ), drawn.pitch );
+    }
+
+    if( drawn.pixels != strip.pixels )
+    {
+      printf( "FAIL C64 tile set draws tiles differently from the decoder\n" );
+      return false;
+    }
+
+    TileAtlas atlas;
+    atlas.Create( set.tileWidth, set.tileHeight );
+    atlas.AddStrip( strip );
+
+    const int32_t mapWidth{ 41 };
+    const int32_t mapHeight{ 23 };
+    std::vector<uint8_t> mapData( static_cast<size_t>( mapWidth ) * mapHeight );
+    for( uint8_t& entry : mapData )
+    {
+      entry = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    const TileMapView map{ mapData.data(), mapWidth, mapHeight, mapWidth, TILE_MAP_BYTE };
+    const TileRegion regions[] = { { 0, 0, mapWidth, mapHeight }, { 7, 2, 13, 19 }, { -3, 20, 50, 50 } };
+    const int32_t threadCounts[] = { 1, 3, 0 };
+
+    IndexSurface expected;
+    IndexSurface actual;
+
+    for( TileRegion region : regions )
+    {
+      ClipTileRegion( map, region );
+
+      for( const int32_t numThreads : threadCounts )
+      {
+        const int32_t expectedMissing{ RenderTileMapReference( atlas, map, region, expected, 0xee ) };
+        const int32_t actualMissing{ RenderC64TileMap( set, map, region, actual, numThreads, 0xee ) };
+
+        if( expected.pixels != actual.pixels || expectedMissing != actualMissing )
+        {
+          printf( "FAIL C64 tile set renderer differs from the reference (%dx%d tiles, region %d,%d %dx%d, "
+                  "%d threads)\n", set.tileWidth, set.tileHeight, region.x, region.y, region.width, region.height,
+                  numThreads );
+          return false;
+        }
+      }
+    }
+
+    // Through the file layout and back, and cut short
+    std::vector<uint8_t> bytes;
+    StoreC64TileSet( set, bytes );
+
+    C64TileSet loaded;
+    if( !ParseC64TileSet( bytes.data(), bytes.size(), loaded ) || loaded.tileWidth != set.tileWidth ||
+        loaded.tileHeight != set.tileHeight || loaded.numTiles != count || loaded.bits != set.bits ||
+        loaded.colors != set.colors || ParseC64TileSet( bytes.data(), bytes.size() - 1, loaded ) )
+    {
+      printf( "FAIL C64 tile set doesn't round-trip through the .c64t layout\n" );
+      return false;
+    }
+  }
+
+  printf( "OK   C64 tile sets sample, draw and render like the decoded atlas, and round-trip through .c64t\n" );
+  return true;
+}
@@ -0,0 +1,22 @@
+// Golden checks for the C64 decoders, encoder, D64 writer and 1 bit per pixel tile sets (c64_decode.h,
+// c64_encode.h, d64_image.h, vic2_decode.h, c64_tiles.h).
+
+#ifndef VERIFY_C64_VERIFY_H
+#define VERIFY_C64_VERIFY_H
+
+// Exhaustive equivalence check between the reference C64 decoder and the optimized kernels
+bool VerifyC64Kernels();
+
+// Checks that the C64 hires encoder reproduces decoded blocks, and writes and rewrites files of every size on a blank
+// D64 image, checking them, the BAM and the changed sector tracking
+bool VerifyC64Writer();
+
+// Checks every VIC-II mode of the row-parallel decoder against the per-pixel one on random data and colors, with
+// partly filled sheet rows
+bool VerifyVic2Decoder();
+
+// Checks that 1 bit per pixel C64 tile sets sample, draw and render maps (missing tiles and clipped regions included)
+// like an atlas of the decoded tiles, and round-trip through the .c64t layout
+bool VerifyC64TileSets();
+
+#endif // VERIFY_C64_VERIFY_H
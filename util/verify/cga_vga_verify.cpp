@@ -0,0 +1,130 @@
+#include "cga_vga_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/cga_decode.h"
+#include "../tile_decode/ega_decode.h"
+#include "../tile_decode/vga_decode.h"
+#include "golden_verify.h"
+
+
+bool VerifyCgaVgaDecoders()
+{
+  INSTRUMENT_BEGIN_FILE( "CGA and VGA checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x3c6ef372 };
+
+  // Tiles, characters, odd-width items and both kinds of picture, each from data that may stop part way through
+  const CgaLayout layouts[] = { CgaItemLayout( 16, 16 ), CgaItemLayout( 8, 8 ), CgaItemLayout( 12, 6 ),
+                                CgaScreenLayout( CGA_SCREEN_SIZE ), CgaScreenLayout( CGA_SCREEN_DUMP_SIZE ) };
+  const int32_t numRows[] = { 16 * 20, 8 * 30, 6 * 9, CGA_SCREEN_HEIGHT, CGA_SCREEN_HEIGHT };
+
+  std::vector<uint8_t> data( CGA_SCREEN_DUMP_SIZE );
+  IndexSurface expected;
+  IndexSurface actual;
+
+  for( int32_t pass = 0; pass < 20; ++pass )
+  {
+    const int32_t which{ pass % 5 };
+    const CgaLayout& layout{ layouts[which] };
+
+    for( uint8_t& value : data )
+    {
+      value = static_cast<uint8_t>( NextRandom( state ) );
+    }
+
+    const int32_t width{ layout.bytesPerRow * CGA_PIXELS_PER_BYTE };
+    const size_t numBlocks{ static_cast<size_t>( numRows[which] / layout.blockHeight ) };
+    const size_t fullSize{ static_cast<size_t>( layout.bankSize ) * 2 * numBlocks };
+    const size_t numBytes{ pass < 10 ? fullSize : NextRandom( state ) % fullSize };
+
+    expected.Create( width, numRows[which], 0xee );
+    actual.Create( width, numRows[which], 0xee );
+
+    const int32_t expectedRows{ DecodeCgaPackedReference( data.data(), numBytes, layout, expected.Row( 0 ),
+                                                          expected.pitch, numRows[which] ) };
+    const int32_t actualRows{ DecodeCgaPacked( data.data(), numBytes, layout, actual.Row( 0 ), actual.pitch,
+                                               numRows[which] ) };
+
+    if( expectedRows != actualRows || expected.pixels != actual.pixels )
+    {
+      printf( "FAIL CGA decoder differs from the reference decoder (%dx%d, %d bytes)\n", width, numRows[which],
+              static_cast<int32_t>( numBytes ) );
+      return false;
+    }
+  }
+
+  // The RLE front end, unpacked as EGA, has to match the EGA RLE reference decoder
+  std::vector<uint8_t> stream;
+  std::vector<uint8_t> expanded;
+  for( int32_t pass = 0; pass < 200; ++pass )
+  {
+    stream.clear();
+    const uint32_t numTokens{ NextRandom( state ) % 2000 };
+    for( uint32_t i = 0; i < numTokens; ++i )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      if( ( r & 0x3 ) == 0 )
+      {
+        stream.push_back( EGA_RLE_MARKER );
+        stream.push_back( static_cast<uint8_t>( r >> 8 ) );
+        stream.push_back( static_cast<uint8_t>( r >> 16 ) );
+      }
+      else
+      {
+        stream.push_back( static_cast<uint8_t>( r >> 8 ) );
+      }
+    }
+
+    if( ( pass & 1 ) && !stream.empty() )
+    {
+      stream.resize( NextRandom( state ) % stream.size() );
+    }
+
+    expanded.assign( 320 * 200 / 2, 0 );
+    const size_t size{ ExpandEgaRle( stream.data(), stream.size(), expanded.data(), expanded.size() ) };
+    const size_t expectedSize{ EgaRleExpandedSize( stream.data(), stream.size() ) };
+
+    expected.Create( 320, 200 );
+    actual.Create( 320, 200 );
+    DecodeEgaRleReference( stream.data(), stream.size(), expected.Row( 0 ), 320, 200, expected.pitch );
+    DecodeEgaPacked( expanded.data(), expanded.size(), 160, actual.Row( 0 ), actual.pitch, 200 );
+
+    if( size != ( expectedSize < expanded.size() ? expectedSize : expanded.size() ) ||
+        expected.pixels != actual.pixels )
+    {
+      printf( "FAIL RLE expansion differs from the EGA RLE reference decoder (stream %d)\n", pass );
+      return false;
+    }
+  }
+
+  // VGA: the DAC range maps onto the full byte range, and rows come through untouched
+  uint8_t paletteFile[VGA_PALETTE_FILE_SIZE];
+  for( int32_t i = 0; i < VGA_PALETTE_FILE_SIZE; ++i )
+  {
+    paletteFile[i] = static_cast<uint8_t>( i % 64 );
+  }
+
+  PaletteEntry palette[VGA_PALETTE_SIZE];
+  if( LoadVgaPalette( paletteFile, sizeof( paletteFile ) - 1, palette ) ||
+      !LoadVgaPalette( paletteFile, sizeof( paletteFile ), palette ) || palette[0].r != 0 || palette[21].r != 255 ||
+      palette[10].g != 125 )
+  {
+    printf( "FAIL VGA palette conversion\n" );
+    return false;
+  }
+
+  actual.Create( 16, 40 );
+  const int32_t rows{ DecodeVgaPacked( data.data(), 16 * 37 + 5, 16, actual.Row( 0 ), actual.pitch, 40 ) };
+  if( rows != 37 || memcmp( actual.pixels.data(), data.data(), 16 * 37 ) != 0 )
+  {
+    printf( "FAIL VGA decoder doesn't copy the rows\n" );
+    return false;
+  }
+
+  printf( "OK   CGA, VGA and RLE expansion decoders match the reference decoders\n" );
+  return true;
+}
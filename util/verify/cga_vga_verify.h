@@ -0,0 +1,10 @@
+// Golden checks for the CGA and VGA upgrade decoders (cga_decode.h, vga_decode.h).
+
+#ifndef VERIFY_CGA_VGA_VERIFY_H
+#define VERIFY_CGA_VGA_VERIFY_H
+
+// Checks the CGA decoder against the per-pixel one for tile, character and picture layouts, the RLE expansion that the
+// CGA and VGA pictures share against the EGA RLE reference decoder, and the VGA palette conversion
+bool VerifyCgaVgaDecoders();
+
+#endif // VERIFY_CGA_VGA_VERIFY_H
@@ -0,0 +1,83 @@
+#include "chunked_map_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/chunked_map.h"
+#include "../tile_decode/tile_map.h"
+#include "golden_verify.h"
+
+
+bool VerifyChunkedMapRenderer()
+{
+  INSTRUMENT_BEGIN_FILE( "Chunked map checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x3c6ef372 };
+
+  // 200 tiles, so some map entries are missing from the atlas
+  IndexSurface strip;
+  strip.Create( 16, 16 * 200 );
+  for( uint8_t& pixel : strip.pixels )
+  {
+    pixel = static_cast<uint8_t>( NextRandom( state ) & 0xf );
+  }
+
+  TileAtlas atlas;
+  atlas.Create( 16, 16 );
+  atlas.AddStrip( strip );
+
+  // Chunks 0, 5 and 9 are all ocean and chunk 7 repeats chunk 2, so both the drawn and the copied paths are covered
+  const ChunkedMapLayout layout{ 4, 3, 8, 6 };
+  const size_t chunkBytes{ 8 * 6 };
+  std::vector<uint8_t> mapData( ChunkedMapSize( layout ) );
+  for( uint8_t& entry : mapData )
+  {
+    entry = static_cast<uint8_t>( NextRandom( state ) );
+  }
+
+  memset( mapData.data(), 0, chunkBytes );
+  memset( mapData.data() + 5 * chunkBytes, 0, chunkBytes );
+  memset( mapData.data() + 9 * chunkBytes, 0, chunkBytes );
+  memcpy( mapData.data() + 7 * chunkBytes, mapData.data() + 2 * chunkBytes, chunkBytes );
+
+  int32_t expectedMissing{ 0 };
+  for( const uint8_t entry : mapData )
+  {
+    expectedMissing += entry >= 200 ? 1 : 0;
+  }
+
+  IndexSurface expected;
+  RenderChunkedMapReference( atlas, mapData.data(), mapData.size(), layout, expected );
+
+  const int32_t threadCounts[] = { 1, 4, 0 };
+  IndexSurface actual;
+
+  for( const int32_t numThreads : threadCounts )
+  {
+    ChunkedMapStats stats;
+    if( !RenderChunkedMap( atlas, mapData.data(), mapData.size(), layout, actual, numThreads, &stats ) ||
+        expected.pixels != actual.pixels )
+    {
+      printf( "FAIL chunked map renderer differs from the reference (%d threads)\n", numThreads );
+      return false;
+    }
+
+    if( stats.numChunks != 12 || stats.numDistinctChunks != 9 || stats.numMissingTiles != expectedMissing )
+    {
+      printf( "FAIL chunked map renderer counted %d chunks, %d distinct, %d missing tiles (expected 12, 9, %d)\n",
+              stats.numChunks, stats.numDistinctChunks, stats.numMissingTiles, expectedMissing );
+      return false;
+    }
+  }
+
+  if( RenderChunkedMap( atlas, mapData.data(), mapData.size() - 1, layout, actual ) )
+  {
+    printf( "FAIL chunked map renderer accepted a truncated map\n" );
+    return false;
+  }
+
+  printf( "OK   Chunked map renderer matches the reference renderer\n" );
+  return true;
+}
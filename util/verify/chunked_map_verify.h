@@ -0,0 +1,9 @@
+// Golden checks for the chunk-cached map renderer (chunked_map.h).
+
+#ifndef VERIFY_CHUNKED_MAP_VERIFY_H
+#define VERIFY_CHUNKED_MAP_VERIFY_H
+
+// Checks the chunk-cached map renderer against the per-pixel one, with repeated chunks and missing tiles
+bool VerifyChunkedMapRenderer();
+
+#endif // VERIFY_CHUNKED_MAP_VERIFY_H
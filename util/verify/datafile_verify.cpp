@@ -0,0 +1,166 @@
+#include "datafile_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "../tile_decode/datafile_writer.h"
+#include "golden_verify.h"
+
+
+namespace
+{
+  struct DatafileObject
+  {
+    uint32_t type;
+    std::string name;
+    std::vector<uint8_t> data;
+  };
+
+
+  uint32_t GetLong( const std::vector<uint8_t>& bytes, size_t& position )
+  {
+    const uint32_t value{ static_cast<uint32_t>( bytes[position] << 24 | bytes[position + 1] << 16 |
+                                                 bytes[position + 2] << 8 | bytes[position + 3] ) };
+    position += 4;
+    return value;
+  }
+
+
+  // Reads a datafile the way load_file_object() does: properties until an object type, then the object's chunk
+  bool ParseDatafile( const std::vector<uint8_t>& bytes, std::vector<DatafileObject>& objects )
+  {
+    size_t position{ 0 };
+    if( bytes.size() < 8 || GetLong( bytes, position ) != DATAFILE_MAGIC )
+    {
+      return false;
+    }
+
+    const uint32_t count{ GetLong( bytes, position ) };
+    objects.clear();
+
+    while( objects.size() < count )
+    {
+      DatafileObject object;
+      for( ;; )
+      {
+        if( position + 4 > bytes.size() )
+        {
+          return false;
+        }
+
+        object.type = GetLong( bytes, position );
+        if( object.type != DATAFILE_PROPERTY )
+        {
+          break;
+        }
+
+        if( position + 8 > bytes.size() )
+        {
+          return false;
+        }
+
+        const uint32_t propertyType{ GetLong( bytes, position ) };
+        const uint32_t size{ GetLong( bytes, position ) };
+        if( size > bytes.size() - position )
+        {
+          return false;
+        }
+
+        if( propertyType == DATAFILE_NAME )
+        {
+          object.name.assign( bytes.begin() + position, bytes.begin() + position + size );
+        }
+
+        position += size;
+      }
+
+      if( position + 8 > bytes.size() )
+      {
+        return false;
+      }
+
+      const uint32_t storedSize{ GetLong( bytes, position ) };
+      const uint32_t dataSize{ GetLong( bytes, position ) };
+      if( storedSize != dataSize || dataSize > bytes.size() - position )
+      {
+        return false;
+      }
+
+      object.data.assign( bytes.begin() + position, bytes.begin() + position + dataSize );
+      position += dataSize;
+      objects.push_back( std::move( object ) );
+    }
+
+    return position == bytes.size();
+  }
+} // namespace
+
+
+bool VerifyDatafileWriter()
+{
+  INSTRUMENT_BEGIN_FILE( "Datafile checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0xda7af11e };
+
+  // A palette, a 3x2 sheet of 7x8 glyphs with a spare column, and a lone bitmap
+  IndexSurface sheet;
+  sheet.Create( 7 * 3 + 4, 8 * 2 );
+  for( uint8_t& pixel : sheet.pixels )
+  {
+    pixel = static_cast<uint8_t>( NextRandom( state ) & 0x0f );
+  }
+
+  PaletteEntry colors[16];
+  RandomPalette( colors, 16, state );
+
+  DatafileWriter writer;
+  writer.AddPalette( "PALETTE", colors, 16 );
+  const int32_t numGlyphs{ writer.AddSheet( "CHAR", sheet, 7, 8 ) };
+  writer.AddBitmap( "START", sheet.Row( 3 ) + 2, sheet.pitch, 11, 5 );
+
+  std::vector<uint8_t> bytes;
+  writer.Store( bytes );
+
+  std::vector<DatafileObject> objects;
+  bool passed{ numGlyphs == 6 && writer.NumObjects() == 8 && ParseDatafile( bytes, objects ) && objects.size() == 8 };
+
+  // The palette is 256 entries of 6-bit components
+  passed = passed && objects[0].type == DATAFILE_PALETTE && objects[0].name == "PALETTE" &&
+           objects[0].data.size() == DATAFILE_PALETTE_SIZE * 3 &&
+           objects[0].data[14 * 3 + 2] == colors[14].b >> 2 && objects[0].data[200 * 3] == 0;
+
+  // Bitmaps are 8 bits per pixel, width, height (all 16-bit words), then their rows
+  for( size_t i = 1; i < objects.size() && passed; ++i )
+  {
+    const DatafileObject& object{ objects[i] };
+    const bool glyph{ i <= 6 };
+    const int32_t width{ glyph ? 7 : 11 };
+    const int32_t height{ glyph ? 8 : 5 };
+    const int32_t x{ glyph ? static_cast<int32_t>( ( i - 1 ) % 3 ) * 7 : 2 };
+    const int32_t y{ glyph ? static_cast<int32_t>( ( i - 1 ) / 3 ) * 8 : 3 };
+
+    char name[16];
+    snprintf( name, sizeof( name ), "CHAR_%03d", static_cast<int32_t>( i - 1 ) );
+
+    passed = object.type == DATAFILE_BITMAP && object.name == ( glyph ? name : "START" ) &&
+             object.data.size() == 6 + static_cast<size_t>( width ) * height && object.data[1] == 8 &&
+             object.data[3] == width && object.data[5] == height;
+
+    for( int32_t row = 0; row < height && passed; ++row )
+    {
+      passed = memcmp( &object.data[6 + row * width], sheet.Row( y + row ) + x, width ) == 0;
+    }
+  }
+
+  if( !passed )
+  {
+    printf( "FAIL datafile writer doesn't lay out its objects the way load_datafile() reads them\n" );
+    return false;
+  }
+
+  printf( "OK   Datafile writer lays out palette and bitmap objects the way load_datafile() reads them\n" );
+  return true;
+}
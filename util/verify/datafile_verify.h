@@ -0,0 +1,9 @@
+// Golden checks for the Allegro datafile writer (datafile_writer.h).
+
+#ifndef VERIFY_DATAFILE_VERIFY_H
+#define VERIFY_DATAFILE_VERIFY_H
+
+// Reads a synthetic datafile back the way Allegro's loader does and checks its palette, names and bitmaps
+bool VerifyDatafileWriter();
+
+#endif // VERIFY_DATAFILE_VERIFY_H
@@ -0,0 +1,101 @@
+#include "ega_encode_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/ega_decode.h"
+#include "../tile_decode/ega_encode.h"
+#include "golden_verify.h"
+
+
+bool VerifyEgaRleEncoder()
+{
+  INSTRUMENT_BEGIN_FILE( "EGA RLE encoder checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x1f123bb5 };
+
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> encoded;
+  std::vector<uint8_t> expanded;
+  std::vector<size_t> smallest;
+
+  for( int32_t pass = 0; pass < 200; ++pass )
+  {
+    // Runs of every length, some over the longest run token, from a small alphabet that includes the marker
+    data.clear();
+    const size_t size{ pass == 0 ? 0 : NextRandom( state ) % 4000 };
+    while( data.size() < size )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      const size_t length{ ( r & 0x7 ) == 0 ? ( r >> 8 ) % 600 : 1 + ( r >> 8 ) % 5 };
+      const uint8_t value{ static_cast<uint8_t>( ( r >> 3 ) & 0x3 ) };
+      data.insert( data.end(), length, value );
+    }
+    data.resize( size );
+
+    EncodeEgaRle( data.data(), data.size(), encoded );
+
+    expanded.assign( data.size() + 1, 0xee );
+    const size_t expandedSize{ ExpandEgaRle( encoded.data(), encoded.size(), expanded.data(), expanded.size() ) };
+    if( expandedSize != data.size() || ( !data.empty() && memcmp( expanded.data(), data.data(), data.size() ) != 0 ) )
+    {
+      printf( "FAIL EGA RLE encoder output doesn't expand back to its input (stream %d)\n", pass );
+      return false;
+    }
+
+    // The smallest possible encoding: each byte is either a literal, if it isn't the marker, or ends a run token
+    smallest.assign( data.size() + 1, 0 );
+    for( size_t i = 1; i <= data.size(); ++i )
+    {
+      size_t best{ data[i - 1] != EGA_RLE_MARKER ? smallest[i - 1] + 1 : SIZE_MAX };
+      for( size_t k = 1; k <= EGA_RLE_MAX_RUN && k <= i && data[i - k] == data[i - 1]; ++k )
+      {
+        if( smallest[i - k] + 3 < best )
+        {
+          best = smallest[i - k] + 3;
+        }
+      }
+      smallest[i] = best;
+    }
+
+    if( encoded.size() != smallest[data.size()] )
+    {
+      printf( "FAIL EGA RLE encoder takes %d bytes where %d would do (stream %d)\n",
+              static_cast<int32_t>( encoded.size() ), static_cast<int32_t>( smallest[data.size()] ), pass );
+      return false;
+    }
+  }
+
+  // Pictures, including odd widths, have to decode the same through the fast and the reference decoder
+  const int32_t widths[] = { 320, 17, 2, 1 };
+  IndexSurface picture;
+  IndexSurface expected;
+  IndexSurface actual;
+  for( const int32_t width : widths )
+  {
+    picture.Create( width, 23 );
+    for( uint8_t& pixel : picture.pixels )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      pixel = static_cast<uint8_t>( ( r & 0x30 ) != 0 ? 0 : r & 0xf );
+    }
+
+    EncodeEgaRlePicture( picture, encoded );
+
+    expected.Create( width, picture.height, 0xee );
+    actual.Create( width, picture.height, 0xee );
+    DecodeEgaRleReference( encoded.data(), encoded.size(), expected.Row( 0 ), width, picture.height, expected.pitch );
+    DecodeEgaRle( encoded.data(), encoded.size(), actual.Row( 0 ), width, picture.height, actual.pitch );
+
+    if( expected.pixels != picture.pixels || actual.pixels != picture.pixels )
+    {
+      printf( "FAIL EGA RLE picture doesn't decode back to the picture (%dx%d)\n", width, picture.height );
+      return false;
+    }
+  }
+
+  printf( "OK   EGA RLE encoder round-trips and writes the smallest encoding\n" );
+  return true;
+}
@@ -0,0 +1,10 @@
+// Golden checks for the EGA RLE picture encoder (ega_encode.h).
+
+#ifndef VERIFY_EGA_ENCODE_VERIFY_H
+#define VERIFY_EGA_ENCODE_VERIFY_H
+
+// Round-trips random data and pictures through the EGA RLE encoder, and checks its size against the smallest possible
+// encoding
+bool VerifyEgaRleEncoder();
+
+#endif // VERIFY_EGA_ENCODE_VERIFY_H
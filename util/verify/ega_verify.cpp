@@ -0,0 +1,86 @@
+#include "ega_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/ega_decode.h"
+#include "golden_verify.h"
+
+
+bool VerifyEgaKernels()
+{
+  INSTRUMENT_BEGIN_FILE( "EGA kernel checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  // Packed 4bpp: every byte value in a single row
+  uint8_t packed[256];
+  for( int32_t i = 0; i < 256; ++i )
+  {
+    packed[i] = static_cast<uint8_t>( i );
+  }
+
+  uint8_t expected[512];
+  uint8_t actual[512];
+  DecodeEgaPackedReference( packed, sizeof( packed ), 256, expected, 512, 1 );
+  DecodeEgaPacked( packed, sizeof( packed ), 256, actual, 512, 1 );
+
+  if( memcmp( expected, actual, sizeof( expected ) ) != 0 )
+  {
+    printf( "FAIL EGA packed kernel differs from the reference decoder\n" );
+    return false;
+  }
+
+  // RLE: synthetic streams with runs that cross rows, overflow the surface, and get truncated mid-token
+  const int32_t sizes[][2] = { { 320, 200 }, { 16, 16 }, { 14, 3 }, { 7, 5 }, { 2, 1 } };
+
+  uint32_t state{ 0x2545f491 };
+  std::vector<uint8_t> stream;
+  IndexSurface expectedSurface;
+  IndexSurface actualSurface;
+
+  for( int32_t pass = 0; pass < 2000; ++pass )
+  {
+    const int32_t* size{ sizes[pass % ( sizeof( sizes ) / sizeof( sizes[0] ) )] };
+
+    stream.clear();
+    const uint32_t numTokens{ NextRandom( state ) % 400 };
+    for( uint32_t i = 0; i < numTokens; ++i )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      if( ( r & 0x3 ) == 0 )
+      {
+        stream.push_back( EGA_RLE_MARKER );
+        stream.push_back( static_cast<uint8_t>( r >> 8 ) );
+        stream.push_back( static_cast<uint8_t>( r >> 16 ) );
+      }
+      else
+      {
+        stream.push_back( static_cast<uint8_t>( r >> 8 ) );
+      }
+    }
+
+    // Every other stream gets cut off, possibly in the middle of a run token
+    if( ( pass & 1 ) && !stream.empty() )
+    {
+      stream.resize( NextRandom( state ) % stream.size() );
+    }
+
+    expectedSurface.Create( size[0], size[1], 0xee );
+    actualSurface.Create( size[0], size[1], 0xee );
+
+    DecodeEgaRleReference( stream.data(), stream.size(), expectedSurface.pixels.data(), size[0], size[1],
+                           expectedSurface.pitch );
+    DecodeEgaRle( stream.data(), stream.size(), actualSurface.pixels.data(), size[0], size[1], actualSurface.pitch );
+
+    if( expectedSurface.pixels != actualSurface.pixels )
+    {
+      printf( "FAIL EGA RLE kernel differs from the reference decoder (stream %d, %dx%d)\n", pass, size[0],
+              size[1] );
+      return false;
+    }
+  }
+
+  printf( "OK   EGA packed and RLE kernels match the reference decoders\n" );
+  return true;
+}
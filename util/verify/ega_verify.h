@@ -0,0 +1,9 @@
+// Golden checks for the EGA decoders (ega_decode.h).
+
+#ifndef VERIFY_EGA_VERIFY_H
+#define VERIFY_EGA_VERIFY_H
+
+// Exhaustive equivalence check between the reference EGA decoders and the optimized kernels
+bool VerifyEgaKernels();
+
+#endif // VERIFY_EGA_VERIFY_H
@@ -0,0 +1,383 @@
+#include "golden_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../png/png_reader.h"
+#include "../tile_decode/c64_decode.h"
+#include "../tile_decode/cpu_dispatch.h"
+
+
+namespace
+{
+  // Maps every palette index onto the lowest index with the same color, so duplicate entries (the C64 grays) compare
+  // as equal
+  void CanonicalIndices( const PaletteEntry* palette, int32_t paletteSize, uint8_t canonical[256] )
+  {
+    for( int32_t i = 0; i < 256; ++i )
+    {
+      canonical[i] = static_cast<uint8_t>( i );
+    }
+
+    for( int32_t i = 0; i < paletteSize; ++i )
+    {
+      for( int32_t j = 0; j < i; ++j )
+      {
+        if( palette[i].r == palette[j].r && palette[i].g == palette[j].g && palette[i].b == palette[j].b )
+        {
+          canonical[i] = static_cast<uint8_t>( j );
+          break;
+        }
+      }
+    }
+  }
+
+
+  int32_t NearestIndex( const PaletteEntry& color, const PaletteEntry* palette, int32_t paletteSize )
+  {
+    int32_t best{ 0 };
+    int32_t bestDistance{ 0x7fffffff };
+
+    for( int32_t i = 0; i < paletteSize; ++i )
+    {
+      const int32_t dr{ color.r - palette[i].r };
+      const int32_t dg{ color.g - palette[i].g };
+      const int32_t db{ color.b - palette[i].b };
+      const int32_t distance{ dr * dr + dg * dg + db * db };
+
+      if( distance < bestDistance )
+      {
+        best = i;
+        bestDistance = distance;
+      }
+    }
+
+    return best;
+  }
+
+
+  void Remap( IndexSurface& surface, const uint8_t map[256] )
+  {
+    for( int32_t y = 0; y < surface.height; ++y )
+    {
+      uint8_t* row{ surface.Row( y ) };
+      for( int32_t x = 0; x < surface.width; ++x )
+      {
+        row[x] = map[row[x]];
+      }
+    }
+  }
+} // namespace
+
+
+uint64_t HashSurface( const IndexSurface& surface )
+{
+  uint64_t hash{ 0xcbf29ce484222325ull };
+
+  for( int32_t y = 0; y < surface.height; ++y )
+  {
+    const uint8_t* row{ surface.Row( y ) };
+    for( int32_t x = 0; x < surface.width; ++x )
+    {
+      hash ^= row[x];
+      hash *= 0x100000001b3ull;
+    }
+  }
+
+  return hash;
+}
+
+
+void RandomPalette( PaletteEntry* palette, int32_t paletteSize, uint32_t& state )
+{
+  for( int32_t i = 0; i < paletteSize; ++i )
+  {
+    const uint32_t r{ NextRandom( state ) };
+    palette[i] = PaletteEntry{ static_cast<uint8_t>( r ), static_cast<uint8_t>( r >> 8 ),
+                               static_cast<uint8_t>( r >> 16 ) };
+  }
+}
+
+
+bool VerifySurfaceAgainstPng( const char* label, const IndexSurface& decoded, const PaletteEntry* palette,
+                              int32_t paletteSize, const char* pngFilename, int32_t tileWidth, int32_t tileHeight )
+{
+  INSTRUMENT_SCOPE( "verify" );
+
+  PngImage reference;
+  const char* error{ nullptr };
+
+  if( !ReadPng( pngFilename, reference, error ) )
+  {
+    printf( "FAIL %s: can't read %s (%s)\n", label, pngFilename, error );
+    return false;
+  }
+
+  if( reference.indices.width != decoded.width || reference.indices.height != decoded.height )
+  {
+    printf( "FAIL %s: %s is %dx%d, decoded surface is %dx%d\n", label, pngFilename, reference.indices.width,
+            reference.indices.height, decoded.width, decoded.height );
+    return false;
+  }
+
+  uint8_t canonical[256];
+  CanonicalIndices( palette, paletteSize, canonical );
+
+  // Reference palette index -> canonical decoder palette index
+  uint8_t referenceMap[256];
+  for( int32_t i = 0; i < 256; ++i )
+  {
+    referenceMap[i] = i < static_cast<int32_t>( reference.palette.size() )
+                      ? canonical[NearestIndex( reference.palette[i], palette, paletteSize )]
+                      : static_cast<uint8_t>( 0xff );
+  }
+
+  IndexSurface actual{ decoded };
+  Remap( actual, canonical );
+  Remap( reference.indices, referenceMap );
+
+  const uint64_t actualHash{ HashSurface( actual ) };
+  const uint64_t referenceHash{ HashSurface( reference.indices ) };
+
+  if( actualHash == referenceHash )
+  {
+    printf( "OK   %s: %dx%d matches %s (hash %016llx)\n", label, decoded.width, decoded.height, pngFilename,
+            static_cast<unsigned long long>( actualHash ) );
+    return true;
+  }
+
+  // The hashes differ, so find the first pixel that does
+  const int32_t tilesPerRow{ decoded.width / tileWidth };
+
+  for( int32_t y = 0; y < decoded.height; ++y )
+  {
+    const uint8_t* actualRow{ actual.Row( y ) };
+    const uint8_t* referenceRow{ reference.indices.Row( y ) };
+
+    for( int32_t x = 0; x < decoded.width; ++x )
+    {
+      if( actualRow[x] != referenceRow[x] )
+      {
+        const int32_t tile{ ( y / tileHeight ) * tilesPerRow + ( x / tileWidth ) };
+        printf( "FAIL %s: differs from %s in tile %d at pixel (%d, %d), tile pixel (%d, %d): decoded %d, "
+                "reference %d\n", label, pngFilename, tile, x, y, x % tileWidth, y % tileHeight, actualRow[x],
+                referenceRow[x] );
+        return false;
+      }
+    }
+  }
+
+  // Only reachable if the surfaces differ in a way the diff can't see, which would be a bug in the hash
+  printf( "FAIL %s: hash mismatch against %s with no differing pixel\n", label, pngFilename );
+  return false;
+}
+
+
+bool VerifyDispatchKernels()
+{
+  INSTRUMENT_BEGIN_FILE( "Dispatch kernel checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  const DecodeKernels scalar{ BindKernels( IsaScalar ) };
+
+  uint32_t state{ 0x6b8b4567 };
+  uint8_t src[1024];
+  uint8_t colors[1024];
+  for( int32_t i = 0; i < 1024; ++i )
+  {
+    src[i] = static_cast<uint8_t>( NextRandom( state ) );
+    colors[i] = static_cast<uint8_t>( NextRandom( state ) );
+  }
+
+  uint8_t expected[2048];
+  uint8_t actual[2048];
+  uint32_t expected32[1024];
+  uint32_t actual32[1024];
+  uint16_t expected16[1024];
+  uint16_t actual16[1024];
+
+  uint32_t table32[256];
+  uint16_t table16[256];
+  for( int32_t i = 0; i < 256; ++i )
+  {
+    table32[i] = NextRandom( state );
+    table16[i] = static_cast<uint16_t>( NextRandom( state ) );
+  }
+
+  // Two rows of 32-bit pixels for the box filter
+  uint32_t pixels32[2][400];
+  for( int32_t i = 0; i < 400; ++i )
+  {
+    pixels32[0][i] = NextRandom( state );
+    pixels32[1][i] = NextRandom( state );
+  }
+
+  const int32_t tableSizes[] = { 2, 6, 16, 17, 256 };
+
+  bool passed{ true };
+
+  for( int32_t level = IsaSse2; level < NumIsas; ++level )
+  {
+    const Isa isa{ static_cast<Isa>( level ) };
+    if( !IsaSupported( isa ) )
+    {
+      break;
+    }
+
+    const DecodeKernels kernels{ BindKernels( isa ) };
+    bool matched{ true };
+
+    // Every length up to a few vector widths, from an unaligned start
+    for( int32_t count = 0; count <= 200 && matched; ++count )
+    {
+      const int32_t offset{ count & 3 };
+
+      scalar.expandNibbles( src + offset, count, expected );
+      kernels.expandNibbles( src + offset, count, actual );
+      if( memcmp( expected, actual, static_cast<size_t>( count ) * 2 ) != 0 )
+      {
+        printf( "FAIL %s nibble kernel differs from scalar (%d bytes)\n", IsaName( isa ), count );
+        matched = false;
+      }
+
+      scalar.expand2bpp( src + offset, count, expected );
+      kernels.expand2bpp( src + offset, count, actual );
+      if( memcmp( expected, actual, static_cast<size_t>( count ) * 4 ) != 0 )
+      {
+        printf( "FAIL %s 2bpp kernel differs from scalar (%d bytes)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    for( int32_t count = 0; count <= 300 && matched; ++count )
+    {
+      const uint8_t first{ src[count] };
+      const uint8_t second{ static_cast<uint8_t>( count % 3 == 0 ? first : colors[count] ) };
+
+      memset( expected, 0xee, sizeof( expected ) );
+      memset( actual, 0xee, sizeof( actual ) );
+      scalar.fillPairs( expected + 1, count, first, second );
+      kernels.fillPairs( actual + 1, count, first, second );
+      if( memcmp( expected, actual, static_cast<size_t>( count ) * 2 + 2 ) != 0 )
+      {
+        printf( "FAIL %s pair fill kernel differs from scalar (%d pairs)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    for( int32_t count = 0; count <= 100 && matched; ++count )
+    {
+      const int32_t offset{ count & 7 };
+
+      scalar.expandHires( src + offset, colors + offset, count, expected );
+      kernels.expandHires( src + offset, colors + offset, count, actual );
+      if( memcmp( expected, actual, static_cast<size_t>( count ) * C64_PIXELS_PER_BYTE ) != 0 )
+      {
+        printf( "FAIL %s hires kernel differs from scalar (%d bytes)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    for( const int32_t tableSize : tableSizes )
+    {
+      if( !matched )
+      {
+        break;
+      }
+
+      uint8_t indices[1024];
+      for( int32_t i = 0; i < 1024; ++i )
+      {
+        indices[i] = static_cast<uint8_t>( src[i] % tableSize );
+      }
+
+      for( int32_t count = 0; count <= 200 && matched; count += 7 )
+      {
+        const int32_t offset{ count & 3 };
+
+        scalar.mapIndices32( indices + offset, count, table32, tableSize, expected32 );
+        kernels.mapIndices32( indices + offset, count, table32, tableSize, actual32 );
+        scalar.mapIndices16( indices + offset, count, table16, tableSize, expected16 );
+        kernels.mapIndices16( indices + offset, count, table16, tableSize, actual16 );
+
+        if( memcmp( expected32, actual32, static_cast<size_t>( count ) * sizeof( uint32_t ) ) != 0 ||
+            memcmp( expected16, actual16, static_cast<size_t>( count ) * sizeof( uint16_t ) ) != 0 )
+        {
+          printf( "FAIL %s palette kernel differs from scalar (%d colors, %d pixels)\n", IsaName( isa ), tableSize,
+                  count );
+          matched = false;
+        }
+      }
+    }
+
+    for( int32_t count = 0; count <= 150 && matched; ++count )
+    {
+      const int32_t offset{ count & 3 };
+
+      scalar.boxFilter2x( pixels32[0] + offset, pixels32[1] + offset, count, expected32 );
+      kernels.boxFilter2x( pixels32[0] + offset, pixels32[1] + offset, count, actual32 );
+      if( memcmp( expected32, actual32, static_cast<size_t>( count ) * sizeof( uint32_t ) ) != 0 )
+      {
+        printf( "FAIL %s box filter kernel differs from scalar (%d pixels)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    // Runs of every length that end at every position within a vector, and runs that reach the end of the data
+    for( int32_t count = 0; count <= 200 && matched; ++count )
+    {
+      const int32_t offset{ count & 3 };
+      const int32_t runEnd{ static_cast<int32_t>( src[count] ) % ( count + 1 ) };
+
+      memset( expected, colors[count], sizeof( expected ) );
+      if( runEnd < count )
+      {
+        expected[offset + runEnd] = static_cast<uint8_t>( colors[count] ^ ( 1 << ( count & 7 ) ) );
+      }
+
+      if( scalar.runLength( expected + offset, count ) != kernels.runLength( expected + offset, count ) )
+      {
+        printf( "FAIL %s run length kernel differs from scalar (%d bytes)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    // Random nibble counts, capped and not, against data where about half the bytes match
+    for( int32_t count = 0; count <= 200 && matched; ++count )
+    {
+      const int32_t offset{ count & 3 };
+
+      PixelDifferenceTable table;
+      for( int32_t i = 0; i < 16; ++i )
+      {
+        table.low[i] = static_cast<uint8_t>( NextRandom( state ) % 5 );
+        table.high[i] = static_cast<uint8_t>( NextRandom( state ) % 5 );
+      }
+
+      table.cap = static_cast<uint8_t>( count % 3 == 0 ? 1 : 8 );
+
+      for( int32_t i = 0; i < count; ++i )
+      {
+        expected[offset + i] = ( colors[i] & 1 ) != 0 ? src[offset + i] : colors[i];
+      }
+
+      if( scalar.countPixelDifferences( src + offset, expected + offset, count, table ) !=
+          kernels.countPixelDifferences( src + offset, expected + offset, count, table ) )
+      {
+        printf( "FAIL %s pixel difference kernel differs from scalar (%d bytes)\n", IsaName( isa ), count );
+        matched = false;
+      }
+    }
+
+    if( matched )
+    {
+      printf( "OK   %s kernels match the scalar kernels\n", IsaName( isa ) );
+    }
+
+    passed &= matched;
+  }
+
+  printf( "     Decoding with %s kernels (best supported: %s)\n", IsaName( Kernels().isa ), IsaName( DetectIsa() ) );
+  return passed;
+}
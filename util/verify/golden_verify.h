@@ -0,0 +1,36 @@
+// Golden verification for the rippers' --verify mode.
+// Decoded surfaces are compared against the reference PNGs that ship next to the inputs, and the optimized decode
+// kernels are checked exhaustively against the per-pixel reference decoders. The checks for each decoder, encoder and
+// writer live next to this file in a *_verify.h of their own, so a ripper only links the modules it uses.
+
+#ifndef VERIFY_GOLDEN_VERIFY_H
+#define VERIFY_GOLDEN_VERIFY_H
+
+#include "../tile_decode/surface.h"
+
+// 64-bit FNV-1a hash of the pixel indices, row by row (padding past the width is ignored)
+uint64_t HashSurface( const IndexSurface& surface );
+
+// Compares a decoded surface with a reference PNG. The reference palette is matched to the decoder palette by nearest
+// color, since the references were saved from 16-bit screens and don't carry the exact RGB values. Palette entries
+// with identical colors are treated as equal. Reports the first differing tile and pixel on a mismatch.
+bool VerifySurfaceAgainstPng( const char* label, const IndexSurface& decoded, const PaletteEntry* palette,
+                              int32_t paletteSize, const char* pngFilename, int32_t tileWidth, int32_t tileHeight );
+
+// Checks every vector kernel level this CPU supports against the scalar kernels, over unaligned starts and every
+// tail length
+bool VerifyDispatchKernels();
+
+// Small deterministic generator for the synthetic inputs of the checks
+inline uint32_t NextRandom( uint32_t& state )
+{
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+// Fills a palette with made-up colors, for the checks that don't need a real one
+void RandomPalette( PaletteEntry* palette, int32_t paletteSize, uint32_t& state );
+
+#endif // VERIFY_GOLDEN_VERIFY_H
@@ -0,0 +1,79 @@
+#include "lzw_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../lzwpack/lzw_pack.h"
+#include "../tile_decode/surface.h"
+
+extern "C"
+{
+#include "../lzw_decode/lzw.h"
+}
+
+
+bool VerifyLzwEncoder( const std::vector<std::string>& filenames )
+{
+  INSTRUMENT_BEGIN_FILE( "LZW encoder checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  std::vector<std::vector<uint8_t>> files( filenames.size() );
+  for( size_t i = 0; i < filenames.size(); ++i )
+  {
+    if( !ReadFileBytes( filenames[i].c_str(), files[i] ) )
+    {
+      printf( "FAIL LZW encoder: can't read %s\n", filenames[i].c_str() );
+      return false;
+    }
+  }
+
+  std::vector<std::vector<uint8_t>> compressed;
+  std::vector<std::vector<uint8_t>> compressedAlone;
+  if( !CompressLzwBatch( files, compressed, 0 ) || !CompressLzwBatch( files, compressedAlone, 1 ) )
+  {
+    printf( "FAIL LZW encoder: a file couldn't be compressed\n" );
+    return false;
+  }
+
+  size_t totalSize{ 0 };
+  size_t totalCompressed{ 0 };
+  for( size_t i = 0; i < files.size(); ++i )
+  {
+    const std::vector<uint8_t>& file{ files[i] };
+    std::vector<uint8_t>& stream{ compressed[i] };
+    const long streamSize{ static_cast<long>( stream.size() ) };
+
+    if( stream != compressedAlone[i] )
+    {
+      printf( "FAIL LZW encoder: %s compresses differently on one thread\n", filenames[i].c_str() );
+      return false;
+    }
+
+    // One byte more than the file, so a stream that decodes too long is caught
+    std::vector<uint8_t> decoded( file.size() + 1 );
+    const long decodedSize{ lzwDecompressBounded( stream.data(), decoded.data(), streamSize,
+                                                  static_cast<long>( decoded.size() ) ) };
+    if( lzwGetDecompressedSize( stream.data(), streamSize ) != static_cast<long>( file.size() ) ||
+        decodedSize != static_cast<long>( file.size() ) || memcmp( decoded.data(), file.data(), file.size() ) != 0 )
+    {
+      printf( "FAIL LZW encoder: %s doesn't decode back to itself\n", filenames[i].c_str() );
+      return false;
+    }
+
+    totalSize += file.size();
+    totalCompressed += stream.size();
+  }
+
+  std::vector<std::vector<uint8_t>> empty( 1 );
+  if( CompressLzwBatch( empty, compressed, 0 ) || !compressed[0].empty() )
+  {
+    printf( "FAIL LZW encoder accepts an empty file\n" );
+    return false;
+  }
+
+  printf( "OK   LZW encoder round-trips %d files (%d bytes to %d) through the U4 decoder, on any number of threads\n",
+          static_cast<int32_t>( files.size() ), static_cast<int32_t>( totalSize ),
+          static_cast<int32_t>( totalCompressed ) );
+  return true;
+}
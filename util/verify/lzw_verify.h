@@ -0,0 +1,13 @@
+// Golden checks for the LZW encoder (lzwenc.h) and its batch driver (lzw_pack.h).
+
+#ifndef VERIFY_LZW_VERIFY_H
+#define VERIFY_LZW_VERIFY_H
+
+#include <string>
+#include <vector>
+
+// Compresses a ripper's own input files in one batch on all cores, and checks that every stream decodes back to its
+// file through the U4 decoder (lzw.c), that one thread compresses them the same, and that an empty file is refused
+bool VerifyLzwEncoder( const std::vector<std::string>& filenames );
+
+#endif // VERIFY_LZW_VERIFY_H
@@ -0,0 +1,66 @@
+#include "png_writer_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#include "../png/png_reader.h"
+#include "../png/png_writer.h"
+#include "golden_verify.h"
+
+
+bool VerifyPngWriter()
+{
+  INSTRUMENT_BEGIN_FILE( "PNG writer checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x9e3779b9 };
+
+  PaletteEntry palette[16];
+  RandomPalette( palette, 16, state );
+
+  // Noise (stored blocks), flat areas (long matches) and short repeats, at sizes that aren't a multiple of anything
+  const int32_t sizes[][2] = { { 1, 1 }, { 37, 23 }, { 320, 200 }, { 300, 257 } };
+  std::vector<uint8_t> png;
+  IndexSurface surface;
+
+  for( int32_t pass = 0; pass < 3; ++pass )
+  {
+    for( const auto& size : sizes )
+    {
+      surface.Create( size[0], size[1] );
+      for( size_t i = 0; i < surface.pixels.size(); ++i )
+      {
+        const uint32_t r{ NextRandom( state ) };
+        surface.pixels[i] = static_cast<uint8_t>( pass == 0 ? r & 0xf : pass == 1 ? ( i / 97 ) & 0xf : ( i % 5 ) * 3 );
+      }
+
+      PngImage image;
+      const char* error{ nullptr };
+
+      if( !EncodePngIndexed( surface, palette, 16, png ) || !DecodePng( png.data(), png.size(), image, error ) ||
+          image.indices.width != surface.width || image.indices.height != surface.height )
+      {
+        printf( "FAIL PNG writer output doesn't read back (%dx%d)\n", size[0], size[1] );
+        return false;
+      }
+
+      for( int32_t y = 0; y < surface.height; ++y )
+      {
+        for( int32_t x = 0; x < surface.width; ++x )
+        {
+          const PaletteEntry& expected{ palette[surface.Row( y )[x]] };
+          const PaletteEntry& actual{ image.palette[image.indices.Row( y )[x]] };
+
+          if( expected.r != actual.r || expected.g != actual.g || expected.b != actual.b )
+          {
+            printf( "FAIL PNG writer round trip differs at %d,%d (%dx%d)\n", x, y, size[0], size[1] );
+            return false;
+          }
+        }
+      }
+    }
+  }
+
+  printf( "OK   PNG writer output reads back identically\n" );
+  return true;
+}
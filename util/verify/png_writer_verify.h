@@ -0,0 +1,9 @@
+// Golden checks for the PNG writer (png_writer.h).
+
+#ifndef VERIFY_PNG_WRITER_VERIFY_H
+#define VERIFY_PNG_WRITER_VERIFY_H
+
+// Round-trips synthetic images through the PNG writer and the PNG reader
+bool VerifyPngWriter();
+
+#endif // VERIFY_PNG_WRITER_VERIFY_H
@@ -0,0 +1,39 @@
+#include "sniff_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#include "golden_verify.h"
+
+
+bool VerifySniffedGeometry( const char* label, const char* filename, SniffEncoding encoding, int32_t stride,
+                            int32_t tileWidth, int32_t tileHeight )
+{
+  INSTRUMENT_BEGIN_FILE( "Sniff checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  std::vector<uint8_t> bytes;
+  if( !ReadFileBytes( filename, bytes ) )
+  {
+    printf( "FAIL can't open %s\n", filename );
+    return false;
+  }
+
+  std::vector<SniffCandidate> candidates;
+  SniffGeometry( bytes.data(), bytes.size(), SniffOptions{}, candidates );
+
+  // The best candidate has to be the real layout, starting on a whole row of tiles
+  const size_t tileRowBytes{ static_cast<size_t>( stride ) * tileHeight };
+  if( candidates.empty() || candidates[0].encoding != encoding || candidates[0].stride != stride ||
+      candidates[0].tileWidth != tileWidth || candidates[0].tileHeight != tileHeight ||
+      candidates[0].offset % tileRowBytes != 0 )
+  {
+    printf( "FAIL %s sniffed as something other than %s tiles %dx%d, %d bytes a row\n", label,
+            SniffEncodingName( encoding ), tileWidth, tileHeight, stride );
+    return false;
+  }
+
+  printf( "OK   %s sniffed as %s tiles %dx%d, %d bytes a row\n", label, SniffEncodingName( encoding ), tileWidth,
+          tileHeight, stride );
+  return true;
+}
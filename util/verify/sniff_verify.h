@@ -0,0 +1,13 @@
+// Golden checks for the geometry sniffer (geometry_sniff.h).
+
+#ifndef VERIFY_SNIFF_VERIFY_H
+#define VERIFY_SNIFF_VERIFY_H
+
+#include "../sniff/geometry_sniff.h"
+
+// Sniffs a ripper's own input and checks the best candidate is its real pixel format, row stride and tile size,
+// starting on a whole tile
+bool VerifySniffedGeometry( const char* label, const char* filename, SniffEncoding encoding, int32_t stride,
+                            int32_t tileWidth, int32_t tileHeight );
+
+#endif // VERIFY_SNIFF_VERIFY_H
@@ -0,0 +1,80 @@
+#include "tile_map_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+
+#include "../tile_decode/tile_map.h"
+#include "golden_verify.h"
+
+
+bool VerifyTileMapRenderer()
+{
+  INSTRUMENT_BEGIN_FILE( "Tile map checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x1f123bb5 };
+
+  // Two 16x16 tile sets (the second one short, so some set 1 tiles are missing) and a map with every kind of entry
+  IndexSurface strip;
+  TileAtlas atlas;
+  atlas.Create( 16, 16 );
+
+  const int32_t setSizes[] = { 256, 44 };
+  for( const int32_t setSize : setSizes )
+  {
+    strip.Create( 16, 16 * setSize );
+    for( uint8_t& pixel : strip.pixels )
+    {
+      pixel = static_cast<uint8_t>( NextRandom( state ) & 0xf );
+    }
+
+    atlas.AddStrip( strip );
+  }
+
+  const int32_t mapWidth{ 37 };
+  const int32_t mapHeight{ 29 };
+  std::vector<uint8_t> mapData( static_cast<size_t>( mapWidth ) * mapHeight * 2 );
+  for( size_t i = 0; i < mapData.size(); i += 2 )
+  {
+    const uint32_t r{ NextRandom( state ) };
+    mapData[i] = static_cast<uint8_t>( ( r & 0x1f ) == 0 ? 2 : ( r >> 8 ) & 1 );
+    mapData[i + 1] = static_cast<uint8_t>( r >> 16 );
+  }
+
+  const TileMapEncoding encodings[] = { TILE_MAP_SET_AND_INDEX, TILE_MAP_BYTE };
+  const TileRegion regions[] =
+  {
+    { 0, 0, mapWidth, mapHeight }, { 5, 3, 11, 17 }, { -4, 20, 60, 60 }, { 36, 28, 1, 1 }
+  };
+  const int32_t threadCounts[] = { 1, 3, 8, 0 };
+
+  IndexSurface expected;
+  IndexSurface actual;
+
+  for( const TileMapEncoding encoding : encodings )
+  {
+    const TileMapView map{ mapData.data(), encoding == TILE_MAP_BYTE ? mapWidth * 2 : mapWidth, mapHeight,
+                           mapWidth * 2, encoding };
+
+    for( TileRegion region : regions )
+    {
+      ClipTileRegion( map, region );
+
+      for( const int32_t numThreads : threadCounts )
+      {
+        const int32_t expectedMissing{ RenderTileMapReference( atlas, map, region, expected, 0xee ) };
+        const int32_t actualMissing{ RenderTileMap( atlas, map, region, actual, numThreads, 0xee ) };
+
+        if( expected.pixels != actual.pixels || expectedMissing != actualMissing )
+        {
+          printf( "FAIL tile map renderer differs from the reference (region %d,%d %dx%d, %d threads)\n", region.x,
+                  region.y, region.width, region.height, numThreads );
+          return false;
+        }
+      }
+    }
+  }
+
+  printf( "OK   Tile map renderer matches the reference renderer\n" );
+  return true;
+}
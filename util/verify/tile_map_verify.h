@@ -0,0 +1,10 @@
+// Golden checks for the tile map renderer (tile_map.h).
+
+#ifndef VERIFY_TILE_MAP_VERIFY_H
+#define VERIFY_TILE_MAP_VERIFY_H
+
+// Checks the banded tile map renderer against the per-pixel one on a synthetic map, including regions that need
+// clipping and tiles missing from the atlas
+bool VerifyTileMapRenderer();
+
+#endif // VERIFY_TILE_MAP_VERIFY_H
@@ -0,0 +1,168 @@
+#include "tile_pack_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/tile_pack.h"
+#include "golden_verify.h"
+
+
+namespace
+{
+  // Checks that tile first + i of a pack holds tile i of sheet, read in place when it's raw and extracted either way
+  bool PackHoldsSheet( const TilePackView& view, int32_t first, const IndexSurface& sheet, int32_t tileWidth,
+                       int32_t tileHeight, int32_t palette )
+  {
+    const int32_t tilesPerRow{ sheet.width / tileWidth };
+    const int32_t numTiles{ tilesPerRow * ( sheet.height / tileHeight ) };
+
+    // Extracted once with padding on every row and once without, which compressed tiles expand straight into
+    const int32_t pitch{ tileWidth + 3 };
+    std::vector<uint8_t> extracted( static_cast<size_t>( pitch ) * tileHeight );
+    std::vector<uint8_t> tight( static_cast<size_t>( tileWidth ) * tileHeight );
+
+    for( int32_t tile = 0; tile < numTiles; ++tile )
+    {
+      const TilePackEntry& entry{ view.Tile( first + tile ) };
+      if( entry.width != tileWidth || entry.height != tileHeight || entry.palette != palette ||
+          !view.ExtractTile( first + tile, extracted.data(), pitch ) ||
+          !view.ExtractTile( first + tile, tight.data(), tileWidth ) )
+      {
+        return false;
+      }
+
+      const uint8_t* pixels{ view.Pixels( first + tile ) };
+      if( pixels != nullptr && entry.offset % TILE_PACK_ALIGNMENT != 0 )
+      {
+        return false;
+      }
+
+      const int32_t x{ ( tile % tilesPerRow ) * tileWidth };
+      const int32_t y{ ( tile / tilesPerRow ) * tileHeight };
+      for( int32_t row = 0; row < tileHeight; ++row )
+      {
+        const uint8_t* expected{ sheet.Row( y + row ) + x };
+        if( memcmp( &extracted[static_cast<size_t>( row ) * pitch], expected, tileWidth ) != 0 ||
+            memcmp( &tight[static_cast<size_t>( row ) * tileWidth], expected, tileWidth ) != 0 ||
+            ( pixels != nullptr && memcmp( pixels + row * tileWidth, expected, tileWidth ) != 0 ) )
+        {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+} // namespace
+
+
+bool VerifyTilePack()
+{
+  INSTRUMENT_BEGIN_FILE( "Tile pack checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x7a11e5 };
+
+  // Sheets of runs (which compress) and of noise (which doesn't), in every tile size the rippers write
+  const int32_t sizes[][4] = { { 16, 16, 16, 8 }, { 14, 16, 16, 16 }, { 7, 8, 16, 8 }, { 8, 8, 16, 16 } };
+  IndexSurface sheets[4];
+  PaletteEntry colors[2][16];
+  RandomPalette( colors[0], 16, state );
+  RandomPalette( colors[1], 16, state );
+
+  TilePackWriter writer;
+  const int32_t palettes[] = { writer.AddPalette( colors[0], 16 ), writer.AddPalette( colors[1], 16 ) };
+  int32_t firsts[4];
+
+  for( int32_t i = 0; i < 4; ++i )
+  {
+    sheets[i].Create( sizes[i][0] * sizes[i][2], sizes[i][1] * sizes[i][3] );
+
+    uint8_t value{ 0 };
+    for( uint8_t& pixel : sheets[i].pixels )
+    {
+      const uint32_t r{ NextRandom( state ) };
+      value = static_cast<uint8_t>( i % 2 == 0 ? ( ( r & 0x1f ) == 0 ? r >> 8 : value ) : r );
+      pixel = value;
+    }
+
+    firsts[i] = writer.AddSheet( sheets[i], sizes[i][0], sizes[i][1], palettes[i % 2] );
+  }
+
+  for( const bool compress : { false, true } )
+  {
+    std::vector<uint8_t> bytes;
+    writer.Store( bytes, compress, compress ? 3 : 0 );
+
+    TilePackView view;
+    bool passed{ view.Open( bytes.data(), bytes.size() ) && view.NumPalettes() == 2 };
+    for( int32_t i = 0; i < 4 && passed; ++i )
+    {
+      passed = PackHoldsSheet( view, firsts[i], sheets[i], sizes[i][0], sizes[i][1], palettes[i % 2] );
+    }
+
+    passed &= view.Palette( 1 )[2].r == colors[1][2].r && view.Palette( 0 )[200].g == 0;
+
+    // Only the sheets of runs compress
+    int32_t numCompressed{ 0 };
+    for( int32_t tile = 0; tile < view.NumTiles(); ++tile )
+    {
+      numCompressed += view.Tile( tile ).codec == TILE_PACK_CODEC_RLE ? 1 : 0;
+    }
+
+    passed &= compress ? numCompressed >= 16 * 8 + 16 * 8 : numCompressed == 0;
+
+    // A pack cut short, and one whose tile points past the end, are refused
+    TilePackView refused;
+    passed &= !refused.Open( bytes.data(), bytes.size() - 1 );
+
+    std::vector<uint8_t> broken( bytes );
+    TilePackEntry* entries{ reinterpret_cast<TilePackEntry*>( &broken[reinterpret_cast<TilePackHeader*>(
+                                                                        broken.data() )->indexOffset] ) };
+    entries[5].offset = static_cast<uint32_t>( broken.size() - 4 );
+    passed &= !refused.Open( broken.data(), broken.size() );
+
+    entries[5].offset = 0;
+    entries[5].palette = 2;
+    passed &= !refused.Open( broken.data(), broken.size() );
+
+    if( !passed )
+    {
+      printf( "FAIL tile pack doesn't round-trip (%s)\n", compress ? "compressed" : "raw" );
+      return false;
+    }
+  }
+
+  printf( "OK   Tile packs round-trip raw and compressed tiles, and refuse packs that point outside themselves\n" );
+  return true;
+}
+
+
+bool VerifySheetPack( const char* label, const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize,
+                      int32_t tileWidth, int32_t tileHeight )
+{
+  TilePackWriter writer;
+  const int32_t paletteId{ writer.AddPalette( palette, paletteSize ) };
+  const int32_t first{ writer.AddSheet( sheet, tileWidth, tileHeight, paletteId ) };
+
+  size_t packSizes[2]{};
+  for( const bool compress : { false, true } )
+  {
+    std::vector<uint8_t> bytes;
+    writer.Store( bytes, compress );
+    packSizes[compress ? 1 : 0] = bytes.size();
+
+    TilePackView view;
+    if( first < 0 || !view.Open( bytes.data(), bytes.size() ) ||
+        !PackHoldsSheet( view, first, sheet, tileWidth, tileHeight, paletteId ) )
+    {
+      printf( "FAIL %s: tiles don't round-trip through a tile pack (%s)\n", label, compress ? "compressed" : "raw" );
+      return false;
+    }
+  }
+
+  printf( "OK   %s: tiles round-trip through a tile pack (%d bytes raw, %d compressed)\n", label,
+          static_cast<int32_t>( packSizes[0] ), static_cast<int32_t>( packSizes[1] ) );
+  return true;
+}
@@ -0,0 +1,16 @@
+// Golden checks for the tile pack format (tile_pack.h).
+
+#ifndef VERIFY_TILE_PACK_VERIFY_H
+#define VERIFY_TILE_PACK_VERIFY_H
+
+#include "../tile_decode/surface.h"
+
+// Round-trips sheets of every tile size through raw and compressed tile packs, and checks that packs pointing outside
+// themselves are refused
+bool VerifyTilePack();
+
+// Packs a decoded sheet raw and compressed, and checks every tile comes back the same
+bool VerifySheetPack( const char* label, const IndexSurface& sheet, const PaletteEntry* palette, int32_t paletteSize,
+                      int32_t tileWidth, int32_t tileHeight );
+
+#endif // VERIFY_TILE_PACK_VERIFY_H
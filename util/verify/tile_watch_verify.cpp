@@ -0,0 +1,148 @@
+#include "tile_watch_verify.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "../tile_decode/tile_pack.h"
+#include "../watch/tile_watch.h"
+#include "golden_verify.h"
+
+
+bool VerifyTileWatch()
+{
+  INSTRUMENT_BEGIN_FILE( "Tile watch checks" );
+  INSTRUMENT_SCOPE( "verify" );
+
+  uint32_t state{ 0x3a7c41 };
+
+  // Tiles one after another with gaps between their lines, tiles interleaved a line at a time, and a color byte per
+  // tile, like the EGA, Apple and C64 inputs
+  const TileByteLayout layouts[] = { { 16, 40, 5, 4, 8, 20, 0 }, { 820, 2, 64, 2, 16, 32, 20 },
+                                     { 1850, 1, 1, 1, 1, 32, 52 } };
+  const int32_t numPackTiles{ 84 };
+
+  std::vector<uint8_t> before( 1900 );
+  for( uint8_t& byte : before )
+  {
+    byte = static_cast<uint8_t>( NextRandom( state ) );
+  }
+
+  for( int32_t pass = 0; pass < 2000; ++pass )
+  {
+    std::vector<uint8_t> after( before );
+    const uint32_t numEdits{ 1 + NextRandom( state ) % 4 };
+    for( uint32_t edit = 0; edit < numEdits; ++edit )
+    {
+      after[NextRandom( state ) % after.size()] ^= static_cast<uint8_t>( 1 + NextRandom( state ) % 255 );
+    }
+
+    // Now and then the file is cut short or grows
+    if( pass % 16 == 0 )
+    {
+      after.resize( 1700 + NextRandom( state ) % 400, 0 );
+    }
+
+    std::vector<bool> changed( numPackTiles, false );
+    std::vector<bool> expected( numPackTiles, false );
+    for( const TileByteLayout& layout : layouts )
+    {
+      MarkChangedTiles( layout, before, after, changed );
+
+      for( int32_t tile = 0; tile < layout.numTiles; ++tile )
+      {
+        for( int32_t line = 0; line < layout.numLines; ++line )
+        {
+          for( int32_t byte = 0; byte < layout.bytesPerLine; ++byte )
+          {
+            const size_t position{ layout.offset + tile * layout.tileStride + line * layout.lineStride + byte };
+            const bool inBefore{ position < before.size() };
+            const bool inAfter{ position < after.size() };
+            if( inBefore != inAfter || ( inBefore && before[position] != after[position] ) )
+            {
+              expected[layout.firstPackTile + tile] = true;
+            }
+          }
+        }
+      }
+    }
+
+    if( changed != expected )
+    {
+      printf( "FAIL tile watch marks the wrong tiles as changed (pass %d)\n", pass );
+      return false;
+    }
+  }
+
+  // A pack of two tile sizes, two of whose tiles are patched: one from back to back rows and one from a wider sheet
+  IndexSurface sheets[2];
+  sheets[0].Create( 16 * 4, 16 );
+  sheets[1].Create( 7 * 8, 8 );
+  IndexSurface patches;
+  patches.Create( 24, 8 );
+
+  for( IndexSurface* surface : { &sheets[0], &sheets[1], &patches } )
+  {
+    for( uint8_t& pixel : surface->pixels )
+    {
+      pixel = static_cast<uint8_t>( NextRandom( state ) );
+    }
+  }
+
+  PaletteEntry colors[16];
+  RandomPalette( colors, 16, state );
+
+  TilePackWriter writer;
+  const int32_t palette{ writer.AddPalette( colors, 16 ) };
+  writer.AddSheet( sheets[0], 16, 16, palette );
+  writer.AddSheet( sheets[1], 7, 8, palette );
+
+  const char* filename{ "watch_check.utp" };
+  std::vector<uint8_t> original;
+  writer.Store( original, false );
+
+  TilePackPatcher patcher;
+  bool passed{ WriteFileBytes( filename, original ) && patcher.Open( filename ) && patcher.NumTiles() == 12 };
+  passed = passed && patcher.PatchTile( 6, patches.Row( 0 ) + 3, patches.pitch );
+
+  std::vector<uint8_t> backToBack( 16 * 16 );
+  for( uint8_t& pixel : backToBack )
+  {
+    pixel = static_cast<uint8_t>( NextRandom( state ) );
+  }
+
+  passed = passed && patcher.PatchTile( 1, backToBack.data(), 16 ) && patcher.Flush();
+  patcher.Close();
+
+  std::vector<uint8_t> patched;
+  TilePackView view;
+  passed = passed && ReadFileBytes( filename, patched ) && patched.size() == original.size() &&
+           view.Open( patched.data(), patched.size() );
+  remove( filename );
+
+  for( int32_t tile = 0; tile < 12 && passed; ++tile )
+  {
+    const TilePackEntry& entry{ view.Tile( tile ) };
+    for( int32_t y = 0; y < entry.height && passed; ++y )
+    {
+      const uint8_t* row{ view.Pixels( tile ) + static_cast<size_t>( y ) * entry.width };
+      const uint8_t* expected{ tile == 1 ? &backToBack[static_cast<size_t>( y ) * 16]
+                               : tile == 6 ? patches.Row( y ) + 3
+                               : tile < 4 ? sheets[0].Row( y ) + tile * 16
+                                          : sheets[1].Row( y ) + ( tile - 4 ) * 7 };
+      passed = memcmp( row, expected, entry.width ) == 0;
+    }
+  }
+
+  // The headers and index are untouched
+  passed = passed && memcmp( patched.data(), original.data(), view.Tile( 0 ).offset ) == 0;
+
+  if( !passed )
+  {
+    printf( "FAIL patching a tile pack in place doesn't leave the new tiles, and only them, changed\n" );
+    return false;
+  }
+
+  printf( "OK   Tile watch marks exactly the edited tiles and patches packs in place\n" );
+  return true;
+}
@@ -0,0 +1,10 @@
+// Golden checks for --watch (tile_watch.h).
+
+#ifndef VERIFY_TILE_WATCH_VERIFY_H
+#define VERIFY_TILE_WATCH_VERIFY_H
+
+// Checks that --watch finds exactly the tiles an edit touches, for tiles stored one after another, interleaved by line,
+// and one byte each, and that a raw pack patched in place holds the new tiles and nothing else changed
+bool VerifyTileWatch();
+
+#endif // VERIFY_TILE_WATCH_VERIFY_H
@@ -0,0 +1,381 @@
+#include "file_watcher.h"
+
+#include <cstring>
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined( __linux__ )
+#include <cerrno>
+#include <poll.h>
+#include <strings.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <strings.h>
+#include <sys/stat.h>
+#include <thread>
+#endif
+
+
+namespace
+{
+  // How long a directory has to be quiet before a save counts as finished
+  const int32_t settleMilliseconds{ 50 };
+
+
+  void SplitPath( const char* filename, std::string& directory, std::string& baseName )
+  {
+    const char* slash{ strrchr( filename, '/' ) };
+#if defined( _WIN32 )
+    const char* backslash{ strrchr( filename, '\\' ) };
+    slash = backslash > slash ? backslash : slash;
+#endif
+
+    directory = slash != nullptr ? std::string( filename, slash - filename + 1 ) : std::string( "." );
+    baseName = slash != nullptr ? slash + 1 : filename;
+  }
+
+
+  bool SameName( const char* a, const char* b )
+  {
+#if defined( _WIN32 )
+    return _stricmp( a, b ) == 0;
+#else
+    return strcasecmp( a, b ) == 0;
+#endif
+  }
+} // namespace
+
+
+#if defined( _WIN32 )
+
+struct FileWatcher::Directory
+{
+  std::string path;
+  HANDLE handle{ INVALID_HANDLE_VALUE };
+  OVERLAPPED overlapped{};
+  DWORD buffer[4096];  // FILE_NOTIFY_INFORMATION records are DWORD aligned
+
+  bool Read()
+  {
+    const DWORD filter{ FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE };
+    return ReadDirectoryChangesW( handle, buffer, sizeof( buffer ), FALSE, filter, nullptr, &overlapped, nullptr ) !=
+           FALSE;
+  }
+
+  ~Directory()
+  {
+    if( handle != INVALID_HANDLE_VALUE )
+    {
+      CancelIo( handle );
+      CloseHandle( handle );
+    }
+
+    if( overlapped.hEvent != nullptr )
+    {
+      CloseHandle( overlapped.hEvent );
+    }
+  }
+};
+
+#elif defined( __linux__ )
+
+struct FileWatcher::Directory
+{
+  std::string path;
+  int watch{ -1 };
+};
+
+#else
+
+struct FileWatcher::Directory
+{
+  std::string path;
+};
+
+
+namespace
+{
+  void FileStatus( const char* filename, uint64_t& size, int64_t& time )
+  {
+    struct stat status;
+    if( stat( filename, &status ) != 0 )
+    {
+      size = 0;
+      time = -1;
+      return;
+    }
+
+    size = static_cast<uint64_t>( status.st_size );
+    time = static_cast<int64_t>( status.st_mtime );
+  }
+} // namespace
+
+#endif
+
+
+FileWatcher::FileWatcher()
+{
+#if defined( __linux__ )
+  m_inotify = inotify_init1( IN_CLOEXEC );
+#endif
+}
+
+
+FileWatcher::~FileWatcher()
+{
+  m_directories.clear();
+
+#if defined( __linux__ )
+  if( m_inotify >= 0 )
+  {
+    close( m_inotify );
+  }
+#endif
+}
+
+
+bool FileWatcher::Watch( const char* filename )
+{
+  File file;
+  std::string directoryPath;
+  file.name = filename;
+  SplitPath( filename, directoryPath, file.baseName );
+  file.size = 0;
+  file.time = 0;
+
+  file.directory = m_directories.size();
+  for( size_t i = 0; i < m_directories.size(); ++i )
+  {
+    if( m_directories[i]->path == directoryPath )
+    {
+      file.directory = i;
+    }
+  }
+
+  if( file.directory == m_directories.size() )
+  {
+    std::unique_ptr<Directory> directory{ new Directory };
+    directory->path = directoryPath;
+
+#if defined( _WIN32 )
+    // One outstanding read per directory, and WaitForMultipleObjects() takes at most 64 of them
+    directory->handle = CreateFileA( directoryPath.c_str(), FILE_LIST_DIRECTORY,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                     FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr );
+    directory->overlapped.hEvent = CreateEventA( nullptr, TRUE, FALSE, nullptr );
+    if( directory->handle == INVALID_HANDLE_VALUE || directory->overlapped.hEvent == nullptr ||
+        m_directories.size() == MAXIMUM_WAIT_OBJECTS || !directory->Read() )
+    {
+      return false;
+    }
+#elif defined( __linux__ )
+    const uint32_t events{ IN_CLOSE_WRITE | IN_MOVED_TO };
+    directory->watch = m_inotify >= 0 ? inotify_add_watch( m_inotify, directoryPath.c_str(), events ) : -1;
+    if( directory->watch < 0 )
+    {
+      return false;
+    }
+#endif
+
+    m_directories.push_back( std::move( directory ) );
+  }
+
+#if !defined( _WIN32 ) && !defined( __linux__ )
+  FileStatus( filename, file.size, file.time );
+#endif
+
+  m_files.push_back( file );
+  return true;
+}
+
+
+void FileWatcher::MarkChanged( size_t directory, const char* baseName, std::vector<bool>& changed ) const
+{
+  for( size_t i = 0; i < m_files.size(); ++i )
+  {
+    const File& file{ m_files[i] };
+    if( file.directory == directory && ( baseName == nullptr || SameName( file.baseName.c_str(), baseName ) ) )
+    {
+      changed[i] = true;
+    }
+  }
+}
+
+
+bool FileWatcher::WaitForChanges( std::vector<std::string>& changed )
+{
+  changed.clear();
+  if( m_files.empty() )
+  {
+    return false;
+  }
+
+  std::vector<bool> flags( m_files.size(), false );
+  bool anyChanged{ false };
+
+#if defined( _WIN32 )
+  std::vector<HANDLE> events;
+  for( const auto& directory : m_directories )
+  {
+    events.push_back( directory->overlapped.hEvent );
+  }
+
+  // Until something watched changes, and then until the writes stop
+  for( ;; )
+  {
+    const DWORD result{ WaitForMultipleObjects( static_cast<DWORD>( events.size() ), events.data(), FALSE,
+                                                anyChanged ? settleMilliseconds : INFINITE ) };
+    if( result == WAIT_TIMEOUT )
+    {
+      break;
+    }
+
+    if( result >= WAIT_OBJECT_0 + events.size() )
+    {
+      return false;
+    }
+
+    const size_t index{ result - WAIT_OBJECT_0 };
+    Directory& directory{ *m_directories[index] };
+
+    DWORD numBytes{ 0 };
+    if( !GetOverlappedResult( directory.handle, &directory.overlapped, &numBytes, FALSE ) )
+    {
+      return false;
+    }
+
+    // No records means the buffer overflowed, and anything in the directory may have changed
+    if( numBytes == 0 )
+    {
+      MarkChanged( index, nullptr, flags );
+    }
+
+    const uint8_t* record{ reinterpret_cast<const uint8_t*>( directory.buffer ) };
+    while( numBytes > 0 )
+    {
+      const FILE_NOTIFY_INFORMATION* info{ reinterpret_cast<const FILE_NOTIFY_INFORMATION*>( record ) };
+
+      char name[MAX_PATH * 3];
+      const int32_t length{ WideCharToMultiByte( CP_ACP, 0, info->FileName,
+                                                 static_cast<int>( info->FileNameLength / sizeof( WCHAR ) ), name,
+                                                 sizeof( name ) - 1, nullptr, nullptr ) };
+      name[length > 0 ? length : 0] = '\0';
+      MarkChanged( index, name, flags );
+
+      if( info->NextEntryOffset == 0 )
+      {
+        break;
+      }
+
+      record += info->NextEntryOffset;
+    }
+
+    ResetEvent( directory.overlapped.hEvent );
+    if( !directory.Read() )
+    {
+      return false;
+    }
+
+    for( bool flag : flags )
+    {
+      anyChanged |= flag;
+    }
+  }
+#elif defined( __linux__ )
+  for( ;; )
+  {
+    pollfd descriptor{ m_inotify, POLLIN, 0 };
+    const int ready{ poll( &descriptor, 1, anyChanged ? settleMilliseconds : -1 ) };
+    if( ready < 0 && errno == EINTR )
+    {
+      continue;
+    }
+
+    if( ready < 0 )
+    {
+      return false;
+    }
+
+    if( ready == 0 )
+    {
+      break;
+    }
+
+    alignas( inotify_event ) char buffer[4096];
+    const ssize_t numBytes{ read( m_inotify, buffer, sizeof( buffer ) ) };
+    if( numBytes < 0 && errno == EINTR )
+    {
+      continue;
+    }
+
+    if( numBytes <= 0 )
+    {
+      return false;
+    }
+
+    for( const char* record = buffer; record < buffer + numBytes; )
+    {
+      const inotify_event* event{ reinterpret_cast<const inotify_event*>( record ) };
+      for( size_t i = 0; i < m_directories.size(); ++i )
+      {
+        if( ( event->mask & IN_Q_OVERFLOW ) != 0 )
+        {
+          MarkChanged( i, nullptr, flags );
+        }
+        else if( m_directories[i]->watch == event->wd && event->len > 0 )
+        {
+          MarkChanged( i, event->name, flags );
+        }
+      }
+
+      record += sizeof( inotify_event ) + event->len;
+    }
+
+    for( bool flag : flags )
+    {
+      anyChanged |= flag;
+    }
+  }
+#else
+  for( ;; )
+  {
+    std::this_thread::sleep_for( std::chrono::milliseconds( settleMilliseconds ) );
+
+    bool changedNow{ false };
+    for( size_t i = 0; i < m_files.size(); ++i )
+    {
+      uint64_t size;
+      int64_t time;
+      FileStatus( m_files[i].name.c_str(), size, time );
+
+      if( size != m_files[i].size || time != m_files[i].time )
+      {
+        m_files[i].size = size;
+        m_files[i].time = time;
+        flags[i] = true;
+        changedNow = true;
+      }
+    }
+
+    if( anyChanged && !changedNow )
+    {
+      break;
+    }
+
+    anyChanged |= changedNow;
+  }
+#endif
+
+  for( size_t i = 0; i < m_files.size(); ++i )
+  {
+    if( flags[i] )
+    {
+      changed.push_back( m_files[i].name );
+    }
+  }
+
+  return true;
+}
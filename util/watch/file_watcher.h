@@ -0,0 +1,53 @@
+// Waits for input files to be saved, for the rippers' --watch mode.
+//
+// Directories are watched rather than files, since many editors save by writing a new file and renaming it over the
+// old one: inotify on Linux, ReadDirectoryChangesW on Windows, and polling modification times anywhere else. A save is
+// usually several writes, so a wait only returns once the directory has been quiet for a moment.
+
+#ifndef WATCH_FILE_WATCHER_H
+#define WATCH_FILE_WATCHER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+class FileWatcher
+{
+public:
+  FileWatcher();
+  ~FileWatcher();
+
+  FileWatcher( const FileWatcher& ) = delete;
+  FileWatcher& operator=( const FileWatcher& ) = delete;
+
+  // Starts watching filename. Returns false if its directory can't be watched.
+  bool Watch( const char* filename );
+
+  // Blocks until watched files have been written, and returns their names as they were given to Watch(). Names are
+  // matched without regard to case, like the games' own file names. Returns false if watching fails.
+  bool WaitForChanges( std::vector<std::string>& changed );
+
+private:
+  struct Directory;
+
+  struct File
+  {
+    std::string name;
+    std::string baseName;
+    size_t directory;
+    uint64_t size;   // Polling only
+    int64_t time;
+  };
+
+  void MarkChanged( size_t directory, const char* baseName, std::vector<bool>& changed ) const;
+
+  std::vector<File> m_files;
+  std::vector<std::unique_ptr<Directory>> m_directories;
+
+#if defined( __linux__ )
+  int m_inotify{ -1 };
+#endif
+};
+
+#endif // WATCH_FILE_WATCHER_H
@@ -0,0 +1,215 @@
+#include "tile_watch.h"
+
+
+namespace
+{
+  // The tile whose bytes include the one at position (from the layout's offset), if any
+  bool TileOfByte( const TileByteLayout& layout, size_t position, int32_t& tile )
+  {
+    size_t tileNum;
+    size_t line;
+    size_t byte;
+
+    // Whichever stride is the larger one splits the bytes up first
+    if( layout.tileStride >= layout.lineStride )
+    {
+      tileNum = position / layout.tileStride;
+      line = position % layout.tileStride / layout.lineStride;
+      byte = position % layout.tileStride % layout.lineStride;
+    }
+    else
+    {
+      line = position / layout.lineStride;
+      tileNum = position % layout.lineStride / layout.tileStride;
+      byte = position % layout.lineStride % layout.tileStride;
+    }
+
+    tile = static_cast<int32_t>( tileNum );
+    return tileNum < static_cast<size_t>( layout.numTiles ) && line < static_cast<size_t>( layout.numLines ) &&
+           byte < static_cast<size_t>( layout.bytesPerLine );
+  }
+} // namespace
+
+
+void MarkChangedTiles( const TileByteLayout& layout, const std::vector<uint8_t>& before,
+                       const std::vector<uint8_t>& after, std::vector<bool>& changed )
+{
+  if( layout.numTiles <= 0 || layout.numLines <= 0 || layout.bytesPerLine <= 0 || layout.tileStride == 0 ||
+      layout.lineStride == 0 )
+  {
+    return;
+  }
+
+  const size_t extent{ ( layout.numTiles - 1 ) * layout.tileStride + ( layout.numLines - 1 ) * layout.lineStride +
+                       layout.bytesPerLine };
+  const size_t end{ layout.offset + extent };
+  const size_t common{ before.size() < after.size() ? before.size() : after.size() };
+  const size_t longest{ before.size() > after.size() ? before.size() : after.size() };
+
+  // Edits are a few bytes in a file, so most of it is skipped a block at a time
+  const size_t blockSize{ 64 };
+  size_t position{ layout.offset };
+
+  while( position < end && position < longest )
+  {
+    if( position + blockSize <= common && memcmp( &before[position], &after[position], blockSize ) == 0 )
+    {
+      position += blockSize;
+      continue;
+    }
+
+    const size_t blockEnd{ position + blockSize < end ? position + blockSize : end };
+    for( ; position < blockEnd && position < longest; ++position )
+    {
+      int32_t tile;
+      if( ( position >= common || before[position] != after[position] ) &&
+          TileOfByte( layout, position - layout.offset, tile ) )
+      {
+        changed[static_cast<size_t>( layout.firstPackTile + tile )] = true;
+      }
+    }
+  }
+}
+
+
+bool HasWatchOption( int32_t argc, char* argv[] )
+{
+  for( int32_t i = 1; i < argc; ++i )
+  {
+    if( strcmp( argv[i], "--watch" ) == 0 )
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+
+int32_t TileWatch::AddInput( const char* filename )
+{
+  Input input;
+  input.filename = filename;
+  if( !ReadFileBytes( filename, input.bytes ) )
+  {
+    return -1;
+  }
+
+  m_inputs.push_back( std::move( input ) );
+  return static_cast<int32_t>( m_inputs.size() ) - 1;
+}
+
+
+void TileWatch::AddLayout( int32_t input, const TileByteLayout& layout )
+{
+  m_inputs[input].layouts.push_back( layout );
+}
+
+
+bool TileWatch::Start( const char* packFilename )
+{
+  m_packFilename = packFilename;
+
+  if( !m_pack.Open( packFilename ) )
+  {
+    printf( "%s: can't open the tile pack to patch it\n", packFilename );
+    return false;
+  }
+
+  for( const Input& input : m_inputs )
+  {
+    for( const TileByteLayout& layout : input.layouts )
+    {
+      if( layout.firstPackTile < 0 || layout.firstPackTile + layout.numTiles > m_pack.NumTiles() )
+      {
+        printf( "%s: doesn't hold the tiles of %s\n", packFilename, input.filename.c_str() );
+        return false;
+      }
+    }
+
+    if( !m_watcher.Watch( input.filename.c_str() ) )
+    {
+      printf( "%s: can't watch it for changes\n", input.filename.c_str() );
+      return false;
+    }
+  }
+
+  // Patches only fit tiles that were stored raw
+  for( int32_t tile = 0; tile < m_pack.NumTiles(); ++tile )
+  {
+    if( m_pack.Tile( tile ).codec != TILE_PACK_CODEC_RAW )
+    {
+      printf( "%s: has compressed tiles, which can't be patched in place\n", packFilename );
+      return false;
+    }
+  }
+
+  printf( "Watching %d files, patching %s as they change\n", static_cast<int32_t>( m_inputs.size() ), packFilename );
+  fflush( stdout );
+  return true;
+}
+
+
+bool TileWatch::NextChange( std::vector<int32_t>& tiles )
+{
+  tiles.clear();
+
+  std::vector<std::string> changedFiles;
+  if( !m_watcher.WaitForChanges( changedFiles ) )
+  {
+    printf( "Watching for changes failed\n" );
+    return false;
+  }
+
+  m_changeTime = std::chrono::steady_clock::now();
+
+  std::vector<bool> changed( static_cast<size_t>( m_pack.NumTiles() ), false );
+  std::vector<uint8_t> bytes;
+
+  for( Input& input : m_inputs )
+  {
+    bool saved{ false };
+    for( const std::string& filename : changedFiles )
+    {
+      saved |= filename == input.filename;
+    }
+
+    // A file that's gone (an editor saving through a temporary file) keeps its old contents until it's back
+    if( !saved || !ReadFileBytes( input.filename.c_str(), bytes ) )
+    {
+      continue;
+    }
+
+    for( const TileByteLayout& layout : input.layouts )
+    {
+      MarkChangedTiles( layout, input.bytes, bytes, changed );
+    }
+
+    input.bytes.swap( bytes );
+  }
+
+  for( size_t tile = 0; tile < changed.size(); ++tile )
+  {
+    if( changed[tile] )
+    {
+      tiles.push_back( static_cast<int32_t>( tile ) );
+    }
+  }
+
+  return true;
+}
+
+
+bool TileWatch::Finish( const std::vector<int32_t>& tiles )
+{
+  if( !m_pack.Flush() )
+  {
+    printf( "%s: can't write the patched tiles\n", m_packFilename );
+    return false;
+  }
+
+  const std::chrono::duration<double, std::milli> elapsed{ std::chrono::steady_clock::now() - m_changeTime };
+  printf( "%s: patched %d tiles in %.2f ms\n", m_packFilename, static_cast<int32_t>( tiles.size() ), elapsed.count() );
+  fflush( stdout );
+  return true;
+}
@@ -0,0 +1,151 @@
+// Incremental re-ripping for --watch: keeps a tile pack in step with its input files as they're edited.
+//
+// Each input has layouts that say where every tile's bytes are in it. When an input is saved, it's compared with what
+// it held before, only the tiles with a changed byte are decoded again, and they're written over their old pixels in
+// the pack. A tool that has the pack mapped sees the edit without reloading anything.
+
+#ifndef WATCH_TILE_WATCH_H
+#define WATCH_TILE_WATCH_H
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../tile_decode/tile_pack.h"
+#include "file_watcher.h"
+
+// Where a run of tiles is in an input: line l of tile t is bytesPerLine bytes at offset + t * tileStride +
+// l * lineStride. That covers tiles stored one after another (EGA shapes: a tileStride of 128 and a lineStride of 8)
+// as well as tiles whose lines are interleaved (Apple SHP0: a tileStride of 1 and a lineStride of 256).
+struct TileByteLayout
+{
+  size_t offset;
+  size_t tileStride;
+  size_t lineStride;
+  int32_t bytesPerLine;
+  int32_t numLines;
+  int32_t numTiles;
+  int32_t firstPackTile;  // The pack tile that tile 0 is
+};
+
+// Sets changed[firstPackTile + t] for every tile t of the layout with a byte that differs between before and after. A
+// byte that's in one of them but past the end of the other has changed.
+void MarkChangedTiles( const TileByteLayout& layout, const std::vector<uint8_t>& before,
+                       const std::vector<uint8_t>& after, std::vector<bool>& changed );
+
+// True if --watch is on the command line
+bool HasWatchOption( int32_t argc, char* argv[] );
+
+class TileWatch
+{
+public:
+  // Reads an input. Returns its number for AddLayout() and Bytes(), or -1 if it can't be read.
+  int32_t AddInput( const char* filename );
+
+  void AddLayout( int32_t input, const TileByteLayout& layout );
+
+  // The input as of its last change
+  const std::vector<uint8_t>& Bytes( int32_t input ) const
+  {
+    return m_inputs[input].bytes;
+  }
+
+  // Patches the pack in packFilename (written raw, from the inputs as they are now) every time an input is saved, until
+  // watching fails. decodeTile( packTile, dest, pitch ) decodes a pack tile from Bytes() into dest, which is cleared to
+  // 0 first. Returns false when watching fails, or right away if the pack doesn't match the layouts.
+  template<typename DecodeTile>
+  bool Run( const char* packFilename, DecodeTile&& decodeTile );
+
+private:
+  struct Input
+  {
+    std::string filename;
+    std::vector<uint8_t> bytes;
+    std::vector<TileByteLayout> layouts;
+  };
+
+  bool Start( const char* packFilename );
+
+  // Waits for inputs to be saved and rereads them. Returns the pack tiles they changed.
+  bool NextChange( std::vector<int32_t>& tiles );
+
+  bool Finish( const std::vector<int32_t>& tiles );
+
+  std::vector<Input> m_inputs;
+  FileWatcher m_watcher;
+  TilePackPatcher m_pack;
+  const char* m_packFilename{ nullptr };
+  std::vector<uint8_t> m_pixels;
+  std::chrono::steady_clock::time_point m_changeTime;
+};
+
+
+template<typename DecodeTile>
+bool TileWatch::Run( const char* packFilename, DecodeTile&& decodeTile )
+{
+  if( !Start( packFilename ) )
+  {
+    return false;
+  }
+
+  std::vector<int32_t> tiles;
+  while( NextChange( tiles ) )
+  {
+    for( int32_t tile : tiles )
+    {
+      const TilePackEntry& entry{ m_pack.Tile( tile ) };
+      m_pixels.assign( static_cast<size_t>( entry.width ) * entry.height, 0 );
+      decodeTile( tile, m_pixels.data(), static_cast<int32_t>( entry.width ) );
+
+      if( !m_pack.PatchTile( tile, m_pixels.data(), entry.width ) )
+      {
+        printf( "%s: can't patch tile %d\n", packFilename, tile );
+        return false;
+      }
+    }
+
+    if( !Finish( tiles ) )
+    {
+      return false;
+    }
+  }
+
+  return false;
+}
+
+
+// Decodes each of the sheet's tiles on its own with a watch's decodeTile (tiles left to right, then top to bottom, the
+// first of them being firstPackTile), and checks it against the sheet, so that a watched pack ends up the same as one
+// from a full rip
+template<typename DecodeTile>
+bool VerifyTilesDecodeAlone( const char* label, const IndexSurface& sheet, int32_t tileWidth, int32_t tileHeight,
+                             int32_t firstPackTile, DecodeTile&& decodeTile )
+{
+  const int32_t tilesPerRow{ sheet.width / tileWidth };
+  const int32_t numTiles{ tilesPerRow * ( sheet.height / tileHeight ) };
+  std::vector<uint8_t> pixels;
+
+  for( int32_t tile = 0; tile < numTiles; ++tile )
+  {
+    pixels.assign( static_cast<size_t>( tileWidth ) * tileHeight, 0 );
+    decodeTile( firstPackTile + tile, pixels.data(), tileWidth );
+
+    const int32_t x{ ( tile % tilesPerRow ) * tileWidth };
+    const int32_t y{ ( tile / tilesPerRow ) * tileHeight };
+    for( int32_t row = 0; row < tileHeight; ++row )
+    {
+      if( memcmp( sheet.Row( y + row ) + x, &pixels[static_cast<size_t>( row ) * tileWidth], tileWidth ) != 0 )
+      {
+        printf( "FAIL %s: tile %d decoded alone differs from the sheet at row %d\n", label, tile, row );
+        return false;
+      }
+    }
+  }
+
+  printf( "OK   %s: %d tiles decode alone like the sheet\n", label, numTiles );
+  return true;
+}
+
+#endif // WATCH_TILE_WATCH_H